@@ -71,15 +71,20 @@ public:
 
 	pointer allocate(size_type numelements) const
 	{
+		// Arrays don't fit in a pool element so they come from the heap the pool was created in.  See JRSMemory_MemoryResource.h for
+		// cPoolResource which does this for any size.
 		if(numelements > 1)
-			return 0;
+			return static_cast<pointer>(m_pPool->GetHeap()->AllocateMemory(numelements * sizeof(value_type), 0));
 
 		return static_cast<pointer>(m_pPool->AllocateMemory());
 	}
 
 	void deallocate(pointer ptr, size_type numelements) const
 	{
-		m_pPool->FreeMemory(ptr);
+		if(numelements > 1)
+			m_pPool->GetHeap()->FreeMemory(ptr);
+		else
+			m_pPool->FreeMemory(ptr);
 	}
 
 	void construct(pointer ptr, const_reference value) const
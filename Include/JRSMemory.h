@@ -28,6 +28,10 @@
 // Callstack depth - should be a multiple of 4.  Otherwise an undefined error could happen
 #define JRSMEMORY_CALLSTACKDEPTH 8
 
+// Define MEMORYMANAGER_FRAMEPOINTERS when Elephant and the code calling it are built with frame pointers (-fno-omit-frame-pointer).
+// Call stacks are then walked through the frame pointer chain instead of the unwinder, which is much faster.  Stacks the walk cannot
+// follow fall back to the unwinder.  Linux and Android only.
+
 // Largest memory size allowed
 #define JRSMEMORYINITFLAG_LARGEST 0xffffffffffffffffULL
 
@@ -44,6 +48,11 @@
 #define JRSMEMORYFLAG_RESERVED1 9
 #define JRSMEMORYFLAG_RESERVED2 10
 
+// Zero fill guarantees of the system callbacks.  See InitializeAllocationCallbacks.
+#define JRSMEMORYZEROFLAG_NONE 0
+#define JRSMEMORYZEROFLAG_ALLOCATOR 1			// Memory from the system allocator is zero filled.
+#define JRSMEMORYZEROFLAG_RELEASE 2				// Pages given to the system release callback read back as zero.
+
 #ifndef _JRSMEMORY_HEAP_H
 #include <JRSMemory_Heap.h>
 #endif
@@ -59,16 +68,38 @@ typedef void (*MemoryManagerOutputToFile)(void *pData, int size, const jrs_i8 *p
 typedef void *(*MemoryManagerDefaultAllocator)(jrs_u64 uSize, void *pExtMemoryPtr);
 typedef void (*MemoryManagerDefaultFree)(void *pFree, jrs_u64 uSize);
 typedef jrs_sizet (*MemoryManagerDefaultSystemPageSize)(void);
+typedef jrs_bool (*MemoryManagerDefaultRelease)(void *pAddress, jrs_u64 uSize);
 
-// Maximum number of managed heaps defined.  Change this and recompile to increase.
+// Number of managed heap slots reserved in Initialize.  The registry doubles from the system allocator when they run out.  Must be a power of 2.
 static const jrs_u32 MemoryManager_MaxHeaps = 32;
 
-// Maximum number of self managed heaps defined.  Change this and recompile to increase.
+// Number of self managed heap slots reserved in Initialize.  The registry doubles from the system allocator when they run out.  Must be a power of 2.
 static const jrs_u32 MemoryManager_MaxUserHeaps = 32;
 
-// Maximum number of non intrusive heaps defined.  Change this and recompile to increase.
+// Number of non intrusive heap slots reserved in Initialize.  The registry doubles from the system allocator when they run out.  Must be a power of 2.
 static const jrs_u32 MemoryManager_MaxNonIntrusiveHeaps = 32;
 
+// Registry slot of a heap that is not registered.
+static const jrs_u32 MemoryManager_InvalidHeapSlot = 0xffffffff;
+
+// Maximum number of Malloc routes.  Routes are held in a 32bit mask so this cannot be increased.
+static const jrs_u32 MemoryManager_MaxMallocRoutes = 32;
+
+// Number of Malloc size classes.  One per power of 2 plus 0.
+static const jrs_u32 MemoryManager_MallocRouteClasses = (sizeof(jrs_sizet) * 8) + 1;
+
+// Maximum number of destroyed heap regions kept by the region cache.
+static const jrs_u32 MemoryManager_MaxCachedRegions = 32;
+
+// Maximum number of LiveView clients connected at once.  Only the Linux server accepts more than one.
+static const jrs_u32 MemoryManager_MaxLiveViewClients = 16;
+
+// Frames held for each unique call stack in the stack table.  Block headers store a 32bit id into the table instead of the frames.
+static const jrs_u32 MemoryManager_StackTableDepth = 16;
+
+// Frames recorded for each allocation sampled by the heap profiler.  No more than MemoryManager_StackTableDepth.
+static const jrs_u32 MemoryManager_SampleStackDepth = 16;
+
 // Forward declarations
 struct sFreeBlock;
 struct sAllocatedBlock;
@@ -85,12 +116,17 @@ typedef void (*MemoryManagerUserDetails)(cHeap::sHeapDetails &rDetails);
 JRSMEMORYALIGNPRE(128)				// Align the memory manager to 128 bytes.  Important for cache and atomic operations.
 class JRSMEMORYDLLEXPORT cMemoryManager
 {
-	// Thread locks for each potential heap plus the logging heap.
+	// Thread locks for the heap slots reserved in Initialize.  Slots added later bring their own.
 	JRSMemory_ThreadLock g_ThreadLocks[MemoryManager_MaxHeaps + MemoryManager_MaxUserHeaps + MemoryManager_MaxNonIntrusiveHeaps];
 	JRSMemory_ThreadLock m_EDThreadLock;
 	JRSMemory_ThreadLock m_LVThreadLock;
 	JRSMemory_ThreadLock m_ContThreadLock;
+	JRSMemory_ThreadLock m_ContDumpLock;
 	JRSMemory_ThreadLock m_MMThreadLock;
+	JRSMemory_ThreadLock m_RegionCacheLock;
+	JRSMemory_ThreadLock m_SamplerLock;
+	JRSMemory_ThreadLock m_StatsPageLock;
+	JRSMemory_ThreadLock m_PoolListLock;		// Pools attach to and detach from heaps under this.  Taken before any pool or heap lock.
 
 	// Statics and singleton values for the memory manager
 	static jrs_sizet m_uSmallHeapSize;
@@ -111,6 +147,20 @@ class JRSMEMORYDLLEXPORT cMemoryManager
 	static jrs_u32 m_uEDebugTime;
 	static jrs_u32 m_uEDebugPendingTime;
 	static jrs_u32 m_uEDebugMaxPendingAllocations;
+	static jrs_bool m_bDestroyOnExit;
+	static jrs_u64 m_uRegionCacheMaxSize;
+	static jrs_bool m_bRegionCacheRelease;
+	static jrs_u64 m_uSampleInterval;
+	static jrs_u32 m_uMaxSamples;
+	static jrs_u32 m_uMaxStacks;
+	static jrs_u32 m_uCompactDumpChunkSize;
+	static jrs_u32 m_uCompactDumpChunks;
+	static jrs_i8 m_StatsPageName[64];
+	static jrs_u32 m_uStatsPageUpdateMS;
+	static jrs_u32 m_uStatsPageMaxEntries;
+	static jrs_u32 m_uLVMaxClients;
+	static jrs_u32 m_uLVClientBacklog;
+	static jrs_i8 m_LVLocalSocketPath[108];
 
 	jrs_bool m_bInitialized;					// True if initialized
 
@@ -120,25 +170,123 @@ class JRSMEMORYDLLEXPORT cMemoryManager
 	void *m_pUseableMemoryStart;
 	void *m_pUseableMemoryEnd;
 	void *m_pUsableHeapMemoryStart;
+	void *m_pUsableHeapMemoryZero;				// Usable memory from here on has never been given to a heap.
 	jrs_bool m_bCustomMemoryDefined;		// TRUE if memory has been initialized by the user.
 	jrs_sizet m_uSystemPageSize;
 
+	// Heap registry.  One per heap type.  Each slot holds the storage and lock for a heap so creating one is a pop from the free list and
+	// finding one by name is a hash lookup.  The slot table doubles when it is full.  Old tables are kept until Destroy so threads reading
+	// them without the lock never see freed memory.
+	struct sHeapSlot
+	{
+		void *pHeap;							// Live heap or NULL.
+		void *pObject;							// Storage for the heap.
+		JRSMemory_ThreadLock *pLock;
+		jrs_u32 uNextFree;						// Next slot on the free list.
+		jrs_u32 uNextName;						// Next slot in the same name bucket.
+	};
+
+	struct sHeapRegistry
+	{
+		sHeapSlot * volatile pSlots;
+		jrs_u32 *pNameBuckets;					// First slot for each name hash.  One bucket per slot.
+		volatile jrs_u32 uMaxSlots;				// Power of 2.
+		jrs_u32 uFreeSlot;						// First free slot.  MemoryManager_InvalidHeapSlot when full.
+		jrs_u32 uObjectSize;
+	};
+
+	// Address range of every heap block sorted by start address.  Free and the FindHeapFromMemoryAddress calls search it without locking.
+	// Writers hold m_MMThreadLock and make the sequence odd while changing it so readers retry.
+	struct sHeapRange
+	{
+		jrs_i8 *pStart;
+		jrs_i8 *pEnd;
+		jrs_i8 *pMaxEnd;						// Largest end of this and every earlier range.
+		cHeap *pHeap;							// Owner.  Only one is set.
+		cHeapNonIntrusive *pNIHeap;
+	};
+
+	struct sHeapRangeTable
+	{
+		jrs_u32 uMaxRanges;
+		jrs_u32 uNumRanges;
+		sHeapRange Ranges[1];					// uMaxRanges entries.
+	};
+
+	// System memory owned by the registry and range table.  Freed in Destroy.
+	struct sRegistryBlock
+	{
+		sRegistryBlock *pNext;
+		jrs_u64 uSize;
+		JRSMemory_ThreadLock *pLocks;			// Locks constructed in the block.
+		jrs_u32 uNumLocks;
+	};
+
 	jrs_u32 m_uHeapNum;
-	cHeap *m_pHeaps[MemoryManager_MaxHeaps];
 	jrs_u32 m_uUserHeapNum;
-	cHeap *m_pUserHeaps[MemoryManager_MaxUserHeaps];
-	jrs_u32 m_uHeapIdInfo;
-	
 	jrs_u32 m_uNonIntrusiveHeapNum;
-	cHeapNonIntrusive *m_pNonInstrusiveHeaps[MemoryManager_MaxNonIntrusiveHeaps];
+	jrs_u32 m_uHeapIdInfo;
+	sHeapRegistry m_HeapRegistry;
+	sHeapRegistry m_UserHeapRegistry;
+	sHeapRegistry m_NIHeapRegistry;
+	sHeapSlot m_InitialHeapSlots[MemoryManager_MaxHeaps + MemoryManager_MaxUserHeaps + MemoryManager_MaxNonIntrusiveHeaps];
+	jrs_u32 m_uInitialNameBuckets[MemoryManager_MaxHeaps + MemoryManager_MaxUserHeaps + MemoryManager_MaxNonIntrusiveHeaps];
+	sHeapRangeTable * volatile m_pHeapRanges;
+	sRegistryBlock *m_pRegistryBlocks;
+	JRSMEMORYLOCALALIGN(volatile jrs_u32 m_uHeapRangeSequence, 128);
 
 	jrs_u32 m_uPoolIdInfo;
 
+	// Malloc routing.  Routes are tried in the order they were added and the next matching route is tried when one is full.
+	struct sMallocRoute
+	{
+		jrs_sizet uMinSize;						// Smallest size served.
+		jrs_sizet uMaxSize;						// Largest size served.
+		jrs_u32 uMaxAlignment;					// Largest alignment served.
+		cHeap *pHeap;							// Destination.  Only one of the heap, non intrusive heap or pool is set.
+		cHeapNonIntrusive *pNIHeap;
+		cPool *pPool;
+		jrs_u32 uOverflows;						// Allocations that could not be served and moved on.
+	};
+	sMallocRoute m_MallocRoutes[MemoryManager_MaxMallocRoutes];
+	jrs_u32 m_uNumMallocRoutes;
+	jrs_u32 m_uMallocRouteClasses[MemoryManager_MallocRouteClasses];	// Mask of the routes overlapping each size class.
+	jrs_u32 m_uMallocRoutePools;										// Mask of the routes to pools.
+
 	// Flags to handle dynamic resizing
 	jrs_bool m_bResizeable;		
 	jrs_u64 *m_pResizableSystemAllocs;
 	jrs_u32 m_uResizableCount;
 
+	// Region cache.  System memory of destroyed heaps waits here for the next heap of the same size class.  Oldest first.
+	struct sHeapRegion
+	{
+		void *pMemory;
+		jrs_u64 uSize;
+		MemoryManagerDefaultAllocator systemAllocator;		// Allocator and free the region came from.  Only reused for the same pair.
+		MemoryManagerDefaultFree systemFree;
+		jrs_bool bZeroed;									// Pages were released and read back as zero.
+	};
+	sHeapRegion m_RegionCache[MemoryManager_MaxCachedRegions];
+	jrs_u32 m_uNumCachedRegions;
+	jrs_u64 m_uCachedRegionSize;
+
+	// Sampling heap profiler.  Created in Initialize when InitializeSamplingProfiler has set an interval.
+	struct sSampler;
+	sSampler *m_pSampler;
+
+	// Unique call stacks referenced by id from block headers.  Created by the first stack captured.
+	struct sStackTable;
+	sStackTable * volatile m_pStackTable;
+
+	// Compact continuous dump.  Created in Initialize when InitializeCompactContinuousDump has set a chunk size.
+	struct sCompactDump;
+	sCompactDump *m_pCompactDump;
+
+	// Shared memory statistics page.  Created in Initialize when InitializeStatsPage has set a name.
+	struct sStatsPage;
+	sStatsPage *m_pStatsPage;
+
 	// Enhanced debugging information
 	struct sEDebug
 	{
@@ -176,7 +324,7 @@ class JRSMEMORYDLLEXPORT cMemoryManager
 
 	void AddEDebugAllocation(void *pMemoryAddress);
 
-	// Heaps come from the start of this block
+	// Heaps in the initial registry slots come from the start of this block
 	cHeap *m_pMemoryHeaps;
 	cHeap *m_pMemoryUserHeaps;
 	cHeap *m_pMemorySmallHeap;
@@ -212,6 +360,8 @@ class JRSMEMORYDLLEXPORT cMemoryManager
 	static MemoryManagerDefaultAllocator m_MemoryManagerDefaultAllocator;
 	static MemoryManagerDefaultFree m_MemoryManagerDefaultFree;
 	static MemoryManagerDefaultSystemPageSize m_MemoryManagerDefaultSystemPageSize;
+	static MemoryManagerDefaultRelease m_MemoryManagerDefaultSystemRelease;
+	static jrs_u32 m_uMemoryManagerDefaultZeroFlags;
 	static MemoryManagerTTYOutputCB m_MemoryManagerTTYOutput;
 	static MemoryManagerErrorCB m_MemoryManagerError;
 	static MemoryManagerOutputToFile m_MemoryManagerFileOutput;
@@ -227,8 +377,11 @@ class JRSMEMORYDLLEXPORT cMemoryManager
 
 	// Thread functions
 	static jrs_bool JRSMemory_LiveView_SendOperations(void *pBuffer, JRSMemory_ThreadLock *pThreadLock);
+	static void JRSMemory_LiveView_ResetOperations(void);
 	static cJRSThread::jrs_threadout JRSMemory_LiveViewThread(cJRSThread::jrs_threadin pArg);
 	static cJRSThread::jrs_threadout JRSMemory_EnhancedDebuggingThread(cJRSThread::jrs_threadin pArg);
+	static cJRSThread::jrs_threadout JRSMemory_ContinuousDumpThread(cJRSThread::jrs_threadin pArg);
+	static cJRSThread::jrs_threadout JRSMemory_StatsPageThread(cJRSThread::jrs_threadin pArg);
 
 	// Private functions	
 	jrs_bool InternalCreatePoolBase(jrs_u32 uElementSize, jrs_u32 uMaxElements, const jrs_i8 *pHeapName, sPoolDetails *pDetails = NULL, cHeap *pHeap = NULL);
@@ -236,19 +389,97 @@ class JRSMEMORYDLLEXPORT cMemoryManager
 	jrs_bool ContinuousLog_CanLog(cHeap *pHeap);
 	jrs_bool ContinuousLog_CanLog(cHeapNonIntrusive *pHeap);
 	void ContinuousLog_AddToBuffer(sLVOperation &rOp, void *pData);
+	jrs_u32 ContinuousLog_ExpandStackId(jrs_u8 *pWire, const void *pHeader, jrs_bool bFreeBlock) const;
 	void ContinuousLogging_Operation(eContLog eType, cHeap *pHeap, cPoolBase *pPool, jrs_u64 uMisc);
 	void ContinuousLogging_NIOperation(eContLog eType, cHeapNonIntrusive *pHeap, cPoolBase *pPool, jrs_u64 uMisc);
-	void ContinuousLogging_HeapOperation(eContLog eType, cHeap *pHeap, void *pHeaderAdd, jrs_u32 uAlignment, jrs_u64 uMisc);
+	void ContinuousLogging_HeapOperation(eContLog eType, cHeap *pHeap, void *pHeaderAdd, jrs_u32 uAlignment, jrs_u64 uMisc, void *pMemory = NULL);
 	void ContinuousLogging_HeapNIOperation(eContLog eType, cHeapNonIntrusive *pHeap, void *pHeaderAdd, jrs_u32 uAlignment, jrs_u64 uSize, jrs_u64 uMisc);
 	void ContinuousLogging_PoolOperation(eContLog eType, cPoolBase *pPool, void *pAddress, jrs_u64 uMisc);
 
+	// Compact continuous dump
+	jrs_bool CreateCompactDump(void);
+	void DestroyCompactDump(void);
+	jrs_bool ContinuousLog_IsDumpWriter(void) const;
+	void CompactDump_Start(void);
+	void CompactDump_Finish(void);
+	void CompactDump_Record(eContLog eType, jrs_u32 uId, jrs_u64 uAddress, jrs_u64 uSize, jrs_u32 uAlignment, jrs_u32 uStackId, const jrs_i8 *pName);
+	void CompactDump_CreateRecord(eContLog eType, jrs_u32 uId, jrs_u32 uKind, jrs_u32 uParentId, jrs_u64 uAddress, jrs_u64 uSize, jrs_u32 uAlignment, jrs_u64 uMinSize, jrs_u64 uMaxSize, const jrs_i8 *pName);
+	jrs_u8 *CompactDump_BeginRecord(jrs_u32 uType, jrs_u32 uId);
+	void CompactDump_EndRecord(jrs_u8 *pEnd);
+	void CompactDump_DefineStack(jrs_u32 uStackId);
+	jrs_bool CompactDump_NewChunk(void);
+	void CompactDump_QueueChunk(void);
+
+	// Statistics page
+	jrs_bool CreateStatsPage(void);
+	void DestroyStatsPage(void);
+
 	void StackTrace(jrs_sizet *pCallStack, jrs_u32 uCallstackDepth, jrs_u32 uCallStackCount);
-	static void StackToString(jrs_i8 *pOutputBuffer, jrs_sizet *pCallstack, jrs_u32 uCallStackCount);
+	static void StackToString(jrs_i8 *pOutputBuffer, const jrs_sizet *pCallstack, jrs_u32 uCallStackCount);
+
+	// Stack table
+	jrs_u32 StackTraceId(jrs_u32 uCallstackDepth, jrs_u32 uCallStackCount);
+	jrs_u32 AddStack(const jrs_sizet *pCallStack, jrs_u32 uCallStackCount);
+	const jrs_sizet *GetStackFromId(jrs_u32 uStackId) const;
+	jrs_bool CreateStackTable(void);
+	void DestroyStackTable(void);
+
+	// Malloc routing
+	jrs_bool InternalAddMallocRoute(jrs_sizet uMinSize, jrs_sizet uMaxSize, jrs_u32 uMaxAlignment, cHeap *pHeap, cHeapNonIntrusive *pNIHeap, cPool *pPool);
+	void RemoveMallocRoutes(void *pDestination);
+	void BuildMallocRouteClasses(void);
+	static jrs_u32 GetMallocRouteClass(jrs_sizet uSize);
+	cPool *FindMallocRoutePool(void *pMemory) const;
+	void *ReallocMigrate(cHeap *pHeap, void *pMemory, jrs_sizet uSizeInBytes, jrs_u32 uAlignment, jrs_u32 uFlag, const jrs_i8 *pText);
+	void *InternalMalloc(jrs_sizet uSizeInBytes, jrs_u32 uAlignment, jrs_u32 uFlag, const jrs_i8 *pText, const jrs_u32 uExternalId, jrs_bool bZeroed);
+	static jrs_u32 GetSystemZeroFlags(MemoryManagerDefaultAllocator Allocator, MemoryManagerDefaultRelease Release);
 
 	// Resizable calls
 	jrs_bool InternalResize(jrs_u64 uMinimumSize);
 	jrs_bool InternalResizeHeap(cHeap *pHeap, jrs_u64 uSize);
 
+	// Heap registry
+	void InitializeHeapRegistry(sHeapRegistry &rRegistry, sHeapSlot *pSlots, jrs_u32 *pNameBuckets, jrs_u32 uNumSlots, void *pObjects, jrs_u32 uObjectSize, JRSMemory_ThreadLock *pLocks);
+	jrs_bool GrowHeapRegistry(sHeapRegistry &rRegistry);
+	jrs_u32 AcquireHeapSlot(sHeapRegistry &rRegistry);
+	void RegisterHeapSlot(sHeapRegistry &rRegistry, jrs_u32 uSlot, void *pHeap);
+	void ReleaseHeapSlot(sHeapRegistry &rRegistry, jrs_u32 uSlot);
+	void *FindHeapSlot(const sHeapRegistry &rRegistry, const jrs_i8 *pName) const;
+	const jrs_i8 *GetHeapSlotName(const sHeapRegistry &rRegistry, void *pHeap) const;
+	static jrs_u32 HashHeapName(const jrs_i8 *pName);
+	void *AllocateRegistryBlock(jrs_u64 uSize, jrs_u64 uLocksOffset, jrs_u32 uNumLocks);
+	void FreeRegistryBlocks(void);
+
+	// Heap address ranges
+	jrs_bool ReserveHeapRanges(jrs_u32 uCount);
+	jrs_bool AddHeapRange(cHeap *pHeap, cHeapNonIntrusive *pNIHeap, void *pStart, void *pEnd);
+	void RemoveHeapRanges(void *pHeap, void *pStart);
+	void SetHeapRangeEnd(void *pHeap, void *pStart, void *pEnd);
+	void UpdateHeapRangeMaxEnd(jrs_u32 uFirst);
+
+	// Region cache
+	jrs_u64 GetHeapRegionSize(jrs_u64 uSize, jrs_sizet uPageSize) const;
+	void *AcquireHeapRegion(jrs_u64 uSize, MemoryManagerDefaultAllocator Allocator, MemoryManagerDefaultFree Free, jrs_bool *pbZeroed);
+	void ReleaseHeapRegion(void *pMemory, jrs_u64 uSize, MemoryManagerDefaultAllocator Allocator, MemoryManagerDefaultFree Free);
+	jrs_bool DestroyScratchHeap(cHeap *pHeap);
+	jrs_bool FindHeapRange(void *pMemory, cHeap **ppHeap, cHeapNonIntrusive **ppNIHeap) const;
+
+	// Pool locks around fork
+	enum ePoolLockOperation
+	{
+		ePoolLock_Lock,
+		ePoolLock_Unlock,
+		ePoolLock_Reinitialize
+	};
+	void AllPoolLocks(ePoolLockOperation eOperation);
+
+	// Sampling heap profiler
+	jrs_bool CreateSampler(void);
+	void DestroySampler(void);
+	void SampleAllocation(void *pMemory, jrs_sizet uSize);
+	void RecordSample(void *pMemory, jrs_sizet uSize);
+	void RemoveSample(void *pMemory);
+
 	// Friend
 	friend class cHeap;
 	friend class cHeapNonIntrusive;
@@ -264,11 +495,18 @@ public:
 
 	// Callback initialize.  Call all before Initialize
 	static void InitializeCallbacks(MemoryManagerTTYOutputCB TTYOutput, MemoryManagerErrorCB ErrorHandle, MemoryManagerOutputToFile FileOutput = 0);
-	static void InitializeAllocationCallbacks(MemoryManagerDefaultAllocator DefaultAllocator, MemoryManagerDefaultFree DefaultFree, MemoryManagerDefaultSystemPageSize DefaultPageSize);
+	static void InitializeAllocationCallbacks(MemoryManagerDefaultAllocator DefaultAllocator, MemoryManagerDefaultFree DefaultFree, MemoryManagerDefaultSystemPageSize DefaultPageSize, MemoryManagerDefaultRelease DefaultRelease = NULL, jrs_u32 uZeroFlags = JRSMEMORYZEROFLAG_NONE);
 	static void InitializeSmallHeap(jrs_sizet uSmallHeapSize, jrs_u32 uMaxAllocSize, cHeap::sHeapDetails *pDetails = NULL);
 	static void InitializeContinuousDump(const jrs_i8 *pFileNameAndPath, jrs_bool bDefaultEnable = true);
+	static void InitializeCompactContinuousDump(jrs_u32 uChunkSize = 64 * 1024, jrs_u32 uNumChunks = 16);
 	static void InitializeLiveView(jrs_u32 uMilliSeconds = 33, jrs_u32 uPendingContinuousOperations = 1024, jrs_bool bAllowUserPostInit = false, jrs_i32 iExternalConnectionTimeOutMS = 0, jrs_u16 uPort = 7133);
+	static void InitializeLiveViewServer(jrs_u32 uMaxClients = 4, const jrs_i8 *pLocalSocketPath = NULL, jrs_u32 uClientBacklogSize = 1024 * 1024);
 	static void InitializeEnhancedDebugging(jrs_bool bEnhancedDebugging = false, jrs_u32 uDeferredTimeMS = 66, jrs_u32 uMaxAllocation = 1024 * 32, jrs_bool bAllowUserPostInit = false);
+	static void InitializeDestroyOnExit(jrs_bool bDestroyOnExit);
+	static void InitializeRegionCache(jrs_u64 uMaxCachedSize, jrs_bool bReleasePages = true);
+	static void InitializeSamplingProfiler(jrs_u64 uSampleInterval = 512 * 1024, jrs_u32 uMaxSamples = 16384);
+	static void InitializeStackTable(jrs_u32 uMaxStacks = 65536);
+	static void InitializeStatsPage(const jrs_i8 *pName = "/elephant_stats_%d", jrs_u32 uUpdateMS = 1000, jrs_u32 uMaxEntries = 256);
 
 	// Initialize and destroy
 	jrs_bool Initialize(jrs_u64 uMemorySize, jrs_u64 uDefaultHeapSize = JRSMEMORYINITFLAG_LARGEST, jrs_bool bFindMaxClosestToSize = true, void *pMemory = NULL);
@@ -280,6 +518,7 @@ public:
 	cHeap *CreateHeap(void *pMemoryAddress, jrs_u64 uHeapSize, const jrs_i8 *pHeapName, cHeap::sHeapDetails *pHeapDetails);
 	cHeapNonIntrusive *CreateNonIntrusiveHeap(void *pMemoryAddress, jrs_sizet uHeapSize, cHeap *pHeap, const jrs_i8 *pHeapName, cHeapNonIntrusive::sHeapDetails *pHeapDetails);
 	cHeapNonIntrusive *CreateNonIntrusiveHeap(jrs_sizet uHeapSize, cHeap *pHeap, const jrs_i8 *pHeapName, cHeapNonIntrusive::sHeapDetails *pHeapDetails);
+	cHeap *CreateScratchHeap(jrs_u64 uHeapSize, const jrs_i8 *pHeapName = "Scratch", cHeap::sHeapDetails *pHeapDetails = NULL);
 
 	jrs_bool ResizeHeap(cHeap *pHeap, jrs_u64 uSize);
 	jrs_bool ResizeHeapToLastAllocation(cHeap *pHeap);
@@ -288,6 +527,8 @@ public:
 	cHeap *GetHeap(jrs_u32 iIndex);
 	cHeap *GetUserHeap(jrs_u32 iIndex);
 	cHeapNonIntrusive *GetNIHeap(jrs_u32 iIndex);
+	jrs_u32 SnapshotHeapSlice(jrs_u32 iIndex, jrs_bool bUserHeap, cHeap::sSnapshot *pSnapshot, cHeap::sSnapshotBlock *pBlocks, jrs_u32 uMaxBlocks);
+	jrs_bool ReportHeapPool(jrs_u32 iIndex, jrs_bool bUserHeap, jrs_u32 uHeapId, jrs_u32 uPool);
 	jrs_u32 GetNumHeaps(void) const;
 	jrs_u32 GetNumUserHeaps(void) const;
 	jrs_u32 GetMaxNumHeaps(void) const;
@@ -307,12 +548,21 @@ public:
 	// Allocation functions
 	void *Malloc(jrs_sizet uSizeInBytes, jrs_u32 uAlignment = 0);
 	void *Malloc(jrs_sizet uSizeInBytes, jrs_u32 uAlignment, jrs_u32 uFlag, const jrs_i8 *pText, const jrs_u32 uExternalId = 0);
+	void *Calloc(jrs_sizet uCount, jrs_sizet uSizeInBytes, jrs_u32 uAlignment = 0, jrs_u32 uFlag = JRSMEMORYFLAG_NONE, const jrs_i8 *pText = NULL, const jrs_u32 uExternalId = 0);
 	void Free(void *pMemory, jrs_u32 uFlag = JRSMEMORYFLAG_NONE);
 	void Free(void *pMemory, jrs_u32 uFlag, const jrs_i8 *pText);
 	void *Realloc(void *pMemory, jrs_sizet uSizeInBytes, jrs_u32 uAlignment = 0, jrs_u32 uFlag = JRSMEMORYFLAG_NONE, const jrs_i8 *pText = NULL);
 
+	// Malloc routing
+	jrs_bool AddMallocRoute(jrs_sizet uMinSize, jrs_sizet uMaxSize, cHeap *pHeap, jrs_u32 uMaxAlignment = 0);
+	jrs_bool AddMallocRoute(jrs_sizet uMinSize, jrs_sizet uMaxSize, cHeapNonIntrusive *pHeap, jrs_u32 uMaxAlignment = 0);
+	jrs_bool AddMallocRoute(jrs_sizet uMinSize, jrs_sizet uMaxSize, cPool *pPool);
+	void ClearMallocRoutes(void);
+	void ReportMallocRoutes(void);
+
 	// Reclaiming
 	void Reclaim(void);
+	void FlushRegionCache(void);
 
 	// General functions
 	jrs_u64 GetFreeUsableMemory(void) const;
@@ -338,6 +588,8 @@ public:
 	void ReportAll(const jrs_i8 *pLogToFile = 0, jrs_bool includeFreeBlocks = FALSE, jrs_bool displayCallStack = FALSE);
 	void ReportStatistics(jrs_bool bAdvanced = false);
 	void ReportAllocationsMemoryOrder(const jrs_i8 *pLogToFile = 0, jrs_bool includeFreeBlocks = FALSE, jrs_bool displayCallStack = FALSE);
+	jrs_bool WriteHeapProfile(const jrs_i8 *pFilePathAndName);
+	void UpdateStatsPage(void);
 
 	void ReportAllToGoldfish(void);
 	void ReportContinuousStartToGoldfish(void);
@@ -345,6 +597,9 @@ public:
 
 	// Reset
 	void ResetHeapStatistics(void);
+	void LockAllHeaps(void);
+	void UnlockAllHeaps(void);
+	void ReinitializeAllHeapLocks(void);
 
 	// Singleton get
 
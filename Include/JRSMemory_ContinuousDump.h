@@ -0,0 +1,360 @@
+/* 
+(C) Copyright 2010 Jury Rig Software Limited. All Rights Reserved. 
+
+Use of this software is subject to the terms of an end user license agreement.
+This software contains code, techniques and know-how which is confidential and proprietary to Jury Rig Software Ltd.
+Not for disclosure or distribution without Jury Rig Software Ltd's prior written consent. 
+*/
+
+#ifndef _JRSMEMORY_CONTINUOUSDUMP_H
+#define _JRSMEMORY_CONTINUOUSDUMP_H
+
+#ifndef _JRSCORETYPES_H
+#include <JRSCoreTypes.h>
+#endif
+
+#include <string.h>
+
+// Compact continuous dump format.  Written instead of the CSV continuous dump when cMemoryManager::InitializeCompactContinuousDump is
+// called.  Everything is in the byte order of the machine that wrote it.
+//
+// The file is a sContinuousDumpFileHeader followed by chunks.  Each chunk is a sContinuousDumpChunkHeader and the chunk data, LZ compressed
+// unless the compressed size is 0.  Finishing the log appends one sContinuousDumpIndexEntry per chunk and a sContinuousDumpFooter so
+// readers can seek straight to a chunk.  A log that was not finished has no footer but the chunks can still be read in order.
+//
+// The chunk data is a sequence of records.  Each starts with a tag byte.  The low 5 bits are the record type and bit 5 and 6 say if the heap
+// or pool id and the thread id follow as varints.  Otherwise they are the same as the previous record.  All other values are LEB128 varints
+// with signed values zigzag encoded.  Every record other than a stack carries the ticks since the previous record.  Addresses are sent as
+// the signed difference from the previous address.  All of these start again from 0 and the chunk's first ticks at the start of each chunk
+// so chunks decode on their own.  Stack records define a stack id the first time it is used in each chunk, before the first record using it,
+// so a chunk found through the index resolves its own stacks.
+//
+//	Allocate, AllocatePool	- Address, size, alignment, stack id, name.
+//	Free, FreePool			- Address, size.
+//	CreateHeap, CreatePool	- Kind, parent heap id, address, size, alignment, minimum size, maximum size, name.
+//	ResizeHeap				- Size.
+//	DestroyHeap, DestroyPool - Nothing.
+//	Marker					- Name.
+//	Stack					- Stack id, frame count, frames as the signed difference from the previous frame.
+//
+// Names are a varint length followed by the characters without a terminator.  Pool allocations and frees use the element size as their size.
+
+// Elephant Namespace
+namespace Elephant
+{
+	// File identifiers
+	static const jrs_u32 ContinuousDump_FileMagic = 0x44434c45;			// 'ELCD'
+	static const jrs_u32 ContinuousDump_ChunkMagic = 0x4b4e4843;		// 'CHNK'
+	static const jrs_u32 ContinuousDump_FooterMagic = 0x58444e49;		// 'INDX'
+	static const jrs_u32 ContinuousDump_Version = 1;
+
+	// Longest name stored in a record, not including the terminator.
+	static const jrs_u32 ContinuousDump_MaxName = 63;
+
+	// Most frames stored in a stack record.
+	static const jrs_u32 ContinuousDump_MaxFrames = 16;
+
+	// Tag byte layout
+	static const jrs_u8 ContinuousDump_TagTypeMask = 0x1f;
+	static const jrs_u8 ContinuousDump_TagHasId = 0x20;
+	static const jrs_u8 ContinuousDump_TagHasThread = 0x40;
+
+	// Record types.  Match the continuous logging operations.
+	enum eContinuousDumpRecord
+	{
+		eContinuousDumpRecord_Allocate = 0,
+		eContinuousDumpRecord_Free = 1,
+		eContinuousDumpRecord_CreateHeap = 3,
+		eContinuousDumpRecord_ResizeHeap = 4,
+		eContinuousDumpRecord_DestroyHeap = 5,
+		eContinuousDumpRecord_Marker = 8,
+		eContinuousDumpRecord_CreatePool = 9,
+		eContinuousDumpRecord_DestroyPool = 10,
+		eContinuousDumpRecord_AllocatePool = 11,
+		eContinuousDumpRecord_FreePool = 12,
+		eContinuousDumpRecord_Stack = 31
+	};
+
+	// What a create record made.  Heaps and non intrusive heaps share ids.  Pools have their own.
+	enum eContinuousDumpKind
+	{
+		eContinuousDumpKind_Heap,
+		eContinuousDumpKind_NonIntrusiveHeap,
+		eContinuousDumpKind_Pool
+	};
+
+	// File header flags
+	static const jrs_u32 ContinuousDumpFlag_64Bit = 1 << 0;
+	static const jrs_u32 ContinuousDumpFlag_NameAndStack = 1 << 1;
+	static const jrs_u32 ContinuousDumpFlag_Sentinels = 1 << 2;
+
+	// Start of the file.
+	struct sContinuousDumpFileHeader
+	{
+		jrs_u32 uMagic;							// ContinuousDump_FileMagic
+		jrs_u32 uVersion;						// ContinuousDump_Version
+		jrs_u32 uChunkSize;						// Largest uncompressed chunk.
+		jrs_u32 uFlags;							// ContinuousDumpFlag_ values.
+		jrs_u64 uTicksPerSecond;				// 0 if the platform has no tick counter.
+		jrs_u64 uStartTicks;
+		jrs_u64 uBaseAddress;					// Stack frames are relative to this.
+	};
+
+	// Start of each chunk.
+	struct sContinuousDumpChunkHeader
+	{
+		jrs_u32 uMagic;							// ContinuousDump_ChunkMagic
+		jrs_u32 uCompressedSize;				// 0 if the data is stored uncompressed.
+		jrs_u32 uRawSize;
+		jrs_u32 uNumRecords;
+		jrs_u64 uFirstTicks;					// Ticks the first record is relative to.
+	};
+
+	// One per chunk after the last chunk.
+	struct sContinuousDumpIndexEntry
+	{
+		jrs_u64 uOffset;						// File offset of the chunk header.
+		jrs_u64 uFirstTicks;
+		jrs_u32 uNumRecords;
+		jrs_u32 uPad;
+	};
+
+	// End of a finished file.
+	struct sContinuousDumpFooter
+	{
+		jrs_u64 uIndexOffset;					// File offset of the first index entry.
+		jrs_u32 uNumChunks;
+		jrs_u32 uMagic;							// ContinuousDump_FooterMagic
+	};
+
+	// A decoded record.  Only the values used by the record type are set.
+	struct sContinuousDumpRecord
+	{
+		jrs_u32 uType;							// eContinuousDumpRecord
+		jrs_u32 uId;							// Heap or pool id.  Stack id for stack records.
+		jrs_u64 uThreadId;
+		jrs_u64 uTicks;
+		jrs_u64 uAddress;
+		jrs_u64 uSize;
+		jrs_u32 uAlignment;
+		jrs_u32 uStackId;						// 0 if there is no stack.
+		jrs_u32 uKind;							// eContinuousDumpKind of a create record.
+		jrs_u32 uParentId;						// Heap a pool was created in.
+		jrs_u64 uMinSize;
+		jrs_u64 uMaxSize;
+		jrs_u32 uNumFrames;
+		jrs_u64 uFrames[ContinuousDump_MaxFrames];
+		jrs_i8 Name[ContinuousDump_MaxName + 1];
+	};
+
+	//  Description:
+	//      Decompresses a chunk.  Control bytes below 0x80 are followed by that many + 1 literal bytes.  Others copy (control & 0x7f) + 4 bytes
+	//		from a 16bit little endian offset back in the output.
+	//  See Also:
+	//      cContinuousDumpChunkReader
+	//  Arguments:
+	//      pIn - Compressed data.
+	//		uInSize - Size of the compressed data.
+	//		pOut - Buffer for the chunk.
+	//		uOutSize - Size of pOut.  The chunk header raw size.
+	//  Return Value:
+	//      Size of the decompressed data.  0 if the data is corrupt or does not fit.
+	//  Summary:
+	//      Decompresses a chunk.
+	inline jrs_u32 ContinuousDump_Decompress(const void *pIn, jrs_u32 uInSize, void *pOut, jrs_u32 uOutSize)
+	{
+		const jrs_u8 *pSrc = (const jrs_u8 *)pIn;
+		const jrs_u8 *pSrcEnd = pSrc + uInSize;
+		jrs_u8 *pDst = (jrs_u8 *)pOut;
+		jrs_u32 uOut = 0;
+
+		while(pSrc < pSrcEnd)
+		{
+			jrs_u32 uControl = *pSrc++;
+			if(uControl < 0x80)
+			{
+				jrs_u32 uLength = uControl + 1;
+				if((jrs_u32)(pSrcEnd - pSrc) < uLength || uOutSize - uOut < uLength)
+					return 0;
+
+				memcpy(pDst + uOut, pSrc, uLength);
+				pSrc += uLength;
+				uOut += uLength;
+			}
+			else
+			{
+				if(pSrcEnd - pSrc < 2)
+					return 0;
+
+				jrs_u32 uLength = (uControl & 0x7f) + 4;
+				jrs_u32 uOffset = pSrc[0] | (pSrc[1] << 8);
+				pSrc += 2;
+				if(!uOffset || uOffset > uOut || uOutSize - uOut < uLength)
+					return 0;
+
+				// Matches can overlap themselves so copy a byte at a time
+				for(jrs_u32 i = 0; i < uLength; i++)
+					pDst[uOut + i] = pDst[uOut - uOffset + i];
+				uOut += uLength;
+			}
+		}
+
+		return uOut;
+	}
+
+	// Reads the records from the uncompressed data of one chunk.
+	class cContinuousDumpChunkReader
+	{
+		const jrs_u8 *m_pData;
+		jrs_u32 m_uSize;
+		jrs_u32 m_uPos;
+		jrs_u64 m_uTicks;
+		jrs_u64 m_uAddress;
+		jrs_u64 m_uThreadId;
+		jrs_u32 m_uId;
+		jrs_bool m_bError;
+
+		jrs_u64 ReadVarint(void)
+		{
+			jrs_u64 uValue = 0;
+			for(jrs_u32 uShift = 0; uShift < 64; uShift += 7)
+			{
+				if(m_uPos >= m_uSize)
+					break;
+
+				jrs_u8 uByte = m_pData[m_uPos++];
+				uValue |= (jrs_u64)(uByte & 0x7f) << uShift;
+				if(!(uByte & 0x80))
+					return uValue;
+			}
+
+			m_bError = TRUE;
+			return 0;
+		}
+
+		jrs_u64 ReadSigned(void)
+		{
+			jrs_u64 uValue = ReadVarint();
+			return (uValue >> 1) ^ (0 - (uValue & 1));
+		}
+
+		void ReadName(jrs_i8 *pName)
+		{
+			jrs_u32 uLength = (jrs_u32)ReadVarint();
+			if(uLength > ContinuousDump_MaxName || m_uSize - m_uPos < uLength)
+			{
+				m_bError = TRUE;
+				uLength = 0;
+			}
+
+			memcpy(pName, m_pData + m_uPos, uLength);
+			pName[uLength] = 0;
+			m_uPos += uLength;
+		}
+
+	public:
+
+		cContinuousDumpChunkReader(const void *pData, jrs_u32 uSize, jrs_u64 uFirstTicks) : m_pData((const jrs_u8 *)pData), m_uSize(uSize), m_uPos(0),
+			m_uTicks(uFirstTicks), m_uAddress(0), m_uThreadId(0), m_uId(0), m_bError(FALSE) {}
+
+		// TRUE if a record was truncated or had bad values.
+		jrs_bool HasError(void) const { return m_bError; }
+
+		//  Description:
+		//      Reads the next record in the chunk.
+		//  See Also:
+		//      ContinuousDump_Decompress
+		//  Arguments:
+		//      rRecord - Filled with the record.
+		//  Return Value:
+		//      TRUE if a record was read.
+		//		FALSE at the end of the chunk or on an error.  HasError tells the two apart.
+		//  Summary:
+		//      Reads the next record.
+		jrs_bool ReadRecord(sContinuousDumpRecord &rRecord)
+		{
+			if(m_bError || m_uPos >= m_uSize)
+				return FALSE;
+
+			jrs_u8 uTag = m_pData[m_uPos++];
+			memset(&rRecord, 0, sizeof(rRecord));
+			rRecord.uType = uTag & ContinuousDump_TagTypeMask;
+
+			if(rRecord.uType == eContinuousDumpRecord_Stack)
+			{
+				rRecord.uId = (jrs_u32)ReadVarint();
+				rRecord.uNumFrames = (jrs_u32)ReadVarint();
+				if(rRecord.uNumFrames > ContinuousDump_MaxFrames)
+				{
+					m_bError = TRUE;
+					return FALSE;
+				}
+
+				jrs_u64 uFrame = 0;
+				for(jrs_u32 i = 0; i < rRecord.uNumFrames; i++)
+				{
+					uFrame += ReadSigned();
+					rRecord.uFrames[i] = uFrame;
+				}
+				return !m_bError;
+			}
+
+			if(uTag & ContinuousDump_TagHasId)
+				m_uId = (jrs_u32)ReadVarint();
+			if(uTag & ContinuousDump_TagHasThread)
+				m_uThreadId = ReadVarint();
+			m_uTicks += ReadVarint();
+
+			rRecord.uId = m_uId;
+			rRecord.uThreadId = m_uThreadId;
+			rRecord.uTicks = m_uTicks;
+
+			switch(rRecord.uType)
+			{
+			case eContinuousDumpRecord_Allocate:
+			case eContinuousDumpRecord_AllocatePool:
+				m_uAddress += ReadSigned();
+				rRecord.uAddress = m_uAddress;
+				rRecord.uSize = ReadVarint();
+				rRecord.uAlignment = (jrs_u32)ReadVarint();
+				rRecord.uStackId = (jrs_u32)ReadVarint();
+				ReadName(rRecord.Name);
+				break;
+			case eContinuousDumpRecord_Free:
+			case eContinuousDumpRecord_FreePool:
+				m_uAddress += ReadSigned();
+				rRecord.uAddress = m_uAddress;
+				rRecord.uSize = ReadVarint();
+				break;
+			case eContinuousDumpRecord_CreateHeap:
+			case eContinuousDumpRecord_CreatePool:
+				rRecord.uKind = (jrs_u32)ReadVarint();
+				rRecord.uParentId = (jrs_u32)ReadVarint();
+				m_uAddress += ReadSigned();
+				rRecord.uAddress = m_uAddress;
+				rRecord.uSize = ReadVarint();
+				rRecord.uAlignment = (jrs_u32)ReadVarint();
+				rRecord.uMinSize = ReadVarint();
+				rRecord.uMaxSize = ReadVarint();
+				ReadName(rRecord.Name);
+				break;
+			case eContinuousDumpRecord_ResizeHeap:
+				rRecord.uSize = ReadVarint();
+				break;
+			case eContinuousDumpRecord_DestroyHeap:
+			case eContinuousDumpRecord_DestroyPool:
+				break;
+			case eContinuousDumpRecord_Marker:
+				ReadName(rRecord.Name);
+				break;
+			default:
+				m_bError = TRUE;
+				break;
+			}
+
+			return !m_bError;
+		}
+	};
+}
+
+#endif	// _JRSMEMORY_CONTINUOUSDUMP_H
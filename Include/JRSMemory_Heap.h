@@ -12,6 +12,8 @@
 #define JRSMEMORYMANAGER_PAGEFREE 0x1
 #define JRSMEMORYMANAGER_PAGEALLOCATED 0x2
 #define JRSMEMORYMANAGER_PAGESUBALLOC 0x4
+#define JRSMEMORYMANAGER_PAGERELEASED 0x8
+#define JRSMEMORYMANAGER_PAGEZEROED 0x10
 
 // Elephant Namespace
 namespace Elephant
@@ -19,10 +21,17 @@ namespace Elephant
 	class cHeap;
 	class cHeapNonIntrusive;
 
+	// Latency histogram buckets.  Bucket n counts times from 2^n up to 2^(n+1) nanoseconds.
+	static const jrs_u32 MemoryManager_LatencyBuckets = 29;
+
+	// Length of the allocation names copied by cHeap::SnapshotSlice including the terminator.  The same as the block headers hold.
+	static const jrs_u32 MemoryManager_SnapshotNameLength = 40;
+
 	// User call backs
 	typedef void *(*MemoryManagerDefaultAllocator)(jrs_u64 uSize, void *pExtMemoryPtr);
 	typedef void (*MemoryManagerDefaultFree)(void *pFree, jrs_u64 uSize);
 	typedef jrs_sizet (*MemoryManagerDefaultSystemPageSize)(void);
+	typedef jrs_bool (*MemoryManagerDefaultRelease)(void *pAddress, jrs_u64 uSize);
 	typedef void (*HeapSystemCallback)(cHeap *pHeap, void *pAddress, jrs_u64 uSize, jrs_bool bFreeOp);
 	typedef void (*HeapSystemNICallback)(cHeapNonIntrusive *pHeap, void *pAddress, jrs_u64 uSize, jrs_bool bFreeOp);
 
@@ -41,6 +50,9 @@ namespace Elephant
 		// Mutex for various elephant functions
 		JRSMemory_ThreadLock *m_pThreadLock;
 		jrs_bool m_bThreadSafe;
+		jrs_u32 m_uRegistrySlot;		// Slot in the memory managers heap registry
+		void *m_pScratchRegion;			// System region holding a scratch heap and its lock.  NULL for other heaps.
+		jrs_u64 m_uScratchRegionSize;	// Size of the scratch region
 
 		jrs_sizet m_uMinAllocSize;		// Minimum allocation size
 		jrs_sizet m_uMaxAllocSize;		// Maximum allocation size
@@ -63,6 +75,8 @@ namespace Elephant
 		jrs_u32 m_uCallstackDepth;					// Default callstack start depth
 
 		sFreeBlock *m_pMainFreeBlock;				// Floating free block
+		jrs_i8 *m_pZeroMemoryStart;					// Start of the memory above the main free block still zero from the system
+		jrs_i8 *m_pZeroMemoryEnd;					// End of the zero memory
 
 		jrs_u32 m_uDefaultAlignment;				// Default alignment value	
 		jrs_bool m_bReverseFreeOnly;				// Reverse free only
@@ -76,11 +90,17 @@ namespace Elephant
 		// The allocated list
 		sAllocatedBlock *m_pAllocList;				// Live allocation list
 
+		// Incremental snapshots.  See SnapshotSlice.
+		jrs_u32 m_uGeneration;						// Changes each time a block joins, leaves or resizes in the allocation list.
+		jrs_u32 m_uSnapshotId;						// Id of the snapshot owning the cursor.  0 if none.
+		sAllocatedBlock *m_pSnapshotNext;			// Block the snapshot continues from.  Moved on when it leaves the list.
+
 		sLinkedBlock *m_pResizableLink;				// Pointer to the first resizable link
 		jrs_bool m_bResizable;						// TRUE if resizable by Elephant.
 		jrs_sizet m_uResizableSizeMin;				// Minimum size to resize.  Multiple of page size.  Minimum 32MB.
 		jrs_u64 m_uReclaimSize;						// Minimum size to reclaim.  Larger is faster and minimum is m_uResizableSizeMin.
 		jrs_bool m_bAllowResizeReclaimation;		// Allow reclamation.
+		jrs_u32 m_uResizeCount;						// Number of times the heap has grown or shrunk.
 
 		// Debug bits and pieces
 		jrs_bool m_bEnableErrors;					// Error enable
@@ -115,9 +135,49 @@ namespace Elephant
 		static const jrs_u32 m_uBinCount = 64;
 		sFreeBlock *m_pBins[m_uBinCount];
 
+		// Free block statistics.  Updated as blocks enter and leave the bins so GetFragmentationInfo does not walk the free lists.
+		jrs_u64 m_uBinMask;							// Bit per non empty bin.
+		jrs_u64 m_uBinMaxDirty;						// Bit per bin whose largest block has left.  m_uBinMaxSize is then only an upper bound.
+		jrs_sizet m_uBinFreeSize;					// Total size of the binned free blocks.
+		jrs_u32 m_uBinFreeBlocks[m_uBinCount];		// Free blocks in each bin.
+		jrs_sizet m_uBinFreeBytes[m_uBinCount];		// Total size of the free blocks in each bin.
+		jrs_sizet m_uBinMaxSize[m_uBinCount];		// Largest free block in each bin.
+
 		// Attached pools
 		cPoolBase *m_pAttachedPools;
 
+		// Address ranges of the attached pools sorted by start address.  FindPoolRange binary searches them without locking.
+		// Writers hold the heap lock and make the sequence odd while changing it so readers retry.  Tables come from the default
+		// system allocator and replaced tables are kept until the heap is destroyed so a late reader never reads freed memory.
+		struct sPoolRange
+		{
+			jrs_i8 *pStart;
+			jrs_i8 *pEnd;
+			cPoolBase *pPool;
+		};
+
+		struct sPoolRangeTable
+		{
+			sPoolRangeTable *pRetired;				// Table this one replaced.
+			jrs_u32 uMaxRanges;
+			jrs_u32 uNumRanges;
+			sPoolRange Ranges[1];					// uMaxRanges entries.
+		};
+		sPoolRangeTable * volatile m_pPoolRanges;
+		volatile jrs_u32 m_uPoolRangeSequence;
+
+		// Size class pools.  Created on demand and owned by the heap.
+		static const jrs_u32 m_uMaxSizeClasses = 64;
+		cPool *m_pSizeClassPools[m_uMaxSizeClasses];
+		jrs_u32 m_uNumSizeClasses;					// Number of size classes.  0 if disabled.
+		jrs_u32 m_uSizeClassPoolElements;			// Elements in each pool and in each grown chunk.
+
+		// Latency statistics.  Allocated the first time they are enabled and kept until the heap is destroyed.
+		struct sLatencyStats;
+		struct sLatencyScope;
+		sLatencyStats *m_pLatencyStats;
+		jrs_bool m_bLatencyStats;					// Operations and the lock are being timed.
+
 		// System callbacks for allocation
 		MemoryManagerDefaultAllocator m_systemAllocator;				// Allocates the heap during creation and resizing. Default NULL (uses cMemoryManager defaults).
 		MemoryManagerDefaultFree m_systemFree;						// Frees any memory for the heap during reclaiming or destruction.  Default NULL (uses cMemoryManager defaults).
@@ -134,6 +194,9 @@ namespace Elephant
 		// Block functions
 		sAllocatedBlock *AllocateFromFreeBlock(sFreeBlock *pFreeBlock, jrs_sizet uSize, jrs_u32 uAlignment, jrs_u32 uFlag);		
 		void InternalFreeMemory(void *pMemory, jrs_u32 uFlag, const jrs_i8 *pName, const jrs_u32 uExternalId);
+		jrs_bool InternalGrowInPlace(sAllocatedBlock *pBlock, jrs_sizet uSize);
+		void AddZeroMemory(jrs_i8 *pStart, jrs_i8 *pEnd);
+		void UpdateZeroMemory(void);
 		sFreeBlock *SearchForFreeBlockBinFit(jrs_sizet uSize, jrs_u32 uAlignment);		
 
 		// Bin Management
@@ -141,6 +204,9 @@ namespace Elephant
 		void CreateBinAllocation(jrs_sizet uSize, sFreeBlock *pNewFreeBlock, sFreeBlock **pFBPrevBin, sFreeBlock **pFBNextBin);
 		void StackTrace(jrs_sizet *pCallStack);			// Stack tracing
 
+		// Incremental snapshots
+		void SnapshotRemoveBlock(sAllocatedBlock *pBlock, sAllocatedBlock *pNext);
+
 		sLinkedBlock *ResizeInsertLink(jrs_u8 *pEndPtrForNewLink, jrs_u8 *pStartPtrOfNextBlock, sAllocatedBlock *pPrevAlloc, sAllocatedBlock *pNextAlloc, sLinkedBlock *pPrevLink, sLinkedBlock *pNextLink);
 		void ResizeInsertFreeBlock(sAllocatedBlock *pLastAllocBefore, sAllocatedBlock *pNextAllocPtr, jrs_u8 *pFreeBlockStartAddress);
 		void ResizeSafeInsertFreeBlock(sAllocatedBlock *pLastAllocBefore, sAllocatedBlock *pNextAllocPtr, jrs_u8 *pFreeBlockStartAddress);
@@ -156,18 +222,112 @@ namespace Elephant
 
 		// Finds the bin size related to the allocation size wanted.
 		jrs_sizet GetBinLookupBasedOnSize(jrs_sizet uSize) const;
+		jrs_sizet GetLargestBinBlock(jrs_u32 uBin) const;
+		void RefreshBinMaxSize(jrs_u32 uBin);
 
 		// Pools
-		void AttachPool(cPoolBase *pPool);
+		jrs_bool AttachPool(cPoolBase *pPool, void *pAddress, jrs_sizet uSize);
 		void RemovePool(cPoolBase *pPool);
+		jrs_bool AddPoolRange(cPoolBase *pPool, void *pAddress, jrs_sizet uSize);
+		void RemovePoolRange(void *pAddress);
+		void DestroyPoolRanges(void);
+		cPoolBase *FindPoolRange(void *pMemory) const;
+
+		// Size class pools
+		cPool *CreateSizeClassPool(jrs_u32 uSizeClass);
+		cPool *GetSizeClassPool(void *pMemory) const;
+		jrs_u32 GetNumberOfSizeClassAllocations(void) const;
+		void DestroySizeClassPools(void);
+
+		// Latency statistics
+		jrs_bool CreateLatencyStatistics(void);
+		void DestroyLatencyStatistics(void);
+		void LatencyLock(void) const;
+		void LatencyUnlock(void) const;
+		void RecordLatency(jrs_u32 uOp, jrs_u64 uTicks) const;
 
 		// friend
 		friend class cMemoryManager;
 		friend class cPoolBase;
+		friend class cPool;
+		friend struct sLatencyScope;
 
 
 	public:
 
+		// Operations timed by the latency statistics
+		enum eLatency
+		{
+			eLatency_Allocate,
+			eLatency_Free,
+			eLatency_ReAllocate,
+			eLatency_LockWait,
+			eLatency_LockHold,
+			eLatency_Max
+		};
+
+		// Latency histogram of one operation.  All times are in nanoseconds.
+		struct sLatencyHistogram
+		{
+			jrs_u64 uCount[MemoryManager_LatencyBuckets];	// Operations per bucket.  The first also counts 0 and the last everything longer.
+			jrs_u64 uTotal;									// Number of operations timed.
+			jrs_u64 uTotalNS;								// Sum of all the times.
+			jrs_u64 uMaxNS;									// Longest time.
+
+			jrs_u64 GetPercentileNS(jrs_f32 fPercentile) const;
+		};
+
+		// Free memory layout.  See GetFragmentationInfo.  Sizes are of whole free blocks including their headers unless stated.
+		struct sFragmentationInfo
+		{
+			jrs_sizet uFreeBytes;							// All free memory including the main free block.
+			jrs_sizet uMainFreeBlockSize;					// Free memory at the end of the heap.
+			jrs_sizet uLargestFreeBlock;					// Largest free block including the main free block.
+			jrs_sizet uLargestAllocation;					// Largest allocation that would fit.  Same as GetSizeOfLargestFragment.
+			jrs_u32 uNumFreeBlocks;							// Free blocks in the bins.  The main free block is not counted.
+			jrs_f32 fFragmentation;							// 1 - uLargestFreeBlock / uFreeBytes.  0 when all free memory is in one block.
+			jrs_u32 uNumBins;
+			jrs_sizet uBinMinimumSize[m_uBinCount];			// Smallest usable size (block size less the allocation header) each bin holds.
+			jrs_u32 uBinBlocks[m_uBinCount];				// Free blocks in each bin.
+			jrs_sizet uBinBytes[m_uBinCount];				// Total size of the free blocks in each bin.
+		};
+
+		// One block copied by SnapshotSlice.  Allocations, links and the free blocks between them in address order.
+		struct sSnapshotBlock
+		{
+			jrs_u64 uAddress;								// Address of the memory after the header.
+			jrs_u64 uSize;									// Usable size.
+			jrs_u32 uFlag;									// JRSMEMORYFLAG_ value.  0 for free blocks.
+			jrs_u32 uNumber;								// Unique allocation number.  The unique free number for free blocks.
+			jrs_u32 uStackId;								// Call stack id.  0 unless names and call stacks are tracked.
+			jrs_bool bFree;
+			jrs_i8 Name[MemoryManager_SnapshotNameLength];	// "Unknown" unless names and call stacks are tracked.
+		};
+
+		// Progress of an incremental snapshot.  Start with a new one for each snapshot and pass it to SnapshotSlice until bFinished is set.
+		struct sSnapshot
+		{
+			jrs_u32 uId;									// Set by the first slice.
+			jrs_u32 uStartGeneration;						// Heap generation when the first slice was taken.
+			jrs_u32 uGeneration;							// Heap generation at the end of the last slice.
+			jrs_u32 uChanges;								// Changes made to the heap between slices.  0 if the blocks are the heap at one moment.
+			jrs_u32 uSlices;
+			jrs_bool bFinished;
+			jrs_bool bInterrupted;							// Another snapshot of the heap started before this one finished.
+
+			// Heap details for the report header.  Taken by the first slice.
+			jrs_u32 uHeapId;
+			jrs_i8 HeapName[32];
+			jrs_u64 uHeapSize;
+			jrs_u64 uHeapAddress;
+			jrs_u64 uMinAllocSize;
+			jrs_u64 uMaxAllocSize;
+			jrs_u32 uDefaultAlignment;
+			jrs_bool bHeapIsUserManaged;
+
+			sSnapshot() : uId(0), uStartGeneration(0), uGeneration(0), uChanges(0), uSlices(0), bFinished(false), bInterrupted(false) {};
+		};
+
 		struct sHeapDetails
 		{
 			jrs_u32 uDefaultAlignment;			// Minimum of 16bytes.  Must be power of two multiple. Default 16.
@@ -185,6 +345,9 @@ namespace Elephant
 			jrs_sizet uReclaimSize;				// Size to reclaim.  Will try and reclaim all blocks larger or equal to this size and return to the OS.  Minimum size is uResizableSize. Default 128MB.
 			jrs_bool bAllowResizeReclaimation;	// Gives memory back to OS.  Performance hit may occur but will help.  Only for resizable heaps. Default false.
 			jrs_bool bEnableLogging;			// Enables logging for this heap.  Default true.
+			jrs_u32 uSizeClassPoolMax;			// Allocations up to this size with default alignment are served from size class pools owned by the heap.  Rounded down to a multiple of uDefaultAlignment, 64 classes maximum.  0 disables.  Default 0.
+			jrs_u32 uSizeClassPoolElements;		// Elements each size class pool starts with and grows by.  Default 256.
+			jrs_bool bEnableLatencyStatistics;	// Times allocations, frees, reallocations and the heap lock.  See GetLatencyHistogram.  Default false.
 
 			// Memory clearing and enhanced debugging.
 			jrs_bool bHeapClearing;				// Enable this to clear the allocations and frees with set values when the operation takes place.  Default false.
@@ -207,7 +370,7 @@ namespace Elephant
 			sHeapDetails() : uDefaultAlignment(16), uMinAllocationSize(16), uMaxAllocationSize(0), bUseEndAllocationOnly(false), bReverseFreeOnly(false),
 				bAllowNullFree(false), bAllowZeroSizeAllocations(false), bAllowDestructionWithAllocations(false), bAllowNotEnoughSpaceReturn(false), 
 				bHeapIsSelfManaged(false), bThreadSafe(true), uResizableSize(32 << 20), uReclaimSize(128 << 20), bAllowResizeReclaimation(false), bEnableLogging(true), 
-				bHeapClearing(false), uHeapAllocClearValue(0xad), uHeapFreeClearValue(0xbc), bEnableEnhancedDebug(true),
+				uSizeClassPoolMax(0), uSizeClassPoolElements(256), bEnableLatencyStatistics(false), bHeapClearing(false), uHeapAllocClearValue(0xad), uHeapFreeClearValue(0xbc), bEnableEnhancedDebug(true),
 				bEnableErrors(true), bErrorsAsWarnings(false), bEnableExhaustiveErrorChecking(false), bEnableSentinelChecking(true),
 				systemAllocator(NULL), systemFree(NULL), systemPageSize(NULL), systemOpCallback(NULL)
 			{};
@@ -219,6 +382,7 @@ namespace Elephant
 
 		// Memory allocation/deallocation functions
 		void *AllocateMemory(jrs_sizet uSize, jrs_u32 uAlignment, jrs_u32 uFlag = JRSMEMORYFLAG_NONE, const jrs_i8 *pName = 0, const jrs_u32 uExternalId = 0);
+		void *AllocateZeroed(jrs_sizet uSize, jrs_u32 uAlignment, jrs_u32 uFlag = JRSMEMORYFLAG_NONE, const jrs_i8 *pName = 0, const jrs_u32 uExternalId = 0);
 		void FreeMemory(void *pMemory, jrs_u32 uFlag = JRSMEMORYFLAG_NONE, const jrs_i8 *pName  = 0, const jrs_u32 uExternalId = 0);
 		void *ReAllocateMemory(void *pMemory, jrs_sizet uSize, jrs_u32 uAlignment, jrs_u32 uFlag = JRSMEMORYFLAG_NONE, const jrs_i8 *pName = 0, const jrs_u32 uExternalId = 0);
 
@@ -243,9 +407,11 @@ namespace Elephant
 		jrs_sizet GetMemoryUsedMaximum(void) const;
 		jrs_u32 GetNumberOfAllocationsMaximum(void) const;
 		jrs_u32 GetNumberOfLinks(void) const;
+		jrs_u32 GetResizeCount(void) const;
 
 		jrs_sizet GetSizeOfLargestFragment(void) const;
 		jrs_sizet GetTotalFreeMemory(void) const;
+		void GetFragmentationInfo(sFragmentationInfo *pInfo);
 
 		jrs_bool IsMemoryManagerManaged(void) const;
 		jrs_bool IsAllocatedFromThisHeap(void *pMemory) const;
@@ -270,6 +436,11 @@ namespace Elephant
 		void EnableExhaustiveSentinelChecking(jrs_bool bEnable);	
 		void EnableLogging(jrs_bool bEnable);						// Enables or disables continuous logging for the heap.
 		void SetCallstackDepth(jrs_u32 uDepth);					// Sets the callstack depth for the NAC/NACS libs to start from.  
+		jrs_bool EnableLatencyStatistics(jrs_bool bEnable);		// Times allocations, frees, reallocations and the heap lock.
+
+		// Latency statistics
+		jrs_bool GetLatencyHistogram(eLatency eOp, sLatencyHistogram *pHistogram) const;
+		void ResetLatencyStatistics(void);
 
 		// Error checking
 		void CheckForErrors(void);		//      Checks the entire heap for errors.
@@ -285,6 +456,12 @@ namespace Elephant
 		void ReportStatistics(jrs_bool bAdvanced = false);
 		void ReportAllocationsMemoryOrder(const jrs_i8 *pLogToFile = 0, jrs_bool includeFreeBlocks = FALSE, jrs_bool displayCallStack = FALSE);
 
+		// Incremental snapshots.  Each slice holds the heap lock only while it copies at most uMaxBlocks blocks.
+		jrs_u32 GetGeneration(void) const;
+		jrs_u32 SnapshotSlice(sSnapshot *pSnapshot, sSnapshotBlock *pBlocks, jrs_u32 uMaxBlocks);
+		static void ReportSnapshotHeader(const jrs_i8 *pLogToFile, const sSnapshot &rSnapshot);
+		static void ReportSnapshotBlocks(const jrs_i8 *pLogToFile, const sSnapshot &rSnapshot, const sSnapshotBlock *pBlocks, jrs_u32 uNumBlocks);
+
 		// Reset statistics
 		void ResetStatistics(void);
 
@@ -300,6 +477,7 @@ namespace Elephant
 
 		// Thread locking
 		JRSMemory_ThreadLock *m_pThreadLock;
+		jrs_u32 m_uRegistrySlot;		// Slot in the memory managers heap registry
 
 		// Block headers
 		struct sPageBlock
@@ -329,6 +507,8 @@ namespace Elephant
 			jrs_sizet uSize;
 			jrs_sizet uPageBlockSize;
 			jrs_u32 numBlocks;
+			void **ppDebugInfo;				// Memory tracking side table regions, created on first use.  One entry per slot of each page.
+			jrs_u32 uNumDebugRegions;
 		};
 		sSlab m_Slabs[m_uMaxNumSlabs];
 		jrs_u32 m_uNumSlabs;
@@ -350,6 +530,9 @@ namespace Elephant
 
 #ifndef MEMORYMANAGER_MINIMAL
 		jrs_u32 m_uDebugHeaderSize;
+		jrs_u32 m_uDebugSlotsPerPage;
+		jrs_u32 m_uDebugPagesPerRegion;
+		jrs_sizet m_uDebugRegionSize;
 #endif
 		// Addresses
 		void *m_pHeapStartAddress;
@@ -379,6 +562,13 @@ namespace Elephant
 		jrs_bool m_bResizable;				// Heap will automatically resize.  Default false.
 		jrs_sizet m_uResizableSize;			// Minimum size to resize the heap each time in resizable mode.  Larger sizes can create excessive wastage but will perform better. Default 128MB.
 
+		// Page release
+		jrs_bool m_bReleaseFreePages;		// Returns free page runs to the system.
+		jrs_sizet m_uReleaseThreshold;		// Minimum size of a free run before it is returned.
+		jrs_u32 m_uReleaseDelay;			// Number of frees between automatic purges.  0 releases as soon as a run is freed.
+		jrs_u32 m_uReleaseDelayCount;		// Frees since the last automatic purge.
+		jrs_sizet m_uReleasedSize;			// Total size of the free runs currently returned to the system.
+
 		// Debug bits and pieces
 		jrs_bool m_bEnableErrors;					// Error enable
 		jrs_bool m_bErrorsAsWarnings;				// Errors as warnings
@@ -395,6 +585,7 @@ namespace Elephant
 		MemoryManagerDefaultFree m_systemFree;						// Frees any memory for the heap during reclaiming or destruction.  Default NULL (uses cMemoryManager defaults).
 		MemoryManagerDefaultSystemPageSize m_systemPageSize;			// Page size required for system allocation.  Default NULL (uses cMemoryManager defaults).
 		HeapSystemNICallback m_systemOpCallback;						// Callback called everytime it calls a system function.
+		MemoryManagerDefaultRelease m_systemRelease;			// Returns free pages to the system.  NULL keeps them resident.
 		
 		// Private methods
 		cHeapNonIntrusive();
@@ -402,15 +593,21 @@ namespace Elephant
 		// Book keeping
 		void AddPagesToBin(sPageBlock *pFirstPageOfArray, jrs_u32 numPages);
 		sPageBlock *FindPages(jrs_u32 numPages, jrs_sizet uAlignment);
+		void *InternalAllocateMemory(jrs_sizet uSize, jrs_u32 uAlignment, jrs_u32 uFlag, const jrs_i8 *pName, const jrs_u32 uExternalId, jrs_bool bZeroed);
 		void RemoveFromBin(jrs_u32 uBin, sPageBlock *pBlock);
 		void RemoveFromBin(sPageBlock *pBlock);
 
 		// Sub block allocation
 		void *AddSubAllocation(sPageBlock *pBlock, jrs_sizet uSize);
 
+		// Page release
+		jrs_bool ReleasePages(sPageBlock *pBlock);
+		jrs_sizet InternalPurge(jrs_sizet uMinSize);
+
 		// Helpers
 		cHeapNonIntrusive::sSlab *FindSlabFromMemory(jrs_i8 *pMemory);
 		void UpdateDebugInfo(void *pDebugInfo, const jrs_i8 *pName);
+		void *GetDebugInfo(sPageBlock *pBlock);
 
 		// Expand the heap
 		jrs_bool Expand(void *pMemoryAddress, jrs_sizet uSize);
@@ -435,22 +632,29 @@ namespace Elephant
 			jrs_sizet uResizableSize;			// Minimum size to resize the heap each time in resizable mode.  Larger sizes can create excessive wastage but will perform better. Default 128MB.
 			jrs_bool bEnableLogging;			// Enables logging for this heap.  Default true.
 
+			// Page release.  The heap memory must come from the system allocators or otherwise be safe to release.
+			jrs_bool bReleaseFreePages;			// Returns free page runs to the system while keeping the address range.  Default false.
+			jrs_sizet uReleaseThreshold;		// Minimum size of a free run before it is returned to the system.  Default 256k.
+			jrs_u32 uReleaseDelay;				// Number of frees between automatic purges.  0 releases a run as soon as it is freed.  Default 0.
+
 			// Extra debug structures.		These are available in debug only builds.
 			jrs_bool bEnableErrors;				// Checks for errors.  Default true.
 			jrs_bool bErrorsAsWarnings;			// Disables all errors and turns them into warnings. Default false.
 			jrs_bool bEnableMemoryTracking;			// Enables name and callstack tracking.  Default false.
-			jrs_u32 uNumCallStacks;					// Depth of callstacks to capture.  Default 8.  bEnableDebugFeatures must be true.
+			jrs_u32 uNumCallStacks;					// Depth of callstacks to capture.  Default 8, at most 16.  bEnableDebugFeatures must be true.
 
 			// System callbacks for allocation
 			MemoryManagerDefaultAllocator systemAllocator;				// Allocates the heap during creation and resizing. Default NULL (uses cMemoryManager defaults).
 			MemoryManagerDefaultFree systemFree;						// Frees any memory for the heap during reclaiming or destruction.  Default NULL (uses cMemoryManager defaults).
 			MemoryManagerDefaultSystemPageSize systemPageSize;			// Page size required for system allocation.  Default NULL (uses cMemoryManager defaults).
 			HeapSystemNICallback systemOpCallback;						// Callback when a system op occurs.  Default NULL.
+			MemoryManagerDefaultRelease systemRelease;			// Returns free pages to the system.  Only used with a custom systemAllocator.  Default NULL (uses cMemoryManager defaults).
 
 			sHeapDetails() : uDefaultAlignment(64), uMinAllocationSize(64), uMaxAllocationSize(0), bAllowNullFree(false), bAllowZeroSizeAllocations(false), bAllowDestructionWithAllocations(false),
 				bAllowNotEnoughSpaceReturn(false), bThreadSafe(true), bResizable(false), uResizableSize(128 << 20), bEnableLogging(true),
+				bReleaseFreePages(false), uReleaseThreshold(256 << 10), uReleaseDelay(0),
 				bEnableErrors(true), bErrorsAsWarnings(false), bEnableMemoryTracking(false), uNumCallStacks(8),
-				systemAllocator(NULL), systemFree(NULL), systemPageSize(NULL), systemOpCallback(NULL)
+				systemAllocator(NULL), systemFree(NULL), systemPageSize(NULL), systemOpCallback(NULL), systemRelease(NULL)
 			{};
 		};
 
@@ -460,7 +664,12 @@ namespace Elephant
 
 		// Memory allocation/deallocation functions
 		void *AllocateMemory(jrs_sizet uSize, jrs_u32 uAlignment, jrs_u32 uFlag = JRSMEMORYFLAG_NONE, const jrs_i8 *pName = 0, const jrs_u32 uExternalId = 0);
+		void *AllocateZeroed(jrs_sizet uSize, jrs_u32 uAlignment, jrs_u32 uFlag = JRSMEMORYFLAG_NONE, const jrs_i8 *pName = 0, const jrs_u32 uExternalId = 0);
 		void FreeMemory(void *pMemory, jrs_u32 uFlag = JRSMEMORYFLAG_NONE, const jrs_i8 *pName  = 0, const jrs_u32 uExternalId = 0);
+		void *ReAllocateMemory(void *pMemory, jrs_sizet uSize, jrs_u32 uAlignment, jrs_u32 uFlag = JRSMEMORYFLAG_NONE, const jrs_i8 *pName = 0, const jrs_u32 uExternalId = 0);
+
+		// Returns free pages to the system
+		jrs_sizet Purge(jrs_sizet uMinSize = 0);
 		
 		// Reporting functions
 		void ReportAll(const jrs_i8 *pLogToFile = 0, jrs_bool includeFreeBlocks = FALSE, jrs_bool displayCallStack = FALSE);
@@ -483,6 +692,7 @@ namespace Elephant
 
 		jrs_sizet GetSizeOfLargestFragment(void) const;
 		jrs_sizet GetTotalFreeMemory(void) const;
+		jrs_sizet GetReleasedMemory(void) const;
 		void *GetAddress(void) const;
 		void *GetAddressEnd(void) const;
 		jrs_sizet GetMaxAllocationSize(void) const;
@@ -0,0 +1,297 @@
+/* 
+(C) Copyright 2010 Jury Rig Software Limited. All Rights Reserved. 
+
+Use of this software is subject to the terms of an end user license agreement.
+This software contains code, techniques and know-how which is confidential and proprietary to Jury Rig Software Ltd.
+Not for disclosure or distribution without Jury Rig Software Ltd's prior written consent. 
+*/
+
+#ifndef _JRSMEMORY_MEMORYRESOURCE_H
+#define _JRSMEMORY_MEMORYRESOURCE_H
+
+#ifndef _JRSMEMORY_H
+#include <JRSMemory.h>
+#endif
+
+#ifndef _JRSMEMORY_POOLS_H
+#include <JRSMemory_Pools.h>
+#endif
+
+// std::pmr::memory_resource adapters.  Only available when compiling C++17 or later with <memory_resource>.  The library itself does not
+// need C++17.
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#if defined(__has_include)
+#if __has_include(<memory_resource>)
+#define JRSMEMORY_HASMEMORYRESOURCE
+#endif
+#endif
+#endif
+
+#ifdef JRSMEMORY_HASMEMORYRESOURCE
+
+#include <memory_resource>
+
+// Elephant Namespace
+namespace Elephant
+{
+	//  Description:
+	//      Reports a failed allocation from a memory resource.  memory_resource requires std::bad_alloc to be thrown but Elephant is normally
+	//		built without exceptions.  In that case NULL is returned and the heap or pool will already have reported the error.
+	//  See Also:
+	//      cHeapResource
+	//  Arguments:
+	//      None
+	//  Return Value:
+	//      NULL
+	//  Summary:
+	//      Reports a failed allocation.
+	inline void *MemoryResourceAllocationFailed(void)
+	{
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND)
+		throw std::bad_alloc();
+#else
+		return NULL;
+#endif
+	}
+
+	// Memory resource allocating from a cHeap.  Deallocation goes straight to the heap without searching for the owner.
+	class cHeapResource : public std::pmr::memory_resource
+	{
+		cHeap *m_pHeap;
+		const jrs_i8 *m_pName;
+
+	public:
+
+		cHeapResource(cHeap *pHeap, const jrs_i8 *pName = NULL) : m_pHeap(pHeap), m_pName(pName) {}
+
+		cHeap *GetHeap(void) const { return m_pHeap; }
+
+	protected:
+
+		virtual void *do_allocate(std::size_t uBytes, std::size_t uAlignment)
+		{
+			// Heaps always align to at least their default so only ask for larger
+			void *pMemory = m_pHeap->AllocateMemory(uBytes, uAlignment > m_pHeap->GetDefaultAlignment() ? (jrs_u32)uAlignment : 0, JRSMEMORYFLAG_NONE, m_pName);
+			return pMemory ? pMemory : MemoryResourceAllocationFailed();
+		}
+
+		virtual void do_deallocate(void *pMemory, std::size_t, std::size_t)
+		{
+			m_pHeap->FreeMemory(pMemory, JRSMEMORYFLAG_NONE, m_pName);
+		}
+
+		virtual bool do_is_equal(const std::pmr::memory_resource &rOther) const noexcept
+		{
+			return this == &rOther;
+		}
+	};
+
+	// Memory resource allocating from a cHeapNonIntrusive.  Deallocation goes straight to the heap without searching for the owner.
+	class cHeapNonIntrusiveResource : public std::pmr::memory_resource
+	{
+		cHeapNonIntrusive *m_pHeap;
+		const jrs_i8 *m_pName;
+
+	public:
+
+		cHeapNonIntrusiveResource(cHeapNonIntrusive *pHeap, const jrs_i8 *pName = NULL) : m_pHeap(pHeap), m_pName(pName) {}
+
+		cHeapNonIntrusive *GetHeap(void) const { return m_pHeap; }
+
+	protected:
+
+		virtual void *do_allocate(std::size_t uBytes, std::size_t uAlignment)
+		{
+			void *pMemory = m_pHeap->AllocateMemory(uBytes, uAlignment > m_pHeap->GetDefaultAlignment() ? (jrs_u32)uAlignment : 0, JRSMEMORYFLAG_NONE, m_pName);
+			return pMemory ? pMemory : MemoryResourceAllocationFailed();
+		}
+
+		virtual void do_deallocate(void *pMemory, std::size_t, std::size_t)
+		{
+			m_pHeap->FreeMemory(pMemory, JRSMEMORYFLAG_NONE, m_pName);
+		}
+
+		virtual bool do_is_equal(const std::pmr::memory_resource &rOther) const noexcept
+		{
+			return this == &rOther;
+		}
+	};
+
+	// Memory resource for node based containers.  Sizes up to the maximum node size with an alignment of 16 or less come from growing cPools,
+	// one per 16 byte size class created the first time the class is used.  Everything else comes from the heap.  The size and alignment
+	// passed to deallocate select the pool or heap again so no ownership lookup is needed.  A full pool never falls back to the heap as the
+	// deallocation would then go to the wrong place.
+	class cPoolResource : public std::pmr::memory_resource
+	{
+	public:
+
+		enum
+		{
+			PoolGranularity = 16,
+			MaxPools = 64
+		};
+
+	private:
+
+		cHeap *m_pHeap;
+		cPool * volatile m_pPools[MaxPools];
+		volatile jrs_u64 m_uHeapClasses;	// Bit per size class served by the heap because its pool was released or could not be created.
+		jrs_u32 m_uNumPools;
+		jrs_u32 m_uElementsPerPool;
+		const jrs_i8 *m_pName;
+		JRSMemory_ThreadLock m_Lock;		// Taken to create and release pools.
+
+		// Non copyable
+		cPoolResource(const cPoolResource &);
+		cPoolResource &operator=(const cPoolResource &);
+
+		// Size class for the size and alignment.  MaxPools if the heap is used.
+		jrs_u32 GetSizeClass(std::size_t uBytes, std::size_t uAlignment) const
+		{
+			std::size_t uPool = uBytes ? (uBytes - 1) / PoolGranularity : 0;
+			return (uPool < m_uNumPools && uAlignment <= PoolGranularity) ? (jrs_u32)uPool : (jrs_u32)MaxPools;
+		}
+
+		//  Description:
+		//      Creates the pool of a size class the first time it is used.  A class whose pool cannot be created is served by the heap from then
+		//		on so a later pool never receives memory that came from the heap.
+		//  See Also:
+		//      do_allocate
+		//  Arguments:
+		//      uClass - Size class.
+		//  Return Value:
+		//      The pool.  NULL if the heap serves the class.
+		//  Summary:
+		//      Creates the pool of a size class.
+		cPool *CreateClassPool(jrs_u32 uClass)
+		{
+			m_Lock.Lock();
+			cPool *pPool = m_pPools[uClass];
+			if(!pPool && !(m_uHeapClasses & (1ULL << uClass)))
+			{
+				sPoolDetails details;
+				details.uAlignment = PoolGranularity;
+				details.uGrowElements = m_uElementsPerPool;
+				details.bAllowDestructionWithAllocations = true;
+				details.bAllowNotEnoughSpaceReturn = true;
+				pPool = cMemoryManager::Get().CreatePool((uClass + 1) * PoolGranularity, m_uElementsPerPool, m_pName, &details, m_pHeap);
+				if(pPool)
+				{
+					JRSMemoryBarrier();
+					m_pPools[uClass] = pPool;
+				}
+				else
+				{
+					m_uHeapClasses |= 1ULL << uClass;
+				}
+			}
+			m_Lock.Unlock();
+
+			return pPool;
+		}
+
+	public:
+
+		//  Description:
+		//      Sets up the size classes.  uMaxNodeSize is rounded up to 16 bytes and clamped to MaxPools size classes.  No pool is created until its
+		//		size class is first allocated.
+		//  See Also:
+		//      Release
+		//  Arguments:
+		//      pHeap - Heap for the pools and for allocations the pools do not serve.  NULL for the default heap.
+		//		uMaxNodeSize - Largest allocation served by a pool.  Default 256.
+		//		uElementsPerPool - Elements each pool starts with and grows by.  Default 256.
+		//		pName - Name of the pools and allocations.
+		//  Return Value:
+		//      None
+		//  Summary:
+		//      Sets up the size classes.
+		cPoolResource(cHeap *pHeap = NULL, jrs_u32 uMaxNodeSize = 256, jrs_u32 uElementsPerPool = 256, const jrs_i8 *pName = "PoolResource") : m_uHeapClasses(0), 
+			m_uElementsPerPool(uElementsPerPool), m_pName(pName)
+		{
+			m_pHeap = pHeap ? pHeap : cMemoryManager::Get().GetDefaultHeap();
+
+			m_uNumPools = (uMaxNodeSize + PoolGranularity - 1) / PoolGranularity;
+			if(m_uNumPools > MaxPools)
+				m_uNumPools = MaxPools;
+			for(jrs_u32 i = 0; i < MaxPools; i++)
+				m_pPools[i] = NULL;
+		}
+
+		virtual ~cPoolResource()
+		{
+			for(jrs_u32 i = 0; i < m_uNumPools; i++)
+			{
+				if(m_pPools[i])
+					cMemoryManager::Get().DestroyPool(m_pPools[i]);
+			}
+		}
+
+		//  Description:
+		//      Destroys the pools that have nothing allocated from them.  Later allocations of their size classes come from the heap.  Pools still in
+		//		use are kept, along with the size class table, so memory already handed out is always freed back to where it came from.  Everything
+		//		left is destroyed with the resource.  Must not be called while other threads allocate from the resource.
+		//  See Also:
+		//      cPoolResource
+		//  Arguments:
+		//      None
+		//  Return Value:
+		//      None
+		//  Summary:
+		//      Destroys the unused pools.
+		void Release(void)
+		{
+			m_Lock.Lock();
+			for(jrs_u32 i = 0; i < m_uNumPools; i++)
+			{
+				cPool *pPool = m_pPools[i];
+				if(pPool && !pPool->GetNumberOfAllocations())
+				{
+					m_uHeapClasses |= 1ULL << i;
+					m_pPools[i] = NULL;
+					cMemoryManager::Get().DestroyPool(pPool);
+				}
+			}
+			m_Lock.Unlock();
+		}
+
+		// Information functions
+		cHeap *GetHeap(void) const { return m_pHeap; }
+		jrs_u32 GetNumPools(void) const { return m_uNumPools; }		// Size classes.  Unused and released classes have a NULL pool.
+		cPool *GetPool(jrs_u32 uIndex) const { return uIndex < m_uNumPools ? m_pPools[uIndex] : NULL; }
+
+	protected:
+
+		virtual void *do_allocate(std::size_t uBytes, std::size_t uAlignment)
+		{
+			jrs_u32 uClass = GetSizeClass(uBytes, uAlignment);
+			cPool *pPool = uClass < MaxPools ? m_pPools[uClass] : NULL;
+			if(!pPool && uClass < MaxPools && !(m_uHeapClasses & (1ULL << uClass)))
+				pPool = CreateClassPool(uClass);
+
+			void *pMemory = pPool ? pPool->AllocateMemory(m_pName) :
+				m_pHeap->AllocateMemory(uBytes, uAlignment > m_pHeap->GetDefaultAlignment() ? (jrs_u32)uAlignment : 0, JRSMEMORYFLAG_NONE, m_pName);
+			return pMemory ? pMemory : MemoryResourceAllocationFailed();
+		}
+
+		virtual void do_deallocate(void *pMemory, std::size_t uBytes, std::size_t uAlignment)
+		{
+			// Only a class with a pool can have handed out pool memory
+			jrs_u32 uClass = GetSizeClass(uBytes, uAlignment);
+			cPool *pPool = uClass < MaxPools ? m_pPools[uClass] : NULL;
+			if(pPool)
+				pPool->FreeMemory(pMemory, m_pName);
+			else
+				m_pHeap->FreeMemory(pMemory, JRSMEMORYFLAG_NONE, m_pName);
+		}
+
+		virtual bool do_is_equal(const std::pmr::memory_resource &rOther) const noexcept
+		{
+			return this == &rOther;
+		}
+	};
+}
+
+#endif	// JRSMEMORY_HASMEMORYRESOURCE
+
+#endif	// _JRSMEMORY_MEMORYRESOURCE_H
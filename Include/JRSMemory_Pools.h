@@ -9,11 +9,17 @@
 #include <JRSMemory_ThreadLocks.h>
 #endif
 
+// For placement new
+#include <new>
+
 // Elephant Namespace
 namespace Elephant
 {
 	class cHeap;
 
+	// Callback for visiting live pool elements.
+	typedef void (*PoolLiveElementCallback)(void *pElement, void *pUserData);
+
 	// Pool details.
 	struct sPoolDetails
 	{
@@ -27,9 +33,14 @@ namespace Elephant
 		jrs_bool bAllowNotEnoughSpaceReturn;			// Allows the heap to return null without checking for failure when memory cant fit. Default false.
 		jrs_bool bEnableErrors;							// Checks for errors.  Default true.
 		jrs_bool bErrorsAsWarnings;						// Disables all errors and turns them into warnings. Default false.
+		jrs_u32 uGrowElements;							// Minimum number of elements added in a new chunk from the pool heap when the pool runs out.  0 by default which disables growing.  cPool only.
+		jrs_bool bReleaseFreeChunks;					// Returns grown chunks to the heap as soon as they have no allocations.  Default false.  cPool only.
+		jrs_u32 uMagazineSize;							// Elements held by each thread cache magazine.  0 by default which disables thread caching.  Needs bThreadSafe.  Ignored with tracking or sentinels.  cPool only.
+		jrs_u32 uMagazineCaches;						// Number of thread caches that threads are hashed to.  Power of 2.  8 by default.  cPool only.
 
 		sPoolDetails() : uAlignment(sizeof(jrs_sizet)), uBufferAlignment(0), pOverrunHeap(NULL), bEnableMemoryTracking(false), bEnableSentinel(false), bThreadSafe(true), 
-			bAllowDestructionWithAllocations(false), bAllowNotEnoughSpaceReturn(false), bEnableErrors(true), bErrorsAsWarnings(false) {}
+			bAllowDestructionWithAllocations(false), bAllowNotEnoughSpaceReturn(false), bEnableErrors(true), bErrorsAsWarnings(false), uGrowElements(0), bReleaseFreeChunks(false),
+			uMagazineSize(0), uMagazineCaches(8) {}
 	};
 
 	class JRSMEMORYDLLEXPORT cPoolBase
@@ -48,7 +59,6 @@ namespace Elephant
 		jrs_u32 m_uPoolID;
 
 		// Functions
-		void StackTrace(jrs_sizet *pCallStack);
 		void SetAllocatedSentinels(jrs_u32 *pStart, jrs_u32 *pEnd);
 		void CheckAllocatedSentinels(jrs_u32 *pStart, jrs_u32 *pEnd);
 		void SetFreeSentinels(jrs_u32 *pStart, jrs_u32 *pEnd);
@@ -62,6 +72,9 @@ namespace Elephant
 
 		// Virtuals
 		virtual void Destroy(void) = 0;
+		virtual void LockAllThreadLocks(void);
+		virtual void UnlockAllThreadLocks(void);
+		virtual void ReinitializeThreadLocks(void);
 
 	public:
 
@@ -95,6 +108,7 @@ namespace Elephant
 
 		virtual jrs_u32 GetTotalAllocations(void) = 0;
 		virtual jrs_u32 GetMaxAllocations(void) = 0;
+		virtual jrs_u32 GetResizeCount(void) = 0;
 
 		virtual jrs_bool HasNameAndCallstackTracing(void) = 0;
 		virtual jrs_bool HasSentinels(void) = 0;
@@ -102,6 +116,31 @@ namespace Elephant
 
 	class JRSMEMORYDLLEXPORT cPool : public cPoolBase
 	{
+		// Header of a grown chunk.  Chunks are found from an element address through the pool's sorted chunk ranges.
+		struct sPoolChunk
+		{
+			cPool *pOwner;					// Pool the chunk belongs to.
+			sPoolChunk *pNext, *pPrev;		// Chunks with free elements are kept before full chunks.
+			jrs_sizet *pFreePtr;			// Free list of the chunk.
+			jrs_u32 uUsedElements;			// Allocations from this chunk.
+		};
+
+		// Magazine of cached element pointers.
+		struct sPoolMagazine
+		{
+			sPoolMagazine *pNext;			// Next magazine in the depot.
+			jrs_u32 uRounds;				// Number of elements held.
+			void *pRounds[1];				// Element pointers.  Sized to the magazine size.
+		};
+
+		// Thread cache.  Threads are hashed to a cache so its lock is normally uncontended.  The previous magazine is always full or empty.
+		struct sPoolCache
+		{
+			JRSMemory_ThreadLock Lock;
+			sPoolMagazine *pLoaded;
+			sPoolMagazine *pPrevious;
+		};
+
 		jrs_sizet *m_pBuffer;			// Main data pointer to the buffer.  Passed in by user.  16byte aligned minimum.
 		jrs_sizet *m_pFreePtr;			// Current free pointer for the next available allocation.
 		jrs_u32 m_uMaxElements;		// Maximum number of elements.
@@ -120,13 +159,46 @@ namespace Elephant
 		jrs_bool m_bEnableOverrun;	// If the memory pool runs out of memory allocate from the heap specified (or just the main heap if null)
 		cHeap *m_pOverrunHeap;		// Overrun heap to use if pool runs out of memory.
 
+		sPoolChunk *m_pChunks;			// Grown chunks.  Chunks with free elements first.
+		sPoolChunk *m_pChunksTail;		// Last chunk in the list.
+		jrs_u32 m_uNumChunks;			// Number of grown chunks.
+		sPoolChunk **m_ppChunkRanges;	// Grown chunks sorted by address.  Protected by m_Mutex.
+		jrs_u32 m_uMaxChunkRanges;		// Capacity of m_ppChunkRanges.
+		jrs_u32 m_uResizeCount;			// Number of chunks added and released.
+		jrs_u32 m_uChunkElements;		// Elements per chunk.  0 if the pool cannot grow.
+		jrs_u32 m_uChunkSize;			// Size of each chunk.
+		jrs_u32 m_uChunkHeaderSize;		// Offset to the first element of a chunk.
+		jrs_bool m_bReleaseFreeChunks;	// Return empty chunks to the heap.
+
+		sPoolCache *m_pCaches;			// Thread caches.  NULL if disabled.
+		jrs_u32 m_uNumCaches;			// Number of thread caches.
+		jrs_u32 m_uMagazineSize;		// Elements per magazine.
+		sPoolMagazine *m_pFullMagazines;	// Depot of full magazines.  Protected by m_Mutex.
+		sPoolMagazine *m_pEmptyMagazines;	// Depot of empty magazines.  Protected by m_Mutex.
+
 		// Friends
 		friend class cHeap;
+		friend class cMemoryManager;
+
+		// Functions
+		void InitializeElements(jrs_sizet *pBuffer, jrs_u32 uNumElements, const jrs_i8 *pName);
+		sPoolChunk *AddChunk(void);
+		void RemoveChunk(sPoolChunk *pChunk);
+		sPoolChunk *FindChunk(void *pMemory) const;
+		void ReportElements(jrs_sizet *pBuffer, jrs_sizet uSize, jrs_sizet *pFreePtr, const jrs_i8 *pLogToFile);
+		void InternalFreeMemory(void *pMemory, const jrs_i8 *pName, jrs_bool bLog);
+		void *AllocateFromMagazine(void);
+		jrs_bool FreeToMagazine(void *pMemory);
+		sPoolMagazine *CreateMagazine(void);
+		sPoolCache *GetCache(void);
 
 	protected:
 		
 		// Functions
 		virtual void Destroy(void);
+		virtual void LockAllThreadLocks(void);
+		virtual void UnlockAllThreadLocks(void);
+		virtual void ReinitializeThreadLocks(void);
 
 	public:
 
@@ -137,9 +209,13 @@ namespace Elephant
 		void *AllocateMemory(void);
 		void *AllocateMemory(const jrs_i8 *pName);
 		void FreeMemory(void *pMemory, const jrs_i8 *pName = 0);
+		void *AllocateMemoryUnshared(void);
+		void FreeMemoryUnshared(void *pMemory);
+		void FlushMagazines(void);
 	
 		// Information functions
 		jrs_u32 GetNumberOfAllocations(void) const;
+		jrs_u32 GetNumberOfCachedElements(void);
 		virtual jrs_bool IsAllocatedFromThisPool(void *pMemory) const;
 		virtual jrs_u32 GetAllocationSize(void) const;
 
@@ -152,7 +228,10 @@ namespace Elephant
 		virtual void ReportAllocationsMemoryOrder(const jrs_i8 *pLogToFile = 0, jrs_bool bLogEachAllocation = false);
 
 		virtual jrs_u32 GetTotalAllocations(void) { return m_uUsedElements; }
-		virtual jrs_u32 GetMaxAllocations(void) { return m_uMaxElements; }
+		virtual jrs_u32 GetMaxAllocations(void) { return m_uMaxElements + (m_uNumChunks * m_uChunkElements); }
+		virtual jrs_u32 GetResizeCount(void) { return m_uResizeCount; }
+
+		jrs_u32 GetNumberOfChunks(void) const { return m_uNumChunks; }
 
 		virtual jrs_bool HasNameAndCallstackTracing(void) { return m_bEnableMemoryTracking; }
 		virtual jrs_bool HasSentinels(void) { return m_bEnableSentinel; }
@@ -172,6 +251,7 @@ namespace Elephant
 		jrs_bool m_bEnableMemoryTracking;	// Enables name and callstack tracking per object.
 		jrs_u32 m_uTrackingOffset;			// Offsets for memory tracking.  Do nothing in master.
 		jrs_u32 m_uUsedElements;			// Amount of used elements from the pool.
+		jrs_u32 *m_pOccupancy;				// One bit per element set while allocated.  Stored after the headers.
 
 		// Friends
 		friend class cHeap;
@@ -196,9 +276,14 @@ namespace Elephant
 		void *AllocateMemory(const jrs_i8 *pName);
 		void FreeMemory(void *pMemory, const jrs_i8 *pName = 0);
 
+		// Live element iteration
+		void ForEachLive(PoolLiveElementCallback pCallback, void *pUserData = 0);
+		void SortFreeList(void);
+
 		// Information functions
 		jrs_u32 GetNumberOfAllocations(void) const;
 		virtual jrs_bool IsAllocatedFromThisPool(void *pMemory) const;
+		jrs_bool IsLive(void *pMemory) const;
 		virtual jrs_u32 GetAllocationSize(void) const;
 
 		virtual void *GetAddress(void);
@@ -211,11 +296,194 @@ namespace Elephant
 
 		virtual jrs_u32 GetTotalAllocations(void) { return m_uUsedElements; }
 		virtual jrs_u32 GetMaxAllocations(void) { return m_uMaxElements; }
+		virtual jrs_u32 GetResizeCount(void) { return 0; }				// Cannot grow
 
 		virtual jrs_bool HasNameAndCallstackTracing(void) { return m_bEnableMemoryTracking; }
 		virtual jrs_bool HasSentinels(void) { return false; }			// No sentinels
 	};
 
+	// Policies for tPool.  bThreadSafe and bTracking map to the sPoolDetails flags but are fixed at compile time.
+	struct sPoolPolicyDefault
+	{
+		enum { bThreadSafe = 1, bTracking = 0 };
+	};
+
+	struct sPoolPolicySingleThread
+	{
+		enum { bThreadSafe = 0, bTracking = 0 };
+	};
+
+	struct sPoolPolicyTracking
+	{
+		enum { bThreadSafe = 1, bTracking = 1 };
+	};
+
+	// Typed pool.  Wraps a cPool sized and aligned for T.  Single threaded policies use the pool's unshared entry points which 
+	// take the free list directly when the pool was really created without locks or thread caches.
+	template<class T, class Policy = sPoolPolicyDefault>
+	class tPool
+	{
+		struct sAlignOf { jrs_i8 c; T t; };
+
+		cPool *m_pPool;
+
+		// Non copyable
+		tPool(const tPool &);
+		tPool &operator=(const tPool &);
+
+	public:
+
+		enum 
+		{ 
+			TypeAlignment = sizeof(sAlignOf) - sizeof(T),
+			Alignment = TypeAlignment < sizeof(jrs_sizet) ? sizeof(jrs_sizet) : TypeAlignment,
+			ElementSize = (sizeof(T) + (Alignment - 1)) & ~(Alignment - 1)
+		};
+
+		tPool() : m_pPool(NULL) {}
+		~tPool() { Release(); }
+
+		//  Description:
+		//      Creates the pool.  The element size, alignment, thread safety and tracking come from T and the Policy and override pDetails.
+		//  See Also:
+		//      Release
+		//  Arguments:
+		//      uMaxElements - Maximum number of elements in the main buffer.
+		//      pName - Name of the pool.
+		//		pHeap - Heap to take the pool from.  NULL for the default heap.
+		//		pDetails - Pool details.  NULL for the defaults.
+		//  Return Value:
+		//      TRUE if the pool was created.  FALSE otherwise.
+		//  Summary:
+		//      Creates the pool.
+		jrs_bool Initialize(jrs_u32 uMaxElements, const jrs_i8 *pName, cHeap *pHeap = NULL, const sPoolDetails *pDetails = NULL)
+		{
+			sPoolDetails details;
+			if(pDetails)
+				details = *pDetails;
+			details.uAlignment = Alignment;
+
+			// Heaps align to at least their default so only ask for larger
+			cHeap *pPoolHeap = pHeap ? pHeap : cMemoryManager::Get().GetDefaultHeap();
+			if(pPoolHeap && Alignment > pPoolHeap->GetDefaultAlignment() && Alignment > details.uBufferAlignment)
+				details.uBufferAlignment = Alignment;
+			details.bThreadSafe = Policy::bThreadSafe ? true : false;
+			details.bEnableMemoryTracking = Policy::bTracking ? true : false;
+			m_pPool = cMemoryManager::Get().CreatePool(ElementSize, uMaxElements, pName, &details, pHeap);
+			return m_pPool ? TRUE : FALSE;
+		}
+
+		//  Description:
+		//      Destroys the pool.  Any T still allocated is not destructed.
+		//  See Also:
+		//      Initialize
+		//  Arguments:
+		//      None
+		//  Return Value:
+		//      None
+		//  Summary:
+		//      Destroys the pool.
+		void Release(void)
+		{
+			if(m_pPool)
+				cMemoryManager::Get().DestroyPool(m_pPool);
+			m_pPool = NULL;
+		}
+
+		//  Description:
+		//      Allocates uninitialized memory for one T.
+		//  See Also:
+		//      FreeMemory, Create
+		//  Arguments:
+		//      None
+		//  Return Value:
+		//      Memory for one T.  NULL if there is no space.
+		//  Summary:
+		//      Allocates uninitialized memory for one T.
+		void *AllocateMemory(void)
+		{
+			return Policy::bThreadSafe ? m_pPool->AllocateMemory() : m_pPool->AllocateMemoryUnshared();
+		}
+
+		//  Description:
+		//      Frees memory allocated with AllocateMemory.
+		//  See Also:
+		//      AllocateMemory, Destroy
+		//  Arguments:
+		//      pMemory - Memory to free.
+		//  Return Value:
+		//      None
+		//  Summary:
+		//      Frees memory allocated with AllocateMemory.
+		void FreeMemory(void *pMemory)
+		{
+			if(Policy::bThreadSafe)
+				m_pPool->FreeMemory(pMemory);
+			else
+				m_pPool->FreeMemoryUnshared(pMemory);
+		}
+
+		//  Description:
+		//      Allocates and default constructs a T.
+		//  See Also:
+		//      Destroy
+		//  Arguments:
+		//      None
+		//  Return Value:
+		//      Constructed T.  NULL if there is no space.
+		//  Summary:
+		//      Allocates and constructs a T.
+		T *Create(void)
+		{
+			void *pMemory = AllocateMemory();
+			return pMemory ? new(pMemory) T() : NULL;
+		}
+
+		template<class A1>
+		T *Create(const A1 &a1)
+		{
+			void *pMemory = AllocateMemory();
+			return pMemory ? new(pMemory) T(a1) : NULL;
+		}
+
+		template<class A1, class A2>
+		T *Create(const A1 &a1, const A2 &a2)
+		{
+			void *pMemory = AllocateMemory();
+			return pMemory ? new(pMemory) T(a1, a2) : NULL;
+		}
+
+		template<class A1, class A2, class A3>
+		T *Create(const A1 &a1, const A2 &a2, const A3 &a3)
+		{
+			void *pMemory = AllocateMemory();
+			return pMemory ? new(pMemory) T(a1, a2, a3) : NULL;
+		}
+
+		//  Description:
+		//      Destructs a T made by Create and frees its memory.  NULL is ignored.
+		//  See Also:
+		//      Create
+		//  Arguments:
+		//      pObject - Object to destroy.
+		//  Return Value:
+		//      None
+		//  Summary:
+		//      Destructs and frees a T.
+		void Destroy(T *pObject)
+		{
+			if(!pObject)
+				return;
+			pObject->~T();
+			FreeMemory(pObject);
+		}
+
+		// Information functions
+		cPool *GetPool(void) const { return m_pPool; }
+		jrs_u32 GetNumberOfAllocations(void) const { return m_pPool->GetNumberOfAllocations(); }
+		jrs_bool IsAllocatedFromThisPool(void *pMemory) const { return m_pPool->IsAllocatedFromThisPool(pMemory); }
+	};
+
 }
 
 using namespace Elephant;
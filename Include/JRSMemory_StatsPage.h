@@ -0,0 +1,142 @@
+/* 
+(C) Copyright 2010 Jury Rig Software Limited. All Rights Reserved. 
+
+Use of this software is subject to the terms of an end user license agreement.
+This software contains code, techniques and know-how which is confidential and proprietary to Jury Rig Software Ltd.
+Not for disclosure or distribution without Jury Rig Software Ltd's prior written consent. 
+*/
+
+#ifndef _JRSMEMORY_STATSPAGE_H
+#define _JRSMEMORY_STATSPAGE_H
+
+#ifndef _JRSCORETYPES_H
+#include <JRSCoreTypes.h>
+#endif
+
+#ifndef _JRSMEMORY_THREADLOCKS_H
+#include <JRSMemory_ThreadLocks.h>
+#endif
+
+#include <string.h>
+
+// Shared memory statistics page.  Published by cMemoryManager when InitializeStatsPage is called so other processes can monitor the
+// heaps without calling into the process or connecting LiveView.  Everything is in the byte order of the machine that wrote it.
+//
+// The page is a sStatsPageHeader followed by uMaxEntries sStatsPageEntry's starting uHeaderSize bytes in.  There is one entry for every
+// heap, every pool attached to a heap and every non intrusive heap.  Entries past uMaxEntries are dropped and StatsPageFlag_Truncated is
+// set.
+//
+// The publisher makes uSequence odd, writes the entries and header and then makes it even again.  Readers copy the page out and only use
+// the copy if uSequence was even and unchanged across it.  StatsPage_Read does this.  Readers never write to the page.
+
+// Elephant Namespace
+namespace Elephant
+{
+	// Page identifiers
+	static const jrs_u32 StatsPage_Magic = 0x54534c45;					// 'ELST'
+	static const jrs_u32 StatsPage_Version = 1;
+
+	// Size of the name in each entry including the terminator.
+	static const jrs_u32 StatsPage_MaxName = 32;
+
+	// What an entry describes.  Heaps and non intrusive heaps share ids.  Pools have their own.
+	enum eStatsPageKind
+	{
+		eStatsPageKind_Heap,
+		eStatsPageKind_NonIntrusiveHeap,
+		eStatsPageKind_Pool
+	};
+
+	// Header flags
+	static const jrs_u32 StatsPageFlag_Truncated = 1 << 0;				// There were more entries than uMaxEntries.
+	static const jrs_u32 StatsPageFlag_LockStatistics = 1 << 1;			// At least one heap has latency statistics enabled.
+
+	// Start of the page.
+	struct sStatsPageHeader
+	{
+		jrs_u32 uMagic;							// StatsPage_Magic
+		jrs_u32 uVersion;						// StatsPage_Version
+		jrs_u32 uHeaderSize;					// Offset of the first entry.
+		jrs_u32 uEntrySize;						// sizeof(sStatsPageEntry) of the writer.
+		jrs_u32 uMaxEntries;
+		volatile jrs_u32 uSequence;				// Odd while the page is being written.
+		jrs_u32 uNumEntries;
+		jrs_u32 uFlags;							// StatsPageFlag_ values.
+		jrs_u32 uUpdateMS;						// Update period.  0 if only updated by cMemoryManager::UpdateStatsPage.
+		jrs_u32 uPad;
+		jrs_u64 uUpdateCount;					// Number of updates published.
+		jrs_u64 uTicks;							// Ticks of the last update.
+		jrs_u64 uTicksPerSecond;				// 0 if the platform has no tick counter.
+	};
+
+	// One per heap, pool and non intrusive heap.  Sizes are in bytes.
+	struct sStatsPageEntry
+	{
+		jrs_u32 uId;							// Heap or pool unique id.
+		jrs_u32 uKind;							// eStatsPageKind
+		jrs_u32 uParentId;						// Id of the heap a pool is attached to.  0 for heaps.
+		jrs_u32 uResizeCount;					// Times a heap has grown or shrunk or a pool added or released a chunk.
+		jrs_u64 uSize;
+		jrs_u64 uUsed;							// Allocated bytes.  Element size multiples for pools.
+		jrs_u64 uPeakUsed;
+		jrs_u64 uCount;							// Live allocations.
+		jrs_u64 uPeakCount;						// Pool peaks are the highest value seen by the publisher.
+		jrs_u64 uFree;
+		jrs_u64 uLargestFree;					// Largest allocation that would currently fit.
+		jrs_u64 uLockCount;						// Heap lock acquisitions.  0 unless the heap has latency statistics enabled.
+		jrs_u64 uLockWaitNS;					// Total time spent waiting for the heap lock.
+		jrs_u64 uLockWaitMaxNS;					// Longest wait for the heap lock.
+		jrs_i8 Name[StatsPage_MaxName];
+	};
+
+	//  Description:
+	//		Copies a consistent view of a statistics page.  Retries while the publisher is part way through an update.  Does not lock or
+	//		write to the page.
+	//  See Also:
+	//		sStatsPageHeader
+	//  Arguments:
+	//		pPage - Start of the mapped page.
+	//		pHeader - Receives the header.  uNumEntries is the number of entries copied.
+	//		pEntries - Receives the entries.
+	//		uMaxEntries - Number of entries pEntries can hold.
+	//		uRetries - Number of attempts before giving up.  Default 1000.
+	//  Return Value:
+	//      TRUE if a consistent copy was made.
+	//		FALSE if the page is not a statistics page of this version or was being written on every attempt.
+	//  Summary:
+	//		Copies a consistent view of a statistics page.
+	inline jrs_bool StatsPage_Read(const void *pPage, sStatsPageHeader *pHeader, sStatsPageEntry *pEntries, jrs_u32 uMaxEntries, jrs_u32 uRetries = 1000)
+	{
+		const sStatsPageHeader *pShared = (const sStatsPageHeader *)pPage;
+		if(pShared->uMagic != StatsPage_Magic || pShared->uVersion != StatsPage_Version || pShared->uEntrySize != sizeof(sStatsPageEntry))
+			return false;
+
+		const sStatsPageEntry *pSharedEntries = (const sStatsPageEntry *)((const jrs_i8 *)pPage + pShared->uHeaderSize);
+		for(jrs_u32 uTry = 0; uTry < uRetries; uTry++)
+		{
+			jrs_u32 uSequence = pShared->uSequence;
+			JRSMemoryBarrier();
+			if(uSequence & 1)
+				continue;
+
+			memcpy(pHeader, (const void *)pShared, sizeof(sStatsPageHeader));
+			jrs_u32 uNumEntries = pHeader->uNumEntries;
+			if(uNumEntries > pHeader->uMaxEntries)
+				uNumEntries = pHeader->uMaxEntries;
+			if(uNumEntries > uMaxEntries)
+				uNumEntries = uMaxEntries;
+			memcpy(pEntries, pSharedEntries, uNumEntries * sizeof(sStatsPageEntry));
+
+			JRSMemoryBarrier();
+			if(pShared->uSequence == uSequence)
+			{
+				pHeader->uNumEntries = uNumEntries;
+				return true;
+			}
+		}
+
+		return false;
+	}
+}
+
+#endif	// _JRSMEMORY_STATSPAGE_H
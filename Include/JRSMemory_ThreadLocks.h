@@ -77,4 +77,30 @@ public:
 JRSMEMORYALIGNPOST(128)
 ;
 
+// Full memory barrier.  Orders the sequence counters used by readers that do not take a lock.
+inline void JRSMemoryBarrier(void)
+{
+#if defined(JRSMEMORYMICROSOFTPLATFORMS)
+	MemoryBarrier();
+#elif defined(__GNUC__) || defined(__clang__)
+	__sync_synchronize();
+#endif
+}
+
+// Atomically replaces *pDest with uExchange if it holds uCompare.  Returns TRUE if it was replaced.  Platforms without an atomic
+// compare and swap run Elephant on one thread so a plain compare is enough.
+inline jrs_bool JRSMemoryCompareAndSwap(volatile jrs_u32 *pDest, jrs_u32 uCompare, jrs_u32 uExchange)
+{
+#if defined(JRSMEMORYMICROSOFTPLATFORMS)
+	return InterlockedCompareExchange((volatile LONG *)pDest, (LONG)uExchange, (LONG)uCompare) == (LONG)uCompare;
+#elif defined(__GNUC__) || defined(__clang__)
+	return __sync_bool_compare_and_swap(pDest, uCompare, uExchange);
+#else
+	if(*pDest != uCompare)
+		return FALSE;
+	*pDest = uExchange;
+	return TRUE;
+#endif
+}
+
 #endif
@@ -15,6 +15,8 @@ CINCLUDES = -IInclude
 CCCOMPFLAGS = -g
 
 SRC_FILES = $(wildcard Source/*.cpp Source/Linux/*.cpp)
+PRELOAD_SRC_FILES = $(SRC_FILES) Source/Linux/Preload/JRSMemory_MallocPreload.cpp
+REPLAY_SRC_FILES = $(SRC_FILES) Source/Linux/Replay/JRSMemory_Replay.cpp
 OBJ_X86_FILES = $(addprefix $(X86OUTPATH)/, $(notdir $(SRC_FILES:%.cpp=%.o)))
 OBJ_X64_FILES = $(addprefix $(X64OUTPATH)/, $(notdir $(SRC_FILES:%.cpp=%.o)))
 
@@ -86,6 +88,18 @@ JRSMemory_Master:	MakeDir
 	$(ARX86) crs $(X86LIBPATH)/libJRSMemory_Master.a $(OBJ_X86_FILES)
 	$(ARX86) crs $(X64LIBPATH)/libJRSMemory_Master.a $(OBJ_X64_FILES)
 	
+# Malloc replacement for LD_PRELOAD.  64bit only.  Elephant symbols are hidden so programs that link Elephant themselves are not affected.
+JRSMemory_MallocPreload:	MakeDir
+	$(CCX86) -shared -fPIC -fvisibility=hidden $(CCCOMPFLAGS) $(CPU_X64) -fno-exceptions -fno-rtti $(CINCLUDES) -DMEMORYMANAGER_MINIMAL -fomit-frame-pointer -O2 $(PRELOAD_SRC_FILES) -o $(X64LIBPATH)/libelephant_malloc.so -lpthread -ldl -lrt
+
+# Replays compact continuous dumps against Elephant or glibc.  64bit only.  Not MINIMAL as the heap statistics are reported.
+JRSMemory_Replay:	MakeDir
+	$(CCX86) $(CCCOMPFLAGS) $(CPU_X64) -fno-exceptions -fno-rtti $(CINCLUDES) -fomit-frame-pointer -O2 $(REPLAY_SRC_FILES) -o $(X64LIBPATH)/elephant_replay -lpthread -lrt
+
+# Prints the shared memory statistics page of a running process.  64bit only.  Only uses JRSMemory_StatsPage.h so no library sources.
+JRSMemory_StatsReader:	MakeDir
+	$(CCX86) $(CCCOMPFLAGS) $(CPU_X64) -fno-exceptions -fno-rtti $(CINCLUDES) -O2 Source/Linux/StatsReader/JRSMemory_StatsReader.cpp -o $(X64LIBPATH)/elephant_stats -lrt
+	
 # Clean it all
 clean:
 	rm -r -f $(X86OUTPATH)
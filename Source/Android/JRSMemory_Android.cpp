@@ -9,6 +9,7 @@ Not for disclosure or distribution without Jury Rig Software Ltd's prior written
 #include <string.h>
 #include <unwind.h>
 #include <dlfcn.h> 
+#include <fcntl.h>
 
 #include <JRSMemory.h>
 #include <JRSMemory_Pools.h>
@@ -28,6 +29,11 @@ namespace Elephant
 	// Forward declarations to avoid compiler errors on some platforms
 	void *MemoryManagerDefaultSystemAllocator(jrs_u64 uSize, void *pExtMemoryPtr);
 	void MemoryManagerDefaultSystemFree(void *pFree, jrs_u64 uSize);
+	jrs_bool MemoryManagerDefaultSystemRelease(void *pAddress, jrs_u64 uSize);
+	jrs_u32 MemoryManagerDefaultSystemZeroFlags(void);
+	void MemoryManagerPlatformWriteModuleMap(MemoryManagerOutputToFile Output, const jrs_i8 *pFilePathAndName);
+	void *MemoryManagerPlatformCreateSharedPage(const jrs_i8 *pName, jrs_sizet uSize);
+	void MemoryManagerPlatformDestroySharedPage(const jrs_i8 *pName, void *pPage, jrs_sizet uSize);
 	void MemoryManagerPlatformInit(void);
 	void MemoryManagerPlatformDestroy(void);
 	jrs_sizet MemoryManagerPlatformAddressToBaseAddress(jrs_sizet uAddress);
@@ -54,6 +60,42 @@ namespace Elephant
 		free(pFree);
 	}
 
+	jrs_bool MemoryManagerDefaultSystemRelease(void *pAddress, jrs_u64 uSize)
+	{
+		// Not supported.  Memory stays resident.
+		return FALSE;
+	}
+
+	jrs_u32 MemoryManagerDefaultSystemZeroFlags(void)
+	{
+		// Memory is not known to be zero filled.
+		return JRSMEMORYZEROFLAG_NONE;
+	}
+
+	void MemoryManagerPlatformWriteModuleMap(MemoryManagerOutputToFile Output, const jrs_i8 *pFilePathAndName)
+	{
+		// pprof reads the mapped libraries in the /proc/self/maps layout so the file is copied as is.
+		int iFile = open("/proc/self/maps", O_RDONLY);
+		if(iFile < 0)
+			return;
+
+		jrs_i8 Buffer[4096];
+		ssize_t iRead;
+		while((iRead = read(iFile, Buffer, sizeof(Buffer))) > 0)
+			Output(Buffer, (int)iRead, pFilePathAndName, true);
+		close(iFile);
+	}
+
+	void *MemoryManagerPlatformCreateSharedPage(const jrs_i8 *pName, jrs_sizet uSize)
+	{
+		// No shared memory.  The statistics page is not available.
+		return NULL;
+	}
+
+	void MemoryManagerPlatformDestroySharedPage(const jrs_i8 *pName, void *pPage, jrs_sizet uSize)
+	{
+	}
+
 	jrs_sizet MemoryManagerSystemPageSize(void)
 	{
 		return 1024 * 64;
@@ -111,7 +153,34 @@ namespace Elephant
 		memset(stack.pCallstack, 0, 32 * sizeof(void *));
 		stack.uCount = 0;
 		stack.uSize = 32;
+
+#ifdef MEMORYMANAGER_FRAMEPOINTERS
+		// Follow the saved frame pointers.  Much cheaper than unwinding but only valid while the code is built with frame pointers.  The
+		// walk stops at a link that does not point a little further up the stack, usually code built without frame pointers, and unwinds
+		// instead if that left it short of the requested frames.  Frame 0 is this function.
+		jrs_sizet *pFrame = (jrs_sizet *)__builtin_frame_address(0);
+		stack.uCount = 1;
+		while(pFrame && stack.uCount < stack.uSize && stack.uCount < uCallStackCount)
+		{
+			jrs_sizet *pNext = (jrs_sizet *)pFrame[0];
+			if(!pFrame[1])
+				break;
+			stack.pCallstack[stack.uCount++] = (void *)pFrame[1];
+
+			if(pNext && (pNext <= pFrame || (jrs_sizet)pNext - (jrs_sizet)pFrame > 0x10000 || ((jrs_sizet)pNext & (sizeof(jrs_sizet) - 1))))
+				break;
+			pFrame = pNext;
+		}
+
+		if(stack.uCount < stack.uSize && stack.uCount < uCallStackCount)
+		{
+			memset(stack.pCallstack, 0, 32 * sizeof(void *));
+			stack.uCount = 0;
+			_Unwind_Backtrace(ArmTracFunc, (void *)&stack); 
+		}
+#else
 		_Unwind_Backtrace(ArmTracFunc, (void *)&stack); 
+#endif
 
         for(jrs_i32 i = uCallstackDepth; i < uCallStackCount && i < stack.uCount; i++)
         {
@@ -119,21 +188,6 @@ namespace Elephant
         }
 	}
 
-	void cPoolBase::StackTrace(jrs_sizet *pCallStack)
-	{
-		void* callstack[32];
-		sLocalStack stack;
-		memset(stack.pCallstack, 0, 32 * sizeof(void *));
-		stack.uCount = 0;
-		stack.uSize = 32;
-		_Unwind_Backtrace(ArmTracFunc, (void *)&stack); 
-
-		for(jrs_i32 i = 3; i < JRSMEMORY_CALLSTACKDEPTH && i < stack.uCount; i++)
-		{
-			pCallStack[i - 3] = (jrs_sizet)stack.pCallstack[i]; 
-		}
-	}
-
 	// Socket wrappers per platform.  This doesn't have to be sockets but must function the same.  Although we call it a socket it could just be an id that is passed around.
 
 	//  Description:
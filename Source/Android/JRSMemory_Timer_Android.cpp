@@ -6,6 +6,7 @@ This software contains code, techniques and know-how which is confidential and p
 Not for disclosure or distribution without Jury Rig Software Ltd's prior written consent. 
 */
 #include <sys/time.h>
+#include <time.h>
 #include <stdio.h>
 #include "../JRSMemory_Timer.h"
 
@@ -63,4 +64,19 @@ namespace Elephant
 
 		return m_ElapsedTimeMSTotal;
 	}
+
+	namespace JRSTimer
+	{
+		jrs_u64 GetTicks(void)
+		{
+			timespec CurrentTime;
+			clock_gettime(CLOCK_MONOTONIC, &CurrentTime);
+			return (jrs_u64)CurrentTime.tv_sec * 1000000000ULL + (jrs_u64)CurrentTime.tv_nsec;
+		}
+
+		jrs_u64 GetTicksPerSecond(void)
+		{
+			return 1000000000ULL;
+		}
+	}
 }
\ No newline at end of file
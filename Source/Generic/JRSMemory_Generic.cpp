@@ -25,6 +25,11 @@ namespace Elephant
 	// Forward declarations to avoid compiler errors on some platforms
 	void *MemoryManagerDefaultSystemAllocator(jrs_u64 uSize, void *pExtMemoryPtr);
 	void MemoryManagerDefaultSystemFree(void *pFree, jrs_u64 uSize);
+	jrs_bool MemoryManagerDefaultSystemRelease(void *pAddress, jrs_u64 uSize);
+	jrs_u32 MemoryManagerDefaultSystemZeroFlags(void);
+	void MemoryManagerPlatformWriteModuleMap(MemoryManagerOutputToFile Output, const jrs_i8 *pFilePathAndName);
+	void *MemoryManagerPlatformCreateSharedPage(const jrs_i8 *pName, jrs_sizet uSize);
+	void MemoryManagerPlatformDestroySharedPage(const jrs_i8 *pName, void *pPage, jrs_sizet uSize);
 	void MemoryManagerPlatformInit(void);
 	void MemoryManagerPlatformDestroy(void);
 	jrs_sizet MemoryManagerPlatformAddressToBaseAddress(jrs_sizet uAddress);
@@ -49,6 +54,33 @@ namespace Elephant
 		free(pFree);
 	}
 
+	jrs_bool MemoryManagerDefaultSystemRelease(void *pAddress, jrs_u64 uSize)
+	{
+		// Not supported.  Memory stays resident.
+		return FALSE;
+	}
+
+	jrs_u32 MemoryManagerDefaultSystemZeroFlags(void)
+	{
+		// Memory is not known to be zero filled.
+		return JRSMEMORYZEROFLAG_NONE;
+	}
+
+	void MemoryManagerPlatformWriteModuleMap(MemoryManagerOutputToFile Output, const jrs_i8 *pFilePathAndName)
+	{
+		// No module map.  Addresses are left for the tools to resolve against the executable.
+	}
+
+	void *MemoryManagerPlatformCreateSharedPage(const jrs_i8 *pName, jrs_sizet uSize)
+	{
+		// No shared memory.  The statistics page is not available.
+		return NULL;
+	}
+
+	void MemoryManagerPlatformDestroySharedPage(const jrs_i8 *pName, void *pPage, jrs_sizet uSize)
+	{
+	}
+
 	jrs_sizet MemoryManagerSystemPageSize(void)
 	{
 		return 1024 * 64;
@@ -78,11 +110,6 @@ namespace Elephant
 		memset(pCallStack, 0, uCallStackCount * sizeof(jrs_sizet));
 	}
 
-	void cPoolBase::StackTrace(jrs_sizet *pCallStack)
-	{
-		memset(pCallStack, 0, JRSMEMORY_CALLSTACKDEPTH * sizeof(jrs_sizet));
-	}
-
 	// Socket wrappers per platform.  This doesn't have to be sockets but must function the same.  Although we call it a socket it could just be an id that is passed around.
 
 	//  Description:
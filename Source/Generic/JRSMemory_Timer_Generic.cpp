@@ -64,4 +64,18 @@ namespace Elephant
 
 		return m_ElapsedTimeMSTotal;
 	}
+
+	namespace JRSTimer
+	{
+		// No counter on this platform.  Latency statistics stay disabled.
+		jrs_u64 GetTicks(void)
+		{
+			return 0;
+		}
+
+		jrs_u64 GetTicksPerSecond(void)
+		{
+			return 0;
+		}
+	}
 }
\ No newline at end of file
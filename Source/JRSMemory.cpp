@@ -3,12 +3,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <stddef.h>
+#include <math.h>
 
 #include <JRSMemory.h>
 #include <JRSMemory_Thread.h>
 #include <JRSMemory_Pools.h>
+#include <JRSMemory_ContinuousDump.h>
+#include <JRSMemory_StatsPage.h>
 #include "JRSMemory_ErrorCodes.h"
 #include "JRSMemory_Internal.h"
+#include "JRSMemory_Timer.h"
 
 // Extern the main thread
 extern cJRSThread::jrs_threadout JRSMemory_LiveViewThread(cJRSThread::jrs_threadin pArg);
@@ -40,11 +45,192 @@ namespace Elephant
 	MemoryManagerDefaultAllocator cMemoryManager::m_MemoryManagerDefaultAllocator = MemoryManagerDefaultSystemAllocator;
 	MemoryManagerDefaultFree cMemoryManager::m_MemoryManagerDefaultFree = MemoryManagerDefaultSystemFree;
 	MemoryManagerDefaultSystemPageSize cMemoryManager::m_MemoryManagerDefaultSystemPageSize = MemoryManagerSystemPageSize;
+	MemoryManagerDefaultRelease cMemoryManager::m_MemoryManagerDefaultSystemRelease = MemoryManagerDefaultSystemRelease;
+	jrs_u32 cMemoryManager::m_uMemoryManagerDefaultZeroFlags = JRSMEMORYZEROFLAG_NONE;
 	MemoryManagerUserDetails cMemoryManager::m_MemoryManagerUserDetails = 0;
 
 	// Small heap size.
 	jrs_sizet cMemoryManager::m_uSmallHeapSize = 0;
 
+	// Destroy Elephant when the memory manager is destructed.
+	jrs_bool cMemoryManager::m_bDestroyOnExit = true;
+	jrs_u64 cMemoryManager::m_uRegionCacheMaxSize = 0;
+	jrs_bool cMemoryManager::m_bRegionCacheRelease = true;
+
+	// Sampling heap profiler.  0 interval disables it.
+	jrs_u64 cMemoryManager::m_uSampleInterval = 0;
+	jrs_u32 cMemoryManager::m_uMaxSamples = 16384;
+
+	// Stack table size.
+	jrs_u32 cMemoryManager::m_uMaxStacks = 65536;
+
+	// Compact continuous dump.  0 chunk size writes the CSV dump.
+	jrs_u32 cMemoryManager::m_uCompactDumpChunkSize = 0;
+	jrs_u32 cMemoryManager::m_uCompactDumpChunks = 16;
+
+	// Shared memory statistics page.  An empty name disables it.
+	jrs_i8 cMemoryManager::m_StatsPageName[64] = { 0 };
+	jrs_u32 cMemoryManager::m_uStatsPageUpdateMS = 1000;
+	jrs_u32 cMemoryManager::m_uStatsPageMaxEntries = 256;
+
+	// The sampler countdowns are split into shards picked by thread id like the heap latency statistics.  Two threads can land on the same
+	// shard and very occasionally lose a count which only nudges the sampling rate.  Frees test a counting filter of sampled addresses
+	// before taking the lock so frees of unsampled memory stay lock free.
+	static const jrs_u32 MemoryManager_SamplerShardBits = 4;
+	static const jrs_u32 MemoryManager_SamplerShards = 1 << MemoryManager_SamplerShardBits;
+	static const jrs_u32 MemoryManager_SamplerFilterBits = 16;
+	static const jrs_u32 MemoryManager_SamplerNone = 0xffffffff;
+
+	struct cMemoryManager::sSampler
+	{
+		struct sShard
+		{
+			jrs_i64 iBytesUntilSample;
+			jrs_u64 uRandom;
+			jrs_u8 uPad[112];					// Keep shards on their own cache lines
+		};
+
+		struct sSample
+		{
+			void *pMemory;
+			jrs_sizet uSize;
+			jrs_u32 uSite;
+			jrs_u32 uNext;						// Next sample in the hash chain or free list
+		};
+
+		struct sSite
+		{
+			jrs_u64 uAllocCount;				// Every sample taken at this site
+			jrs_u64 uAllocSize;
+			jrs_u64 uLiveCount;					// Samples not yet freed
+			jrs_u64 uLiveSize;
+			jrs_u32 uStackId;
+			jrs_u32 uNext;						// Next site in the hash chain
+		};
+
+		sShard Shards[MemoryManager_SamplerShards];
+		volatile jrs_u8 uFilter[1 << MemoryManager_SamplerFilterBits];	// Saturating count of samples per address hash
+		jrs_u64 uBlockSize;
+		jrs_u64 uInterval;
+		jrs_u64 uDropped;						// Samples lost to full tables
+		jrs_u32 uMaxSamples;
+		jrs_u32 uHashMask;
+		jrs_u32 uFreeSample;
+		jrs_u32 uNumSites;
+		sSample *pSamples;
+		sSite *pSites;
+		jrs_u32 *pSampleHash;
+		jrs_u32 *pSiteHash;
+	};
+
+	// The stack table is an open addressed hash set of call stacks that is only ever added to.  Threads claim an empty entry with a
+	// compare and swap, write the frames and then publish the hash so lookups never lock.  A block header stores the entry index + 1.
+	static const jrs_u32 MemoryManager_StackTableProbes = 64;
+	static const jrs_u32 MemoryManager_StackTableEmpty = 0;
+	static const jrs_u32 MemoryManager_StackTableWriting = 1;
+	static const jrs_u32 MemoryManager_StackTableWriteWaits = 1024;		// Reads of an entry being written before probing past it.
+	static const jrs_sizet g_NoCallStack[MemoryManager_StackTableDepth] = { 0 };
+
+	// Heap headers are sent to the viewer with the stack id expanded back to the JRSMEMORY_CALLSTACKDEPTH frames it refers to.
+#if !defined(MEMORYMANAGER_MINIMAL) && defined(MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS)
+	static const jrs_u32 MemoryManager_WireStackGrowth = (JRSMEMORY_CALLSTACKDEPTH * sizeof(jrs_sizet)) - (4 * sizeof(jrs_u32));
+#else
+	static const jrs_u32 MemoryManager_WireStackGrowth = 0;
+#endif
+
+	struct cMemoryManager::sStackTable
+	{
+		struct sEntry
+		{
+			volatile jrs_u32 uHash;				// Empty, writing or the hash of the published stack
+			jrs_u32 uCount;
+			jrs_sizet uCallStack[MemoryManager_StackTableDepth];
+		};
+
+		jrs_u64 uBlockSize;
+		jrs_u32 uMask;
+		jrs_u32 uPad;
+		sEntry Entries[1];
+	};
+
+	// The compact continuous dump encodes records into chunks under m_ContThreadLock.  Full chunks are queued for the writer thread which
+	// compresses them and passes them to the file callback.  When the writer falls behind another chunk is allocated rather than waiting as
+	// the logging thread can hold heap locks the file callback needs.  For the same reason the logging side never waits for the writer.
+	// The file header goes out with the first chunk of a file and the index and footer with the last.  The queues are protected by
+	// m_ContDumpLock which is never held while encoding, compressing or writing.
+	static const jrs_u32 MemoryManager_CompactDumpRecordMax = 256;			// Largest encoded record
+	static const jrs_u32 MemoryManager_CompactDumpHashBits = 12;
+	static const jrs_u32 MemoryManager_CompactDumpNoId = 0xffffffff;
+	static const jrs_u32 MemoryManager_CompactDumpFirstInFile = 1 << 0;	// Writer writes the file header before the chunk.
+	static const jrs_u32 MemoryManager_CompactDumpLastInFile = 1 << 1;	// Writer writes the index and footer after the chunk.
+
+	struct cMemoryManager::sCompactDump
+	{
+		struct sChunk
+		{
+			sChunk *pNext;
+			jrs_u32 uUsed;
+			jrs_u32 uNumRecords;
+			jrs_u64 uFirstTicks;
+			jrs_u64 uStartTicks;				// File start ticks for the header.
+			jrs_u32 uFlags;						// MemoryManager_CompactDump flags.  May be set on a chunk with no records.
+		};										// Followed by the chunk data.
+
+		jrs_u64 uBlockSize;
+		jrs_u32 uChunkSize;
+		volatile jrs_bool bRunning;				// Writer thread keeps going while set.
+		jrs_bool bStarted;						// A file has been started and not finished.
+		jrs_bool bNewFile;						// The next chunk is the first of the file.
+		volatile jrs_sizet uWriterThread;
+
+		// Logging side.  Owned by m_ContThreadLock.
+		sChunk *pFill;
+		jrs_u64 uLastTicks;
+		jrs_u64 uLastAddress;
+		jrs_u64 uLastThread;
+		jrs_u32 uLastId;
+		jrs_u32 uStackBits;
+		jrs_u32 *pStacksSent;					// One bit per stack table entry defined in the chunk being filled.  Cleared when it is queued.
+		jrs_u64 uFileStartTicks;
+
+		// Owned by m_ContDumpLock.
+		sChunk *pFull;							// Oldest full chunk.
+		sChunk *pFullTail;
+		sChunk *pFree;
+		jrs_u32 uNumChunks;
+
+		// Writer side.
+		jrs_u64 uFileOffset;
+		sContinuousDumpIndexEntry *pIndex;
+		jrs_u32 uNumIndex;
+		jrs_u32 uMaxIndex;
+		jrs_u32 *pHashTable;
+		jrs_u8 *pOutput;						// Chunk header and compressed data.
+	};
+
+	// The statistics page is gathered into a private copy one heap at a time holding only that heap's lock.  The copy is then written to
+	// the shared page inside the sequence so readers see a consistent view without locking.  Heaps are found from a snapshot of the
+	// registries taken under m_MMThreadLock and skipped if their slot was released before their lock was taken.
+	struct cMemoryManager::sStatsPage
+	{
+		struct sHeapRef
+		{
+			void *pHeap;
+			jrs_u32 uRegistry;
+			jrs_u32 uSlot;
+		};
+
+		sStatsPageHeader *pHeader;				// Shared page
+		sStatsPageEntry *pEntries;				// Entries in the shared page
+		jrs_sizet uPageSize;
+		jrs_u64 uBlockSize;
+		sStatsPageEntry *pGather;				// Private copy the next update is built in
+		sHeapRef *pHeaps;						// Registry snapshot
+		jrs_u32 uMaxEntries;
+		jrs_u32 uUpdateMS;
+		volatile jrs_bool bRunning;				// Publisher thread keeps going while set.
+	};
+
 	// Small heap details.
 	cHeap::sHeapDetails m_SmallHeapDetails;
 
@@ -60,6 +246,11 @@ namespace Elephant
 	// Live view port
 	jrs_u16 cMemoryManager::m_uLVPort = 7133;
 
+	// Live view clients.  See InitializeLiveViewServer.
+	jrs_u32 cMemoryManager::m_uLVMaxClients = 4;
+	jrs_u32 cMemoryManager::m_uLVClientBacklog = 1024 * 1024;
+	jrs_i8 cMemoryManager::m_LVLocalSocketPath[108] = { 0 };
+
 	// Live view is running flag
 	volatile jrs_bool cMemoryManager::m_bLiveViewRunning = false;
 
@@ -93,6 +284,12 @@ namespace Elephant
 	// Enhanced debugging thread
 	cJRSThread g_MemoryManagerEnhancedDebugThread;
 
+	// Compact continuous dump writer thread
+	cJRSThread g_MemoryManagerContinuousDumpThread;
+
+	// Statistics page publisher thread
+	cJRSThread g_MemoryManagerStatsPageThread;
+
 	// Continuous dump file name
 	jrs_i8 cMemoryManager::m_ContinuousDumpFile[256];
 
@@ -139,16 +336,21 @@ namespace Elephant
 	//      DefaultAllocator - Default allocation call.
 	//      DefaultFree - Default free call.
 	//		DefaultPageSize - Default page size call.
+	//		DefaultRelease - Call to return unused pages to the system while keeping the address range.  May be NULL to keep all pages resident.  Default NULL.
+	//		uZeroFlags - JRSMEMORYZEROFLAG_ALLOCATOR if DefaultAllocator returns zero filled memory and JRSMEMORYZEROFLAG_RELEASE if released pages
+	//					 read back as zero.  Calloc skips clearing memory it knows is zero.  Default JRSMEMORYZEROFLAG_NONE.
 	//  Return Value:
 	//      Nothing.
 	//  Summary:
 	//      Initializes Elephants allocation and free main pool functions.
-	void cMemoryManager::InitializeAllocationCallbacks(MemoryManagerDefaultAllocator DefaultAllocator, MemoryManagerDefaultFree DefaultFree, MemoryManagerDefaultSystemPageSize DefaultPageSize)
+	void cMemoryManager::InitializeAllocationCallbacks(MemoryManagerDefaultAllocator DefaultAllocator, MemoryManagerDefaultFree DefaultFree, MemoryManagerDefaultSystemPageSize DefaultPageSize, MemoryManagerDefaultRelease DefaultRelease, jrs_u32 uZeroFlags)
 	{
 		MemoryWarning(!cMemoryManager::Get().IsInitialized(), JRSMEMORYERROR_CALLEDAFTERINITIALIZE, "This function should be called before Initialization.");
 		cMemoryManager::m_MemoryManagerDefaultAllocator = DefaultAllocator;
 		cMemoryManager::m_MemoryManagerDefaultFree = DefaultFree;
 		cMemoryManager::m_MemoryManagerDefaultSystemPageSize = DefaultPageSize;
+		cMemoryManager::m_MemoryManagerDefaultSystemRelease = DefaultRelease;
+		cMemoryManager::m_uMemoryManagerDefaultZeroFlags = uZeroFlags;
 	}
 
 	//  Description:
@@ -198,6 +400,32 @@ namespace Elephant
 		strcpy(m_ContinuousDumpFile, pFileNameAndPath);
 	}
 
+	//  Description:
+	//      Writes the continuous dump in a compact binary format instead of CSV text.  Records are delta and varint encoded into chunks
+	//		which a low priority thread compresses and passes to the file callback, so logging never waits on the file.  More chunks are
+	//		allocated if the writer falls behind.  Enabling logging starts a new file and disabling it or Destroy writes the chunk index.
+	//		The format and a reader are in JRSMemory_ContinuousDump.h.  Allocations made by the file callback are not logged.
+	//
+	//		Must be called before Initialize.  InitializeContinuousDump still sets the file name.
+	//  See Also:
+	//      InitializeContinuousDump, EnableLogging
+	//  Arguments:
+	//      uChunkSize - Size of each uncompressed chunk.  Between 4KB and 1MB.  0 returns to the CSV dump.  Default 64KB.
+	//		uNumChunks - Number of chunks allocated up front.  At least 2.  Default 16.
+	//  Return Value:
+	//      Nothing.
+	//  Summary:
+	//      Writes the continuous dump in a compact binary format.
+	void cMemoryManager::InitializeCompactContinuousDump(jrs_u32 uChunkSize, jrs_u32 uNumChunks)
+	{
+		MemoryWarning(!cMemoryManager::Get().IsInitialized(), JRSMEMORYERROR_CALLEDAFTERINITIALIZE, "This function should be called before Initialization.");
+
+		if(uChunkSize)
+			uChunkSize = uChunkSize < 4096 ? 4096 : (uChunkSize > 1024 * 1024 ? 1024 * 1024 : uChunkSize);
+		m_uCompactDumpChunkSize = uChunkSize;
+		m_uCompactDumpChunks = uNumChunks < 2 ? 2 : uNumChunks;
+	}
+
 	//  Description:
 	//      Initializes the live view network thread.  The thread is of low priority and is polled roughly every uMilliSeconds.  The thread will always be active but do very little if Goldfish isnt running.
 	//  See Also:
@@ -229,6 +457,33 @@ namespace Elephant
 #endif
 	}
 
+	//  Description:
+	//      Configures how the live view thread serves clients on Linux.  Several clients may be connected at once, each choosing whether to receive
+	//		the continuous operations.  The operation ring is sent straight from the buffer.  Anything a client cannot take yet is copied into its own
+	//		backlog so the ring is always emptied and allocating threads never wait on a slow client.  A client that falls uClientBacklogSize bytes
+	//		behind is disconnected.  Other platforms serve a single client on the LiveView port and ignore this.
+	//  See Also:
+	//      InitializeLiveView
+	//  Arguments:
+	//		uMaxClients - Number of clients that can be connected at once.  1 to MemoryManager_MaxLiveViewClients.  Default 4.
+	//		pLocalSocketPath - Path of a unix domain socket to listen on as well as the LiveView port.  NULL for none.  Default NULL.
+	//		uClientBacklogSize - Bytes each client may fall behind.  Minimum 64k and never less than the operation ring.  Default 1MB.
+	//  Return Value:
+	//      Nothing.
+	//  Summary:
+	//      Configures how the live view thread serves clients on Linux.
+	void cMemoryManager::InitializeLiveViewServer(jrs_u32 uMaxClients, const jrs_i8 *pLocalSocketPath, jrs_u32 uClientBacklogSize)
+	{
+		MemoryWarning(!cMemoryManager::Get().IsInitialized(), JRSMEMORYERROR_CALLEDAFTERINITIALIZE, "This function should be called before Initialization.");
+		MemoryWarning(!pLocalSocketPath || strlen(pLocalSocketPath) < sizeof(m_LVLocalSocketPath), JRSMEMORYERROR_INVALIDARGUMENTS, "Local socket path must be less than %d characters.", sizeof(m_LVLocalSocketPath));
+
+		m_uLVMaxClients = uMaxClients < 1 ? 1 : (uMaxClients > MemoryManager_MaxLiveViewClients ? MemoryManager_MaxLiveViewClients : uMaxClients);
+		m_uLVClientBacklog = uClientBacklogSize < 64 * 1024 ? 64 * 1024 : uClientBacklogSize;
+		m_LVLocalSocketPath[0] = 0;
+		if(pLocalSocketPath && strlen(pLocalSocketPath) < sizeof(m_LVLocalSocketPath))
+			strcpy(m_LVLocalSocketPath, pLocalSocketPath);
+	}
+
 	//  Description:
 	//      Initializes the enhanced debugging thread.  The thread is of low priority and is polled roughly every 16ms.  This thread checks the memory has not been used after it was freed.
 	//		It does however mean that some memory will remain 'valid' until it has been checked and confirmed as unused else where. This means that memory consumption will be slightly higher
@@ -256,6 +511,126 @@ namespace Elephant
 		m_uEDebugMaxPendingAllocations = uMaxAllocation;
 	}
 
+	//  Description:
+	//      Sets if Elephant is destroyed when the memory manager is destructed during global destruction.  This is enabled by default.  Disable it
+	//		when memory may still be freed after global destruction, such as when Elephant replaces the system malloc, and the operating
+	//		system will reclaim the memory instead.
+	//
+	//		Must be called before Initialize.
+	//  See Also:
+	//      Initialize, Destroy
+	//  Arguments:
+	//      bDestroyOnExit - false to leave Elephant initialized during global destruction.
+	//  Return Value:
+	//      Nothing.
+	//  Summary:
+	//      Sets if Elephant is destroyed during global destruction.
+	void cMemoryManager::InitializeDestroyOnExit(jrs_bool bDestroyOnExit)
+	{
+		MemoryWarning(!cMemoryManager::Get().IsInitialized(), JRSMEMORYERROR_CALLEDAFTERINITIALIZE, "This function should be called before Initialization.");
+
+		m_bDestroyOnExit = bDestroyOnExit;
+	}
+
+	//  Description:
+	//      Enables the region cache.  The system memory of destroyed heaps is kept and reused by the next heap of the same size class instead of
+	//		going back to the system.  It is used by scratch heaps and by CreateHeap in resizable mode.  Disabled by default.
+	//
+	//		Must be called before Initialize.
+	//  See Also:
+	//      CreateScratchHeap, FlushRegionCache
+	//  Arguments:
+	//      uMaxCachedSize - Maximum number of bytes of cached regions.  0 disables the cache.
+	//		bReleasePages - true to release the pages of cached regions back to the system while keeping the address range.  Only regions from
+	//						the default allocator with a release callback can be released.  Default true.
+	//  Return Value:
+	//      Nothing.
+	//  Summary:
+	//      Enables the region cache.
+	void cMemoryManager::InitializeRegionCache(jrs_u64 uMaxCachedSize, jrs_bool bReleasePages)
+	{
+		MemoryWarning(!cMemoryManager::Get().IsInitialized(), JRSMEMORYERROR_CALLEDAFTERINITIALIZE, "This function should be called before Initialization.");
+
+		m_uRegionCacheMaxSize = uMaxCachedSize;
+		m_bRegionCacheRelease = bReleasePages;
+	}
+
+	//  Description:
+	//      Enables the sampling heap profiler.  On average one allocation is recorded with its call stack every uSampleInterval bytes
+	//		allocated from cHeaps and NI heaps.  The gaps between samples are random so allocation patterns cannot hide from it.  Sampled
+	//		allocations are removed when freed.  WriteHeapProfile writes the live and total samples per call stack in the pprof heap format.
+	//		Disabled by default.
+	//
+	//		Must be called before Initialize.
+	//  See Also:
+	//      WriteHeapProfile
+	//  Arguments:
+	//      uSampleInterval - Mean number of bytes allocated between samples.  1 samples every allocation.  0 disables the profiler.  Default 512KB.
+	//		uMaxSamples - Maximum number of live samples and of distinct call stacks.  Samples past this are dropped.  Default 16384.
+	//  Return Value:
+	//      Nothing.
+	//  Summary:
+	//      Enables the sampling heap profiler.
+	void cMemoryManager::InitializeSamplingProfiler(jrs_u64 uSampleInterval, jrs_u32 uMaxSamples)
+	{
+		MemoryWarning(!cMemoryManager::Get().IsInitialized(), JRSMEMORYERROR_CALLEDAFTERINITIALIZE, "This function should be called before Initialization.");
+
+		m_uSampleInterval = uSampleInterval;
+		m_uMaxSamples = uMaxSamples;
+	}
+
+	//  Description:
+	//      Sets the size of the stack table.  Every unique call stack recorded by name and callstack builds, tracked pools, tracked NI heaps
+	//		and the sampling heap profiler is kept once in the table and block headers store a 32bit id into it.  Once the table is full new
+	//		call stacks are recorded without frames.  The table is allocated from the default allocator when the first stack is captured.
+	//
+	//		Must be called before Initialize.
+	//  See Also:
+	//      InitializeSamplingProfiler
+	//  Arguments:
+	//      uMaxStacks - Number of unique call stacks.  Rounded up to a power of 2.  Default 65536.
+	//  Return Value:
+	//      Nothing.
+	//  Summary:
+	//      Sets the size of the stack table.
+	void cMemoryManager::InitializeStackTable(jrs_u32 uMaxStacks)
+	{
+		MemoryWarning(!cMemoryManager::Get().IsInitialized(), JRSMEMORYERROR_CALLEDAFTERINITIALIZE, "This function should be called before Initialization.");
+
+		m_uMaxStacks = uMaxStacks;
+	}
+
+	//  Description:
+	//      Publishes the heap statistics to a shared memory page other processes can map and read without locking or calling into this
+	//		process.  Every heap, pool attached to a heap and non intrusive heap gets an entry with its size, used and peak bytes, allocation
+	//		counts, free and largest free bytes, resize count and lock waits.  A low priority thread updates the page every uUpdateMS and
+	//		UpdateStatsPage updates it at any time.  The layout and a reader are in JRSMemory_StatsPage.h.  Lock waits are only recorded for
+	//		heaps with latency statistics enabled.  Platforms without shared memory warn and carry on without the page.
+	//
+	//		Must be called before Initialize.  The page is removed by Destroy in the process that created it.
+	//  See Also:
+	//      UpdateStatsPage, cHeap::EnableLatencyStatistics
+	//  Arguments:
+	//      pName - Name of the shared memory object.  %d is replaced by the process id.  Creating the page fails with a warning if the name
+	//				is already in use.  NULL or an empty string disables the page.  Default "/elephant_stats_%d".
+	//		uUpdateMS - Milliseconds between updates.  0 only updates from UpdateStatsPage.  Default 1000.
+	//		uMaxEntries - Number of entries the page holds.  Entries past this are dropped.  Default 256.
+	//  Return Value:
+	//      Nothing.
+	//  Summary:
+	//      Publishes heap statistics to a shared memory page.
+	void cMemoryManager::InitializeStatsPage(const jrs_i8 *pName, jrs_u32 uUpdateMS, jrs_u32 uMaxEntries)
+	{
+		MemoryWarning(!cMemoryManager::Get().IsInitialized(), JRSMEMORYERROR_CALLEDAFTERINITIALIZE, "This function should be called before Initialization.");
+		MemoryWarning(!pName || strlen(pName) < sizeof(m_StatsPageName), JRSMEMORYERROR_INVALIDFILENAME, "Statistics page name is too long.");
+
+		m_StatsPageName[0] = 0;
+		if(pName && strlen(pName) < sizeof(m_StatsPageName))
+			strcpy(m_StatsPageName, pName);
+		m_uStatsPageUpdateMS = uUpdateMS;
+		m_uStatsPageMaxEntries = uMaxEntries ? uMaxEntries : 1;
+	}
+
 	//  Description:
 	//      Private constructor for the memory manager.  May not be called by the user.
 	//  See Also:
@@ -266,7 +641,7 @@ namespace Elephant
 	//      Nothing.
 	//  Summary:
 	//      Private constructor for the memory manager.
-	cMemoryManager::cMemoryManager() : m_bInitialized(false)
+	cMemoryManager::cMemoryManager() : m_bInitialized(false), m_pHeapRanges(NULL), m_pRegistryBlocks(NULL), m_pSampler(NULL), m_pStackTable(NULL), m_pCompactDump(NULL), m_pStatsPage(NULL)
 	{
 		g_uBaseAddressOffsetCalculation = (jrs_u64)MemoryManagerPlatformInit;
 	}
@@ -284,7 +659,7 @@ namespace Elephant
 	//      Destructor for the memory manager.
 	cMemoryManager::~cMemoryManager()
 	{
-		if(m_bInitialized)
+		if(m_bInitialized && m_bDestroyOnExit)
 			Destroy();
 	}
 
@@ -334,23 +709,18 @@ namespace Elephant
 		MemoryWarning(1 == JRSCountLeadingZero(2), JRSMEMORYERROR_CLZIMPLEMENTATIONFAIL, "Count Leading Zero failed.  For 2 answer should be 1.");
 		MemoryWarning(31 == JRSCountLeadingZero(0x80000000), JRSMEMORYERROR_CLZIMPLEMENTATIONFAIL, "Count Leading Zero failed.  For 0x80000000 answer should be 31.");
 		
-		// Clear all the heaps
-		for(jrs_u32 i = 0; i < MemoryManager_MaxHeaps; i++)
-			m_pHeaps[i] = 0;
-
-		for(jrs_u32 i = 0; i < MemoryManager_MaxUserHeaps; i++)
-			m_pUserHeaps[i] = 0;
-
-		for(jrs_u32 i = 0; i < MemoryManager_MaxNonIntrusiveHeaps; i++)
-			m_pNonInstrusiveHeaps[i] = 0;
-
 		// Clear the count
 		m_uHeapNum = m_uUserHeapNum = m_uNonIntrusiveHeapNum = m_uHeapIdInfo = m_uPoolIdInfo = 0;
+		m_pHeapRanges = NULL;
+		m_pRegistryBlocks = NULL;
+		m_uHeapRangeSequence = 0;
+		m_uNumCachedRegions = 0;
+		m_uCachedRegionSize = 0;
 
 		// Init the data to the actual sizes that we can actually use
 		const jrs_u32 HeapSizes = (((sizeof(cHeap) * (MemoryManager_MaxHeaps + MemoryManager_MaxUserHeaps)) + (sizeof(cHeapNonIntrusive) * MemoryManager_MaxNonIntrusiveHeaps)) + 0xf) & ~0xf;		// Size is aligned to 16bytes
 		const jrs_u32 EDebugSize = ((sizeof(sEDebug) * m_uEDebugMaxPendingAllocations) + 0xf) & ~0xf;
-		const jrs_u32 ELVDebugSize = ((jrs_u32)SizeofFreeBlock() + sizeof(sLVOperation)) * (m_uLVMaxPendingContinuousOperations);
+		const jrs_u32 ELVDebugSize = ((jrs_u32)SizeofFreeBlock() + MemoryManager_WireStackGrowth + sizeof(sLVOperation)) * (m_uLVMaxPendingContinuousOperations);
 		jrs_u32 ResizableSystemStore = 0;		
 
 		// Default page size of 64k
@@ -450,15 +820,24 @@ namespace Elephant
 
 		// Set the heap starting memory
 		m_pUsableHeapMemoryStart = m_pUseableMemoryStart;
+		m_pUsableHeapMemoryZero = (!m_bCustomMemoryDefined && (GetSystemZeroFlags(m_MemoryManagerDefaultAllocator, NULL) & JRSMEMORYZEROFLAG_ALLOCATOR)) ? m_pUseableMemoryStart : m_pUseableMemoryEnd;
 
-		// Heaps come from the start of this block
+		// Heaps in the initial registry slots come from the start of this block
 		m_pMemoryHeaps = (cHeap *)m_pAllocatedMemoryBlock;
 		m_pMemoryUserHeaps = m_pMemoryHeaps + MemoryManager_MaxHeaps;
 		m_pMemoryNonIntrusiveHeaps = (cHeapNonIntrusive *)(m_pMemoryUserHeaps + MemoryManager_MaxUserHeaps);
+		InitializeHeapRegistry(m_HeapRegistry, m_InitialHeapSlots, m_uInitialNameBuckets, MemoryManager_MaxHeaps, m_pMemoryHeaps, sizeof(cHeap), g_ThreadLocks);
+		InitializeHeapRegistry(m_UserHeapRegistry, m_InitialHeapSlots + MemoryManager_MaxHeaps, m_uInitialNameBuckets + MemoryManager_MaxHeaps, MemoryManager_MaxUserHeaps, m_pMemoryUserHeaps, sizeof(cHeap), g_ThreadLocks + MemoryManager_MaxHeaps);
+		InitializeHeapRegistry(m_NIHeapRegistry, m_InitialHeapSlots + MemoryManager_MaxHeaps + MemoryManager_MaxUserHeaps, m_uInitialNameBuckets + MemoryManager_MaxHeaps + MemoryManager_MaxUserHeaps, MemoryManager_MaxNonIntrusiveHeaps, 
+			m_pMemoryNonIntrusiveHeaps, sizeof(cHeapNonIntrusive), g_ThreadLocks + MemoryManager_MaxHeaps + MemoryManager_MaxUserHeaps);
 		
 		// Create the small heap if needed
 		m_pMemorySmallHeap = 0;
 
+		// No malloc routes until the small heap or the user adds them
+		m_uNumMallocRoutes = 0;
+		BuildMallocRouteClasses();
+
 		// Default malloc heap
 		m_pDefaultMallocHeap = 0;
 		m_bOverrideMallocHeap = false;
@@ -466,6 +845,11 @@ namespace Elephant
 		// Initialize any thing for platform specifics.
 		MemoryManagerPlatformInit();
 
+		// The profiler must exist before the first allocation
+		m_pSampler = NULL;
+		if(m_uSampleInterval && !CreateSampler())
+			MemoryWarning(0, JRSMEMORYERROR_ELEPHANTOOM, "Could not allocate the sampling heap profiler.  Profiling is disabled.");
+
 		// Its now initialized
 		m_bInitialized = true;
 
@@ -529,6 +913,11 @@ namespace Elephant
 				g_MemoryManagerEnhancedDebugThread.Start();
 			}
 		}
+
+		// Compact continuous dump writer.  Must exist before logging starts.
+		m_pCompactDump = NULL;
+		if(m_uCompactDumpChunkSize && !CreateCompactDump())
+			MemoryWarning(0, JRSMEMORYERROR_ELEPHANTOOM, "Could not allocate the compact continuous dump.  The CSV dump is written instead.");
 #endif
 		// Set the resizable buffer up
 		if(m_bResizeable)
@@ -552,6 +941,8 @@ namespace Elephant
 		{
 			cHeap::sHeapDetails SmallHeapDetails = m_SmallHeapDetails;
 			m_pMemorySmallHeap = CreateHeap(m_uSmallHeapSize, "SmallHeap", &SmallHeapDetails);
+			if(m_pMemorySmallHeap)
+				AddMallocRoute(0, m_pMemorySmallHeap->GetMaxAllocationSize(), m_pMemorySmallHeap);
 		}
 
 		//Sometimes we want the heap to swallow up everything
@@ -570,6 +961,11 @@ namespace Elephant
 			//Create the default heap. 
 			CreateHeap(uDefaultHeapSize, "DefaultHeap", 0);
 		}
+
+		// Statistics page.  Published once here so readers see the initial heaps.
+		m_pStatsPage = NULL;
+		if(m_StatsPageName[0] && !CreateStatsPage())
+			MemoryWarning(0, JRSMEMORYERROR_STATSPAGE, "Could not create the statistics page %s.  Shared memory of that name may already exist.", m_StatsPageName);
 		
 		//Memory manager completed successfully
 		return true;
@@ -618,8 +1014,14 @@ namespace Elephant
 		// Memory must be aligned to the page size also.
 		MemoryWarning(!((jrs_u64)pMemStartAdd & (uSystemPageSize - 1)), JRSMEMORYERROR_RESIZEOFELEPHANTFAILED, "Returned address is not system page size aligned. Errors may occur.");
 
-		// We have to add the expansion to our pool for later
+		// We have to add the expansion to our pool for later.  Free finds the heap from its own range for the block.
 		m_MMThreadLock.Lock();
+		if(!AddHeapRange(pHeap, NULL, pMemStartAdd, pMemEndAdd))
+		{
+			m_MMThreadLock.Unlock();
+			pHeap->m_systemFree(pMemStartAdd, uSingleSize);
+			return FALSE;
+		}
 		m_pResizableSystemAllocs[m_uResizableCount] = (jrs_u64)pMemStartAdd;
 		m_pResizableSystemAllocs[m_uResizableCount + 1] = uSingleSize;
 		m_uResizableCount += 2;
@@ -627,6 +1029,9 @@ namespace Elephant
 		
 		// Resize the heap with this memory address
 		pHeap->ResizeInternal(pMemStartAdd, pMemEndAdd);
+		pHeap->UpdateZeroMemory();
+		if(GetSystemZeroFlags(pHeap->m_systemAllocator, NULL) & JRSMEMORYZEROFLAG_ALLOCATOR)
+			pHeap->AddZeroMemory((jrs_i8 *)pMemStartAdd, (jrs_i8 *)pMemEndAdd);
 
 		return TRUE;
 	}
@@ -706,32 +1111,43 @@ namespace Elephant
 		}
 #endif
 
+		// The statistics page goes before the heaps it reads
+		DestroyStatsPage();
+
 		// Destroy any thing for platform specifics.
 		MemoryManagerPlatformDestroy();
 
 		// Remove all the non intrusive user heaps.
-		for(jrs_u32 i = 0; i < MemoryManager_MaxNonIntrusiveHeaps; i++)
+		for(jrs_u32 i = 0; i < m_NIHeapRegistry.uMaxSlots; i++)
 		{
-			if(m_pNonInstrusiveHeaps[i])
-				DestroyNonIntrusiveHeap(m_pNonInstrusiveHeaps[i]);
+			if(m_NIHeapRegistry.pSlots[i].pHeap)
+				DestroyNonIntrusiveHeap((cHeapNonIntrusive *)m_NIHeapRegistry.pSlots[i].pHeap);
 		}
 
 		// Remove all the user heaps.
-		for(jrs_u32 i = 0; i < MemoryManager_MaxUserHeaps; i++)
+		for(jrs_u32 i = 0; i < m_UserHeapRegistry.uMaxSlots; i++)
 		{
-			if(m_pUserHeaps[i])
-				DestroyHeap(m_pUserHeaps[i]);
+			if(m_UserHeapRegistry.pSlots[i].pHeap)
+				DestroyHeap((cHeap *)m_UserHeapRegistry.pSlots[i].pHeap);
 		}
 
 		// Clear all the heaps
-		for(jrs_u32 i = MemoryManager_MaxHeaps; i > 0; i--)
+		for(jrs_u32 i = m_HeapRegistry.uMaxSlots; i > 0; i--)
 		{
-			if(m_pHeaps[i - 1])
-				DestroyHeap(m_pHeaps[i - 1]);
+			if(m_HeapRegistry.pSlots[i - 1].pHeap)
+				DestroyHeap((cHeap *)m_HeapRegistry.pSlots[i - 1].pHeap);
 		}
 
+		// Regions of the destroyed heaps
+		FlushRegionCache();
+
+		// Sampled allocations went with the heaps
+		DestroySampler();
+		DestroyStackTable();
+
 		// End the logging
 		ContinuousLogging_Operation(eContLog_StopLogging, NULL, NULL, 0);
+		DestroyCompactDump();
 
 		// Disable continuous logging
 		m_bEnableContinuousDump = false;
@@ -743,11 +1159,16 @@ namespace Elephant
 		// Clear other internal values
 		m_pAllocatedMemoryBlock = 0;
 		m_pUseableMemoryStart = m_pUseableMemoryEnd = 0;
-		m_pUsableHeapMemoryStart = 0;
+		m_pUsableHeapMemoryStart = m_pUsableHeapMemoryZero = 0;
 		m_pMemorySmallHeap = 0;
+		m_uNumMallocRoutes = 0;
+		BuildMallocRouteClasses();
 
 		// Clear the count
-		m_uHeapNum = m_uUserHeapNum = 0;
+		m_uHeapNum = m_uUserHeapNum = m_uNonIntrusiveHeapNum = 0;
+
+		// Registry tables, heaps and locks added after Initialize
+		FreeRegistryBlocks();
 
 		// Completed
 		m_bInitialized = false;
@@ -785,2873 +1206,6093 @@ namespace Elephant
 	}
 
 	//  Description:
-	//      Retrieves the maximum number of managed heaps Elephant can handle.
+	//      Retrieves the number of managed heap slots.  Use it as the upper bound for GetHeap.  It grows as more heaps are created.
 	//  See Also:
 	//      GetMaxNumUserHeaps
 	//  Arguments:
 	//      None.
 	//  Return Value:
-	//      The maximum number of heaps.
+	//      The number of managed heap slots.
 	//  Summary:
-	//      Gets the maximum allowed managed heaps.
+	//      Gets the number of managed heap slots.
 	jrs_u32 cMemoryManager::GetMaxNumHeaps(void) const 
 	{ 
-		return MemoryManager_MaxHeaps; 
+		return m_HeapRegistry.uMaxSlots; 
 	}
 
 	//  Description:
-	//      Retrieves the maximum number of NI heaps Elephant can handle.
+	//      Retrieves the number of NI heap slots.  Use it as the upper bound for GetNIHeap.  It grows as more heaps are created.
 	//  See Also:
 	//      GetMaxNumUserHeaps
 	//  Arguments:
 	//      None.
 	//  Return Value:
-	//      The maximum number of NI heaps.
+	//      The number of NI heap slots.
 	//  Summary:
-	//      Gets the maximum allowed NI managed heaps.
+	//      Gets the number of NI heap slots.
 	jrs_u32 cMemoryManager::GetMaxNumNIHeaps(void) const 
 	{ 
-		return MemoryManager_MaxHeaps; 
+		return m_NIHeapRegistry.uMaxSlots; 
 	}
 
 	//  Description:
-	//      Retrieves the maximum number of self managed heaps Elephant can handle.
+	//      Retrieves the number of self managed heap slots.  Use it as the upper bound for GetUserHeap.  It grows as more heaps are created.
 	//  See Also:
 	//      GetMaxNumHeaps
 	//  Arguments:
 	//      None.
 	//  Return Value:
-	//      The maximum number of heaps.
+	//      The number of self managed heap slots.
 	//  Summary:
-	//      Gets the maximum allowed self managed heaps.
+	//      Gets the number of self managed heap slots.
 	jrs_u32 cMemoryManager::GetMaxNumUserHeaps(void) const 
 	{ 
-		return MemoryManager_MaxUserHeaps; 
+		return m_UserHeapRegistry.uMaxSlots; 
 	}
 
 	//  Description:
-	//      Creates a managed heap only, self managed heaps will fail creation.  A unique name may be specified and it will automatically
-	//		come out of Elephants memory created in Initialize. Use the details to customize the operation of the heap for example
-	//		to allow zero size allocations.
+	//      Sets up a heap registry with slots whose storage and locks already exist.  Every slot starts on the free list lowest first.
 	//  See Also:
-	//      Initialize, DestroyHeap, cHeap::sHeapDetails
+	//      GrowHeapRegistry
 	//  Arguments:
-	//      uHeapSize - The total size in bytes of the heap.  16byte multiple.
-	//      pHeapName - Null terminated string for the heap name. Smaller than 32bytes.
-	//      pHeapDetails - A valid pointer to heap details which can be created locally on the stack.  Its lifetime is
-	//					  only the length of CreateHeap function.  NULL will use the sHeapDetails values.
+	//      rRegistry - Registry to set up.
+	//		pSlots - uNumSlots slots.
+	//		pNameBuckets - uNumSlots name buckets.
+	//		uNumSlots - Number of slots.  Power of 2.
+	//		pObjects - Storage for uNumSlots heaps.
+	//		uObjectSize - Size of each heap in bytes.
+	//		pLocks - uNumSlots locks.
 	//  Return Value:
-	//      Valid cHeap if successful.
-	//		NULL for failure.
+	//      None
 	//  Summary:
-	//      Creates a managed heap.
-	cHeap *cMemoryManager::CreateHeap(jrs_u64 uHeapSize, const jrs_i8 *pHeapName, cHeap::sHeapDetails *pHeapDetails)
+	//      Sets up a heap registry.
+	void cMemoryManager::InitializeHeapRegistry(sHeapRegistry &rRegistry, sHeapSlot *pSlots, jrs_u32 *pNameBuckets, jrs_u32 uNumSlots, void *pObjects, jrs_u32 uObjectSize, JRSMemory_ThreadLock *pLocks)
 	{
-		// Check if initialized
-		if(!m_bInitialized)
+		for(jrs_u32 i = 0; i < uNumSlots; i++)
 		{
-			MemoryWarning(m_bInitialized, JRSMEMORYERROR_NOTINITIALIZED, "Memory manager is not initialized.");
-			return 0;
-		}	
+			pSlots[i].pHeap = NULL;
+			pSlots[i].pObject = (jrs_i8 *)pObjects + (jrs_sizet)i * uObjectSize;
+			pSlots[i].pLock = &pLocks[i];
+			pSlots[i].uNextFree = (i + 1) < uNumSlots ? i + 1 : MemoryManager_InvalidHeapSlot;
+			pSlots[i].uNextName = MemoryManager_InvalidHeapSlot;
+			pNameBuckets[i] = MemoryManager_InvalidHeapSlot;
+		}
 
-		m_MMThreadLock.Lock();
-		cHeap::sHeapDetails defaultdetails;
+		rRegistry.pSlots = pSlots;
+		rRegistry.pNameBuckets = pNameBuckets;
+		rRegistry.uMaxSlots = uNumSlots;
+		rRegistry.uFreeSlot = 0;
+		rRegistry.uObjectSize = uObjectSize;
+	}
 
-		// Create details
-		if(!pHeapDetails)
-			pHeapDetails = &defaultdetails;
+	//  Description:
+	//      Doubles the number of slots in a registry.  The new table, name buckets, heap storage and locks come from one system allocation.
+	//		Existing heaps keep their storage and locks.  The old table is left in place for any thread still reading it.  m_MMThreadLock
+	//		must be held.
+	//  See Also:
+	//      AcquireHeapSlot
+	//  Arguments:
+	//      rRegistry - Registry to grow.  Its free list must be empty.
+	//  Return Value:
+	//      TRUE if successful.
+	//		FALSE if the system allocator failed.
+	//  Summary:
+	//      Doubles the number of slots in a registry.
+	jrs_bool cMemoryManager::GrowHeapRegistry(sHeapRegistry &rRegistry)
+	{
+		jrs_u32 uOldSlots = rRegistry.uMaxSlots;
+		jrs_u32 uNewSlots = uOldSlots * 2;
+		if(uNewSlots <= uOldSlots)
+			return FALSE;
 
-		// Do we need to set defaults
-		if(pHeapDetails->systemAllocator == NULL || pHeapDetails->systemFree == NULL || pHeapDetails->systemPageSize == NULL)
-		{
-			pHeapDetails->systemAllocator = m_MemoryManagerDefaultAllocator;
-			pHeapDetails->systemFree = m_MemoryManagerDefaultFree;
-			pHeapDetails->systemPageSize = m_MemoryManagerDefaultSystemPageSize;
-		}
-		else if(!m_bResizeable)
+		// Slots and buckets, then the heaps and locks for the new half.  Both need 128 byte alignment.
+		jrs_u64 uObjectsOffset = (((sizeof(sHeapSlot) + sizeof(jrs_u32)) * (jrs_u64)uNewSlots) + 127) & ~127;
+		jrs_u64 uLocksOffset = (uObjectsOffset + ((jrs_u64)rRegistry.uObjectSize * uOldSlots) + 127) & ~127;
+		jrs_i8 *pBlock = (jrs_i8 *)AllocateRegistryBlock(uLocksOffset + sizeof(JRSMemory_ThreadLock) * (jrs_u64)uOldSlots, uLocksOffset, uOldSlots);
+		if(!pBlock)
+			return FALSE;
+
+		sHeapSlot *pSlots = (sHeapSlot *)pBlock;
+		jrs_u32 *pNameBuckets = (jrs_u32 *)(pSlots + uNewSlots);
+		JRSMemory_ThreadLock *pLocks = (JRSMemory_ThreadLock *)(pBlock + uLocksOffset);
+		memcpy(pSlots, rRegistry.pSlots, sizeof(sHeapSlot) * uOldSlots);
+		for(jrs_u32 i = 0; i < uOldSlots; i++)
 		{
-			// Non resizable heaps default to cMemoryManagers
-			pHeapDetails->systemAllocator = m_MemoryManagerDefaultAllocator;
-			pHeapDetails->systemFree = m_MemoryManagerDefaultFree;
-			pHeapDetails->systemPageSize = m_MemoryManagerDefaultSystemPageSize;
+			sHeapSlot &rSlot = pSlots[uOldSlots + i];
+			rSlot.pHeap = NULL;
+			rSlot.pObject = pBlock + uObjectsOffset + (jrs_sizet)i * rRegistry.uObjectSize;
+			rSlot.pLock = &pLocks[i];
+			rSlot.uNextFree = (uOldSlots + i + 1) < uNewSlots ? uOldSlots + i + 1 : MemoryManager_InvalidHeapSlot;
+			rSlot.uNextName = MemoryManager_InvalidHeapSlot;
 		}
+		for(jrs_u32 i = 0; i < uNewSlots; i++)
+			pNameBuckets[i] = MemoryManager_InvalidHeapSlot;
 
-		if(pHeapDetails->bHeapIsSelfManaged)
+		// Rehash the live heaps into the larger bucket table
+		for(jrs_u32 i = 0; i < uOldSlots; i++)
 		{
-			MemoryWarning(!pHeapDetails->bHeapIsSelfManaged, JRSMEMORYERROR_HEAPSELFMANAGED, "Cannot create a self managed heap.  Use cMemoryManager::CreateHeap(void *pMemoryAddress, u32 uHeapSize, i8 *pHeapName, cHeap::sHeapDetails *pHeapDetails)");
-			return 0;
+			pSlots[i].uNextName = MemoryManager_InvalidHeapSlot;
+			if(pSlots[i].pHeap)
+			{
+				jrs_u32 uBucket = HashHeapName(GetHeapSlotName(rRegistry, pSlots[i].pHeap)) & (uNewSlots - 1);
+				pSlots[i].uNextName = pNameBuckets[uBucket];
+				pNameBuckets[uBucket] = i;
+			}
 		}
-		
-#ifdef JRS64BIT
-		// No need to check for 64bit overflows.  Not for a few years anyway.
-#else
-		MemoryWarning(uHeapSize <= 0xffffffff, JRSMEMORYERROR_HEAPTOBIG, "Heap size can only be a maximum size of 4gb (2^32)");
-#endif
-		// Here we create the memory address and hand it to the creation function, a bit like user managed but we handle internally.
-		m_bAllowHeapCreationFromAddress = true;		// Enable creation from a specified address
 
-		jrs_sizet uSystemPageSize = m_uSystemPageSize;
-		if(pHeapDetails->systemPageSize)
-			uSystemPageSize = pHeapDetails->systemPageSize();
+		// Publish the table before the count so a reader checking the count never indexes past the table it reads
+		rRegistry.pSlots = pSlots;
+		rRegistry.pNameBuckets = pNameBuckets;
+		rRegistry.uFreeSlot = uOldSlots;
+		JRSMemoryBarrier();
+		rRegistry.uMaxSlots = uNewSlots;
 
-		// Resizable mode functions slightly differently
-		if(m_bResizeable)
-		{
-			// Align the memory size to the page size but only for resizable heaps
-			uHeapSize = ((uHeapSize + (uSystemPageSize - 1)) & ~(uSystemPageSize - 1));
+		return TRUE;
+	}
 
-			void *pMemory = pHeapDetails->systemAllocator(uHeapSize, NULL);
-			
-			// Increase count			
-			m_pResizableSystemAllocs[m_uResizableCount] = (jrs_u64)pMemory;
-			m_pResizableSystemAllocs[m_uResizableCount + 1] = uHeapSize;
-			m_uResizableCount += 2;			
+	//  Description:
+	//      Takes a slot from the free list of a registry growing it if needed.  m_MMThreadLock must be held.
+	//  See Also:
+	//      RegisterHeapSlot, ReleaseHeapSlot
+	//  Arguments:
+	//      rRegistry - Registry to take the slot from.
+	//  Return Value:
+	//      Slot index or MemoryManager_InvalidHeapSlot if the registry could not grow.
+	//  Summary:
+	//      Takes a free heap slot.
+	jrs_u32 cMemoryManager::AcquireHeapSlot(sHeapRegistry &rRegistry)
+	{
+		if(rRegistry.uFreeSlot == MemoryManager_InvalidHeapSlot && !GrowHeapRegistry(rRegistry))
+			return MemoryManager_InvalidHeapSlot;
 
-			cHeap *pHeap = CreateHeap(pMemory, (jrs_sizet)uHeapSize, pHeapName, pHeapDetails);
-			
-			// Call the system op callback if one exist.
-			if(pHeapDetails->systemOpCallback)
-				pHeapDetails->systemOpCallback(pHeap, pMemory, uHeapSize, FALSE);
+		jrs_u32 uSlot = rRegistry.uFreeSlot;
+		rRegistry.uFreeSlot = rRegistry.pSlots[uSlot].uNextFree;
+		rRegistry.pSlots[uSlot].uNextFree = MemoryManager_InvalidHeapSlot;
+		return uSlot;
+	}
 
-			m_bAllowHeapCreationFromAddress = false;			// Disable
-			m_MMThreadLock.Unlock();			
-			return pHeap;
-		}
+	//  Description:
+	//      Marks a slot taken with AcquireHeapSlot as live and adds the heap name to the name buckets.  m_MMThreadLock must be held.
+	//  See Also:
+	//      AcquireHeapSlot, ReleaseHeapSlot
+	//  Arguments:
+	//      rRegistry - Registry the slot belongs to.
+	//		uSlot - Slot index.
+	//		pHeap - Heap constructed in the slot storage.
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Marks a heap slot as live.
+	void cMemoryManager::RegisterHeapSlot(sHeapRegistry &rRegistry, jrs_u32 uSlot, void *pHeap)
+	{
+		sHeapSlot &rSlot = rRegistry.pSlots[uSlot];
+		jrs_u32 uBucket = HashHeapName(GetHeapSlotName(rRegistry, pHeap)) & (rRegistry.uMaxSlots - 1);
+		rSlot.uNextName = rRegistry.pNameBuckets[uBucket];
+		rRegistry.pNameBuckets[uBucket] = uSlot;
+		rSlot.pHeap = pHeap;
+	}
 
-		//If the last heap is still null we need to create one from the start other wise we tag it on the end
-		cHeap *pHeap = CreateHeap(m_pUsableHeapMemoryStart, (jrs_sizet)uHeapSize, pHeapName, pHeapDetails);
-		if(pHeap)
+	//  Description:
+	//      Returns a slot to the free list.  Live slots are removed from the name buckets first.  m_MMThreadLock must be held.
+	//  See Also:
+	//      AcquireHeapSlot, RegisterHeapSlot
+	//  Arguments:
+	//      rRegistry - Registry the slot belongs to.
+	//		uSlot - Slot index.
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Frees a heap slot.
+	void cMemoryManager::ReleaseHeapSlot(sHeapRegistry &rRegistry, jrs_u32 uSlot)
+	{
+		sHeapSlot *pSlots = rRegistry.pSlots;
+		if(pSlots[uSlot].pHeap)
 		{
-			//Increment the size of the heap
-			m_pUsableHeapMemoryStart = (void *)((jrs_i8 *)m_pUsableHeapMemoryStart + uHeapSize);
+			jrs_u32 *pLink = &rRegistry.pNameBuckets[HashHeapName(GetHeapSlotName(rRegistry, pSlots[uSlot].pHeap)) & (rRegistry.uMaxSlots - 1)];
+			while(*pLink != uSlot)
+				pLink = &pSlots[*pLink].uNextName;
+			*pLink = pSlots[uSlot].uNextName;
+			pSlots[uSlot].pHeap = NULL;
 		}
-		m_bAllowHeapCreationFromAddress = false;			// Disable
 
-		//Return the Heap
-		m_MMThreadLock.Unlock();
-		return pHeap;
+		pSlots[uSlot].uNextName = MemoryManager_InvalidHeapSlot;
+		pSlots[uSlot].uNextFree = rRegistry.uFreeSlot;
+		rRegistry.uFreeSlot = uSlot;
 	}
 
 	//  Description:
-	//      Creates a managed or self managed heap.  A unique name may be specified and it will automatically
-	//		come out of Elephants memory created in Initialize. Use the details to customize the operation of the heap for example
-	//		to allow zero size allocations.  Use this type of create heap to direct to other predefined areas of the system for 
-	//		memory types such as VRAM.
+	//      Finds a live heap in a registry by name.
 	//  See Also:
-	//      Initialize, DestroyHeap, cHeap::sHeapDetails
+	//      FindHeap, FindNonIntrusiveHeap
 	//  Arguments:
-	//		pMemoryAddress - The memory address to create the heap on.  May be other CPU accessible areas 
-	//						like VRAM. 
-	//      uHeapSize - The total size in bytes of the heap.  16byte multiple.
-	//      pHeapName - Null terminated string for the heap name. Smaller than 32bytes.
-	//      pHeapDetails - A valid pointer to heap details which can be created locally on the stack.  Its lifetime is
-	//					  only the length of CreateHeap function.
+	//      rRegistry - Registry to search.
+	//		pName - Null terminated heap name.
 	//  Return Value:
-	//      Valid cHeap if successful.
-	//		NULL for failure.
+	//      The heap or NULL if not found.
 	//  Summary:
-	//      Creates a managed heap.
-	cHeap *cMemoryManager::CreateHeap(void *pMemoryAddress, jrs_u64 uHeapSize, const jrs_i8 *pHeapName, cHeap::sHeapDetails *pHeapDetails)
+	//      Finds a heap by name.
+	void *cMemoryManager::FindHeapSlot(const sHeapRegistry &rRegistry, const jrs_i8 *pName) const
 	{
-		MemoryWarning(pHeapDetails, JRSMEMORYERROR_INVALIDARGUMENTS, "pHeapDetails must be valid for this function");
-		MemoryWarning(pHeapDetails->uDefaultAlignment >= 16, JRSMEMORYERROR_INVALIDALIGN, "Default alignment must be >= 16");
-		MemoryWarning(!(pHeapDetails->uDefaultAlignment & (pHeapDetails->uDefaultAlignment - 1)), JRSMEMORYERROR_INVALIDALIGN, "Cannot create heap because the alignment is non power of 2");
-		MemoryWarning(uHeapSize >= (sizeof(sFreeBlock) + sizeof(sAllocatedBlock) + pHeapDetails->uMinAllocationSize), JRSMEMORYERROR_HEAPTOSMALL, "Heap size must be a minimum of %d bytes.  WARNING You probably want this to be atleast 128k or bigger to be useful.", sizeof(sFreeBlock) + sizeof(sAllocatedBlock) + pHeapDetails->uMinAllocationSize);
-		MemoryWarning(!(uHeapSize & 0xf), JRSMEMORYERROR_INVALIDALIGN, "Heap size must be 16byte aligned.");
+		const sHeapSlot *pSlots = rRegistry.pSlots;
+		if(!pSlots)
+			return NULL;
 
-		// Must be a valid memory address
-		if(!pMemoryAddress)
+		for(jrs_u32 uSlot = rRegistry.pNameBuckets[HashHeapName(pName) & (rRegistry.uMaxSlots - 1)]; uSlot != MemoryManager_InvalidHeapSlot; uSlot = pSlots[uSlot].uNextName)
 		{
-			MemoryWarning(pMemoryAddress, JRSMEMORYERROR_HEAPCREATEINVALIDPOINTER, "0 Memory address.  Cannot create Heap.");
-			return 0;
+			if(!strcmp(pName, GetHeapSlotName(rRegistry, pSlots[uSlot].pHeap)))
+				return pSlots[uSlot].pHeap;
 		}
 
-		// Check if initialized
-		if(!m_bInitialized)
-		{
-			MemoryWarning(m_bInitialized,  JRSMEMORYERROR_NOTINITIALIZED, "Memory manager is not initialized.");
-			return 0;
-		}	
-
-		// Do we need to set defaults
-		if(pHeapDetails->systemAllocator == NULL || pHeapDetails->systemFree == NULL || pHeapDetails->systemPageSize == NULL)
-		{
-			MemoryWarning(pHeapDetails->systemAllocator, JRSMEMORYERROR_HEAPSYSTEMALLOCATOR, "The heap detail system allocator is not null.  It will be overridden.");
-			MemoryWarning(pHeapDetails->systemFree, JRSMEMORYERROR_HEAPSYSTEMALLOCATOR, "The heap detail system allocator is not null.  It will be overridden.");
-			MemoryWarning(pHeapDetails->systemPageSize, JRSMEMORYERROR_HEAPSYSTEMALLOCATOR, "The heap detail system allocator is not null.  It will be overridden.");
-
-			pHeapDetails->systemAllocator = m_MemoryManagerDefaultAllocator;
-			pHeapDetails->systemFree = m_MemoryManagerDefaultFree;
-			pHeapDetails->systemPageSize = m_MemoryManagerDefaultSystemPageSize;
-		}
+		return NULL;
+	}
 
-		// Lock
-		m_MMThreadLock.Lock();
+	//  Description:
+	//      Returns the name of a heap held in a registry.
+	//  See Also:
+	//      FindHeapSlot
+	//  Arguments:
+	//      rRegistry - Registry the heap belongs to.
+	//		pHeap - Heap.
+	//  Return Value:
+	//      Null terminated heap name.
+	//  Summary:
+	//      Returns the name of a registry heap.
+	const jrs_i8 *cMemoryManager::GetHeapSlotName(const sHeapRegistry &rRegistry, void *pHeap) const
+	{
+		if(&rRegistry == &m_NIHeapRegistry)
+			return ((cHeapNonIntrusive *)pHeap)->GetName();
 
-		// Check if the heap with the same name has already been created.
-		cHeap *pHeap = FindHeap(pHeapName);
-		if(pHeap)
-		{
-			MemoryWarning(0, JRSMEMORYERROR_HEAPNAME, "Memory manager cannot create two heaps with the same name.");
-			// UnLock
-			m_MMThreadLock.Unlock();
-			return 0;
-		}
+		return ((cHeap *)pHeap)->m_HeapName;
+	}
 
-		// Check if we can create it
-		if(!pHeapDetails->bHeapIsSelfManaged && !m_bAllowHeapCreationFromAddress)
+	//  Description:
+	//      Hashes a heap name for the registry name buckets.  FNV-1a.
+	//  See Also:
+	//      FindHeapSlot
+	//  Arguments:
+	//      pName - Null terminated heap name.
+	//  Return Value:
+	//      Hash of the name.
+	//  Summary:
+	//      Hashes a heap name.
+	jrs_u32 cMemoryManager::HashHeapName(const jrs_i8 *pName)
+	{
+		jrs_u32 uHash = 2166136261u;
+		while(*pName)
 		{
-			MemoryWarning(!(!pHeapDetails->bHeapIsSelfManaged && !m_bAllowHeapCreationFromAddress), JRSMEMORYERROR_HEAPSELFMANAGED, "Cannot create a self managed heap.  See cHeap::sHeapDetails::bHeapIsSelfManaged flag for details.");
-			return 0;
+			uHash ^= (jrs_u8)*pName++;
+			uHash *= 16777619u;
 		}
-		
-		// Is the heap memory manager micromanaged?
-		if(!pHeapDetails->bHeapIsSelfManaged)
-		{
-			// Set the correct heap up			
-			for(jrs_u32 uHeap = 0; uHeap < MemoryManager_MaxHeaps; uHeap++)
-			{
-				// Find an empty heap
-				if(!m_pHeaps[uHeap])
-				{
-					jrs_u32 HeapNumber = uHeap;
-
-					// Found
-					m_uHeapNum++;
 
-					// Ensure the pointer we are setting is 0.
-					MemoryWarning(!m_pHeaps[HeapNumber], JRSMEMORYERROR_FATAL, "Pointer must be 0.  Fatal error.");
+		return uHash;
+	}
 
-					// If the heap size is 0 then it will expand to the whole buffer (resizable doesnt need this check as we pass it in).
-					if(!m_bResizeable)
-					{
-						MemoryWarning(GetFreeUsableMemory() >= uHeapSize, JRSMEMORYERROR_ELEPHANTOOM, "Cannot allocate the heap.  Out of memory.");
-					}
+	//  Description:
+	//      Allocates system memory for the heap registry or range table.  The block is kept on a list and only freed in Destroy so threads
+	//		reading an old table without the lock never see freed memory.  Blocks are 128 byte aligned.
+	//  See Also:
+	//      FreeRegistryBlocks
+	//  Arguments:
+	//      uSize - Size in bytes.
+	//		uLocksOffset - Offset in bytes of the thread locks to construct in the block.
+	//		uNumLocks - Number of thread locks to construct.  0 for none.
+	//  Return Value:
+	//      The memory or NULL if the system allocator failed.
+	//  Summary:
+	//      Allocates system memory for the heap registry.
+	void *cMemoryManager::AllocateRegistryBlock(jrs_u64 uSize, jrs_u64 uLocksOffset, jrs_u32 uNumLocks)
+	{
+		const jrs_u64 uHeaderSize = (sizeof(sRegistryBlock) + 127) & ~127;
+		uSize = (uSize + uHeaderSize + (m_uSystemPageSize - 1)) & ~((jrs_u64)m_uSystemPageSize - 1);
 
-					// Now create it.
-					m_pMemoryHeaps[HeapNumber] = cHeap(pMemoryAddress, (jrs_sizet)uHeapSize, pHeapName, pHeapDetails);	
-					m_pMemoryHeaps[HeapNumber].m_pThreadLock = &g_ThreadLocks[HeapNumber];
-					m_pHeaps[HeapNumber] = &m_pMemoryHeaps[HeapNumber];
+		sRegistryBlock *pBlock = (sRegistryBlock *)m_MemoryManagerDefaultAllocator(uSize, NULL);
+		if(!pBlock)
+		{
+			MemoryWarning(pBlock, JRSMEMORYERROR_ELEPHANTOOM, "Could not allocate %lld bytes for the heap registry.", uSize);
+			return NULL;
+		}
 
-					// Set the unique id
-					m_pHeaps[HeapNumber]->m_uHeapId = m_uHeapIdInfo++;
+		jrs_i8 *pMemory = (jrs_i8 *)pBlock + uHeaderSize;
+		pBlock->pNext = m_pRegistryBlocks;
+		pBlock->uSize = uSize;
+		pBlock->pLocks = (JRSMemory_ThreadLock *)(pMemory + uLocksOffset);
+		pBlock->uNumLocks = uNumLocks;
+		for(jrs_u32 i = 0; i < uNumLocks; i++)
+			new (&pBlock->pLocks[i]) JRSMemory_ThreadLock();
+		m_pRegistryBlocks = pBlock;
 
-					// UnLock
-					m_MMThreadLock.Unlock();
+		return pMemory;
+	}
 
-					return m_pHeaps[HeapNumber];
-				}
-			}
+	//  Description:
+	//      Frees every block allocated by AllocateRegistryBlock and destroys the locks in them.  Only called from Destroy.
+	//  See Also:
+	//      AllocateRegistryBlock
+	//  Arguments:
+	//      None
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Frees the heap registry memory.
+	void cMemoryManager::FreeRegistryBlocks(void)
+	{
+		while(m_pRegistryBlocks)
+		{
+			sRegistryBlock *pBlock = m_pRegistryBlocks;
+			m_pRegistryBlocks = pBlock->pNext;
 
-			MemoryWarning(0, JRSMEMORYERROR_NOTENOUGHHEAPS, "Out of free heaps");
-			m_MMThreadLock.Unlock();
-				
-			return 0;			
+			for(jrs_u32 i = 0; i < pBlock->uNumLocks; i++)
+				pBlock->pLocks[i].~JRSMemory_ThreadLock();
+			m_MemoryManagerDefaultFree(pBlock, pBlock->uSize);
 		}
-		else
-		{
-			// Cannot init a user heap thats smaller than the minimum
-			if((sizeof(sFreeBlock) + sizeof(sAllocatedBlock) + pHeapDetails->uMinAllocationSize) > uHeapSize)
-			{
-				MemoryWarning((sizeof(sFreeBlock) + sizeof(sAllocatedBlock) + pHeapDetails->uMinAllocationSize) < uHeapSize, JRSMEMORYERROR_HEAPTOSMALL, "User heap size is to small.  Must be %d bytes.", (sizeof(sFreeBlock) + sizeof(sAllocatedBlock) + pHeapDetails->uMinAllocationSize));
-				// UnLock
-				m_MMThreadLock.Unlock();
-				return 0;
-			}
+		m_pHeapRanges = NULL;
+	}
 
-			// The heap is user managed but we will register with the memory manager for debugging reasons.
-			// Set the correct heap up
-			jrs_u32 HeapNumber = m_uUserHeapNum;
-			if(HeapNumber >= MemoryManager_MaxUserHeaps)
-			{
-				MemoryWarning(HeapNumber < MemoryManager_MaxUserHeaps, JRSMEMORYERROR_NOTENOUGHUSERHEAPS, "Out of user heaps");
-				// UnLock
-				m_MMThreadLock.Unlock();
-				return 0;
-			}
-			m_uUserHeapNum++;
+	//  Description:
+	//      Makes sure the range table has room for uCount more ranges.  A larger table is published as a copy so readers of the old one are
+	//		unaffected.  m_MMThreadLock must be held.
+	//  See Also:
+	//      AddHeapRange
+	//  Arguments:
+	//      uCount - Number of ranges about to be added.
+	//  Return Value:
+	//      TRUE if there is room.
+	//		FALSE if the system allocator failed.
+	//  Summary:
+	//      Reserves room in the heap range table.
+	jrs_bool cMemoryManager::ReserveHeapRanges(jrs_u32 uCount)
+	{
+		sHeapRangeTable *pTable = m_pHeapRanges;
+		jrs_u32 uNumRanges = pTable ? pTable->uNumRanges : 0;
+		if(pTable && uNumRanges + uCount <= pTable->uMaxRanges)
+			return TRUE;
 
-			// Find the first free one.  This is because user heaps can be freed in any order.
-			for(jrs_u32 i = 0; i < MemoryManager_MaxUserHeaps; i++)
-			{
-				if(!m_pUserHeaps[i])
-				{
-					HeapNumber = i;
-					break;
-				}
-			}
+		jrs_u32 uMaxRanges = pTable ? pTable->uMaxRanges * 2 : 64;
+		while(uMaxRanges < uNumRanges + uCount)
+			uMaxRanges *= 2;
 
-			// Now create it.
-			MemoryWarning(!m_pUserHeaps[HeapNumber], JRSMEMORYERROR_FATAL, "Fatal error in user heap allocation.  Report a bug.");
-			m_pMemoryUserHeaps[HeapNumber] = cHeap(pMemoryAddress, (jrs_sizet)uHeapSize, pHeapName, pHeapDetails);		m_pMemoryHeaps[MemoryManager_MaxHeaps + HeapNumber].m_pThreadLock = &g_ThreadLocks[MemoryManager_MaxHeaps + HeapNumber];
-			m_pUserHeaps[HeapNumber] = &m_pMemoryUserHeaps[HeapNumber];
+		sHeapRangeTable *pNewTable = (sHeapRangeTable *)AllocateRegistryBlock(sizeof(sHeapRangeTable) + sizeof(sHeapRange) * (jrs_u64)(uMaxRanges - 1), 0, 0);
+		if(!pNewTable)
+			return FALSE;
 
-			// Set the unique id
-			m_pUserHeaps[HeapNumber]->m_uHeapId = m_uHeapIdInfo++;
+		pNewTable->uMaxRanges = uMaxRanges;
+		pNewTable->uNumRanges = uNumRanges;
+		if(uNumRanges)
+			memcpy(pNewTable->Ranges, pTable->Ranges, sizeof(sHeapRange) * uNumRanges);
+		JRSMemoryBarrier();
+		m_pHeapRanges = pNewTable;
 
-			// UnLock
-			m_MMThreadLock.Unlock();
-			return m_pUserHeaps[HeapNumber];
-		}
+		return TRUE;
 	}
 
 	//  Description:
-	//      Creates a non intrusive heap. Use this type of create heap to direct to other predefined areas of the system for 
-	//		memory types such as VRAM that the CPU has limited access to.
+	//      Adds a block of heap memory to the range table used to find the heap of an address.  Ranges are sorted by start address and equal
+	//		starts put the largest end first.
 	//  See Also:
-	//      Initialize, DestroyHeap, cHeap::sHeapDetails
+	//      RemoveHeapRanges, FindHeapRange
 	//  Arguments:
-	//		pMemoryAddress - The memory address to create the heap on.  May be other addressable areas not accessible via CPU like
-	//						like VRAM. 
-	//      uHeapSize - The total size in bytes of the heap.  16byte multiple.
-	//      pHeapName - Null terminated string for the heap name. Smaller than 32bytes.
-	//      pHeapDetails - A valid pointer to heap details which can be created locally on the stack.  Its lifetime is
-	//					  only the length of CreateHeap function.
+	//      pHeap - Owning heap or NULL.
+	//		pNIHeap - Owning non intrusive heap or NULL.
+	//		pStart - Start of the block.
+	//		pEnd - End of the block.
 	//  Return Value:
-	//      Valid cHeap if successful.
-	//		NULL for failure.
+	//      TRUE if successful.
+	//		FALSE if the table could not grow.
 	//  Summary:
-	//      Creates a NI non resizable intrusive heap.
-	cHeapNonIntrusive *cMemoryManager::CreateNonIntrusiveHeap(void *pMemoryAddress, jrs_sizet uHeapSize, cHeap *pHeap, const jrs_i8 *pHeapName, cHeapNonIntrusive::sHeapDetails *pHeapDetails)
+	//      Adds a heap address range.
+	jrs_bool cMemoryManager::AddHeapRange(cHeap *pHeap, cHeapNonIntrusive *pNIHeap, void *pStart, void *pEnd)
 	{
-		MemoryWarning(pHeap, JRSMEMORYERROR_HEAPINVALID, "Heap must be valid");
-
-		if(!pMemoryAddress)
-		{
-			MemoryWarning(pMemoryAddress, JRSMEMORYERROR_INVALIDADDRESS, "pMemoryAddress must be a pointer to a valid memory block.");
-			return NULL;
-		}
-		
-		cHeapNonIntrusive::sHeapDetails details;
-		if(!pHeapDetails)
-			pHeapDetails = &details;
-
-		if(pHeapDetails->bResizable)
-		{
-			MemoryWarning(!pHeapDetails->bResizable, JRSMEMORYERROR_INVALIDARGUMENTS, "Cannot create this style heap with bResizable set.");
-			return NULL;
-		}
-
-		// Lock
 		m_MMThreadLock.Lock();
-
-		// Check if the heap with the same name has already been created.
-		cHeapNonIntrusive *pHeapNI = FindNonIntrusiveHeap(pHeapName);
-		if(pHeapNI)
+		if(!ReserveHeapRanges(1))
 		{
-			MemoryWarning(0, JRSMEMORYERROR_HEAPNAME, "Memory manager cannot create two heaps with the same name.");
-			// UnLock
 			m_MMThreadLock.Unlock();
-			return 0;
+			return FALSE;
 		}
 
-		// Check we can create a heap
-		if(m_uNonIntrusiveHeapNum >= MemoryManager_MaxNonIntrusiveHeaps)
+		// Find where it goes
+		sHeapRangeTable *pTable = m_pHeapRanges;
+		sHeapRange *pRanges = pTable->Ranges;
+		jrs_u32 uLow = 0;
+		jrs_u32 uHigh = pTable->uNumRanges;
+		while(uLow < uHigh)
 		{
-			MemoryWarning(m_uNonIntrusiveHeapNum < MemoryManager_MaxNonIntrusiveHeaps, JRSMEMORYERROR_NOTENOUGHNONINTRUSIVEHEAPS, "Out of non intrusive heaps");
-			// UnLock
-			m_MMThreadLock.Unlock();
-			return NULL;
+			jrs_u32 uMid = (uLow + uHigh) >> 1;
+			if(pRanges[uMid].pStart < (jrs_i8 *)pStart || (pRanges[uMid].pStart == (jrs_i8 *)pStart && pRanges[uMid].pEnd >= (jrs_i8 *)pEnd))
+				uLow = uMid + 1;
+			else
+				uHigh = uMid;
 		}
 
-		// Find an empty heap space
-		for(jrs_u32 i = 0; i < MemoryManager_MaxNonIntrusiveHeaps; i++)
-		{
-			if(!m_pNonInstrusiveHeaps[i])
-			{
-				// Create it
-				m_pMemoryNonIntrusiveHeaps[i] = cHeapNonIntrusive(pMemoryAddress, uHeapSize, pHeap, pHeapName, pHeapDetails);		
-				m_pMemoryNonIntrusiveHeaps[i].m_pThreadLock = &g_ThreadLocks[MemoryManager_MaxHeaps + MemoryManager_MaxUserHeaps + i];
-				m_pMemoryNonIntrusiveHeaps[i].m_bSelfManaged = true;
-				m_pMemoryNonIntrusiveHeaps[i].m_uHeapId = m_uHeapIdInfo++;
-				m_pNonInstrusiveHeaps[i] = &m_pMemoryNonIntrusiveHeaps[i];
-
-				m_uNonIntrusiveHeapNum++;
-
-				// Unlock
-				m_MMThreadLock.Unlock();
+		m_uHeapRangeSequence++;
+		JRSMemoryBarrier();
 
-				return m_pNonInstrusiveHeaps[i];
-			}
-		}
+		for(jrs_u32 i = pTable->uNumRanges; i > uLow; i--)
+			pRanges[i] = pRanges[i - 1];
+		pRanges[uLow].pStart = (jrs_i8 *)pStart;
+		pRanges[uLow].pEnd = (jrs_i8 *)pEnd;
+		pRanges[uLow].pHeap = pHeap;
+		pRanges[uLow].pNIHeap = pNIHeap;
+		pTable->uNumRanges++;
+		UpdateHeapRangeMaxEnd(uLow);
 
-		// Unlock
+		JRSMemoryBarrier();
+		m_uHeapRangeSequence++;
 		m_MMThreadLock.Unlock();
 
-		return NULL;
+		return TRUE;
 	}
 
 	//  Description:
-	//      Creates a non intrusive heap. Use this type of create heap to direct to other predefined areas of the system for 
-	//		memory types such as VRAM that the CPU has limited access to.
+	//      Removes the ranges of a heap from the range table.
 	//  See Also:
-	//      Initialize, DestroyHeap, cHeap::sHeapDetails
+	//      AddHeapRange
 	//  Arguments:
-	//		pMemoryAddress - The memory address to create the heap on.  May be other addressable areas not accessible via CPU like
-	//						like VRAM. 
-	//      uHeapSize - The total size in bytes of the heap.  16byte multiple.
-	//      pHeapName - Null terminated string for the heap name. Smaller than 32bytes.
-	//      pHeapDetails - A valid pointer to heap details which can be created locally on the stack.  Its lifetime is
-	//					  only the length of CreateHeap function.
+	//      pHeap - Owning heap or non intrusive heap.
+	//		pStart - Start of the block to remove.  NULL removes every range of the heap.
 	//  Return Value:
-	//      Valid cHeap if successful.
-	//		NULL for failure.
+	//      None
 	//  Summary:
-	//      Creates a NI non intrusive heap.
-	cHeapNonIntrusive *cMemoryManager::CreateNonIntrusiveHeap(jrs_sizet uHeapSize, cHeap *pHeap, const jrs_i8 *pHeapName, cHeapNonIntrusive::sHeapDetails *pHeapDetails)
+	//      Removes heap address ranges.
+	void cMemoryManager::RemoveHeapRanges(void *pHeap, void *pStart)
 	{
-		MemoryWarning(pHeap, JRSMEMORYERROR_HEAPINVALID, "Heap must be valid");
-
-		cHeapNonIntrusive::sHeapDetails details;
-		if(!pHeapDetails)
-			pHeapDetails = &details;
-
-		// Lock
 		m_MMThreadLock.Lock();
-
-		// Check if the heap with the same name has already been created.
-		cHeapNonIntrusive *pHeapNI = FindNonIntrusiveHeap(pHeapName);
-		if(pHeapNI)
+		sHeapRangeTable *pTable = m_pHeapRanges;
+		if(!pTable)
 		{
-			MemoryWarning(0, JRSMEMORYERROR_HEAPNAME, "Memory manager cannot create two heaps with the same name.");
-			// UnLock
 			m_MMThreadLock.Unlock();
-			return 0;
+			return;
 		}
 
-		// Check we can create a heap
-		if(m_uNonIntrusiveHeapNum >= MemoryManager_MaxNonIntrusiveHeaps)
-		{
-			MemoryWarning(m_uNonIntrusiveHeapNum < MemoryManager_MaxNonIntrusiveHeaps, JRSMEMORYERROR_NOTENOUGHNONINTRUSIVEHEAPS, "Out of non intrusive heaps");
-			// UnLock
-			m_MMThreadLock.Unlock();
-			return NULL;
-		}
+		m_uHeapRangeSequence++;
+		JRSMemoryBarrier();
 
-		// Find an empty heap space
-		for(jrs_u32 i = 0; i < MemoryManager_MaxNonIntrusiveHeaps; i++)
+		sHeapRange *pRanges = pTable->Ranges;
+		jrs_u32 uFirst = pTable->uNumRanges;
+		jrs_u32 uNumRanges = 0;
+		for(jrs_u32 i = 0; i < pTable->uNumRanges; i++)
 		{
-			if(!m_pNonInstrusiveHeaps[i])
+			if((pRanges[i].pHeap == pHeap || pRanges[i].pNIHeap == pHeap) && (!pStart || pRanges[i].pStart == (jrs_i8 *)pStart))
 			{
-				// Create it
-				m_pMemoryNonIntrusiveHeaps[i] = cHeapNonIntrusive(NULL, uHeapSize, pHeap, pHeapName, pHeapDetails);		
-				m_pMemoryNonIntrusiveHeaps[i].m_pThreadLock = &g_ThreadLocks[MemoryManager_MaxHeaps + MemoryManager_MaxUserHeaps + i];
-				m_pMemoryNonIntrusiveHeaps[i].m_uHeapId = m_uHeapIdInfo++;
-				m_pNonInstrusiveHeaps[i] = &m_pMemoryNonIntrusiveHeaps[i];
-				m_uNonIntrusiveHeapNum++;
-
-				// Unlock
-				m_MMThreadLock.Unlock();
-
-				return m_pNonInstrusiveHeaps[i];
+				if(uFirst > i)
+					uFirst = i;
+				continue;
 			}
+
+			pRanges[uNumRanges++] = pRanges[i];
 		}
+		pTable->uNumRanges = uNumRanges;
+		UpdateHeapRangeMaxEnd(uFirst);
 
-		// Unlock
+		JRSMemoryBarrier();
+		m_uHeapRangeSequence++;
 		m_MMThreadLock.Unlock();
-
-		return NULL;
 	}
 
-
 	//  Description:
-	//      Resizes a heap to the size you require.  For self managed heaps you must be very careful when resizing that the expansion does not trample other memory.  
-	//		Elephant has no way of detecting this.  Elephant will disallow resizing of managed heaps if it is not the last on the stack.
+	//      Changes the end of a heap range when the heap is resized.
 	//  See Also:
-	//      CreateHeap, DestroyHeap, cHeap::sHeapDetails
+	//      AddHeapRange
 	//  Arguments:
-	//		pHeap - Valid pointer to a cHeap.
-	//      uSize - The total size in bytes to resize the heap.  16byte multiple.  
+	//      pHeap - Owning heap.
+	//		pStart - Start of the range.
+	//		pEnd - New end of the range.
 	//  Return Value:
-	//      TRUE if successful.
-	//		FALSE for failure.
+	//      None
 	//  Summary:
-	//      Resizes a heap.
-	jrs_bool cMemoryManager::ResizeHeap(cHeap *pHeap, jrs_u64 uSize)
+	//      Changes the end of a heap range.
+	void cMemoryManager::SetHeapRangeEnd(void *pHeap, void *pStart, void *pEnd)
 	{
-		// Can only resize a heap if its at the end.  Its is up to the user to deal with unmanaged heaps.
-		MemoryWarning(pHeap, JRSMEMORYERROR_HEAPINVALID, "Heap must be a valid pointer.");
-
-		// Check if initialized
-		if(!m_bInitialized)
+		m_MMThreadLock.Lock();
+		sHeapRangeTable *pTable = m_pHeapRanges;
+		for(jrs_u32 i = 0; pTable && i < pTable->uNumRanges; i++)
 		{
-			MemoryWarning(m_bInitialized,  JRSMEMORYERROR_NOTINITIALIZED, "Memory manager is not initialized.");
-			return false;
-		}	
+			sHeapRange &rRange = pTable->Ranges[i];
+			if(rRange.pStart == (jrs_i8 *)pStart && (rRange.pHeap == pHeap || rRange.pNIHeap == pHeap))
+			{
+				m_uHeapRangeSequence++;
+				JRSMemoryBarrier();
 
-		// Self managed heap
-		if(!pHeap->IsMemoryManagerManaged())
-		{
-			MemoryWarning(pHeap->IsMemoryManagerManaged(), JRSMEMORYERROR_HEAPINVALIDCALL, "Heap cannot be resized with this function as it is managed by yourself.  Use cHeap::Resize().");
-			return false;
+				rRange.pEnd = (jrs_i8 *)pEnd;
+				UpdateHeapRangeMaxEnd(i);
+
+				JRSMemoryBarrier();
+				m_uHeapRangeSequence++;
+				break;
+			}
 		}
-
-		// Lock
-		m_MMThreadLock.Lock();
-
-		// Check the end block
-		if((void *)((jrs_i8 *)pHeap->m_pHeapEndAddress + sizeof(sFreeBlock)) != m_pUsableHeapMemoryStart)
-		{
-			MemoryWarning((void *)((jrs_i8 *)pHeap->m_pHeapEndAddress + sizeof(sFreeBlock)) == m_pUsableHeapMemoryStart, JRSMEMORYERROR_HEAPINVALIDFREE, "The heap is not the last heap that is self managed in the memory manager.  It cannot be resized using this method.");
-			// UnLock
-			m_MMThreadLock.Unlock();
-			return false;
-		}
-
-		// Resizing to the same size does nothing
-		if(pHeap->m_uHeapSize == uSize)
-		{
-			// UnLock
-			m_MMThreadLock.Unlock();
-			return true;
-		}
-
-		// Work out the minimum size of the heap
-		jrs_sizet MinSize = sizeof(sFreeBlock) + sizeof(sAllocatedBlock) + pHeap->m_uMinAllocSize;
-		if(uSize < MinSize)
-		{
-			MemoryWarning(uSize >= MinSize, JRSMEMORYERROR_HEAPTOSMALL, "Cannot resize the heap to %d bytes.  Minimum size to resize to is %d bytes.", uSize, MinSize);
-			// UnLock
-			m_MMThreadLock.Unlock();
-			return false;
-		}
-
-		// Check it will fit within the main memory manager.
-		jrs_i8 *pNewPointer = pHeap->m_pHeapStartAddress + uSize;
-		if(pNewPointer > (jrs_i8 *)m_pUseableMemoryEnd)
-		{
-			MemoryWarning(pNewPointer <= (jrs_i8 *)m_pUseableMemoryEnd, JRSMEMORYERROR_HEAPTOBIG, "The heap is being resized past the size of the memory managers usable memory area.  Resize has failed.");
-			// UnLock
-			m_MMThreadLock.Unlock();
-			return false;
-		}
-
-		// Move the new pointer back
-		m_pUsableHeapMemoryStart = pNewPointer;
-
-		// Resize
-		jrs_bool bPassed = pHeap->Resize((jrs_sizet)uSize);
-
-		// UnLock
-		m_MMThreadLock.Unlock();
-		return bPassed;
-	}
+		m_MMThreadLock.Unlock();
+	}
 
 	//  Description:
-	//      Resizes a heap to the end of the greatest allocated block.  Elephant will disallow resizing of self managed heaps.  Use cHeap::Resize instead.
+	//      Recalculates the running maximum end of the ranges from uFirst onwards.  Called inside a range table write.
 	//  See Also:
-	//      CreateHeap, DestroyHeap, ResizeHeap, cHeap::Resize, cHeap::sHeapDetails
+	//      FindHeapRange
 	//  Arguments:
-	//		pHeap - Valid pointer to a cHeap.
+	//      uFirst - First range that changed.
 	//  Return Value:
-	//      TRUE if successful.
-	//		FALSE for failure.
+	//      None
 	//  Summary:
-	//      Resizes a heap to the last allocation.
-	jrs_bool cMemoryManager::ResizeHeapToLastAllocation(cHeap *pHeap)
+	//      Recalculates the running maximum end of the ranges.
+	void cMemoryManager::UpdateHeapRangeMaxEnd(jrs_u32 uFirst)
 	{
-		MemoryWarning(pHeap, JRSMEMORYERROR_HEAPCREATEINVALIDPOINTER, "Heap must be a valid pointer.");
-		MemoryWarning(pHeap->IsMemoryManagerManaged(), JRSMEMORYERROR_HEAPSELFMANAGED, "Heap cannot be resized with this function as it is managed by yourself.  Use cHeap::Resize().");
-		MemoryWarning((void *)((jrs_i8 *)pHeap->m_pHeapEndAddress + sizeof(sFreeBlock)) == m_pUsableHeapMemoryStart, JRSMEMORYERROR_HEAPINVALIDFREE, "The heap is not the last heap that is self managed in the memory manager.  It cannot be resized using this method.");
-
-		// Lock
-		m_MMThreadLock.Lock();
-
-		// Work out the memory address we can resize too.
-		void *pEndPointer = (void *)((jrs_i8 *)pHeap->m_pMainFreeBlock + sizeof(sFreeBlock));
-
-		// Just make sure we havent overrun the heap.  Unlikely but you never know.
-		MemoryWarning(pEndPointer <= m_pUsableHeapMemoryStart, JRSMEMORYERROR_FATAL, "Heap has overrun the end pointer.  Serious error.");
-
-		// Check that we dont need to resize it if it fits exactly
-		if(pEndPointer == m_pUsableHeapMemoryStart)
+		sHeapRangeTable *pTable = m_pHeapRanges;
+		sHeapRange *pRanges = pTable->Ranges;
+		jrs_i8 *pMaxEnd = uFirst ? pRanges[uFirst - 1].pMaxEnd : NULL;
+		for(jrs_u32 i = uFirst; i < pTable->uNumRanges; i++)
 		{
-			// No need to size here
-			// UnLock
-			m_MMThreadLock.Unlock();
-			return true;
+			if(pRanges[i].pEnd > pMaxEnd)
+				pMaxEnd = pRanges[i].pEnd;
+			pRanges[i].pMaxEnd = pMaxEnd;
 		}
-
-		// Heap can be resized.  Resize the heap to this size.  It may be 0.
-		jrs_u64 uNewSize = (jrs_i8 *)pEndPointer - pHeap->m_pHeapStartAddress;
-		jrs_u64 uMinSize = sizeof(sFreeBlock) + sizeof(sAllocatedBlock) + pHeap->m_uMinAllocSize;
-		if(uNewSize < uMinSize)
-			uNewSize = uMinSize;
-
-		// And finally do it.
-		jrs_bool bPass = ResizeHeap(pHeap, uNewSize);
-
-		// UnLock
-		m_MMThreadLock.Unlock();
-		return bPass;
 	}
 
 	//  Description:
-	//      Finds a heap based on its name.
+	//      Finds the heap owning an address without locking.  The ranges are binary searched for the last one starting at or before the address
+	//		and then walked back while the running maximum end covers it.  The first match has the largest start so heaps created inside memory
+	//		of another heap win over the outer heap.  The search is retried if the table changed while it was read.
 	//  See Also:
-	//      GetHeap, CreateHeap
+	//      AddHeapRange, Free
 	//  Arguments:
-	//		pHeapName - Null terminated string with the heap's name.
+	//      pMemory - Address to find.
+	//		ppHeap - Receives the heap.  NULL to skip heap ranges.
+	//		ppNIHeap - Receives the non intrusive heap.  NULL to skip non intrusive ranges.
 	//  Return Value:
-	//      Valid cHeap if successful.
-	//		NULL if heap couldn't be found.
+	//      TRUE if found.
+	//		FALSE otherwise.
 	//  Summary:
-	//      Finds a heap based on its name.
-	cHeap *cMemoryManager::FindHeap(const jrs_i8 *pHeapName)
+	//      Finds the heap owning an address.
+	jrs_bool cMemoryManager::FindHeapRange(void *pMemory, cHeap **ppHeap, cHeapNonIntrusive **ppNIHeap) const
 	{
-		// Check if initialized
-		if(!m_bInitialized)
+		const jrs_i8 *pAddress = (const jrs_i8 *)pMemory;
+		cHeap *pHeap;
+		cHeapNonIntrusive *pNIHeap;
+		jrs_u32 uSequence;
+		do
 		{
-			MemoryWarning(m_bInitialized,  JRSMEMORYERROR_NOTINITIALIZED, "Memory manager is not initialized.");
-			return 0;
-		}	
+			pHeap = NULL;
+			pNIHeap = NULL;
+			uSequence = m_uHeapRangeSequence;
+			JRSMemoryBarrier();
 
-		// Scan all the heaps.
-		for(jrs_u32 i = 0; i < MemoryManager_MaxHeaps; i++)
-		{
-			// Only if valid
-			if(m_pHeaps[i])
+			const sHeapRangeTable *pTable = m_pHeapRanges;
+			if(!(uSequence & 1) && pTable)
 			{
-				if(/*strlen(m_pHeaps[i]->m_HeapName) == strlen(pHeapName) && */!strcmp(pHeapName, m_pHeaps[i]->m_HeapName))
+				// The count may be from a newer table while a writer swaps them.  The sequence check below throws that result away.
+				const sHeapRange *pRanges = pTable->Ranges;
+				jrs_u32 uLow = 0;
+				jrs_u32 uHigh = pTable->uNumRanges < pTable->uMaxRanges ? pTable->uNumRanges : pTable->uMaxRanges;
+				while(uLow < uHigh)
 				{
-					return m_pHeaps[i];
+					jrs_u32 uMid = (uLow + uHigh) >> 1;
+					if(pRanges[uMid].pStart <= pAddress)
+						uLow = uMid + 1;
+					else
+						uHigh = uMid;
 				}
-			}
-		}
 
-		// Scan all the user heaps.
-		for(jrs_u32 i = 0; i < MemoryManager_MaxUserHeaps; i++)
-		{
-			// Only if valid
-			if(m_pUserHeaps[i])
-			{
-				if(/*strlen(m_pHeaps[i]->m_HeapName) == strlen(pHeapName) && */!strcmp(pHeapName, m_pUserHeaps[i]->m_HeapName))
+				for(jrs_u32 i = uLow; i > 0 && pRanges[i - 1].pMaxEnd > pAddress; i--)
 				{
-					return m_pUserHeaps[i];
+					const sHeapRange &rRange = pRanges[i - 1];
+					if(pAddress < rRange.pEnd && ((ppHeap && rRange.pHeap) || (ppNIHeap && rRange.pNIHeap)))
+					{
+						pHeap = rRange.pHeap;
+						pNIHeap = rRange.pNIHeap;
+						break;
+					}
 				}
 			}
-		}
 
-		return 0;
+			JRSMemoryBarrier();
+		}while((uSequence & 1) || uSequence != m_uHeapRangeSequence);
+
+		if(ppHeap)
+			*ppHeap = pHeap;
+		if(ppNIHeap)
+			*ppNIHeap = pNIHeap;
+
+		return pHeap || pNIHeap;
 	}
 
 	//  Description:
-	//      Finds a non intrusive heap based on its name.
+	//      Rounds a heap region size up to the page size.  With the region cache enabled it is also rounded up to a size class so regions of
+	//		destroyed heaps fit the next heap of a similar size.  There are at least four classes per power of 2 so no more than a quarter is wasted.
 	//  See Also:
-	//      GetHeap, CreateHeap
+	//      AcquireHeapRegion, ReleaseHeapRegion
 	//  Arguments:
-	//		pHeapName - Null terminated string with the heap's name.
+	//      uSize - Size in bytes.
+	//		uPageSize - System page size of the allocator.  Power of 2.
 	//  Return Value:
-	//      Valid cHeap if successful.
-	//		NULL if heap couldn't be found.
+	//      Region size in bytes.
 	//  Summary:
-	//      Finds a non intrusive heap based on its name.
-	cHeapNonIntrusive *cMemoryManager::FindNonIntrusiveHeap(const jrs_i8 *pHeapName)
+	//      Rounds a heap region size to its size class.
+	jrs_u64 cMemoryManager::GetHeapRegionSize(jrs_u64 uSize, jrs_sizet uPageSize) const
 	{
-		// Scan all the user heaps.
-		for(jrs_u32 i = 0; i < MemoryManager_MaxNonIntrusiveHeaps; i++)
-		{
-			// Only if valid
-			if(m_pNonInstrusiveHeaps[i])
-			{
-				if(!strcmp(pHeapName, m_pNonInstrusiveHeaps[i]->GetName()))
-				{
-					return m_pNonInstrusiveHeaps[i];
-				}
-			}
-		}
+		uSize = (uSize + (uPageSize - 1)) & ~((jrs_u64)uPageSize - 1);
+		if(!m_uRegionCacheMaxSize)
+			return uSize;
 
-		return NULL;
+		jrs_u64 uStep = uPageSize;
+		while((uStep << 3) <= uSize)
+			uStep <<= 1;
+
+		return (uSize + (uStep - 1)) & ~(uStep - 1);
 	}
 
 	//  Description:
-	//      Gets a managed heap from an index
+	//      Gets system memory for a heap.  A cached region of exactly the same size from the same allocator is reused before calling the
+	//		allocator.  The newest match is taken as it is most likely to still be resident.
 	//  See Also:
-	//      GetHeap, CreateHeap
+	//      ReleaseHeapRegion, GetHeapRegionSize
 	//  Arguments:
-	//		iIndex - Index of heap, starting at 0.
+	//      uSize - Size in bytes from GetHeapRegionSize.
+	//		Allocator - System allocator of the heap.
+	//		Free - System free of the heap.
+	//		pbZeroed - Set to TRUE if the memory is known to be zero filled.
 	//  Return Value:
-	//      Valid cHeap if successful.
-	//		NULL if heap couldn't be found.
+	//      The memory or NULL if the allocator failed.
 	//  Summary:
-	//      Gets a managed heap by index.
-	cHeap *cMemoryManager::GetHeap(jrs_u32 iIndex)
+	//      Gets system memory for a heap.
+	void *cMemoryManager::AcquireHeapRegion(jrs_u64 uSize, MemoryManagerDefaultAllocator Allocator, MemoryManagerDefaultFree Free, jrs_bool *pbZeroed)
 	{
-		// Check if initialized
-		if(!m_bInitialized)
+		// An empty cache is the common case so it is checked without the lock
+		if(m_uNumCachedRegions)
 		{
-			MemoryWarning(m_bInitialized,  JRSMEMORYERROR_NOTINITIALIZED, "Memory manager is not initialized.");
-			return 0;
-		}	
-
-		MemoryWarning(iIndex < MemoryManager_MaxHeaps, JRSMEMORYERROR_NOTENOUGHHEAPS, "Heap index exceeds the number of heaps");
+			m_RegionCacheLock.Lock();
+			for(jrs_u32 i = m_uNumCachedRegions; i > 0; i--)
+			{
+				sHeapRegion &rRegion = m_RegionCache[i - 1];
+				if(rRegion.uSize == uSize && rRegion.systemAllocator == Allocator && rRegion.systemFree == Free)
+				{
+					void *pMemory = rRegion.pMemory;
+					*pbZeroed = rRegion.bZeroed;
+					m_uCachedRegionSize -= uSize;
+					m_uNumCachedRegions--;
+					memmove(&m_RegionCache[i - 1], &m_RegionCache[i], sizeof(sHeapRegion) * (m_uNumCachedRegions - (i - 1)));
+					m_RegionCacheLock.Unlock();
+					return pMemory;
+				}
+			}
+			m_RegionCacheLock.Unlock();
+		}
 
-		return m_pHeaps[iIndex];
+		*pbZeroed = (GetSystemZeroFlags(Allocator, NULL) & JRSMEMORYZEROFLAG_ALLOCATOR) != 0;
+		return Allocator(uSize, NULL);
 	}
 
 	//  Description:
-	//      Gets a self managed heap from an index.
+	//      Returns the system memory of a destroyed heap.  With the region cache enabled whole size class regions are kept for the next heap
+	//		and the oldest are freed to stay in the limits.  Regions from the default allocator have their pages released first if the cache
+	//		was initialized to do so.  Anything else goes straight back to the system.
 	//  See Also:
-	//      GetHeap, CreateHeap
+	//      AcquireHeapRegion, FlushRegionCache, InitializeRegionCache
 	//  Arguments:
-	//		iIndex - Index of heap, starting at 0.
+	//      pMemory - Start of the region.
+	//		uSize - Size of the region in bytes.
+	//		Allocator - System allocator the region came from.
+	//		Free - System free for the region.
 	//  Return Value:
-	//      Valid cHeap if successful.
-	//		NULL if heap couldn't be found.
+	//      None
 	//  Summary:
-	//      Gets a managed heap by index.
-	cHeap *cMemoryManager::GetUserHeap(jrs_u32 iIndex)
+	//      Returns the system memory of a destroyed heap.
+	void cMemoryManager::ReleaseHeapRegion(void *pMemory, jrs_u64 uSize, MemoryManagerDefaultAllocator Allocator, MemoryManagerDefaultFree Free)
 	{
-		// Check if initialized
-		if(!m_bInitialized)
+		if(!m_uRegionCacheMaxSize || uSize > m_uRegionCacheMaxSize || uSize != GetHeapRegionSize(uSize, m_uSystemPageSize))
 		{
-			MemoryWarning(m_bInitialized,  JRSMEMORYERROR_NOTINITIALIZED, "Memory manager is not initialized.");
-			return 0;
-		}	
+			Free(pMemory, uSize);
+			return;
+		}
 
-		MemoryWarning(iIndex < MemoryManager_MaxUserHeaps, JRSMEMORYERROR_NOTENOUGHUSERHEAPS, "Heap index exceeds the number of heaps");
+		// Keep the address range but give the pages back
+		jrs_bool bZeroed = FALSE;
+		if(m_bRegionCacheRelease && Allocator == m_MemoryManagerDefaultAllocator && m_MemoryManagerDefaultSystemRelease && m_MemoryManagerDefaultSystemRelease(pMemory, uSize))
+			bZeroed = (GetSystemZeroFlags(NULL, m_MemoryManagerDefaultSystemRelease) & JRSMEMORYZEROFLAG_RELEASE) != 0;
 
-		return m_pUserHeaps[iIndex];
-	}
+		m_RegionCacheLock.Lock();
 
-	//  Description:
-	//      Gets a non intrusive heap from an index.
-	//  See Also:
-	//      GetHeap, CreateHeap
-	//  Arguments:
-	//		iIndex - Index of heap, starting at 0.
-	//  Return Value:
-	//      Valid cHeap if successful.
-	//		NULL if heap couldn't be found.
-	//  Summary:
-	//      Gets a Non intrusive heap by index.
-	cHeapNonIntrusive *cMemoryManager::GetNIHeap(jrs_u32 iIndex)
-	{
-		// Check if initialized
-		if(!m_bInitialized)
+		// Make room by freeing the oldest
+		while(m_uNumCachedRegions && (m_uNumCachedRegions == MemoryManager_MaxCachedRegions || m_uCachedRegionSize + uSize > m_uRegionCacheMaxSize))
 		{
-			MemoryWarning(m_bInitialized,  JRSMEMORYERROR_NOTINITIALIZED, "Memory manager is not initialized.");
-			return 0;
-		}	
+			m_RegionCache[0].systemFree(m_RegionCache[0].pMemory, m_RegionCache[0].uSize);
+			m_uCachedRegionSize -= m_RegionCache[0].uSize;
+			m_uNumCachedRegions--;
+			memmove(&m_RegionCache[0], &m_RegionCache[1], sizeof(sHeapRegion) * m_uNumCachedRegions);
+		}
 
-		MemoryWarning(iIndex < MemoryManager_MaxNonIntrusiveHeaps, JRSMEMORYERROR_NOTENOUGHNONINTRUSIVEHEAPS, "Heap index exceeds the number of heaps");
+		sHeapRegion &rRegion = m_RegionCache[m_uNumCachedRegions];
+		rRegion.pMemory = pMemory;
+		rRegion.uSize = uSize;
+		rRegion.systemAllocator = Allocator;
+		rRegion.systemFree = Free;
+		rRegion.bZeroed = bZeroed;
+		m_uCachedRegionSize += uSize;
+		m_uNumCachedRegions++;
 
-		return m_pNonInstrusiveHeaps[iIndex];
+		m_RegionCacheLock.Unlock();
 	}
 
 	//  Description:
-	//      Destroys the specified heap. The heap can be managed or self managed. On destruction the heap may warn
-	//		you if there are any allocations remaining depending on the settings specified at creation time.
+	//      Creates a managed heap only, self managed heaps will fail creation.  A unique name may be specified and it will automatically
+	//		come out of Elephants memory created in Initialize. Use the details to customize the operation of the heap for example
+	//		to allow zero size allocations.
 	//  See Also:
-	//      GetHeap, CreateHeap
+	//      Initialize, DestroyHeap, cHeap::sHeapDetails
 	//  Arguments:
-	//		pHeap - Valid cHeap.
+	//      uHeapSize - The total size in bytes of the heap.  16byte multiple.
+	//      pHeapName - Null terminated string for the heap name. Smaller than 32bytes.
+	//      pHeapDetails - A valid pointer to heap details which can be created locally on the stack.  Its lifetime is
+	//					  only the length of CreateHeap function.  NULL will use the sHeapDetails values.
 	//  Return Value:
-	//      TRUE if successfully destroyed.
-	//		FALSE otherwise.
+	//      Valid cHeap if successful.
+	//		NULL for failure.
 	//  Summary:
-	//      Destroys a heap
-	jrs_bool cMemoryManager::DestroyHeap(cHeap *pHeap)
+	//      Creates a managed heap.
+	cHeap *cMemoryManager::CreateHeap(jrs_u64 uHeapSize, const jrs_i8 *pHeapName, cHeap::sHeapDetails *pHeapDetails)
 	{
 		// Check if initialized
-		if(!m_bInitialized || !pHeap)
+		if(!m_bInitialized)
 		{
-			MemoryWarning(pHeap, JRSMEMORYERROR_HEAPINVALID, "Heap is not valid");
-			MemoryWarning(m_bInitialized,  JRSMEMORYERROR_NOTINITIALIZED, "Memory manager is not initialized.");
-			return false;
+			MemoryWarning(m_bInitialized, JRSMEMORYERROR_NOTINITIALIZED, "Memory manager is not initialized.");
+			return 0;
 		}	
 
-		// Lock
 		m_MMThreadLock.Lock();
+		cHeap::sHeapDetails defaultdetails;
 
-		// If we are using enhanced debugging we may have pending operations so we wait for those to clear.  Warn the user.
-		if(m_bEnhancedDebugging && pHeap->m_bEnableEnhancedDebug && pHeap->m_uEDebugPending)
-		{
-			DebugOutput("cMemoryManager::DestroyHeap - Enhanced Debugging is waiting for some pending allocations to be cleared.");
+		// Create details
+		if(!pHeapDetails)
+			pHeapDetails = &defaultdetails;
 
-			volatile jrs_u32 *pPending = &pHeap->m_uEDebugPending;
-			while(*pPending)
-			{
-				JRSThread::SleepMilliSecond(16);
-			}
+		// Do we need to set defaults
+		if(pHeapDetails->systemAllocator == NULL || pHeapDetails->systemFree == NULL || pHeapDetails->systemPageSize == NULL)
+		{
+			pHeapDetails->systemAllocator = m_MemoryManagerDefaultAllocator;
+			pHeapDetails->systemFree = m_MemoryManagerDefaultFree;
+			pHeapDetails->systemPageSize = m_MemoryManagerDefaultSystemPageSize;
 		}
-		
-		// We can only destroy a heap with allocations still valid if we are allowed.  Check that here.
-		if(!pHeap->m_bAllowDestructionWithAllocations)
+		else if(!m_bResizeable)
 		{
-			if(pHeap->GetNumberOfAllocations())
-			{
-				MemoryWarning(pHeap->GetNumberOfAllocations() == 0, JRSMEMORYERROR_HEAPWITHVALIDALLOCATIONS, "Cannot free heap %s as it still has valid allocations. Set Heap flag bAllowDestructionWithAllocations to true.", pHeap->m_HeapName);
-				// UnLock
-				m_MMThreadLock.Unlock();
-				return false;
-			}
-
-			if(pHeap->m_pAttachedPools)
-			{
-				MemoryWarning(!pHeap->m_pAttachedPools, JRSMEMORYERROR_HEAPWITHVALIDPOOLS, "Cannot free heap %s as it still has valid pools. Set Heap flag bAllowDestructionWithAllocations to true.", pHeap->m_HeapName);
-			}
+			// Non resizable heaps default to cMemoryManagers
+			pHeapDetails->systemAllocator = m_MemoryManagerDefaultAllocator;
+			pHeapDetails->systemFree = m_MemoryManagerDefaultFree;
+			pHeapDetails->systemPageSize = m_MemoryManagerDefaultSystemPageSize;
 		}
 
-		// Heaps have to be destroyed with different methods depending on if they are managed or not.
-		if(pHeap->IsMemoryManagerManaged())
+		if(pHeapDetails->bHeapIsSelfManaged)
 		{
-			MemoryWarning(m_uHeapNum, JRSMEMORYERROR_HEAPINVALID, "No heap to remove");
-
-			// Find the heap
-			jrs_u32 uHeap = 0;
-			cHeap *pFHeap = NULL;
-			for(; uHeap < MemoryManager_MaxHeaps; uHeap++)
-			{
-				if(pHeap == m_pHeaps[uHeap])
-				{
-					pFHeap = pHeap;
-					break;
-				}
-			}
-			
-			// Did we match one?
-			if(!pFHeap)
-			{
-				MemoryWarning(pFHeap, JRSMEMORYERROR_HEAPINVALIDFREE, "Heap not found, could not be freed.");
-				return false;
-			}
-
-			// Now free it
-			if(m_bResizeable)
-			{
-				// Free the memory
-				pFHeap->DestroyLinkedMemory();
-			}
-			else
-			{
-				// Cannot free a managed heap if its not the last one.
-				if((void *)((jrs_i8 *)pFHeap->m_pHeapEndAddress + sizeof(sFreeBlock)) != m_pUsableHeapMemoryStart)
-				{
-					MemoryWarning((void *)((jrs_i8 *)pFHeap->m_pHeapEndAddress + sizeof(sFreeBlock)) == m_pUsableHeapMemoryStart, JRSMEMORYERROR_HEAPINVALIDFREE, "The heap is not the last heap that is self managed in the memory manager.  It cannot be removed using this method. Heap may also be a user managed heap without the user managed flag set.");
-					// UnLock
-					m_MMThreadLock.Unlock();
-					return false;
-				}
-
-				// Reduce the number of heaps
-				m_pUsableHeapMemoryStart = (jrs_i8 *)pFHeap->m_pHeapStartAddress;
-			}
-			m_uHeapNum--;
+			MemoryWarning(!pHeapDetails->bHeapIsSelfManaged, JRSMEMORYERROR_HEAPSELFMANAGED, "Cannot create a self managed heap.  Use cMemoryManager::CreateHeap(void *pMemoryAddress, u32 uHeapSize, i8 *pHeapName, cHeap::sHeapDetails *pHeapDetails)");
+			return 0;
+		}
+		
+#ifdef JRS64BIT
+		// No need to check for 64bit overflows.  Not for a few years anyway.
+#else
+		MemoryWarning(uHeapSize <= 0xffffffff, JRSMEMORYERROR_HEAPTOBIG, "Heap size can only be a maximum size of 4gb (2^32)");
+#endif
+		// Here we create the memory address and hand it to the creation function, a bit like user managed but we handle internally.
+		m_bAllowHeapCreationFromAddress = true;		// Enable creation from a specified address
 
-			cMemoryManager::Get().ContinuousLogging_Operation(cMemoryManager::eContLog_DestroyHeap, pFHeap, NULL, 0);
+		jrs_sizet uSystemPageSize = m_uSystemPageSize;
+		if(pHeapDetails->systemPageSize)
+			uSystemPageSize = pHeapDetails->systemPageSize();
 
-			// Set it to 0
-			m_pHeaps[uHeap] = 0;
-		}
-		else
+		// Resizable mode functions slightly differently
+		if(m_bResizeable)
 		{
-			// User heap.  Destroy it here.  A bit more complex and the user still has to deal with the memory used to create this heap.
-			MemoryWarning(m_uUserHeapNum, JRSMEMORYERROR_HEAPINVALID, "No heap to remove");
+			// Align the memory size to the page size but only for resizable heaps.  The region cache also rounds it to a size class.
+			uHeapSize = GetHeapRegionSize(uHeapSize, uSystemPageSize);
 
-			// Find the heap in the user list
-			jrs_u32 uHeap;
-			for(uHeap = 0; uHeap < MemoryManager_MaxUserHeaps; uHeap++)
-			{
-				if(pHeap == m_pUserHeaps[uHeap])
-					break;
-			}
+			jrs_bool bZeroed;
+			void *pMemory = AcquireHeapRegion(uHeapSize, pHeapDetails->systemAllocator, pHeapDetails->systemFree, &bZeroed);
+			
+			// Increase count			
+			m_pResizableSystemAllocs[m_uResizableCount] = (jrs_u64)pMemory;
+			m_pResizableSystemAllocs[m_uResizableCount + 1] = uHeapSize;
+			m_uResizableCount += 2;			
 
-			// Check if we found it or not
-			if(uHeap == MemoryManager_MaxUserHeaps)
-			{
-				MemoryWarning(m_uUserHeapNum, JRSMEMORYERROR_HEAPINVALID, "No heap to remove");
+			cHeap *pHeap = CreateHeap(pMemory, (jrs_sizet)uHeapSize, pHeapName, pHeapDetails);
+			if(pHeap && bZeroed)
+				pHeap->AddZeroMemory((jrs_i8 *)pMemory, (jrs_i8 *)pMemory + uHeapSize);
+			
+			// Call the system op callback if one exist.
+			if(pHeapDetails->systemOpCallback)
+				pHeapDetails->systemOpCallback(pHeap, pMemory, uHeapSize, FALSE);
 
-				// UnLock
-				m_MMThreadLock.Unlock();
-				return false;
-			}
+			m_bAllowHeapCreationFromAddress = false;			// Disable
+			m_MMThreadLock.Unlock();			
+			return pHeap;
+		}
 
-			cMemoryManager::Get().ContinuousLogging_Operation(cMemoryManager::eContLog_DestroyHeap, m_pUserHeaps[m_uHeapNum], NULL, 0);
+		//If the last heap is still null we need to create one from the start other wise we tag it on the end
+		cHeap *pHeap = CreateHeap(m_pUsableHeapMemoryStart, (jrs_sizet)uHeapSize, pHeapName, pHeapDetails);
+		if(pHeap)
+		{
+			// Memory that has never been used by another heap is still zero
+			jrs_i8 *pHeapEnd = (jrs_i8 *)m_pUsableHeapMemoryStart + uHeapSize;
+			if(m_pUsableHeapMemoryStart >= m_pUsableHeapMemoryZero)
+				pHeap->AddZeroMemory((jrs_i8 *)m_pUsableHeapMemoryStart, pHeapEnd);
+			if(pHeapEnd > (jrs_i8 *)m_pUsableHeapMemoryZero)
+				m_pUsableHeapMemoryZero = pHeapEnd;
 
-			// Remove the heap
-			m_pUserHeaps[uHeap] = 0;
-			m_uUserHeapNum--;
+			//Increment the size of the heap
+			m_pUsableHeapMemoryStart = (void *)pHeapEnd;
 		}
+		m_bAllowHeapCreationFromAddress = false;			// Disable
 
-		// UnLock
+		//Return the Heap
 		m_MMThreadLock.Unlock();
-
-		// Removed.
-		return true;
+		return pHeap;
 	}
 
 	//  Description:
-	//      Destroys the specified non intrusive heap. On destruction the heap may warn
-	//		you if there are any allocations remaining depending on the settings specified at creation time.
+	//      Creates a managed or self managed heap.  A unique name may be specified and it will automatically
+	//		come out of Elephants memory created in Initialize. Use the details to customize the operation of the heap for example
+	//		to allow zero size allocations.  Use this type of create heap to direct to other predefined areas of the system for 
+	//		memory types such as VRAM.
 	//  See Also:
-	//      GetHeap, FindHeap
+	//      Initialize, DestroyHeap, cHeap::sHeapDetails
 	//  Arguments:
-	//		pHeap - Valid cHeapNonIntrusive.
+	//		pMemoryAddress - The memory address to create the heap on.  May be other CPU accessible areas 
+	//						like VRAM. 
+	//      uHeapSize - The total size in bytes of the heap.  16byte multiple.
+	//      pHeapName - Null terminated string for the heap name. Smaller than 32bytes.
+	//      pHeapDetails - A valid pointer to heap details which can be created locally on the stack.  Its lifetime is
+	//					  only the length of CreateHeap function.
 	//  Return Value:
-	//      TRUE if successfully destroyed.
-	//		FALSE otherwise.
+	//      Valid cHeap if successful.
+	//		NULL for failure.
 	//  Summary:
-	//      Destroys a heap
-	jrs_bool cMemoryManager::DestroyNonIntrusiveHeap(cHeapNonIntrusive *pHeap)
+	//      Creates a managed heap.
+	cHeap *cMemoryManager::CreateHeap(void *pMemoryAddress, jrs_u64 uHeapSize, const jrs_i8 *pHeapName, cHeap::sHeapDetails *pHeapDetails)
 	{
+		MemoryWarning(pHeapDetails, JRSMEMORYERROR_INVALIDARGUMENTS, "pHeapDetails must be valid for this function");
+		MemoryWarning(pHeapDetails->uDefaultAlignment >= 16, JRSMEMORYERROR_INVALIDALIGN, "Default alignment must be >= 16");
+		MemoryWarning(!(pHeapDetails->uDefaultAlignment & (pHeapDetails->uDefaultAlignment - 1)), JRSMEMORYERROR_INVALIDALIGN, "Cannot create heap because the alignment is non power of 2");
+		MemoryWarning(uHeapSize >= (sizeof(sFreeBlock) + sizeof(sAllocatedBlock) + pHeapDetails->uMinAllocationSize), JRSMEMORYERROR_HEAPTOSMALL, "Heap size must be a minimum of %d bytes.  WARNING You probably want this to be atleast 128k or bigger to be useful.", sizeof(sFreeBlock) + sizeof(sAllocatedBlock) + pHeapDetails->uMinAllocationSize);
+		MemoryWarning(!(uHeapSize & 0xf), JRSMEMORYERROR_INVALIDALIGN, "Heap size must be 16byte aligned.");
+
+		// Must be a valid memory address
+		if(!pMemoryAddress)
+		{
+			MemoryWarning(pMemoryAddress, JRSMEMORYERROR_HEAPCREATEINVALIDPOINTER, "0 Memory address.  Cannot create Heap.");
+			return 0;
+		}
+
 		// Check if initialized
-		if(!m_bInitialized || !pHeap)
+		if(!m_bInitialized)
 		{
-			MemoryWarning(pHeap, JRSMEMORYERROR_HEAPINVALID, "Heap is not valid");
 			MemoryWarning(m_bInitialized,  JRSMEMORYERROR_NOTINITIALIZED, "Memory manager is not initialized.");
-			return false;
+			return 0;
 		}	
 
+		// Do we need to set defaults
+		if(pHeapDetails->systemAllocator == NULL || pHeapDetails->systemFree == NULL || pHeapDetails->systemPageSize == NULL)
+		{
+			MemoryWarning(pHeapDetails->systemAllocator, JRSMEMORYERROR_HEAPSYSTEMALLOCATOR, "The heap detail system allocator is not null.  It will be overridden.");
+			MemoryWarning(pHeapDetails->systemFree, JRSMEMORYERROR_HEAPSYSTEMALLOCATOR, "The heap detail system allocator is not null.  It will be overridden.");
+			MemoryWarning(pHeapDetails->systemPageSize, JRSMEMORYERROR_HEAPSYSTEMALLOCATOR, "The heap detail system allocator is not null.  It will be overridden.");
+
+			pHeapDetails->systemAllocator = m_MemoryManagerDefaultAllocator;
+			pHeapDetails->systemFree = m_MemoryManagerDefaultFree;
+			pHeapDetails->systemPageSize = m_MemoryManagerDefaultSystemPageSize;
+		}
+
 		// Lock
 		m_MMThreadLock.Lock();
 
-		// User heap.  Destroy it here.  A bit more complex and the user still has to deal with the memory used to create this heap.
-		MemoryWarning(m_uNonIntrusiveHeapNum, JRSMEMORYERROR_HEAPINVALID, "No heap to remove");
+		// Check if the heap with the same name has already been created.
+		cHeap *pHeap = FindHeap(pHeapName);
+		if(pHeap)
+		{
+			MemoryWarning(0, JRSMEMORYERROR_HEAPNAME, "Memory manager cannot create two heaps with the same name.");
+			// UnLock
+			m_MMThreadLock.Unlock();
+			return 0;
+		}
 
-		// Find the heap in the user list
-		jrs_u32 uHeap;
-		for(uHeap = 0; uHeap < MemoryManager_MaxNonIntrusiveHeaps; uHeap++)
+		// Check if we can create it
+		if(!pHeapDetails->bHeapIsSelfManaged && !m_bAllowHeapCreationFromAddress)
 		{
-			if(pHeap == m_pNonInstrusiveHeaps[uHeap])
-				break;
+			MemoryWarning(!(!pHeapDetails->bHeapIsSelfManaged && !m_bAllowHeapCreationFromAddress), JRSMEMORYERROR_HEAPSELFMANAGED, "Cannot create a self managed heap.  See cHeap::sHeapDetails::bHeapIsSelfManaged flag for details.");
+			return 0;
 		}
 
-		// Check if we found it or not
-		if(uHeap == MemoryManager_MaxNonIntrusiveHeaps)
+		// The heap needs an entry in the address ranges used by Free
+		if(!ReserveHeapRanges(1))
 		{
-			MemoryWarning(m_uNonIntrusiveHeapNum, JRSMEMORYERROR_HEAPINVALID, "No heap to remove");
+			m_MMThreadLock.Unlock();
+			return 0;
+		}
+		
+		// Is the heap memory manager micromanaged?
+		if(!pHeapDetails->bHeapIsSelfManaged)
+		{
+			// Take a free slot.  The registry grows when they run out.
+			jrs_u32 HeapNumber = AcquireHeapSlot(m_HeapRegistry);
+			if(HeapNumber == MemoryManager_InvalidHeapSlot)
+			{
+				MemoryWarning(0, JRSMEMORYERROR_NOTENOUGHHEAPS, "Out of free heaps");
+				m_MMThreadLock.Unlock();
+				return 0;
+			}
+
+			// Found
+			m_uHeapNum++;
+
+			// If the heap size is 0 then it will expand to the whole buffer (resizable doesnt need this check as we pass it in).
+			if(!m_bResizeable)
+			{
+				MemoryWarning(GetFreeUsableMemory() >= uHeapSize, JRSMEMORYERROR_ELEPHANTOOM, "Cannot allocate the heap.  Out of memory.");
+			}
+
+			// Now create it.
+			sHeapSlot &rSlot = m_HeapRegistry.pSlots[HeapNumber];
+			cHeap *pNewHeap = (cHeap *)rSlot.pObject;
+			*pNewHeap = cHeap(pMemoryAddress, (jrs_sizet)uHeapSize, pHeapName, pHeapDetails);	
+			pNewHeap->m_pThreadLock = rSlot.pLock;
+			pNewHeap->m_uRegistrySlot = HeapNumber;
+			RegisterHeapSlot(m_HeapRegistry, HeapNumber, pNewHeap);
+			AddHeapRange(pNewHeap, NULL, pMemoryAddress, (jrs_i8 *)pMemoryAddress + uHeapSize);
+
+			// Set the unique id.  The creation is logged with it.
+			pNewHeap->m_uHeapId = m_uHeapIdInfo++;
+			ContinuousLogging_Operation(eContLog_CreateHeap, pNewHeap, NULL, 0);
 
 			// UnLock
 			m_MMThreadLock.Unlock();
-			return false;
-		}
 
-		// We can only destroy a heap with allocations still valid if we are allowed.  Check that here.
-		if(!pHeap->m_bAllowDestructionWithAllocations)
+			return pNewHeap;
+		}
+		else
 		{
-			if(pHeap->GetNumberOfAllocations())
+			// Cannot init a user heap thats smaller than the minimum
+			if((sizeof(sFreeBlock) + sizeof(sAllocatedBlock) + pHeapDetails->uMinAllocationSize) > uHeapSize)
 			{
-				MemoryWarning(pHeap->GetNumberOfAllocations() == 0, JRSMEMORYERROR_HEAPWITHVALIDALLOCATIONS, "Cannot free heap %s as it still has valid allocations. Set Heap flag bAllowDestructionWithAllocations to true.", pHeap->m_HeapName);
+				MemoryWarning((sizeof(sFreeBlock) + sizeof(sAllocatedBlock) + pHeapDetails->uMinAllocationSize) < uHeapSize, JRSMEMORYERROR_HEAPTOSMALL, "User heap size is to small.  Must be %d bytes.", (sizeof(sFreeBlock) + sizeof(sAllocatedBlock) + pHeapDetails->uMinAllocationSize));
 				// UnLock
 				m_MMThreadLock.Unlock();
-				return false;
+				return 0;
 			}
-		}
-		cMemoryManager::Get().ContinuousLogging_NIOperation(cMemoryManager::eContLog_DestroyHeap, pHeap, NULL, 0);
 
-		// Remove the allocations
-		pHeap->Destroy();
+			// The heap is user managed but we will register with the memory manager for debugging reasons.
+			// Take a free slot.  User heaps can be freed in any order and their slots are reused.
+			jrs_u32 HeapNumber = AcquireHeapSlot(m_UserHeapRegistry);
+			if(HeapNumber == MemoryManager_InvalidHeapSlot)
+			{
+				MemoryWarning(0, JRSMEMORYERROR_NOTENOUGHUSERHEAPS, "Out of user heaps");
+				// UnLock
+				m_MMThreadLock.Unlock();
+				return 0;
+			}
+			m_uUserHeapNum++;
 
-		// Remove the heap
-		m_pNonInstrusiveHeaps[uHeap] = NULL;
-		m_uNonIntrusiveHeapNum--;
+			// Now create it.
+			sHeapSlot &rSlot = m_UserHeapRegistry.pSlots[HeapNumber];
+			cHeap *pNewHeap = (cHeap *)rSlot.pObject;
+			*pNewHeap = cHeap(pMemoryAddress, (jrs_sizet)uHeapSize, pHeapName, pHeapDetails);
+			pNewHeap->m_pThreadLock = rSlot.pLock;
+			pNewHeap->m_uRegistrySlot = HeapNumber;
+			RegisterHeapSlot(m_UserHeapRegistry, HeapNumber, pNewHeap);
+			AddHeapRange(pNewHeap, NULL, pMemoryAddress, (jrs_i8 *)pMemoryAddress + uHeapSize);
+
+			// Set the unique id.  The creation is logged with it.
+			pNewHeap->m_uHeapId = m_uHeapIdInfo++;
+			ContinuousLogging_Operation(eContLog_CreateHeap, pNewHeap, NULL, 0);
 
-		m_MMThreadLock.Unlock();
-		return TRUE;
+			// UnLock
+			m_MMThreadLock.Unlock();
+			return pNewHeap;
+		}
 	}
 
 	//  Description:
-	//      Returns the heap where the memory address lies.  Can be useful for finding out general information of where memory came from.  Does not need to be an allocated address,
-	//		any will do.
+	//      Creates a non intrusive heap. Use this type of create heap to direct to other predefined areas of the system for 
+	//		memory types such as VRAM that the CPU has limited access to.
 	//  See Also:
-	//      
+	//      Initialize, DestroyHeap, cHeap::sHeapDetails
 	//  Arguments:
-	//		pMemory - Memory address to search heaps against.
+	//		pMemoryAddress - The memory address to create the heap on.  May be other addressable areas not accessible via CPU like
+	//						like VRAM. 
+	//      uHeapSize - The total size in bytes of the heap.  16byte multiple.
+	//      pHeapName - Null terminated string for the heap name. Smaller than 32bytes.
+	//      pHeapDetails - A valid pointer to heap details which can be created locally on the stack.  Its lifetime is
+	//					  only the length of CreateHeap function.
 	//  Return Value:
-	//      A valid cHeap pointer if a heap contains the memory location.  NULL otherwise.
+	//      Valid cHeap if successful.
+	//		NULL for failure.
 	//  Summary:
-	//      Returns a valid Heap where the memory address lies.
-	cHeap *cMemoryManager::FindHeapFromMemoryAddress(void *pMemory) const
+	//      Creates a NI non resizable intrusive heap.
+	cHeapNonIntrusive *cMemoryManager::CreateNonIntrusiveHeap(void *pMemoryAddress, jrs_sizet uHeapSize, cHeap *pHeap, const jrs_i8 *pHeapName, cHeapNonIntrusive::sHeapDetails *pHeapDetails)
 	{
-		// Do the user heaps first.  Sounds odd but the user heaps MAY come from the main heap.  Then any data that gets free'd through this function
-		// will corrupt that main heap as it will be detected from that heap.
-		for(jrs_u32 i = MemoryManager_MaxUserHeaps; i > 0; i--)
+		MemoryWarning(pHeap, JRSMEMORYERROR_HEAPINVALID, "Heap must be valid");
+
+		if(!pMemoryAddress)
 		{
-			if(m_pUserHeaps[i - 1] && m_pUserHeaps[i - 1]->IsAllocatedFromThisHeap(pMemory))
-			{
-				return m_pUserHeaps[i - 1];
-			}
+			MemoryWarning(pMemoryAddress, JRSMEMORYERROR_INVALIDADDRESS, "pMemoryAddress must be a pointer to a valid memory block.");
+			return NULL;
 		}
 		
-		// Find out what heap it is from.  Done in reverse because typically they will be done on the last heap using these methods.  This will
-		// also catch the small heap.
-		for(jrs_u32 i = MemoryManager_MaxHeaps; i > 0; i--)
+		cHeapNonIntrusive::sHeapDetails details;
+		if(!pHeapDetails)
+			pHeapDetails = &details;
+
+		if(pHeapDetails->bResizable)
 		{
-			if(m_pHeaps[i - 1] && m_pHeaps[i - 1]->IsAllocatedFromThisHeap(pMemory))
-			{
-				return m_pHeaps[i - 1];
-			}
+			MemoryWarning(!pHeapDetails->bResizable, JRSMEMORYERROR_INVALIDARGUMENTS, "Cannot create this style heap with bResizable set.");
+			return NULL;
 		}
 
-		return NULL;
-	}
+		// Lock
+		m_MMThreadLock.Lock();
 
-	//  Description:
-	//      Returns the heap where the memory address lies.  Can be useful for finding out general information of where memory came from.  Does not need to be an allocated address,
-	//		any will do.
-	//  See Also:
-	//      
-	//  Arguments:
-	//		pMemory - Memory address to search heaps against.
-	//  Return Value:
-	//      A valid cHeapNonIntrusive pointer if a heap contains the memory location.  NULL otherwise.
-	//  Summary:
-	//      Returns a valid NI Heap where the memory address lies.
-	cHeapNonIntrusive *cMemoryManager::FindNIHeapFromMemoryAddress(void *pMemory) const
-	{
-		for(jrs_u32 i = MemoryManager_MaxNonIntrusiveHeaps; i > 0; i--)
+		// Check if the heap with the same name has already been created.
+		cHeapNonIntrusive *pHeapNI = FindNonIntrusiveHeap(pHeapName);
+		if(pHeapNI)
 		{
-			if(m_pNonInstrusiveHeaps[i - 1] && m_pNonInstrusiveHeaps[i - 1]->IsAllocatedFromThisHeap(pMemory))
-			{
-				return m_pNonInstrusiveHeaps[i - 1];
-			}
+			MemoryWarning(0, JRSMEMORYERROR_HEAPNAME, "Memory manager cannot create two heaps with the same name.");
+			// UnLock
+			m_MMThreadLock.Unlock();
+			return 0;
 		}
 
-		return NULL;
-	}
-
-	//  Description:
-	//      Gets the default heap allocations will go into when calling cMemoryManager::Malloc.
-	//  See Also:
-	//		SetMallocDefaultHeap
-	//  Arguments:
-	//      None
-	//  Return Value:
-	//      Valid cHeap pointer or NULL.
-	//  Summary:	
-	//		Gets the default heap allocations will go into when calling cMemoryManager::Malloc.
-	cHeap *cMemoryManager::GetDefaultHeap(void)
-	{
-		// Check to ensure valid heap
-		if(!m_uHeapNum)
+		// Take a free slot.  The registry grows when they run out.  The first slab needs an address range.
+		jrs_u32 uSlot = ReserveHeapRanges(1) ? AcquireHeapSlot(m_NIHeapRegistry) : MemoryManager_InvalidHeapSlot;
+		if(uSlot == MemoryManager_InvalidHeapSlot)
 		{
-			MemoryWarning(m_uHeapNum, JRSMEMORYERROR_NOVALIDHEAP, "No valid heap. Use CreateHeap to create one.");
+			MemoryWarning(0, JRSMEMORYERROR_NOTENOUGHNONINTRUSIVEHEAPS, "Out of non intrusive heaps");
+			// UnLock
+			m_MMThreadLock.Unlock();
 			return NULL;
 		}
 
-		// Use the user set heap
-		if(m_bOverrideMallocHeap)
-			return m_pDefaultMallocHeap;
+		// Create it
+		sHeapSlot &rSlot = m_NIHeapRegistry.pSlots[uSlot];
+		cHeapNonIntrusive *pNewHeap = (cHeapNonIntrusive *)rSlot.pObject;
+		*pNewHeap = cHeapNonIntrusive(pMemoryAddress, uHeapSize, pHeap, pHeapName, pHeapDetails);		
+		pNewHeap->m_pThreadLock = rSlot.pLock;
+		pNewHeap->m_bSelfManaged = true;
+		pNewHeap->m_uHeapId = m_uHeapIdInfo++;
+		pNewHeap->m_uRegistrySlot = uSlot;
+		RegisterHeapSlot(m_NIHeapRegistry, uSlot, pNewHeap);
+		m_uNonIntrusiveHeapNum++;
+		ContinuousLogging_NIOperation(eContLog_CreateHeap, pNewHeap, NULL, 0);
+
+		// Slabs added from now on register themselves
+		for(jrs_u32 i = 0; i < pNewHeap->m_uNumSlabs; i++)
+			AddHeapRange(NULL, pNewHeap, pNewHeap->m_Slabs[i].pBase, (jrs_i8 *)pNewHeap->m_Slabs[i].pBase + pNewHeap->m_Slabs[i].uSize);
 
-		return &m_pMemoryHeaps[m_uHeapNum - 1];
+		// Unlock
+		m_MMThreadLock.Unlock();
+
+		return pNewHeap;
 	}
 
 	//  Description:
-	//      Resets any heap statistics that have accrued since either Initialization or the last time this function was called.
+	//      Creates a non intrusive heap. Use this type of create heap to direct to other predefined areas of the system for 
+	//		memory types such as VRAM that the CPU has limited access to.
 	//  See Also:
-	//      cHeap::ResetStatistics
+	//      Initialize, DestroyHeap, cHeap::sHeapDetails
 	//  Arguments:
-	//		None.
+	//		pMemoryAddress - The memory address to create the heap on.  May be other addressable areas not accessible via CPU like
+	//						like VRAM. 
+	//      uHeapSize - The total size in bytes of the heap.  16byte multiple.
+	//      pHeapName - Null terminated string for the heap name. Smaller than 32bytes.
+	//      pHeapDetails - A valid pointer to heap details which can be created locally on the stack.  Its lifetime is
+	//					  only the length of CreateHeap function.
 	//  Return Value:
-	//      Nothing.
+	//      Valid cHeap if successful.
+	//		NULL for failure.
 	//  Summary:
-	//      Resets all heap statistics.
-	void cMemoryManager::ResetHeapStatistics(void)
+	//      Creates a NI non intrusive heap.
+	cHeapNonIntrusive *cMemoryManager::CreateNonIntrusiveHeap(jrs_sizet uHeapSize, cHeap *pHeap, const jrs_i8 *pHeapName, cHeapNonIntrusive::sHeapDetails *pHeapDetails)
 	{
-		for(jrs_u32 i = MemoryManager_MaxUserHeaps; i > 0; i--)
+		MemoryWarning(pHeap, JRSMEMORYERROR_HEAPINVALID, "Heap must be valid");
+
+		cHeapNonIntrusive::sHeapDetails details;
+		if(!pHeapDetails)
+			pHeapDetails = &details;
+
+		// Lock
+		m_MMThreadLock.Lock();
+
+		// Check if the heap with the same name has already been created.
+		cHeapNonIntrusive *pHeapNI = FindNonIntrusiveHeap(pHeapName);
+		if(pHeapNI)
 		{
-			if(m_pUserHeaps[i - 1])
-			{
-				m_pUserHeaps[i - 1]->ResetStatistics();
-			}
+			MemoryWarning(0, JRSMEMORYERROR_HEAPNAME, "Memory manager cannot create two heaps with the same name.");
+			// UnLock
+			m_MMThreadLock.Unlock();
+			return 0;
 		}
 
-		for(jrs_u32 i = MemoryManager_MaxNonIntrusiveHeaps; i > 0; i--)
+		// Take a free slot.  The registry grows when they run out.  The first slab needs an address range.
+		jrs_u32 uSlot = ReserveHeapRanges(1) ? AcquireHeapSlot(m_NIHeapRegistry) : MemoryManager_InvalidHeapSlot;
+		if(uSlot == MemoryManager_InvalidHeapSlot)
 		{
-			if(m_pNonInstrusiveHeaps[i - 1])
-			{
-				m_pNonInstrusiveHeaps[i - 1]->ResetStatistics();
-			}
+			MemoryWarning(0, JRSMEMORYERROR_NOTENOUGHNONINTRUSIVEHEAPS, "Out of non intrusive heaps");
+			// UnLock
+			m_MMThreadLock.Unlock();
+			return NULL;
 		}
 
-		for(jrs_u32 i = MemoryManager_MaxHeaps; i > 0; i--)
-		{
-			if(m_pHeaps[i - 1])
-			{
-				m_pHeaps[i - 1]->ResetStatistics();
-			}
-		}		
+		// Create it
+		sHeapSlot &rSlot = m_NIHeapRegistry.pSlots[uSlot];
+		cHeapNonIntrusive *pNewHeap = (cHeapNonIntrusive *)rSlot.pObject;
+		*pNewHeap = cHeapNonIntrusive(NULL, uHeapSize, pHeap, pHeapName, pHeapDetails);		
+		pNewHeap->m_pThreadLock = rSlot.pLock;
+		pNewHeap->m_uHeapId = m_uHeapIdInfo++;
+		pNewHeap->m_uRegistrySlot = uSlot;
+		RegisterHeapSlot(m_NIHeapRegistry, uSlot, pNewHeap);
+		m_uNonIntrusiveHeapNum++;
+		ContinuousLogging_NIOperation(eContLog_CreateHeap, pNewHeap, NULL, 0);
+
+		// Slabs added from now on register themselves
+		for(jrs_u32 i = 0; i < pNewHeap->m_uNumSlabs; i++)
+			AddHeapRange(NULL, pNewHeap, pNewHeap->m_Slabs[i].pBase, (jrs_i8 *)pNewHeap->m_Slabs[i].pBase + pNewHeap->m_Slabs[i].uSize);
+
+		// Unlock
+		m_MMThreadLock.Unlock();
+
+		return pNewHeap;
 	}
 
 	//  Description:
-	//      Replaces standard system malloc but allows for more advanced allocation parameters such as alignment. Malloc will
-	//		automatically send the allocation to the last created heap, unless a small heap is specified.  If a small heap is
-	//		specified and the allocation size is <= the maximum allocation size of the small heap the small heap will try to allocate.
-	//		Flags are set by the user.  It can be one of JRSMEMORYFLAG_xxx or any user specified flags > JRSMEMORYFLAG_RESERVED3
-	//		but smaller than or equal to 15, values greater than 15 will be lost and operation of Malloc is undefined.  Input text is
-	//		limited to 32 chars including terminator.  Strings longer than this will only store the last 31 chars.
+	//      Creates a scratch heap for short lived work.  The heap, its lock and its memory share one system region which comes from the region
+	//		cache when a region of the same size class is available.  Creation and destruction do not take the memory manager lock or register
+	//		the heap unless continuous logging, LiveView or enhanced debugging is enabled.  An unregistered scratch heap cannot be found by
+	//		name or address so its memory must be freed with cHeap::FreeMemory rather than cMemoryManager::Free, it is not locked by
+	//		LockAllHeaps and it must be destroyed with DestroyHeap before Destroy.  The heap may be slightly larger than requested.
 	//  See Also:
-	//		Free
+	//      DestroyHeap, InitializeRegionCache
 	//  Arguments:
-	//      uSizeInBytes - Size in bytes. Minimum size will be 16bytes unless the heap settings have set a larger minimum size.
-	//		uAlignment - Default alignment is 16bytes unless heap settings have set a larger alignment.
-	//					 Any specified alignments must be a power of 2. Passing 0 will set it to the correct alignment for the heap.
-	//		uFlag - One of JRSMEMORYFLAG_xxx or user defined value.  Default JRSMEMORYFLAG_NONE.  See description for more details.
-	//		pText - NULL terminating text string to associate with the allocation.
-	//		uExternalId - An external id to associate with the allocation.  Default 0.
+	//      uHeapSize - The size in bytes of the heap.
+	//      pHeapName - Null terminated string for the heap name. Smaller than 32bytes.  Names do not need to be unique.  Default "Scratch".
+	//      pHeapDetails - Heap details.  bHeapIsSelfManaged and bAllowResizeReclaimation are ignored.  NULL will use the sHeapDetails values.
 	//  Return Value:
-	//      Valid pointer to allocated memory.
-	//		NULL otherwise.
+	//      Valid cHeap if successful.
+	//		NULL for failure.
 	//  Summary:
-	//      Allocates memory with additional information.
-	void *cMemoryManager::Malloc(jrs_sizet uSizeInBytes, jrs_u32 uAlignment, jrs_u32 uFlag, const jrs_i8 *pText, const jrs_u32 uExternalId /* = 0*/)
+	//      Creates a scratch heap.
+	cHeap *cMemoryManager::CreateScratchHeap(jrs_u64 uHeapSize, const jrs_i8 *pHeapName, cHeap::sHeapDetails *pHeapDetails)
 	{
-		// Check to ensure valid heap
-		if(!m_uHeapNum)
+		// Check if initialized
+		if(!m_bInitialized)
 		{
-			MemoryWarning(m_uHeapNum, JRSMEMORYERROR_NOVALIDHEAP, "No valid heap to allocate from.  Use CreateHeap to create one before calling Malloc.");
+			MemoryWarning(m_bInitialized, JRSMEMORYERROR_NOTINITIALIZED, "Memory manager is not initialized.");
 			return NULL;
-		}
+		}	
 
-		// Do we need to allocate from the small heap
-		if(m_pMemorySmallHeap && m_pMemorySmallHeap->GetMaxAllocationSize() >= uSizeInBytes)
+		cHeap::sHeapDetails details;
+		if(pHeapDetails)
+			details = *pHeapDetails;
+		if(details.systemAllocator == NULL || details.systemFree == NULL || details.systemPageSize == NULL)
 		{
-			if(m_pMemorySmallHeap->GetDefaultAlignment() == uAlignment || uAlignment == 0)
-			{
-				// Warn once with an warning when the heap overflows.
-#ifndef MEMORYMANAGER_MINIMAL
-				static jrs_bool bSmallHeapWarnOverflowOnce = false;
-#endif
-				void *pMem = m_pMemorySmallHeap->AllocateMemory(uSizeInBytes, uAlignment, uFlag, pText, uExternalId);
-				if(pMem)
-					return pMem;
-
-				// Warn
-#ifndef MEMORYMANAGER_MINIMAL
-				// Can only continue if sdf
-				if(!m_pMemorySmallHeap->IsOutOfMemoryReturnEnabled())
-					return NULL;
-
-				if(!bSmallHeapWarnOverflowOnce)
-				{
-					DebugOutput("Small heap memory hes been exhausted. Memory will use the default Malloc heap.  You will see this warning only once.");
-					bSmallHeapWarnOverflowOnce = true;
-				}
-#endif
-			}
-				
+			details.systemAllocator = m_MemoryManagerDefaultAllocator;
+			details.systemFree = m_MemoryManagerDefaultFree;
+			details.systemPageSize = m_MemoryManagerDefaultSystemPageSize;
 		}
+		details.bHeapIsSelfManaged = true;
+		details.bAllowResizeReclaimation = false;
 
-		// No just allocate
-		return GetDefaultHeap()->AllocateMemory(uSizeInBytes, uAlignment, uFlag, pText, uExternalId);
-	}
-
-	//  Description:
-	//      Replaces standard system malloc but allows for more advanced allocation parameters such as alignment. Malloc will
-	//		automatically send the allocation to the last created heap, unless a small heap is specified.  If a small heap is
-	//		specified and the allocation size is <= the maximum allocation size of the small heap the small heap will try to allocate.
-	//		Allocation flag defaults to JRSMEMORYFLAG_NONE and passed in string is NULL.  In NAC or NACS libraries the string will
-	//		be given a default value of 'Unknown'.
-	//  See Also:
-	//		Free, Realloc
-	//  Arguments:
-	//      uSizeInBytes - Size in bytes. Minimum size will be 16bytes unless the heap settings have set a larger minimum size.
-	//		uAlignment - Default alignment is 16bytes unless heap settings have set a larger alignment.
-	//					 Any specified alignments must be a power of 2. Passing 0 will set it to the correct alignment for the heap.
-	//  Return Value:
-	//      Valid pointer to allocated memory.
-	//		NULL otherwise.
-	//  Summary:	
-	//		Allocates memory with standard values.
-	void *cMemoryManager::Malloc(jrs_sizet uSizeInBytes, jrs_u32 uAlignment)
-	{
-		// No just allocate
-		return Malloc(uSizeInBytes, uAlignment, JRSMEMORYFLAG_NONE, NULL);
-	}
-
-	//  Description:
-	//      Frees allocated memory. Elephant will automatically search for the heap the allocation was allocated from (See note).
-	//		DeAllocation flag defaults to JRSMEMORYFLAG_NONE.  In NAC or NACS libraries the string associated with the free will
-	//		be given a default value.
-	//		Note: If heaps are created from memory allocated within other heaps this function may corrupt memory. If you are allocating
-	//		self managed heaps or heaps with addresses from memory allocated by Elephant in Initialize it is recommended that you do not use this
-	//		function to avoid potential errors.
-	//  See Also:
-	//		Free, Malloc, Realloc
-	//  Arguments:
-	//      pMemory - Valid memory address.  A NULL value may cause a warning depending on the settings of the heap.
-	//		uFlag - Defaults to JRSMEMORYFLAG_NONE but can be other user specified values.
-	//  Return Value:
-	//      Nothing.
-	//  Summary:	
-	//		Frees some previously allocated memory.
-	void cMemoryManager::Free(void *pMemory, jrs_u32 uFlag)
-	{
-		Free(pMemory, uFlag, NULL);
-	}
-
-	//  Description:
-	//      Reallocates a block of memory. This works just like standard realloc.  Passing in pMemory as NULL will perform a standard malloc.  Passing 0 
-	//		as a size will free the memory.  Any other size will resize the allocation.  In most situations this may be performed as a malloc, copy, free
-	//		operation.
-	//  See Also:
-	//		Free, Malloc
-	//  Arguments:
-	//      pMemory - Valid memory address.  A NULL value will cause a standard allocation to the default heap to be performed.
-	//		uSizeInBytes - Size in bytes of the memory to resize.  0 causes a free operation to be performed.
-	//		uFlag - Defaults to JRSMEMORYFLAG_NONE but can be other user specified values.
-	//		pText - 32char NULL terminated text string to associate with the memory.
-	//  Return Value:
-	//      Valid memory pointer if memory is valid.  NULL otherwise.
-	//  Summary:	
-	//		Reallocates a block of memory. 
-	void *cMemoryManager::Realloc(void *pMemory, jrs_sizet uSizeInBytes, jrs_u32 uAlignment, jrs_u32 uFlag, const jrs_i8 *pText)
-	{
-		// If memory is null then we just allocate as normal
-		if(!pMemory)
-			return Malloc(uSizeInBytes, uAlignment, uFlag, pText);
+		// The heap and its lock sit at the front of the region
+		jrs_u64 uAlignment = details.uDefaultAlignment > 128 ? details.uDefaultAlignment : 128;
+		jrs_u64 uHeaderSize = (sizeof(cHeap) + sizeof(JRSMemory_ThreadLock) + (uAlignment - 1)) & ~(uAlignment - 1);
+		jrs_u64 uRegionSize = GetHeapRegionSize(uHeaderSize + ((uHeapSize + 0xf) & ~0xf), details.systemPageSize());
 
-		// Memory isn't null, it can be reallocated.  We reallocate to the same heap it came from.
-		cHeap *pHeap = FindHeapFromMemoryAddress(pMemory);
-		if(!pHeap)
+		jrs_bool bZeroed;
+		jrs_i8 *pRegion = (jrs_i8 *)AcquireHeapRegion(uRegionSize, details.systemAllocator, details.systemFree, &bZeroed);
+		if(!pRegion)
 		{
-			MemoryWarning(pHeap, JRSMEMORYERROR_UNKNOWNADDRESS, "Heap could not be found for memory allocation. Realloc has failed");
+			MemoryWarning(pRegion, JRSMEMORYERROR_ELEPHANTOOM, "Cannot allocate the scratch heap.  Out of memory.");
 			return NULL;
 		}
 
-		// Do we have a small heap?
-		if(m_pMemorySmallHeap && pHeap == m_pMemorySmallHeap)
+		jrs_i8 *pHeapMemory = pRegion + uHeaderSize;
+		JRSMemory_ThreadLock *pLock = new (pRegion + sizeof(cHeap)) JRSMemory_ThreadLock();
+		cHeap *pHeap = new (pRegion) cHeap(pHeapMemory, (jrs_sizet)(uRegionSize - uHeaderSize), pHeapName, &details);
+		pHeap->m_pThreadLock = pLock;
+		pHeap->m_pScratchRegion = pRegion;
+		pHeap->m_uScratchRegionSize = uRegionSize;
+		if(bZeroed)
+			pHeap->AddZeroMemory(pHeapMemory, pRegion + uRegionSize);
+
+		// The tools need to see every heap
+		if(m_bEnableContinuousDump || m_bELVContinuousGrab || m_bEnableLiveView || m_bEnhancedDebugging)
 		{
-			// Just free and recall malloc
-			Free(pMemory);
-			return Malloc(uSizeInBytes, uAlignment, uFlag, pText);
+			m_MMThreadLock.Lock();
+
+			jrs_u32 uSlot = ReserveHeapRanges(1) ? AcquireHeapSlot(m_UserHeapRegistry) : MemoryManager_InvalidHeapSlot;
+			if(uSlot != MemoryManager_InvalidHeapSlot)
+			{
+				pHeap->m_pThreadLock = m_UserHeapRegistry.pSlots[uSlot].pLock;
+				pHeap->m_uRegistrySlot = uSlot;
+				RegisterHeapSlot(m_UserHeapRegistry, uSlot, pHeap);
+				AddHeapRange(pHeap, NULL, pHeapMemory, pRegion + uRegionSize);
+				m_uUserHeapNum++;
+			}
+			pHeap->m_uHeapId = m_uHeapIdInfo++;
+			ContinuousLogging_Operation(eContLog_CreateHeap, pHeap, NULL, 0);
+
+			m_MMThreadLock.Unlock();
 		}
 
-		// Reallocate it
-		return pHeap->ReAllocateMemory(pMemory, uSizeInBytes, uAlignment, uFlag, pText);
+		return pHeap;
 	}
 
 	//  Description:
-	//      Frees allocated memory. Elephant will automatically search for the heap the allocation was allocated from (See note).
-	//		DeAllocation flag defaults to JRSMEMORYFLAG_NONE.  In NAC or NACS libraries the string associated with the free will
-	//		be given a default value otherwise a custom value may be assigned.  See Malloc for futher flag values.  This function is identical to the other cMemoryManager::Free
-	//		except that it allows a string to be associated with the free.
-	//		Note: If heaps are created from memory allocated within other heaps this function may corrupt memory. If you are allocating
-	//		self managed heaps or heaps with addresses from memory allocated by Elephant in Initialize it is recommended that you do not use this
-	//		function to avoid potential errors.
+	//      Destroys a heap created with CreateScratchHeap and returns its region to the region cache.  Called by DestroyHeap.  Private.
 	//  See Also:
-	//		Free, Malloc
+	//      CreateScratchHeap, DestroyHeap
 	//  Arguments:
-	//      pMemory - Valid memory address.  A NULL value may cause a warning depending on the settings of the heap.
-	//		uFlag - Defaults to JRSMEMORYFLAG_NONE but can be other user specified values.
-	//		pText - 32 byte including terminator value string to be associated with the free. 
+	//		pHeap - Scratch heap.
 	//  Return Value:
-	//      Nothing.
-	//  Summary:	
-	//		Frees some previously allocated memory.
-	void cMemoryManager::Free(void *pMemory, jrs_u32 uFlag, const jrs_i8 *pText)
+	//      TRUE if successfully destroyed.
+	//		FALSE otherwise.
+	//  Summary:
+	//      Destroys a scratch heap.
+	jrs_bool cMemoryManager::DestroyScratchHeap(cHeap *pHeap)
 	{
-		// Null frees just get returned
-		if(!pMemory)
-			return;
-
-		// Do the user heaps first.  Sounds odd but the user heaps MAY come from the main heap.  Then any data that gets free'd through this function
-		// will corrupt that main heap as it will be detected from that heap.
-		for(jrs_u32 i = MemoryManager_MaxUserHeaps; i > 0; i--)
+		// Enhanced debugging registers the heap so it may have pending operations
+		if(m_bEnhancedDebugging && pHeap->m_bEnableEnhancedDebug && pHeap->m_uEDebugPending)
 		{
-			if(m_pUserHeaps[i - 1] && m_pUserHeaps[i - 1]->IsAllocatedFromThisHeap(pMemory))
+			DebugOutput("cMemoryManager::DestroyHeap - Enhanced Debugging is waiting for some pending allocations to be cleared.");
+
+			volatile jrs_u32 *pPending = &pHeap->m_uEDebugPending;
+			while(*pPending)
 			{
-				m_pUserHeaps[i - 1]->FreeMemory(pMemory, uFlag, pText);
-				return;
+				JRSThread::SleepMilliSecond(16);
 			}
 		}
 
-		// Find out what heap it is from.  Done in reverse because typically they will be done on the last heap using these methods.  This will
-		// also catch the small heap.
-		for(jrs_u32 i = m_uHeapNum; i > 0; i--)
+		if(!pHeap->m_bAllowDestructionWithAllocations && (pHeap->GetNumberOfAllocations() || pHeap->GetNumberOfSizeClassAllocations()))
 		{
-			if(m_pHeaps[i - 1]->IsAllocatedFromThisHeap(pMemory))
-			{
-				m_pHeaps[i - 1]->FreeMemory(pMemory, uFlag, pText);
-				return;
-			}
+			MemoryWarning(pHeap->GetNumberOfAllocations() == 0, JRSMEMORYERROR_HEAPWITHVALIDALLOCATIONS, "Cannot free heap %s as it still has valid allocations. Set Heap flag bAllowDestructionWithAllocations to true.", pHeap->m_HeapName);
+			return false;
 		}
+		pHeap->DestroySizeClassPools();
 
-		MemoryWarning(0, JRSMEMORYERROR_UNKNOWNADDRESS, "Memory could not be found allocated from any of the memory managers heaps.");
+		// Routes are only added under the manager lock so none can appear for a heap being destroyed
+		if(m_uNumMallocRoutes)
+			RemoveMallocRoutes(pHeap);
+
+		if(pHeap->m_uRegistrySlot != MemoryManager_InvalidHeapSlot)
+		{
+			// Registered scratch heaps use the slot lock.  Taken first like DestroyHeap.
+			JRSMemory_ThreadLock *pHeapLock = pHeap->m_pThreadLock;
+			m_PoolListLock.Lock();
+			pHeapLock->Lock();
+			m_MMThreadLock.Lock();
+
+			ContinuousLogging_Operation(eContLog_DestroyHeap, pHeap, NULL, 0);
+			RemoveHeapRanges(pHeap, NULL);
+			ReleaseHeapSlot(m_UserHeapRegistry, pHeap->m_uRegistrySlot);
+			pHeap->m_uRegistrySlot = MemoryManager_InvalidHeapSlot;
+			m_uUserHeapNum--;
+
+			m_MMThreadLock.Unlock();
+			pHeapLock->Unlock();
+			m_PoolListLock.Unlock();
+		}
+
+		// The heap lives in the region so everything needed is read first
+		jrs_i8 *pRegion = (jrs_i8 *)pHeap->m_pScratchRegion;
+		jrs_u64 uRegionSize = pHeap->m_uScratchRegionSize;
+		MemoryManagerDefaultAllocator Allocator = pHeap->m_systemAllocator;
+		MemoryManagerDefaultFree Free = pHeap->m_systemFree;
+		pHeap->DestroyLatencyStatistics();
+		pHeap->DestroyPoolRanges();
+		pHeap->~cHeap();
+		((JRSMemory_ThreadLock *)(pRegion + sizeof(cHeap)))->~JRSMemory_ThreadLock();
+
+		ReleaseHeapRegion(pRegion, uRegionSize, Allocator, Free);
+
+		return true;
 	}
 
+
 	//  Description:
-	//      Logs a memory marker to the continuous logging information.  Goldfish will use this value as a marker also for its continuous
-	//		views.
+	//      Resizes a heap to the size you require.  For self managed heaps you must be very careful when resizing that the expansion does not trample other memory.  
+	//		Elephant has no way of detecting this.  Elephant will disallow resizing of managed heaps if it is not the last on the stack.
 	//  See Also:
-	//		
+	//      CreateHeap, DestroyHeap, cHeap::sHeapDetails
 	//  Arguments:
-	//      pMarkerName - NULL terminated string of the name of the marker to log.
+	//		pHeap - Valid pointer to a cHeap.
+	//      uSize - The total size in bytes to resize the heap.  16byte multiple.  
 	//  Return Value:
-	//      Nothing.
-	//  Summary:	
-	//		Adds a marker to the log.
-	void cMemoryManager::LogMemoryMarker(const jrs_i8 *pMarkerName)
+	//      TRUE if successful.
+	//		FALSE for failure.
+	//  Summary:
+	//      Resizes a heap.
+	jrs_bool cMemoryManager::ResizeHeap(cHeap *pHeap, jrs_u64 uSize)
 	{
-		MemoryWarning(pMarkerName, JRSMEMORYERROR_INVALIDMARKER, "Marker name is invalid");
-		ContinuousLogging_Operation(eContLog_Marker, (cHeap *)pMarkerName, NULL, 0);
+		// Can only resize a heap if its at the end.  Its is up to the user to deal with unmanaged heaps.
+		MemoryWarning(pHeap, JRSMEMORYERROR_HEAPINVALID, "Heap must be a valid pointer.");
+
+		// Check if initialized
+		if(!m_bInitialized)
+		{
+			MemoryWarning(m_bInitialized,  JRSMEMORYERROR_NOTINITIALIZED, "Memory manager is not initialized.");
+			return false;
+		}	
+
+		// Self managed heap
+		if(!pHeap->IsMemoryManagerManaged())
+		{
+			MemoryWarning(pHeap->IsMemoryManagerManaged(), JRSMEMORYERROR_HEAPINVALIDCALL, "Heap cannot be resized with this function as it is managed by yourself.  Use cHeap::Resize().");
+			return false;
+		}
+
+		// Lock
+		m_MMThreadLock.Lock();
+
+		// Check the end block
+		if((void *)((jrs_i8 *)pHeap->m_pHeapEndAddress + sizeof(sFreeBlock)) != m_pUsableHeapMemoryStart)
+		{
+			MemoryWarning((void *)((jrs_i8 *)pHeap->m_pHeapEndAddress + sizeof(sFreeBlock)) == m_pUsableHeapMemoryStart, JRSMEMORYERROR_HEAPINVALIDFREE, "The heap is not the last heap that is self managed in the memory manager.  It cannot be resized using this method.");
+			// UnLock
+			m_MMThreadLock.Unlock();
+			return false;
+		}
+
+		// Resizing to the same size does nothing
+		if(pHeap->m_uHeapSize == uSize)
+		{
+			// UnLock
+			m_MMThreadLock.Unlock();
+			return true;
+		}
+
+		// Work out the minimum size of the heap
+		jrs_sizet MinSize = sizeof(sFreeBlock) + sizeof(sAllocatedBlock) + pHeap->m_uMinAllocSize;
+		if(uSize < MinSize)
+		{
+			MemoryWarning(uSize >= MinSize, JRSMEMORYERROR_HEAPTOSMALL, "Cannot resize the heap to %d bytes.  Minimum size to resize to is %d bytes.", uSize, MinSize);
+			// UnLock
+			m_MMThreadLock.Unlock();
+			return false;
+		}
+
+		// Check it will fit within the main memory manager.
+		jrs_i8 *pNewPointer = pHeap->m_pHeapStartAddress + uSize;
+		if(pNewPointer > (jrs_i8 *)m_pUseableMemoryEnd)
+		{
+			MemoryWarning(pNewPointer <= (jrs_i8 *)m_pUseableMemoryEnd, JRSMEMORYERROR_HEAPTOBIG, "The heap is being resized past the size of the memory managers usable memory area.  Resize has failed.");
+			// UnLock
+			m_MMThreadLock.Unlock();
+			return false;
+		}
+
+		// Move the new pointer back
+		jrs_i8 *pOldPointer = (jrs_i8 *)m_pUsableHeapMemoryStart;
+		m_pUsableHeapMemoryStart = pNewPointer;
+
+		// Resize
+		jrs_bool bPassed = pHeap->Resize((jrs_sizet)uSize);
+
+		// Growing into memory no heap has used yet keeps it zero
+		if(bPassed && pNewPointer > pOldPointer)
+		{
+			if(pOldPointer >= (jrs_i8 *)m_pUsableHeapMemoryZero)
+				pHeap->AddZeroMemory(pOldPointer, pNewPointer);
+			if(pNewPointer > (jrs_i8 *)m_pUsableHeapMemoryZero)
+				m_pUsableHeapMemoryZero = pNewPointer;
+		}
+
+		// UnLock
+		m_MMThreadLock.Unlock();
+		return bPassed;
 	}
 
 	//  Description:
-	//      Returns the size of the allocated memory allocated with Malloc or one of the heap allocation functions.
+	//      Resizes a heap to the end of the greatest allocated block.  Elephant will disallow resizing of self managed heaps.  Use cHeap::Resize instead.
 	//  See Also:
-	//		Malloc
+	//      CreateHeap, DestroyHeap, ResizeHeap, cHeap::Resize, cHeap::sHeapDetails
 	//  Arguments:
-	//      pMemory - Valid memory address.  A NULL value may cause a warning depending on the settings of the heap.
+	//		pHeap - Valid pointer to a cHeap.
 	//  Return Value:
-	//      Size in bytes of the allocation.
-	//  Summary:	
-	//		Gets the size in bytes of the allocated block of memory.
-	jrs_sizet cMemoryManager::SizeofAllocation(void *pMemory) const
+	//      TRUE if successful.
+	//		FALSE for failure.
+	//  Summary:
+	//      Resizes a heap to the last allocation.
+	jrs_bool cMemoryManager::ResizeHeapToLastAllocation(cHeap *pHeap)
 	{
-		MemoryWarning(pMemory, JRSMEMORYERROR_UNKNOWNADDRESS, "Not a valid allocation.");
-		sAllocatedBlock *pB = (sAllocatedBlock *)pMemory - 1;
-		return pB->uSize;
+		MemoryWarning(pHeap, JRSMEMORYERROR_HEAPCREATEINVALIDPOINTER, "Heap must be a valid pointer.");
+		MemoryWarning(pHeap->IsMemoryManagerManaged(), JRSMEMORYERROR_HEAPSELFMANAGED, "Heap cannot be resized with this function as it is managed by yourself.  Use cHeap::Resize().");
+		MemoryWarning((void *)((jrs_i8 *)pHeap->m_pHeapEndAddress + sizeof(sFreeBlock)) == m_pUsableHeapMemoryStart, JRSMEMORYERROR_HEAPINVALIDFREE, "The heap is not the last heap that is self managed in the memory manager.  It cannot be resized using this method.");
+
+		// Lock
+		m_MMThreadLock.Lock();
+
+		// Work out the memory address we can resize too.
+		void *pEndPointer = (void *)((jrs_i8 *)pHeap->m_pMainFreeBlock + sizeof(sFreeBlock));
+
+		// Just make sure we havent overrun the heap.  Unlikely but you never know.
+		MemoryWarning(pEndPointer <= m_pUsableHeapMemoryStart, JRSMEMORYERROR_FATAL, "Heap has overrun the end pointer.  Serious error.");
+
+		// Check that we dont need to resize it if it fits exactly
+		if(pEndPointer == m_pUsableHeapMemoryStart)
+		{
+			// No need to size here
+			// UnLock
+			m_MMThreadLock.Unlock();
+			return true;
+		}
+
+		// Heap can be resized.  Resize the heap to this size.  It may be 0.
+		jrs_u64 uNewSize = (jrs_i8 *)pEndPointer - pHeap->m_pHeapStartAddress;
+		jrs_u64 uMinSize = sizeof(sFreeBlock) + sizeof(sAllocatedBlock) + pHeap->m_uMinAllocSize;
+		if(uNewSize < uMinSize)
+			uNewSize = uMinSize;
+
+		// And finally do it.
+		jrs_bool bPass = ResizeHeap(pHeap, uNewSize);
+
+		// UnLock
+		m_MMThreadLock.Unlock();
+		return bPass;
 	}
 
 	//  Description:
-	//      Returns the size of the allocated memory allocated with Malloc or one of the heap allocation functions.  This size is the actual size of the allocated
-	//		block which may be larger than the size returned by SizeofAllocation.
+	//      Finds a heap based on its name.
 	//  See Also:
-	//		Malloc, SizeofAllocation
+	//      GetHeap, CreateHeap
 	//  Arguments:
-	//      pMemory - Valid memory address.  A NULL value may cause a warning depending on the settings of the heap.
+	//		pHeapName - Null terminated string with the heap's name.
 	//  Return Value:
-	//      Size in bytes of the allocation.
-	//  Summary:	
-	//		Gets the size in bytes of the allocated block of memory.
-	jrs_sizet cMemoryManager::SizeofAllocationAligned(void *pMemory) const
+	//      Valid cHeap if successful.
+	//		NULL if heap couldn't be found.
+	//  Summary:
+	//      Finds a heap based on its name.
+	cHeap *cMemoryManager::FindHeap(const jrs_i8 *pHeapName)
 	{
-		MemoryWarning(pMemory, JRSMEMORYERROR_UNKNOWNADDRESS, "Not a valid allocation.");
-		cHeap *pHeap = FindHeapFromMemoryAddress(pMemory);
-		sAllocatedBlock *pB = (sAllocatedBlock *)pMemory - 1;
-		
-		return (jrs_sizet)(HEAP_FULLSIZE_CALC(pB->uSize, pHeap->GetMinAllocationSize()));
+		// Check if initialized
+		if(!m_bInitialized)
+		{
+			MemoryWarning(m_bInitialized,  JRSMEMORYERROR_NOTINITIALIZED, "Memory manager is not initialized.");
+			return 0;
+		}	
+
+		// Managed heaps then user heaps.
+		cHeap *pHeap = (cHeap *)FindHeapSlot(m_HeapRegistry, pHeapName);
+		if(!pHeap)
+			pHeap = (cHeap *)FindHeapSlot(m_UserHeapRegistry, pHeapName);
+
+		return pHeap;
 	}
 
 	//  Description:
-	//      Returns the size of the allocation header.  This will be 16 bytes (32 for 64bit) normally but different library configurations
-	//		may change this.
+	//      Finds a non intrusive heap based on its name.
 	//  See Also:
-	//		SizeofAllocation, SizeofFreeBlock
+	//      GetHeap, CreateHeap
 	//  Arguments:
-	//      None
+	//		pHeapName - Null terminated string with the heap's name.
 	//  Return Value:
-	//      Size in bytes of the allocation header.
-	//  Summary:	
-	//		Gets the size in bytes of the allocation header.
-	jrs_sizet cMemoryManager::SizeofAllocatedBlock(void)
+	//      Valid cHeap if successful.
+	//		NULL if heap couldn't be found.
+	//  Summary:
+	//      Finds a non intrusive heap based on its name.
+	cHeapNonIntrusive *cMemoryManager::FindNonIntrusiveHeap(const jrs_i8 *pHeapName)
 	{
-		return sizeof(sAllocatedBlock);
+		return (cHeapNonIntrusive *)FindHeapSlot(m_NIHeapRegistry, pHeapName);
 	}
 
 	//  Description:
-	//      Returns the size of the free header.  This is typically always 16bytes larger than the allocation header.
+	//      Gets a managed heap from an index
 	//  See Also:
-	//		SizeofAllocation, SizeofAllocationBlock
+	//      GetHeap, CreateHeap
 	//  Arguments:
-	//      None
+	//		iIndex - Index of heap, starting at 0.
 	//  Return Value:
-	//      Size in bytes of the free header.
-	//  Summary:	
-	//		Gets the size in bytes of the free header.
-	jrs_sizet cMemoryManager::SizeofFreeBlock(void)
+	//      Valid cHeap if successful.
+	//		NULL if heap couldn't be found.
+	//  Summary:
+	//      Gets a managed heap by index.
+	cHeap *cMemoryManager::GetHeap(jrs_u32 iIndex)
 	{
-		return sizeof(sFreeBlock);
+		// Check if initialized
+		if(!m_bInitialized)
+		{
+			MemoryWarning(m_bInitialized,  JRSMEMORYERROR_NOTINITIALIZED, "Memory manager is not initialized.");
+			return 0;
+		}	
+
+		// Read the count first.  The table is published before it so is always large enough.
+		jrs_u32 uMaxSlots = m_HeapRegistry.uMaxSlots;
+		MemoryWarning(iIndex < uMaxSlots, JRSMEMORYERROR_NOTENOUGHHEAPS, "Heap index exceeds the number of heaps");
+
+		return iIndex < uMaxSlots ? (cHeap *)m_HeapRegistry.pSlots[iIndex].pHeap : NULL;
 	}
 
 	//  Description:
-	//      Returns the flag attached to the allocation.
+	//      Gets a self managed heap from an index.
 	//  See Also:
-	//		
+	//      GetHeap, CreateHeap
 	//  Arguments:
-	//      None
+	//		iIndex - Index of heap, starting at 0.
 	//  Return Value:
-	//      The flag attached to the allocation.
-	//  Summary:	
-	//		Returns the flag attached to the allocation.
-	jrs_u32 cMemoryManager::GetAllocationFlag(void *pMemory) const
+	//      Valid cHeap if successful.
+	//		NULL if heap couldn't be found.
+	//  Summary:
+	//      Gets a managed heap by index.
+	cHeap *cMemoryManager::GetUserHeap(jrs_u32 iIndex)
 	{
-		MemoryWarning(pMemory, JRSMEMORYERROR_INVALIDALLOCBLOCK, "Not a valid allocation.");
-		sAllocatedBlock *pB = (sAllocatedBlock *)pMemory - 1;
-		return pB->uFlagAndUniqueAllocNumber & 15;
+		// Check if initialized
+		if(!m_bInitialized)
+		{
+			MemoryWarning(m_bInitialized,  JRSMEMORYERROR_NOTINITIALIZED, "Memory manager is not initialized.");
+			return 0;
+		}	
+
+		jrs_u32 uMaxSlots = m_UserHeapRegistry.uMaxSlots;
+		MemoryWarning(iIndex < uMaxSlots, JRSMEMORYERROR_NOTENOUGHUSERHEAPS, "Heap index exceeds the number of heaps");
+
+		return iIndex < uMaxSlots ? (cHeap *)m_UserHeapRegistry.pSlots[iIndex].pHeap : NULL;
 	}
 
 	//  Description:
-	//      Sets the default heap for malloc to use.  Otherwise it uses the last created user heap.
+	//      Gets a non intrusive heap from an index.
 	//  See Also:
-	//		GetDefaultHeap
+	//      GetHeap, CreateHeap
 	//  Arguments:
-	//      pHeap - Valid heap to force allocations to allocated to.  NULL to revert to the last created heap.
+	//		iIndex - Index of heap, starting at 0.
 	//  Return Value:
-	//      None
-	//  Summary:	
-	//		Sets the default heap for malloc to use.  Otherwise it uses the last created user heap.
-	void cMemoryManager::SetMallocDefaultHeap(cHeap *pHeap)
+	//      Valid cHeap if successful.
+	//		NULL if heap couldn't be found.
+	//  Summary:
+	//      Gets a Non intrusive heap by index.
+	cHeapNonIntrusive *cMemoryManager::GetNIHeap(jrs_u32 iIndex)
 	{
-		if(!pHeap)
-		{
-			m_bOverrideMallocHeap = false;
-			m_pDefaultMallocHeap = GetDefaultHeap();
-		}
-		else
+		// Check if initialized
+		if(!m_bInitialized)
 		{
-			m_bOverrideMallocHeap = true;
-			m_pDefaultMallocHeap = pHeap;
-		}
+			MemoryWarning(m_bInitialized,  JRSMEMORYERROR_NOTINITIALIZED, "Memory manager is not initialized.");
+			return 0;
+		}	
+
+		jrs_u32 uMaxSlots = m_NIHeapRegistry.uMaxSlots;
+		MemoryWarning(iIndex < uMaxSlots, JRSMEMORYERROR_NOTENOUGHNONINTRUSIVEHEAPS, "Heap index exceeds the number of heaps");
+
+		return iIndex < uMaxSlots ? (cHeapNonIntrusive *)m_NIHeapRegistry.pSlots[iIndex].pHeap : NULL;
 	}
 
 	//  Description:
-	//		Runs a full check on all heaps to see if their are any errors like overruns.  Must be using NACS or S libraries 
-	//		for this to be performed.  It is thorough but not a quick operation.
+	//      Takes the next slice of a snapshot of the heap at an index.  The same as cHeap::SnapshotSlice except that the heap is found
+	//		from its slot under the slot lock for every slice.  A heap destroyed between slices interrupts the snapshot instead of being
+	//		read after it has gone, so this is the safe way to snapshot heaps the caller does not own.
 	//  See Also:
-	//		
+	//      cHeap::SnapshotSlice, GetHeap, GetUserHeap
 	//  Arguments:
-	//      None
+	//		iIndex - Index of heap, starting at 0.
+	//		bUserHeap - TRUE for the self managed heap at iIndex.  FALSE for the managed heap.
+	//		pSnapshot - Progress of the snapshot.  Use a new sSnapshot for each snapshot.
+	//		pBlocks - Receives the blocks.
+	//		uMaxBlocks - Number of blocks pBlocks can hold.  Minimum 3.
 	//  Return Value:
-	//      Nothing
-	//  Summary:	
-	//		Checks all heaps for any errors.
-	void cMemoryManager::CheckForErrors(void)
+	//      Number of blocks copied.  bFinished is set without any blocks if there is no heap at the index.
+	//  Summary:
+	//      Takes the next slice of a heap snapshot.
+	jrs_u32 cMemoryManager::SnapshotHeapSlice(jrs_u32 iIndex, jrs_bool bUserHeap, cHeap::sSnapshot *pSnapshot, cHeap::sSnapshotBlock *pBlocks, jrs_u32 uMaxBlocks)
 	{
-		for(jrs_u32 i = 0; i < m_uHeapNum; i++)
+		if(!pSnapshot || pSnapshot->bFinished)
+			return 0;
+
+		sHeapRegistry &rRegistry = bUserHeap ? m_UserHeapRegistry : m_HeapRegistry;
+		if(!m_bInitialized || iIndex >= rRegistry.uMaxSlots)
 		{
-			if(m_pHeaps[i])
-				m_pHeaps[i]->CheckForErrors();
+			pSnapshot->bFinished = true;
+			return 0;
 		}
 
-		for(jrs_u32 i = 0; i < MemoryManager_MaxUserHeaps; i++)
+		// Slot locks never move and are the heap locks so the heap cannot be destroyed during the slice.  A different heap in the slot
+		// means ours was destroyed since the last one.
+		JRSMemory_ThreadLock *pLock = rRegistry.pSlots[iIndex].pLock;
+		pLock->Lock();
+		cHeap *pHeap = (cHeap *)rRegistry.pSlots[iIndex].pHeap;
+		jrs_u32 uNumBlocks = 0;
+		if(pHeap && (!pSnapshot->uSlices || pHeap->GetUniqueId() == pSnapshot->uHeapId))
 		{
-			if(m_pUserHeaps[i])
-			{
-				m_pUserHeaps[i]->CheckForErrors();
-			}
+			uNumBlocks = pHeap->SnapshotSlice(pSnapshot, pBlocks, uMaxBlocks);
+		}
+		else
+		{
+			pSnapshot->bInterrupted = pSnapshot->uSlices ? true : false;
+			pSnapshot->bFinished = true;
 		}
+		pLock->Unlock();
+
+		return uNumBlocks;
 	}
 
 	//  Description:
-	//		Does a full memory report (statistics and allocations in memory order) to the user TTY callback.  If you want to report these to a file
-	//		include full path and file name to the function.  The generated file is an Overview file for use in Goldfish.  The file is in a 
-	//		compatible CSV format for loading into a spread sheet for self analysis.  When connected to a debugger TTY output may cause this
-	//		function to take a lot longer than just writing to a log file can take.  Time is proportionate to the number of allocations.
+	//      Reports the allocations of one pool of the heap at an index in memory order.  The pool list lock is held while the heap and pool
+	//		are found and while the pool reports so neither can be destroyed or detached part way through.  The slot lock is not taken as it
+	//		is the heap lock and pools are always locked before their heap.
 	//  See Also:
-	//		ReportStatistics, ReportAllocationsMemoryOrder
+	//      SnapshotHeapSlice, cPoolBase::ReportAllocationsMemoryOrder
 	//  Arguments:
-	//      pLogToFile - Full path and file name null terminated string. NULL if you do not wish to generate a file.
-	//		includeFreeBlocks - Reports free blocks to the output also.
-	//		displayCallStack - Logs any the callstacks as well.  May be slow.  Default false.
+	//		iIndex - Index of heap, starting at 0.
+	//		bUserHeap - TRUE for the self managed heap at iIndex.  FALSE for the managed heap.
+	//		uHeapId - Unique id the heap must still have.  Usually the uHeapId of a snapshot of it.
+	//		uPool - Position of the pool in the heap's pool list, starting at 0.
 	//  Return Value:
-	//      Nothing
-	//  Summary:	
-	//		Reports on all heaps and can generate an Overview file for Goldfish.
-	void cMemoryManager::ReportAll(const jrs_i8 *pLogToFile, jrs_bool includeFreeBlocks, jrs_bool displayCallStack)
+	//      TRUE if the pool reported.
+	//		FALSE if the heap has gone or has no pool at that position.
+	//  Summary:
+	//      Reports one pool of a heap.
+	jrs_bool cMemoryManager::ReportHeapPool(jrs_u32 iIndex, jrs_bool bUserHeap, jrs_u32 uHeapId, jrs_u32 uPool)
 	{
-		// Used to determine where the reporting comes from
-		g_ReportHeap = true;
-		g_ReportHeapCreate = true;
-
-		for(jrs_u32 i = 0; i < m_uHeapNum; i++)
-		{
-			if(m_pHeaps[i])
-				m_pHeaps[i]->ReportAll(pLogToFile, includeFreeBlocks, displayCallStack);
-		}
+		sHeapRegistry &rRegistry = bUserHeap ? m_UserHeapRegistry : m_HeapRegistry;
+		if(!m_bInitialized || iIndex >= rRegistry.uMaxSlots)
+			return FALSE;
 
-		// And the user heap
-		for(jrs_u32 i = 0; i < MemoryManager_MaxUserHeaps; i++)
+		m_PoolListLock.Lock();
+		cHeap *pHeap = (cHeap *)rRegistry.pSlots[iIndex].pHeap;
+		cPoolBase *pPool = NULL;
+		if(pHeap && pHeap->GetUniqueId() == uHeapId)
 		{
-			if(m_pUserHeaps[i])
-			{
-				// Report
-				m_pUserHeaps[i]->ReportAll(pLogToFile, includeFreeBlocks, displayCallStack);
-			}
+			pPool = pHeap->GetPool(NULL);
+			for(jrs_u32 i = 0; pPool && i < uPool; i++)
+				pPool = pHeap->GetPool(pPool);
 		}
 
-		// And the NI heap
-		for(jrs_u32 i = 0; i < MemoryManager_MaxNonIntrusiveHeaps; i++)
-		{
-			if(m_pNonInstrusiveHeaps[i])
-			{
-				// Report
-				m_pNonInstrusiveHeaps[i]->ReportAll(pLogToFile, includeFreeBlocks, displayCallStack);
-			}
-		}
+		if(pPool)
+			pPool->ReportAllocationsMemoryOrder();
+		m_PoolListLock.Unlock();
 
-		// Rest
-		g_ReportHeap = false;
-		g_ReportHeapCreate = true;
+		return pPool ? TRUE : FALSE;
 	}
 
 	//  Description:
-	//		Reports basic statistics about all heaps to the user TTY callback. Use this to get quick information on 
-	//		when need that is more detailed that simple heap memory realtime calls.
+	//      Destroys the specified heap. The heap can be managed, self managed or a scratch heap. On destruction the heap may warn
+	//		you if there are any allocations remaining depending on the settings specified at creation time.  The memory of scratch heaps
+	//		and resizable managed heaps goes to the region cache when it is enabled.
 	//  See Also:
-	//		ReportAll, ReportAllocationsMemoryOrder
+	//      GetHeap, CreateHeap, CreateScratchHeap
 	//  Arguments:
-	//		bAdvanced - When true displays bins and other counts.
+	//		pHeap - Valid cHeap.
 	//  Return Value:
-	//      Nothing
-	//  Summary:	
-	//		Reports basic statistics about all heaps to the user TTY callback. 
-	void cMemoryManager::ReportStatistics(jrs_bool bAdvanced)
+	//      TRUE if successfully destroyed.
+	//		FALSE otherwise.
+	//  Summary:
+	//      Destroys a heap
+	jrs_bool cMemoryManager::DestroyHeap(cHeap *pHeap)
 	{
-		for(jrs_u32 i = 0; i < MemoryManager_MaxHeaps; i++)
+		// Check if initialized
+		if(!m_bInitialized || !pHeap)
+		{
+			MemoryWarning(pHeap, JRSMEMORYERROR_HEAPINVALID, "Heap is not valid");
+			MemoryWarning(m_bInitialized,  JRSMEMORYERROR_NOTINITIALIZED, "Memory manager is not initialized.");
+			return false;
+		}	
+
+		// Scratch heaps do not need the manager lock
+		if(pHeap->m_pScratchRegion)
+			return DestroyScratchHeap(pHeap);
+
+		// If we are using enhanced debugging we may have pending operations so we wait for those to clear.  Warn the user.  The pending
+		// frees need the heap lock so this is done before locking.
+		if(m_bEnhancedDebugging && pHeap->m_bEnableEnhancedDebug && pHeap->m_uEDebugPending)
 		{
-			if(m_pHeaps[i])
+			DebugOutput("cMemoryManager::DestroyHeap - Enhanced Debugging is waiting for some pending allocations to be cleared.");
+
+			volatile jrs_u32 *pPending = &pHeap->m_uEDebugPending;
+			while(*pPending)
 			{
-				// Report
-				m_pHeaps[i]->ReportStatistics(bAdvanced);
+				JRSThread::SleepMilliSecond(16);
 			}
 		}
 
-		for(jrs_u32 i = 0; i < MemoryManager_MaxUserHeaps; i++)
+		// Lock.  The heap lock is taken before the manager lock as it is when a heap resizes.  The stats page reads heaps holding only
+		// their lock so it never sees one part way through destruction.  The pool list lock comes first as the size class pools are
+		// destroyed and LockAllHeaps must not walk the pools of a heap being destroyed.
+		JRSMemory_ThreadLock *pHeapLock = pHeap->m_pThreadLock;
+		m_PoolListLock.Lock();
+		pHeapLock->Lock();
+		m_MMThreadLock.Lock();
+		
+		// Allocations served by the size class pools count as heap allocations.
+		if(!pHeap->m_bAllowDestructionWithAllocations && pHeap->GetNumberOfSizeClassAllocations())
 		{
-			if(m_pUserHeaps[i])
-			{
-				// Report
-				m_pUserHeaps[i]->ReportStatistics(bAdvanced);
-			}
+			MemoryWarning(pHeap->GetNumberOfSizeClassAllocations() == 0, JRSMEMORYERROR_HEAPWITHVALIDALLOCATIONS, "Cannot free heap %s as it still has valid allocations. Set Heap flag bAllowDestructionWithAllocations to true.", pHeap->m_HeapName);
+			// UnLock
+			m_MMThreadLock.Unlock();
+			pHeapLock->Unlock();
+			m_PoolListLock.Unlock();
+			return false;
 		}
+		pHeap->DestroySizeClassPools();
+		RemoveMallocRoutes(pHeap);
 
-		for(jrs_u32 i = 0; i < MemoryManager_MaxNonIntrusiveHeaps; i++)
+		// We can only destroy a heap with allocations still valid if we are allowed.  Check that here.
+		if(!pHeap->m_bAllowDestructionWithAllocations)
 		{
-			if(m_pNonInstrusiveHeaps[i])
+			if(pHeap->GetNumberOfAllocations())
 			{
-				// Report
-				m_pNonInstrusiveHeaps[i]->ReportStatistics(bAdvanced);
+				MemoryWarning(pHeap->GetNumberOfAllocations() == 0, JRSMEMORYERROR_HEAPWITHVALIDALLOCATIONS, "Cannot free heap %s as it still has valid allocations. Set Heap flag bAllowDestructionWithAllocations to true.", pHeap->m_HeapName);
+				// UnLock
+				m_MMThreadLock.Unlock();
+				pHeapLock->Unlock();
+				m_PoolListLock.Unlock();
+				return false;
 			}
-		}
-	}
 
-	//  Description:
-	//		Reports on all the allocations in every heap.  This function is like ReportAll but doesnt output the statistics.  Calling
-	//		this function with a valid file name will create an Overview file for use in Goldfish.
-	//  See Also:
-	//		ReportAll, ReportStatistics
-	//  Arguments:
-	//		pLogToFile - Full path and file name null terminated string. NULL if you do not wish to generate a file.
-	//		includeFreeBlocks - Reports free blocks to the output also.
-	//		displayCallStack - Logs any the callstacks as well.  May be slow.  Default false.
-	//  Return Value:
-	//      Nothing
-	//  Summary:	
-	//		Reports all allocations from all heaps to the user TTY callback and/or a file.
-	void cMemoryManager::ReportAllocationsMemoryOrder(const jrs_i8 *pLogToFile, jrs_bool includeFreeBlocks, jrs_bool displayCallStack)
-	{
-		for(jrs_u32 i = 0; i < MemoryManager_MaxHeaps; i++)
-		{
-			if(m_pHeaps[i])
+			if(pHeap->m_pAttachedPools)
 			{
-				m_pHeaps[i]->ReportAllocationsMemoryOrder(pLogToFile, includeFreeBlocks, displayCallStack);
+				MemoryWarning(!pHeap->m_pAttachedPools, JRSMEMORYERROR_HEAPWITHVALIDPOOLS, "Cannot free heap %s as it still has valid pools. Set Heap flag bAllowDestructionWithAllocations to true.", pHeap->m_HeapName);
 			}
 		}
 
-		for(jrs_u32 i = 0; i < MemoryManager_MaxUserHeaps; i++)
+		// Heaps have to be destroyed with different methods depending on if they are managed or not.
+		if(pHeap->IsMemoryManagerManaged())
 		{
-			if(m_pUserHeaps[i])
+			MemoryWarning(m_uHeapNum, JRSMEMORYERROR_HEAPINVALID, "No heap to remove");
+
+			// Find the heap
+			jrs_u32 uHeap = pHeap->m_uRegistrySlot;
+			cHeap *pFHeap = (uHeap < m_HeapRegistry.uMaxSlots && m_HeapRegistry.pSlots[uHeap].pHeap == pHeap) ? pHeap : NULL;
+			
+			// Did we match one?
+			if(!pFHeap)
 			{
-				m_pUserHeaps[i]->ReportAllocationsMemoryOrder(pLogToFile, includeFreeBlocks, displayCallStack);
+				MemoryWarning(pFHeap, JRSMEMORYERROR_HEAPINVALIDFREE, "Heap not found, could not be freed.");
+				m_MMThreadLock.Unlock();
+				pHeapLock->Unlock();
+				m_PoolListLock.Unlock();
+				return false;
 			}
-		}
 
-		for(jrs_u32 i = 0; i < MemoryManager_MaxNonIntrusiveHeaps; i++)
+			// Now free it
+			if(m_bResizeable)
+			{
+				// Free the memory
+				pFHeap->DestroyLinkedMemory();
+			}
+			else
+			{
+				// Cannot free a managed heap if its not the last one.
+				if((void *)((jrs_i8 *)pFHeap->m_pHeapEndAddress + sizeof(sFreeBlock)) != m_pUsableHeapMemoryStart)
+				{
+					MemoryWarning((void *)((jrs_i8 *)pFHeap->m_pHeapEndAddress + sizeof(sFreeBlock)) == m_pUsableHeapMemoryStart, JRSMEMORYERROR_HEAPINVALIDFREE, "The heap is not the last heap that is self managed in the memory manager.  It cannot be removed using this method. Heap may also be a user managed heap without the user managed flag set.");
+					// UnLock
+					m_MMThreadLock.Unlock();
+					pHeapLock->Unlock();
+					m_PoolListLock.Unlock();
+					return false;
+				}
+
+				// Reduce the number of heaps
+				m_pUsableHeapMemoryStart = (jrs_i8 *)pFHeap->m_pHeapStartAddress;
+			}
+			m_uHeapNum--;
+
+			cMemoryManager::Get().ContinuousLogging_Operation(cMemoryManager::eContLog_DestroyHeap, pFHeap, NULL, 0);
+
+			// Release the slot
+			RemoveHeapRanges(pFHeap, NULL);
+			ReleaseHeapSlot(m_HeapRegistry, uHeap);
+			pFHeap->m_uRegistrySlot = MemoryManager_InvalidHeapSlot;
+		}
+		else
 		{
-			if(m_pNonInstrusiveHeaps[i])
+			// User heap.  Destroy it here.  A bit more complex and the user still has to deal with the memory used to create this heap.
+			MemoryWarning(m_uUserHeapNum, JRSMEMORYERROR_HEAPINVALID, "No heap to remove");
+
+			// Find the heap in the user list
+			jrs_u32 uHeap = pHeap->m_uRegistrySlot;
+
+			// Check if we found it or not
+			if(uHeap >= m_UserHeapRegistry.uMaxSlots || m_UserHeapRegistry.pSlots[uHeap].pHeap != pHeap)
 			{
-				m_pNonInstrusiveHeaps[i]->ReportAllocationsMemoryOrder(pLogToFile, includeFreeBlocks, displayCallStack);
+				MemoryWarning(m_uUserHeapNum, JRSMEMORYERROR_HEAPINVALID, "No heap to remove");
+
+				// UnLock
+				m_MMThreadLock.Unlock();
+				pHeapLock->Unlock();
+				m_PoolListLock.Unlock();
+				return false;
 			}
+
+			cMemoryManager::Get().ContinuousLogging_Operation(cMemoryManager::eContLog_DestroyHeap, pHeap, NULL, 0);
+
+			// Remove the heap
+			RemoveHeapRanges(pHeap, NULL);
+			ReleaseHeapSlot(m_UserHeapRegistry, uHeap);
+			pHeap->m_uRegistrySlot = MemoryManager_InvalidHeapSlot;
+			m_uUserHeapNum--;
 		}
+		pHeap->DestroyLatencyStatistics();
+		pHeap->DestroyPoolRanges();
+
+		// UnLock
+		m_MMThreadLock.Unlock();
+		pHeapLock->Unlock();
+		m_PoolListLock.Unlock();
+
+		// Removed.
+		return true;
 	}
-	
+
 	//  Description:
-	//		Forces a ReportAll to be sent to Goldfish.
+	//      Destroys the specified non intrusive heap. On destruction the heap may warn
+	//		you if there are any allocations remaining depending on the settings specified at creation time.
 	//  See Also:
-	//		
+	//      GetHeap, FindHeap
 	//  Arguments:
-	//		None
+	//		pHeap - Valid cHeapNonIntrusive.
 	//  Return Value:
-	//      Nothing
-	//  Summary:	
-	//		Forces a ReportAll to be sent to Goldfish.
-	void cMemoryManager::ReportAllToGoldfish(void)
+	//      TRUE if successfully destroyed.
+	//		FALSE otherwise.
+	//  Summary:
+	//      Destroys a heap
+	jrs_bool cMemoryManager::DestroyNonIntrusiveHeap(cHeapNonIntrusive *pHeap)
 	{
-		if(m_bLiveViewRunning && !m_bForceLVOverviewGrab)
+		// Check if initialized
+		if(!m_bInitialized || !pHeap)
 		{
-			m_bForceLVOverviewGrab = TRUE;
+			MemoryWarning(pHeap, JRSMEMORYERROR_HEAPINVALID, "Heap is not valid");
+			MemoryWarning(m_bInitialized,  JRSMEMORYERROR_NOTINITIALIZED, "Memory manager is not initialized.");
+			return false;
+		}	
 
-			// Wait a little while so it can go
-			JRSThread::SleepMilliSecond(100);
+		// Lock.  The heap lock first as in DestroyHeap.
+		JRSMemory_ThreadLock *pHeapLock = pHeap->m_pThreadLock;
+		pHeapLock->Lock();
+		m_MMThreadLock.Lock();
+
+		// User heap.  Destroy it here.  A bit more complex and the user still has to deal with the memory used to create this heap.
+		MemoryWarning(m_uNonIntrusiveHeapNum, JRSMEMORYERROR_HEAPINVALID, "No heap to remove");
+
+		// Find the heap in the user list
+		jrs_u32 uHeap = pHeap->m_uRegistrySlot;
+
+		// Check if we found it or not
+		if(uHeap >= m_NIHeapRegistry.uMaxSlots || m_NIHeapRegistry.pSlots[uHeap].pHeap != pHeap)
+		{
+			MemoryWarning(m_uNonIntrusiveHeapNum, JRSMEMORYERROR_HEAPINVALID, "No heap to remove");
+
+			// UnLock
+			m_MMThreadLock.Unlock();
+			pHeapLock->Unlock();
+			return false;
+		}
+
+		// We can only destroy a heap with allocations still valid if we are allowed.  Check that here.
+		if(!pHeap->m_bAllowDestructionWithAllocations)
+		{
+			if(pHeap->GetNumberOfAllocations())
+			{
+				MemoryWarning(pHeap->GetNumberOfAllocations() == 0, JRSMEMORYERROR_HEAPWITHVALIDALLOCATIONS, "Cannot free heap %s as it still has valid allocations. Set Heap flag bAllowDestructionWithAllocations to true.", pHeap->m_HeapName);
+				// UnLock
+				m_MMThreadLock.Unlock();
+				pHeapLock->Unlock();
+				return false;
+			}
 		}
+		cMemoryManager::Get().ContinuousLogging_NIOperation(cMemoryManager::eContLog_DestroyHeap, pHeap, NULL, 0);
+		RemoveMallocRoutes(pHeap);
+
+		// Remove the heap.  Its ranges go first so Free stops finding the slabs before they are released.
+		RemoveHeapRanges(pHeap, NULL);
+		pHeap->Destroy();
+		ReleaseHeapSlot(m_NIHeapRegistry, uHeap);
+		pHeap->m_uRegistrySlot = MemoryManager_InvalidHeapSlot;
+		m_uNonIntrusiveHeapNum--;
+
+		m_MMThreadLock.Unlock();
+		pHeapLock->Unlock();
+		return TRUE;
 	}
 
 	//  Description:
-	//		Starts a continuous grab to be sent to Goldfish.
+	//      Returns the heap where the memory address lies.  Can be useful for finding out general information of where memory came from.  Does not need to be an allocated address,
+	//		any will do.
 	//  See Also:
-	//		
+	//      
 	//  Arguments:
-	//		None
+	//		pMemory - Memory address to search heaps against.
 	//  Return Value:
-	//      Nothing
-	//  Summary:	
-	//		Starts a continuous grab to be sent to Goldfish.
-	void cMemoryManager::ReportContinuousStartToGoldfish(void)
+	//      A valid cHeap pointer if a heap contains the memory location.  NULL otherwise.
+	//  Summary:
+	//      Returns a valid Heap where the memory address lies.
+	cHeap *cMemoryManager::FindHeapFromMemoryAddress(void *pMemory) const
 	{
-		if(m_bLiveViewRunning && !m_bForceLVContinuousGrab)
-		{
-			m_bForceLVContinuousGrab = TRUE;
-		}		
+		// User heaps MAY come from the main heap.  The range search returns the innermost heap so memory in them is never detected as the outer one.
+		cHeap *pHeap;
+		FindHeapRange(pMemory, &pHeap, NULL);
+		return pHeap;
 	}
 
 	//  Description:
-	//		Stops a previously started continuous grab being sent to Goldfish.
+	//      Returns the heap where the memory address lies.  Can be useful for finding out general information of where memory came from.  Does not need to be an allocated address,
+	//		any will do.
 	//  See Also:
-	//		
+	//      
 	//  Arguments:
-	//		None
+	//		pMemory - Memory address to search heaps against.
 	//  Return Value:
-	//      Nothing
-	//  Summary:	
-	//		Stops a previously started continuous grab being sent to Goldfish.
-	void cMemoryManager::ReportContinuousStopToGoldfish(void)
+	//      A valid cHeapNonIntrusive pointer if a heap contains the memory location.  NULL otherwise.
+	//  Summary:
+	//      Returns a valid NI Heap where the memory address lies.
+	cHeapNonIntrusive *cMemoryManager::FindNIHeapFromMemoryAddress(void *pMemory) const
 	{
-		if(m_bLiveViewRunning && m_bELVContinuousGrab)
-		{
-			m_bForceLVContinuousGrab = TRUE;
-		}		
+		cHeapNonIntrusive *pNIHeap;
+		FindHeapRange(pMemory, NULL, &pNIHeap);
+		return pNIHeap;
 	}
 
 	//  Description:
-	//		Standard Elephant debug output generator to pass to user TTY callback.
+	//      Gets the default heap allocations will go into when calling cMemoryManager::Malloc.
 	//  See Also:
-	//		
+	//		SetMallocDefaultHeap
 	//  Arguments:
-	//		pText - Standard text string. 2k - 1 max length.
-	//		... - variable args.
+	//      None
 	//  Return Value:
-	//      Nothing
+	//      Valid cHeap pointer or NULL.
 	//  Summary:	
-	//		Internal debug output generation.
-	void cMemoryManager::DebugOutput(const jrs_i8 *pText, ...)
+	//		Gets the default heap allocations will go into when calling cMemoryManager::Malloc.
+	cHeap *cMemoryManager::GetDefaultHeap(void)
 	{
-		// Only if debugging is valid
-		if(cMemoryManager::m_MemoryManagerTTYOutput)
+		// Check to ensure valid heap
+		if(!m_uHeapNum)
 		{
-			jrs_i8 logtext[2048];
-			va_list args;
+			MemoryWarning(m_uHeapNum, JRSMEMORYERROR_NOVALIDHEAP, "No valid heap. Use CreateHeap to create one.");
+			return NULL;
+		}
 
-			// Create the string
-			va_start(args, pText);
-			vsnprintf(logtext, 2047, pText, args);
-			va_end(args);  
+		// Use the user set heap
+		if(m_bOverrideMallocHeap)
+			return m_pDefaultMallocHeap;
 
-			cMemoryManager::m_MemoryManagerTTYOutput(logtext);
-		}
+		return (cHeap *)m_HeapRegistry.pSlots[m_uHeapNum - 1].pObject;
 	}
 
 	//  Description:
-	//		Standard Elephant debug output to file generator to pass to user TTY callback.
+	//      Resets any heap statistics that have accrued since either Initialization or the last time this function was called.
 	//  See Also:
-	//		
+	//      cHeap::ResetStatistics
 	//  Arguments:
-	//		pFile - File name of output.
-	//		bCreate - TRUE if the file is to be recreated/cleared.  FALSE to append.
-	//		pText - Standard text string. 2k - 1 max length.
-	//		... - variable args.
+	//		None.
 	//  Return Value:
-	//      Nothing
-	//  Summary:	
-	//		Internal debug output generation.
-	void cMemoryManager::DebugOutputFile(const jrs_i8 *pFile, jrs_bool bCreate, const jrs_i8 *pText, ...)
+	//      Nothing.
+	//  Summary:
+	//      Resets all heap statistics.
+	void cMemoryManager::ResetHeapStatistics(void)
 	{
-		// Can we write the file?
-		if(m_MemoryManagerFileOutput || m_MemoryManagerLiveViewOutput)
+		for(jrs_u32 i = m_UserHeapRegistry.uMaxSlots; i > 0; i--)
 		{
-			jrs_i8 OutputText[2048];
-
-			// Write the file
-			va_list args;
-
-			// Create the string
-			va_start(args, pText);
-			vsnprintf(OutputText, 2046, pText, args);
-			va_end(args); 
-
-			strcat(OutputText, "\n");
-
-			if(m_MemoryManagerFileOutput && pFile)
-				m_MemoryManagerFileOutput(OutputText, (int)strlen(OutputText), pFile, !bCreate);
-
-			if(m_MemoryManagerLiveViewOutput)
-				m_MemoryManagerLiveViewOutput(OutputText, (int)strlen(OutputText), pFile, !bCreate);
+			if(m_UserHeapRegistry.pSlots[i - 1].pHeap)
+			{
+				((cHeap *)m_UserHeapRegistry.pSlots[i - 1].pHeap)->ResetStatistics();
+			}
 		}
-	}
 
-	//  Description:
-	//		Standard Elephant debug error generator.
-	//  See Also:
-	//		
-	//  Arguments:
-	//		uErrorCode - Error code.  Normally just line number.
-	//		pText - Standard text string. 2k - 1 max length.
-	//  Return Value:
-	//      Nothing
-	//  Summary:	
-	//		Internal debug output generation.
-	void cMemoryManager::DebugError(jrs_u32 uErrorCode, const jrs_i8 *pText)
-	{
-		if(cMemoryManager::m_MemoryManagerError)
+		for(jrs_u32 i = m_NIHeapRegistry.uMaxSlots; i > 0; i--)
 		{
-			if(m_bLiveViewRunning)
+			if(m_NIHeapRegistry.pSlots[i - 1].pHeap)
 			{
-				// Flush any pending
-				JRSThread::SleepMilliSecond(m_uLiveViewPoll * 100);
+				((cHeapNonIntrusive *)m_NIHeapRegistry.pSlots[i - 1].pHeap)->ResetStatistics();
 			}
-
-			cMemoryManager::m_MemoryManagerError(pText, uErrorCode);
 		}
+
+		for(jrs_u32 i = m_HeapRegistry.uMaxSlots; i > 0; i--)
+		{
+			if(m_HeapRegistry.pSlots[i - 1].pHeap)
+			{
+				((cHeap *)m_HeapRegistry.pSlots[i - 1].pHeap)->ResetStatistics();
+			}
+		}		
 	}
 
 	//  Description:
-	//		Standard Elephant debug error generator.
+	//      Takes or releases the thread locks of every pool attached to a heap, including the size class pools and the magazine caches.
+	//		m_PoolListLock must be held so no pool is attached or removed while the lists are walked.  Internal function.
 	//  See Also:
-	//		
+	//      LockAllHeaps, UnlockAllHeaps, ReinitializeAllHeapLocks
 	//  Arguments:
-	//		pHeap - Valid pHeap for heap error or NULL for manager error.
-	//		pPool - Valid pPool for pool error or NULL for manager error.
-	//		uErrorCode - Error code.  Normally just line number.
-	//		pFunction - Name of the function.
-	//		pText - Standard text string. 2k - 1 max length.
-	//		... - variable args.
+	//		eOperation - Lock, unlock or recreate the locks.
 	//  Return Value:
-	//      Nothing
-	//  Summary:	
-	//		Internal debug output generation.
-	void cMemoryManager::DebugWarning(cHeap *pHeap, cPoolBase *pPool, jrs_u32 uErrorCode, const jrs_i8 *pFunction, const jrs_i8 *pText, ...)
+	//      Nothing.
+	//  Summary:
+	//      Locks, unlocks or recreates all pool locks.
+	void cMemoryManager::AllPoolLocks(ePoolLockOperation eOperation)
 	{
-		// We always do this for warnings.  We will print them out.  
-		jrs_i8 logtext[2048];
-		va_list args;
-
-		sprintf(logtext, "Error 0x%x: ", uErrorCode);
-
-		// Create the string
-		va_start(args, pText);
-		vsnprintf(&logtext[strlen(logtext)], 2047, pText, args);
-		va_end(args);  
-
-		if(cMemoryManager::m_MemoryManagerTTYOutput)
+		// Pools never lock each other so any order will do.  A heap in a slot cannot be destroyed while the pool list lock is held.
+		sHeapRegistry *pRegistries[2] = { &m_HeapRegistry, &m_UserHeapRegistry };
+		for(jrs_u32 r = 0; r < 2; r++)
 		{
-			if(pHeap && pHeap->AreErrorsEnabled())
-			{
-				cMemoryManager::m_MemoryManagerTTYOutput(logtext);
-				if(!pHeap->AreErrorsWarningsOnly())
-				{
-					if(pHeap->m_bEnableReportsInErrors)
-						pHeap->ReportStatistics(false);
-					DebugError(uErrorCode, logtext);
-				}
-			}
-			else if(pPool && pPool->AreErrorsEnabled())
+			for(jrs_u32 i = 0; i < pRegistries[r]->uMaxSlots; i++)
 			{
-				cMemoryManager::m_MemoryManagerTTYOutput(logtext);
-				if(!pPool->AreErrorsWarningsOnly())
+				cHeap *pHeap = (cHeap *)pRegistries[r]->pSlots[i].pHeap;
+				if(!pHeap)
+					continue;
+
+				for(cPoolBase *pPool = pHeap->m_pAttachedPools; pPool; pPool = pPool->m_pNext)
 				{
-					DebugError(uErrorCode, logtext);
+					if(eOperation == ePoolLock_Lock)
+						pPool->LockAllThreadLocks();
+					else if(eOperation == ePoolLock_Unlock)
+						pPool->UnlockAllThreadLocks();
+					else
+						pPool->ReinitializeThreadLocks();
 				}
 			}
-			else
-			{
-				cMemoryManager::m_MemoryManagerTTYOutput(logtext);
-				DebugError(uErrorCode, logtext);
-			}
 		}
 	}
 
 	//  Description:
-	//		Standard Elephant debug error generator.
+	//      Takes the thread lock of every pool, every heap and then the memory manager so no other thread can be part way through an
+	//		allocation.  Used around fork so the child process does not inherit a lock held by another thread.  Logging and debugging
+	//		locks are not taken.
 	//  See Also:
-	//		
+	//      UnlockAllHeaps
 	//  Arguments:
-	//		pHeap - Valid pHeap for heap error or NULL for manager error.
-	//		pPool - Valid pPool for pool error or NULL for manager error.
-	//		uErrorCode - Error code.  Normally just line number.
-	//		pFunction - Name of the function.
-	//		pText - Standard text string. 2k - 1 max length.
-	//		... - variable args.
+	//		None.
 	//  Return Value:
-	//      Nothing
-	//  Summary:	
-	//		Internal debug output generation.
-	void cMemoryManager::DebugWarning(cHeapNonIntrusive *pHeap, cPoolBase *pPool, jrs_u32 uErrorCode, const jrs_i8 *pFunction, const jrs_i8 *pText, ...)
+	//      Nothing.
+	//  Summary:
+	//      Locks all heaps.
+	void cMemoryManager::LockAllHeaps(void)
 	{
-		// We always do this for warnings.  We will print them out.  
-		jrs_i8 logtext[2048];
-		va_list args;
-
-		sprintf(logtext, "Error 0x%x: ", uErrorCode);
-
-		// Create the string
-		va_start(args, pText);
-		vsnprintf(&logtext[strlen(logtext)], 2047, pText, args);
-		va_end(args);  
-
-		if(cMemoryManager::m_MemoryManagerTTYOutput)
+		// Pools lock their heap when they grow so every pool is locked before any heap.
+		m_PoolListLock.Lock();
+		AllPoolLocks(ePoolLock_Lock);
+
+		// Heap locks are taken before the manager lock when heaps resize so the same order is used here.  A registry that grew while
+		// its locks were being taken has the new ones taken too.
+		sHeapRegistry *pRegistries[3] = { &m_HeapRegistry, &m_UserHeapRegistry, &m_NIHeapRegistry };
+		jrs_u32 uLocked[3] = { 0, 0, 0 };
+		jrs_bool bGrew;
+		do
 		{
-			if(pHeap && pHeap->AreErrorsEnabled())
-			{
-				cMemoryManager::m_MemoryManagerTTYOutput(logtext);
-				if(!pHeap->AreErrorsWarningsOnly())
-				{
-					if(pHeap->m_bEnableReportsInErrors)
-						pHeap->ReportStatistics(false);
-					DebugError(uErrorCode, logtext);
-				}
-			}
-			else if(pPool && pPool->AreErrorsEnabled())
-			{
-				cMemoryManager::m_MemoryManagerTTYOutput(logtext);
-				if(!pPool->AreErrorsWarningsOnly())
-				{
-					DebugError(uErrorCode, logtext);
-				}
-			}
-			else
+			for(jrs_u32 r = 0; r < 3; r++)
 			{
-				cMemoryManager::m_MemoryManagerTTYOutput(logtext);
-				DebugError(uErrorCode, logtext);
+				for(; uLocked[r] < pRegistries[r]->uMaxSlots; uLocked[r]++)
+					pRegistries[r]->pSlots[uLocked[r]].pLock->Lock();
 			}
-		}
+
+			m_MMThreadLock.Lock();
+			bGrew = FALSE;
+			for(jrs_u32 r = 0; r < 3; r++)
+				bGrew |= uLocked[r] != pRegistries[r]->uMaxSlots;
+			if(bGrew)
+				m_MMThreadLock.Unlock();
+		}while(bGrew);
+
+		m_RegionCacheLock.Lock();
+		m_SamplerLock.Lock();
 	}
 
 	//  Description:
-	//		Returns the amount of free usable memory that Elephant has to allocate managed heaps from.  This does not include 
-	//		memory taken with self managed heaps.
+	//      Releases the locks taken by LockAllHeaps.
 	//  See Also:
-	//		Initialize
+	//      LockAllHeaps
 	//  Arguments:
-	//		Nothing
+	//		None.
 	//  Return Value:
-	//      The amount of remaining memory available to Elephant for managed heaps.
-	//  Summary:	
-	//		Returns the amount of free usable memory that Elephant has to allocate managed heaps from.
-	jrs_u64 cMemoryManager::GetFreeUsableMemory(void) const 
-	{ 
-		return (jrs_u64)((jrs_i8 *)m_pUseableMemoryEnd - (jrs_i8 *)m_pUsableHeapMemoryStart); 
+	//      Nothing.
+	//  Summary:
+	//      Unlocks all heaps.
+	void cMemoryManager::UnlockAllHeaps(void)
+	{
+		m_SamplerLock.Unlock();
+		m_RegionCacheLock.Unlock();
+		m_MMThreadLock.Unlock();
+
+		sHeapRegistry *pRegistries[3] = { &m_NIHeapRegistry, &m_UserHeapRegistry, &m_HeapRegistry };
+		for(jrs_u32 r = 0; r < 3; r++)
+		{
+			for(jrs_u32 i = pRegistries[r]->uMaxSlots; i > 0; i--)
+				pRegistries[r]->pSlots[i - 1].pLock->Unlock();
+		}
+
+		AllPoolLocks(ePoolLock_Unlock);
+		m_PoolListLock.Unlock();
 	}
 
 	//  Description:
-	//		Returns the system page size.
+	//      Recreates the locks taken by LockAllHeaps without unlocking them.  Call this instead of UnlockAllHeaps in the child process after
+	//		fork.  Only the forking thread exists in the child so a lock whose owner thread is gone could never be unlocked there.  Every lock
+	//		is recreated rather than relying on which thread took it.
 	//  See Also:
-	//		Initialize
+	//      LockAllHeaps, UnlockAllHeaps
 	//  Arguments:
-	//		Nothing
+	//		None.
 	//  Return Value:
-	//      System page size.
-	//  Summary:	
-	//		Returns the system page size.
-	jrs_sizet cMemoryManager::GetSystemPageSize(void) const
+	//      Nothing.
+	//  Summary:
+	//      Recreates all heap locks in a forked child.
+	void cMemoryManager::ReinitializeAllHeapLocks(void)
 	{
-		return m_uSystemPageSize;
+		new (&m_MMThreadLock) JRSMemory_ThreadLock();
+		new (&m_RegionCacheLock) JRSMemory_ThreadLock();
+		new (&m_SamplerLock) JRSMemory_ThreadLock();
+		new (&m_StatsPageLock) JRSMemory_ThreadLock();
+
+		sHeapRegistry *pRegistries[3] = { &m_HeapRegistry, &m_UserHeapRegistry, &m_NIHeapRegistry };
+		for(jrs_u32 r = 0; r < 3; r++)
+		{
+			for(jrs_u32 i = 0; i < pRegistries[r]->uMaxSlots; i++)
+				new (pRegistries[r]->pSlots[i].pLock) JRSMemory_ThreadLock();
+		}
+
+		AllPoolLocks(ePoolLock_Reinitialize);
+		new (&m_PoolListLock) JRSMemory_ThreadLock();
 	}
 
 	//  Description:
-	//		Returns the system page size.
+	//      Replaces standard system malloc but allows for more advanced allocation parameters such as alignment. Malloc will
+	//		automatically send the allocation to the last created heap, unless a malloc route covers the size and alignment.  Routes
+	//		are tried in the order they were added (the small heap is always the first) and a full route passes the allocation on to
+	//		the next matching route and finally the default heap.
+	//		Flags are set by the user.  It can be one of JRSMEMORYFLAG_xxx or any user specified flags > JRSMEMORYFLAG_RESERVED3
+	//		but smaller than or equal to 15, values greater than 15 will be lost and operation of Malloc is undefined.  Input text is
+	//		limited to 32 chars including terminator.  Strings longer than this will only store the last 31 chars.
 	//  See Also:
-	//		Initialize
+	//		Free
 	//  Arguments:
-	//		Nothing
+	//      uSizeInBytes - Size in bytes. Minimum size will be 16bytes unless the heap settings have set a larger minimum size.
+	//		uAlignment - Default alignment is 16bytes unless heap settings have set a larger alignment.
+	//					 Any specified alignments must be a power of 2. Passing 0 will set it to the correct alignment for the heap.
+	//		uFlag - One of JRSMEMORYFLAG_xxx or user defined value.  Default JRSMEMORYFLAG_NONE.  See description for more details.
+	//		pText - NULL terminating text string to associate with the allocation.
+	//		uExternalId - An external id to associate with the allocation.  Default 0.
 	//  Return Value:
-	//      System page size.
-	//  Summary:	
-	//		Returns the system page size.
-	jrs_u16 cMemoryManager::GetLVPortNumber(void) const
+	//      Valid pointer to allocated memory.
+	//		NULL otherwise.
+	//  Summary:
+	//      Allocates memory with additional information.
+	void *cMemoryManager::Malloc(jrs_sizet uSizeInBytes, jrs_u32 uAlignment, jrs_u32 uFlag, const jrs_i8 *pText, const jrs_u32 uExternalId /* = 0*/)
 	{
-		return m_uLVPort;
+		return InternalMalloc(uSizeInBytes, uAlignment, uFlag, pText, uExternalId, false);
 	}
 
 	//  Description:
-	//		Used to determine if the memory manager is initialized or not.
+	//      Allocates uCount elements of uSizeInBytes each, cleared to zero.  Routing is the same as Malloc.  Heaps skip clearing memory they know has
+	//		not been touched since it came from the system, such as the unused end of the heap or pages released back to the system, so large
+	//		allocations from fresh memory only cost the page faults.
 	//  See Also:
-	//		Initialize
+	//		Malloc, cHeap::AllocateZeroed, cHeapNonIntrusive::AllocateZeroed
 	//  Arguments:
-	//		Nothing
+	//      uCount - Number of elements.
+	//		uSizeInBytes - Size in bytes of each element.
+	//		uAlignment - Default alignment is 16bytes unless heap settings have set a larger alignment.
+	//					 Any specified alignments must be a power of 2. Passing 0 will set it to the correct alignment for the heap.
+	//		uFlag - One of JRSMEMORYFLAG_xxx or user defined value.  Default JRSMEMORYFLAG_NONE.
+	//		pText - NULL terminating text string to associate with the allocation.  Default NULL.
+	//		uExternalId - An external id to associate with the allocation.  Default 0.
 	//  Return Value:
-	//      TRUE if initialized.
-	//		FALSE otherwise.
-	//  Summary:	
-	//		Determines if the memory manager is initialized or not.
-	jrs_bool cMemoryManager::IsInitialized(void) const 
-	{ 
-		return m_bInitialized; 
+	//      Valid pointer to zero filled memory.
+	//		NULL otherwise or if uCount * uSizeInBytes overflows.
+	//  Summary:
+	//      Allocates zero filled memory.
+	void *cMemoryManager::Calloc(jrs_sizet uCount, jrs_sizet uSizeInBytes, jrs_u32 uAlignment /*= 0*/, jrs_u32 uFlag /*= JRSMEMORYFLAG_NONE*/, const jrs_i8 *pText /*= NULL*/, const jrs_u32 uExternalId /*= 0*/)
+	{
+		if(uSizeInBytes && uCount > ((jrs_sizet)-1) / uSizeInBytes)
+		{
+			MemoryWarning(0, JRSMEMORYERROR_INVALIDARGUMENTS, "Calloc size overflows.  %llu elements of %llu bytes.", (jrs_u64)uCount, (jrs_u64)uSizeInBytes);
+			return NULL;
+		}
+
+		return InternalMalloc(uCount * uSizeInBytes, uAlignment, uFlag, pText, uExternalId, true);
 	}
 
 	//  Description:
-	//		Tries to reclaim on all cHeaps.
+	//      Malloc and Calloc implementation.  Private.
 	//  See Also:
-	//		cHeap::Reclaim
+	//		Malloc, Calloc
 	//  Arguments:
-	//		Nothing
+	//      uSizeInBytes - Size in bytes.
+	//		uAlignment - Alignment or 0 for the heap default.
+	//		uFlag - One of JRSMEMORYFLAG_xxx or user defined value.
+	//		pText - NULL terminating text string to associate with the allocation.
+	//		uExternalId - An external id to associate with the allocation.
+	//		bZeroed - TRUE to return zero filled memory.
 	//  Return Value:
-	//      None
-	//  Summary:	
-	//		Tries to reclaim on all cHeaps.
-	void cMemoryManager::Reclaim(void)
+	//      Valid pointer to allocated memory.
+	//		NULL otherwise.
+	//  Summary:
+	//      Allocates memory through the malloc routes.
+	void *cMemoryManager::InternalMalloc(jrs_sizet uSizeInBytes, jrs_u32 uAlignment, jrs_u32 uFlag, const jrs_i8 *pText, const jrs_u32 uExternalId, jrs_bool bZeroed)
 	{
-		for(jrs_u32 i = 0; i < MemoryManager_MaxHeaps; i++)
+		// Check to ensure valid heap
+		if(!m_uHeapNum)
+		{
+			MemoryWarning(m_uHeapNum, JRSMEMORYERROR_NOVALIDHEAP, "No valid heap to allocate from.  Use CreateHeap to create one before calling Malloc.");
+			return NULL;
+		}
+
+		// Try the routes overlapping the size class in the order they were added.  A route that cannot serve the allocation overflows into the next.
+		jrs_u32 uRoutes = m_uMallocRouteClasses[GetMallocRouteClass(uSizeInBytes)];
+		while(uRoutes)
 		{
-			if(m_pHeaps[i])
+			sMallocRoute *pRoute = &m_MallocRoutes[JRSCountTrailingZero(uRoutes)];
+			uRoutes &= uRoutes - 1;
+			if(uSizeInBytes < pRoute->uMinSize || uSizeInBytes > pRoute->uMaxSize || uAlignment > pRoute->uMaxAlignment)
+				continue;
+
+			void *pMem;
+			jrs_bool bOverflow = TRUE;
+			if(pRoute->pPool)
+			{
+				pMem = pRoute->pPool->AllocateMemory(pText);
+				if(pMem && bZeroed)
+					memset(pMem, 0, uSizeInBytes);
+			}
+			else if(pRoute->pNIHeap)
+			{
+				jrs_u32 uNIAlignment = uAlignment > pRoute->pNIHeap->GetDefaultAlignment() ? uAlignment : 0;
+				pMem = bZeroed ? pRoute->pNIHeap->AllocateZeroed(uSizeInBytes, uNIAlignment, uFlag, pText, uExternalId) : pRoute->pNIHeap->AllocateMemory(uSizeInBytes, uNIAlignment, uFlag, pText, uExternalId);
+				bOverflow = pRoute->pNIHeap->IsOutOfMemoryReturnEnabled();
+			}
+			else
+			{
+				jrs_u32 uHeapAlignment = uAlignment > pRoute->pHeap->GetDefaultAlignment() ? uAlignment : 0;
+				pMem = bZeroed ? pRoute->pHeap->AllocateZeroed(uSizeInBytes, uHeapAlignment, uFlag, pText, uExternalId) : pRoute->pHeap->AllocateMemory(uSizeInBytes, uHeapAlignment, uFlag, pText, uExternalId);
+				bOverflow = pRoute->pHeap->IsOutOfMemoryReturnEnabled();
+			}
+
+			if(pMem)
+				return pMem;
+
+#ifndef MEMORYMANAGER_MINIMAL
+			// Heaps that do not return on out of memory have already reported the error.  Master builds carry on to the next route.
+			if(!bOverflow)
+				return NULL;
+
+			// Warn once with a warning when the route overflows.
+			if(!pRoute->uOverflows)
 			{
-				m_pHeaps[i]->Reclaim();
+				const jrs_i8 *pName = pRoute->pPool ? pRoute->pPool->GetName() : (pRoute->pNIHeap ? pRoute->pNIHeap->GetName() : pRoute->pHeap->GetName());
+				DebugOutput("Malloc route to %s has been exhausted. Memory will use the next route or the default Malloc heap.  You will see this warning only once per route.", pName);
 			}
+#else
+			(void)bOverflow;
+#endif
+			pRoute->uOverflows++;
 		}
+
+		// No just allocate
+		if(bZeroed)
+			return GetDefaultHeap()->AllocateZeroed(uSizeInBytes, uAlignment, uFlag, pText, uExternalId);
+		return GetDefaultHeap()->AllocateMemory(uSizeInBytes, uAlignment, uFlag, pText, uExternalId);
 	}
 
 	//  Description:
-	//		Enables or disables continuous logging.  This is used to control output to a continuous log file and TYY using the user callback functions.
+	//      Gets the zero fill guarantees of a pair of system callbacks.  The platform defaults report their own guarantees and the callbacks
+	//		passed to InitializeAllocationCallbacks report the flags passed with them.  Anything else has no guarantees.  Private.
 	//  See Also:
-	//		IsLoggingEnabled
+	//		InitializeAllocationCallbacks, Calloc
 	//  Arguments:
-	//		bEnable - TRUE to enable logging.  FALSE to disable.
+	//      Allocator - System allocator.  May be NULL.
+	//		Release - System release callback.  May be NULL.
 	//  Return Value:
-	//      Nothing
-	//  Summary:	
-	//		Enables or disables continuous logging.
-	void cMemoryManager::EnableLogging(jrs_bool bEnable)
+	//      JRSMEMORYZEROFLAG_xxx flags.
+	//  Summary:
+	//      Gets the zero fill guarantees of the system callbacks.
+	jrs_u32 cMemoryManager::GetSystemZeroFlags(MemoryManagerDefaultAllocator Allocator, MemoryManagerDefaultRelease Release)
 	{
-		m_bEnableContinuousDump = bEnable;
-		ContinuousLogging_Operation(eContLog_StartLogging, NULL, NULL, 0);
+		jrs_u32 uPlatformFlags = MemoryManagerDefaultSystemZeroFlags();
+		jrs_u32 uFlags = JRSMEMORYZEROFLAG_NONE;
+
+		if(Allocator == MemoryManagerDefaultSystemAllocator)
+			uFlags |= uPlatformFlags & JRSMEMORYZEROFLAG_ALLOCATOR;
+		else if(Allocator && Allocator == m_MemoryManagerDefaultAllocator)
+			uFlags |= m_uMemoryManagerDefaultZeroFlags & JRSMEMORYZEROFLAG_ALLOCATOR;
+
+		if(Release == MemoryManagerDefaultSystemRelease)
+			uFlags |= uPlatformFlags & JRSMEMORYZEROFLAG_RELEASE;
+		else if(Release && Release == m_MemoryManagerDefaultSystemRelease)
+			uFlags |= m_uMemoryManagerDefaultZeroFlags & JRSMEMORYZEROFLAG_RELEASE;
+
+		return uFlags;
 	}
 
 	//  Description:
-	//		Determines if logging is currently enabled or not.
+	//      Replaces standard system malloc but allows for more advanced allocation parameters such as alignment. Malloc will
+	//		automatically send the allocation to the last created heap, unless a small heap is specified.  If a small heap is
+	//		specified and the allocation size is <= the maximum allocation size of the small heap the small heap will try to allocate.
+	//		Allocation flag defaults to JRSMEMORYFLAG_NONE and passed in string is NULL.  In NAC or NACS libraries the string will
+	//		be given a default value of 'Unknown'.
 	//  See Also:
-	//		EnableLogging
+	//		Free, Realloc
 	//  Arguments:
-	//		None
+	//      uSizeInBytes - Size in bytes. Minimum size will be 16bytes unless the heap settings have set a larger minimum size.
+	//		uAlignment - Default alignment is 16bytes unless heap settings have set a larger alignment.
+	//					 Any specified alignments must be a power of 2. Passing 0 will set it to the correct alignment for the heap.
 	//  Return Value:
-	//      TRUE if logging is currently enabled.
-	//		FALSE otherwise.
+	//      Valid pointer to allocated memory.
+	//		NULL otherwise.
 	//  Summary:	
-	//		Determines if logging is currently enabled or not.
-	jrs_bool cMemoryManager::IsLoggingEnabled(void) const 
-	{ 
-		return m_bEnableContinuousDump; 
+	//		Allocates memory with standard values.
+	void *cMemoryManager::Malloc(jrs_sizet uSizeInBytes, jrs_u32 uAlignment)
+	{
+		// No just allocate
+		return Malloc(uSizeInBytes, uAlignment, JRSMEMORYFLAG_NONE, NULL);
 	}
 
-
 	//  Description:
-	//		Creates a callstack to a string
+	//      Routes allocations made with Malloc between uMinSize and uMaxSize (inclusive) to a heap.  Routes are tried in the order they are added
+	//		and an allocation that the heap cannot serve moves on to the next matching route and finally the default heap.  This only happens when
+	//		the heap has bReturnNullOnOutOfMemory set, otherwise the heap reports the error and Malloc returns NULL.  Routes should be set up before
+	//		other threads start calling Malloc.
 	//  See Also:
-	//		ReportAll
+	//		ClearMallocRoutes, ReportMallocRoutes, Malloc
 	//  Arguments:
-	//		pOutputBuffer - Pointer to the start of the string to append to.
-	//		pCallstack - Pointer to the callstack values
-	//		uCallStackCount - Number of callstack values
+	//      uMinSize - Smallest allocation size in bytes to route.
+	//		uMaxSize - Largest allocation size in bytes to route.
+	//		pHeap - Heap to allocate from.
+	//		uMaxAlignment - Largest alignment to route.  0 uses the default alignment of the heap.
 	//  Return Value:
-	//      None
-	//  Summary:	
-	//		Creates a callstack to a string
-	void cMemoryManager::StackToString(jrs_i8 *pOutputBuffer, jrs_sizet *pCallstack, jrs_u32 uCallStackCount)
+	//      TRUE if the route was added.  FALSE otherwise.
+	//  Summary:
+	//      Routes a band of Malloc sizes to a heap.
+	jrs_bool cMemoryManager::AddMallocRoute(jrs_sizet uMinSize, jrs_sizet uMaxSize, cHeap *pHeap, jrs_u32 uMaxAlignment /*= 0*/)
 	{
-		char outbuffer[386];
-		for(jrs_u32 i = 0; i < uCallStackCount; i++)
-		{
-			jrs_sizet uFuncStartAdd = 0;
-			jrs_sizet uFuncSize = 0;
-			outbuffer[0] = ' ';
-			outbuffer[1] = '\0';
-			MemoryManagerPlatformFunctionNameFromAddress(pCallstack[i], &outbuffer[1], &uFuncStartAdd, &uFuncSize);
-			if(uFuncSize == 0)
-			{
-#ifdef JRS64BIT
-				sprintf(outbuffer, " 0x%llu", (jrs_u64)pCallstack[i]);
-#else
-				sprintf(outbuffer, " 0x%u", (jrs_u32)pCallstack[i]);
-#endif
-			}
-			strcat(pOutputBuffer, outbuffer);
-		}
+		MemoryWarning(pHeap, JRSMEMORYERROR_HEAPINVALID, "Malloc route heap is not valid.");
+		if(!pHeap)
+			return FALSE;
+
+		return InternalAddMallocRoute(uMinSize, uMaxSize, uMaxAlignment ? uMaxAlignment : pHeap->GetDefaultAlignment(), pHeap, NULL, NULL);
 	}
 
 	//  Description:
-	//		Internal only.  Inserts the continuous data into the ring buffer.
+	//      Routes allocations made with Malloc between uMinSize and uMaxSize (inclusive) to a non intrusive heap.  See the cHeap version for details.
+	//		Memory from the heap is freed by Free and resized by Realloc as normal.
 	//  See Also:
-	//		ContinuousLogging_PoolOperation
+	//		ClearMallocRoutes, ReportMallocRoutes, Malloc
 	//  Arguments:
-	//		rOp - Operation details to add to the list.
-	//		pData - Data operation to add to the list.
+	//      uMinSize - Smallest allocation size in bytes to route.
+	//		uMaxSize - Largest allocation size in bytes to route.
+	//		pHeap - Non intrusive heap to allocate from.
+	//		uMaxAlignment - Largest alignment to route.  0 uses the default alignment of the heap.
 	//  Return Value:
-	//      Nothing
-	//  Summary:	
-	//		Reports any operations that occur on a specific heap.  These cover Allocations, Frees and Reallocs.  Reallocs may not always show.
-	void cMemoryManager::ContinuousLog_AddToBuffer(sLVOperation &rOp, void *pData)
+	//      TRUE if the route was added.  FALSE otherwise.
+	//  Summary:
+	//      Routes a band of Malloc sizes to a non intrusive heap.
+	jrs_bool cMemoryManager::AddMallocRoute(jrs_sizet uMinSize, jrs_sizet uMaxSize, cHeapNonIntrusive *pHeap, jrs_u32 uMaxAlignment /*= 0*/)
 	{
-#ifndef MEMORYMANAGER_MINIMAL
-		// Only if active
-		if(!m_bELVContinuousGrab)
-			return;
-
-		// Prevent multiple locks taking place while adding data.
-		while(m_bLiveViewRunning && m_bELVContinuousGrab)
-		{
-			m_LVThreadLock.Lock();
+		MemoryWarning(pHeap, JRSMEMORYERROR_HEAPINVALID, "Malloc route heap is not valid.");
+		if(!pHeap)
+			return FALSE;
 
-			jrs_u32 uCurRead = m_uELVDBRead;
-			jrs_u32 uCurWrite = m_uELVDBWrite;
-			jrs_u32 uCurWriteEnd = m_uELVDBWriteEnd;
+		return InternalAddMallocRoute(uMinSize, uMaxSize, uMaxAlignment ? uMaxAlignment : (jrs_u32)pHeap->GetDefaultAlignment(), NULL, pHeap, NULL);
+	}
 
-			jrs_u32 uReadMsb = uCurRead & 1;
-			jrs_u32 uWriteMsb = uCurWrite & 1;
+	//  Description:
+	//      Routes allocations made with Malloc between uMinSize and uMaxSize (inclusive) to a pool.  uMaxSize is clipped to the element size of the pool
+	//		and alignments up to the pool alignment are routed.  Once the pool cannot allocate allocations move on to the next matching route.
+	//		Realloc moves pool allocations out of the pool.
+	//  See Also:
+	//		ClearMallocRoutes, ReportMallocRoutes, Malloc
+	//  Arguments:
+	//      uMinSize - Smallest allocation size in bytes to route.
+	//		uMaxSize - Largest allocation size in bytes to route.
+	//		pPool - Pool to allocate from.
+	//  Return Value:
+	//      TRUE if the route was added.  FALSE otherwise.
+	//  Summary:
+	//      Routes a band of Malloc sizes to a pool.
+	jrs_bool cMemoryManager::AddMallocRoute(jrs_sizet uMinSize, jrs_sizet uMaxSize, cPool *pPool)
+	{
+		MemoryWarning(pPool, JRSMEMORYERROR_INVALIDARGUMENTS, "Malloc route pool is not valid.");
+		if(!pPool)
+			return FALSE;
 
-			uCurRead &= ~1;
-			uCurWrite &= ~1;
+		if(uMaxSize > pPool->GetAllocationSize())
+			uMaxSize = pPool->GetAllocationSize();
 
-			jrs_u32 uSizeToAdd = sizeof(sLVOperation) + rOp.sizeofopdata;
-			jrs_u32 uNewWriteEnd = uCurWrite + uSizeToAdd;
+		return InternalAddMallocRoute(uMinSize, uMaxSize, pPool->m_uAlignment, NULL, NULL, pPool);
+	}
 
-			if(uReadMsb == uWriteMsb)
-			{
-				// Read is ALWAYS behind write.
+	//  Description:
+	//      Adds a route to the end of the malloc route table.  Internal function.
+	//  See Also:
+	//		AddMallocRoute
+	//  Arguments:
+	//      uMinSize - Smallest allocation size in bytes to route.
+	//		uMaxSize - Largest allocation size in bytes to route.
+	//		uMaxAlignment - Largest alignment to route.
+	//		pHeap, pNIHeap, pPool - Destination.  Only one is valid.
+	//  Return Value:
+	//      TRUE if the route was added.  FALSE otherwise.
+	//  Summary:
+	//      Adds a malloc route.
+	jrs_bool cMemoryManager::InternalAddMallocRoute(jrs_sizet uMinSize, jrs_sizet uMaxSize, jrs_u32 uMaxAlignment, cHeap *pHeap, cHeapNonIntrusive *pNIHeap, cPool *pPool)
+	{
+		MemoryWarning(uMinSize <= uMaxSize, JRSMEMORYERROR_INVALIDARGUMENTS, "Malloc route minimum size is larger than the maximum size.");
+		if(uMinSize > uMaxSize)
+			return FALSE;
 
-				// Same ring
-				if(uNewWriteEnd > m_uELVDebugBufferSize)
-				{
-					// If the wrap ptr is valid we cant do anything yet
-					if(!uCurWriteEnd)
-					{
-						// Loop around
-						m_uELVDBWriteEnd = uCurWrite;
-						m_uELVDBWrite = 0 | (uWriteMsb ^ 1);
-					}					
-				}
-				else
-				{
-					// We can add
-					memcpy((void *)(m_pELVDebugBuffer + uCurWrite), &rOp, sizeof(sLVOperation));
-					if(pData)
-						memcpy((void *)(m_pELVDebugBuffer + uCurWrite + sizeof(rOp)), pData, rOp.sizeofopdata);	
+		m_MMThreadLock.Lock();
 
-					m_uELVDBWrite = uNewWriteEnd | (uWriteMsb);
-					m_LVThreadLock.Unlock();
-					return;				
-				}
-			}	
-			else
-			{
-				// Read is AHEAD of write
-				if(uNewWriteEnd > uCurRead)
-				{
-					// Wait
-				}
-				else
-				{
-					// We can add
-					memcpy((void *)(m_pELVDebugBuffer + uCurWrite), &rOp, sizeof(sLVOperation));
-					if(pData)
-						memcpy((void *)(m_pELVDebugBuffer + uCurWrite + sizeof(rOp)), pData, rOp.sizeofopdata);	
+		MemoryWarning(m_uNumMallocRoutes < MemoryManager_MaxMallocRoutes, JRSMEMORYERROR_INVALIDARGUMENTS, "Too many malloc routes.  Maximum is %d.", MemoryManager_MaxMallocRoutes);
+		if(m_uNumMallocRoutes >= MemoryManager_MaxMallocRoutes)
+		{
+			m_MMThreadLock.Unlock();
+			return FALSE;
+		}
 
-					m_uELVDBWrite = uNewWriteEnd | (uWriteMsb);
-					m_LVThreadLock.Unlock();
-					return;				
-				}
-			}
+		sMallocRoute *pRoute = &m_MallocRoutes[m_uNumMallocRoutes++];
+		pRoute->uMinSize = uMinSize;
+		pRoute->uMaxSize = uMaxSize;
+		pRoute->uMaxAlignment = uMaxAlignment;
+		pRoute->pHeap = pHeap;
+		pRoute->pNIHeap = pNIHeap;
+		pRoute->pPool = pPool;
+		pRoute->uOverflows = 0;
+		BuildMallocRouteClasses();
 
-			m_LVThreadLock.Unlock();
-		}
-#endif
+		m_MMThreadLock.Unlock();
+		return TRUE;
 	}
 
 	//  Description:
-	//		Internal only.  This function add data to the internal ring buffer of operations to be transmitted.  This specific function deals with 
-	//		the heap operations.
+	//      Removes every malloc route including the small heap route.  Malloc will then allocate everything from the default heap.
 	//  See Also:
-	//		ContinuousLogging_Operation, ContinuousLogging_PoolOperation
+	//		AddMallocRoute
 	//  Arguments:
-	//		eType - Type of Logging operation.
-	//		pHeap - Heap pointer.
-	//		pHeaderAdd - Header address of the operation.
-	//		uAlignment - Alignment of the operation.
-	//		uMisc - Misc information.
+	//      None.
 	//  Return Value:
-	//      Nothing
-	//  Summary:	
-	//		Reports any operations that occur on a specific heap.  These cover Allocations, Frees and Reallocs.  Reallocs may not always show.
-	void cMemoryManager::ContinuousLogging_HeapOperation(eContLog eType, cHeap *pHeap, void *pHeaderAdd, jrs_u32 uAlignment, jrs_u64 uMisc)
-	{
+	//      None.
+	//  Summary:
+	//      Removes all malloc routes.
+	void cMemoryManager::ClearMallocRoutes(void)
+	{
+		m_MMThreadLock.Lock();
+		m_uNumMallocRoutes = 0;
+		BuildMallocRouteClasses();
+		m_MMThreadLock.Unlock();
+	}
+
+	//  Description:
+	//      Removes the routes to a heap, non intrusive heap or pool that is being destroyed.  Internal function.
+	//  See Also:
+	//		AddMallocRoute
+	//  Arguments:
+	//      pDestination - Heap, non intrusive heap or pool.
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Removes the routes to a destination.
+	void cMemoryManager::RemoveMallocRoutes(void *pDestination)
+	{
+		m_MMThreadLock.Lock();
+
+		jrs_u32 uRoutes = 0;
+		for(jrs_u32 i = 0; i < m_uNumMallocRoutes; i++)
+		{
+			sMallocRoute *pRoute = &m_MallocRoutes[i];
+			if(pRoute->pHeap == pDestination || pRoute->pNIHeap == pDestination || pRoute->pPool == pDestination)
+				continue;
+
+			m_MallocRoutes[uRoutes++] = *pRoute;
+		}
+
+		if(uRoutes != m_uNumMallocRoutes)
+		{
+			m_uNumMallocRoutes = uRoutes;
+			BuildMallocRouteClasses();
+		}
+
+		m_MMThreadLock.Unlock();
+	}
+
+	//  Description:
+	//      Rebuilds the size class index of the malloc routes.  Each size class holds a mask of the routes whose size band overlaps it so Malloc
+	//		only tests the routes that can match.  Internal function.
+	//  See Also:
+	//		GetMallocRouteClass
+	//  Arguments:
+	//      None.
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Rebuilds the malloc route index.
+	void cMemoryManager::BuildMallocRouteClasses(void)
+	{
+		memset(m_uMallocRouteClasses, 0, sizeof(m_uMallocRouteClasses));
+		m_uMallocRoutePools = 0;
+
+		for(jrs_u32 i = 0; i < m_uNumMallocRoutes; i++)
+		{
+			jrs_u32 uLastClass = GetMallocRouteClass(m_MallocRoutes[i].uMaxSize);
+			for(jrs_u32 uClass = GetMallocRouteClass(m_MallocRoutes[i].uMinSize); uClass <= uLastClass; uClass++)
+				m_uMallocRouteClasses[uClass] |= 1 << i;
+
+			if(m_MallocRoutes[i].pPool)
+				m_uMallocRoutePools |= 1 << i;
+		}
+	}
+
+	//  Description:
+	//      Gets the malloc route size class of a size.  Class 0 is a zero size and class n covers sizes from 2^(n-1) to 2^n - 1.  Internal function.
+	//  See Also:
+	//		BuildMallocRouteClasses
+	//  Arguments:
+	//      uSize - Size in bytes.
+	//  Return Value:
+	//      Size class.
+	//  Summary:
+	//      Gets the malloc route size class.
+	jrs_u32 cMemoryManager::GetMallocRouteClass(jrs_sizet uSize)
+	{
+		if(!uSize)
+			return 0;
+
+		jrs_u32 uHigh = (jrs_u32)((jrs_u64)uSize >> 32);
+		if(uHigh)
+			return 33 + JRSCountLeadingZero(uHigh);
+
+		return 1 + JRSCountLeadingZero((jrs_u32)uSize);
+	}
+
+	//  Description:
+	//      Finds the malloc route pool an allocation was made from.  Internal function.
+	//  See Also:
+	//		AddMallocRoute
+	//  Arguments:
+	//      pMemory - Memory address.
+	//  Return Value:
+	//      Valid cPool pointer if a routed pool owns the address.  NULL otherwise.
+	//  Summary:
+	//      Finds the malloc route pool of an allocation.
+	cPool *cMemoryManager::FindMallocRoutePool(void *pMemory) const
+	{
+		jrs_u32 uRoutes = m_uMallocRoutePools;
+		while(uRoutes)
+		{
+			cPool *pPool = m_MallocRoutes[JRSCountTrailingZero(uRoutes)].pPool;
+			uRoutes &= uRoutes - 1;
+			if(pPool->IsAllocatedFromThisPool(pMemory))
+				return pPool;
+		}
+
+		return NULL;
+	}
+
+	//  Description:
+	//      Outputs the malloc routes in the order they are tried with the number of allocations each could not serve.
+	//  See Also:
+	//		AddMallocRoute
+	//  Arguments:
+	//      None.
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Outputs the malloc routes.
+	void cMemoryManager::ReportMallocRoutes(void)
+	{
+		DebugOutput("Malloc routes: %d", m_uNumMallocRoutes);
+		for(jrs_u32 i = 0; i < m_uNumMallocRoutes; i++)
+		{
+			const sMallocRoute *pRoute = &m_MallocRoutes[i];
+			const jrs_i8 *pType = pRoute->pPool ? "Pool" : (pRoute->pNIHeap ? "NIHeap" : "Heap");
+			const jrs_i8 *pName = pRoute->pPool ? pRoute->pPool->GetName() : (pRoute->pNIHeap ? pRoute->pNIHeap->GetName() : pRoute->pHeap->GetName());
+			DebugOutput("  %llu - %llu bytes, align <= %d -> %s %s.  Overflows: %d", (jrs_u64)pRoute->uMinSize, (jrs_u64)pRoute->uMaxSize, pRoute->uMaxAlignment, pType, pName, pRoute->uOverflows);
+		}
+	}
+
+	//  Description:
+	//      Frees allocated memory. Elephant will automatically search for the heap the allocation was allocated from (See note).
+	//		DeAllocation flag defaults to JRSMEMORYFLAG_NONE.  In NAC or NACS libraries the string associated with the free will
+	//		be given a default value.
+	//		Note: If heaps are created from memory allocated within other heaps the heap with the highest start address containing the memory
+	//		is used.  Heaps that partially overlap other heaps are not supported.
+	//  See Also:
+	//		Free, Malloc, Realloc
+	//  Arguments:
+	//      pMemory - Valid memory address.  A NULL value may cause a warning depending on the settings of the heap.
+	//		uFlag - Defaults to JRSMEMORYFLAG_NONE but can be other user specified values.
+	//  Return Value:
+	//      Nothing.
+	//  Summary:	
+	//		Frees some previously allocated memory.
+	void cMemoryManager::Free(void *pMemory, jrs_u32 uFlag)
+	{
+		Free(pMemory, uFlag, NULL);
+	}
+
+	//  Description:
+	//      Reallocates a block of memory. This works just like standard realloc.  Passing in pMemory as NULL will perform a standard malloc.  Passing 0 
+	//		as a size will free the memory.  Any other size will resize the allocation.  In most situations this may be performed as a malloc, copy, free
+	//		operation.  Memory from a non intrusive heap is reallocated within that heap.  Memory from other heaps, including the small heap,
+	//		stays in its heap and grows in place where possible until the size exceeds the heap's maximum allocation size or the heap runs out of
+	//		space and allows a NULL return.  It is then moved to the heap Malloc selects for the new size.
+	//  See Also:
+	//		Free, Malloc
+	//  Arguments:
+	//      pMemory - Valid memory address.  A NULL value will cause a standard allocation to the default heap to be performed.
+	//		uSizeInBytes - Size in bytes of the memory to resize.  0 causes a free operation to be performed.
+	//		uFlag - Defaults to JRSMEMORYFLAG_NONE but can be other user specified values.
+	//		pText - 32char NULL terminated text string to associate with the memory.
+	//  Return Value:
+	//      Valid memory pointer if memory is valid.  NULL otherwise.
+	//  Summary:	
+	//		Reallocates a block of memory. 
+	void *cMemoryManager::Realloc(void *pMemory, jrs_sizet uSizeInBytes, jrs_u32 uAlignment, jrs_u32 uFlag, const jrs_i8 *pText)
+	{
+		// If memory is null then we just allocate as normal
+		if(!pMemory)
+			return Malloc(uSizeInBytes, uAlignment, uFlag, pText);
+
+		// Pool elements cannot grow.  Move the data to wherever Malloc routes the new size.
+		cPool *pPool = m_uMallocRoutePools ? FindMallocRoutePool(pMemory) : NULL;
+		if(pPool)
+		{
+			void *pNewMemory = uSizeInBytes ? Malloc(uSizeInBytes, uAlignment, uFlag, pText) : NULL;
+			if(!pNewMemory && uSizeInBytes)
+				return NULL;
+
+			if(pNewMemory)
+				memcpy(pNewMemory, pMemory, uSizeInBytes < pPool->GetAllocationSize() ? uSizeInBytes : pPool->GetAllocationSize());
+			pPool->FreeMemory(pMemory, pText);
+			return pNewMemory;
+		}
+
+		// Memory isn't null, it can be reallocated.  We reallocate to the same heap it came from.
+		cHeap *pHeap = FindHeapFromMemoryAddress(pMemory);
+		if(!pHeap)
+		{
+			// Non intrusive heaps can also reallocate
+			cHeapNonIntrusive *pNIHeap = FindNIHeapFromMemoryAddress(pMemory);
+			if(pNIHeap)
+				return pNIHeap->ReAllocateMemory(pMemory, uSizeInBytes, uAlignment, uFlag, pText);
+
+			MemoryWarning(pHeap, JRSMEMORYERROR_UNKNOWNADDRESS, "Heap could not be found for memory allocation. Realloc has failed");
+			return NULL;
+		}
+
+		// Stay in the owning heap while the size still fits it.  This grows in place when it can.  Shrinking never moves.
+		jrs_sizet uMaxSize = pHeap->GetMaxAllocationSize();
+		if(!uSizeInBytes || !uMaxSize || uSizeInBytes <= uMaxSize)
+		{
+			void *pNewMemory = pHeap->ReAllocateMemory(pMemory, uSizeInBytes, uAlignment, uFlag, pText);
+			if(pNewMemory || !uSizeInBytes || !pHeap->IsOutOfMemoryReturnEnabled())
+				return pNewMemory;
+		}
+
+		// Too large for the heap, such as the small heap, or it is full.  Move it to wherever Malloc routes the new size.
+		return ReallocMigrate(pHeap, pMemory, uSizeInBytes, uAlignment, uFlag, pText);
+	}
+
+	//  Description:
+	//      Moves an allocation out of its heap for Realloc.  Memory is allocated through Malloc so the size routing picks the new heap, the bytes
+	//		in use are copied and the old allocation is freed.  The old allocation is left untouched if the new one fails.
+	//  See Also:
+	//		Realloc
+	//  Arguments:
+	//      pHeap - Heap that owns pMemory.
+	//		pMemory - Valid memory address from pHeap.
+	//		uSizeInBytes - New size in bytes.
+	//		uAlignment - Alignment of the new memory.
+	//		uFlag - Defaults to JRSMEMORYFLAG_NONE but can be other user specified values.
+	//		pText - 32char NULL terminated text string to associate with the memory.
+	//  Return Value:
+	//      Valid memory pointer if memory is valid.  NULL otherwise.
+	//  Summary:	
+	//		Moves an allocation to another heap.
+	void *cMemoryManager::ReallocMigrate(cHeap *pHeap, void *pMemory, jrs_sizet uSizeInBytes, jrs_u32 uAlignment, jrs_u32 uFlag, const jrs_i8 *pText)
+	{
+		void *pNewMemory = Malloc(uSizeInBytes, uAlignment, uFlag, pText);
+		if(!pNewMemory)
+			return NULL;
+
+		// Size class allocations have no header.  Heap blocks copy their rounded capacity as resizing in place keeps the original size.
+		cPool *pPool = pHeap->m_uNumSizeClasses ? pHeap->GetSizeClassPool(pMemory) : NULL;
+		jrs_sizet uUsedSize = pPool ? pPool->GetAllocationSize() : (jrs_sizet)HEAP_FULLSIZE_CALC(((sAllocatedBlock *)pMemory - 1)->uSize, pHeap->GetMinAllocationSize());
+		memcpy(pNewMemory, pMemory, uUsedSize < uSizeInBytes ? uUsedSize : uSizeInBytes);
+		pHeap->FreeMemory(pMemory, uFlag, pText);
+
+		return pNewMemory;
+	}
+
+	//  Description:
+	//      Frees allocated memory. Elephant will automatically search for the heap the allocation was allocated from (See note).
+	//		DeAllocation flag defaults to JRSMEMORYFLAG_NONE.  In NAC or NACS libraries the string associated with the free will
+	//		be given a default value otherwise a custom value may be assigned.  See Malloc for futher flag values.  This function is identical to the other cMemoryManager::Free
+	//		except that it allows a string to be associated with the free.
+	//		Note: If heaps are created from memory allocated within other heaps the heap with the highest start address containing the memory
+	//		is used.  Heaps that partially overlap other heaps are not supported.
+	//  See Also:
+	//		Free, Malloc
+	//  Arguments:
+	//      pMemory - Valid memory address.  A NULL value may cause a warning depending on the settings of the heap.
+	//		uFlag - Defaults to JRSMEMORYFLAG_NONE but can be other user specified values.
+	//		pText - 32 byte including terminator value string to be associated with the free. 
+	//  Return Value:
+	//      Nothing.
+	//  Summary:	
+	//		Frees some previously allocated memory.
+	void cMemoryManager::Free(void *pMemory, jrs_u32 uFlag, const jrs_i8 *pText)
+	{
+		// Null frees just get returned
+		if(!pMemory)
+			return;
+
+		// Pools used by malloc routes live inside heaps so they are checked before them.
+		cPool *pPool = m_uMallocRoutePools ? FindMallocRoutePool(pMemory) : NULL;
+		if(pPool)
+		{
+			pPool->FreeMemory(pMemory, pText);
+			return;
+		}
+
+		// Find the heap from the address ranges.  User heaps MAY come from the main heap so the innermost heap is the one found.
+		cHeap *pHeap;
+		cHeapNonIntrusive *pNIHeap;
+		if(FindHeapRange(pMemory, &pHeap, &pNIHeap))
+		{
+			if(pHeap)
+				pHeap->FreeMemory(pMemory, uFlag, pText);
+			else
+				pNIHeap->FreeMemory(pMemory, uFlag, pText);
+			return;
+		}
+
+		MemoryWarning(0, JRSMEMORYERROR_UNKNOWNADDRESS, "Memory could not be found allocated from any of the memory managers heaps.");
+	}
+
+	//  Description:
+	//      Logs a memory marker to the continuous logging information.  Goldfish will use this value as a marker also for its continuous
+	//		views.
+	//  See Also:
+	//		
+	//  Arguments:
+	//      pMarkerName - NULL terminated string of the name of the marker to log.
+	//  Return Value:
+	//      Nothing.
+	//  Summary:	
+	//		Adds a marker to the log.
+	void cMemoryManager::LogMemoryMarker(const jrs_i8 *pMarkerName)
+	{
+		MemoryWarning(pMarkerName, JRSMEMORYERROR_INVALIDMARKER, "Marker name is invalid");
+		ContinuousLogging_Operation(eContLog_Marker, (cHeap *)pMarkerName, NULL, 0);
+	}
+
+	//  Description:
+	//      Returns the size of the allocated memory allocated with Malloc or one of the heap allocation functions.
+	//  See Also:
+	//		Malloc
+	//  Arguments:
+	//      pMemory - Valid memory address.  A NULL value may cause a warning depending on the settings of the heap.
+	//  Return Value:
+	//      Size in bytes of the allocation.
+	//  Summary:	
+	//		Gets the size in bytes of the allocated block of memory.
+	jrs_sizet cMemoryManager::SizeofAllocation(void *pMemory) const
+	{
+		MemoryWarning(pMemory, JRSMEMORYERROR_UNKNOWNADDRESS, "Not a valid allocation.");
+
+		// Size class and malloc route pool allocations have no header.
+		cPool *pPool = m_uMallocRoutePools ? FindMallocRoutePool(pMemory) : NULL;
+		if(pPool)
+			return pPool->GetAllocationSize();
+
+		cHeap *pHeap = FindHeapFromMemoryAddress(pMemory);
+		pPool = (pHeap && pHeap->m_uNumSizeClasses) ? pHeap->GetSizeClassPool(pMemory) : NULL;
+		if(pPool)
+			return pPool->GetAllocationSize();
+
+		sAllocatedBlock *pB = (sAllocatedBlock *)pMemory - 1;
+		return pB->uSize;
+	}
+
+	//  Description:
+	//      Returns the size of the allocated memory allocated with Malloc or one of the heap allocation functions.  This size is the actual size of the allocated
+	//		block which may be larger than the size returned by SizeofAllocation.
+	//  See Also:
+	//		Malloc, SizeofAllocation
+	//  Arguments:
+	//      pMemory - Valid memory address.  A NULL value may cause a warning depending on the settings of the heap.
+	//  Return Value:
+	//      Size in bytes of the allocation.
+	//  Summary:	
+	//		Gets the size in bytes of the allocated block of memory.
+	jrs_sizet cMemoryManager::SizeofAllocationAligned(void *pMemory) const
+	{
+		MemoryWarning(pMemory, JRSMEMORYERROR_UNKNOWNADDRESS, "Not a valid allocation.");
+
+		// Size class and malloc route pool allocations have no header.
+		cPool *pPool = m_uMallocRoutePools ? FindMallocRoutePool(pMemory) : NULL;
+		if(pPool)
+			return pPool->GetAllocationSize();
+
+		cHeap *pHeap = FindHeapFromMemoryAddress(pMemory);
+		pPool = (pHeap && pHeap->m_uNumSizeClasses) ? pHeap->GetSizeClassPool(pMemory) : NULL;
+		if(pPool)
+			return pPool->GetAllocationSize();
+
+		sAllocatedBlock *pB = (sAllocatedBlock *)pMemory - 1;
+		
+		return (jrs_sizet)(HEAP_FULLSIZE_CALC(pB->uSize, pHeap->GetMinAllocationSize()));
+	}
+
+	//  Description:
+	//      Returns the size of the allocation header.  This will be 16 bytes (32 for 64bit) normally but different library configurations
+	//		may change this.
+	//  See Also:
+	//		SizeofAllocation, SizeofFreeBlock
+	//  Arguments:
+	//      None
+	//  Return Value:
+	//      Size in bytes of the allocation header.
+	//  Summary:	
+	//		Gets the size in bytes of the allocation header.
+	jrs_sizet cMemoryManager::SizeofAllocatedBlock(void)
+	{
+		return sizeof(sAllocatedBlock);
+	}
+
+	//  Description:
+	//      Returns the size of the free header.  This is typically always 16bytes larger than the allocation header.
+	//  See Also:
+	//		SizeofAllocation, SizeofAllocationBlock
+	//  Arguments:
+	//      None
+	//  Return Value:
+	//      Size in bytes of the free header.
+	//  Summary:	
+	//		Gets the size in bytes of the free header.
+	jrs_sizet cMemoryManager::SizeofFreeBlock(void)
+	{
+		return sizeof(sFreeBlock);
+	}
+
+	//  Description:
+	//      Returns the flag attached to the allocation.
+	//  See Also:
+	//		
+	//  Arguments:
+	//      None
+	//  Return Value:
+	//      The flag attached to the allocation.
+	//  Summary:	
+	//		Returns the flag attached to the allocation.
+	jrs_u32 cMemoryManager::GetAllocationFlag(void *pMemory) const
+	{
+		MemoryWarning(pMemory, JRSMEMORYERROR_INVALIDALLOCBLOCK, "Not a valid allocation.");
+		sAllocatedBlock *pB = (sAllocatedBlock *)pMemory - 1;
+		return pB->uFlagAndUniqueAllocNumber & 15;
+	}
+
+	//  Description:
+	//      Sets the default heap for malloc to use.  Otherwise it uses the last created user heap.
+	//  See Also:
+	//		GetDefaultHeap
+	//  Arguments:
+	//      pHeap - Valid heap to force allocations to allocated to.  NULL to revert to the last created heap.
+	//  Return Value:
+	//      None
+	//  Summary:	
+	//		Sets the default heap for malloc to use.  Otherwise it uses the last created user heap.
+	void cMemoryManager::SetMallocDefaultHeap(cHeap *pHeap)
+	{
+		if(!pHeap)
+		{
+			m_bOverrideMallocHeap = false;
+			m_pDefaultMallocHeap = GetDefaultHeap();
+		}
+		else
+		{
+			m_bOverrideMallocHeap = true;
+			m_pDefaultMallocHeap = pHeap;
+		}
+	}
+
+	//  Description:
+	//		Runs a full check on all heaps to see if their are any errors like overruns.  Must be using NACS or S libraries 
+	//		for this to be performed.  It is thorough but not a quick operation.
+	//  See Also:
+	//		
+	//  Arguments:
+	//      None
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Checks all heaps for any errors.
+	void cMemoryManager::CheckForErrors(void)
+	{
+		for(jrs_u32 i = 0; i < GetMaxNumHeaps(); i++)
+		{
+			if(GetHeap(i))
+				GetHeap(i)->CheckForErrors();
+		}
+
+		for(jrs_u32 i = 0; i < GetMaxNumUserHeaps(); i++)
+		{
+			if(GetUserHeap(i))
+			{
+				GetUserHeap(i)->CheckForErrors();
+			}
+		}
+	}
+
+	//  Description:
+	//		Does a full memory report (statistics and allocations in memory order) to the user TTY callback.  If you want to report these to a file
+	//		include full path and file name to the function.  The generated file is an Overview file for use in Goldfish.  The file is in a 
+	//		compatible CSV format for loading into a spread sheet for self analysis.  When connected to a debugger TTY output may cause this
+	//		function to take a lot longer than just writing to a log file can take.  Time is proportionate to the number of allocations.
+	//  See Also:
+	//		ReportStatistics, ReportAllocationsMemoryOrder
+	//  Arguments:
+	//      pLogToFile - Full path and file name null terminated string. NULL if you do not wish to generate a file.
+	//		includeFreeBlocks - Reports free blocks to the output also.
+	//		displayCallStack - Logs any the callstacks as well.  May be slow.  Default false.
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Reports on all heaps and can generate an Overview file for Goldfish.
+	void cMemoryManager::ReportAll(const jrs_i8 *pLogToFile, jrs_bool includeFreeBlocks, jrs_bool displayCallStack)
+	{
+		// Used to determine where the reporting comes from
+		g_ReportHeap = true;
+		g_ReportHeapCreate = true;
+
+		for(jrs_u32 i = 0; i < GetMaxNumHeaps(); i++)
+		{
+			if(GetHeap(i))
+				GetHeap(i)->ReportAll(pLogToFile, includeFreeBlocks, displayCallStack);
+		}
+
+		// And the user heap
+		for(jrs_u32 i = 0; i < GetMaxNumUserHeaps(); i++)
+		{
+			if(GetUserHeap(i))
+			{
+				// Report
+				GetUserHeap(i)->ReportAll(pLogToFile, includeFreeBlocks, displayCallStack);
+			}
+		}
+
+		// And the NI heap
+		for(jrs_u32 i = 0; i < GetMaxNumNIHeaps(); i++)
+		{
+			if(GetNIHeap(i))
+			{
+				// Report
+				GetNIHeap(i)->ReportAll(pLogToFile, includeFreeBlocks, displayCallStack);
+			}
+		}
+
+		// Rest
+		g_ReportHeap = false;
+		g_ReportHeapCreate = true;
+	}
+
+	//  Description:
+	//		Reports basic statistics about all heaps to the user TTY callback. Use this to get quick information on 
+	//		when need that is more detailed that simple heap memory realtime calls.
+	//  See Also:
+	//		ReportAll, ReportAllocationsMemoryOrder
+	//  Arguments:
+	//		bAdvanced - When true displays bins and other counts.
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Reports basic statistics about all heaps to the user TTY callback. 
+	void cMemoryManager::ReportStatistics(jrs_bool bAdvanced)
+	{
+		for(jrs_u32 i = 0; i < GetMaxNumHeaps(); i++)
+		{
+			if(GetHeap(i))
+			{
+				// Report
+				GetHeap(i)->ReportStatistics(bAdvanced);
+			}
+		}
+
+		for(jrs_u32 i = 0; i < GetMaxNumUserHeaps(); i++)
+		{
+			if(GetUserHeap(i))
+			{
+				// Report
+				GetUserHeap(i)->ReportStatistics(bAdvanced);
+			}
+		}
+
+		for(jrs_u32 i = 0; i < GetMaxNumNIHeaps(); i++)
+		{
+			if(GetNIHeap(i))
+			{
+				// Report
+				GetNIHeap(i)->ReportStatistics(bAdvanced);
+			}
+		}
+	}
+
+	//  Description:
+	//		Reports on all the allocations in every heap.  This function is like ReportAll but doesnt output the statistics.  Calling
+	//		this function with a valid file name will create an Overview file for use in Goldfish.
+	//  See Also:
+	//		ReportAll, ReportStatistics
+	//  Arguments:
+	//		pLogToFile - Full path and file name null terminated string. NULL if you do not wish to generate a file.
+	//		includeFreeBlocks - Reports free blocks to the output also.
+	//		displayCallStack - Logs any the callstacks as well.  May be slow.  Default false.
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Reports all allocations from all heaps to the user TTY callback and/or a file.
+	void cMemoryManager::ReportAllocationsMemoryOrder(const jrs_i8 *pLogToFile, jrs_bool includeFreeBlocks, jrs_bool displayCallStack)
+	{
+		for(jrs_u32 i = 0; i < GetMaxNumHeaps(); i++)
+		{
+			if(GetHeap(i))
+			{
+				GetHeap(i)->ReportAllocationsMemoryOrder(pLogToFile, includeFreeBlocks, displayCallStack);
+			}
+		}
+
+		for(jrs_u32 i = 0; i < GetMaxNumUserHeaps(); i++)
+		{
+			if(GetUserHeap(i))
+			{
+				GetUserHeap(i)->ReportAllocationsMemoryOrder(pLogToFile, includeFreeBlocks, displayCallStack);
+			}
+		}
+
+		for(jrs_u32 i = 0; i < GetMaxNumNIHeaps(); i++)
+		{
+			if(GetNIHeap(i))
+			{
+				GetNIHeap(i)->ReportAllocationsMemoryOrder(pLogToFile, includeFreeBlocks, displayCallStack);
+			}
+		}
+	}
+	
+	//  Description:
+	//		Forces a ReportAll to be sent to Goldfish.
+	//  See Also:
+	//		
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Forces a ReportAll to be sent to Goldfish.
+	void cMemoryManager::ReportAllToGoldfish(void)
+	{
+		if(m_bLiveViewRunning && !m_bForceLVOverviewGrab)
+		{
+			m_bForceLVOverviewGrab = TRUE;
+
+			// Wait a little while so it can go
+			JRSThread::SleepMilliSecond(100);
+		}
+	}
+
+	//  Description:
+	//		Starts a continuous grab to be sent to Goldfish.
+	//  See Also:
+	//		
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Starts a continuous grab to be sent to Goldfish.
+	void cMemoryManager::ReportContinuousStartToGoldfish(void)
+	{
+		if(m_bLiveViewRunning && !m_bForceLVContinuousGrab)
+		{
+			m_bForceLVContinuousGrab = TRUE;
+		}		
+	}
+
+	//  Description:
+	//		Stops a previously started continuous grab being sent to Goldfish.
+	//  See Also:
+	//		
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Stops a previously started continuous grab being sent to Goldfish.
+	void cMemoryManager::ReportContinuousStopToGoldfish(void)
+	{
+		if(m_bLiveViewRunning && m_bELVContinuousGrab)
+		{
+			m_bForceLVContinuousGrab = TRUE;
+		}		
+	}
+
+	//  Description:
+	//		Standard Elephant debug output generator to pass to user TTY callback.
+	//  See Also:
+	//		
+	//  Arguments:
+	//		pText - Standard text string. 2k - 1 max length.
+	//		... - variable args.
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Internal debug output generation.
+	void cMemoryManager::DebugOutput(const jrs_i8 *pText, ...)
+	{
+		// Only if debugging is valid
+		if(cMemoryManager::m_MemoryManagerTTYOutput)
+		{
+			jrs_i8 logtext[2048];
+			va_list args;
+
+			// Create the string
+			va_start(args, pText);
+			vsnprintf(logtext, 2047, pText, args);
+			va_end(args);  
+
+			cMemoryManager::m_MemoryManagerTTYOutput(logtext);
+		}
+	}
+
+	//  Description:
+	//		Standard Elephant debug output to file generator to pass to user TTY callback.
+	//  See Also:
+	//		
+	//  Arguments:
+	//		pFile - File name of output.
+	//		bCreate - TRUE if the file is to be recreated/cleared.  FALSE to append.
+	//		pText - Standard text string. 2k - 1 max length.
+	//		... - variable args.
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Internal debug output generation.
+	void cMemoryManager::DebugOutputFile(const jrs_i8 *pFile, jrs_bool bCreate, const jrs_i8 *pText, ...)
+	{
+		// Can we write the file?
+		if(m_MemoryManagerFileOutput || m_MemoryManagerLiveViewOutput)
+		{
+			jrs_i8 OutputText[2048];
+
+			// Write the file
+			va_list args;
+
+			// Create the string
+			va_start(args, pText);
+			vsnprintf(OutputText, 2046, pText, args);
+			va_end(args); 
+
+			strcat(OutputText, "\n");
+
+			if(m_MemoryManagerFileOutput && pFile)
+				m_MemoryManagerFileOutput(OutputText, (int)strlen(OutputText), pFile, !bCreate);
+
+			if(m_MemoryManagerLiveViewOutput)
+				m_MemoryManagerLiveViewOutput(OutputText, (int)strlen(OutputText), pFile, !bCreate);
+		}
+	}
+
+	//  Description:
+	//		Standard Elephant debug error generator.
+	//  See Also:
+	//		
+	//  Arguments:
+	//		uErrorCode - Error code.  Normally just line number.
+	//		pText - Standard text string. 2k - 1 max length.
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Internal debug output generation.
+	void cMemoryManager::DebugError(jrs_u32 uErrorCode, const jrs_i8 *pText)
+	{
+		if(cMemoryManager::m_MemoryManagerError)
+		{
+			if(m_bLiveViewRunning)
+			{
+				// Flush any pending
+				JRSThread::SleepMilliSecond(m_uLiveViewPoll * 100);
+			}
+
+			cMemoryManager::m_MemoryManagerError(pText, uErrorCode);
+		}
+	}
+
+	//  Description:
+	//		Standard Elephant debug error generator.
+	//  See Also:
+	//		
+	//  Arguments:
+	//		pHeap - Valid pHeap for heap error or NULL for manager error.
+	//		pPool - Valid pPool for pool error or NULL for manager error.
+	//		uErrorCode - Error code.  Normally just line number.
+	//		pFunction - Name of the function.
+	//		pText - Standard text string. 2k - 1 max length.
+	//		... - variable args.
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Internal debug output generation.
+	void cMemoryManager::DebugWarning(cHeap *pHeap, cPoolBase *pPool, jrs_u32 uErrorCode, const jrs_i8 *pFunction, const jrs_i8 *pText, ...)
+	{
+		// We always do this for warnings.  We will print them out.  
+		jrs_i8 logtext[2048];
+		va_list args;
+
+		sprintf(logtext, "Error 0x%x: ", uErrorCode);
+
+		// Create the string
+		va_start(args, pText);
+		vsnprintf(&logtext[strlen(logtext)], 2047, pText, args);
+		va_end(args);  
+
+		if(cMemoryManager::m_MemoryManagerTTYOutput)
+		{
+			if(pHeap && pHeap->AreErrorsEnabled())
+			{
+				cMemoryManager::m_MemoryManagerTTYOutput(logtext);
+				if(!pHeap->AreErrorsWarningsOnly())
+				{
+					if(pHeap->m_bEnableReportsInErrors)
+						pHeap->ReportStatistics(false);
+					DebugError(uErrorCode, logtext);
+				}
+			}
+			else if(pPool && pPool->AreErrorsEnabled())
+			{
+				cMemoryManager::m_MemoryManagerTTYOutput(logtext);
+				if(!pPool->AreErrorsWarningsOnly())
+				{
+					DebugError(uErrorCode, logtext);
+				}
+			}
+			else
+			{
+				cMemoryManager::m_MemoryManagerTTYOutput(logtext);
+				DebugError(uErrorCode, logtext);
+			}
+		}
+	}
+
+	//  Description:
+	//		Standard Elephant debug error generator.
+	//  See Also:
+	//		
+	//  Arguments:
+	//		pHeap - Valid pHeap for heap error or NULL for manager error.
+	//		pPool - Valid pPool for pool error or NULL for manager error.
+	//		uErrorCode - Error code.  Normally just line number.
+	//		pFunction - Name of the function.
+	//		pText - Standard text string. 2k - 1 max length.
+	//		... - variable args.
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Internal debug output generation.
+	void cMemoryManager::DebugWarning(cHeapNonIntrusive *pHeap, cPoolBase *pPool, jrs_u32 uErrorCode, const jrs_i8 *pFunction, const jrs_i8 *pText, ...)
+	{
+		// We always do this for warnings.  We will print them out.  
+		jrs_i8 logtext[2048];
+		va_list args;
+
+		sprintf(logtext, "Error 0x%x: ", uErrorCode);
+
+		// Create the string
+		va_start(args, pText);
+		vsnprintf(&logtext[strlen(logtext)], 2047, pText, args);
+		va_end(args);  
+
+		if(cMemoryManager::m_MemoryManagerTTYOutput)
+		{
+			if(pHeap && pHeap->AreErrorsEnabled())
+			{
+				cMemoryManager::m_MemoryManagerTTYOutput(logtext);
+				if(!pHeap->AreErrorsWarningsOnly())
+				{
+					if(pHeap->m_bEnableReportsInErrors)
+						pHeap->ReportStatistics(false);
+					DebugError(uErrorCode, logtext);
+				}
+			}
+			else if(pPool && pPool->AreErrorsEnabled())
+			{
+				cMemoryManager::m_MemoryManagerTTYOutput(logtext);
+				if(!pPool->AreErrorsWarningsOnly())
+				{
+					DebugError(uErrorCode, logtext);
+				}
+			}
+			else
+			{
+				cMemoryManager::m_MemoryManagerTTYOutput(logtext);
+				DebugError(uErrorCode, logtext);
+			}
+		}
+	}
+
+	//  Description:
+	//		Returns the amount of free usable memory that Elephant has to allocate managed heaps from.  This does not include 
+	//		memory taken with self managed heaps.
+	//  See Also:
+	//		Initialize
+	//  Arguments:
+	//		Nothing
+	//  Return Value:
+	//      The amount of remaining memory available to Elephant for managed heaps.
+	//  Summary:	
+	//		Returns the amount of free usable memory that Elephant has to allocate managed heaps from.
+	jrs_u64 cMemoryManager::GetFreeUsableMemory(void) const 
+	{ 
+		return (jrs_u64)((jrs_i8 *)m_pUseableMemoryEnd - (jrs_i8 *)m_pUsableHeapMemoryStart); 
+	}
+
+	//  Description:
+	//		Returns the system page size.
+	//  See Also:
+	//		Initialize
+	//  Arguments:
+	//		Nothing
+	//  Return Value:
+	//      System page size.
+	//  Summary:	
+	//		Returns the system page size.
+	jrs_sizet cMemoryManager::GetSystemPageSize(void) const
+	{
+		return m_uSystemPageSize;
+	}
+
+	//  Description:
+	//		Returns the system page size.
+	//  See Also:
+	//		Initialize
+	//  Arguments:
+	//		Nothing
+	//  Return Value:
+	//      System page size.
+	//  Summary:	
+	//		Returns the system page size.
+	jrs_u16 cMemoryManager::GetLVPortNumber(void) const
+	{
+		return m_uLVPort;
+	}
+
+	//  Description:
+	//		Used to determine if the memory manager is initialized or not.
+	//  See Also:
+	//		Initialize
+	//  Arguments:
+	//		Nothing
+	//  Return Value:
+	//      TRUE if initialized.
+	//		FALSE otherwise.
+	//  Summary:	
+	//		Determines if the memory manager is initialized or not.
+	jrs_bool cMemoryManager::IsInitialized(void) const 
+	{ 
+		return m_bInitialized; 
+	}
+
+	//  Description:
+	//		Tries to reclaim on all cHeaps.
+	//  See Also:
+	//		cHeap::Reclaim
+	//  Arguments:
+	//		Nothing
+	//  Return Value:
+	//      None
+	//  Summary:	
+	//		Tries to reclaim on all cHeaps.
+	void cMemoryManager::Reclaim(void)
+	{
+		for(jrs_u32 i = 0; i < GetMaxNumHeaps(); i++)
+		{
+			if(GetHeap(i))
+			{
+				GetHeap(i)->Reclaim();
+			}
+		}
+
+		FlushRegionCache();
+	}
+
+	//  Description:
+	//		Frees every region held by the region cache back to the system.  Called by Reclaim and Destroy.
+	//  See Also:
+	//		InitializeRegionCache, Reclaim
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Empties the region cache.
+	void cMemoryManager::FlushRegionCache(void)
+	{
+		m_RegionCacheLock.Lock();
+
+		for(jrs_u32 i = 0; i < m_uNumCachedRegions; i++)
+			m_RegionCache[i].systemFree(m_RegionCache[i].pMemory, m_RegionCache[i].uSize);
+		m_uNumCachedRegions = 0;
+		m_uCachedRegionSize = 0;
+
+		m_RegionCacheLock.Unlock();
+	}
+
+	//  Description:
+	//		Hashes an address for the sampler filter and sample table.
+	//  See Also:
+	//		RecordSample, RemoveSample
+	//  Arguments:
+	//		pMemory - Address to hash.
+	//  Return Value:
+	//      32bit hash.  The top bits index the filter.
+	//  Summary:	
+	//		Hashes an address for the sampler.
+	static jrs_u32 SamplerAddressHash(void *pMemory)
+	{
+		return (jrs_u32)(((jrs_u64)(jrs_sizet)pMemory * 0x9e3779b97f4a7c15ULL) >> 32);
+	}
+
+	//  Description:
+	//		Picks the number of bytes until the next sample.  The gaps are exponentially distributed with a mean of the sample interval so
+	//		every byte has the same chance of being sampled whatever the allocation pattern.
+	//  See Also:
+	//		SampleAllocation
+	//  Arguments:
+	//		uRandom - Xorshift state of the shard.
+	//		uInterval - Mean sample interval in bytes.
+	//  Return Value:
+	//      Bytes until the next sample.
+	//  Summary:	
+	//		Picks the next sample gap.
+	static jrs_i64 SamplerNextGap(jrs_u64 &uRandom, jrs_u64 uInterval)
+	{
+		uRandom ^= uRandom << 13;
+		uRandom ^= uRandom >> 7;
+		uRandom ^= uRandom << 17;
+
+		// Uniform in (0, 1]
+		double dUniform = (double)((uRandom >> 11) + 1) * (1.0 / 9007199254740992.0);
+		return (jrs_i64)(-log(dUniform) * (double)uInterval);
+	}
+
+	//  Description:
+	//		Allocates the sampling heap profiler from the default allocator.  Called by Initialize when InitializeSamplingProfiler has set
+	//		an interval.  Private.
+	//  See Also:
+	//		InitializeSamplingProfiler, DestroySampler
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      TRUE if the profiler exists.
+	//		FALSE if the memory could not be allocated.
+	//  Summary:	
+	//		Allocates the sampling heap profiler.
+	jrs_bool cMemoryManager::CreateSampler(void)
+	{
+		if(m_pSampler)
+			return true;
+
+		jrs_u32 uMaxSamples = m_uMaxSamples ? m_uMaxSamples : 1;
+		jrs_u32 uHashSize = 1;
+		while(uHashSize < uMaxSamples)
+			uHashSize <<= 1;
+
+		jrs_u64 uBlockSize = sizeof(sSampler) + (jrs_u64)uMaxSamples * (sizeof(sSampler::sSample) + sizeof(sSampler::sSite)) + (jrs_u64)uHashSize * 2 * sizeof(jrs_u32);
+		sSampler *pSampler = (sSampler *)m_MemoryManagerDefaultAllocator(uBlockSize, NULL);
+		if(!pSampler)
+			return false;
+
+		memset(pSampler, 0, sizeof(sSampler));
+		pSampler->uBlockSize = uBlockSize;
+		pSampler->uInterval = m_uSampleInterval;
+		pSampler->uMaxSamples = uMaxSamples;
+		pSampler->uHashMask = uHashSize - 1;
+		pSampler->pSamples = (sSampler::sSample *)(pSampler + 1);
+		pSampler->pSites = (sSampler::sSite *)(pSampler->pSamples + uMaxSamples);
+		pSampler->pSampleHash = (jrs_u32 *)(pSampler->pSites + uMaxSamples);
+		pSampler->pSiteHash = pSampler->pSampleHash + uHashSize;
+
+		for(jrs_u32 i = 0; i < uHashSize; i++)
+			pSampler->pSampleHash[i] = pSampler->pSiteHash[i] = MemoryManager_SamplerNone;
+		for(jrs_u32 i = 0; i < uMaxSamples; i++)
+			pSampler->pSamples[i].uNext = i + 1 < uMaxSamples ? i + 1 : MemoryManager_SamplerNone;
+
+		for(jrs_u32 i = 0; i < MemoryManager_SamplerShards; i++)
+		{
+			pSampler->Shards[i].uRandom = 0x2545f4914f6cdd1dULL * (i + 1) ^ (jrs_u64)(jrs_sizet)pSampler;
+			pSampler->Shards[i].iBytesUntilSample = SamplerNextGap(pSampler->Shards[i].uRandom, pSampler->uInterval);
+		}
+
+		m_pSampler = pSampler;
+
+		return true;
+	}
+
+	//  Description:
+	//		Frees the sampling heap profiler.  Called by Destroy.  Private.
+	//  See Also:
+	//		CreateSampler
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Frees the sampling heap profiler.
+	void cMemoryManager::DestroySampler(void)
+	{
+		m_SamplerLock.Lock();
+		sSampler *pSampler = m_pSampler;
+		m_pSampler = NULL;
+		m_SamplerLock.Unlock();
+
+		if(pSampler)
+			m_MemoryManagerDefaultFree(pSampler, pSampler->uBlockSize);
+	}
+
+	//  Description:
+	//		Counts an allocation towards the next sample of the calling thread and records it when the sample interval runs out.  Called by
+	//		the heaps after a successful allocation.  Private.
+	//  See Also:
+	//		RecordSample, RemoveSample
+	//  Arguments:
+	//		pMemory - The allocation.
+	//		uSize - Size requested by the user.
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Samples an allocation.
+	void cMemoryManager::SampleAllocation(void *pMemory, jrs_sizet uSize)
+	{
+		sSampler *pSampler = m_pSampler;
+		if(!pSampler || !pMemory)
+			return;
+
+		jrs_u64 uShard = ((jrs_u64)JRSThread::CurrentID() * 0x9e3779b97f4a7c15ULL) >> (64 - MemoryManager_SamplerShardBits);
+		sSampler::sShard &rShard = pSampler->Shards[uShard];
+		rShard.iBytesUntilSample -= (jrs_i64)uSize;
+		if(rShard.iBytesUntilSample >= 0)
+			return;
+
+		rShard.iBytesUntilSample = SamplerNextGap(rShard.uRandom, pSampler->uInterval);
+		RecordSample(pMemory, uSize);
+	}
+
+	//  Description:
+	//		Records a sampled allocation against the call stack that made it.  A stale sample at the same address is replaced.  The sample
+	//		is dropped if the tables are full.  Private.
+	//  See Also:
+	//		SampleAllocation
+	//  Arguments:
+	//		pMemory - The allocation.
+	//		uSize - Size requested by the user.
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Records a sampled allocation.
+	void cMemoryManager::RecordSample(void *pMemory, jrs_sizet uSize)
+	{
+		// Skip StackTraceId, RecordSample and SampleAllocation.  Captured before the lock as unwinding can be slow.
+		jrs_u32 uStackId = StackTraceId(3, MemoryManager_SampleStackDepth);
+
+		m_SamplerLock.Lock();
+
+		sSampler *pSampler = m_pSampler;
+		if(!pSampler)
+		{
+			m_SamplerLock.Unlock();
+			return;
+		}
+
+		// The address was freed by something the heaps do not see
+		RemoveSample(pMemory);
+
+		// Find or add the site.  Stacks the stack table could not hold are dropped.
+		jrs_u32 uSite = pSampler->pSiteHash[uStackId & pSampler->uHashMask];
+		while(uSite != MemoryManager_SamplerNone && pSampler->pSites[uSite].uStackId != uStackId)
+			uSite = pSampler->pSites[uSite].uNext;
+
+		if(uStackId && uSite == MemoryManager_SamplerNone && pSampler->uNumSites < pSampler->uMaxSamples)
+		{
+			uSite = pSampler->uNumSites++;
+			sSampler::sSite &rSite = pSampler->pSites[uSite];
+			rSite.uAllocCount = rSite.uAllocSize = rSite.uLiveCount = rSite.uLiveSize = 0;
+			rSite.uStackId = uStackId;
+			rSite.uNext = pSampler->pSiteHash[uStackId & pSampler->uHashMask];
+			pSampler->pSiteHash[uStackId & pSampler->uHashMask] = uSite;
+		}
+
+		jrs_u32 uSample = pSampler->uFreeSample;
+		if(!uStackId || uSite == MemoryManager_SamplerNone || uSample == MemoryManager_SamplerNone)
+		{
+			pSampler->uDropped++;
+			m_SamplerLock.Unlock();
+			return;
+		}
+
+		// Link the sample
+		jrs_u32 uAddressHash = SamplerAddressHash(pMemory);
+		sSampler::sSample &rSample = pSampler->pSamples[uSample];
+		pSampler->uFreeSample = rSample.uNext;
+		rSample.pMemory = pMemory;
+		rSample.uSize = uSize;
+		rSample.uSite = uSite;
+		rSample.uNext = pSampler->pSampleHash[uAddressHash & pSampler->uHashMask];
+		pSampler->pSampleHash[uAddressHash & pSampler->uHashMask] = uSample;
+
+		volatile jrs_u8 &rFilter = pSampler->uFilter[uAddressHash >> (32 - MemoryManager_SamplerFilterBits)];
+		if(rFilter != 0xff)
+			rFilter = rFilter + 1;
+
+		sSampler::sSite &rSite = pSampler->pSites[uSite];
+		rSite.uAllocCount++;
+		rSite.uAllocSize += uSize;
+		rSite.uLiveCount++;
+		rSite.uLiveSize += uSize;
+
+		m_SamplerLock.Unlock();
+	}
+
+	//  Description:
+	//		Removes the sample of freed memory.  Addresses the filter has never seen return without locking.  Called by the heaps before
+	//		freeing.  Private.
+	//  See Also:
+	//		RecordSample
+	//  Arguments:
+	//		pMemory - Memory being freed.
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Removes the sample of freed memory.
+	void cMemoryManager::RemoveSample(void *pMemory)
+	{
+		sSampler *pSampler = m_pSampler;
+		if(!pSampler)
+			return;
+
+		jrs_u32 uAddressHash = SamplerAddressHash(pMemory);
+		volatile jrs_u8 &rFilter = pSampler->uFilter[uAddressHash >> (32 - MemoryManager_SamplerFilterBits)];
+		if(!rFilter)
+			return;
+
+		m_SamplerLock.Lock();
+
+		jrs_u32 *pLink = &pSampler->pSampleHash[uAddressHash & pSampler->uHashMask];
+		while(*pLink != MemoryManager_SamplerNone && pSampler->pSamples[*pLink].pMemory != pMemory)
+			pLink = &pSampler->pSamples[*pLink].uNext;
+
+		jrs_u32 uSample = *pLink;
+		if(uSample != MemoryManager_SamplerNone)
+		{
+			sSampler::sSample &rSample = pSampler->pSamples[uSample];
+			*pLink = rSample.uNext;
+
+			sSampler::sSite &rSite = pSampler->pSites[rSample.uSite];
+			rSite.uLiveCount--;
+			rSite.uLiveSize -= rSample.uSize;
+
+			// A saturated count no longer knows how many samples share it
+			if(rFilter != 0xff)
+				rFilter = rFilter - 1;
+
+			rSample.pMemory = NULL;
+			rSample.uNext = pSampler->uFreeSample;
+			pSampler->uFreeSample = uSample;
+		}
+
+		m_SamplerLock.Unlock();
+	}
+
+	//  Description:
+	//		Writes the samples of the sampling heap profiler in the pprof legacy heap format.  Each call stack lists its live samples and
+	//		every sample taken there so pprof can show both in use and total allocated memory.  pprof scales the sampled figures back up
+	//		from the sample interval in the header.  The mapped libraries follow where the platform can supply them.  Uses the file output
+	//		callback set by InitializeCallbacks.
+	//  See Also:
+	//		InitializeSamplingProfiler
+	//  Arguments:
+	//		pFilePathAndName - File to write.  It is replaced.
+	//  Return Value:
+	//      TRUE if the profile was written.
+	//		FALSE if the profiler is not enabled or there is no file output callback.
+	//  Summary:	
+	//		Writes a pprof heap profile.
+	jrs_bool cMemoryManager::WriteHeapProfile(const jrs_i8 *pFilePathAndName)
+	{
+		if(!m_pSampler || !m_MemoryManagerFileOutput || !pFilePathAndName)
+			return false;
+
+		m_SamplerLock.Lock();
+
+		sSampler *pSampler = m_pSampler;
+		if(!pSampler)
+		{
+			m_SamplerLock.Unlock();
+			return false;
+		}
+
+		jrs_u64 uLiveCount = 0, uLiveSize = 0, uAllocCount = 0, uAllocSize = 0;
+		for(jrs_u32 i = 0; i < pSampler->uNumSites; i++)
+		{
+			uLiveCount += pSampler->pSites[i].uLiveCount;
+			uLiveSize += pSampler->pSites[i].uLiveSize;
+			uAllocCount += pSampler->pSites[i].uAllocCount;
+			uAllocSize += pSampler->pSites[i].uAllocSize;
+		}
+
+		// Lines are gathered into a buffer to keep the number of writes down
+		jrs_i8 OutputText[4096];
+		jrs_i8 LineText[512];
+		jrs_u32 uUsed = (jrs_u32)sprintf(OutputText, "heap profile: %llu: %llu [%llu: %llu] @ heap_v2/%llu\n", uLiveCount, uLiveSize, uAllocCount, uAllocSize, pSampler->uInterval);
+		jrs_bool bAppend = false;
+
+		for(jrs_u32 i = 0; i < pSampler->uNumSites; i++)
+		{
+			sSampler::sSite &rSite = pSampler->pSites[i];
+			const jrs_sizet *pCallStack = GetStackFromId(rSite.uStackId);
+			jrs_u32 uLine = (jrs_u32)sprintf(LineText, "%llu: %llu [%llu: %llu] @", rSite.uLiveCount, rSite.uLiveSize, rSite.uAllocCount, rSite.uAllocSize);
+			for(jrs_u32 f = 0; f < MemoryManager_SampleStackDepth && pCallStack[f]; f++)
+				uLine += (jrs_u32)sprintf(&LineText[uLine], " 0x%llx", (jrs_u64)pCallStack[f]);
+			LineText[uLine++] = '\n';
+
+			if(uUsed + uLine > sizeof(OutputText))
+			{
+				m_MemoryManagerFileOutput(OutputText, (int)uUsed, pFilePathAndName, bAppend);
+				bAppend = true;
+				uUsed = 0;
+			}
+			memcpy(&OutputText[uUsed], LineText, uLine);
+			uUsed += uLine;
+		}
+
+		m_MemoryManagerFileOutput(OutputText, (int)uUsed, pFilePathAndName, bAppend);
+		m_MemoryManagerFileOutput((void *)"\nMAPPED_LIBRARIES:\n", 19, pFilePathAndName, true);
+		MemoryManagerPlatformWriteModuleMap(m_MemoryManagerFileOutput, pFilePathAndName);
+
+		m_SamplerLock.Unlock();
+
+		return true;
+	}
+
+	//  Description:
+	//		Enables or disables continuous logging.  This is used to control output to a continuous log file and TYY using the user callback functions.
+	//		Enabling starts a new file.  Disabling finishes a compact dump by writing its chunk index.
+	//  See Also:
+	//		IsLoggingEnabled
+	//  Arguments:
+	//		bEnable - TRUE to enable logging.  FALSE to disable.
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Enables or disables continuous logging.
+	void cMemoryManager::EnableLogging(jrs_bool bEnable)
+	{
+		// The compact dump writes its index when it stops
+		if(!bEnable && m_bEnableContinuousDump && m_pCompactDump)
+		{
+			m_ContThreadLock.Lock();
+			CompactDump_Finish();
+			m_ContThreadLock.Unlock();
+		}
+
+		m_bEnableContinuousDump = bEnable;
+		ContinuousLogging_Operation(eContLog_StartLogging, NULL, NULL, 0);
+	}
+
+	//  Description:
+	//		Determines if logging is currently enabled or not.
+	//  See Also:
+	//		EnableLogging
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      TRUE if logging is currently enabled.
+	//		FALSE otherwise.
+	//  Summary:	
+	//		Determines if logging is currently enabled or not.
+	jrs_bool cMemoryManager::IsLoggingEnabled(void) const 
+	{ 
+		return m_bEnableContinuousDump; 
+	}
+
+
+	//  Description:
+	//		Creates a callstack to a string
+	//  See Also:
+	//		ReportAll
+	//  Arguments:
+	//		pOutputBuffer - Pointer to the start of the string to append to.
+	//		pCallstack - Pointer to the callstack values
+	//		uCallStackCount - Number of callstack values
+	//  Return Value:
+	//      None
+	//  Summary:	
+	//		Creates a callstack to a string
+	void cMemoryManager::StackToString(jrs_i8 *pOutputBuffer, const jrs_sizet *pCallstack, jrs_u32 uCallStackCount)
+	{
+		char outbuffer[386];
+		for(jrs_u32 i = 0; i < uCallStackCount; i++)
+		{
+			jrs_sizet uFuncStartAdd = 0;
+			jrs_sizet uFuncSize = 0;
+			outbuffer[0] = ' ';
+			outbuffer[1] = '\0';
+			MemoryManagerPlatformFunctionNameFromAddress(pCallstack[i], &outbuffer[1], &uFuncStartAdd, &uFuncSize);
+			if(uFuncSize == 0)
+			{
+#ifdef JRS64BIT
+				sprintf(outbuffer, " 0x%llu", (jrs_u64)pCallstack[i]);
+#else
+				sprintf(outbuffer, " 0x%u", (jrs_u32)pCallstack[i]);
+#endif
+			}
+			strcat(pOutputBuffer, outbuffer);
+		}
+	}
+
+	//  Description:
+	//		Captures the call stack and returns its id in the stack table.  Frames are counted from the function calling StackTraceId as
+	//		frame 0 like StackTrace.  Private.
+	//  See Also:
+	//		AddStack, GetStackFromId
+	//  Arguments:
+	//		uCallstackDepth - Number of frames to skip.
+	//		uCallStackCount - Number of frames to record.  No more than MemoryManager_StackTableDepth.
+	//  Return Value:
+	//      Id of the call stack.  0 if it could not be recorded.
+	//  Summary:	
+	//		Captures the call stack as a stack table id.
+	jrs_u32 cMemoryManager::StackTraceId(jrs_u32 uCallstackDepth, jrs_u32 uCallStackCount)
+	{
+		if(uCallStackCount > MemoryManager_StackTableDepth)
+			uCallStackCount = MemoryManager_StackTableDepth;
+
+		// One more frame for this function
+		jrs_sizet uCallStack[MemoryManager_StackTableDepth];
+		memset(uCallStack, 0, sizeof(uCallStack));
+		StackTrace(uCallStack, uCallstackDepth + 1, uCallstackDepth + 1 + uCallStackCount);
+
+		return AddStack(uCallStack, uCallStackCount);
+	}
+
+	//  Description:
+	//		Finds or adds a call stack in the stack table without locking.  Trailing zero frames are ignored.  Private.
+	//  See Also:
+	//		StackTraceId, GetStackFromId
+	//  Arguments:
+	//		pCallStack - Frames of the call stack.
+	//		uCallStackCount - Number of frames.  No more than MemoryManager_StackTableDepth.
+	//  Return Value:
+	//      Id of the call stack.  0 for an empty stack or if the table is full.
+	//  Summary:	
+	//		Adds a call stack to the stack table.
+	jrs_u32 cMemoryManager::AddStack(const jrs_sizet *pCallStack, jrs_u32 uCallStackCount)
+	{
+		while(uCallStackCount && !pCallStack[uCallStackCount - 1])
+			uCallStackCount--;
+		if(!uCallStackCount)
+			return 0;
+
+		sStackTable *pTable = m_pStackTable;
+		if(!pTable)
+		{
+			if(!CreateStackTable())
+				return 0;
+			pTable = m_pStackTable;
+		}
+
+		// 0 and 1 mark empty and claimed entries
+		jrs_u32 uHash = 2166136261U;
+		for(jrs_u32 i = 0; i < uCallStackCount; i++)
+			uHash = (uHash ^ (jrs_u32)(pCallStack[i] ^ ((jrs_u64)pCallStack[i] >> 32))) * 16777619U;
+		if(uHash <= MemoryManager_StackTableWriting)
+			uHash += 2;
+
+		jrs_u32 uIndex = uHash & pTable->uMask;
+		jrs_u32 uWaits = 0;
+		for(jrs_u32 uProbe = 0; uProbe < MemoryManager_StackTableProbes; )
+		{
+			sStackTable::sEntry &rEntry = pTable->Entries[uIndex];
+			jrs_u32 uEntryHash = rEntry.uHash;
+			if(uEntryHash == MemoryManager_StackTableEmpty)
+			{
+				if(!JRSMemoryCompareAndSwap(&rEntry.uHash, MemoryManager_StackTableEmpty, MemoryManager_StackTableWriting))
+					continue;
+
+				// Unused frames are already zero
+				rEntry.uCount = uCallStackCount;
+				memcpy(rEntry.uCallStack, pCallStack, uCallStackCount * sizeof(jrs_sizet));
+				JRSMemoryBarrier();
+				rEntry.uHash = uHash;
+				return uIndex + 1;
+			}
+
+			// Another thread is writing this entry.  It may be the same stack.  A writer that is not running is probed past so the stack
+			// may get a second entry.
+			if(uEntryHash == MemoryManager_StackTableWriting && uWaits++ < MemoryManager_StackTableWriteWaits)
+				continue;
+
+			if(uEntryHash == uHash)
+			{
+				JRSMemoryBarrier();
+				if(rEntry.uCount == uCallStackCount && !memcmp(rEntry.uCallStack, pCallStack, uCallStackCount * sizeof(jrs_sizet)))
+					return uIndex + 1;
+			}
+
+			uIndex = (uIndex + 1) & pTable->uMask;
+			uProbe++;
+			uWaits = 0;
+		}
+
+		return 0;
+	}
+
+	//  Description:
+	//		Returns the frames of a call stack in the stack table.  Frames past the end of the stack are 0.  Private.
+	//  See Also:
+	//		StackTraceId, AddStack
+	//  Arguments:
+	//		uStackId - Id from StackTraceId or AddStack.
+	//  Return Value:
+	//      MemoryManager_StackTableDepth frames.  All 0 for id 0.
+	//  Summary:	
+	//		Returns the frames of a call stack id.
+	const jrs_sizet *cMemoryManager::GetStackFromId(jrs_u32 uStackId) const
+	{
+		const sStackTable *pTable = m_pStackTable;
+		if(!pTable || !uStackId || uStackId > pTable->uMask + 1)
+			return g_NoCallStack;
+
+		return pTable->Entries[uStackId - 1].uCallStack;
+	}
+
+	//  Description:
+	//		Allocates the stack table from the default allocator.  Called by the first stack added.  Private.
+	//  See Also:
+	//		InitializeStackTable, DestroyStackTable
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      TRUE if the table exists.
+	//		FALSE if the memory could not be allocated.
+	//  Summary:	
+	//		Allocates the stack table.
+	jrs_bool cMemoryManager::CreateStackTable(void)
+	{
+		m_MMThreadLock.Lock();
+
+		if(!m_pStackTable)
+		{
+			jrs_u32 uSize = 1;
+			while(uSize < m_uMaxStacks)
+				uSize <<= 1;
+
+			jrs_u64 uBlockSize = sizeof(sStackTable) + (jrs_u64)(uSize - 1) * sizeof(sStackTable::sEntry);
+			sStackTable *pTable = (sStackTable *)m_MemoryManagerDefaultAllocator(uBlockSize, NULL);
+			if(pTable)
+			{
+				if(!(GetSystemZeroFlags(m_MemoryManagerDefaultAllocator, NULL) & JRSMEMORYZEROFLAG_ALLOCATOR))
+					memset(pTable, 0, uBlockSize);
+				pTable->uBlockSize = uBlockSize;
+				pTable->uMask = uSize - 1;
+
+				JRSMemoryBarrier();
+				m_pStackTable = pTable;
+			}
+		}
+
+		m_MMThreadLock.Unlock();
+
+		return m_pStackTable != NULL;
+	}
+
+	//  Description:
+	//		Frees the stack table.  Called by Destroy once no headers refer to it.  Private.
+	//  See Also:
+	//		CreateStackTable
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Frees the stack table.
+	void cMemoryManager::DestroyStackTable(void)
+	{
+		sStackTable *pTable = m_pStackTable;
+		m_pStackTable = NULL;
+
+		if(pTable)
+			m_MemoryManagerDefaultFree(pTable, pTable->uBlockSize);
+	}
+
+	//  Description:
+	//		Internal only.  Copies a heap header into the layout sent to the viewer.  The stack id is replaced by the JRSMEMORY_CALLSTACKDEPTH
+	//		frames it refers to so the viewer does not need the stack table.
+	//  See Also:
+	//		ContinuousLogging_HeapOperation
+	//  Arguments:
+	//		pWire - Buffer of at least sizeof(sFreeBlock) + MemoryManager_WireStackGrowth bytes.
+	//		pHeader - sAllocatedBlock or sFreeBlock to copy.
+	//		bFreeBlock - TRUE if pHeader is a sFreeBlock.
+	//  Return Value:
+	//      Number of bytes written to pWire.
+	//  Summary:	
+	//		Expands the stack id of a header for the viewer.
+	jrs_u32 cMemoryManager::ContinuousLog_ExpandStackId(jrs_u8 *pWire, const void *pHeader, jrs_bool bFreeBlock) const
+	{
+		const jrs_u8 *pSrc = (const jrs_u8 *)pHeader;
+		const jrs_u32 uHeaderSize = bFreeBlock ? sizeof(sFreeBlock) : sizeof(sAllocatedBlock);
+#if !defined(MEMORYMANAGER_MINIMAL) && defined(MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS)
+		const jrs_u32 uStackIdOffset = bFreeBlock ? offsetof(sFreeBlock, uStackId) : offsetof(sAllocatedBlock, uStackId);
+		jrs_u32 uStackId;
+		memcpy(&uStackId, &pSrc[uStackIdOffset], sizeof(jrs_u32));
+
+		// Frames replace the id and its padding
+		const jrs_u32 uIdSize = 4 * sizeof(jrs_u32);
+		const jrs_u32 uFramesSize = JRSMEMORY_CALLSTACKDEPTH * sizeof(jrs_sizet);
+		memcpy(pWire, pSrc, uStackIdOffset);
+		memcpy(&pWire[uStackIdOffset], GetStackFromId(uStackId), uFramesSize);
+		memcpy(&pWire[uStackIdOffset + uFramesSize], &pSrc[uStackIdOffset + uIdSize], uHeaderSize - (uStackIdOffset + uIdSize));
+		return uHeaderSize + MemoryManager_WireStackGrowth;
+#else
+		memcpy(pWire, pSrc, uHeaderSize);
+		return uHeaderSize;
+#endif
+	}
+
+	//  Description:
+	//		Internal only.  Inserts the continuous data into the ring buffer.
+	//  See Also:
+	//		ContinuousLogging_PoolOperation
+	//  Arguments:
+	//		rOp - Operation details to add to the list.
+	//		pData - Data operation to add to the list.
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Reports any operations that occur on a specific heap.  These cover Allocations, Frees and Reallocs.  Reallocs may not always show.
+	void cMemoryManager::ContinuousLog_AddToBuffer(sLVOperation &rOp, void *pData)
+	{
+#ifndef MEMORYMANAGER_MINIMAL
+		// Only if active
+		if(!m_bELVContinuousGrab)
+			return;
+
+		// Prevent multiple locks taking place while adding data.
+		while(m_bLiveViewRunning && m_bELVContinuousGrab)
+		{
+			m_LVThreadLock.Lock();
+
+			jrs_u32 uCurRead = m_uELVDBRead;
+			jrs_u32 uCurWrite = m_uELVDBWrite;
+			jrs_u32 uCurWriteEnd = m_uELVDBWriteEnd;
+
+			jrs_u32 uReadMsb = uCurRead & 1;
+			jrs_u32 uWriteMsb = uCurWrite & 1;
+
+			uCurRead &= ~1;
+			uCurWrite &= ~1;
+
+			jrs_u32 uSizeToAdd = sizeof(sLVOperation) + rOp.sizeofopdata;
+			jrs_u32 uNewWriteEnd = uCurWrite + uSizeToAdd;
+
+			if(uReadMsb == uWriteMsb)
+			{
+				// Read is ALWAYS behind write.
+
+				// Same ring
+				if(uNewWriteEnd > m_uELVDebugBufferSize)
+				{
+					// If the wrap ptr is valid we cant do anything yet
+					if(!uCurWriteEnd)
+					{
+						// Loop around
+						m_uELVDBWriteEnd = uCurWrite;
+						m_uELVDBWrite = 0 | (uWriteMsb ^ 1);
+					}					
+				}
+				else
+				{
+					// We can add
+					memcpy((void *)(m_pELVDebugBuffer + uCurWrite), &rOp, sizeof(sLVOperation));
+					if(pData)
+						memcpy((void *)(m_pELVDebugBuffer + uCurWrite + sizeof(rOp)), pData, rOp.sizeofopdata);	
+
+					m_uELVDBWrite = uNewWriteEnd | (uWriteMsb);
+					m_LVThreadLock.Unlock();
+
+					// Wake the live view thread before the ring fills rather than waiting for its next poll.
+					if(uNewWriteEnd - uCurRead > (m_uELVDebugBufferSize >> 1))
+						MemoryManagerLiveViewWake();
+					return;				
+				}
+			}	
+			else
+			{
+				// Read is AHEAD of write
+				if(uNewWriteEnd > uCurRead)
+				{
+					// Wait
+				}
+				else
+				{
+					// We can add
+					memcpy((void *)(m_pELVDebugBuffer + uCurWrite), &rOp, sizeof(sLVOperation));
+					if(pData)
+						memcpy((void *)(m_pELVDebugBuffer + uCurWrite + sizeof(rOp)), pData, rOp.sizeofopdata);	
+
+					m_uELVDBWrite = uNewWriteEnd | (uWriteMsb);
+					m_LVThreadLock.Unlock();
+
+					if(uCurWriteEnd - uCurRead + uNewWriteEnd > (m_uELVDebugBufferSize >> 1))
+						MemoryManagerLiveViewWake();
+					return;				
+				}
+			}
+
+			// Full.  Make sure the live view thread knows before waiting for it.
+			m_LVThreadLock.Unlock();
+			MemoryManagerLiveViewWake();
+		}
+#endif
+	}
+
+	//  Description:
+	//		Internal only.  This function add data to the internal ring buffer of operations to be transmitted.  This specific function deals with 
+	//		the heap operations.
+	//  See Also:
+	//		ContinuousLogging_Operation, ContinuousLogging_PoolOperation
+	//  Arguments:
+	//		eType - Type of Logging operation.
+	//		pHeap - Heap pointer.
+	//		pHeaderAdd - Header address of the operation.
+	//		uAlignment - Alignment of the operation.
+	//		uMisc - Misc information.
+	//		pMemory - Address being freed.  The header is the free block it joined.  NULL uses the address after the header.
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Reports any operations that occur on a specific heap.  These cover Allocations, Frees and Reallocs.  Reallocs may not always show.
+	void cMemoryManager::ContinuousLogging_HeapOperation(eContLog eType, cHeap *pHeap, void *pHeaderAdd, jrs_u32 uAlignment, jrs_u64 uMisc, void *pMemory)
+	{
+#ifndef MEMORYMANAGER_MINIMAL
+		// Only if active
+		if(!ContinuousLog_CanLog(pHeap))
+			return;
+
+		// Lock the thread writes
+		m_ContThreadLock.Lock();
+
+		jrs_u8 flags = 0;
+#ifdef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
+		flags |= 1 << 7;
+#endif
+
+#ifdef MEMORYMANAGER_ENABLESENTINELCHECKS
+		flags |= 1 << 6;
+#endif
+
+		jrs_bool bFileAppend = TRUE;
+		jrs_i8 ContinuousOutputText[2048];
+
+		jrs_u64 heapSize = (jrs_u64)pHeap->GetSize();
+		jrs_u64 heapMemSize = (jrs_u64)pHeap->GetMemoryUsed();
+		jrs_u64 heapMemCount = (jrs_u64)pHeap->GetNumberOfAllocations();
+		jrs_u64 heapDetails = (((MemoryManager_StringLength << 9) | (0 << 8) | JRSMEMORY_CALLSTACKDEPTH) << 16);	// Always freeblock as thats the largest.
+		jrs_u8 WireHeader[sizeof(sFreeBlock) + MemoryManager_WireStackGrowth];
+
+		sLVOperation op;
+		if(eType == eContLog_Allocate)
+		{
+			op.type = (jrs_u8)eContLog_Allocate | flags;
+			op.address = (jrs_u64)pHeaderAdd;
+			op.sizeofopdata = (jrs_u8)ContinuousLog_ExpandStackId(WireHeader, pHeaderAdd, FALSE);
+			op.alignment = uAlignment;
+			op.idofheappool = (jrs_u16)pHeap->GetUniqueId();
+			op.extraInfo0 = heapMemCount;
+			op.extraInfo1 = heapMemSize;
+			op.extraInfo2 = heapSize;
+			op.extraInfo3 = heapDetails | (cMemoryManager::Get().SizeofAllocatedBlock() + MemoryManager_WireStackGrowth);
+
+			// Log it out if needed
+			if(m_bEnableContinuousDump && m_pCompactDump)
+			{
+				sAllocatedBlock *pBlock = (sAllocatedBlock *)pHeaderAdd;
+#ifdef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
+				CompactDump_Record(eType, pHeap->GetUniqueId(), (jrs_u64)(((jrs_i8 *)pHeaderAdd) + sizeof(sAllocatedBlock)), pBlock->uSize, uAlignment, pBlock->uStackId, pBlock->Name);
+#else
+				CompactDump_Record(eType, pHeap->GetUniqueId(), (jrs_u64)(((jrs_i8 *)pHeaderAdd) + sizeof(sAllocatedBlock)), pBlock->uSize, uAlignment, 0, NULL);
+#endif
+			}
+			else if(m_bEnableContinuousDump)
+			{
+				sAllocatedBlock *pBlock = (sAllocatedBlock *)pHeaderAdd;
+				sprintf(ContinuousOutputText, "Heap Alloc; %s; 0x%llx; 0x%llx; 0x%x; 0x%x; 0x%x; 0x%llx; 0x%llx; 0x%llx; 0x%llx"
+					, pHeap->GetName()
+					, (jrs_u64)(((jrs_i8 *)pHeaderAdd) + sizeof(sAllocatedBlock))
+					, (jrs_u64)pBlock->uSize
+					, uAlignment
+					, (jrs_u32)(pBlock->uFlagAndUniqueAllocNumber & 0xf), (jrs_u32)(pBlock->uFlagAndUniqueAllocNumber >> 4)
+					, heapMemCount
+					, heapMemSize
+					, heapSize
+					, heapDetails);
+
+#ifndef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
+				strcat(ContinuousOutputText, "Unknown");					
+#else
+				strcat(ContinuousOutputText, pBlock->Name);
+#endif
+				for(jrs_u32 cs = 0; cs < JRSMEMORY_CALLSTACKDEPTH; cs++)
+				{
+#ifdef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
+					jrs_i8 temp[32];
+					sprintf(temp, "; 0x%llx", (jrs_u64)MemoryManagerPlatformAddressToBaseAddress(GetStackFromId(pBlock->uStackId)[cs]));
+					strcat(ContinuousOutputText, temp);
+#else
+					strcat(ContinuousOutputText, "; 0x0");
+#endif
+				}
+				strcat(ContinuousOutputText, "\n");
+			}
+		}
+		else if(eType == eContLog_Free)
+		{
+			op.type = (jrs_u8)eContLog_Free | flags;
+			op.address = (jrs_u64)pHeaderAdd;
+			op.sizeofopdata = (jrs_u8)ContinuousLog_ExpandStackId(WireHeader, pHeaderAdd, TRUE);
+			op.alignment = (jrs_u32)uMisc;
+			op.idofheappool = (jrs_u16)pHeap->GetUniqueId();
+			op.extraInfo0 = heapMemCount;
+			op.extraInfo1 = heapMemSize;
+			op.extraInfo2 = heapSize;
+			op.extraInfo3 = heapDetails | (cMemoryManager::Get().SizeofAllocatedBlock() + MemoryManager_WireStackGrowth);
+
+			if(m_bEnableContinuousDump && m_pCompactDump)
+			{
+				CompactDump_Record(eType, pHeap->GetUniqueId(), pMemory ? (jrs_u64)pMemory : (jrs_u64)(((jrs_i8 *)pHeaderAdd) + sizeof(sAllocatedBlock)), uMisc, 0, 0, NULL);
+			}
+			else if(m_bEnableContinuousDump)
+			{
+				sFreeBlock *pBlock = (sFreeBlock *)pHeaderAdd;
+				sprintf(ContinuousOutputText, "Heap Free; %s; 0x%llx; 0x%llx; 0x%x; 0x%x; 0x%llx; 0x%llx; 0x%llx; 0x%llx; 0x%llx"
+					, pHeap->GetName()
+					, (jrs_u64)(((jrs_i8 *)pHeaderAdd) + sizeof(sAllocatedBlock))
+					, (jrs_u64)pBlock->uSize
+					, uAlignment
+					, 0, (jrs_u64)pBlock->uFlags		// flag/id
+					, heapMemCount
+					, heapMemSize
+					, heapSize
+					, heapDetails);
+
+
+#ifndef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
+				strcat(ContinuousOutputText, "Unknown");					
+#else
+				strcat(ContinuousOutputText, pBlock->Name);
+#endif
+				for(jrs_u32 cs = 0; cs < JRSMEMORY_CALLSTACKDEPTH; cs++)
+				{
+#ifdef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
+					jrs_i8 temp[32];
+					sprintf(temp, "; 0x%llx", (jrs_u64)MemoryManagerPlatformAddressToBaseAddress(GetStackFromId(pBlock->uStackId)[cs]));
+					strcat(ContinuousOutputText, temp);
+#else
+					strcat(ContinuousOutputText, "; 0x0");
+#endif
+				}
+				strcat(ContinuousOutputText, "\n");
+			}
+		}
+		else if(eType == eContLog_ReAlloc)
+		{
+			op.type = (jrs_u8)eContLog_ReAlloc | flags;
+			op.address = (jrs_sizet)pHeaderAdd;
+			op.sizeofopdata = (jrs_u8)ContinuousLog_ExpandStackId(WireHeader, pHeaderAdd, TRUE);
+			op.alignment = uAlignment;
+			op.idofheappool = pHeap->GetUniqueId();
+			op.extraInfo0 = op.extraInfo1 = op.extraInfo2 = op.extraInfo3 = 0;
+		}
+		else 
+		{
+			MemoryWarning(0, JRSMEMORYERROR_UNKNOWNWARNING, "Wrong type for ContinuousLogging_HeapOperation.");
+		}
+
+		// Write CSV file if need be
+		if(m_bEnableContinuousDump && m_MemoryManagerFileOutput && !m_pCompactDump)
+			m_MemoryManagerFileOutput(ContinuousOutputText, (int)strlen(ContinuousOutputText), m_ContinuousDumpFile, bFileAppend);
+				
+		// Add the data
+		ContinuousLog_AddToBuffer(op, WireHeader);
+
+		// Unlock the continuous writes
+		m_ContThreadLock.Unlock();
+#endif
+	}
+
+	//  Description:
+	//		Internal only.  This function add data to the internal ring buffer of operations to be transmitted.  This specific function deals with 
+	//		the heap operations.
+	//  See Also:
+	//		ContinuousLogging_Operation
+	//  Arguments:
+	//		eType - Type of Logging operation.
+	//		pHeap - Heap pointer.
+	//		pHeaderAdd - Header address of the operation.
+	//		uAlignment - Alignment of the operation.
+	//		uMisc - Misc information.
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Reports any operations that occur on a specific non intrusive heap.  These cover Allocations, Frees and Reallocs.  Reallocs may not always show.
+	void cMemoryManager::ContinuousLogging_HeapNIOperation(eContLog eType, cHeapNonIntrusive *pHeap, void *pHeaderAdd, jrs_u32 uAlignment, jrs_u64 uSize, jrs_u64 uMisc)
+	{
+#ifndef MEMORYMANAGER_MINIMAL
+		// Only if active
+		if(!ContinuousLog_CanLog(pHeap))
+			return;
+
+		// Lock the thread writes
+		m_ContThreadLock.Lock();
+
+		jrs_u8 flags = 0;
+		flags |= 1 << 5;						// Size not included in 
+		if(pHeap->IsMemoryTrackingEnabled())
+			flags |= 1 << 7;
+
+		// Not available for NI heaps
+// #ifdef MEMORYMANAGER_ENABLESENTINELCHECKS
+// 		flags |= 1 << 6;
+// #endif
+
+		jrs_u64 heapSize = pHeap->GetSize();
+		jrs_u64 heapMemSize = pHeap->GetMemoryUsed();
+		jrs_u64 heapMemCount = pHeap->GetNumberOfAllocations();
+
+		jrs_bool bFileAppend = TRUE;
+		jrs_i8 ContinuousOutputText[2048];
+
+		// Find the page by getting the base alignment
+		jrs_i8 *pPageAdd = (jrs_i8 *)((jrs_sizet)pHeaderAdd & ~(pHeap->GetPageSize() - 1));
+		cHeapNonIntrusive::sSlab *pSlab = pHeap->FindSlabFromMemory(pPageAdd);
+		jrs_sizet pageIndex = ((jrs_sizet)pPageAdd - (jrs_sizet)pSlab->pBase) / pHeap->GetPageSize();
+		cHeapNonIntrusive::sPageBlock *pBlock = &pSlab->pBlocks[pageIndex];
+
+		jrs_u64 blockSize = pBlock->numFreePages * pHeap->GetPageSize();
+		if(pBlock->pageFlags & JRSMEMORYMANAGER_PAGESUBALLOC)
+		{
+			//offsetDebug = offset / pBlock->sizeOfSubAllocs;
+			blockSize = pBlock->sizeOfSubAllocs;
+		}
+		
+		const jrs_i8 *pText = "Unknown";
+		const jrs_sizet *puCallStack = GetStackFromId(0);
+		jrs_u8 transferSize = 0;
+#ifndef MEMORYMANAGER_MINIMAL
+		if(pBlock->pDebugInfo)
+		{
+			// The stack id is sent as the frames it refers to
+			pText = (jrs_i8 *)pBlock->pDebugInfo;
+			puCallStack = GetStackFromId(*(jrs_u32 *)(pText + MemoryManager_StringLength));
+			transferSize = (jrs_u8)(MemoryManager_StringLength + (pHeap->m_uNumCallStacks * sizeof(jrs_sizet)) + sizeof(jrs_u64) + sizeof(jrs_u64));
+			MemoryWarning(transferSize < 255, JRSMEMORYERROR_UNKNOWNWARNING, "Transfer size is to big. Must be maximum of 256 bytes (32char string + size + flags + callstack depth of 52 (26 in 64bit)");
+		}
+		else
+		{
+			// The size and space for details later
+			transferSize = sizeof(jrs_u64) + sizeof(jrs_u64);
+		}
+#endif
+		// The 1 << 8 elmininates it from calculations in goldfish
+		jrs_u64 heapDetails = (((MemoryManager_StringLength << 9) | (1 << 8) | pHeap->m_uNumCallStacks) << 16) | transferSize;
+
+		sLVOperation op;
+		if(eType == eContLog_Allocate)
+		{
+			op.type = (jrs_u8)eContLog_Allocate | flags;
+			op.address = (jrs_sizet)pHeaderAdd;
+			op.sizeofopdata = transferSize;
+			op.alignment = uAlignment;
+			op.idofheappool = pHeap->GetUniqueId();
+			op.extraInfo0 = heapMemCount;
+			op.extraInfo1 = heapMemSize;
+			op.extraInfo2 = heapSize;
+			op.extraInfo3 = heapDetails;
+
+			// Log it out if needed
+			if(m_bEnableContinuousDump && m_pCompactDump)
+			{
+				CompactDump_Record(eType, pHeap->GetUniqueId(), (jrs_u64)pHeaderAdd, uSize, uAlignment, pBlock->pDebugInfo ? *(jrs_u32 *)(pText + MemoryManager_StringLength) : 0, pBlock->pDebugInfo ? pText : NULL);
+			}
+			else if(m_bEnableContinuousDump)
+			{
+				sprintf(ContinuousOutputText, "Heap Alloc; %s; 0x%llx; 0x%llx; 0x%x; 0x%x; 0x%x; 0x%llx; 0x%llx; 0x%llx; 0x%llx"
+					, pHeap->GetName()
+					, (jrs_u64)(((jrs_i8 *)pHeaderAdd) + sizeof(sAllocatedBlock))
+					, blockSize
+					, uAlignment
+					, 0, 0
+					, heapMemCount
+					, heapMemSize
+					, heapSize
+					, heapDetails);
+				
+				strcat(ContinuousOutputText, pText);	
+
+				for(jrs_u32 cs = 0; cs < pHeap->m_uNumCallStacks; cs++)
+				{
+					jrs_i8 temp[32];
+					sprintf(temp, "; 0x%llx", (jrs_u64)MemoryManagerPlatformAddressToBaseAddress(puCallStack[cs]));
+					strcat(ContinuousOutputText, temp);
+				}
+				strcat(ContinuousOutputText, "\n");
+			}
+		}
+		else if(eType == eContLog_Free)
+		{
+			op.type = (jrs_u8)eContLog_Free | flags;
+			op.address = (jrs_sizet)pHeaderAdd;
+			op.sizeofopdata = transferSize;
+			op.alignment = (jrs_u32)uMisc;
+			op.idofheappool = pHeap->GetUniqueId();
+			op.extraInfo0 = heapMemCount;
+			op.extraInfo1 = heapMemSize;
+			op.extraInfo2 = heapSize;
+			op.extraInfo3 = heapDetails;
+
+			if(m_bEnableContinuousDump && m_pCompactDump)
+			{
+				CompactDump_Record(eType, pHeap->GetUniqueId(), (jrs_u64)pHeaderAdd, uSize, 0, 0, NULL);
+			}
+			else if(m_bEnableContinuousDump)
+			{
+				sprintf(ContinuousOutputText, "Heap Free; %s; 0x%llx; 0x%llx; 0x%x; 0x%x; 0x%llx; 0x%llx; 0x%llx; 0x%llx; 0x%llx"
+					, pHeap->GetName()
+					, (jrs_u64)(((jrs_i8 *)pHeaderAdd) + sizeof(sAllocatedBlock))
+					, blockSize
+					, uAlignment
+					, 0, (jrs_u64)0
+					, heapMemCount
+					, heapMemSize
+					, heapSize
+					, heapDetails);
+
+				strcat(ContinuousOutputText, pText);			
+				for(jrs_u32 cs = 0; cs < pHeap->m_uNumCallStacks; cs++)
+				{
+					jrs_i8 temp[32];
+					sprintf(temp, "; 0x%llx", (jrs_u64)MemoryManagerPlatformAddressToBaseAddress(puCallStack[cs]));
+					strcat(ContinuousOutputText, temp);
+				}
+				strcat(ContinuousOutputText, "\n");
+			}
+		}
+		else if(eType == eContLog_ReAlloc)
+		{
+			op.type = (jrs_u8)eContLog_ReAlloc | flags;
+			op.address = (jrs_sizet)pHeaderAdd;
+			op.sizeofopdata = transferSize;
+			op.alignment = uAlignment;
+			op.idofheappool = pHeap->GetUniqueId();
+			op.extraInfo0 = op.extraInfo1 = op.extraInfo2 = op.extraInfo3 = 0;
+		}
+		else 
+		{
+			MemoryWarning(0, JRSMEMORYERROR_UNKNOWNWARNING, "Wrong type for ContinuousLogging_HeapOperation.");
+		}
+
+		// Write CSV file if need be
+		if(m_bEnableContinuousDump && m_MemoryManagerFileOutput && !m_pCompactDump)
+			m_MemoryManagerFileOutput(ContinuousOutputText, (int)strlen(ContinuousOutputText), m_ContinuousDumpFile, bFileAppend);
+
+		// Add the data - We cant do this yet
+		jrs_u8 dataToTransfer[256];
+		if(pBlock->pDebugInfo)
+		{
+			jrs_u64 zeros = 0;
+			memcpy(&dataToTransfer[0], &blockSize, sizeof(jrs_u64));
+			memcpy(&dataToTransfer[8], &zeros, sizeof(jrs_u64));
+			memcpy(&dataToTransfer[16], pText, MemoryManager_StringLength);
+			memcpy(&dataToTransfer[16 + MemoryManager_StringLength], puCallStack, pHeap->m_uNumCallStacks * sizeof(jrs_sizet));
+			ContinuousLog_AddToBuffer(op, dataToTransfer);
+		}
+		else if(transferSize)
+		{
+			jrs_u64 zeros = 0;
+			memcpy(&dataToTransfer[0], &blockSize, sizeof(jrs_u64));
+			memcpy(&dataToTransfer[8], &zeros, sizeof(jrs_u64));
+			ContinuousLog_AddToBuffer(op, dataToTransfer);
+		}
+
+		// Unlock the continuous writes
+		m_ContThreadLock.Unlock();
+#endif
+	}
+
+	//  Description:
+	//		Internal only.  This function add data to the internal ring buffer of operations to be transmitted.  This specific function deals with 
+	//		the heap operations.
+	//  See Also:
+	//		ContinuousLogging_Operation
+	//  Arguments:
+	//		eType - Type of Logging operation.
+	//		pHeap - Heap pointer.
+	//		pHeaderAdd - Header address of the operation.
+	//		uAlignment - Alignment of the operation.
+	//		uMisc - Misc information.
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Reports any operations that occur on a specific heap.  These cover Allocations, Frees and Reallocs.  Reallocs may not always show.
+	void cMemoryManager::ContinuousLogging_PoolOperation(eContLog eType, cPoolBase *pPool, void *pAddress, jrs_u64 uMisc)
+	{
+#ifndef MEMORYMANAGER_MINIMAL
+		// Only if active
+		if(!ContinuousLog_CanLog(pPool->GetHeap()))
+			return;
+
+		// Lock the thread writes
+		m_ContThreadLock.Lock();
+
+		jrs_bool bFileAppend = TRUE;
+		jrs_i8 ContinuousOutputText[512];
+
+		jrs_u8 flags = 0;
+		flags |= pPool->HasNameAndCallstackTracing() ? 1 << 7 : 0;
+		flags |= pPool->HasSentinels() ? 1 << 6 : 0;
+
+		sLVOperation op;
+		if(eType == eContLog_AllocatePool)
+		{
+			op.type = (jrs_u8)eContLog_AllocatePool | flags;
+			op.address = (jrs_sizet)pAddress;
+			op.sizeofopdata = 0;
+			op.alignment = pPool->GetAllocationSize();
+			op.idofheappool = (jrs_u16)pPool->GetUniqueId();
+			op.extraInfo0 = op.extraInfo1 = op.extraInfo2 = op.extraInfo3 = 0;
+
+			if(m_bEnableContinuousDump && m_pCompactDump)
+			{
+				CompactDump_Record(eType, pPool->GetUniqueId(), op.address, pPool->GetAllocationSize(), 0, 0, NULL);
+			}
+			else if(m_bEnableContinuousDump)
+			{
+				sprintf(ContinuousOutputText, "Pool Alloc; %s; %s; 0x%llx; 0x%x; 0x%x; %s; 0x%llx; 0x%llx; 0x%llx; 0x%llx; 0x%llx; 0x%llx; 0x%llx; 0x%llx\n",
+					pPool->GetName(),
+					pPool->GetHeap()->GetName(),
+					op.address,
+					pPool->GetAllocationSize(),
+					16,
+					"Name",
+					(jrs_u64)0,
+					(jrs_u64)1,
+					(jrs_u64)2,
+					(jrs_u64)3,
+					(jrs_u64)4,
+					(jrs_u64)5,
+					(jrs_u64)6,
+					(jrs_u64)7
+					);
+			}
+		}
+		else if(eType == eContLog_FreePool)
+		{
+			op.type = (jrs_u8)eContLog_FreePool | flags;
+			op.address = (jrs_sizet)pAddress;
+			op.sizeofopdata = 0;
+			op.alignment = pPool->GetAllocationSize();
+			op.idofheappool = (jrs_u16)pPool->GetUniqueId();
+			op.extraInfo0 = op.extraInfo1 = op.extraInfo2 = op.extraInfo3 = 0;
+
+			if(m_bEnableContinuousDump && m_pCompactDump)
+			{
+				CompactDump_Record(eType, pPool->GetUniqueId(), op.address, pPool->GetAllocationSize(), 0, 0, NULL);
+			}
+			else if(m_bEnableContinuousDump)
+			{
+				sprintf(ContinuousOutputText, "Pool Free; %s; %s; 0x%llx; 0x%x; 0x%x; %s; 0x%llx; 0x%llx; 0x%llx; 0x%llx; 0x%llx; 0x%llx; 0x%llx; 0x%llx\n",
+					pPool->GetName(),
+					pPool->GetHeap()->GetName(),
+					op.address,
+					pPool->GetAllocationSize(),
+					16,
+					"Name",
+					(jrs_u64)0,
+					(jrs_u64)1,
+					(jrs_u64)2,
+					(jrs_u64)3,
+					(jrs_u64)4,
+					(jrs_u64)5,
+					(jrs_u64)6,
+					(jrs_u64)7
+					);
+			}
+		}
+		else 
+		{
+			MemoryWarning(0, JRSMEMORYERROR_UNKNOWNWARNING, "Wrong type for ContinuousLogging_PoolOperation.");
+		}
+
+		// Add the data
+		ContinuousLog_AddToBuffer(op, pAddress);
+
+		// Add the data
+		// Write CSV file if need be
+		if(m_bEnableContinuousDump && m_MemoryManagerFileOutput && !m_pCompactDump)
+			m_MemoryManagerFileOutput(ContinuousOutputText, (int)strlen(ContinuousOutputText), m_ContinuousDumpFile, bFileAppend);
+
+		// Unlock the continuous writes
+		m_ContThreadLock.Unlock();
+#endif
+	}
+
+	//  Description:
+	//		Internal only.  Reports if the heap can log or not.
+	//  See Also:
+	//		
+	//  Arguments:
+	//		pHeap - Heap to check.
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Checks if the heap can log or not
+	jrs_bool cMemoryManager::ContinuousLog_CanLog(cHeap *pHeap)
+	{
 #ifndef MEMORYMANAGER_MINIMAL
 		// Only if active
-		if(!ContinuousLog_CanLog(pHeap))
+		if(!pHeap->IsLoggingEnabled())
+			return FALSE;
+
+		// Only if continuous data grabbing is enabled or we want continuous output
+		if(!m_bELVContinuousGrab && !m_bEnableContinuousDump)
+			return FALSE;
+
+		// Not the dump writing itself out
+		if(ContinuousLog_IsDumpWriter())
+			return FALSE;
+#endif
+		return TRUE;
+	}
+
+	//  Description:
+	//		Internal only.  Reports if the NI heap can log or not.
+	//  See Also:
+	//		
+	//  Arguments:
+	//		pHeap - Heap to check.
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Checks if the NI heap can log or not
+	jrs_bool cMemoryManager::ContinuousLog_CanLog(cHeapNonIntrusive *pHeap)
+	{
+#ifndef MEMORYMANAGER_MINIMAL
+		// Only if active
+		if(!pHeap->IsLoggingEnabled())
+			return FALSE;
+
+		// Only if continuous data grabbing is enabled or we want continuous output
+		if(!m_bELVContinuousGrab && !m_bEnableContinuousDump)
+			return FALSE;
+
+		// Not the dump writing itself out
+		if(ContinuousLog_IsDumpWriter())
+			return FALSE;
+#endif
+		return TRUE;
+	}
+
+	//  Description:
+	//		Internal only.  This function add data to the internal ring buffer of operations to be transmitted.  This specific function deals with 
+	//		the heap operations.
+	//  See Also:
+	//		
+	//  Arguments:
+	//		eType - Type of Logging operation.
+	//		pHeap - Heap pointer.
+	//		pPool - Pool pointer base.
+	//		uMisc - Misc information.
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Reports any operations that occur on a specific heap.  These cover Allocations, Frees and Reallocs.  Reallocs may not always show.
+	void cMemoryManager::ContinuousLogging_Operation(eContLog eType, cHeap *pHeap, cPoolBase *pPool, jrs_u64 uMisc)
+	{
+#ifndef MEMORYMANAGER_MINIMAL
+		// Only if active - we ignore the heap here and only care about if we should be logging or not
+		if(!m_bELVContinuousGrab && !m_bEnableContinuousDump)
+			return;
+
+		if(ContinuousLog_IsDumpWriter())
 			return;
 
 		// Lock the thread writes
 		m_ContThreadLock.Lock();
 
-		jrs_u8 flags = 0;
+		jrs_bool bFileAppend = TRUE;
+		jrs_i8 ContinuousOutputText[512];
+
+		sLVOperation op;
+		op.type = (jrs_u8)eType;
+		op.address = 0;
+		op.sizeofopdata = 32;
+		op.alignment = 0;
+		op.extraInfo0 = op.extraInfo1 = op.extraInfo2 = op.extraInfo3 = 0;
+		if(eType == eContLog_CreateHeap || eType == eContLog_DestroyHeap || eType == eContLog_ResizeHeap)
+		{	
+			struct LVOpHeapInformation
+			{
+				jrs_u64 uSize;				// 0
+				jrs_u32 uDefaultAlignment;  // 8
+				jrs_u32 uMinAllocSize;		// 12
+				jrs_u32 uMaxAllocSize;		// 16
+				jrs_u32 uPad1;				// 20
+				jrs_u32 uPad2;				// 24
+				jrs_u32 uFlags;				// 28
+			};
+
+			op.idofheappool = pHeap->GetUniqueId();
+			op.address = (jrs_u64)(pHeap->GetAddress());
+
+			LVOpHeapInformation info;
+			info.uSize = pHeap->GetSize();
+			info.uDefaultAlignment = pHeap->GetDefaultAlignment();
+			info.uMinAllocSize = (jrs_u32)pHeap->GetMinAllocationSize();
+			info.uMaxAllocSize = (jrs_u32)pHeap->GetMaxAllocationSize();
+			info.uPad1 = info.uPad2 = 0;
+			info.uFlags = 0;
+#ifdef MEMORYMANAGER_ENABLESENTINELCHECKS
+			info.uFlags |= 1 << 7;
+#endif
 #ifdef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
-		flags |= 1 << 7;
+			info.uFlags |= 1 << 6;
 #endif
+			ContinuousLog_AddToBuffer(op, &info);
+
+			if(m_bEnableContinuousDump && m_pCompactDump)
+			{
+				if(eType == eContLog_CreateHeap)
+					CompactDump_CreateRecord(eType, pHeap->GetUniqueId(), eContinuousDumpKind_Heap, 0, op.address, info.uSize, info.uDefaultAlignment, info.uMinAllocSize, info.uMaxAllocSize, pHeap->GetName());
+				else
+					CompactDump_Record(eType, pHeap->GetUniqueId(), 0, info.uSize, 0, 0, NULL);
+			}
+			else if(m_bEnableContinuousDump)
+			{
+				const jrs_i8 *pOp = "Heap Create";
+				if(op.type == eContLog_DestroyHeap)
+				{
+					pOp = "Heap Destroy";
+				}
+				else if(op.type == eContLog_ResizeHeap)
+				{
+					pOp = "Heap Resize";
+				}
+
+				sprintf(ContinuousOutputText, "%s; %s; 0x%llx; 0x%llx; 0x%x; 0x%x; 0x%x; 0x0; 0x0; 0x0; 0x0; 0x0; 0x0; 0x0\n",
+					pOp,
+					pHeap->GetName(),
+					op.address,
+					info.uSize,
+					info.uDefaultAlignment,
+					info.uMinAllocSize,
+					info.uMaxAllocSize
+					);
+			}
+		}
+		else if(eType == eContLog_CreatePool || eType == eContLog_DestroyPool)
+		{
+			op.idofheappool = 0;
+			struct LVOpPoolInformation
+			{
+				jrs_u64 uSize;				// 8
+				jrs_u32 uDefaultAlignment;  // 12
+				jrs_u32 uAllocSize;			// 16
+				jrs_u32 uPad1;				// 20
+				jrs_u32 uPad2;				// 24
+				jrs_u32 uFlags;				// 28
+			};
+
+			op.idofheappool = (jrs_u16)pPool->GetUniqueId();
+			op.address = (jrs_u64)pPool->GetAddress();
+
+			LVOpPoolInformation info;
+			info.uSize = pPool->GetSize();
+			info.uDefaultAlignment = 0;
+			info.uAllocSize = pPool->GetAllocationSize();
+			info.uFlags = 0;
+			info.uFlags |= pPool->HasNameAndCallstackTracing() ? 1 << 7 : 0;
+			info.uFlags |= pPool->HasSentinels() ? 1 << 6 : 0;
+			ContinuousLog_AddToBuffer(op, &info);
+
+			if(m_bEnableContinuousDump && m_pCompactDump)
+			{
+				if(eType == eContLog_CreatePool)
+					CompactDump_CreateRecord(eType, pPool->GetUniqueId(), eContinuousDumpKind_Pool, pPool->GetHeap()->GetUniqueId(), op.address, info.uSize, 0, info.uAllocSize, info.uAllocSize, pPool->GetName());
+				else
+					CompactDump_Record(eType, pPool->GetUniqueId(), 0, 0, 0, 0, NULL);
+			}
+			else if(m_bEnableContinuousDump)
+			{
+				const jrs_i8 *pOp = "Pool Create";
+				if(op.type == eContLog_DestroyPool)
+				{
+					pOp = "Pool Destroy";
+				}
 
-#ifdef MEMORYMANAGER_ENABLESENTINELCHECKS
-		flags |= 1 << 6;
-#endif
+				sprintf(ContinuousOutputText, "%s; %s$$%s; 0x%llx; 0x%llx; 0x%x; 0x0; 0x0; 0x0; 0x0; 0x0; 0x0; 0x0; 0x0; 0x0\n",
+					pOp,
+					pPool->GetName(), pPool->GetHeap()->GetName(),
+					op.address,
+					info.uSize,
+					info.uAllocSize
+					);
+			}
+		}
+		else if(eType == eContLog_Marker)
+		{
+			jrs_i8 text[32];
+			op.idofheappool = eContLog_Marker;
+			jrs_u32 size = (jrs_u32)strlen((jrs_i8 *)pHeap);
+			size = (size >= 31) ? 30 : size;
+			memcpy(text, pHeap, size);
+			text[size] = '\0';
+			ContinuousLog_AddToBuffer(op, text);
 
-		jrs_bool bFileAppend = TRUE;
-		jrs_i8 ContinuousOutputText[2048];
+			if(m_bEnableContinuousDump && m_pCompactDump)
+			{
+				CompactDump_Record(eType, 0, 0, 0, 0, 0, text);
+			}
+			else if(m_bEnableContinuousDump)
+			{
+				sprintf(ContinuousOutputText, "Marker; %s; 0x0; 0x0; 0x0; 0; 0; 0; 0; 0; 0; 0; 0; 0\n", text);
+			}
+		}
+		else if(eType == eContLog_StartLogging || eType == eContLog_StopLogging)
+		{
+			op.idofheappool = 0;
+			ContinuousLog_AddToBuffer(op, NULL);
 
-		jrs_u64 heapSize = (jrs_u64)pHeap->GetSize();
-		jrs_u64 heapMemSize = (jrs_u64)pHeap->GetMemoryUsed();
-		jrs_u64 heapMemCount = (jrs_u64)pHeap->GetNumberOfAllocations();
-		jrs_u64 heapDetails = (((MemoryManager_StringLength << 9) | (0 << 8) | JRSMEMORY_CALLSTACKDEPTH) << 16);	// Always freeblock as thats the largest.
+			// The compact dump starts a new file or writes its index
+			if(m_bEnableContinuousDump && m_pCompactDump)
+			{
+				if(eType == eContLog_StartLogging)
+					CompactDump_Start();
+				else
+					CompactDump_Finish();
 
-		sLVOperation op;
-		if(eType == eContLog_Allocate)
-		{
-			op.type = (jrs_u8)eContLog_Allocate | flags;
-			op.address = (jrs_u64)pHeaderAdd;
-			op.sizeofopdata = (jrs_u8)cMemoryManager::Get().SizeofAllocatedBlock();
-			op.alignment = uAlignment;
-			op.idofheappool = (jrs_u16)pHeap->GetUniqueId();
-			op.extraInfo0 = heapMemCount;
-			op.extraInfo1 = heapMemSize;
-			op.extraInfo2 = heapSize;
-			op.extraInfo3 = heapDetails | cMemoryManager::Get().SizeofAllocatedBlock();
+				m_ContThreadLock.Unlock();
+				return;
+			}
 
-			// Log it out if needed
 			if(m_bEnableContinuousDump)
 			{
-				sAllocatedBlock *pBlock = (sAllocatedBlock *)pHeaderAdd;
-				sprintf(ContinuousOutputText, "Heap Alloc; %s; 0x%llx; 0x%llx; 0x%x; 0x%x; 0x%x; 0x%llx; 0x%llx; 0x%llx; 0x%llx"
-					, pHeap->GetName()
-					, (jrs_u64)(((jrs_i8 *)pHeaderAdd) + sizeof(sAllocatedBlock))
-					, (jrs_u64)pBlock->uSize
-					, uAlignment
-					, (jrs_u32)(pBlock->uFlagAndUniqueAllocNumber & 0xf), (jrs_u32)(pBlock->uFlagAndUniqueAllocNumber >> 4)
-					, heapMemCount
-					, heapMemSize
-					, heapSize
-					, heapDetails);
-
-#ifndef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
-				strcat(ContinuousOutputText, "Unknown");					
+				if(eType == eContLog_StartLogging)
+				{
+					bFileAppend = false;
+					sprintf(ContinuousOutputText, "Logging Started; %d; 0x%llx; %d; %d; ; ; ; ; ; ; ; ; 0\n", 
+#ifdef JRS64BIT
+						1,
 #else
-				strcat(ContinuousOutputText, pBlock->Name);
+						0,
 #endif
-				for(jrs_u32 cs = 0; cs < JRSMEMORY_CALLSTACKDEPTH; cs++)
-				{
-#ifdef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
-					jrs_i8 temp[32];
-					sprintf(temp, "; 0x%llx", (jrs_u64)MemoryManagerPlatformAddressToBaseAddress(pBlock->uCallsStack[cs]));
-					strcat(ContinuousOutputText, temp);
+						g_uBaseAddressOffsetCalculation, 
+#ifdef JRSMEMORYMICROSOFTPLATFORMS
+						0,
 #else
-					strcat(ContinuousOutputText, "; 0x0");
+						1,
 #endif
+						this->m_bResizeable ? 1 : 0
+						);
+				}
+				else
+				{
+					m_ContThreadLock.Unlock();
+					return;
 				}
-				strcat(ContinuousOutputText, "\n");
 			}
 		}
-		else if(eType == eContLog_Free)
+		else 
 		{
-			op.type = (jrs_u8)eContLog_Free | flags;
-			op.address = (jrs_u64)pHeaderAdd;
-			op.sizeofopdata = (jrs_u8)cMemoryManager::Get().SizeofFreeBlock();
-			op.alignment = (jrs_u32)uMisc;
-			op.idofheappool = (jrs_u16)pHeap->GetUniqueId();
-			op.extraInfo0 = heapMemCount;
-			op.extraInfo1 = heapMemSize;
-			op.extraInfo2 = heapSize;
-			op.extraInfo3 = heapDetails | cMemoryManager::Get().SizeofAllocatedBlock();
+			MemoryWarning(0, JRSMEMORYERROR_UNKNOWNWARNING, "Wrong type for ContinuousLogging_Operation.");
+		}
 
-			if(m_bEnableContinuousDump)
+		// Add the data
+		// Write CSV file if need be
+		if(m_bEnableContinuousDump && m_MemoryManagerFileOutput && !m_pCompactDump)
+			m_MemoryManagerFileOutput(ContinuousOutputText, (int)strlen(ContinuousOutputText), m_ContinuousDumpFile, bFileAppend);
+
+		// Unlock the continuous writes
+		m_ContThreadLock.Unlock();
+#endif
+	}
+
+	//  Description:
+	//		Internal only.  This function add data to the internal ring buffer of operations to be transmitted.  This specific function deals with 
+	//		the heap operations.
+	//  See Also:
+	//		
+	//  Arguments:
+	//		eType - Type of Logging operation.
+	//		pHeap - Heap pointer.
+	//		pPool - Pool pointer base.
+	//		uMisc - Misc information.
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Reports any operations that occur on a specific heap.  These cover Allocations, Frees and Reallocs.  Reallocs may not always show.
+	void cMemoryManager::ContinuousLogging_NIOperation(eContLog eType, cHeapNonIntrusive *pHeap, cPoolBase *pPool, jrs_u64 uMisc)
+	{
+#ifndef MEMORYMANAGER_MINIMAL
+		// Only if active - we ignore the heap here and only care about if we should be logging or not
+		if(!m_bELVContinuousGrab && !m_bEnableContinuousDump)
+			return;
+
+		if(ContinuousLog_IsDumpWriter())
+			return;
+
+		// Lock the thread writes
+		m_ContThreadLock.Lock();
+
+		jrs_bool bFileAppend = TRUE;
+		jrs_i8 ContinuousOutputText[512];
+
+		sLVOperation op;
+		op.type = (jrs_u8)eType;
+		op.address = 0;
+		op.sizeofopdata = 32;
+		op.alignment = 0;
+		op.extraInfo0 = op.extraInfo1 = op.extraInfo2 = op.extraInfo3 = 0;
+		if(eType == eContLog_CreateHeap || eType == eContLog_DestroyHeap || eType == eContLog_ResizeHeap)
+		{	
+			struct LVOpHeapInformation
 			{
-				sFreeBlock *pBlock = (sFreeBlock *)pHeaderAdd;
-				sprintf(ContinuousOutputText, "Heap Free; %s; 0x%llx; 0x%llx; 0x%x; 0x%x; 0x%llx; 0x%llx; 0x%llx; 0x%llx; 0x%llx"
-					, pHeap->GetName()
-					, (jrs_u64)(((jrs_i8 *)pHeaderAdd) + sizeof(sAllocatedBlock))
-					, (jrs_u64)pBlock->uSize
-					, uAlignment
-					, 0, (jrs_u64)pBlock->uFlags		// flag/id
-					, heapMemCount
-					, heapMemSize
-					, heapSize
-					, heapDetails);
+				jrs_u64 uSize;				// 0
+				jrs_u32 uDefaultAlignment;  // 8
+				jrs_u32 uMinAllocSize;		// 12
+				jrs_u32 uMaxAllocSize;		// 16
+				jrs_u32 uPad1;				// 20
+				jrs_u32 uPad2;				// 24
+				jrs_u32 uFlags;				// 28
+			};
 
+			op.idofheappool = pHeap->GetUniqueId();
+			op.address = (jrs_u64)(pHeap->GetAddress());
 
-#ifndef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
-				strcat(ContinuousOutputText, "Unknown");					
-#else
-				strcat(ContinuousOutputText, pBlock->Name);
-#endif
-				for(jrs_u32 cs = 0; cs < JRSMEMORY_CALLSTACKDEPTH; cs++)
+			LVOpHeapInformation info;
+			info.uSize = pHeap->GetSize();
+			info.uDefaultAlignment = (jrs_u32)pHeap->GetDefaultAlignment();
+			info.uMinAllocSize = (jrs_u32)pHeap->GetMinAllocationSize();
+			info.uMaxAllocSize = (jrs_u32)pHeap->GetMaxAllocationSize();
+			info.uPad1 = info.uPad2 = 0;
+			info.uFlags = 0;
+			
+			if(pHeap->IsMemoryTrackingEnabled())
+				info.uFlags |= 1 << 7;
+
+// #ifdef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
+// 			info.uFlags |= 1 << 6;
+// #endif
+			ContinuousLog_AddToBuffer(op, &info);
+
+			if(m_bEnableContinuousDump && m_pCompactDump)
+			{
+				if(eType == eContLog_CreateHeap)
+					CompactDump_CreateRecord(eType, pHeap->GetUniqueId(), eContinuousDumpKind_NonIntrusiveHeap, 0, op.address, info.uSize, info.uDefaultAlignment, info.uMinAllocSize, info.uMaxAllocSize, pHeap->GetName());
+				else
+					CompactDump_Record(eType, pHeap->GetUniqueId(), 0, info.uSize, 0, 0, NULL);
+			}
+			else if(m_bEnableContinuousDump)
+			{
+				const jrs_i8 *pOp = "Heap Create";
+				if(op.type == eContLog_DestroyHeap)
 				{
-#ifdef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
-					jrs_i8 temp[32];
-					sprintf(temp, "; 0x%llx", (jrs_u64)MemoryManagerPlatformAddressToBaseAddress(pBlock->uCallsStack[cs]));
-					strcat(ContinuousOutputText, temp);
-#else
-					strcat(ContinuousOutputText, "; 0x0");
-#endif
+					pOp = "Heap Destroy";
 				}
-				strcat(ContinuousOutputText, "\n");
+				else if(op.type == eContLog_ResizeHeap)
+				{
+					pOp = "Heap Resize";
+				}
+
+				sprintf(ContinuousOutputText, "%s; %s; 0x%llx; 0x%llx; 0x%x; 0x%x; 0x%x; 0x0; 0x0; 0x0; 0x0; 0x0; 0x0; 0x0\n",
+					pOp,
+					pHeap->GetName(),
+					op.address,
+					info.uSize,
+					info.uDefaultAlignment,
+					info.uMinAllocSize,
+					info.uMaxAllocSize
+					);
 			}
 		}
-		else if(eType == eContLog_ReAlloc)
+		else 
+		{
+			MemoryWarning(0, JRSMEMORYERROR_UNKNOWNWARNING, "Wrong type for ContinuousLogging_Operation.");
+		}
+
+		// Add the data
+		// Write CSV file if need be
+		if(m_bEnableContinuousDump && m_MemoryManagerFileOutput && !m_pCompactDump)
+			m_MemoryManagerFileOutput(ContinuousOutputText, (int)strlen(ContinuousOutputText), m_ContinuousDumpFile, bFileAppend);
+
+		// Unlock the continuous writes
+		m_ContThreadLock.Unlock();
+#endif
+	}
+
+	//  Description:
+	//		Writes a varint.  7 bits per byte, lowest first, with the top bit set on all but the last byte.
+	//  See Also:
+	//		CompactDumpWriteDelta
+	//  Arguments:
+	//		pOut - Where to write.
+	//		uValue - Value to write.
+	//  Return Value:
+	//      Byte after the varint.
+	//  Summary:
+	//		Writes a varint.
+	static jrs_u8 *CompactDumpWriteVarint(jrs_u8 *pOut, jrs_u64 uValue)
+	{
+		while(uValue >= 0x80)
+		{
+			*pOut++ = (jrs_u8)(uValue | 0x80);
+			uValue >>= 7;
+		}
+		*pOut++ = (jrs_u8)uValue;
+		return pOut;
+	}
+
+	//  Description:
+	//		Writes the signed difference from the previous value as a zigzag varint and makes the value the previous one.
+	//  See Also:
+	//		CompactDumpWriteVarint
+	//  Arguments:
+	//		pOut - Where to write.
+	//		uValue - Value to write.
+	//		ruLast - Previous value.
+	//  Return Value:
+	//      Byte after the varint.
+	//  Summary:
+	//		Writes a delta.
+	static jrs_u8 *CompactDumpWriteDelta(jrs_u8 *pOut, jrs_u64 uValue, jrs_u64 &ruLast)
+	{
+		jrs_u64 uDelta = uValue - ruLast;
+		ruLast = uValue;
+		return CompactDumpWriteVarint(pOut, (uDelta << 1) ^ (0 - (uDelta >> 63)));
+	}
+
+	//  Description:
+	//		Writes a name as its length and characters.  Long names keep their end like the heap block names.
+	//  See Also:
+	//		CompactDumpWriteVarint
+	//  Arguments:
+	//		pOut - Where to write.
+	//		pName - Name.  NULL for none.
+	//  Return Value:
+	//      Byte after the name.
+	//  Summary:
+	//		Writes a name.
+	static jrs_u8 *CompactDumpWriteName(jrs_u8 *pOut, const jrs_i8 *pName)
+	{
+		jrs_u32 uLength = pName ? (jrs_u32)strlen(pName) : 0;
+		if(uLength > ContinuousDump_MaxName)
 		{
-			op.type = (jrs_u8)eContLog_ReAlloc | flags;
-			op.address = (jrs_sizet)pHeaderAdd;
-			op.sizeofopdata = (jrs_u8)cMemoryManager::Get().SizeofFreeBlock();
-			op.alignment = uAlignment;
-			op.idofheappool = pHeap->GetUniqueId();
-			op.extraInfo0 = op.extraInfo1 = op.extraInfo2 = op.extraInfo3 = 0;
+			pName += uLength - ContinuousDump_MaxName;
+			uLength = ContinuousDump_MaxName;
 		}
-		else 
+
+		*pOut++ = (jrs_u8)uLength;
+		memcpy(pOut, pName, uLength);
+		return pOut + uLength;
+	}
+
+	//  Description:
+	//		Writes literal runs of up to 128 bytes for CompactDumpCompress.
+	//  See Also:
+	//		CompactDumpCompress
+	//  Arguments:
+	//		pIn - Literal bytes.
+	//		uCount - Number of literal bytes.
+	//		pOut - Compressed output.
+	//		ruOut - Position in pOut.  Moved past the runs.
+	//		uOutMax - Size of pOut.
+	//  Return Value:
+	//      FALSE if pOut is too small.
+	//  Summary:
+	//		Writes literal runs.
+	static jrs_bool CompactDumpLiterals(const jrs_u8 *pIn, jrs_u32 uCount, jrs_u8 *pOut, jrs_u32 &ruOut, jrs_u32 uOutMax)
+	{
+		while(uCount)
 		{
-			MemoryWarning(0, JRSMEMORYERROR_UNKNOWNWARNING, "Wrong type for ContinuousLogging_HeapOperation.");
-		}
+			jrs_u32 uRun = uCount > 128 ? 128 : uCount;
+			if(ruOut + 1 + uRun > uOutMax)
+				return FALSE;
 
-		// Write CSV file if need be
-		if(m_bEnableContinuousDump && m_MemoryManagerFileOutput)
-			m_MemoryManagerFileOutput(ContinuousOutputText, (int)strlen(ContinuousOutputText), m_ContinuousDumpFile, bFileAppend);
-				
-		// Add the data
-		ContinuousLog_AddToBuffer(op, pHeaderAdd);
+			pOut[ruOut++] = (jrs_u8)(uRun - 1);
+			memcpy(pOut + ruOut, pIn, uRun);
+			ruOut += uRun;
+			pIn += uRun;
+			uCount -= uRun;
+		}
 
-		// Unlock the continuous writes
-		m_ContThreadLock.Unlock();
-#endif
+		return TRUE;
 	}
 
 	//  Description:
-	//		Internal only.  This function add data to the internal ring buffer of operations to be transmitted.  This specific function deals with 
-	//		the heap operations.
+	//		Compresses a chunk in the format ContinuousDump_Decompress reads.  Greedy matching of 4 byte sequences through a hash table of the
+	//		last position each was seen.  Records repeat names, stack ids and small deltas so this does well without an entropy coder.
 	//  See Also:
-	//		ContinuousLogging_Operation
+	//		ContinuousDump_Decompress
 	//  Arguments:
-	//		eType - Type of Logging operation.
-	//		pHeap - Heap pointer.
-	//		pHeaderAdd - Header address of the operation.
-	//		uAlignment - Alignment of the operation.
-	//		uMisc - Misc information.
+	//		pIn - Chunk data.
+	//		uInSize - Size of the chunk data.
+	//		pOut - Compressed output.
+	//		uOutMax - Size of pOut.
+	//		pHashTable - 1 << MemoryManager_CompactDumpHashBits entries of scratch.
 	//  Return Value:
-	//      Nothing
-	//  Summary:	
-	//		Reports any operations that occur on a specific non intrusive heap.  These cover Allocations, Frees and Reallocs.  Reallocs may not always show.
-	void cMemoryManager::ContinuousLogging_HeapNIOperation(eContLog eType, cHeapNonIntrusive *pHeap, void *pHeaderAdd, jrs_u32 uAlignment, jrs_u64 uSize, jrs_u64 uMisc)
+	//      Compressed size.  0 if it would not fit in uOutMax bytes.
+	//  Summary:
+	//		Compresses a chunk.
+	static jrs_u32 CompactDumpCompress(const jrs_u8 *pIn, jrs_u32 uInSize, jrs_u8 *pOut, jrs_u32 uOutMax, jrs_u32 *pHashTable)
 	{
-#ifndef MEMORYMANAGER_MINIMAL
-		// Only if active
-		if(!ContinuousLog_CanLog(pHeap))
-			return;
+		memset(pHashTable, 0xff, sizeof(jrs_u32) << MemoryManager_CompactDumpHashBits);
 
-		// Lock the thread writes
-		m_ContThreadLock.Lock();
+		jrs_u32 uIn = 0;
+		jrs_u32 uOut = 0;
+		jrs_u32 uLiteral = 0;
+		while(uIn + 4 <= uInSize)
+		{
+			jrs_u32 uSequence;
+			memcpy(&uSequence, pIn + uIn, sizeof(uSequence));
+			jrs_u32 uHash = (uSequence * 2654435761U) >> (32 - MemoryManager_CompactDumpHashBits);
+			jrs_u32 uCandidate = pHashTable[uHash];
+			pHashTable[uHash] = uIn;
 
-		jrs_u8 flags = 0;
-		flags |= 1 << 5;						// Size not included in 
-		if(pHeap->IsMemoryTrackingEnabled())
-			flags |= 1 << 7;
+			if(uCandidate == 0xffffffff || uIn - uCandidate > 0xffff || memcmp(pIn + uCandidate, pIn + uIn, 4))
+			{
+				uIn++;
+				continue;
+			}
 
-		// Not available for NI heaps
-// #ifdef MEMORYMANAGER_ENABLESENTINELCHECKS
-// 		flags |= 1 << 6;
-// #endif
+			jrs_u32 uLength = 4;
+			while(uLength < 131 && uIn + uLength < uInSize && pIn[uCandidate + uLength] == pIn[uIn + uLength])
+				uLength++;
 
-		jrs_u64 heapSize = pHeap->GetSize();
-		jrs_u64 heapMemSize = pHeap->GetMemoryUsed();
-		jrs_u64 heapMemCount = pHeap->GetNumberOfAllocations();
+			if(!CompactDumpLiterals(pIn + uLiteral, uIn - uLiteral, pOut, uOut, uOutMax) || uOut + 3 > uOutMax)
+				return 0;
 
-		jrs_bool bFileAppend = TRUE;
-		jrs_i8 ContinuousOutputText[2048];
+			jrs_u32 uOffset = uIn - uCandidate;
+			pOut[uOut++] = (jrs_u8)(0x80 | (uLength - 4));
+			pOut[uOut++] = (jrs_u8)uOffset;
+			pOut[uOut++] = (jrs_u8)(uOffset >> 8);
+			uIn += uLength;
+			uLiteral = uIn;
+		}
 
-		// Find the page by getting the base alignment
-		jrs_i8 *pPageAdd = (jrs_i8 *)((jrs_sizet)pHeaderAdd & ~(pHeap->GetPageSize() - 1));
-		cHeapNonIntrusive::sSlab *pSlab = pHeap->FindSlabFromMemory(pPageAdd);
-		jrs_sizet pageIndex = ((jrs_sizet)pPageAdd - (jrs_sizet)pSlab->pBase) / pHeap->GetPageSize();
-		cHeapNonIntrusive::sPageBlock *pBlock = &pSlab->pBlocks[pageIndex];
+		if(!CompactDumpLiterals(pIn + uLiteral, uInSize - uLiteral, pOut, uOut, uOutMax))
+			return 0;
 
-		jrs_u64 blockSize = pBlock->numFreePages * pHeap->GetPageSize();
-		if(pBlock->pageFlags & JRSMEMORYMANAGER_PAGESUBALLOC)
-		{
-			//offsetDebug = offset / pBlock->sizeOfSubAllocs;
-			blockSize = pBlock->sizeOfSubAllocs;
-		}
-		
-		const jrs_i8 *pText = "Unknown";
-		jrs_sizet *puCallStack = NULL;
-		jrs_u8 transferSize = 0;
-#ifndef MEMORYMANAGER_MINIMAL
-		if(pBlock->pDebugInfo)
-		{
-			pText = (jrs_i8 *)pBlock->pDebugInfo;
-			puCallStack = (jrs_sizet *)(pText + MemoryManager_StringLength);
-			transferSize = (jrs_u8)pHeap->m_uDebugHeaderSize + sizeof(jrs_u64) + sizeof(jrs_u64);
-			MemoryWarning(transferSize < 255, JRSMEMORYERROR_UNKNOWNWARNING, "Transfer size is to big. Must be maximum of 256 bytes (32char string + size + flags + callstack depth of 52 (26 in 64bit)");
-		}
-		else
+		return uOut;
+	}
+
+	//  Description:
+	//		Allocates the compact continuous dump from the default allocator and starts its writer thread.  Called by Initialize when
+	//		InitializeCompactContinuousDump has set a chunk size.  Private.
+	//  See Also:
+	//		InitializeCompactContinuousDump, DestroyCompactDump
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      TRUE if the dump exists.
+	//		FALSE if the memory could not be allocated.
+	//  Summary:
+	//		Allocates the compact continuous dump.
+	jrs_bool cMemoryManager::CreateCompactDump(void)
+	{
+		jrs_u32 uStackBits = 1;
+		while(uStackBits < m_uMaxStacks)
+			uStackBits <<= 1;
+
+		jrs_u32 uStackWords = (uStackBits + 31) / 32;
+		jrs_u32 uOutputSize = sizeof(sContinuousDumpChunkHeader) + m_uCompactDumpChunkSize;
+		jrs_u64 uBlockSize = sizeof(sCompactDump) + (jrs_u64)uStackWords * sizeof(jrs_u32) + (sizeof(jrs_u32) << MemoryManager_CompactDumpHashBits) + uOutputSize;
+		sCompactDump *pDump = (sCompactDump *)m_MemoryManagerDefaultAllocator(uBlockSize, NULL);
+		if(!pDump)
+			return false;
+
+		memset(pDump, 0, sizeof(sCompactDump));
+		pDump->uBlockSize = uBlockSize;
+		pDump->uChunkSize = m_uCompactDumpChunkSize;
+		pDump->uStackBits = uStackBits;
+		pDump->pStacksSent = (jrs_u32 *)(pDump + 1);
+		pDump->pHashTable = pDump->pStacksSent + uStackWords;
+		pDump->pOutput = (jrs_u8 *)(pDump->pHashTable + (1 << MemoryManager_CompactDumpHashBits));
+
+		// The chunks logging starts with
+		for(jrs_u32 i = 0; i < m_uCompactDumpChunks; i++)
 		{
-			// The size and space for details later
-			transferSize = sizeof(jrs_u64) + sizeof(jrs_u64);
+			sCompactDump::sChunk *pChunk = (sCompactDump::sChunk *)m_MemoryManagerDefaultAllocator(sizeof(sCompactDump::sChunk) + pDump->uChunkSize, NULL);
+			if(!pChunk)
+				break;
+
+			pChunk->pNext = pDump->pFree;
+			pDump->pFree = pChunk;
+			pDump->uNumChunks++;
 		}
-#endif
-		// The 1 << 8 elmininates it from calculations in goldfish
-		jrs_u64 heapDetails = (((MemoryManager_StringLength << 9) | (1 << 8) | pHeap->m_uNumCallStacks) << 16) | transferSize;
 
-		sLVOperation op;
-		if(eType == eContLog_Allocate)
+		m_pCompactDump = pDump;
+		if(pDump->uNumChunks < 2)
 		{
-			op.type = (jrs_u8)eContLog_Allocate | flags;
-			op.address = (jrs_sizet)pHeaderAdd;
-			op.sizeofopdata = transferSize;
-			op.alignment = uAlignment;
-			op.idofheappool = pHeap->GetUniqueId();
-			op.extraInfo0 = heapMemCount;
-			op.extraInfo1 = heapMemSize;
-			op.extraInfo2 = heapSize;
-			op.extraInfo3 = heapDetails;
+			DestroyCompactDump();
+			return false;
+		}
 
-			// Log it out if needed
-			if(m_bEnableContinuousDump)
-			{
-				sprintf(ContinuousOutputText, "Heap Alloc; %s; 0x%llx; 0x%llx; 0x%x; 0x%x; 0x%x; 0x%llx; 0x%llx; 0x%llx; 0x%llx"
-					, pHeap->GetName()
-					, (jrs_u64)(((jrs_i8 *)pHeaderAdd) + sizeof(sAllocatedBlock))
-					, blockSize
-					, uAlignment
-					, 0, 0
-					, heapMemCount
-					, heapMemSize
-					, heapSize
-					, heapDetails);
-				
-				strcat(ContinuousOutputText, pText);	
+		pDump->bRunning = TRUE;
+		g_MemoryManagerContinuousDumpThread.Create(JRSMemory_ContinuousDumpThread, pDump, cJRSThread::eJRSPriority_Low, 4, 32 * 1024);
+		g_MemoryManagerContinuousDumpThread.Start();
 
-				for(jrs_u32 cs = 0; cs < pHeap->m_uNumCallStacks; cs++)
-				{
-					jrs_i8 temp[32];
-					sprintf(temp, "; 0x%llx", (jrs_u64)MemoryManagerPlatformAddressToBaseAddress(puCallStack ? puCallStack[cs] : 0));
-					strcat(ContinuousOutputText, temp);
-				}
-				strcat(ContinuousOutputText, "\n");
-			}
-		}
-		else if(eType == eContLog_Free)
-		{
-			op.type = (jrs_u8)eContLog_Free | flags;
-			op.address = (jrs_sizet)pHeaderAdd;
-			op.sizeofopdata = transferSize;
-			op.alignment = (jrs_u32)uMisc;
-			op.idofheappool = pHeap->GetUniqueId();
-			op.extraInfo0 = heapMemCount;
-			op.extraInfo1 = heapMemSize;
-			op.extraInfo2 = heapSize;
-			op.extraInfo3 = heapDetails;
+		return true;
+	}
 
-			if(m_bEnableContinuousDump)
-			{
-				sprintf(ContinuousOutputText, "Heap Free; %s; 0x%llx; 0x%llx; 0x%x; 0x%x; 0x%llx; 0x%llx; 0x%llx; 0x%llx; 0x%llx"
-					, pHeap->GetName()
-					, (jrs_u64)(((jrs_i8 *)pHeaderAdd) + sizeof(sAllocatedBlock))
-					, blockSize
-					, uAlignment
-					, 0, (jrs_u64)0
-					, heapMemCount
-					, heapMemSize
-					, heapSize
-					, heapDetails);
+	//  Description:
+	//		Stops the writer thread once it has written every queued chunk and frees the compact continuous dump.  Called by Destroy after
+	//		logging has stopped.  Private.
+	//  See Also:
+	//		CreateCompactDump
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      Nothing
+	//  Summary:
+	//		Frees the compact continuous dump.
+	void cMemoryManager::DestroyCompactDump(void)
+	{
+		sCompactDump *pDump = m_pCompactDump;
+		if(!pDump)
+			return;
 
-				strcat(ContinuousOutputText, pText);			
-				for(jrs_u32 cs = 0; cs < pHeap->m_uNumCallStacks; cs++)
-				{
-					jrs_i8 temp[32];
-					sprintf(temp, "; 0x%llx", (jrs_u64)MemoryManagerPlatformAddressToBaseAddress(puCallStack ? puCallStack[cs] : 0));
-					strcat(ContinuousOutputText, temp);
-				}
-				strcat(ContinuousOutputText, "\n");
-			}
+		if(pDump->bRunning)
+		{
+			pDump->bRunning = FALSE;
+			g_MemoryManagerContinuousDumpThread.Destroy();
 		}
-		else if(eType == eContLog_ReAlloc)
+		m_pCompactDump = NULL;
+
+		// Finishing left every chunk on the free list
+		if(pDump->pFill)
 		{
-			op.type = (jrs_u8)eContLog_ReAlloc | flags;
-			op.address = (jrs_sizet)pHeaderAdd;
-			op.sizeofopdata = transferSize;
-			op.alignment = uAlignment;
-			op.idofheappool = pHeap->GetUniqueId();
-			op.extraInfo0 = op.extraInfo1 = op.extraInfo2 = op.extraInfo3 = 0;
+			pDump->pFill->pNext = pDump->pFree;
+			pDump->pFree = pDump->pFill;
 		}
-		else 
+		while(pDump->pFree)
 		{
-			MemoryWarning(0, JRSMEMORYERROR_UNKNOWNWARNING, "Wrong type for ContinuousLogging_HeapOperation.");
+			sCompactDump::sChunk *pChunk = pDump->pFree;
+			pDump->pFree = pChunk->pNext;
+			m_MemoryManagerDefaultFree(pChunk, sizeof(sCompactDump::sChunk) + pDump->uChunkSize);
 		}
 
-		// Write CSV file if need be
-		if(m_bEnableContinuousDump && m_MemoryManagerFileOutput)
-			m_MemoryManagerFileOutput(ContinuousOutputText, (int)strlen(ContinuousOutputText), m_ContinuousDumpFile, bFileAppend);
+		if(pDump->pIndex)
+			m_MemoryManagerDefaultFree(pDump->pIndex, pDump->uMaxIndex * sizeof(sContinuousDumpIndexEntry));
+		m_MemoryManagerDefaultFree(pDump, pDump->uBlockSize);
+	}
 
-		// Add the data - We cant do this yet
-		jrs_u8 dataToTransfer[256];
-		if(pBlock->pDebugInfo)
+	//  Description:
+	//		Internal only.  Checks if the calling thread is the compact dump writer.  Allocations made by the file callback are not logged as
+	//		the writer would otherwise wait on itself.
+	//  See Also:
+	//		ContinuousLog_CanLog
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      TRUE if called from the writer thread.
+	//  Summary:
+	//		Checks if the calling thread is the compact dump writer.
+	jrs_bool cMemoryManager::ContinuousLog_IsDumpWriter(void) const
+	{
+		return m_pCompactDump && m_pCompactDump->uWriterThread == JRSThread::CurrentID();
+	}
+
+	//  Description:
+	//		Internal only.  Starts a new compact dump file.  Any file in progress is finished first.  The writer thread writes the file header
+	//		with the first chunk.  m_ContThreadLock must be held.
+	//  See Also:
+	//		CompactDump_Finish
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      Nothing
+	//  Summary:
+	//		Starts a new compact dump file.
+	void cMemoryManager::CompactDump_Start(void)
+	{
+		sCompactDump *pDump = m_pCompactDump;
+		CompactDump_Finish();
+		if(!m_MemoryManagerFileOutput)
+			return;
+
+		pDump->uFileStartTicks = JRSTimer::GetTicks();
+		pDump->bNewFile = TRUE;
+		memset(pDump->pStacksSent, 0, ((pDump->uStackBits + 31) / 32) * sizeof(jrs_u32));
+		pDump->bStarted = TRUE;
+	}
+
+	//  Description:
+	//		Internal only.  Finishes the compact dump file.  The chunk being filled is marked as the last of the file and queued so the
+	//		writer thread writes the chunk index and footer after it.  This does not wait for the writer as the file callback may need a heap
+	//		a thread waiting on m_ContThreadLock has locked.  Does nothing if no file is in progress.  m_ContThreadLock must be held.
+	//  See Also:
+	//		CompactDump_Start
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      Nothing
+	//  Summary:
+	//		Finishes the compact dump file.
+	void cMemoryManager::CompactDump_Finish(void)
+	{
+		sCompactDump *pDump = m_pCompactDump;
+		if(!pDump || !pDump->bStarted)
+			return;
+
+		// The end of the file needs a chunk to carry it even if it has no records
+		pDump->bStarted = FALSE;
+		if(!pDump->pFill && !CompactDump_NewChunk())
 		{
-			jrs_u64 zeros = 0;
-			memcpy(&dataToTransfer[0], &blockSize, sizeof(jrs_u64));
-			memcpy(&dataToTransfer[8], &zeros, sizeof(jrs_u64));
-			memcpy(&dataToTransfer[16], pBlock->pDebugInfo, transferSize);
-			ContinuousLog_AddToBuffer(op, dataToTransfer);
+			DebugOutput("Elephant: Compact continuous dump could not allocate a chunk to finish the file.  The file has no index.\n");
+			return;
 		}
-		else if(transferSize)
-		{
-			jrs_u64 zeros = 0;
-			memcpy(&dataToTransfer[0], &blockSize, sizeof(jrs_u64));
-			memcpy(&dataToTransfer[8], &zeros, sizeof(jrs_u64));
-			ContinuousLog_AddToBuffer(op, dataToTransfer);
+
+		pDump->pFill->uFlags |= MemoryManager_CompactDumpLastInFile;
+		CompactDump_QueueChunk();
+	}
+
+	//  Description:
+	//		Internal only.  Starts a new chunk to fill.  Takes a free chunk or allocates one.  m_ContThreadLock must be held.
+	//  See Also:
+	//		CompactDump_BeginRecord
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      TRUE if pFill was set.
+	//		FALSE if no chunk could be allocated.
+	//  Summary:
+	//		Starts a new chunk to fill.
+	jrs_bool cMemoryManager::CompactDump_NewChunk(void)
+	{
+		sCompactDump *pDump = m_pCompactDump;
+		m_ContDumpLock.Lock();
+		sCompactDump::sChunk *pChunk = pDump->pFree;
+		if(pChunk)
+			pDump->pFree = pChunk->pNext;
+		m_ContDumpLock.Unlock();
+
+		// The writer is behind.  Waiting could stop it if the file callback needs a heap this thread has locked.
+		if(!pChunk)
+		{
+			pChunk = (sCompactDump::sChunk *)m_MemoryManagerDefaultAllocator(sizeof(sCompactDump::sChunk) + pDump->uChunkSize, NULL);
+			if(!pChunk)
+				return false;
+
+			m_ContDumpLock.Lock();
+			pDump->uNumChunks++;
+			m_ContDumpLock.Unlock();
 		}
 
-		// Unlock the continuous writes
-		m_ContThreadLock.Unlock();
-#endif
+		// Every chunk decodes on its own
+		pChunk->uUsed = 0;
+		pChunk->uNumRecords = 0;
+		pChunk->uFirstTicks = JRSTimer::GetTicks();
+		pChunk->uStartTicks = pDump->uFileStartTicks;
+		pChunk->uFlags = pDump->bNewFile ? MemoryManager_CompactDumpFirstInFile : 0;
+		pDump->bNewFile = FALSE;
+		pDump->pFill = pChunk;
+		pDump->uLastTicks = pChunk->uFirstTicks;
+		pDump->uLastAddress = 0;
+		pDump->uLastThread = MemoryManager_CompactDumpNoId;
+		pDump->uLastId = MemoryManager_CompactDumpNoId;
+
+		return true;
 	}
 
 	//  Description:
-	//		Internal only.  This function add data to the internal ring buffer of operations to be transmitted.  This specific function deals with 
-	//		the heap operations.
+	//		Internal only.  Queues the chunk being filled for the writer.  The next record takes a free chunk or allocates one and defines its
+	//		stacks again.  m_ContThreadLock must be held.
 	//  See Also:
-	//		ContinuousLogging_Operation
+	//		CompactDump_BeginRecord
 	//  Arguments:
-	//		eType - Type of Logging operation.
-	//		pHeap - Heap pointer.
-	//		pHeaderAdd - Header address of the operation.
-	//		uAlignment - Alignment of the operation.
-	//		uMisc - Misc information.
+	//		None
 	//  Return Value:
 	//      Nothing
-	//  Summary:	
-	//		Reports any operations that occur on a specific heap.  These cover Allocations, Frees and Reallocs.  Reallocs may not always show.
-	void cMemoryManager::ContinuousLogging_PoolOperation(eContLog eType, cPoolBase *pPool, void *pAddress, jrs_u64 uMisc)
+	//  Summary:
+	//		Queues the chunk being filled.
+	void cMemoryManager::CompactDump_QueueChunk(void)
 	{
-#ifndef MEMORYMANAGER_MINIMAL
-		// Only if active
-		if(!ContinuousLog_CanLog(pPool->GetHeap()))
-			return;
+		sCompactDump *pDump = m_pCompactDump;
+		sCompactDump::sChunk *pChunk = pDump->pFill;
+		pDump->pFill = NULL;
+		pChunk->pNext = NULL;
 
-		// Lock the thread writes
-		m_ContThreadLock.Lock();
+		// The next chunk defines its stacks again
+		memset(pDump->pStacksSent, 0, ((pDump->uStackBits + 31) / 32) * sizeof(jrs_u32));
 
-		jrs_bool bFileAppend = TRUE;
-		jrs_i8 ContinuousOutputText[512];
+		m_ContDumpLock.Lock();
+		if(pDump->pFullTail)
+			pDump->pFullTail->pNext = pChunk;
+		else
+			pDump->pFull = pChunk;
+		pDump->pFullTail = pChunk;
+		m_ContDumpLock.Unlock();
+	}
 
-		jrs_u8 flags = 0;
-		flags |= pPool->HasNameAndCallstackTracing() ? 1 << 7 : 0;
-		flags |= pPool->HasSentinels() ? 1 << 6 : 0;
+	//  Description:
+	//		Internal only.  Starts a record in the chunk being filled.  The chunk is queued and another started if the largest record does
+	//		not fit.  Writes the tag, the heap or pool id and thread if they changed and the ticks since the previous record.  Stack records
+	//		only get the tag.  m_ContThreadLock must be held.
+	//  See Also:
+	//		CompactDump_EndRecord
+	//  Arguments:
+	//		uType - eContinuousDumpRecord type.
+	//		uId - Heap or pool id.
+	//  Return Value:
+	//      Where to write the rest of the record.  NULL if no chunk could be allocated.
+	//  Summary:
+	//		Starts a record.
+	jrs_u8 *cMemoryManager::CompactDump_BeginRecord(jrs_u32 uType, jrs_u32 uId)
+	{
+		sCompactDump *pDump = m_pCompactDump;
+		if(pDump->pFill && pDump->pFill->uUsed + MemoryManager_CompactDumpRecordMax > pDump->uChunkSize)
+			CompactDump_QueueChunk();
 
-		sLVOperation op;
-		if(eType == eContLog_AllocatePool)
-		{
-			op.type = (jrs_u8)eContLog_AllocatePool | flags;
-			op.address = (jrs_sizet)pAddress;
-			op.sizeofopdata = 0;
-			op.alignment = pPool->GetAllocationSize();
-			op.idofheappool = (jrs_u16)pPool->GetUniqueId();
-			op.extraInfo0 = op.extraInfo1 = op.extraInfo2 = op.extraInfo3 = 0;
+		if(!pDump->pFill && !CompactDump_NewChunk())
+			return NULL;
 
-			if(m_bEnableContinuousDump)
-			{
-				sprintf(ContinuousOutputText, "Pool Alloc; %s; %s; 0x%llx; 0x%x; 0x%x; %s; 0x%llx; 0x%llx; 0x%llx; 0x%llx; 0x%llx; 0x%llx; 0x%llx; 0x%llx\n",
-					pPool->GetName(),
-					pPool->GetHeap()->GetName(),
-					op.address,
-					pPool->GetAllocationSize(),
-					16,
-					"Name",
-					(jrs_u64)0,
-					(jrs_u64)1,
-					(jrs_u64)2,
-					(jrs_u64)3,
-					(jrs_u64)4,
-					(jrs_u64)5,
-					(jrs_u64)6,
-					(jrs_u64)7
-					);
-			}
-		}
-		else if(eType == eContLog_FreePool)
-		{
-			op.type = (jrs_u8)eContLog_FreePool | flags;
-			op.address = (jrs_sizet)pAddress;
-			op.sizeofopdata = 0;
-			op.alignment = pPool->GetAllocationSize();
-			op.idofheappool = (jrs_u16)pPool->GetUniqueId();
-			op.extraInfo0 = op.extraInfo1 = op.extraInfo2 = op.extraInfo3 = 0;
+		jrs_u8 *pOut = (jrs_u8 *)(pDump->pFill + 1) + pDump->pFill->uUsed;
+		jrs_u8 *pTag = pOut++;
+		*pTag = (jrs_u8)uType;
+		if(uType == eContinuousDumpRecord_Stack)
+			return pOut;
 
-			if(m_bEnableContinuousDump)
-			{
-				sprintf(ContinuousOutputText, "Pool Free; %s; %s; 0x%llx; 0x%x; 0x%x; %s; 0x%llx; 0x%llx; 0x%llx; 0x%llx; 0x%llx; 0x%llx; 0x%llx; 0x%llx\n",
-					pPool->GetName(),
-					pPool->GetHeap()->GetName(),
-					op.address,
-					pPool->GetAllocationSize(),
-					16,
-					"Name",
-					(jrs_u64)0,
-					(jrs_u64)1,
-					(jrs_u64)2,
-					(jrs_u64)3,
-					(jrs_u64)4,
-					(jrs_u64)5,
-					(jrs_u64)6,
-					(jrs_u64)7
-					);
-			}
-		}
-		else 
+		if(uId != pDump->uLastId)
 		{
-			MemoryWarning(0, JRSMEMORYERROR_UNKNOWNWARNING, "Wrong type for ContinuousLogging_PoolOperation.");
+			*pTag |= ContinuousDump_TagHasId;
+			pOut = CompactDumpWriteVarint(pOut, uId);
+			pDump->uLastId = uId;
 		}
 
-		// Add the data
-		ContinuousLog_AddToBuffer(op, pAddress);
+		jrs_u64 uThread = (jrs_u64)JRSThread::CurrentID();
+		if(uThread != pDump->uLastThread)
+		{
+			*pTag |= ContinuousDump_TagHasThread;
+			pOut = CompactDumpWriteVarint(pOut, uThread);
+			pDump->uLastThread = uThread;
+		}
 
-		// Add the data
-		// Write CSV file if need be
-		if(m_bEnableContinuousDump && m_MemoryManagerFileOutput)
-			m_MemoryManagerFileOutput(ContinuousOutputText, (int)strlen(ContinuousOutputText), m_ContinuousDumpFile, bFileAppend);
+		// Another core's counter can be slightly behind
+		jrs_u64 uTicks = JRSTimer::GetTicks();
+		if(uTicks < pDump->uLastTicks)
+			uTicks = pDump->uLastTicks;
+		pOut = CompactDumpWriteVarint(pOut, uTicks - pDump->uLastTicks);
+		pDump->uLastTicks = uTicks;
 
-		// Unlock the continuous writes
-		m_ContThreadLock.Unlock();
-#endif
+		return pOut;
 	}
 
 	//  Description:
-	//		Internal only.  Reports if the heap can log or not.
+	//		Internal only.  Ends the record started by CompactDump_BeginRecord.  m_ContThreadLock must be held.
 	//  See Also:
-	//		
+	//		CompactDump_BeginRecord
 	//  Arguments:
-	//		pHeap - Heap to check.
+	//		pEnd - Byte after the record.
 	//  Return Value:
 	//      Nothing
-	//  Summary:	
-	//		Checks if the heap can log or not
-	jrs_bool cMemoryManager::ContinuousLog_CanLog(cHeap *pHeap)
+	//  Summary:
+	//		Ends a record.
+	void cMemoryManager::CompactDump_EndRecord(jrs_u8 *pEnd)
 	{
-#ifndef MEMORYMANAGER_MINIMAL
-		// Only if active
-		if(!pHeap->IsLoggingEnabled())
-			return FALSE;
-
-		// Only if continuous data grabbing is enabled or we want continuous output
-		if(!m_bELVContinuousGrab && !m_bEnableContinuousDump)
-			return FALSE;
-#endif
-		return TRUE;
+		sCompactDump::sChunk *pChunk = m_pCompactDump->pFill;
+		pChunk->uUsed = (jrs_u32)(pEnd - (jrs_u8 *)(pChunk + 1));
+		pChunk->uNumRecords++;
 	}
 
 	//  Description:
-	//		Internal only.  Reports if the NI heap can log or not.
+	//		Internal only.  Writes a stack record the first time a stack id is used in the chunk being filled so chunks found through the
+	//		index can resolve their stacks.  m_ContThreadLock must be held.
 	//  See Also:
-	//		
+	//		CompactDump_Record
 	//  Arguments:
-	//		pHeap - Heap to check.
+	//		uStackId - Stack table id.  0 does nothing.
 	//  Return Value:
 	//      Nothing
-	//  Summary:	
-	//		Checks if the NI heap can log or not
-	jrs_bool cMemoryManager::ContinuousLog_CanLog(cHeapNonIntrusive *pHeap)
+	//  Summary:
+	//		Defines a stack id in the compact dump.
+	void cMemoryManager::CompactDump_DefineStack(jrs_u32 uStackId)
 	{
-#ifndef MEMORYMANAGER_MINIMAL
-		// Only if active
-		if(!pHeap->IsLoggingEnabled())
-			return FALSE;
+		sCompactDump *pDump = m_pCompactDump;
+		jrs_u32 uBit = uStackId - 1;
+		if(!uStackId || uBit >= pDump->uStackBits || (pDump->pStacksSent[uBit >> 5] & (1u << (uBit & 31))))
+			return;
 
-		// Only if continuous data grabbing is enabled or we want continuous output
-		if(!m_bELVContinuousGrab && !m_bEnableContinuousDump)
-			return FALSE;
-#endif
-		return TRUE;
+		const jrs_sizet *pCallStack = GetStackFromId(uStackId);
+		jrs_u32 uCount = MemoryManager_StackTableDepth;
+		while(uCount && !pCallStack[uCount - 1])
+			uCount--;
+
+		jrs_u8 *pOut = CompactDump_BeginRecord(eContinuousDumpRecord_Stack, 0);
+		if(!pOut)
+			return;
+
+		pOut = CompactDumpWriteVarint(pOut, uStackId);
+		pOut = CompactDumpWriteVarint(pOut, uCount);
+		jrs_u64 uLastFrame = 0;
+		for(jrs_u32 i = 0; i < uCount; i++)
+			pOut = CompactDumpWriteDelta(pOut, (jrs_u64)MemoryManagerPlatformAddressToBaseAddress(pCallStack[i]), uLastFrame);
+		CompactDump_EndRecord(pOut);
+
+		pDump->pStacksSent[uBit >> 5] |= 1u << (uBit & 31);
 	}
 
 	//  Description:
-	//		Internal only.  This function add data to the internal ring buffer of operations to be transmitted.  This specific function deals with 
-	//		the heap operations.
+	//		Internal only.  Writes an allocation, free, resize, destroy or marker record to the compact dump.  Values the type does not use
+	//		are ignored.  m_ContThreadLock must be held.
 	//  See Also:
-	//		
+	//		CompactDump_CreateRecord
 	//  Arguments:
-	//		eType - Type of Logging operation.
-	//		pHeap - Heap pointer.
-	//		pPool - Pool pointer base.
-	//		uMisc - Misc information.
+	//		eType - Type of logging operation.
+	//		uId - Heap or pool id.
+	//		uAddress - Address of the allocation.
+	//		uSize - Size of the allocation or new size of the heap.
+	//		uAlignment - Alignment of the allocation.
+	//		uStackId - Stack table id of the allocation.  0 for none.
+	//		pName - Name of the allocation or marker.  NULL for none.
 	//  Return Value:
 	//      Nothing
-	//  Summary:	
-	//		Reports any operations that occur on a specific heap.  These cover Allocations, Frees and Reallocs.  Reallocs may not always show.
-	void cMemoryManager::ContinuousLogging_Operation(eContLog eType, cHeap *pHeap, cPoolBase *pPool, jrs_u64 uMisc)
+	//  Summary:
+	//		Writes a record to the compact dump.
+	void cMemoryManager::CompactDump_Record(eContLog eType, jrs_u32 uId, jrs_u64 uAddress, jrs_u64 uSize, jrs_u32 uAlignment, jrs_u32 uStackId, const jrs_i8 *pName)
 	{
-#ifndef MEMORYMANAGER_MINIMAL
-		// Only if active - we ignore the heap here and only care about if we should be logging or not
-		if(!m_bELVContinuousGrab && !m_bEnableContinuousDump)
+		sCompactDump *pDump = m_pCompactDump;
+		if(!pDump->bStarted)
 			return;
 
-		// Lock the thread writes
-		m_ContThreadLock.Lock();
+		// The stack and the allocation using it must land in the same chunk
+		jrs_bool bAllocate = eType == eContLog_Allocate || eType == eContLog_AllocatePool;
+		if(bAllocate)
+		{
+			if(uStackId && pDump->pFill && pDump->pFill->uUsed + 2 * MemoryManager_CompactDumpRecordMax > pDump->uChunkSize)
+				CompactDump_QueueChunk();
+			CompactDump_DefineStack(uStackId);
+		}
 
-		jrs_bool bFileAppend = TRUE;
-		jrs_i8 ContinuousOutputText[512];
+		jrs_u8 *pOut = CompactDump_BeginRecord(eType, uId);
+		if(!pOut)
+			return;
 
-		sLVOperation op;
-		op.type = (jrs_u8)eType;
-		op.address = 0;
-		op.sizeofopdata = 32;
-		op.alignment = 0;
-		op.extraInfo0 = op.extraInfo1 = op.extraInfo2 = op.extraInfo3 = 0;
-		if(eType == eContLog_CreateHeap || eType == eContLog_DestroyHeap || eType == eContLog_ResizeHeap)
-		{	
-			struct LVOpHeapInformation
-			{
-				jrs_u64 uSize;				// 0
-				jrs_u32 uDefaultAlignment;  // 8
-				jrs_u32 uMinAllocSize;		// 12
-				jrs_u32 uMaxAllocSize;		// 16
-				jrs_u32 uPad1;				// 20
-				jrs_u32 uPad2;				// 24
-				jrs_u32 uFlags;				// 28
-			};
+		if(bAllocate || eType == eContLog_Free || eType == eContLog_FreePool)
+			pOut = CompactDumpWriteDelta(pOut, uAddress, pDump->uLastAddress);
+		if(bAllocate || eType == eContLog_Free || eType == eContLog_FreePool || eType == eContLog_ResizeHeap)
+			pOut = CompactDumpWriteVarint(pOut, uSize);
+		if(bAllocate)
+		{
+			pOut = CompactDumpWriteVarint(pOut, uAlignment);
+			pOut = CompactDumpWriteVarint(pOut, uStackId);
+		}
+		if(bAllocate || eType == eContLog_Marker)
+			pOut = CompactDumpWriteName(pOut, pName);
 
-			op.idofheappool = pHeap->GetUniqueId();
-			op.address = (jrs_u64)(pHeap->GetAddress());
+		CompactDump_EndRecord(pOut);
+	}
 
-			LVOpHeapInformation info;
-			info.uSize = pHeap->GetSize();
-			info.uDefaultAlignment = pHeap->GetDefaultAlignment();
-			info.uMinAllocSize = (jrs_u32)pHeap->GetMinAllocationSize();
-			info.uMaxAllocSize = (jrs_u32)pHeap->GetMaxAllocationSize();
-			info.uPad1 = info.uPad2 = 0;
-			info.uFlags = 0;
-#ifdef MEMORYMANAGER_ENABLESENTINELCHECKS
-			info.uFlags |= 1 << 7;
-#endif
-#ifdef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
-			info.uFlags |= 1 << 6;
-#endif
-			ContinuousLog_AddToBuffer(op, &info);
+	//  Description:
+	//		Internal only.  Writes a heap or pool create record to the compact dump.  m_ContThreadLock must be held.
+	//  See Also:
+	//		CompactDump_Record
+	//  Arguments:
+	//		eType - eContLog_CreateHeap or eContLog_CreatePool.
+	//		uId - Heap or pool id.
+	//		uKind - eContinuousDumpKind.
+	//		uParentId - Heap a pool was created in.
+	//		uAddress - Start of the heap or pool memory.
+	//		uSize - Size of the heap or pool.
+	//		uAlignment - Default alignment.
+	//		uMinSize - Minimum allocation size.
+	//		uMaxSize - Maximum allocation size.
+	//		pName - Name of the heap or pool.
+	//  Return Value:
+	//      Nothing
+	//  Summary:
+	//		Writes a create record to the compact dump.
+	void cMemoryManager::CompactDump_CreateRecord(eContLog eType, jrs_u32 uId, jrs_u32 uKind, jrs_u32 uParentId, jrs_u64 uAddress, jrs_u64 uSize, jrs_u32 uAlignment, jrs_u64 uMinSize, jrs_u64 uMaxSize, const jrs_i8 *pName)
+	{
+		sCompactDump *pDump = m_pCompactDump;
+		if(!pDump->bStarted)
+			return;
 
-			if(m_bEnableContinuousDump)
-			{
-				const jrs_i8 *pOp = "Heap Create";
-				if(op.type == eContLog_DestroyHeap)
-				{
-					pOp = "Heap Destroy";
-				}
-				else if(op.type == eContLog_ResizeHeap)
-				{
-					pOp = "Heap Resize";
-				}
+		jrs_u8 *pOut = CompactDump_BeginRecord(eType, uId);
+		if(!pOut)
+			return;
 
-				sprintf(ContinuousOutputText, "%s; %s; 0x%llx; 0x%llx; 0x%x; 0x%x; 0x%x; 0x0; 0x0; 0x0; 0x0; 0x0; 0x0; 0x0\n",
-					pOp,
-					pHeap->GetName(),
-					op.address,
-					info.uSize,
-					info.uDefaultAlignment,
-					info.uMinAllocSize,
-					info.uMaxAllocSize
-					);
-			}
-		}
-		else if(eType == eContLog_CreatePool || eType == eContLog_DestroyPool)
-		{
-			op.idofheappool = 0;
-			struct LVOpPoolInformation
-			{
-				jrs_u64 uSize;				// 8
-				jrs_u32 uDefaultAlignment;  // 12
-				jrs_u32 uAllocSize;			// 16
-				jrs_u32 uPad1;				// 20
-				jrs_u32 uPad2;				// 24
-				jrs_u32 uFlags;				// 28
-			};
+		pOut = CompactDumpWriteVarint(pOut, uKind);
+		pOut = CompactDumpWriteVarint(pOut, uParentId);
+		pOut = CompactDumpWriteDelta(pOut, uAddress, pDump->uLastAddress);
+		pOut = CompactDumpWriteVarint(pOut, uSize);
+		pOut = CompactDumpWriteVarint(pOut, uAlignment);
+		pOut = CompactDumpWriteVarint(pOut, uMinSize);
+		pOut = CompactDumpWriteVarint(pOut, uMaxSize);
+		pOut = CompactDumpWriteName(pOut, pName);
+		CompactDump_EndRecord(pOut);
+	}
 
-			op.idofheappool = (jrs_u16)pPool->GetUniqueId();
-			op.address = (jrs_u64)pPool->GetAddress();
+	//  Description:
+	//		Internal function.  Compact continuous dump writer thread.  Compresses each queued chunk, passes it to the file callback and
+	//		adds it to the chunk index.  Writes the file header before the first chunk of a file and the index and footer after the last.
+	//		Exits once stopped and the queue is empty.
+	//  See Also:
+	//		CreateCompactDump
+	//  Arguments:
+	//		pArg - The compact dump.
+	//  Return Value:
+	//      Nothing
+	//  Summary:
+	//		Compact continuous dump writer thread.
+	cJRSThread::jrs_threadout cMemoryManager::JRSMemory_ContinuousDumpThread(cJRSThread::jrs_threadin pArg)
+	{
+		cMemoryManager &rManager = cMemoryManager::Get();
+		sCompactDump *pDump = (sCompactDump *)((jrs_sizet)pArg);
+		pDump->uWriterThread = JRSThread::CurrentID();
 
-			LVOpPoolInformation info;
-			info.uSize = pPool->GetSize();
-			info.uDefaultAlignment = 0;
-			info.uAllocSize = pPool->GetAllocationSize();
-			info.uFlags = 0;
-			info.uFlags |= pPool->HasNameAndCallstackTracing() ? 1 << 7 : 0;
-			info.uFlags |= pPool->HasSentinels() ? 1 << 6 : 0;
-			ContinuousLog_AddToBuffer(op, &info);
+		for(;;)
+		{
+			jrs_bool bRunning = pDump->bRunning;
+			rManager.m_ContDumpLock.Lock();
+			sCompactDump::sChunk *pChunk = pDump->pFull;
+			if(pChunk)
+			{
+				pDump->pFull = pChunk->pNext;
+				if(!pDump->pFull)
+					pDump->pFullTail = NULL;
+			}
+			rManager.m_ContDumpLock.Unlock();
 
-			if(m_bEnableContinuousDump)
+			if(!pChunk)
 			{
-				const jrs_i8 *pOp = "Pool Create";
-				if(op.type == eContLog_DestroyPool)
-				{
-					pOp = "Pool Destroy";
-				}
+				if(!bRunning)
+					break;
 
-				sprintf(ContinuousOutputText, "%s; %s$$%s; 0x%llx; 0x%llx; 0x%x; 0x0; 0x0; 0x0; 0x0; 0x0; 0x0; 0x0; 0x0; 0x0\n",
-					pOp,
-					pPool->GetName(), pPool->GetHeap()->GetName(),
-					op.address,
-					info.uSize,
-					info.uAllocSize
-					);
+				JRSThread::SleepMilliSecond(2);
+				continue;
 			}
-		}
-		else if(eType == eContLog_Marker)
-		{
-			jrs_i8 text[32];
-			op.idofheappool = eContLog_Marker;
-			jrs_u32 size = (jrs_u32)strlen((jrs_i8 *)pHeap);
-			size = (size >= 31) ? 30 : size;
-			memcpy(text, pHeap, size);
-			text[size] = '\0';
-			ContinuousLog_AddToBuffer(op, text);
 
-			if(m_bEnableContinuousDump)
+			if(pChunk->uFlags & MemoryManager_CompactDumpFirstInFile)
 			{
-				sprintf(ContinuousOutputText, "Marker; %s; 0x0; 0x0; 0x0; 0; 0; 0; 0; 0; 0; 0; 0; 0\n", text);
+				sContinuousDumpFileHeader Header;
+				Header.uMagic = ContinuousDump_FileMagic;
+				Header.uVersion = ContinuousDump_Version;
+				Header.uChunkSize = pDump->uChunkSize;
+				Header.uFlags = sizeof(jrs_sizet) > 4 ? ContinuousDumpFlag_64Bit : 0;
+#ifdef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
+				Header.uFlags |= ContinuousDumpFlag_NameAndStack;
+#endif
+#ifdef MEMORYMANAGER_ENABLESENTINELCHECKS
+				Header.uFlags |= ContinuousDumpFlag_Sentinels;
+#endif
+				Header.uTicksPerSecond = JRSTimer::GetTicksPerSecond();
+				Header.uStartTicks = pChunk->uStartTicks;
+				Header.uBaseAddress = g_uBaseAddressOffsetCalculation;
+				if(m_MemoryManagerFileOutput)
+					m_MemoryManagerFileOutput(&Header, sizeof(Header), rManager.m_ContinuousDumpFile, FALSE);
+
+				pDump->uFileOffset = sizeof(Header);
+				pDump->uNumIndex = 0;
 			}
-		}
-		else if(eType == eContLog_StartLogging || eType == eContLog_StopLogging)
-		{
-			op.idofheappool = 0;
-			ContinuousLog_AddToBuffer(op, NULL);
 
-			if(m_bEnableContinuousDump)
+			if(pChunk->uUsed)
 			{
-				if(eType == eContLog_StartLogging)
+				// Header and data go out in one call.  Chunks that do not compress are stored.
+				sContinuousDumpChunkHeader *pHeader = (sContinuousDumpChunkHeader *)pDump->pOutput;
+				jrs_u8 *pData = (jrs_u8 *)(pHeader + 1);
+				pHeader->uMagic = ContinuousDump_ChunkMagic;
+				pHeader->uRawSize = pChunk->uUsed;
+				pHeader->uNumRecords = pChunk->uNumRecords;
+				pHeader->uFirstTicks = pChunk->uFirstTicks;
+				pHeader->uCompressedSize = CompactDumpCompress((jrs_u8 *)(pChunk + 1), pChunk->uUsed, pData, pChunk->uUsed - 1, pDump->pHashTable);
+				if(!pHeader->uCompressedSize)
+					memcpy(pData, pChunk + 1, pChunk->uUsed);
+
+				jrs_u32 uWriteSize = sizeof(sContinuousDumpChunkHeader) + (pHeader->uCompressedSize ? pHeader->uCompressedSize : pChunk->uUsed);
+				if(m_MemoryManagerFileOutput)
+					m_MemoryManagerFileOutput(pDump->pOutput, (int)uWriteSize, rManager.m_ContinuousDumpFile, TRUE);
+
+				// Grow the index by doubling.  Without memory the chunk is still written but cannot be found from the index.
+				if(pDump->uNumIndex == pDump->uMaxIndex)
 				{
-					bFileAppend = false;
-					sprintf(ContinuousOutputText, "Logging Started; %d; 0x%llx; %d; %d; ; ; ; ; ; ; ; ; 0\n", 
-#ifdef JRS64BIT
-						1,
-#else
-						0,
-#endif
-						g_uBaseAddressOffsetCalculation, 
-#ifdef JRSMEMORYMICROSOFTPLATFORMS
-						0,
-#else
-						1,
-#endif
-						this->m_bResizeable ? 1 : 0
-						);
+					jrs_u32 uMaxIndex = pDump->uMaxIndex ? pDump->uMaxIndex * 2 : 256;
+					sContinuousDumpIndexEntry *pIndex = (sContinuousDumpIndexEntry *)m_MemoryManagerDefaultAllocator(uMaxIndex * sizeof(sContinuousDumpIndexEntry), NULL);
+					if(pIndex)
+					{
+						if(pDump->pIndex)
+						{
+							memcpy(pIndex, pDump->pIndex, pDump->uNumIndex * sizeof(sContinuousDumpIndexEntry));
+							m_MemoryManagerDefaultFree(pDump->pIndex, pDump->uMaxIndex * sizeof(sContinuousDumpIndexEntry));
+						}
+						pDump->pIndex = pIndex;
+						pDump->uMaxIndex = uMaxIndex;
+					}
 				}
-				else
+
+				if(pDump->uNumIndex < pDump->uMaxIndex)
 				{
-					m_ContThreadLock.Unlock();
-					return;
+					sContinuousDumpIndexEntry &rEntry = pDump->pIndex[pDump->uNumIndex++];
+					rEntry.uOffset = pDump->uFileOffset;
+					rEntry.uFirstTicks = pChunk->uFirstTicks;
+					rEntry.uNumRecords = pChunk->uNumRecords;
+					rEntry.uPad = 0;
+				}
+				pDump->uFileOffset += uWriteSize;
+			}
+
+			if(pChunk->uFlags & MemoryManager_CompactDumpLastInFile)
+			{
+				sContinuousDumpFooter Footer;
+				Footer.uIndexOffset = pDump->uFileOffset;
+				Footer.uNumChunks = pDump->uNumIndex;
+				Footer.uMagic = ContinuousDump_FooterMagic;
+				if(m_MemoryManagerFileOutput)
+				{
+					if(pDump->uNumIndex)
+						m_MemoryManagerFileOutput(pDump->pIndex, pDump->uNumIndex * sizeof(sContinuousDumpIndexEntry), rManager.m_ContinuousDumpFile, TRUE);
+					m_MemoryManagerFileOutput(&Footer, sizeof(Footer), rManager.m_ContinuousDumpFile, TRUE);
 				}
 			}
+
+			rManager.m_ContDumpLock.Lock();
+			pChunk->pNext = pDump->pFree;
+			pDump->pFree = pChunk;
+			rManager.m_ContDumpLock.Unlock();
 		}
-		else 
+
+		JRSThreadReturn(1);
+	}
+	//  Description:
+	//		Clears a statistics page entry and fills in what identifies it.  The name is cut to fit.
+	//  See Also:
+	//		UpdateStatsPage
+	//  Arguments:
+	//		rEntry - Entry to fill.
+	//		uId - Heap or pool unique id.
+	//		uKind - eStatsPageKind.
+	//		uParentId - Id of the heap a pool is attached to.
+	//		pName - Name of the heap or pool.
+	//  Return Value:
+	//      Nothing
+	//  Summary:
+	//		Starts a statistics page entry.
+	static void StatsPageStartEntry(sStatsPageEntry &rEntry, jrs_u32 uId, jrs_u32 uKind, jrs_u32 uParentId, const jrs_i8 *pName)
+	{
+		memset(&rEntry, 0, sizeof(sStatsPageEntry));
+		rEntry.uId = uId;
+		rEntry.uKind = uKind;
+		rEntry.uParentId = uParentId;
+		if(pName)
 		{
-			MemoryWarning(0, JRSMEMORYERROR_UNKNOWNWARNING, "Wrong type for ContinuousLogging_Operation.");
+			jrs_sizet uLength = strlen(pName);
+			if(uLength > StatsPage_MaxName - 1)
+				uLength = StatsPage_MaxName - 1;
+			memcpy(rEntry.Name, pName, uLength);
+			rEntry.Name[uLength] = 0;
 		}
+	}
 
-		// Add the data
-		// Write CSV file if need be
-		if(m_bEnableContinuousDump && m_MemoryManagerFileOutput)
-			m_MemoryManagerFileOutput(ContinuousOutputText, (int)strlen(ContinuousOutputText), m_ContinuousDumpFile, bFileAppend);
+	//  Description:
+	//		Finds an entry published by the last update.  Entries rarely move so the same position is tried first.
+	//  See Also:
+	//		UpdateStatsPage
+	//  Arguments:
+	//		pEntries - Published entries.
+	//		uNumEntries - Number of published entries.
+	//		uHint - Position to try first.
+	//		uKind - eStatsPageKind.
+	//		uId - Heap or pool unique id.
+	//  Return Value:
+	//      The entry or NULL if it was not published.
+	//  Summary:
+	//		Finds a published statistics page entry.
+	static const sStatsPageEntry *StatsPageFindEntry(const sStatsPageEntry *pEntries, jrs_u32 uNumEntries, jrs_u32 uHint, jrs_u32 uKind, jrs_u32 uId)
+	{
+		if(uHint < uNumEntries && pEntries[uHint].uKind == uKind && pEntries[uHint].uId == uId)
+			return &pEntries[uHint];
 
-		// Unlock the continuous writes
-		m_ContThreadLock.Unlock();
-#endif
+		for(jrs_u32 i = 0; i < uNumEntries; i++)
+		{
+			if(pEntries[i].uKind == uKind && pEntries[i].uId == uId)
+				return &pEntries[i];
+		}
+
+		return NULL;
 	}
 
 	//  Description:
-	//		Internal only.  This function add data to the internal ring buffer of operations to be transmitted.  This specific function deals with 
-	//		the heap operations.
+	//		Creates the shared statistics page named by InitializeStatsPage, publishes the heaps once and starts the thread that keeps it up
+	//		to date.  Called by Initialize.  Private.
 	//  See Also:
-	//		
+	//		InitializeStatsPage, DestroyStatsPage, UpdateStatsPage
 	//  Arguments:
-	//		eType - Type of Logging operation.
-	//		pHeap - Heap pointer.
-	//		pPool - Pool pointer base.
-	//		uMisc - Misc information.
+	//		None
+	//  Return Value:
+	//      TRUE if the page exists.
+	//		FALSE if the shared memory or the private copy could not be allocated.
+	//  Summary:
+	//		Creates the shared statistics page.
+	jrs_bool cMemoryManager::CreateStatsPage(void)
+	{
+		jrs_sizet uSystemPage = MemoryManagerSystemPageSize();
+		jrs_sizet uPageSize = sizeof(sStatsPageHeader) + (jrs_sizet)m_uStatsPageMaxEntries * sizeof(sStatsPageEntry);
+		uPageSize = (uPageSize + uSystemPage - 1) & ~(uSystemPage - 1);
+		sStatsPageHeader *pHeader = (sStatsPageHeader *)MemoryManagerPlatformCreateSharedPage(m_StatsPageName, uPageSize);
+		if(!pHeader)
+			return false;
+
+		jrs_u64 uBlockSize = sizeof(sStatsPage) + (jrs_u64)m_uStatsPageMaxEntries * (sizeof(sStatsPageEntry) + sizeof(sStatsPage::sHeapRef));
+		sStatsPage *pPage = (sStatsPage *)m_MemoryManagerDefaultAllocator(uBlockSize, NULL);
+		if(!pPage)
+		{
+			MemoryManagerPlatformDestroySharedPage(m_StatsPageName, pHeader, uPageSize);
+			return false;
+		}
+
+		memset(pPage, 0, sizeof(sStatsPage));
+		pPage->pHeader = pHeader;
+		pPage->pEntries = (sStatsPageEntry *)(pHeader + 1);
+		pPage->uPageSize = uPageSize;
+		pPage->uBlockSize = uBlockSize;
+		pPage->pGather = (sStatsPageEntry *)(pPage + 1);
+		pPage->pHeaps = (sStatsPage::sHeapRef *)(pPage->pGather + m_uStatsPageMaxEntries);
+		pPage->uMaxEntries = m_uStatsPageMaxEntries;
+		pPage->uUpdateMS = m_uStatsPageUpdateMS;
+
+		// The page starts zeroed.  The magic goes in last so readers never accept a partial header.
+		pHeader->uVersion = StatsPage_Version;
+		pHeader->uHeaderSize = sizeof(sStatsPageHeader);
+		pHeader->uEntrySize = sizeof(sStatsPageEntry);
+		pHeader->uMaxEntries = m_uStatsPageMaxEntries;
+		pHeader->uUpdateMS = m_uStatsPageUpdateMS;
+		pHeader->uTicksPerSecond = JRSTimer::GetTicksPerSecond();
+		JRSMemoryBarrier();
+		pHeader->uMagic = StatsPage_Magic;
+
+		m_pStatsPage = pPage;
+		UpdateStatsPage();
+
+		if(pPage->uUpdateMS)
+		{
+			pPage->bRunning = TRUE;
+			g_MemoryManagerStatsPageThread.Create(JRSMemory_StatsPageThread, pPage, cJRSThread::eJRSPriority_Low, 4, 32 * 1024);
+			g_MemoryManagerStatsPageThread.Start();
+		}
+
+		return true;
+	}
+
+	//  Description:
+	//		Stops the publisher thread, removes the shared statistics page and frees the private copy.  Called by Destroy before the heaps
+	//		are destroyed.  Private.
+	//  See Also:
+	//		CreateStatsPage
+	//  Arguments:
+	//		None
 	//  Return Value:
 	//      Nothing
-	//  Summary:	
-	//		Reports any operations that occur on a specific heap.  These cover Allocations, Frees and Reallocs.  Reallocs may not always show.
-	void cMemoryManager::ContinuousLogging_NIOperation(eContLog eType, cHeapNonIntrusive *pHeap, cPoolBase *pPool, jrs_u64 uMisc)
+	//  Summary:
+	//		Removes the shared statistics page.
+	void cMemoryManager::DestroyStatsPage(void)
 	{
-#ifndef MEMORYMANAGER_MINIMAL
-		// Only if active - we ignore the heap here and only care about if we should be logging or not
-		if(!m_bELVContinuousGrab && !m_bEnableContinuousDump)
+		sStatsPage *pPage = m_pStatsPage;
+		if(!pPage)
 			return;
 
-		// Lock the thread writes
-		m_ContThreadLock.Lock();
+		if(pPage->bRunning)
+		{
+			pPage->bRunning = FALSE;
+			g_MemoryManagerStatsPageThread.Destroy();
+		}
 
-		jrs_bool bFileAppend = TRUE;
-		jrs_i8 ContinuousOutputText[512];
+		// Waits for any update in another thread to finish
+		m_StatsPageLock.Lock();
+		m_pStatsPage = NULL;
+		m_StatsPageLock.Unlock();
 
-		sLVOperation op;
-		op.type = (jrs_u8)eType;
-		op.address = 0;
-		op.sizeofopdata = 32;
-		op.alignment = 0;
-		op.extraInfo0 = op.extraInfo1 = op.extraInfo2 = op.extraInfo3 = 0;
-		if(eType == eContLog_CreateHeap || eType == eContLog_DestroyHeap || eType == eContLog_ResizeHeap)
-		{	
-			struct LVOpHeapInformation
+		MemoryManagerPlatformDestroySharedPage(m_StatsPageName, pPage->pHeader, pPage->uPageSize);
+		m_MemoryManagerDefaultFree(pPage, pPage->uBlockSize);
+	}
+
+	//  Description:
+	//		Publishes the current heap, pool and non intrusive heap statistics to the shared statistics page.  The publisher thread calls
+	//		this every update period but it may also be called directly, for example at the end of a frame when the period is 0.  Each heap
+	//		is locked in turn while it is read.  Does nothing if there is no statistics page.
+	//  See Also:
+	//		InitializeStatsPage, StatsPage_Read
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      Nothing
+	//  Summary:
+	//		Publishes the statistics page.
+	void cMemoryManager::UpdateStatsPage(void)
+	{
+		m_StatsPageLock.Lock();
+		sStatsPage *pPage = m_pStatsPage;
+		if(!pPage)
+		{
+			m_StatsPageLock.Unlock();
+			return;
+		}
+
+		// Snapshot the live heaps.  Heap locks come before the manager lock so it is released before they are read.
+		sHeapRegistry *pRegistries[3] = { &m_HeapRegistry, &m_UserHeapRegistry, &m_NIHeapRegistry };
+		jrs_bool bTruncated = FALSE;
+		jrs_u32 uNumHeaps = 0;
+		m_MMThreadLock.Lock();
+		for(jrs_u32 r = 0; r < 3; r++)
+		{
+			sHeapSlot *pSlots = pRegistries[r]->pSlots;
+			for(jrs_u32 i = 0; i < pRegistries[r]->uMaxSlots; i++)
 			{
-				jrs_u64 uSize;				// 0
-				jrs_u32 uDefaultAlignment;  // 8
-				jrs_u32 uMinAllocSize;		// 12
-				jrs_u32 uMaxAllocSize;		// 16
-				jrs_u32 uPad1;				// 20
-				jrs_u32 uPad2;				// 24
-				jrs_u32 uFlags;				// 28
-			};
+				if(!pSlots[i].pHeap)
+					continue;
 
-			op.idofheappool = pHeap->GetUniqueId();
-			op.address = (jrs_u64)(pHeap->GetAddress());
+				if(uNumHeaps == pPage->uMaxEntries)
+				{
+					bTruncated = TRUE;
+					break;
+				}
 
-			LVOpHeapInformation info;
-			info.uSize = pHeap->GetSize();
-			info.uDefaultAlignment = (jrs_u32)pHeap->GetDefaultAlignment();
-			info.uMinAllocSize = (jrs_u32)pHeap->GetMinAllocationSize();
-			info.uMaxAllocSize = (jrs_u32)pHeap->GetMaxAllocationSize();
-			info.uPad1 = info.uPad2 = 0;
-			info.uFlags = 0;
-			
-			if(pHeap->IsMemoryTrackingEnabled())
-				info.uFlags |= 1 << 7;
+				sStatsPage::sHeapRef &rRef = pPage->pHeaps[uNumHeaps++];
+				rRef.pHeap = pSlots[i].pHeap;
+				rRef.uRegistry = r;
+				rRef.uSlot = i;
+			}
+		}
+		m_MMThreadLock.Unlock();
 
-// #ifdef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
-// 			info.uFlags |= 1 << 6;
-// #endif
-			ContinuousLog_AddToBuffer(op, &info);
+		// Gather
+		sStatsPageHeader *pHeader = pPage->pHeader;
+		jrs_u32 uNumEntries = 0;
+		jrs_u32 uFlags = 0;
+		for(jrs_u32 h = 0; h < uNumHeaps; h++)
+		{
+			if(uNumEntries == pPage->uMaxEntries)
+			{
+				bTruncated = TRUE;
+				break;
+			}
 
-			if(m_bEnableContinuousDump)
+			// The slot table may have grown since the snapshot but slot locks never move.  A heap destroyed in the mean time is skipped.
+			sStatsPage::sHeapRef &rRef = pPage->pHeaps[h];
+			sHeapRegistry &rRegistry = *pRegistries[rRef.uRegistry];
+			JRSMemory_ThreadLock *pLock = rRegistry.pSlots[rRef.uSlot].pLock;
+			pLock->Lock();
+			if(rRegistry.pSlots[rRef.uSlot].pHeap != rRef.pHeap)
 			{
-				const jrs_i8 *pOp = "Heap Create";
-				if(op.type == eContLog_DestroyHeap)
-				{
-					pOp = "Heap Destroy";
-				}
-				else if(op.type == eContLog_ResizeHeap)
+				pLock->Unlock();
+				continue;
+			}
+
+			sStatsPageEntry &rEntry = pPage->pGather[uNumEntries++];
+			if(rRef.uRegistry == 2)
+			{
+				cHeapNonIntrusive *pHeap = (cHeapNonIntrusive *)rRef.pHeap;
+				StatsPageStartEntry(rEntry, pHeap->GetUniqueId(), eStatsPageKind_NonIntrusiveHeap, 0, pHeap->GetName());
+				rEntry.uResizeCount = pHeap->m_uNumSlabs ? pHeap->m_uNumSlabs - 1 : 0;
+				rEntry.uSize = pHeap->GetSize();
+				rEntry.uUsed = pHeap->GetMemoryUsed();
+				rEntry.uPeakUsed = pHeap->GetMemoryUsedMaximum();
+				rEntry.uCount = pHeap->GetNumberOfAllocations();
+				rEntry.uPeakCount = pHeap->GetNumberOfAllocationsMaximum();
+				rEntry.uFree = pHeap->GetTotalFreeMemory();
+				rEntry.uLargestFree = pHeap->GetSizeOfLargestFragment();
+				pLock->Unlock();
+				continue;
+			}
+
+			cHeap *pHeap = (cHeap *)rRef.pHeap;
+			StatsPageStartEntry(rEntry, pHeap->GetUniqueId(), eStatsPageKind_Heap, 0, pHeap->GetName());
+			rEntry.uResizeCount = pHeap->GetResizeCount();
+			rEntry.uSize = pHeap->GetSize();
+			rEntry.uUsed = pHeap->GetMemoryUsed();
+			rEntry.uPeakUsed = pHeap->GetMemoryUsedMaximum();
+			rEntry.uCount = pHeap->GetNumberOfAllocations();
+			rEntry.uPeakCount = pHeap->GetNumberOfAllocationsMaximum();
+			rEntry.uFree = pHeap->GetTotalFreeMemory();
+			rEntry.uLargestFree = pHeap->GetSizeOfLargestFragment();
+
+			cHeap::sLatencyHistogram LockWait;
+			if(pHeap->GetLatencyHistogram(cHeap::eLatency_LockWait, &LockWait))
+			{
+				uFlags |= StatsPageFlag_LockStatistics;
+				rEntry.uLockCount = LockWait.uTotal;
+				rEntry.uLockWaitNS = LockWait.uTotalNS;
+				rEntry.uLockWaitMaxNS = LockWait.uMaxNS;
+			}
+
+			// Pools attach and detach under the heap lock.  They keep no peaks so the highest value published so far is used.
+			for(cPoolBase *pPool = pHeap->m_pAttachedPools; pPool; pPool = pPool->m_pNext)
+			{
+				if(uNumEntries == pPage->uMaxEntries)
 				{
-					pOp = "Heap Resize";
+					bTruncated = TRUE;
+					break;
 				}
 
-				sprintf(ContinuousOutputText, "%s; %s; 0x%llx; 0x%llx; 0x%x; 0x%x; 0x%x; 0x0; 0x0; 0x0; 0x0; 0x0; 0x0; 0x0\n",
-					pOp,
-					pHeap->GetName(),
-					op.address,
-					info.uSize,
-					info.uDefaultAlignment,
-					info.uMinAllocSize,
-					info.uMaxAllocSize
-					);
+				sStatsPageEntry &rPoolEntry = pPage->pGather[uNumEntries];
+				StatsPageStartEntry(rPoolEntry, pPool->GetUniqueId(), eStatsPageKind_Pool, pHeap->GetUniqueId(), pPool->GetName());
+				jrs_u64 uElementSize = pPool->GetAllocationSize();
+				jrs_u64 uCount = pPool->GetTotalAllocations();
+				jrs_u64 uMaxCount = pPool->GetMaxAllocations();
+				rPoolEntry.uResizeCount = pPool->GetResizeCount();
+				rPoolEntry.uSize = pPool->GetSize();
+				rPoolEntry.uUsed = uCount * uElementSize;
+				rPoolEntry.uCount = uCount;
+				rPoolEntry.uFree = uMaxCount > uCount ? (uMaxCount - uCount) * uElementSize : 0;
+				rPoolEntry.uLargestFree = uMaxCount > uCount ? uElementSize : 0;
+
+				const sStatsPageEntry *pLast = StatsPageFindEntry(pPage->pEntries, pHeader->uNumEntries, uNumEntries, eStatsPageKind_Pool, rPoolEntry.uId);
+				rPoolEntry.uPeakCount = (pLast && pLast->uPeakCount > uCount) ? pLast->uPeakCount : uCount;
+				rPoolEntry.uPeakUsed = (pLast && pLast->uPeakUsed > rPoolEntry.uUsed) ? pLast->uPeakUsed : rPoolEntry.uUsed;
+				uNumEntries++;
 			}
+
+			pLock->Unlock();
 		}
-		else 
+
+		if(bTruncated)
+			uFlags |= StatsPageFlag_Truncated;
+
+		// Publish
+		pHeader->uSequence++;
+		JRSMemoryBarrier();
+		memcpy(pPage->pEntries, pPage->pGather, uNumEntries * sizeof(sStatsPageEntry));
+		pHeader->uNumEntries = uNumEntries;
+		pHeader->uFlags = uFlags;
+		pHeader->uTicks = JRSTimer::GetTicks();
+		pHeader->uUpdateCount++;
+		JRSMemoryBarrier();
+		pHeader->uSequence++;
+
+		m_StatsPageLock.Unlock();
+	}
+
+	//  Description:
+	//		Statistics page publisher thread.  Calls UpdateStatsPage every update period until DestroyStatsPage stops it.  Sleeps in short
+	//		steps so Destroy is not held up by long periods.
+	//  See Also:
+	//		CreateStatsPage
+	//  Arguments:
+	//		pArg - The statistics page.
+	//  Return Value:
+	//      Nothing
+	//  Summary:
+	//		Statistics page publisher thread.
+	cJRSThread::jrs_threadout cMemoryManager::JRSMemory_StatsPageThread(cJRSThread::jrs_threadin pArg)
+	{
+		cMemoryManager &rManager = cMemoryManager::Get();
+		sStatsPage *pPage = (sStatsPage *)((jrs_sizet)pArg);
+
+		while(pPage->bRunning)
 		{
-			MemoryWarning(0, JRSMEMORYERROR_UNKNOWNWARNING, "Wrong type for ContinuousLogging_Operation.");
-		}
+			for(jrs_u32 uSlept = 0; uSlept < pPage->uUpdateMS && pPage->bRunning; uSlept += 10)
+				JRSThread::SleepMilliSecond(10);
 
-		// Add the data
-		// Write CSV file if need be
-		if(m_bEnableContinuousDump && m_MemoryManagerFileOutput)
-			m_MemoryManagerFileOutput(ContinuousOutputText, (int)strlen(ContinuousOutputText), m_ContinuousDumpFile, bFileAppend);
+			if(pPage->bRunning)
+				rManager.UpdateStatsPage();
+		}
 
-		// Unlock the continuous writes
-		m_ContThreadLock.Unlock();
-#endif
+		JRSThreadReturn(1);
 	}
 }	// Elephant
@@ -70,6 +70,7 @@ Not for disclosure or distribution without Jury Rig Software Ltd's prior written
 #define JRSMEMORYERROR_OUTOFSPACE						JRSMAKEERROR(1, 19)			// Warning - Pool is out of memory.
 #define JRSMEMORYERROR_NOVALIDNIHEAPEXPAND				JRSMAKEERROR(1, 20)			// Warning - Out of slabs.
 #define JRSMEMORYERROR_HEAPSYSTEMALLOCATOR				JRSMAKEERROR(1, 21)			// Warning - System allocator/free/pagesize is invalid
+#define JRSMEMORYERROR_STATSPAGE						JRSMAKEERROR(1, 22)			// Warning - The shared memory statistics page could not be created.
 
 #define JRSMEMORYERROR_CALLEDAFTERINITIALIZE			JRSMAKEERROR(2, 1)			// Potential fatal - Function should be called before Initialize.
 #define JRSMEMORYERROR_INVALIDFILENAME					JRSMAKEERROR(2, 2)			// Potential fatal - Invalid file name for output specified.
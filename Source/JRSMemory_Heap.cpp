@@ -9,11 +9,9 @@
 #include <JRSMemory_Pools.h>
 #include "JRSMemory_Internal.h"
 #include "JRSMemory_ErrorCodes.h"
+#include "JRSMemory_Timer.h"
 
-// Defines to force inlining of some components
-#define HEAP_THREADLOCK if(m_bThreadSafe) { m_pThreadLock->Lock(); }
-#define HEAP_THREADUNLOCK if(m_bThreadSafe) { m_pThreadLock->Unlock(); }
-
+// Defines to force inlining of some components.  HEAP_THREADLOCK comes from JRSMemory_Internal.h.
 #define HEAP_FULLSIZE_CALC(x, min) (x > min ? ((x + 0xf) & ~(0xf)) : min)
 #define HEAP_FULLSIZE(x) HEAP_FULLSIZE_CALC(x, m_uMinAllocSize)
 
@@ -22,6 +20,31 @@ namespace Elephant
 {
 	extern jrs_u64 g_uBaseAddressOffsetCalculation;
 
+	// Latency statistics are split into shards picked by thread id so threads timing operations rarely share cache lines.  The shards
+	// are merged when read.  Two threads can land on the same shard and very occasionally lose a count.
+	static const jrs_u32 MemoryManager_LatencyShardBits = 4;
+	static const jrs_u32 MemoryManager_LatencyShards = 1 << MemoryManager_LatencyShardBits;
+
+	struct cHeap::sLatencyStats
+	{
+		cHeap::sLatencyHistogram Shards[MemoryManager_LatencyShards][cHeap::eLatency_Max];
+		jrs_u64 uTicksPerSecond;
+		jrs_u64 uNSScale;				// Nanoseconds per tick in 48.16 fixed point
+		jrs_u64 uLockTicks;				// Time the lock was taken at depth 0
+		jrs_u32 uLockDepth;				// Depth of the recursive lock.  Only changed with the lock held.
+	};
+
+	// Times a heap operation for its scope when latency statistics are enabled.
+	struct cHeap::sLatencyScope
+	{
+		const cHeap *m_pHeap;
+		jrs_u32 m_uOp;
+		jrs_u64 m_uStart;
+
+		sLatencyScope(const cHeap *pHeap, jrs_u32 uOp) : m_pHeap(pHeap), m_uOp(uOp), m_uStart(pHeap->m_bLatencyStats ? JRSTimer::GetTicks() : 0) {}
+		~sLatencyScope() { if(m_uStart) m_pHeap->RecordLatency(m_uOp, JRSTimer::GetTicks() - m_uStart); }
+	};
+
 	//  Description:
 	//		cHeap constructor.  Private and should not be called.  Use CreateHeap to create a heap.
 	//  See Also:
@@ -77,16 +100,25 @@ namespace Elephant
 		m_bThreadSafe = pHeapDetails->bThreadSafe;
 		if(cMemoryManager::Get().m_bEnableLiveView || cMemoryManager::Get().m_bEnhancedDebugging)
 			m_bThreadSafe = true;
+		m_uRegistrySlot = MemoryManager_InvalidHeapSlot;
+		m_pScratchRegion = NULL;
+		m_uScratchRegionSize = 0;
 
 		// Default callstack depth.
 		m_uCallstackDepth = 2;
 
 		// Clear some blocks
 		m_pAllocList = 0;
+		m_uGeneration = 0;
+		m_uSnapshotId = 0;
+		m_pSnapshotNext = NULL;
 
 		// Now we set up one giant free block.
 		InitializeMainFreeBlock();
 
+		// Nothing is known to be zero until the memory manager says so
+		m_pZeroMemoryStart = m_pZeroMemoryEnd = m_pHeapStartAddress;
+
 		// Other defaults
 		m_uDefaultAlignment = pHeapDetails->uDefaultAlignment;		
 		m_bUseEndAllocationOnly = pHeapDetails->bUseEndAllocationOnly;
@@ -134,6 +166,7 @@ namespace Elephant
 		m_pResizableLink = NULL;
 		m_uReclaimSize = pHeapDetails->uReclaimSize < m_uResizableSizeMin ? m_uResizableSizeMin : pHeapDetails->uReclaimSize;
 		m_bAllowResizeReclaimation = pHeapDetails->bAllowResizeReclaimation;
+		m_uResizeCount = 0;
 
 		m_uDebugFlags = 0;
 		m_uDebugTrapOnFreeNum = 0;
@@ -141,12 +174,22 @@ namespace Elephant
 
 		// Pools
 		m_pAttachedPools = NULL;
+		m_pPoolRanges = NULL;
+		m_uPoolRangeSequence = 0;
 
-		// Enable logging in this heap for warnings
-		m_bEnableReportsInErrors = true;
+		// Size class pools.  Each class is a multiple of the default alignment.
+		m_uNumSizeClasses = pHeapDetails->uSizeClassPoolMax / m_uDefaultAlignment;
+		if(m_uNumSizeClasses > m_uMaxSizeClasses)
+			m_uNumSizeClasses = m_uMaxSizeClasses;
+		m_uSizeClassPoolElements = pHeapDetails->uSizeClassPoolElements ? pHeapDetails->uSizeClassPoolElements : 1;
+		memset(m_pSizeClassPools, 0, sizeof(m_pSizeClassPools));
 
-		// Log us some info
-		cMemoryManager::Get().ContinuousLogging_Operation(cMemoryManager::eContLog_CreateHeap, this, NULL, 0);
+		// Latency statistics
+		m_pLatencyStats = NULL;
+		m_bLatencyStats = pHeapDetails->bEnableLatencyStatistics && CreateLatencyStatistics();
+
+		// Enable logging in this heap for warnings.  The creation is logged by the memory manager once the heap has its id.
+		m_bEnableReportsInErrors = true;
 	}
 
 	//  Description:
@@ -187,6 +230,8 @@ namespace Elephant
 	//      Allocates memory with additional information.
 	void *cHeap::AllocateMemory(jrs_sizet uSize, jrs_u32 uAlignment, jrs_u32 uFlag, const jrs_i8 *pName, const jrs_u32 uExternalId)
 	{
+		sLatencyScope latency(this, eLatency_Allocate);
+
 #ifndef MEMORYMANAGER_MINIMAL
 		if(!cMemoryManager::Get().IsInitialized())
 		{
@@ -230,6 +275,28 @@ namespace Elephant
 			}
 		}
 
+		// Small allocations with default alignment are served by the size class pools.  Pool allocations themselves never are.
+		if(uSize && uSize <= m_uNumSizeClasses * m_uDefaultAlignment && uAlignment == m_uDefaultAlignment && uFlag != JRSMEMORYFLAG_POOL && uFlag != JRSMEMORYFLAG_POOLMEM)
+		{
+			jrs_u32 uSizeClass = (jrs_u32)((uSize - 1) / m_uDefaultAlignment);
+			cPool *pPool = m_pSizeClassPools[uSizeClass];
+			if(!pPool)
+				pPool = CreateSizeClassPool(uSizeClass);
+
+			// Failure falls through to the heap
+			void *pAllocation = pPool ? pPool->AllocateMemory(pName) : NULL;
+			if(pAllocation)
+			{
+				if(m_bHeapClearing)
+					memset(pAllocation, m_uHeapAllocClearValue, pPool->GetAllocationSize());
+
+				if(cMemoryManager::Get().m_pSampler)
+					cMemoryManager::Get().SampleAllocation(pAllocation, uSize);
+
+				return pAllocation;
+			}
+		}
+
 		// We are allocating memory.  Bump the size up to the minimum allowed for the heap.
 		uASize = HEAP_FULLSIZE(uASize);
 
@@ -308,7 +375,7 @@ namespace Elephant
 			strcpy(pNewBlock->Name, "Unknown Allocation");
 		pNewBlock->uExternalId = uExternalId;
 		pNewBlock->uHeapId = m_uHeapId;
-		cMemoryManager::Get().StackTrace(pNewBlock->uCallsStack, m_uCallstackDepth, JRSMEMORY_CALLSTACKDEPTH);
+		pNewBlock->uStackId = cMemoryManager::Get().StackTraceId(m_uCallstackDepth, JRSMEMORY_CALLSTACKDEPTH);
 #endif
 		if(m_bEnableLogging)
 		{
@@ -327,10 +394,114 @@ namespace Elephant
 			memset(pAllocation, m_uHeapAllocClearValue, HEAP_FULLSIZE(pNewBlock->uSize));
 		}		
 
+		// Pool memory is profiled per allocation made from the pool
+		if(cMemoryManager::Get().m_pSampler && uFlag != JRSMEMORYFLAG_POOL && uFlag != JRSMEMORYFLAG_POOLMEM)
+			cMemoryManager::Get().SampleAllocation(pAllocation, uSize);
+
 		// Return the correct address
 		return pAllocation;
 	}
 
+	//  Description:
+	//		Allocates memory cleared to zero.  Memory above the main free block that has not been touched since it came from a system allocator
+	//		returning zero filled pages is not cleared again.  Everything else is cleared as normal.  See AllocateMemory for the arguments.
+	//  See Also:
+	//		AllocateMemory, cMemoryManager::Calloc
+	//  Arguments:
+	//      uSize - Size in bytes.
+	//		uAlignment - Alignment or 0 for the heap default.
+	//		uFlag - One of JRSMEMORYFLAG_xxx or user defined value.  Default JRSMEMORYFLAG_NONE.
+	//		pName - NULL terminating text string to associate with the allocation. May be NULL.
+	//		uExternalId - An identifier to associate with the allocation.
+	//  Return Value:
+	//      Valid pointer to zero filled memory.
+	//		NULL otherwise.
+	//  Summary:
+	//      Allocates zero filled memory.
+	void *cHeap::AllocateZeroed(jrs_sizet uSize, jrs_u32 uAlignment, jrs_u32 uFlag, const jrs_i8 *pName, const jrs_u32 uExternalId)
+	{
+		HEAP_THREADLOCK
+
+		// The allocation can only be carved from the untouched range as it stands now
+		jrs_i8 *pZeroStart = m_pZeroMemoryStart;
+		jrs_i8 *pZeroEnd = m_pZeroMemoryEnd;
+
+		jrs_i8 *pAllocation = (jrs_i8 *)AllocateMemory(uSize, uAlignment, uFlag, pName, uExternalId);
+
+		HEAP_THREADUNLOCK
+
+		// Heap clearing has already filled it
+		if(!pAllocation || (m_bHeapClearing && !m_uHeapAllocClearValue))
+			return pAllocation;
+
+		// Size class pools write their free lists into new chunks so only whole blocks can use the range
+		if(m_bHeapClearing || uSize <= m_uNumSizeClasses * m_uDefaultAlignment || pZeroStart >= pZeroEnd)
+		{
+			memset(pAllocation, 0, uSize);
+			return pAllocation;
+		}
+
+		// Clear only what lies outside the untouched range
+		jrs_i8 *pEnd = pAllocation + uSize;
+		if(pAllocation < pZeroStart)
+			memset(pAllocation, 0, (jrs_sizet)((pEnd < pZeroStart ? pEnd : pZeroStart) - pAllocation));
+		if(pEnd > pZeroEnd)
+		{
+			jrs_i8 *pStart = pAllocation > pZeroEnd ? pAllocation : pZeroEnd;
+			memset(pStart, 0, (jrs_sizet)(pEnd - pStart));
+		}
+
+		return pAllocation;
+	}
+
+	//  Description:
+	//		Adds memory fresh from a zero filling system allocator to the untouched range.  The memory must end the heap.  It joins the range
+	//		if it follows on from it and replaces it otherwise.  Private.
+	//  See Also:
+	//		AllocateZeroed, UpdateZeroMemory
+	//  Arguments:
+	//      pStart - Start of the zero filled memory.
+	//		pEnd - End of the zero filled memory.
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Adds zero filled memory to the untouched range.
+	void cHeap::AddZeroMemory(jrs_i8 *pStart, jrs_i8 *pEnd)
+	{
+		HEAP_THREADLOCK
+
+		if(pEnd == m_pHeapEndAddress + sizeof(sFreeBlock))
+		{
+			if(m_pZeroMemoryEnd != pStart || m_pZeroMemoryStart >= m_pZeroMemoryEnd)
+				m_pZeroMemoryStart = pStart;
+			m_pZeroMemoryEnd = pEnd;
+			UpdateZeroMemory();
+		}
+
+		HEAP_THREADUNLOCK
+	}
+
+	//  Description:
+	//		Shrinks the untouched range after the main free block moves up or the heap end moves down.  The main free block header and
+	//		anything below it may have been written.  Private.
+	//  See Also:
+	//		AddZeroMemory
+	//  Arguments:
+	//      None
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Clamps the untouched range to the main free block.
+	void cHeap::UpdateZeroMemory(void)
+	{
+		jrs_i8 *pFreeStart = (jrs_i8 *)m_pMainFreeBlock + sizeof(sFreeBlock);
+		jrs_i8 *pFreeEnd = m_pHeapEndAddress + sizeof(sFreeBlock);
+		if(m_pZeroMemoryStart < pFreeStart)
+			m_pZeroMemoryStart = pFreeStart;
+		if(m_pZeroMemoryEnd > pFreeEnd)
+			m_pZeroMemoryEnd = pFreeEnd;
+	}
+
 	//  Description:
 	//		Reallocates memory.  Generally should be avoided if at all possible as most of the time it will just Free and Allocate except
 	//		for some circumstances.  If you are constantly reallocating it is recommended to see if there is a better alternative.
@@ -353,9 +524,10 @@ namespace Elephant
 	//      Allocates memory with additional information.
 	void *cHeap::ReAllocateMemory(void *pMemory, jrs_sizet uSize, jrs_u32 uAlignment, jrs_u32 uFlag, const jrs_i8 *pName, const jrs_u32 uExternalId)
 	{
-		// Note reallocating memory does nothing special atm unless the size fits in the current block.  It simply free's and allocates copying the
-		// data over.  This could be improved coping with the cases where it could be resized in place.  Unfortunately most of the time the block immediately after
-		// is normally (more than 99% of the time) occupied so it has to be reallocated anyway.  
+		sLatencyScope latency(this, eLatency_ReAllocate);
+
+		// Growing is done in place when the free space directly after the block is large enough.  Otherwise it allocates, copies the
+		// used bytes over and frees the old block.
 
 		// Null memory can just be allocated through the standard approach
 		if(!pMemory)
@@ -368,6 +540,23 @@ namespace Elephant
 			return 0;
 		}
 
+		// Memory from a size class pool stays put if the new size still fits the element.
+		cPool *pPool = m_uNumSizeClasses ? GetSizeClassPool(pMemory) : NULL;
+		if(pPool)
+		{
+			jrs_sizet uClassSize = pPool->GetAllocationSize();
+			if(uSize <= uClassSize)
+				return pMemory;
+
+			void *pNewMem = AllocateMemory(uSize, uAlignment, uFlag, pName, uExternalId);
+			if(pNewMem)
+			{
+				memcpy(pNewMem, pMemory, uClassSize);
+				pPool->FreeMemory(pMemory, pName);
+			}
+			return pNewMem;
+		}
+
 		// Get the block.
 		sAllocatedBlock *pBlock = (sAllocatedBlock *)((jrs_sizet)pMemory - sizeof(sAllocatedBlock));
 
@@ -384,15 +573,141 @@ namespace Elephant
 		if(HEAP_FULLSIZE(pBlock->uSize) > HEAP_FULLSIZE(uSize))
 			return pMemory;
 
-		// Larger
+#ifndef MEMORYMANAGER_MINIMAL
+		if(m_uMaxAllocSize && HEAP_FULLSIZE(uSize) > m_uMaxAllocSize)
+		{
+			HeapWarning(0, JRSMEMORYERROR_SIZETOLARGE, "Size requested from the heap (%s) is larger than the maximum size allowed (%d bytes)", m_HeapName, m_uMaxAllocSize);
+			return 0;
+		}
+#endif
+
+		// Larger.  Try to take the free space after the block first.  The address cannot change so it must already meet the alignment.
+		if(!uAlignment || !((jrs_sizet)pMemory & (uAlignment - 1)))
+		{
+			HEAP_THREADLOCK
+			jrs_bool bGrown = InternalGrowInPlace(pBlock, uSize);
+			HEAP_THREADUNLOCK
+
+			if(bGrown)
+				return pMemory;
+		}
+
+		// Move it.  The whole old block is copied, clamped to the new size, as the in place paths above do not track the size asked for.
+		jrs_sizet uOldSize = HEAP_FULLSIZE(pBlock->uSize);
+		if(uOldSize > uSize)
+			uOldSize = uSize;
 		void *pNewMem = AllocateMemory(uSize, uAlignment, uFlag, pName, uExternalId);
-		memcpy(pNewMem, pMemory, HEAP_FULLSIZE(pBlock->uSize));
+		if(!pNewMem)
+			return 0;
+
+		memcpy(pNewMem, pMemory, uOldSize);
 		FreeMemory(pMemory, uFlag, pName, uExternalId);
 
 		// Return the new memory
 		return pNewMem;
 	}
 
+	//  Description:
+	//		Grows an allocation into the free space that directly follows it.  The free block after it, or the main free block when it is the
+	//		last allocation, is shortened or removed.  Nothing is changed if there is not enough room.  While a continuous log is
+	//		running the allocation is always moved instead so the log stays a sequence of allocations and frees.  The heap must be locked.
+	//		Internal only.
+	//  See Also:
+	//		ReAllocateMemory
+	//  Arguments:
+	//		pBlock - Allocated block to grow.
+	//		uSize - New size in bytes.  Must be larger than the current size.
+	//  Return Value:
+	//      TRUE if the block was grown.
+	//		FALSE otherwise.
+	//  Summary:
+	//      Grows an allocation without moving it.
+	jrs_bool cHeap::InternalGrowInPlace(sAllocatedBlock *pBlock, jrs_sizet uSize)
+	{
+#ifndef MEMORYMANAGER_MINIMAL
+		if(m_bEnableLogging && cMemoryManager::Get().ContinuousLog_CanLog(this))
+			return false;
+#ifdef MEMORYMANAGER_ENABLESENTINELCHECKS
+		CheckAllocatedBlockSentinels(pBlock);
+#endif
+#endif
+
+		jrs_i8 *pDataEnd = (jrs_i8 *)pBlock + sizeof(sAllocatedBlock) + HEAP_FULLSIZE(pBlock->uSize);
+		jrs_i8 *pNewEnd = (jrs_i8 *)pBlock + sizeof(sAllocatedBlock) + HEAP_FULLSIZE(uSize);
+		if(pNewEnd < pDataEnd)
+			return false;
+
+		sAllocatedBlock *pNext = pBlock->pNext;
+		if(!pNext)
+		{
+			// Last allocation.  The main free block follows it and moves up.
+			if((jrs_i8 *)m_pMainFreeBlock != pDataEnd || pNewEnd > m_pHeapEndAddress)
+				return false;
+
+			// The headers may overlap so work from a copy.
+			sFreeBlock MainFreeBlock = *m_pMainFreeBlock;
+			m_pMainFreeBlock = (sFreeBlock *)pNewEnd;
+			*m_pMainFreeBlock = MainFreeBlock;
+			m_pMainFreeBlock->uSize = (jrs_sizet)(m_pHeapEndAddress - pNewEnd);
+#ifdef MEMORYMANAGER_ENABLESENTINELCHECKS
+			SetSentinelsFreeBlock(m_pMainFreeBlock);
+#endif
+			UpdateZeroMemory();
+		}
+		else
+		{
+			// The space up to the next allocation is either a free block or padding that already belongs to this block.
+			if(pNewEnd > (jrs_i8 *)pNext)
+				return false;
+
+			if((jrs_sizet)((jrs_i8 *)pNext - pDataEnd) >= sizeof(sAllocatedBlock) + m_uMinAllocSize)
+			{
+				sFreeBlock FreeBlock = *(sFreeBlock *)pDataEnd;
+				HeapWarning(FreeBlock.uMarker == MemoryManager_FreeBlockValue, JRSMEMORYERROR_INVALIDFREEBLOCK, "Not a valid free block at 0x%p.  It has probably been corrupted.", pDataEnd);
+				RemoveBinAllocation((sFreeBlock *)pDataEnd);
+
+				// Whatever is left becomes a smaller free block if there is room for one.  Otherwise it is padding on the end of this block.
+				jrs_sizet uRemaining = (jrs_sizet)((jrs_i8 *)pNext - pNewEnd);
+				if(uRemaining >= sizeof(sAllocatedBlock) + m_uMinAllocSize)
+				{
+					sFreeBlock *pNewBlock = (sFreeBlock *)pNewEnd;
+					*pNewBlock = FreeBlock;
+
+					sFreeBlock *pFBPrevBin, *pFBNextBin;
+					CreateBinAllocation(uRemaining, pNewBlock, &pFBPrevBin, &pFBNextBin);
+					pNewBlock->pNextBin = pFBNextBin;
+					pNewBlock->pPrevBin = pFBPrevBin;
+					pNewBlock->pPrevAlloc = pBlock;
+					pNewBlock->pNextAlloc = pNext;
+					pNewBlock->uSize = uRemaining;
+
+					// Adjust the bin pointers but only if they don't point to the same block.  This is because we run a circular buffer of pointers
+					if(pFBNextBin && pFBNextBin != pNewBlock)
+					{
+						pFBNextBin->pPrevBin = pNewBlock;
+						pFBPrevBin->pNextBin = pNewBlock;
+					}
+
+#ifdef MEMORYMANAGER_ENABLESENTINELCHECKS
+					SetSentinelsFreeBlock(pNewBlock);
+#endif
+				}
+			}
+		}
+
+		// Clear the new memory if needed
+		if(m_bHeapClearing)
+			memset(pDataEnd, m_uHeapAllocClearValue, (jrs_sizet)(pNewEnd - pDataEnd));
+
+		m_uAllocatedSize += uSize - pBlock->uSize;
+		if(m_uAllocatedSize > m_uAllocatedSizeMax)
+			m_uAllocatedSizeMax = m_uAllocatedSize;
+		pBlock->uSize = uSize;
+		m_uGeneration++;
+
+		return true;
+	}
+
 	//  Description:
 	//		Main memory free function.  Internal only.
 	//  See Also:
@@ -419,6 +734,7 @@ namespace Elephant
 		sAllocatedBlock *pBlock = (sAllocatedBlock *)((jrs_i8*)pMemory - sizeof(sAllocatedBlock));
 		sAllocatedBlock *pPrev = pBlock->pPrev;
 		sAllocatedBlock *pNext = pBlock->pNext;
+		SnapshotRemoveBlock(pBlock, pNext);
 
 		// Clear the new memory if needed
 		if(m_bHeapClearing)
@@ -458,11 +774,11 @@ namespace Elephant
 				strcpy(m_pMainFreeBlock->Name, "Unknown Free");
 			m_pMainFreeBlock->uExternalId = uExternalId;
 			m_pMainFreeBlock->uHeapId = m_uHeapId;
-			cMemoryManager::Get().StackTrace(m_pMainFreeBlock->uCallsStack, m_uCallstackDepth, JRSMEMORY_CALLSTACKDEPTH);
+			m_pMainFreeBlock->uStackId = cMemoryManager::Get().StackTraceId(m_uCallstackDepth, JRSMEMORY_CALLSTACKDEPTH);
 #endif
 			if(m_bEnableLogging)
 			{
-				cMemoryManager::Get().ContinuousLogging_HeapOperation(cMemoryManager::eContLog_Free, this, m_pMainFreeBlock, 0, blocksize);
+				cMemoryManager::Get().ContinuousLogging_HeapOperation(cMemoryManager::eContLog_Free, this, m_pMainFreeBlock, 0, blocksize, pMemory);
 			}
 #endif
 			return;
@@ -713,7 +1029,7 @@ namespace Elephant
 				strcpy(pNewFreeBlock->Name, "Unknown Free");
 			pNewFreeBlock->uExternalId = uExternalId;
 			pNewFreeBlock->uHeapId = m_uHeapId;
-			cMemoryManager::Get().StackTrace(pNewFreeBlock->uCallsStack, m_uCallstackDepth, JRSMEMORY_CALLSTACKDEPTH);
+			pNewFreeBlock->uStackId = cMemoryManager::Get().StackTraceId(m_uCallstackDepth, JRSMEMORY_CALLSTACKDEPTH);
 #endif
 #ifdef MEMORYMANAGER_ENABLESENTINELCHECKS
 			CheckFreeBlockSentinels(pNewFreeBlock);
@@ -722,7 +1038,7 @@ namespace Elephant
 #endif
 			if(m_bEnableLogging)
 			{
-				cMemoryManager::Get().ContinuousLogging_HeapOperation(cMemoryManager::eContLog_Free, this, pNewFreeBlock, 0, blocksize);
+				cMemoryManager::Get().ContinuousLogging_HeapOperation(cMemoryManager::eContLog_Free, this, pNewFreeBlock, 0, blocksize, pMemory);
 			}
 #endif
 
@@ -753,13 +1069,36 @@ namespace Elephant
 	//      Frees memory from within a heap.
 	void cHeap::FreeMemory(void *pMemory, jrs_u32 uFlag, const jrs_i8 *pName, const jrs_u32 uExternalId)
 	{
+		sLatencyScope latency(this, eLatency_Free);
+
 #ifndef MEMORYMANAGER_MINIMAL
 		if(!cMemoryManager::Get().IsInitialized())
 		{
 			HeapWarning(cMemoryManager::Get().IsInitialized(), JRSMEMORYERROR_NOTINITIALIZED, "Elephant is not initialized.");
 			return;
 		}
+#endif
+		if(pMemory && cMemoryManager::Get().m_pSampler)
+			cMemoryManager::Get().RemoveSample(pMemory);
+
+		// Memory from the size class pools goes back to its pool.
+		if(m_uNumSizeClasses && pMemory)
+		{
+			cPool *pPool = GetSizeClassPool(pMemory);
+			if(pPool)
+			{
+				if(IsLocked())
+				{
+					HeapWarning(!IsLocked(), JRSMEMORYERROR_LOCKED, "Heap is locked. You may not free memory.");
+					return;
+				}
+
+				pPool->FreeMemory(pMemory, pName);
+				return;
+			}
+		}
 
+#ifndef MEMORYMANAGER_MINIMAL
 		// Check if the memory address comes from a pool.  If so passing it to the heap could cause problems.
 		if(IsAllocatedFromAttachedPool(pMemory))
 		{
@@ -921,6 +1260,22 @@ namespace Elephant
 		HEAP_THREADUNLOCK
 	}
 
+	//  Description:
+	//		Returns the highest set bit of a bin mask.  Private.
+	//  See Also:
+	//		GetSizeOfLargestFragment
+	//  Arguments:
+	//      uMask - Bin mask.  Must not be 0.
+	//  Return Value:
+	//      Highest non empty bin.
+	//  Summary:
+	//      Returns the highest non empty bin.
+	static jrs_u32 HeapHighestBin(jrs_u64 uMask)
+	{
+		jrs_u32 uHigh = (jrs_u32)(uMask >> 32);
+		return uHigh ? 32 + JRSCountLeadingZero(uHigh) : JRSCountLeadingZero((jrs_u32)uMask);
+	}
+
 	//  Description:
 	//		Determines which Bin to locate the memory from.  Private.
 	//  See Also:
@@ -974,6 +1329,21 @@ namespace Elephant
 		// Get the bin size
 		jrs_sizet uBinSelect = GetBinLookupBasedOnSize(pFreeBlock->uSize);
 
+		// Statistics.  Finding the new largest block is left until it is asked for.
+		jrs_u64 uBinBit = (jrs_u64)1 << uBinSelect;
+		m_uBinFreeSize -= pFreeBlock->uSize;
+		m_uBinFreeBytes[uBinSelect] -= pFreeBlock->uSize;
+		if(!--m_uBinFreeBlocks[uBinSelect])
+		{
+			m_uBinMask &= ~uBinBit;
+			m_uBinMaxDirty &= ~uBinBit;
+			m_uBinMaxSize[uBinSelect] = 0;
+		}
+		else if(pFreeBlock->uSize == m_uBinMaxSize[uBinSelect])
+		{
+			m_uBinMaxDirty |= uBinBit;
+		}
+
 		// We need to totally remove the bins from this if they point to each other making a circular dependency. 
 		if(pFreeBlock->pNextBin == pFreeBlock && pFreeBlock->pNextBin == pFreeBlock->pPrevBin)
 		{
@@ -994,6 +1364,59 @@ namespace Elephant
 		}
 	}
 
+	//  Description:
+	//		Returns the size of the largest free block in a bin.  Walks the bin only if its largest block has left since it was last
+	//		found.  Private.
+	//  See Also:
+	//		RefreshBinMaxSize
+	//  Arguments:
+	//      uBin - Bin to check.
+	//  Return Value:
+	//      Size of the largest block including its header.  0 if the bin is empty.
+	//  Summary:
+	//      Returns the size of the largest free block in a bin.
+	jrs_sizet cHeap::GetLargestBinBlock(jrs_u32 uBin) const
+	{
+		if(!(m_uBinMaxDirty & ((jrs_u64)1 << uBin)))
+			return m_uBinMaxSize[uBin];
+
+		jrs_sizet uMaxSize = 0;
+		sFreeBlock *pBin = m_pBins[uBin];
+		if(pBin)
+		{
+			sFreeBlock *pList = pBin;
+			do
+			{
+				if(pBin->uSize > uMaxSize)
+					uMaxSize = pBin->uSize;
+				pBin = pBin->pNextBin;
+			}
+			while(pBin != pList);
+		}
+
+		return uMaxSize;
+	}
+
+	//  Description:
+	//		Finds the largest free block in a bin again after its previous largest block left so later calls do not walk it.  Private.
+	//  See Also:
+	//		GetLargestBinBlock
+	//  Arguments:
+	//      uBin - Bin to refresh.
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Refreshes the largest free block of a bin.
+	void cHeap::RefreshBinMaxSize(jrs_u32 uBin)
+	{
+		jrs_u64 uBinBit = (jrs_u64)1 << uBin;
+		if(m_uBinMaxDirty & uBinBit)
+		{
+			m_uBinMaxSize[uBin] = GetLargestBinBlock(uBin);
+			m_uBinMaxDirty &= ~uBinBit;
+		}
+	}
+
 	//  Description:
 	//		Creates a bin allocation.  Private.
 	//  See Also:
@@ -1011,6 +1434,14 @@ namespace Elephant
 	{
 		jrs_sizet uBin = GetBinLookupBasedOnSize(uSize);
 
+		// Statistics
+		m_uBinMask |= (jrs_u64)1 << uBin;
+		m_uBinFreeSize += uSize;
+		m_uBinFreeBytes[uBin] += uSize;
+		m_uBinFreeBlocks[uBin]++;
+		if(uSize > m_uBinMaxSize[uBin])
+			m_uBinMaxSize[uBin] = uSize;
+
 		if(m_pBins[uBin])
 		{
 			// Put between this one and the next.
@@ -1196,16 +1627,21 @@ namespace Elephant
 
 		// Resizing the heap.  No need to take the freeblock into account. Could cause problems for the user managed heaps if we did.
 		m_uHeapSize = uSize;
+		m_uResizeCount++;
 		m_pHeapEndAddress = m_pHeapStartAddress + m_uHeapSize - sizeof(sFreeBlock);
 
 		// NOTE:  It is up to the user to ensure the size being enlarged is valid other wise memory overruns could occur.
 
 		// Redo the main freeblock size.  The block hasnt moved so there is no need to change the pointers only the size.
 		m_pMainFreeBlock->uSize = (jrs_sizet)((jrs_i8 *)m_pHeapEndAddress - ((jrs_i8 *)m_pMainFreeBlock));
+		UpdateZeroMemory();
 
 		cMemoryManager::Get().ContinuousLogging_Operation(cMemoryManager::eContLog_ResizeHeap, this, NULL, 0);
 		HEAP_THREADUNLOCK
-			return true;
+
+		// Free finds the heap from its address range.  Updated outside the heap lock as the memory manager takes its lock before heap locks.
+		cMemoryManager::Get().SetHeapRangeEnd(this, m_pHeapStartAddress, m_pHeapStartAddress + uSize);
+		return true;
 	}
 
 	//  Description:
@@ -1225,6 +1661,7 @@ namespace Elephant
 			return;			
 
 		HEAP_THREADLOCK
+		m_uGeneration++;
 
 		// We always search for the free links first of all.  These are the easiest to remove.
 		FreeAllEmptyLinkBlocks();
@@ -1349,6 +1786,7 @@ namespace Elephant
 						{
 							m_pMainFreeBlock->uSize = (jrs_sizet)(pStartOfFreeAddress - pNewMainEndAddress);
 							m_pHeapEndAddress = pStartOfFreeAddress - sizeof(sFreeBlock);
+							UpdateZeroMemory();
 						}
 					}
 					else if(pBlockNextLink)
@@ -1538,6 +1976,7 @@ namespace Elephant
 		jrs_u8 *pNHS = (jrs_u8 *)pNewSBlock;
 		jrs_u8 *pNHE = (jrs_u8 *)pNewEBlock;
 		jrs_sizet newSize = pNHE - pNHS;
+		m_uGeneration++;
 
 		// Call the system op callback if one exist.
 		if(m_systemOpCallback)
@@ -1880,6 +2319,7 @@ namespace Elephant
 
 		// Increase the size
 		m_uHeapSize += newSize;
+		m_uResizeCount++;
 
 		return TRUE;
 	}
@@ -1902,6 +2342,7 @@ namespace Elephant
 	sLinkedBlock *cHeap::ResizeInsertLink(jrs_u8 *pEndPtrForNewLink, jrs_u8 *pStartPtrOfNextBlock, sAllocatedBlock *pPrevAlloc, sAllocatedBlock *pNextAlloc, sLinkedBlock *pPrevLink, sLinkedBlock *pNextLink)
 	{
 		sLinkedBlock *pNewL = (sLinkedBlock *)(pEndPtrForNewLink - sizeof(sLinkedBlock));
+		m_uGeneration++;
 		pNewL->pPrev = pPrevAlloc;
 		if(pPrevAlloc)		
 			pPrevAlloc->pNext = (sAllocatedBlock *)pNewL;
@@ -1943,7 +2384,7 @@ namespace Elephant
 #ifdef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
 		// Set the names etc and if we are on a supported platform get the stack trace
 		strcpy(pNewL->Name, "Heap Linking Block");
-		cMemoryManager::Get().StackTrace(pNewL->uCallsStack, m_uCallstackDepth, JRSMEMORY_CALLSTACKDEPTH);
+		pNewL->uStackId = cMemoryManager::Get().StackTraceId(m_uCallstackDepth, JRSMEMORY_CALLSTACKDEPTH);
 #endif
 		if(m_bEnableLogging)
 		{
@@ -2038,7 +2479,7 @@ namespace Elephant
 		}
 #ifdef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
 		strcpy(pNewBlock->Name, "MemMan_NewResizedBlock");
-		cMemoryManager::Get().StackTrace(pNewBlock->uCallsStack, m_uCallstackDepth, JRSMEMORY_CALLSTACKDEPTH);
+		pNewBlock->uStackId = cMemoryManager::Get().StackTraceId(m_uCallstackDepth, JRSMEMORY_CALLSTACKDEPTH);
 #endif
 #ifdef MEMORYMANAGER_ENABLESENTINELCHECKS
 		SetSentinelsFreeBlock(pNewBlock);
@@ -2046,77 +2487,430 @@ namespace Elephant
 	}
 
 	//  Description:
-	//		Checks if the memory pointer was allocated from this heap by checking the heaps memory range.  May get confused if memory is located within other heaps.
+	//		Creates the pool for a size class.  Size class pools are created the first time an allocation of that size is made and grow on demand.
+	//		They are destroyed with the heap.  Internal function.
 	//  See Also:
-	//		CreateHeap, DestroyHeap
+	//		GetSizeClassPool, DestroySizeClassPools
 	//  Arguments:
-	//		pMemory - Valid memory pointer to a block of memory. 
+	//		uSizeClass - Index of the size class.  The elements are (uSizeClass + 1) * default alignment bytes.
 	//  Return Value:
-	//      TRUE if memory belongs to heap.
-	//		FALSE otherwise.
+	//      Valid cPool.
+	//		NULL if the pool could not be created.
 	//  Summary:
-	//      Checks if the memory pointer was allocated from this heap by checking the heaps memory range.
-	jrs_bool cHeap::IsAllocatedFromThisHeap(void *pMemory) const
+	//      Creates the pool for a size class.
+	cPool *cHeap::CreateSizeClassPool(jrs_u32 uSizeClass)
 	{
-		if((jrs_i8 *)pMemory >= m_pHeapStartAddress && (jrs_i8 *)pMemory < m_pHeapEndAddress)
-		{
-			// Locking only needed in resizable mode
-			if(cMemoryManager::Get().m_bResizeable)
-			{
-				HEAP_THREADLOCK
-			}
-
-			// It is but we need to check if it falls outside of a re-sizable block
-			if(m_pResizableLink)
-			{
-				sLinkedBlock *pL = m_pResizableLink;
-				jrs_u8 *pS = (jrs_u8 *)m_pHeapStartAddress;
-				jrs_u8 *pE = NULL;
-				while(pL)
-				{
-					pE = (jrs_u8 *)pL + sizeof(sLinkedBlock);
-					if((jrs_u8 *)pMemory >= pS && (jrs_u8 *)pMemory <= pE)
-					{
-						HEAP_THREADUNLOCK
-						return true;
-					}
+		// The pool list lock comes before the heap lock as AttachPool takes it
+		cMemoryManager::Get().m_PoolListLock.Lock();
+		HEAP_THREADLOCK
 
-					pS = (jrs_u8 *)pL + sizeof(sAllocatedBlock) + pL->uSize;
-					pL = pL->pLinkedNext;
-				}
+		// Another thread may have created it already.
+		cPool *pPool = m_pSizeClassPools[uSizeClass];
+		if(!pPool)
+		{
+			sPoolDetails details;
+			details.uAlignment = m_uDefaultAlignment;
+			details.uGrowElements = m_uSizeClassPoolElements;
+			details.bThreadSafe = m_bThreadSafe;
+			details.bAllowNotEnoughSpaceReturn = true;
+			details.bAllowDestructionWithAllocations = true;
+			details.bEnableErrors = m_bEnableErrors;
+			details.bErrorsAsWarnings = m_bErrorsAsWarnings;
+
+			jrs_i8 name[32];
+			sprintf(name, "SizeClass_%u", (uSizeClass + 1) * m_uDefaultAlignment);
+			pPool = cMemoryManager::Get().CreatePool((uSizeClass + 1) * m_uDefaultAlignment, m_uSizeClassPoolElements, name, &details, this);
+			m_pSizeClassPools[uSizeClass] = pPool;
+		}
 
-				// Final check
-				pE = (jrs_u8 *)m_pHeapEndAddress;
-				if((jrs_u8 *)pMemory >= pS && (jrs_u8 *)pMemory <= pE)
-				{
-					HEAP_THREADUNLOCK
-					return true;
-				}
+		HEAP_THREADUNLOCK
+		cMemoryManager::Get().m_PoolListLock.Unlock();
 
-				HEAP_THREADUNLOCK
-				// Not found.
-				return false;
-			}
+		return pPool;
+	}
 
-			if(cMemoryManager::Get().m_bResizeable)
-			{
-				HEAP_THREADUNLOCK
-			}
+	//  Description:
+	//		Finds the size class pool a memory address was allocated from.  Internal function.
+	//  See Also:
+	//		CreateSizeClassPool
+	//  Arguments:
+	//		pMemory - Memory address to check.
+	//  Return Value:
+	//      Valid cPool if the address comes from a size class pool.
+	//		NULL otherwise.
+	//  Summary:
+	//      Finds the size class pool a memory address was allocated from.
+	cPool *cHeap::GetSizeClassPool(void *pMemory) const
+	{
+		cPoolBase *pPool = FindPoolRange(pMemory);
+		if(!pPool)
+			return NULL;
 
-			return true;
-		}
+		// Only the pool created for the class matching the element size is a size class pool.
+		jrs_u32 uSizeClass = (pPool->GetAllocationSize() / m_uDefaultAlignment) - 1;
+		if(uSizeClass < m_uNumSizeClasses && m_pSizeClassPools[uSizeClass] == pPool)
+			return m_pSizeClassPools[uSizeClass];
 
-		return false;
+		return NULL;
 	}
 
 	//  Description:
-	//		Returns if error checking is enabled or not for the heap.  This is determined by the bEnableErrors flag of sHeapDetails when creating the heap.
+	//		Returns the number of live allocations served by the size class pools.  Internal function.
 	//  See Also:
-	//		AreErrorsWarningsOnly, CreateHeap
+	//		DestroySizeClassPools
 	//  Arguments:
 	//		None
 	//  Return Value:
-	//      TRUE if errors are enabled.
+	//      Number of allocations.
+	//  Summary:
+	//      Returns the number of live allocations served by the size class pools.
+	jrs_u32 cHeap::GetNumberOfSizeClassAllocations(void) const
+	{
+		jrs_u32 uAllocations = 0;
+		for(jrs_u32 i = 0; i < m_uNumSizeClasses; i++)
+		{
+			if(m_pSizeClassPools[i])
+				uAllocations += m_pSizeClassPools[i]->GetTotalAllocations();
+		}
+
+		return uAllocations;
+	}
+
+	//  Description:
+	//		Destroys all the size class pools of the heap.  Any allocations still in them are lost.  Internal function.
+	//  See Also:
+	//		CreateSizeClassPool
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Destroys all the size class pools of the heap.
+	void cHeap::DestroySizeClassPools(void)
+	{
+		for(jrs_u32 i = 0; i < m_uNumSizeClasses; i++)
+		{
+			if(m_pSizeClassPools[i])
+			{
+				cMemoryManager::Get().DestroyPool(m_pSizeClassPools[i]);
+				m_pSizeClassPools[i] = NULL;
+			}
+		}
+	}
+
+	//  Description:
+	//		Allocates and clears the latency statistics.  They come from the default system allocator so timing does not change the heap.
+	//		Private.
+	//  See Also:
+	//		EnableLatencyStatistics, DestroyLatencyStatistics
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      TRUE if the statistics exist.
+	//		FALSE if the platform has no timer or the memory could not be allocated.
+	//  Summary:
+	//      Allocates the latency statistics.
+	jrs_bool cHeap::CreateLatencyStatistics(void)
+	{
+		if(m_pLatencyStats)
+			return true;
+
+		jrs_u64 uTicksPerSecond = JRSTimer::GetTicksPerSecond();
+		if(!uTicksPerSecond)
+			return false;
+
+		sLatencyStats *pStats = (sLatencyStats *)cMemoryManager::Get().m_MemoryManagerDefaultAllocator(sizeof(sLatencyStats), NULL);
+		if(!pStats)
+			return false;
+
+		memset(pStats, 0, sizeof(sLatencyStats));
+		pStats->uTicksPerSecond = uTicksPerSecond;
+		pStats->uNSScale = (1000000000ULL << 16) / uTicksPerSecond;
+		m_pLatencyStats = pStats;
+
+		return true;
+	}
+
+	//  Description:
+	//		Frees the latency statistics.  Called when the heap is destroyed.  Private.
+	//  See Also:
+	//		CreateLatencyStatistics
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Frees the latency statistics.
+	void cHeap::DestroyLatencyStatistics(void)
+	{
+		m_bLatencyStats = false;
+		if(m_pLatencyStats)
+		{
+			cMemoryManager::Get().m_MemoryManagerDefaultFree(m_pLatencyStats, sizeof(sLatencyStats));
+			m_pLatencyStats = NULL;
+		}
+	}
+
+	//  Description:
+	//		Takes the heap lock recording how long it waited.  Only the outermost lock of a thread is timed.  Private.
+	//  See Also:
+	//		LatencyUnlock
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Takes the heap lock and times the wait.
+	void cHeap::LatencyLock(void) const
+	{
+		jrs_u64 uStart = JRSTimer::GetTicks();
+		m_pThreadLock->Lock();
+
+		sLatencyStats *pStats = m_pLatencyStats;
+		if(!pStats->uLockDepth++)
+		{
+			pStats->uLockTicks = JRSTimer::GetTicks();
+			RecordLatency(eLatency_LockWait, pStats->uLockTicks - uStart);
+		}
+	}
+
+	//  Description:
+	//		Releases the heap lock recording how long it was held.  A lock taken before timing was enabled is released untimed.  Private.
+	//  See Also:
+	//		LatencyLock
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Releases the heap lock and times the hold.
+	void cHeap::LatencyUnlock(void) const
+	{
+		sLatencyStats *pStats = m_pLatencyStats;
+		if(pStats->uLockDepth && !--pStats->uLockDepth)
+			RecordLatency(eLatency_LockHold, JRSTimer::GetTicks() - pStats->uLockTicks);
+
+		m_pThreadLock->Unlock();
+	}
+
+	//  Description:
+	//		Adds a time to the histogram of an operation in the shard of the calling thread.  Private.
+	//  See Also:
+	//		GetLatencyHistogram
+	//  Arguments:
+	//		uOp - One of eLatency.
+	//		uTicks - Time taken in timer ticks.
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Records the time of an operation.
+	void cHeap::RecordLatency(jrs_u32 uOp, jrs_u64 uTicks) const
+	{
+		sLatencyStats *pStats = m_pLatencyStats;
+		jrs_u64 uNS = (uTicks * pStats->uNSScale) >> 16;
+
+		jrs_u32 uBucket = 0;
+		while(uBucket < MemoryManager_LatencyBuckets - 1 && (uNS >> (uBucket + 1)))
+			uBucket++;
+
+		jrs_u64 uShard = ((jrs_u64)JRSThread::CurrentID() * 0x9e3779b97f4a7c15ULL) >> (64 - MemoryManager_LatencyShardBits);
+		sLatencyHistogram &rHistogram = pStats->Shards[uShard][uOp];
+		rHistogram.uCount[uBucket]++;
+		rHistogram.uTotal++;
+		rHistogram.uTotalNS += uNS;
+		if(uNS > rHistogram.uMaxNS)
+			rHistogram.uMaxNS = uNS;
+	}
+
+	//  Description:
+	//		Enables or disables timing of AllocateMemory, FreeMemory, ReAllocateMemory and the heap lock.  The histograms are allocated the
+	//		first time and kept until the heap is destroyed so disabling keeps the results.  The cost while disabled is a test per operation.
+	//		Reallocations that move include the allocation and free they make, which are also counted.
+	//  See Also:
+	//		GetLatencyHistogram, ResetLatencyStatistics
+	//  Arguments:
+	//		bEnable - TRUE to enable.  FALSE to disable.
+	//  Return Value:
+	//      TRUE if the statistics are now in the requested state.
+	//		FALSE if they could not be enabled because the platform has no timer or there was no memory.
+	//  Summary:
+	//      Enables or disables latency statistics.
+	jrs_bool cHeap::EnableLatencyStatistics(jrs_bool bEnable)
+	{
+		// Take the lock directly.  Nobody else holds it while the flag changes so the timed lock depth starts again from 0.
+		if(m_bThreadSafe)
+			m_pThreadLock->Lock();
+
+		jrs_bool bEnabled = bEnable && CreateLatencyStatistics();
+		if(m_pLatencyStats)
+			m_pLatencyStats->uLockDepth = 0;
+		m_bLatencyStats = bEnabled;
+
+		if(m_bThreadSafe)
+			m_pThreadLock->Unlock();
+
+		return bEnabled == bEnable;
+	}
+
+	//  Description:
+	//		Gets the latency histogram of an operation with the shards of all threads merged.  Times are in nanoseconds.  Counts from other
+	//		threads may still be arriving while it is read.
+	//  See Also:
+	//		EnableLatencyStatistics, sLatencyHistogram::GetPercentileNS
+	//  Arguments:
+	//		eOp - Operation to get.  One of eLatency.
+	//		pHistogram - Valid pointer to receive the histogram.  Cleared if there are no statistics.
+	//  Return Value:
+	//      TRUE if the heap has latency statistics.
+	//		FALSE otherwise.
+	//  Summary:
+	//      Gets the latency histogram of an operation.
+	jrs_bool cHeap::GetLatencyHistogram(eLatency eOp, sLatencyHistogram *pHistogram) const
+	{
+		memset(pHistogram, 0, sizeof(sLatencyHistogram));
+		if(!m_pLatencyStats || eOp >= eLatency_Max)
+			return false;
+
+		for(jrs_u32 uShard = 0; uShard < MemoryManager_LatencyShards; uShard++)
+		{
+			const sLatencyHistogram &rShard = m_pLatencyStats->Shards[uShard][eOp];
+			for(jrs_u32 uBucket = 0; uBucket < MemoryManager_LatencyBuckets; uBucket++)
+				pHistogram->uCount[uBucket] += rShard.uCount[uBucket];
+			pHistogram->uTotal += rShard.uTotal;
+			pHistogram->uTotalNS += rShard.uTotalNS;
+			if(rShard.uMaxNS > pHistogram->uMaxNS)
+				pHistogram->uMaxNS = rShard.uMaxNS;
+		}
+
+		return true;
+	}
+
+	//  Description:
+	//		Clears the latency histograms of every operation.
+	//  See Also:
+	//		EnableLatencyStatistics, GetLatencyHistogram
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Clears the latency histograms.
+	void cHeap::ResetLatencyStatistics(void)
+	{
+		if(!m_pLatencyStats)
+			return;
+
+		HEAP_THREADLOCK
+		memset(m_pLatencyStats->Shards, 0, sizeof(m_pLatencyStats->Shards));
+		HEAP_THREADUNLOCK
+	}
+
+	//  Description:
+	//		Returns the time a percentage of the operations completed within.  The result is the upper edge of the bucket the percentile falls
+	//		in so it is accurate to a factor of 2.  It is never more than the longest time recorded.
+	//  See Also:
+	//		cHeap::GetLatencyHistogram
+	//  Arguments:
+	//		fPercentile - Percentage from 0 to 100.  For example 99.9f.
+	//  Return Value:
+	//      Time in nanoseconds.  0 if there are no operations.
+	//  Summary:
+	//      Returns a percentile of the histogram.
+	jrs_u64 cHeap::sLatencyHistogram::GetPercentileNS(jrs_f32 fPercentile) const
+	{
+		if(!uTotal)
+			return 0;
+
+		jrs_u64 uRank = (jrs_u64)((double)uTotal * fPercentile / 100.0);
+		if(uRank >= uTotal)
+			uRank = uTotal - 1;
+
+		jrs_u64 uSeen = 0;
+		for(jrs_u32 uBucket = 0; uBucket < MemoryManager_LatencyBuckets - 1; uBucket++)
+		{
+			uSeen += uCount[uBucket];
+			if(uSeen > uRank)
+			{
+				jrs_u64 uEdge = 2ULL << uBucket;
+				return uEdge < uMaxNS ? uEdge : uMaxNS;
+			}
+		}
+
+		return uMaxNS;
+	}
+
+	//  Description:
+	//		Checks if the memory pointer was allocated from this heap by checking the heaps memory range.  May get confused if memory is located within other heaps.
+	//  See Also:
+	//		CreateHeap, DestroyHeap
+	//  Arguments:
+	//		pMemory - Valid memory pointer to a block of memory. 
+	//  Return Value:
+	//      TRUE if memory belongs to heap.
+	//		FALSE otherwise.
+	//  Summary:
+	//      Checks if the memory pointer was allocated from this heap by checking the heaps memory range.
+	jrs_bool cHeap::IsAllocatedFromThisHeap(void *pMemory) const
+	{
+		if((jrs_i8 *)pMemory >= m_pHeapStartAddress && (jrs_i8 *)pMemory < m_pHeapEndAddress)
+		{
+			// Locking only needed in resizable mode
+			if(cMemoryManager::Get().m_bResizeable)
+			{
+				HEAP_THREADLOCK
+			}
+
+			// It is but we need to check if it falls outside of a re-sizable block
+			if(m_pResizableLink)
+			{
+				sLinkedBlock *pL = m_pResizableLink;
+				jrs_u8 *pS = (jrs_u8 *)m_pHeapStartAddress;
+				jrs_u8 *pE = NULL;
+				while(pL)
+				{
+					pE = (jrs_u8 *)pL + sizeof(sLinkedBlock);
+					if((jrs_u8 *)pMemory >= pS && (jrs_u8 *)pMemory <= pE)
+					{
+						HEAP_THREADUNLOCK
+						return true;
+					}
+
+					pS = (jrs_u8 *)pL + sizeof(sAllocatedBlock) + pL->uSize;
+					pL = pL->pLinkedNext;
+				}
+
+				// Final check
+				pE = (jrs_u8 *)m_pHeapEndAddress;
+				if((jrs_u8 *)pMemory >= pS && (jrs_u8 *)pMemory <= pE)
+				{
+					HEAP_THREADUNLOCK
+					return true;
+				}
+
+				HEAP_THREADUNLOCK
+				// Not found.
+				return false;
+			}
+
+			if(cMemoryManager::Get().m_bResizeable)
+			{
+				HEAP_THREADUNLOCK
+			}
+
+			return true;
+		}
+
+		return false;
+	}
+
+	//  Description:
+	//		Returns if error checking is enabled or not for the heap.  This is determined by the bEnableErrors flag of sHeapDetails when creating the heap.
+	//  See Also:
+	//		AreErrorsWarningsOnly, CreateHeap
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      TRUE if errors are enabled.
 	//		FALSE otherwise.
 	//  Summary:
 	//      Returns if error checking is enabled or not for the heap.
@@ -2319,6 +3113,22 @@ namespace Elephant
 		return uNumLinks;
 	}
 
+	//  Description:
+	//		Returns the number of times the heap has changed size.  Counts Resize calls that changed the size, each block a resizable heap
+	//		grows by and each block it reclaims.
+	//  See Also:
+	//		Resize, Reclaim
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      Number of size changes.
+	//  Summary:
+	//      Returns the number of times the heap has changed size.
+	jrs_u32 cHeap::GetResizeCount(void) const
+	{
+		return m_uResizeCount;
+	}
+
 	//  Description:
 	//		Returns the total number of active allocations in the heap.  Multiply this value with cMemoryManager::SizeofAllocatedBlock to get the total overhead.
 	//  See Also:
@@ -2366,9 +3176,10 @@ namespace Elephant
 	}
 
 	//  Description:
-	//		Finds the largest free block of memory in the Heap.
+	//		Finds the largest free block of memory in the Heap.  This is the larger of the main free block and the largest block in the
+	//		highest non empty bin.  That bin is only walked if its largest block has been allocated since it was last found.
 	//  See Also:
-	//		
+	//		GetFragmentationInfo
 	//  Arguments:
 	//		None
 	//  Return Value:
@@ -2377,39 +3188,13 @@ namespace Elephant
 	//      Finds the largest free block of memory in the system.
 	jrs_sizet cHeap::GetSizeOfLargestFragment(void) const
 	{
-		// Get the free block as the starting size.  This is often the biggest, so optimize for that case.
+		// The main free block is often the biggest.  Otherwise the biggest is in the highest non empty bin.
 		jrs_sizet MaxSize = m_pMainFreeBlock->uSize;
-
-		// Check all the other blocks.  This could be slow if there are lots of fragments.
-		for(jrs_i32 i = m_uBinCount - 1; i >= 0; i--)
+		if(m_uBinMask)
 		{
-			// Check if we have an allocation
-			if(m_pBins[i])
-			{
-				// Check this bin is bigger than the actual size
-				if(i < 8)
-				{
-					if(MaxSize > (jrs_sizet)(16 * i))
-						return MaxSize - cMemoryManager::Get().SizeofAllocatedBlock();
-				}
-				// Early out
-				else if(MaxSize > (jrs_sizet)(1 << i))
-					return MaxSize - cMemoryManager::Get().SizeofAllocatedBlock();
-
-				sFreeBlock *pBin = m_pBins[i];
-				sFreeBlock *pList = pBin;
-
-				// Check the size
-				do
-				{
-					if(pBin->uSize > MaxSize)
-						MaxSize = pBin->uSize;
-					pBin = pBin->pNextBin;
-				}
-				while(pBin != pList);
-
-				return MaxSize - cMemoryManager::Get().SizeofAllocatedBlock();
-			}
+			jrs_sizet uBinMax = GetLargestBinBlock(HeapHighestBin(m_uBinMask));
+			if(uBinMax > MaxSize)
+				MaxSize = uBinMax;
 		}
 
 		// Largest free block size (minus overhead)
@@ -2434,6 +3219,58 @@ namespace Elephant
 		return GetSize() - (GetMemoryUsed() + (GetNumberOfAllocations() * cMemoryManager::Get().SizeofAllocatedBlock())) - cMemoryManager::Get().SizeofFreeBlock();
 	}
 
+	//  Description:
+	//		Returns how the free memory of the heap is laid out.  The totals and the per bin counts are kept up to date as memory is
+	//		allocated and freed so this is cheap enough to call every frame.  Only the bin holding the largest free block may be walked, and
+	//		only if that block has been allocated since the last call.  Use fFragmentation to decide when a heap is worth compacting or
+	//		recycling.
+	//  See Also:
+	//		GetSizeOfLargestFragment, GetTotalFreeMemory
+	//  Arguments:
+	//		pInfo - Receives the information.
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Returns how the free memory of the heap is laid out.
+	void cHeap::GetFragmentationInfo(sFragmentationInfo *pInfo)
+	{
+		HEAP_THREADLOCK
+
+		jrs_sizet uLargest = m_pMainFreeBlock->uSize;
+		if(m_uBinMask)
+		{
+			jrs_u32 uBin = HeapHighestBin(m_uBinMask);
+			RefreshBinMaxSize(uBin);
+			if(m_uBinMaxSize[uBin] > uLargest)
+				uLargest = m_uBinMaxSize[uBin];
+		}
+
+		pInfo->uFreeBytes = m_uBinFreeSize + m_pMainFreeBlock->uSize;
+		pInfo->uMainFreeBlockSize = m_pMainFreeBlock->uSize;
+		pInfo->uLargestFreeBlock = uLargest;
+		pInfo->uLargestAllocation = uLargest ? uLargest - cMemoryManager::Get().SizeofAllocatedBlock() : 0;
+		pInfo->fFragmentation = pInfo->uFreeBytes ? 1.0f - ((jrs_f32)uLargest / (jrs_f32)pInfo->uFreeBytes) : 0.0f;
+		pInfo->uNumBins = m_uBinCount;
+		pInfo->uNumFreeBlocks = 0;
+		for(jrs_u32 i = 0; i < m_uBinCount; i++)
+		{
+			pInfo->uNumFreeBlocks += m_uBinFreeBlocks[i];
+			pInfo->uBinBlocks[i] = m_uBinFreeBlocks[i];
+			pInfo->uBinBytes[i] = m_uBinFreeBytes[i];
+
+			// Matches GetBinLookupBasedOnSize.  16 byte steps up to 512 bytes then powers of 2.  The bins above 2GB are only used by 4GB
+			// and larger blocks.
+			if(i < 31)
+				pInfo->uBinMinimumSize[i] = (jrs_sizet)(16 * (i + 1));
+			else if(i <= 53)
+				pInfo->uBinMinimumSize[i] = (jrs_sizet)1 << (i - 22);
+			else
+				pInfo->uBinMinimumSize[i] = (jrs_sizet)0xffffffffu;
+		}
+
+		HEAP_THREADUNLOCK
+	}
+
 	//  Description:
 	//		Returns if the heap is locked and thus prevented from allocating any more memory.  
 	//  See Also:
@@ -2794,6 +3631,7 @@ namespace Elephant
 		{
 			// The free block is the same as the main free block.  We must move the main free block to the end.
 			m_pMainFreeBlock = (sFreeBlock *)pEndMemory;
+			UpdateZeroMemory();
 
 			// No need to remove the bins.  Since this free block will have no bins or shouldnt (The end free block never has bins).
 			HeapWarning(pFreeBlock->uMarker == MemoryManager_FreeBlockEndValue, JRSMEMORYERROR_FATAL, "Not the last free block. FATAL ERROR");
@@ -2845,7 +3683,7 @@ namespace Elephant
 				// Set the names etc and if we are on a supported platform get the stack trace
 				memset(pNewBlock->Name, 0, sizeof(pNewBlock->Name));
 				memcpy(pNewBlock->Name, "MemMan_Filler", strlen("MemMan_Filler"));
-				cMemoryManager::Get().StackTrace(pNewBlock->uCallsStack, m_uCallstackDepth, JRSMEMORY_CALLSTACKDEPTH);
+				pNewBlock->uStackId = cMemoryManager::Get().StackTraceId(m_uCallstackDepth, JRSMEMORY_CALLSTACKDEPTH);
 #endif
 
 				// Adjust the bin pointers but only if they don't point to the same block.  This is because we run a circular buffer of pointers
@@ -2886,6 +3724,7 @@ namespace Elephant
 		pAllocBlock->pPrev = pAllocPrev;
 		pAllocBlock->pNext = pAllocNext;
 		m_uUniqueAllocCount++;
+		m_uGeneration++;
 
 		// The previous block must have the next updated to the new address
 		if(pAllocBlock->pPrev)
@@ -2947,7 +3786,7 @@ namespace Elephant
 				pNewBlock->uSize = uFreeBytesBetweenAligned;
 #ifdef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
 				strcpy(pNewBlock->Name, "MemMan_Filler_X");
-				cMemoryManager::Get().StackTrace(pNewBlock->uCallsStack, m_uCallstackDepth, JRSMEMORY_CALLSTACKDEPTH);
+				pNewBlock->uStackId = cMemoryManager::Get().StackTraceId(m_uCallstackDepth, JRSMEMORY_CALLSTACKDEPTH);
 #endif
 				// Adjust the bin pointers but only if they don't point to the same block.  This is because we run a circular buffer of pointers
 				if(pFBNextBin && pFBNextBin != pNewBlock)
@@ -3036,7 +3875,8 @@ namespace Elephant
 				jrs_u64 uSize = pRAllocs[i - 1];
 				if(pMem >= pSE && pMem < pEE)
 				{
-					m_systemFree(pMem, uSize);
+					cMemoryManager::Get().RemoveHeapRanges(this, pMem);
+					cMemoryManager::Get().ReleaseHeapRegion(pMem, uSize, m_systemAllocator, m_systemFree);
 
 					// Call the system op callback if one exist.
 					if(m_systemOpCallback)
@@ -3083,7 +3923,15 @@ namespace Elephant
 
 		// Clear bins
 		for(jrs_u32 i = 0; i < m_uBinCount; i++)
+		{
 			m_pBins[i] = 0;
+			m_uBinFreeBlocks[i] = 0;
+			m_uBinFreeBytes[i] = 0;
+			m_uBinMaxSize[i] = 0;
+		}
+		m_uBinMask = 0;
+		m_uBinMaxDirty = 0;
+		m_uBinFreeSize = 0;
 
 #ifdef MEMORYMANAGER_ENABLESENTINELCHECKS
 		SetSentinelsFreeBlock(m_pMainFreeBlock);
@@ -3093,7 +3941,7 @@ namespace Elephant
 		strcpy(m_pMainFreeBlock->Name, "Main Free");
 		m_pMainFreeBlock->uExternalId = 0;
 		m_pMainFreeBlock->uHeapId = m_uHeapId;
-		cMemoryManager::Get().StackTrace(m_pMainFreeBlock->uCallsStack, m_uCallstackDepth, JRSMEMORY_CALLSTACKDEPTH);
+		m_pMainFreeBlock->uStackId = cMemoryManager::Get().StackTraceId(m_uCallstackDepth, JRSMEMORY_CALLSTACKDEPTH);
 #endif
 
 		// Clear the allocated amount
@@ -3396,7 +4244,40 @@ namespace Elephant
 		cMemoryManager::DebugOutput("Minimum allocation size: %d", m_uMinAllocSize);
 		cMemoryManager::DebugOutput("Maximum allocation size: %d", m_uMaxAllocSize);
 		cMemoryManager::DebugOutput("Allocation Header Size: %d", cMemoryManager::Get().SizeofAllocatedBlock());
+		cMemoryManager::DebugOutput("Size class pools: %d (up to %d bytes)", m_uNumSizeClasses, m_uNumSizeClasses * m_uDefaultAlignment);
 
+		// Size class usage
+		for(jrs_u32 uSizeClass = 0; uSizeClass < m_uNumSizeClasses; uSizeClass++)
+		{
+			cPool *pSCPool = m_pSizeClassPools[uSizeClass];
+			if(pSCPool)
+				cMemoryManager::DebugOutput("Size class %d bytes - %d of %d allocated in %d chunks", pSCPool->GetAllocationSize(), pSCPool->GetTotalAllocations(), pSCPool->GetMaxAllocations(), pSCPool->GetNumberOfChunks());
+		}
+
+		// Latency of each operation
+		if(m_pLatencyStats)
+		{
+			static const jrs_i8 *pLatencyNames[eLatency_Max] = { "Allocate", "Free", "ReAllocate", "Lock wait", "Lock hold" };
+			for(jrs_u32 uOp = 0; uOp < eLatency_Max; uOp++)
+			{
+				sLatencyHistogram histogram;
+				GetLatencyHistogram((eLatency)uOp, &histogram);
+				cMemoryManager::DebugOutput("Latency %s: %llu timed - mean %lluns p50 %lluns p99 %lluns p99.9 %lluns max %lluns", pLatencyNames[uOp], histogram.uTotal, 
+					histogram.uTotal ? histogram.uTotalNS / histogram.uTotal : 0, histogram.GetPercentileNS(50.0f), histogram.GetPercentileNS(99.0f), 
+					histogram.GetPercentileNS(99.9f), histogram.uMaxNS);
+
+				if(bAdvanced)
+				{
+					for(jrs_u32 uBucket = 0; uBucket < MemoryManager_LatencyBuckets; uBucket++)
+					{
+						if(histogram.uCount[uBucket] && uBucket < MemoryManager_LatencyBuckets - 1)
+							cMemoryManager::DebugOutput("    Under %lluns - %llu", 2ULL << uBucket, histogram.uCount[uBucket]);
+						else if(histogram.uCount[uBucket])
+							cMemoryManager::DebugOutput("    %lluns and over - %llu", 1ULL << uBucket, histogram.uCount[uBucket]);
+					}
+				}
+			}
+		}
 
 		// Log any pools
 		cPoolBase *pPool = m_pAttachedPools;
@@ -3518,7 +4399,7 @@ namespace Elephant
 #ifdef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
 						sprintf(logtext, "Free Block %6d (%8d %-32s %5d) - 0x%p (0x%p) %llu", FreeCount++, 0, pPotentialFirst->Name, pPotentialFirst->uExternalId, (jrs_i8 *)pPotentialFirst + sizeof(sAllocatedBlock), pPotentialFirst, (jrs_u64)(pPotentialFirst->uSize - sizeof(sAllocatedBlock)));
 						if(displayCallStack)
-							cMemoryManager::StackToString(&logtext[strlen(logtext)], pPotentialFirst->uCallsStack, JRSMEMORY_CALLSTACKDEPTH);
+							cMemoryManager::StackToString(&logtext[strlen(logtext)], cMemoryManager::Get().GetStackFromId(pPotentialFirst->uStackId), JRSMEMORY_CALLSTACKDEPTH);
 						cMemoryManager::DebugOutput(logtext);
 #else
 					cMemoryManager::DebugOutput("Free Block %6d (%8d) - 0x%p (0x%p) %u", FreeCount++, 0, (jrs_i8 *)pPotentialFirst + sizeof(sAllocatedBlock), pPotentialFirst, pPotentialFirst->uSize - sizeof(sAllocatedBlock));
@@ -3537,7 +4418,7 @@ namespace Elephant
 					{
 #ifdef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
 						jrs_i8 temp[32];
-						sprintf(temp, "; 0x%llx", (jrs_u64)MemoryManagerPlatformAddressToBaseAddress(pPotentialFirst->uCallsStack[cs]));
+						sprintf(temp, "; 0x%llx", (jrs_u64)MemoryManagerPlatformAddressToBaseAddress(cMemoryManager::Get().GetStackFromId(pPotentialFirst->uStackId)[cs]));
 						strcat(logtext, temp);
 #else
 						strcat(logtext, "; 0x0");
@@ -3556,7 +4437,7 @@ namespace Elephant
 #ifdef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
 					sprintf(logtext, "%s %6d (%8d %-32s %5d) - 0x%p (0x%p) %llu", bLinkType ? "Link      " : "Allocation", AllocCount, (jrs_u32)pAlloc->uFlagAndUniqueAllocNumber >> 4, pAlloc->Name, pAlloc->uExternalId, pMemoryLocation, pAlloc, (jrs_u64)(HEAP_FULLSIZE(pAlloc->uSize)));
 					if (displayCallStack)
-						cMemoryManager::StackToString(&logtext[strlen(logtext)], pPotentialFirst->uCallsStack, JRSMEMORY_CALLSTACKDEPTH);
+						cMemoryManager::StackToString(&logtext[strlen(logtext)], cMemoryManager::Get().GetStackFromId(pAlloc->uStackId), JRSMEMORY_CALLSTACKDEPTH);
 					cMemoryManager::DebugOutput(logtext);
 #else
 					cMemoryManager::DebugOutput("%s %6d (%8d) - 0x%p (0x%p) %u ", bLinkType ? "Link      " : "Allocation", AllocCount, pAlloc->uFlagAndUniqueAllocNumber >> 4, pMemoryLocation, pAlloc, HEAP_FULLSIZE(pAlloc->uSize));
@@ -3574,7 +4455,7 @@ namespace Elephant
 					{
 #ifdef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
 						jrs_i8 temp[32];
-						sprintf(temp, "; 0x%llx", (jrs_u64)MemoryManagerPlatformAddressToBaseAddress(pAlloc->uCallsStack[cs]));
+						sprintf(temp, "; 0x%llx", (jrs_u64)MemoryManagerPlatformAddressToBaseAddress(cMemoryManager::Get().GetStackFromId(pAlloc->uStackId)[cs]));
 						strcat(logtext, temp);
 #else
 						strcat(logtext, "; 0x0");
@@ -3599,7 +4480,7 @@ namespace Elephant
 #ifdef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
 								sprintf(logtext, "Free Block %6d (%8d %-32s %5d) - 0x%p (0x%p) %llu", FreeCount++, (jrs_u32)pFreeBlock->uFlags, pFreeBlock->Name, pFreeBlock->uExternalId, (jrs_i8 *)pFreeBlock + sizeof(sAllocatedBlock), pFreeBlock, (jrs_u64)(pFreeBlock->uSize - sizeof(sAllocatedBlock)));
 								if (displayCallStack)
-									cMemoryManager::StackToString(&logtext[strlen(logtext)], pPotentialFirst->uCallsStack, JRSMEMORY_CALLSTACKDEPTH);
+									cMemoryManager::StackToString(&logtext[strlen(logtext)], cMemoryManager::Get().GetStackFromId(pFreeBlock->uStackId), JRSMEMORY_CALLSTACKDEPTH);
 								cMemoryManager::DebugOutput(logtext);
 #else
 								cMemoryManager::DebugOutput("Free Block %6d (%8d) - 0x%p (0x%p) %u", FreeCount++, pFreeBlock->uFlags, (jrs_i8 *)pFreeBlock + sizeof(sAllocatedBlock), pFreeBlock, pFreeBlock->uSize - sizeof(sAllocatedBlock));
@@ -3619,7 +4500,7 @@ namespace Elephant
 							{
 #ifdef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
 								jrs_i8 temp[32];
-								sprintf(temp, "; 0x%llx", (jrs_u64)MemoryManagerPlatformAddressToBaseAddress(pFreeBlock->uCallsStack[cs]));
+								sprintf(temp, "; 0x%llx", (jrs_u64)MemoryManagerPlatformAddressToBaseAddress(cMemoryManager::Get().GetStackFromId(pFreeBlock->uStackId)[cs]));
 								strcat(logtext, temp);
 #else
 								strcat(logtext, "; 0x0");
@@ -3661,6 +4542,291 @@ namespace Elephant
 		HEAP_THREADUNLOCK
 	}
 
+#ifdef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
+	//  Description:
+	//		Copies the name of a block header for a snapshot.  Private.
+	//  See Also:
+	//		SnapshotSlice
+	//  Arguments:
+	//		pDest - MemoryManager_SnapshotNameLength characters.
+	//		pName - Name in the block header.
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Copies the name of a block header.
+	static void HeapSnapshotCopyName(jrs_i8 *pDest, const jrs_i8 *pName)
+	{
+		jrs_sizet uLength = strlen(pName);
+		if(uLength > MemoryManager_SnapshotNameLength - 1)
+			uLength = MemoryManager_SnapshotNameLength - 1;
+		memcpy(pDest, pName, uLength);
+		pDest[uLength] = 0;
+	}
+#endif
+
+	//  Description:
+	//		Copies an allocation or link for a snapshot.  Private.  Called with the heap locked.
+	//  See Also:
+	//		SnapshotSlice
+	//  Arguments:
+	//		pCopy - Receives the copy.
+	//		pAlloc - Block in the allocation list.
+	//		uFullSize - Size of the block after rounding to the heap minimum.
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Copies an allocation for a snapshot.
+	static void HeapSnapshotCopyAllocation(cHeap::sSnapshotBlock *pCopy, const sAllocatedBlock *pAlloc, jrs_sizet uFullSize)
+	{
+		pCopy->uAddress = (jrs_u64)((jrs_sizet)pAlloc + sizeof(sAllocatedBlock));
+		pCopy->uSize = (jrs_u64)uFullSize;
+		pCopy->uFlag = (jrs_u32)(pAlloc->uFlagAndUniqueAllocNumber & 0xf);
+		pCopy->uNumber = (jrs_u32)(pAlloc->uFlagAndUniqueAllocNumber >> 4);
+		pCopy->bFree = FALSE;
+#ifdef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
+		pCopy->uStackId = pAlloc->uStackId;
+		HeapSnapshotCopyName(pCopy->Name, pAlloc->Name);
+#else
+		pCopy->uStackId = 0;
+		strcpy(pCopy->Name, "Unknown");
+#endif
+	}
+
+	//  Description:
+	//		Copies a free block for a snapshot.  Private.  Called with the heap locked.
+	//  See Also:
+	//		SnapshotSlice
+	//  Arguments:
+	//		pCopy - Receives the copy.
+	//		pFreeBlock - Free block between two allocations or at the start of the heap.
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Copies a free block for a snapshot.
+	static void HeapSnapshotCopyFree(cHeap::sSnapshotBlock *pCopy, const sFreeBlock *pFreeBlock)
+	{
+		pCopy->uAddress = (jrs_u64)((jrs_sizet)pFreeBlock + sizeof(sAllocatedBlock));
+		pCopy->uSize = (jrs_u64)(pFreeBlock->uSize - sizeof(sAllocatedBlock));
+		pCopy->uFlag = 0;
+		pCopy->uNumber = (jrs_u32)pFreeBlock->uFlags;
+		pCopy->bFree = TRUE;
+#ifdef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
+		pCopy->uStackId = pFreeBlock->uStackId;
+		HeapSnapshotCopyName(pCopy->Name, pFreeBlock->Name);
+#else
+		pCopy->uStackId = 0;
+		strcpy(pCopy->Name, "Unknown");
+#endif
+	}
+
+	//  Description:
+	//		Moves the snapshot cursor on when the block it points to leaves the allocation list and counts the change.  Private.  Called with
+	//		the heap locked before the block is unlinked.
+	//  See Also:
+	//		SnapshotSlice
+	//  Arguments:
+	//		pBlock - Block leaving the allocation list.
+	//		pNext - Block after it.
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Keeps the snapshot cursor valid.
+	void cHeap::SnapshotRemoveBlock(sAllocatedBlock *pBlock, sAllocatedBlock *pNext)
+	{
+		m_uGeneration++;
+		if(m_pSnapshotNext == pBlock)
+			m_pSnapshotNext = pNext;
+	}
+
+	//  Description:
+	//		Returns the generation of the heap.  It changes each time a block joins, leaves or changes size in the allocation list or the heap
+	//		resizes, so two equal readings mean nothing moved in between.
+	//  See Also:
+	//		SnapshotSlice
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      Current generation.  Wraps.
+	//  Summary:
+	//      Returns the generation of the heap.
+	jrs_u32 cHeap::GetGeneration(void) const
+	{
+		return m_uGeneration;
+	}
+
+	//  Description:
+	//		Copies the next part of the allocation list of the heap in address order.  The heap is only locked while at most uMaxBlocks blocks
+	//		are copied so a snapshot of a large heap can be taken a slice at a time without holding up the threads allocating from it.  The
+	//		first slice takes the heap details for the header.  Between slices the heap keeps a cursor to the next block, moving it on if that
+	//		block is freed, and the generation says whether anything changed.  If uChanges is 0 when bFinished is set the slices are the heap
+	//		exactly as it was at one moment.  Otherwise blocks changed while the snapshot was taken may be missing or out of date but every
+	//		block copied was valid when its slice was taken.  One snapshot of a heap can be in progress at a time.  Starting another
+	//		interrupts the first.  Pools attached to the heap are not included.
+	//  See Also:
+	//		ReportSnapshotHeader, ReportSnapshotBlocks, GetGeneration
+	//  Arguments:
+	//		pSnapshot - Progress of the snapshot.  Use a new sSnapshot for each snapshot.
+	//		pBlocks - Receives the blocks.
+	//		uMaxBlocks - Number of blocks pBlocks can hold.  Minimum 3.
+	//  Return Value:
+	//      Number of blocks copied.  May be 0 before bFinished is set.
+	//  Summary:
+	//      Copies the next part of the allocation list.
+	jrs_u32 cHeap::SnapshotSlice(sSnapshot *pSnapshot, sSnapshotBlock *pBlocks, jrs_u32 uMaxBlocks)
+	{
+		if(!pSnapshot || pSnapshot->bFinished)
+			return 0;
+
+		if(!pBlocks || uMaxBlocks < 3)
+		{
+			HeapWarning(pBlocks && uMaxBlocks >= 3, JRSMEMORYERROR_INVALIDARGUMENTS, "A snapshot slice needs room for at least 3 blocks.");
+			pSnapshot->bFinished = true;
+			return 0;
+		}
+
+		HEAP_THREADLOCK
+		jrs_u32 uNumBlocks = 0;
+		sAllocatedBlock *pAlloc;
+		if(!pSnapshot->uSlices)
+		{
+			// Take the cursor
+			if(!++m_uSnapshotId)
+				m_uSnapshotId = 1;
+			pSnapshot->uId = m_uSnapshotId;
+			pSnapshot->uStartGeneration = m_uGeneration;
+
+			pSnapshot->uHeapId = m_uHeapId;
+			strcpy(pSnapshot->HeapName, m_HeapName);
+			pSnapshot->uHeapSize = (jrs_u64)GetSize();
+			pSnapshot->uHeapAddress = (jrs_u64)((jrs_sizet)m_pHeapStartAddress);
+			pSnapshot->uMinAllocSize = (jrs_u64)m_uMinAllocSize;
+			pSnapshot->uMaxAllocSize = (jrs_u64)m_uMaxAllocSize;
+			pSnapshot->uDefaultAlignment = m_uDefaultAlignment;
+			pSnapshot->bHeapIsUserManaged = !m_bHeapIsMemoryManagerManaged;
+
+			// As ReportAllocationsMemoryOrder the first free block may be before the first allocation.
+			pAlloc = m_pAllocList;
+			if(pAlloc && (jrs_i8 *)pAlloc >= m_pHeapStartAddress + sizeof(sAllocatedBlock) + m_uMinAllocSize)
+				HeapSnapshotCopyFree(&pBlocks[uNumBlocks++], (sFreeBlock *)m_pHeapStartAddress);
+		}
+		else if(pSnapshot->uId != m_uSnapshotId)
+		{
+			// Another snapshot has the cursor
+			pSnapshot->bInterrupted = true;
+			pSnapshot->bFinished = true;
+			HEAP_THREADUNLOCK
+			return 0;
+		}
+		else
+		{
+			pSnapshot->uChanges += m_uGeneration - pSnapshot->uGeneration;
+			pAlloc = m_pSnapshotNext;
+		}
+
+		// Each allocation is followed by the free block between it and the next if there is room for one.
+		while(pAlloc && uNumBlocks + 2 <= uMaxBlocks)
+		{
+			HeapSnapshotCopyAllocation(&pBlocks[uNumBlocks++], pAlloc, HEAP_FULLSIZE(pAlloc->uSize));
+			if(pAlloc->pNext)
+			{
+				sAllocatedBlock *pActualNext = (sAllocatedBlock *)((jrs_i8 *)pAlloc + HEAP_FULLSIZE(pAlloc->uSize) + sizeof(sAllocatedBlock));
+				jrs_sizet uSizeBetween = (jrs_sizet)((jrs_i8 *)pAlloc->pNext - (jrs_i8 *)pActualNext);
+				if(uSizeBetween >= sizeof(sAllocatedBlock) + m_uMinAllocSize)
+					HeapSnapshotCopyFree(&pBlocks[uNumBlocks++], (sFreeBlock *)pActualNext);
+			}
+
+			pAlloc = pAlloc->pNext;
+		}
+
+		m_pSnapshotNext = pAlloc;
+		pSnapshot->uGeneration = m_uGeneration;
+		pSnapshot->uSlices++;
+		if(!pAlloc)
+			pSnapshot->bFinished = true;
+		HEAP_THREADUNLOCK
+
+		return uNumBlocks;
+	}
+
+	//  Description:
+	//		Reports the heap header line of a snapshot to the file output.  The same line ReportAllocationsMemoryOrder starts a heap with.
+	//		Does not lock or read the heap.
+	//  See Also:
+	//		SnapshotSlice, ReportSnapshotBlocks
+	//  Arguments:
+	//		pLogToFile - Full path and file name null terminated string. NULL if you do not wish to generate a file.
+	//		rSnapshot - Snapshot after its first slice.
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Reports the heap header of a snapshot.
+	void cHeap::ReportSnapshotHeader(const jrs_i8 *pLogToFile, const sSnapshot &rSnapshot)
+	{
+#ifdef JRS64BIT
+		const jrs_u32 uBits = 64;
+#else
+		const jrs_u32 uBits = 32;
+#endif
+
+		cMemoryManager::DebugOutputFile(pLogToFile, g_ReportHeapCreate, 
+			"_HeapHeadMarker_; %s; %llu; %u; %u; %llu; %llu; %llu; %llu; %u; %llu; %u; %llu; %llu; %u", 
+			rSnapshot.HeapName, rSnapshot.uHeapSize, rSnapshot.bHeapIsUserManaged ? 1 : 0, 
+			rSnapshot.uDefaultAlignment, rSnapshot.uMinAllocSize, 
+			rSnapshot.uMaxAllocSize, rSnapshot.uHeapAddress, 
+			g_uBaseAddressOffsetCalculation, 
+#ifdef JRSMEMORYMICROSOFTPLATFORMS
+			1,
+#else
+			0,
+#endif
+			(jrs_u64)cMemoryManager::Get().SizeofAllocatedBlock(), uBits,
+			(jrs_u64)((jrs_sizet)cMemoryManager::Get().m_pUseableMemoryStart), (jrs_u64)((jrs_sizet)cMemoryManager::Get().m_pUseableMemoryEnd), JRSMEMORY_CALLSTACKDEPTH);	
+
+		if(g_ReportHeap && g_ReportHeapCreate)
+			g_ReportHeapCreate = false;
+	}
+
+	//  Description:
+	//		Reports blocks copied by SnapshotSlice to the file output.  Each block is the same line ReportAllocationsMemoryOrder writes for it.
+	//		Does not lock or read the heap so slow outputs never hold it up.
+	//  See Also:
+	//		SnapshotSlice, ReportSnapshotHeader
+	//  Arguments:
+	//		pLogToFile - Full path and file name null terminated string. NULL if you do not wish to generate a file.
+	//		rSnapshot - Snapshot the blocks belong to.
+	//		pBlocks - Blocks returned by SnapshotSlice.
+	//		uNumBlocks - Number of blocks.
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Reports the blocks of a snapshot.
+	void cHeap::ReportSnapshotBlocks(const jrs_i8 *pLogToFile, const sSnapshot &rSnapshot, const sSnapshotBlock *pBlocks, jrs_u32 uNumBlocks)
+	{
+		jrs_i8 logtext[1024];
+		for(jrs_u32 i = 0; i < uNumBlocks; i++)
+		{
+			const sSnapshotBlock &rBlock = pBlocks[i];
+			jrs_i32 iLength;
+			if(rBlock.bFree)
+				iLength = sprintf(logtext, "_Free_; %s; %llu; %llu; %u; %llu; %s", rSnapshot.HeapName, rBlock.uAddress, rBlock.uSize, 0, (jrs_u64)rBlock.uNumber, rBlock.Name);
+			else
+				iLength = sprintf(logtext, "_Alloc_; %s; %llu; %llu; %llu; %llu; %s", rSnapshot.HeapName, rBlock.uAddress, rBlock.uSize, (jrs_u64)rBlock.uFlag, 
+					(jrs_u64)rBlock.uNumber, rBlock.Name);
+
+			// Write the callstacks
+#ifdef MEMORYMANAGER_ENABLENAMEANDSTACKCHECKS
+			const jrs_sizet *pCallStack = cMemoryManager::Get().GetStackFromId(rBlock.uStackId);
+			for(jrs_u32 cs = 0; cs < JRSMEMORY_CALLSTACKDEPTH; cs++)
+				iLength += sprintf(&logtext[iLength], "; 0x%llx", (jrs_u64)MemoryManagerPlatformAddressToBaseAddress(pCallStack[cs]));
+#else
+			for(jrs_u32 cs = 0; cs < JRSMEMORY_CALLSTACKDEPTH; cs++)
+				iLength += sprintf(&logtext[iLength], "; 0x0");
+#endif
+
+			cMemoryManager::DebugOutputFile(pLogToFile, false, "%s", logtext);
+		}
+	}
+
 	//  Description:
 	//		Resets the heap statistics to the current values. 
 	//  See Also:
@@ -3725,6 +4891,7 @@ namespace Elephant
 
 							// Remove the link							
 							sAllocatedBlock *pNextA = pLink->pNext;
+							SnapshotRemoveBlock((sAllocatedBlock *)pLink, pNextA);
 							if(pNextA)
 								pNextA->pPrev = NULL;
 							if(pPN)
@@ -3767,6 +4934,7 @@ namespace Elephant
 							RemoveBinAllocation((sFreeBlock *)pStartAdd);
 
 							// Remove the link			
+							SnapshotRemoveBlock((sAllocatedBlock *)pLink, pLink->pNext);
 							pPL->pLinkedNext = pPN;
 							if(pPN)
 							{
@@ -3855,6 +5023,7 @@ namespace Elephant
 						HeapWarning(bCanFree, JRSMEMORYERROR_FATAL, "Must always be able to free this block");
 
 						// Move the main free block back
+						SnapshotRemoveBlock((sAllocatedBlock *)pLink, pLink->pNext);
 						sAllocatedBlock *pPrevA = pLink->pPrev;
 						jrs_i8 *pEnd = (jrs_i8 *)pPrevA + pPrevA->uSize + sizeof(sAllocatedBlock);
 						if(pPrevA)
@@ -3880,6 +5049,7 @@ namespace Elephant
 						// Move the main free block back
 						m_pMainFreeBlock = pNewFreeBlock;
 						m_pHeapEndAddress = (jrs_i8 *)pLink;
+						UpdateZeroMemory();
 
 						// Free the block
 						ReclaimBetweenMemoryAddresses(pStartOfFreeAddress, pEndOfFreeAddress);
@@ -3955,6 +5125,7 @@ namespace Elephant
 
 				if(pMem >= pSE && pMemEnd <= pEE)
 				{
+					cMemoryManager::Get().RemoveHeapRanges(this, pMem);
 					m_systemFree(pMem, uSize);
 					pRAllocs[i - 2] = pRAllocs[cMemoryManager::Get().m_uResizableCount - 2];
 					pRAllocs[cMemoryManager::Get().m_uResizableCount - 2] = 0;
@@ -3964,6 +5135,7 @@ namespace Elephant
 					cMemoryManager::Get().m_uResizableCount -= 2;
 			
 					m_uHeapSize -= (jrs_sizet)uSize;
+					m_uResizeCount++;
 					break;
 				}
 			}
@@ -13,6 +13,10 @@ Not for disclosure or distribution without Jury Rig Software Ltd's prior written
 #include <JRSMemory.h>
 #endif
 
+// Heap locking shared by every cHeap source file.  The lock is timed while latency statistics are enabled.
+#define HEAP_THREADLOCK if(m_bThreadSafe) { if(m_bLatencyStats) LatencyLock(); else m_pThreadLock->Lock(); }
+#define HEAP_THREADUNLOCK if(m_bThreadSafe) { if(m_bLatencyStats) LatencyUnlock(); else m_pThreadLock->Unlock(); }
+
 namespace Elephant
 {
 	// Enhanced debugging clear value
@@ -21,6 +25,9 @@ namespace Elephant
 	// String length
 	static const jrs_u32 MemoryManager_StringLength = 40;
 
+	// Size of each region of the non intrusive heap memory tracking side table
+	static const jrs_u32 MemoryManager_NIDebugRegionSize = 64 * 1024;
+
 	// Sentinel block values
 	static const jrs_u32 MemoryManager_SentinelValueFreeBlock = 0xfdffdfdd;
 	static const jrs_u32 MemoryManager_SentinelValueAllocatedBlock = 0xfacceedd;
@@ -51,7 +58,8 @@ namespace Elephant
 		jrs_i8 Name[MemoryManager_StringLength];			// Text of the allocation block.
 		jrs_u32 uExternalId;								// External Id
 		jrs_u32 uHeapId;									// Id check of the heap that allocated this block
-		jrs_sizet uCallsStack[JRSMEMORY_CALLSTACKDEPTH];	// Callstacks.
+		jrs_u32 uStackId;									// Callstack id in the stack table.  0 for none.
+		jrs_u32 uPad[3];
 	#endif
 
 	#ifdef MEMORYMANAGER_ENABLESENTINELCHECKS
@@ -79,7 +87,8 @@ namespace Elephant
 		jrs_i8 Name[MemoryManager_StringLength];
 		jrs_u32 uExternalId;								// External Id
 		jrs_u32 uHeapId;									// Id check of the heap that allocated this block
-		jrs_sizet uCallsStack[JRSMEMORY_CALLSTACKDEPTH];
+		jrs_u32 uStackId;									// Callstack id in the stack table.  0 for none.
+		jrs_u32 uPad[3];
 	#endif
 
 	#ifdef MEMORYMANAGER_ENABLESENTINELCHECKS		
@@ -105,7 +114,8 @@ namespace Elephant
 		jrs_i8 Name[MemoryManager_StringLength];			// Text of the allocation block.
 		jrs_u32 uExternalId;								// External Id
 		jrs_u32 uHeapId;									// Id check of the heap that allocated this block
-		jrs_sizet uCallsStack[JRSMEMORY_CALLSTACKDEPTH];	// Callstacks.
+		jrs_u32 uStackId;									// Callstack id in the stack table.  0 for none.
+		jrs_u32 uPad[3];
 #endif
 
 #ifdef MEMORYMANAGER_ENABLESENTINELCHECKS
@@ -121,11 +131,17 @@ namespace Elephant
 	extern void *MemoryManagerDefaultSystemAllocator(jrs_u64 uSize, void *pExtMemoryPtr);
 	extern void MemoryManagerDefaultSystemFree(void *pFree, jrs_u64 uSize);
 	extern void MemoryManagerLiveViewTransfer(void *pData, int size, const char *pFilePathAndName, jrs_bool bAppend);
+	extern void MemoryManagerLiveViewWake(void);
 	extern void MemoryManagerPlatformInit(void);
 	extern void MemoryManagerPlatformDestroy(void);
 	extern jrs_sizet MemoryManagerPlatformAddressToBaseAddress(jrs_sizet uAddress);
 	extern void MemoryManagerPlatformFunctionNameFromAddress(jrs_sizet uAddress, jrs_i8 *pName, jrs_sizet *pFuncStartAdd, jrs_sizet *pFuncSize);
 	extern jrs_sizet MemoryManagerSystemPageSize(void);
+	extern jrs_bool MemoryManagerDefaultSystemRelease(void *pAddress, jrs_u64 uSize);
+	extern jrs_u32 MemoryManagerDefaultSystemZeroFlags(void);
+	extern void MemoryManagerPlatformWriteModuleMap(MemoryManagerOutputToFile Output, const jrs_i8 *pFilePathAndName);
+	extern void *MemoryManagerPlatformCreateSharedPage(const jrs_i8 *pName, jrs_sizet uSize);
+	extern void MemoryManagerPlatformDestroySharedPage(const jrs_i8 *pName, void *pPage, jrs_sizet uSize);
 
 } // Namespace
 
@@ -21,6 +21,21 @@ Not for disclosure or distribution without Jury Rig Software Ltd's prior written
 // Has sockets?
 #ifdef JRSMEMORY_HASSOCKETS
 
+// Linux serves several clients from one epoll loop.  Other platforms serve one client with select.
+#if defined(JRSUNIXPLATFORM) && defined(__linux__)
+#define JRSMEMORY_LIVEVIEWEPOLL
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#endif
+
 namespace Elephant
 {
 	// Socket wrapped functions.  This is based on sockets but left open enough to deal with platforms that cannot manage this.  These extern to
@@ -63,6 +78,7 @@ namespace Elephant
 	// Send buffer size for sending data
 	static const jrs_i32 m_LVSendBufSize = 16 * 1024;
 
+#ifndef JRSMEMORY_LIVEVIEWEPOLL
 	// Buffer to store data being sent.
 	static char m_LVSendBuf[m_LVSendBufSize];
 
@@ -77,6 +93,11 @@ namespace Elephant
 
 	// Current location of read in the recv buffer
 	static jrs_i32 m_LVRecvBufRead = 0;
+#endif
+
+	// Heap blocks copied by each slice of an overview.  The heap is locked while this many are copied.
+	static const jrs_u32 MemoryManager_LVSnapshotSlice = 256;
+	static cHeap::sSnapshotBlock m_LVSnapshotBlocks[MemoryManager_LVSnapshotSlice];
 
 	// Static type values for sending of data.
 	static const jrs_u32 MemoryManager_PoolDetailType = 5;
@@ -84,6 +105,9 @@ namespace Elephant
 	static const jrs_u32 MemoryManager_MethodInformation = 8;
 	static const jrs_u32 MemoryManager_MethodInformationSend = 9;
 
+	// sHeapData header.  1 was the layout with 32 bit totals.
+	static const jrs_u32 MemoryManager_HeapDataHeader = 2;
+
 	// Each packet has this structure.  
 	struct sPacket
 	{
@@ -107,8 +131,8 @@ namespace Elephant
 	{
 		jrs_u32 Header;
 		jrs_u32 Id;
-		jrs_u32 TotalAllocations;
-		jrs_u32 TotalSize;
+		jrs_u64 TotalAllocations;
+		jrs_u64 TotalSize;
 
 		// Swaps data on big endian systems only.
 		void SwapToLittleEndian(void)
@@ -195,7 +219,84 @@ namespace Elephant
 		}
 	};
 
-	
+	// Stages of an overview.
+	enum eLVOverview
+	{
+		eLVOverview_Start,
+		eLVOverview_Heaps,
+		eLVOverview_UserHeaps,
+		eLVOverview_NIHeaps,
+		eLVOverview_End,
+		eLVOverview_Finished
+	};
+
+	// Progress of an overview.  An overview is sent a step at a time, one heap slice, pool or non intrusive heap per step, so the
+	// Linux server can go back to its other clients and the operation ring between steps.
+	struct sLVOverview
+	{
+		jrs_u32 uStage;							// eLVOverview stage.
+		jrs_u32 uIndex;							// Heap index within the stage.
+		jrs_u32 uPool;							// Pools of the heap already sent.
+		jrs_u32 uChanges;						// Changes made to the heaps while they were being sent.
+		jrs_bool bHeader;						// The heap's report header has been sent.
+		jrs_bool bPools;						// The heap's blocks have been sent.  Its pools are next.
+		cHeap::sSnapshot Snapshot;
+
+		sLVOverview() : uStage(eLVOverview_Start), uIndex(0), uPool(0), uChanges(0), bHeader(false), bPools(false) {};
+	};
+
+#ifdef JRSMEMORY_LIVEVIEWEPOLL
+	// A client of the Linux server.  Socket is -1 while the slot is free.
+	struct sLVClient
+	{
+		jrs_socket Socket;
+		jrs_i8 *pQueue;							// Data the socket has not taken yet.  Always sent before anything newer.
+		jrs_u32 uQueueSize;
+		jrs_u32 uQueueBase;						// Size the queue was created with.  It grows to hold a request's output and shrinks once sent.
+		jrs_u32 uQueueRead;
+		jrs_u32 uQueueWrite;
+		jrs_u32 uRecvSize;						// Bytes of a part received command in Recv.
+		jrs_i8 Recv[sizeof(sPacket)];
+		jrs_bool bStreaming;					// Receives the continuous operations.
+		jrs_bool bMapRetrieve;					// Waiting for a map file.  Heap status is not sent.
+		jrs_bool bWaitingWrite;					// Registered for EPOLLOUT.
+		jrs_bool bClosing;						// Failed or disconnected.  Closed at the end of the pass.
+		jrs_bool bOverview;						// An overview has been asked for and not finished.
+		sLVOverview Overview;
+	};
+
+	// epoll ids of the sockets that are not clients.  Clients use their slot number.
+	static const jrs_u32 MemoryManager_LVEventServer = MemoryManager_MaxLiveViewClients;
+	static const jrs_u32 MemoryManager_LVEventLocal = MemoryManager_MaxLiveViewClients + 1;
+	static const jrs_u32 MemoryManager_LVEventWake = MemoryManager_MaxLiveViewClients + 2;
+
+	// Client slots.
+	static sLVClient m_LVClients[MemoryManager_MaxLiveViewClients];
+
+	// Client JRSMemory_LiveView_Send queues data for.
+	static sLVClient *m_pLVClient = NULL;
+
+	// Client whose overview is being sent.  Overviews go one at a time as a heap only tracks one snapshot.
+	static sLVClient *m_pLVOverviewClient = NULL;
+
+	// Set while answering a client's request.  Only then may JRSMemory_LiveView_Send grow that client's queue.
+	static jrs_bool m_bLVSendCanGrow = FALSE;
+
+	// Allocator the client queues come from.  Set by the thread so the queues can grow outside it.
+	static MemoryManagerDefaultAllocator m_LVQueueAllocator = NULL;
+	static MemoryManagerDefaultFree m_LVQueueFree = NULL;
+
+	// Largest a client's queue grows to, in multiples of its starting size.
+	static const jrs_u32 MemoryManager_LVQueueGrowthMax = 16;
+
+	// Most overview steps sent each pass so the operation ring is still emptied while a large overview goes out.
+	static const jrs_u32 MemoryManager_LVOverviewSteps = 64;
+
+	// Written by allocating threads to wake the server when the operation ring is filling up.  Kept open for the life of the process so a late
+	// write can never land on a reused descriptor.
+	static int m_iLVWakeEvent = -1;
+	static volatile jrs_u32 m_uLVWakePending = 0;
+#endif
 
 	//  Description:
 	//      Closes the network connection.  Internal only.
@@ -227,6 +328,242 @@ namespace Elephant
 		return OpenSocket(rServerSocket, cMemoryManager::Get().GetLVPortNumber());
 	}
 
+#ifdef JRSMEMORY_LIVEVIEWEPOLL
+	//  Description:
+	//      Opens a unix domain socket for local clients to connect to.  Internal only.
+	//  See Also:
+	//      InitializeLiveViewServer
+	//  Arguments:
+	//      rSocket - Returns the listening socket.
+	//		pPath - Path of the socket.  A socket already at the path is replaced.
+	//  Return Value:
+	//      TRUE if the socket is listening.  FALSE otherwise.
+	//  Summary:
+	//      Opens a unix domain socket.
+	static jrs_bool JRSMemory_LiveView_OpenLocalSocket(int &rSocket, const jrs_i8 *pPath)
+	{
+		sockaddr_un Address;
+		memset(&Address, 0, sizeof(Address));
+		Address.sun_family = AF_UNIX;
+		jrs_sizet uLength = strlen(pPath);
+		if(uLength > sizeof(Address.sun_path) - 1)
+			uLength = sizeof(Address.sun_path) - 1;
+		memcpy(Address.sun_path, pPath, uLength);
+		Address.sun_path[uLength] = 0;
+
+		rSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if(rSocket < 0)
+			return FALSE;
+
+		// Remove a socket left behind by an earlier run.  Anything else at the path is left alone and bind fails.
+		struct stat Stat;
+		if(lstat(pPath, &Stat) == 0 && S_ISSOCK(Stat.st_mode))
+			unlink(pPath);
+
+		if(bind(rSocket, (sockaddr *)&Address, sizeof(Address)) < 0 || listen(rSocket, MemoryManager_MaxLiveViewClients) < 0)
+		{
+			close(rSocket);
+			rSocket = -1;
+			return FALSE;
+		}
+
+		return TRUE;
+	}
+
+	//  Description:
+	//      Makes room for uSize bytes at the end of a client's queue.  Moves the unsent data to the start of the queue if needed.  Internal only.
+	//  See Also:
+	//      JRSMemory_LiveView_Flush
+	//  Arguments:
+	//      pClient - Client.
+	//		uSize - Bytes needed.
+	//  Return Value:
+	//      TRUE if the queue has room.  FALSE otherwise.
+	//  Summary:
+	//      Makes room in a client's queue.
+	static jrs_bool JRSMemory_LiveView_QueueSpace(sLVClient *pClient, jrs_u32 uSize)
+	{
+		if(pClient->uQueueWrite + uSize <= pClient->uQueueSize)
+			return TRUE;
+
+		jrs_u32 uQueued = pClient->uQueueWrite - pClient->uQueueRead;
+		if(uQueued + uSize > pClient->uQueueSize)
+			return FALSE;
+
+		memmove(pClient->pQueue, pClient->pQueue + pClient->uQueueRead, uQueued);
+		pClient->uQueueRead = 0;
+		pClient->uQueueWrite = uQueued;
+		return TRUE;
+	}
+
+	//  Description:
+	//      Sends a client's queue followed by an optional header and data without waiting.  The header and data are sent from where they are and
+	//		only what the socket would not take is copied to the queue.  The client is marked as closing if the socket failed or the queue cannot
+	//		hold the remainder.  Internal only.
+	//  See Also:
+	//      JRSMemory_LiveView_Send, JRSMemory_LiveView_SendOperationData
+	//  Arguments:
+	//      pClient - Client to send to.
+	//		pHeader - Header to send after the queue.  NULL if uHeaderSize is 0.
+	//		uHeaderSize - Size of the header in bytes.
+	//		pData - Data to send after the header.  NULL if uDataSize is 0.
+	//		uDataSize - Size of the data in bytes.
+	//  Return Value:
+	//      TRUE if everything was sent or queued.  FALSE if the client is closing.
+	//  Summary:
+	//      Sends a client's queue and new data without waiting.
+	static jrs_bool JRSMemory_LiveView_Flush(sLVClient *pClient, const void *pHeader, jrs_u32 uHeaderSize, const void *pData, jrs_u32 uDataSize)
+	{
+		if(pClient->bClosing)
+			return FALSE;
+
+		iovec Vecs[3];
+		jrs_u32 uNumVecs = 0;
+		jrs_u32 uQueued = pClient->uQueueWrite - pClient->uQueueRead;
+		if(uQueued)
+		{
+			Vecs[uNumVecs].iov_base = pClient->pQueue + pClient->uQueueRead;
+			Vecs[uNumVecs++].iov_len = uQueued;
+		}
+		if(uHeaderSize)
+		{
+			Vecs[uNumVecs].iov_base = (void *)pHeader;
+			Vecs[uNumVecs++].iov_len = uHeaderSize;
+		}
+		if(uDataSize)
+		{
+			Vecs[uNumVecs].iov_base = (void *)pData;
+			Vecs[uNumVecs++].iov_len = uDataSize;
+		}
+
+		if(!uNumVecs)
+			return TRUE;
+
+		msghdr Message;
+		memset(&Message, 0, sizeof(Message));
+		Message.msg_iov = Vecs;
+		Message.msg_iovlen = uNumVecs;
+		ssize_t iSent = sendmsg((int)pClient->Socket, &Message, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if(iSent < 0)
+		{
+			if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			{
+				pClient->bClosing = TRUE;
+				return FALSE;
+			}
+
+			iSent = 0;
+		}
+
+		// The queue went first.
+		jrs_u32 uSent = (jrs_u32)iSent;
+		jrs_u32 uQueueSent = uSent < uQueued ? uSent : uQueued;
+		pClient->uQueueRead += uQueueSent;
+		uSent -= uQueueSent;
+		if(pClient->uQueueRead == pClient->uQueueWrite)
+			pClient->uQueueRead = pClient->uQueueWrite = 0;
+
+		// Queue what is left of the header and data behind it.
+		jrs_u32 uHeaderSent = uSent < uHeaderSize ? uSent : uHeaderSize;
+		jrs_u32 uHeaderLeft = uHeaderSize - uHeaderSent;
+		jrs_u32 uDataLeft = uDataSize - (uSent - uHeaderSent);
+		if(!uHeaderLeft && !uDataLeft)
+			return TRUE;
+
+		if(!JRSMemory_LiveView_QueueSpace(pClient, uHeaderLeft + uDataLeft))
+		{
+			// Too far behind.  Dropped rather than holding up the operation ring.
+			pClient->bClosing = TRUE;
+			return FALSE;
+		}
+
+		if(uHeaderLeft)
+		{
+			memcpy(pClient->pQueue + pClient->uQueueWrite, (const jrs_i8 *)pHeader + uHeaderSent, uHeaderLeft);
+			pClient->uQueueWrite += uHeaderLeft;
+		}
+		if(uDataLeft)
+		{
+			memcpy(pClient->pQueue + pClient->uQueueWrite, (const jrs_i8 *)pData + (uDataSize - uDataLeft), uDataLeft);
+			pClient->uQueueWrite += uDataLeft;
+		}
+
+		return TRUE;
+	}
+
+	//  Description:
+	//      Grows a client's queue to hold uSize more bytes.  The unsent data is moved to the start of the new queue.  Internal only.
+	//  See Also:
+	//      JRSMemory_LiveView_Send
+	//  Arguments:
+	//      pClient - Client.
+	//		uSize - Bytes needed.
+	//  Return Value:
+	//      TRUE if the queue has room.  FALSE if it would grow past MemoryManager_LVQueueGrowthMax times its starting size or there is no
+	//		memory.
+	//  Summary:
+	//      Grows a client's queue.
+	static jrs_bool JRSMemory_LiveView_GrowQueue(sLVClient *pClient, jrs_u32 uSize)
+	{
+		jrs_u32 uQueued = pClient->uQueueWrite - pClient->uQueueRead;
+		jrs_u64 uNewSize = (jrs_u64)pClient->uQueueSize * 2;
+		if(uNewSize < (jrs_u64)uQueued + uSize)
+			uNewSize = (jrs_u64)uQueued + uSize;
+		if(uNewSize > (jrs_u64)pClient->uQueueBase * MemoryManager_LVQueueGrowthMax)
+			return FALSE;
+
+		jrs_i8 *pQueue = (jrs_i8 *)m_LVQueueAllocator(uNewSize, NULL);
+		if(!pQueue)
+			return FALSE;
+
+		memcpy(pQueue, pClient->pQueue + pClient->uQueueRead, uQueued);
+		m_LVQueueFree(pClient->pQueue, pClient->uQueueSize);
+		pClient->pQueue = pQueue;
+		pClient->uQueueSize = (jrs_u32)uNewSize;
+		pClient->uQueueRead = 0;
+		pClient->uQueueWrite = uQueued;
+		return TRUE;
+	}
+
+	//  Description:
+	//      Queues data for the client currently being served.  It is sent at the end of the pass or when the socket can take it.  This never
+	//		waits.  When the queue is full a client's own request grows that client's queue.  Anything else closes the client rather than hold
+	//		up the others.  Internal only.
+	//  See Also:
+	//      JRSMemory_LiveView_Flush, JRSMemory_LiveView_GrowQueue
+	//  Arguments:
+	//		rSendSocket - Ignored.  The data goes to the client being served.
+	//		pData - Data to send.
+	//		iSize - Size of data in bytes to send.
+	//		uFlags - Ignored.  Everything is buffered.
+	//  Return Value:
+	//      TRUE if the data was queued. FALSE if the client is closing.
+	//  Summary:
+	//     Sends data.
+	jrs_bool JRSMemory_LiveView_Send(jrs_socket &rSendSocket, const char *pData, jrs_i32 iSize, jrs_u32 uFlags)
+	{
+		sLVClient *pClient = m_pLVClient;
+		if(!pClient || pClient->bClosing)
+			return FALSE;
+
+		if(!JRSMemory_LiveView_QueueSpace(pClient, (jrs_u32)iSize))
+		{
+			// Whatever the socket takes now makes room
+			if(!JRSMemory_LiveView_Flush(pClient, NULL, 0, NULL, 0))
+				return FALSE;
+
+			if(!JRSMemory_LiveView_QueueSpace(pClient, (jrs_u32)iSize) && (!m_bLVSendCanGrow || !JRSMemory_LiveView_GrowQueue(pClient, (jrs_u32)iSize)))
+			{
+				pClient->bClosing = TRUE;
+				return FALSE;
+			}
+		}
+
+		memcpy(pClient->pQueue + pClient->uQueueWrite, pData, iSize);
+		pClient->uQueueWrite += iSize;
+		return TRUE;
+	}
+#else
 	//  Description:
 	//      Checks if there is any remaining data to process in the recv buffer.  Internal only.
 	//  See Also:
@@ -402,6 +739,7 @@ namespace Elephant
 
 		return TRUE;
 	}
+#endif
 
 	//  Description:
 	//      Sends the current memory manager status. Internal only.
@@ -467,7 +805,34 @@ namespace Elephant
 	}
 
 	//  Description:
-	//      Sends the current status of each heap. Internal only.
+	//      Sends one packet of heap status. Internal only.
+	//  See Also:
+	//      JRSMemory_LiveView_SendAllocationDetails
+	//  Arguments:
+	//     pData - Heap data already swapped to little endian.
+	//	   iCount - Number of entries.
+	//  Return Value:
+	//     TRUE if successful.  False otherwise.
+	//  Summary:
+	//     Sends one packet of heap status.
+	static jrs_bool JRSMemory_LiveView_SendHeapData(const sHeapData *pData, jrs_i32 iCount)
+	{
+		sPacket packet;
+		packet.TimeMS = m_uLVTimeElapsed;
+		packet.Count = iCount;
+		packet.Type = 1;
+		packet.Size = sizeof(sHeapData) * iCount;
+		packet.SwapToLittleEndian();
+
+		if(!JRSMemory_LiveView_Send(m_ClientSocket, (const char *)&packet, sizeof(sPacket), 0)) return FALSE;
+		if(!JRSMemory_LiveView_Send(m_ClientSocket, (const char *)pData, sizeof(sHeapData) * iCount, 0)) return FALSE;
+
+		return TRUE;
+	}
+
+	//  Description:
+	//      Sends the current status of each heap. Internal only.  The registry can hold any number of heaps so they are sent in packets
+	//		of up to HeapDataBatch entries.
 	//  See Also:
 	//      
 	//  Arguments:
@@ -478,20 +843,27 @@ namespace Elephant
 	//     Sends the current status of each heap.
 	jrs_bool JRSMemory_LiveView_SendAllocationDetails(void)
 	{
+		const jrs_i32 HeapDataBatch = MemoryManager_MaxHeaps + MemoryManager_MaxUserHeaps + MemoryManager_MaxNonIntrusiveHeaps;
 		jrs_i32 heapc = 0;
-		sHeapData data[MemoryManager_MaxHeaps + MemoryManager_MaxUserHeaps + MemoryManager_MaxNonIntrusiveHeaps];	
+		jrs_bool bSent = FALSE;
+		sHeapData data[HeapDataBatch];	
 
 		for(jrs_u32 i = 0; i < cMemoryManager::Get().GetMaxNumHeaps(); i++)
 		{
 			cHeap *pHeap = cMemoryManager::Get().GetHeap(i);
 			if(pHeap)
 			{
-				data[heapc].Header = 1;
+				data[heapc].Header = MemoryManager_HeapDataHeader;
 				data[heapc].Id = pHeap->GetUniqueId();
 				data[heapc].TotalAllocations = pHeap->GetNumberOfAllocations();
-				data[heapc].TotalSize = (jrs_u32)pHeap->GetMemoryUsed();
+				data[heapc].TotalSize = (jrs_u64)pHeap->GetMemoryUsed();
 				data[heapc].SwapToLittleEndian();
-				heapc++;
+				if(++heapc == HeapDataBatch)
+				{
+					if(!JRSMemory_LiveView_SendHeapData(data, heapc)) return FALSE;
+					heapc = 0;
+					bSent = TRUE;
+				}
 			}
 		}
 
@@ -500,12 +872,17 @@ namespace Elephant
 			cHeap *pHeap = cMemoryManager::Get().GetUserHeap(i);
 			if(pHeap)
 			{
-				data[heapc].Header = 1;
+				data[heapc].Header = MemoryManager_HeapDataHeader;
 				data[heapc].Id = pHeap->GetUniqueId();
 				data[heapc].TotalAllocations = pHeap->GetNumberOfAllocations();
-				data[heapc].TotalSize = (jrs_u32)pHeap->GetMemoryUsed();
+				data[heapc].TotalSize = (jrs_u64)pHeap->GetMemoryUsed();
 				data[heapc].SwapToLittleEndian();
-				heapc++;
+				if(++heapc == HeapDataBatch)
+				{
+					if(!JRSMemory_LiveView_SendHeapData(data, heapc)) return FALSE;
+					heapc = 0;
+					bSent = TRUE;
+				}
 			}
 		}
 
@@ -514,24 +891,22 @@ namespace Elephant
 			cHeapNonIntrusive *pHeap = cMemoryManager::Get().GetNIHeap(i);
 			if(pHeap)
 			{
-				data[heapc].Header = 1;
+				data[heapc].Header = MemoryManager_HeapDataHeader;
 				data[heapc].Id = pHeap->GetUniqueId();
 				data[heapc].TotalAllocations = pHeap->GetNumberOfAllocations();
-				data[heapc].TotalSize = (jrs_u32)pHeap->GetMemoryUsed();
+				data[heapc].TotalSize = (jrs_u64)pHeap->GetMemoryUsed();
 				data[heapc].SwapToLittleEndian();
-				heapc++;
+				if(++heapc == HeapDataBatch)
+				{
+					if(!JRSMemory_LiveView_SendHeapData(data, heapc)) return FALSE;
+					heapc = 0;
+					bSent = TRUE;
+				}
 			}
 		}
 
-		sPacket packet;
-		packet.TimeMS = m_uLVTimeElapsed;
-		packet.Count = heapc;
-		packet.Type = 1;
-		packet.Size = sizeof(sHeapData) * heapc;
-		packet.SwapToLittleEndian();
-
-		if(!JRSMemory_LiveView_Send(m_ClientSocket, (const char *)&packet, sizeof(sPacket), 0)) return FALSE;
-		if(!JRSMemory_LiveView_Send(m_ClientSocket, (const char *)data, sizeof(sHeapData) * heapc, 0)) return FALSE;
+		// The remainder.  An empty packet is still sent when there are no heaps.
+		if((heapc || !bSent) && !JRSMemory_LiveView_SendHeapData(data, heapc)) return FALSE;
 
 		// Send the pool details
 		for(jrs_u32 i = 0; i < cMemoryManager::Get().GetMaxNumHeaps(); i++)
@@ -543,6 +918,7 @@ namespace Elephant
 				while(pPool)
 				{
 					// Create the packet details
+					sPacket packet;
 					packet.Count = 1;
 					packet.Type = MemoryManager_PoolDetailType;
 					packet.Size = sizeof(sPoolData);
@@ -804,6 +1180,68 @@ namespace Elephant
 
 
 
+#ifdef JRSMEMORY_LIVEVIEWEPOLL
+	//  Description:
+	//      Sends a block of the operation ring to every client receiving the continuous operations.  Each client is sent the block straight from
+	//		the ring.  Only the part a client's socket would not take is copied, to its queue, so the ring can always be released.  Internal only.
+	//  See Also:
+	//      JRSMemory_LiveView_SendOperations
+	//  Arguments:
+	//		rPacket - Packet header already swapped to little endian.
+	//		pData - Start of the block in the ring.
+	//		uSize - Size of the block in bytes.
+	//  Return Value:
+	//      TRUE.  Clients that fall too far behind are closed instead.
+	//  Summary:
+	//      Sends a block of the operation ring.
+	static jrs_bool JRSMemory_LiveView_SendOperationData(const sPacket &rPacket, const jrs_u8 *pData, jrs_u32 uSize)
+	{
+		for(jrs_u32 i = 0; i < MemoryManager_MaxLiveViewClients; i++)
+		{
+			sLVClient *pClient = &m_LVClients[i];
+			if(pClient->Socket >= 0 && pClient->bStreaming)
+				JRSMemory_LiveView_Flush(pClient, &rPacket, sizeof(sPacket), pData, uSize);
+		}
+
+		return TRUE;
+	}
+#else
+	//  Description:
+	//      Sends a block of the operation ring in 16k chunks.  Internal only.
+	//  See Also:
+	//      JRSMemory_LiveView_SendOperations
+	//  Arguments:
+	//		rPacket - Packet header already swapped to little endian.
+	//		pData - Start of the block in the ring.
+	//		uSize - Size of the block in bytes.
+	//  Return Value:
+	//      TRUE if data was sent.  FALSE for error.
+	//  Summary:
+	//      Sends a block of the operation ring.
+	static jrs_bool JRSMemory_LiveView_SendOperationData(const sPacket &rPacket, const jrs_u8 *pData, jrs_u32 uSize)
+	{
+		const jrs_u32 DataSize = 1024 * 16;
+		if(!JRSMemory_LiveView_Send(m_ClientSocket, (const char *)&rPacket, sizeof(sPacket), 1))
+		{
+			return FALSE;
+		}
+
+		while(uSize)
+		{
+			jrs_u32 cop = uSize > DataSize ? DataSize : uSize;
+			if(!JRSMemory_LiveView_Send(m_ClientSocket, (const char *)pData, cop, 1))
+			{
+				return FALSE;
+			}
+
+			pData += cop;
+			uSize -= cop;
+		}
+
+		return TRUE;
+	}
+#endif
+
 	//  Description:
 	//      Sends an the operation data. Internal only.
 	//  See Also:
@@ -826,9 +1264,7 @@ namespace Elephant
 		if(uReadPtr == uWritePtr)
 			return TRUE;
 
-		// Packet size - Send it in 16k chunks
 		sPacket packet;
-		const jrs_u32 DataSize = 1024 * 16;
 		jrs_u32 size = 0;		
 
 		jrs_u32 uNewWrap = uWrapPtr;
@@ -849,25 +1285,12 @@ namespace Elephant
 			packet.Count = 0;
 			packet.SwapToLittleEndian();
 
-			if(!JRSMemory_LiveView_Send(m_ClientSocket, (const char *)&packet, sizeof(sPacket), 1))
+			if(!JRSMemory_LiveView_SendOperationData(packet, pReadPtr, size))
 			{
 				return FALSE;
 			}
 
-			while(size)
-			{
-				jrs_u32 cop = size > DataSize ? DataSize : size;
-				if(!JRSMemory_LiveView_Send(m_ClientSocket, (const char *)pReadPtr, cop, 1))
-				{
-					return FALSE;
-				}
-
-				uReadPtr += cop;
-				pReadPtr += cop;
-				size -= cop;
-			}
-
-			uReadPtr = uReadPtr | (uReadMsb);
+			uReadPtr = uWritePtr | (uReadMsb);
 		}
 		else
 		{
@@ -879,25 +1302,9 @@ namespace Elephant
 			packet.SwapToLittleEndian();
 
 			// It is possible to get a 0 size
-			if(size != 0)
-			{				
-				if(!JRSMemory_LiveView_Send(m_ClientSocket, (const char *)&packet, sizeof(sPacket), 1))
-				{
-					return FALSE;
-				}
-
-				while(size)
-				{
-					jrs_u32 cop = size > DataSize ? DataSize : size;
-					if(!JRSMemory_LiveView_Send(m_ClientSocket, (const char *)pReadPtr, cop, 1))
-					{
-						return FALSE;
-					}
-
-					uReadPtr += cop;
-					pReadPtr += cop;
-					size -= cop;
-				}
+			if(size != 0 && !JRSMemory_LiveView_SendOperationData(packet, pReadPtr, size))
+			{
+				return FALSE;
 			}
 
 			uNewWrap = 0;
@@ -918,9 +1325,152 @@ namespace Elephant
 	}
 
 	//  Description:
-	//      Sends an overview. Internal only.
+	//      Empties the operation ring.  Internal only.
 	//  See Also:
-	//      
+	//      JRSMemory_LiveView_SendOperations
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Empties the operation ring.
+	void cMemoryManager::JRSMemory_LiveView_ResetOperations(void)
+	{
+		cMemoryManager::Get().m_LVThreadLock.Lock();
+		cMemoryManager::Get().m_uELVDBRead = 0;
+		cMemoryManager::Get().m_uELVDBWrite = 0;
+		cMemoryManager::Get().m_uELVDBWriteEnd = 0;
+		cMemoryManager::Get().m_LVThreadLock.Unlock();
+	}
+
+	//  Description:
+	//      Moves an overview on to the next heap of its stage.  Internal only.
+	//  See Also:
+	//      JRSMemory_LiveView_SendOverviewStep
+	//  Arguments:
+	//		rOverview - Overview.
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Moves an overview on to the next heap.
+	static void JRSMemory_LiveView_NextOverviewHeap(sLVOverview &rOverview)
+	{
+		rOverview.uIndex++;
+		rOverview.uPool = 0;
+		rOverview.bHeader = FALSE;
+		rOverview.bPools = FALSE;
+		rOverview.Snapshot = cHeap::sSnapshot();
+	}
+
+	//  Description:
+	//      Sends the next step of an overview.  Internal only.  A step is the start packet, one slice of a heap's allocations, one of the
+	//		heap's pools, one non intrusive heap or the end packet.  A heap is only locked while its slice is copied, never while it is sent, so
+	//		the threads allocating from it are not held up by the size of the heap or a slow client.  The end packet's Count is the number of
+	//		changes made to the heaps while they were being sent.
+	//  See Also:
+	//      JRSMemory_LiveView_SendOverview
+	//  Arguments:
+	//		rOverview - Progress of the overview.  Start with a new one.
+	//  Return Value:
+	//      TRUE once the end packet has been sent.  FALSE if there is more to send.
+	//  Summary:
+	//      Sends the next step of an overview.
+	static jrs_bool JRSMemory_LiveView_SendOverviewStep(sLVOverview &rOverview)
+	{
+		sPacket packet;
+		switch(rOverview.uStage)
+		{
+		case eLVOverview_Start:
+			// Send a packet letting us know what to expect
+			packet.TimeMS = m_uLVTimeElapsed;
+			packet.Count = 0;
+			packet.Type = 3;
+			packet.Size = 0;
+			packet.SwapToLittleEndian();
+			JRSMemory_LiveView_Send(m_ClientSocket, (const char *)&packet, sizeof(sPacket), 1);
+			rOverview.uStage = eLVOverview_Heaps;
+			return FALSE;
+
+		case eLVOverview_Heaps:
+		case eLVOverview_UserHeaps:
+			{
+				jrs_bool bUserHeap = rOverview.uStage == eLVOverview_UserHeaps;
+				if(rOverview.uIndex >= (bUserHeap ? cMemoryManager::Get().GetMaxNumUserHeaps() : cMemoryManager::Get().GetMaxNumHeaps()))
+				{
+					rOverview.uStage++;
+					rOverview.uIndex = 0;
+					return FALSE;
+				}
+
+				cHeap::sSnapshot &rSnapshot = rOverview.Snapshot;
+				if(!rOverview.bPools)
+				{
+					jrs_u32 uNumBlocks = cMemoryManager::Get().SnapshotHeapSlice(rOverview.uIndex, bUserHeap, &rSnapshot, m_LVSnapshotBlocks, MemoryManager_LVSnapshotSlice);
+
+					// No heap at the index or destroyed part way through
+					if(!rSnapshot.uSlices || rSnapshot.bInterrupted)
+					{
+						rOverview.uChanges += rSnapshot.bInterrupted ? 1 : 0;
+						JRSMemory_LiveView_NextOverviewHeap(rOverview);
+						return FALSE;
+					}
+
+					// The header goes before the first blocks
+					if(!rOverview.bHeader)
+					{
+						cHeap::ReportSnapshotHeader(NULL, rSnapshot);
+						rOverview.bHeader = TRUE;
+					}
+					cHeap::ReportSnapshotBlocks(NULL, rSnapshot, m_LVSnapshotBlocks, uNumBlocks);
+					rOverview.bPools = rSnapshot.bFinished;
+					return FALSE;
+				}
+
+				// One pool a step under the pool list lock.  The heap must still be the one the blocks came from.
+				if(!cMemoryManager::Get().ReportHeapPool(rOverview.uIndex, bUserHeap, rSnapshot.uHeapId, rOverview.uPool))
+				{
+					rOverview.uChanges += rSnapshot.uChanges;
+					JRSMemory_LiveView_NextOverviewHeap(rOverview);
+					return FALSE;
+				}
+
+				rOverview.uPool++;
+				return FALSE;
+			}
+
+		case eLVOverview_NIHeaps:
+			{
+				if(rOverview.uIndex >= cMemoryManager::Get().GetMaxNumNIHeaps())
+				{
+					rOverview.uStage = eLVOverview_End;
+					return FALSE;
+				}
+
+				cHeapNonIntrusive *pHeap = cMemoryManager::Get().GetNIHeap(rOverview.uIndex++);
+				if(pHeap)
+					pHeap->ReportAllocationsMemoryOrder();
+				return FALSE;
+			}
+
+		case eLVOverview_End:
+			packet.TimeMS = m_uLVTimeElapsed;
+			packet.Count = rOverview.uChanges;
+			packet.Type = 18;
+			packet.Size = 0;
+			packet.SwapToLittleEndian();
+			JRSMemory_LiveView_Send(m_ClientSocket, (const char *)&packet, sizeof(sPacket), 1);
+			rOverview.uStage = eLVOverview_Finished;
+			return TRUE;
+
+		default:
+			return TRUE;
+		}
+	}
+
+	//  Description:
+	//      Sends a whole overview. Internal only.  The Linux server sends overviews a step at a time instead.
+	//  See Also:
+	//      JRSMemory_LiveView_SendOverviewStep
 	//  Arguments:
 	//		None
 	//  Return Value:
@@ -929,60 +1479,457 @@ namespace Elephant
 	//      Sends an overview.
 	jrs_bool JRSMemory_LiveView_SendOverview(void)
 	{
-		// Send a packet letting us know what to expect
-		sPacket packet;
-		packet.TimeMS = m_uLVTimeElapsed;
-		packet.Count = 0;
-		packet.Type = 3;
-		packet.Size = 0;
-		packet.SwapToLittleEndian();
-		if(!JRSMemory_LiveView_Send(m_ClientSocket, (const char *)&packet, sizeof(sPacket), 1))
+		sLVOverview overview;
+		while(!JRSMemory_LiveView_SendOverviewStep(overview))
 		{
-			return FALSE;
 		}
 
-		// Do the basic reporting and dump the information
-		for(jrs_u32 i = 0; i < cMemoryManager::Get().GetMaxNumHeaps(); i++)
+		return TRUE;
+	}
+
+#ifdef JRSMEMORY_LIVEVIEWEPOLL
+	//  Description:
+	//      Acts on a command from a client.  Internal only.
+	//  See Also:
+	//      JRSMemory_LiveView_Receive
+	//  Arguments:
+	//		pClient - Client that sent the command.
+	//		rPacket - Command.
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Acts on a command from a client.
+	static void JRSMemory_LiveView_ProcessCommand(sLVClient *pClient, const sPacket &rPacket)
+	{
+		m_pLVClient = pClient;
+		m_bLVSendCanGrow = TRUE;
+		switch(rPacket.Type)
 		{
-			cHeap *pHeap = cMemoryManager::Get().GetHeap(i);
-			if(pHeap)
+		case 2:
+			// We want to send the names of heap.
+			JRSMemory_LiveView_SendHeapDetails(rPacket.Count);
+			break;
+		case 3:
+			// We want to send overview information.  Sent a step at a time by the thread.
+			if(!pClient->bOverview)
 			{
-				pHeap->ReportAllocationsMemoryOrder();
+				pClient->Overview = sLVOverview();
+				pClient->bOverview = TRUE;
 			}
+			break;
+		case 4:
+			// We want to start/stop continue logging.  The thread starts and stops the collection as clients ask for it.
+			pClient->bStreaming = !pClient->bStreaming;
+			break;
+		case MemoryManager_PoolInformationType:
+			// We want to send the names of the pools.
+			JRSMemory_LiveView_SendPoolDetails(rPacket.Size, rPacket.Count);
+			break;
+		case MemoryManager_MethodInformation:
+			// We want to send the names of the pools.
+			JRSMemory_LiveView_SendMethodInformation(rPacket.Size, rPacket.Count);
+			break;
+		case MemoryManager_MethodInformationSend:
+			// We will receive heap data
+			pClient->bMapRetrieve = rPacket.Count ? TRUE : FALSE;
+			break;
+		default:
+			break;
 		}
+		m_bLVSendCanGrow = FALSE;
+	}
 
-		for(jrs_u32 i = 0; i < cMemoryManager::Get().GetMaxNumUserHeaps(); i++)
+	//  Description:
+	//      Reads everything waiting on a client's socket and acts on each complete command.  Internal only.
+	//  See Also:
+	//      JRSMemory_LiveView_ProcessCommand
+	//  Arguments:
+	//		pClient - Client to read from.
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Reads a client's commands.
+	static void JRSMemory_LiveView_Receive(sLVClient *pClient)
+	{
+		char buffer[2048];
+		while(!pClient->bClosing)
 		{
-			cHeap *pHeap = cMemoryManager::Get().GetUserHeap(i);
-			if(pHeap)
+			ssize_t iRead = recv((int)pClient->Socket, buffer, sizeof(buffer), MSG_DONTWAIT);
+			if(iRead <= 0)
+			{
+				if(iRead == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+					pClient->bClosing = TRUE;
+				return;
+			}
+
+			// Every command is a single packet.
+			for(ssize_t i = 0; i < iRead; i++)
 			{
-				pHeap->ReportAllocationsMemoryOrder();
+				pClient->Recv[pClient->uRecvSize++] = buffer[i];
+				if(pClient->uRecvSize == sizeof(sPacket))
+				{
+					sPacket packet;
+					memcpy(&packet, pClient->Recv, sizeof(sPacket));
+					packet.SwapToLittleEndian();
+					pClient->uRecvSize = 0;
+					JRSMemory_LiveView_ProcessCommand(pClient, packet);
+				}
 			}
 		}
+	}
 
-		for(jrs_u32 i = 0; i < cMemoryManager::Get().GetMaxNumNIHeaps(); i++)
+	//  Description:
+	//      Wakes the live view thread so it empties the operation ring before its next poll.  Called by allocating threads.  Internal only.
+	//  See Also:
+	//      ContinuousLog_AddToBuffer
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Wakes the live view thread.
+	void MemoryManagerLiveViewWake(void)
+	{
+		if(m_iLVWakeEvent < 0 || m_uLVWakePending)
+			return;
+
+		m_uLVWakePending = 1;
+		jrs_u64 uValue = 1;
+		ssize_t iWritten = write(m_iLVWakeEvent, &uValue, sizeof(uValue));
+		(void)iWritten;
+	}
+
+	//  Description:
+	//		Main Live View thread.  Controls communication with the outside world. Internal only.  Serves up to m_uLVMaxClients clients on the
+	//		LiveView port and the optional unix domain socket from one epoll loop.  Sockets are never waited on so one slow client cannot hold up
+	//		the others or the operation ring.
+	//  See Also:
+	//      InitializeLiveView, InitializeLiveViewServer
+	//  Arguments:
+	//		pArg - Pointer value to active variable of the LV thread.
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Main Live View thread
+	cJRSThread::jrs_threadout cMemoryManager::JRSMemory_LiveViewThread(cJRSThread::jrs_threadin pArg)
+	{
+		jrs_socket ServerSocket;
+		jrs_bool *pActiveLiveView = (jrs_bool *)((jrs_sizet)pArg);
+
+		if(!JRSMemory_LiveView_CreateNetworkConnection(ServerSocket))
 		{
-			cHeapNonIntrusive *pHeap = cMemoryManager::Get().GetNIHeap(i);
-			if(pHeap)
+			*pActiveLiveView = FALSE;
+			JRSThreadReturn(1);
+		}
+
+		int iEpoll = epoll_create1(EPOLL_CLOEXEC);
+		if(iEpoll < 0)
+		{
+			JRSMemory_LiveView_CloseNetworkConnection(ServerSocket);
+			*pActiveLiveView = FALSE;
+			JRSThreadReturn(1);
+		}
+
+		epoll_event Event;
+		memset(&Event, 0, sizeof(Event));
+		Event.events = EPOLLIN;
+		Event.data.u32 = MemoryManager_LVEventServer;
+		fcntl((int)ServerSocket, F_SETFL, fcntl((int)ServerSocket, F_GETFL) | O_NONBLOCK);
+		epoll_ctl(iEpoll, EPOLL_CTL_ADD, (int)ServerSocket, &Event);
+
+		int iLocalSocket = -1;
+		if(m_LVLocalSocketPath[0])
+		{
+			if(JRSMemory_LiveView_OpenLocalSocket(iLocalSocket, m_LVLocalSocketPath))
+			{
+				Event.data.u32 = MemoryManager_LVEventLocal;
+				epoll_ctl(iEpoll, EPOLL_CTL_ADD, iLocalSocket, &Event);
+			}
+			else
 			{
-				pHeap->ReportAllocationsMemoryOrder();
+				DebugOutput("Elephant Memory Manager could not listen for LiveView on %s.", m_LVLocalSocketPath);
 			}
 		}
 
-		packet.TimeMS = m_uLVTimeElapsed;
-		packet.Count = 0;
-		packet.Type = 18;
-		packet.Size = 0;
-		packet.SwapToLittleEndian();
-		if(!JRSMemory_LiveView_Send(m_ClientSocket, (const char *)&packet, sizeof(sPacket), 1))
+		if(m_iLVWakeEvent < 0)
+			m_iLVWakeEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if(m_iLVWakeEvent >= 0)
 		{
-			return FALSE;
+			Event.data.u32 = MemoryManager_LVEventWake;
+			epoll_ctl(iEpoll, EPOLL_CTL_ADD, m_iLVWakeEvent, &Event);
 		}
 
-		// Do we need to send and recieve the mapfile data?
+		for(jrs_u32 i = 0; i < MemoryManager_MaxLiveViewClients; i++)
+			m_LVClients[i].Socket = -1;
+		m_LVQueueAllocator = m_MemoryManagerDefaultAllocator;
+		m_LVQueueFree = m_MemoryManagerDefaultFree;
 
+		// Create the timer
+		cJRSTimer LVTimer;
+		jrs_u32 uLastPoll = 0;
+		m_uLVTimeElapsed = 0;
 
-		return TRUE;
+		while(*pActiveLiveView && cMemoryManager::Get().IsInitialized())
+		{
+			// Wait for the sockets until the next poll.  An overview with room in its client's queue carries straight on.
+			jrs_u32 uSincePoll = LVTimer.GetElapsedTimeMilliSec(true) - uLastPoll;
+			jrs_bool bOverviewReady = FALSE;
+			for(jrs_u32 i = 0; i < MemoryManager_MaxLiveViewClients && !bOverviewReady; i++)
+			{
+				sLVClient *pClient = &m_LVClients[i];
+				if(pClient->Socket >= 0 && pClient->bOverview && pClient->uQueueWrite - pClient->uQueueRead < pClient->uQueueBase / 2)
+					bOverviewReady = TRUE;
+			}
+			epoll_event Events[8];
+			int iNumEvents = epoll_wait(iEpoll, Events, 8, !bOverviewReady && uSincePoll < m_uLiveViewPoll ? (int)(m_uLiveViewPoll - uSincePoll) : 0);
+			for(int e = 0; e < iNumEvents; e++)
+			{
+				jrs_u32 uId = Events[e].data.u32;
+				if(uId == MemoryManager_LVEventServer || uId == MemoryManager_LVEventLocal)
+				{
+					// Accept everyone waiting.  Connections past the client limit are closed straight away.
+					int iListenSocket = uId == MemoryManager_LVEventServer ? (int)ServerSocket : iLocalSocket;
+					int iSocket;
+					while((iSocket = accept4(iListenSocket, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+					{
+						sLVClient *pClient = NULL;
+						for(jrs_u32 i = 0; i < m_uLVMaxClients && !pClient; i++)
+						{
+							if(m_LVClients[i].Socket < 0)
+								pClient = &m_LVClients[i];
+						}
+
+						// The queue can always take a full operation ring.
+						jrs_u32 uQueueSize = m_uLVClientBacklog > cMemoryManager::Get().m_uELVDebugBufferSize ? m_uLVClientBacklog : cMemoryManager::Get().m_uELVDebugBufferSize;
+						jrs_i8 *pQueue = pClient ? (jrs_i8 *)m_MemoryManagerDefaultAllocator(uQueueSize, NULL) : NULL;
+						if(!pQueue)
+						{
+							close(iSocket);
+							continue;
+						}
+
+						jrs_i32 iSendBufSize = 256 * 1024;
+						setsockopt(iSocket, SOL_SOCKET, SO_SNDBUF, &iSendBufSize, sizeof(iSendBufSize));
+
+						*pClient = sLVClient();
+						pClient->Socket = iSocket;
+						pClient->pQueue = pQueue;
+						pClient->uQueueSize = uQueueSize;
+						pClient->uQueueBase = uQueueSize;
+						Event.events = EPOLLIN;
+						Event.data.u32 = (jrs_u32)(pClient - m_LVClients);
+						epoll_ctl(iEpoll, EPOLL_CTL_ADD, iSocket, &Event);
+						m_bLiveViewRunning = TRUE;
+
+						// Send some init data to get us going
+						m_pLVClient = pClient;
+						JRSMemory_LiveView_SendSystemDetails();
+					}
+				}
+				else if(uId == MemoryManager_LVEventWake)
+				{
+					jrs_u64 uValue;
+					ssize_t iRead = read(m_iLVWakeEvent, &uValue, sizeof(uValue));
+					(void)iRead;
+					m_uLVWakePending = 0;
+				}
+				else
+				{
+					sLVClient *pClient = &m_LVClients[uId];
+					if(Events[e].events & EPOLLIN)
+						JRSMemory_LiveView_Receive(pClient);
+					if(Events[e].events & EPOLLOUT)
+						JRSMemory_LiveView_Flush(pClient, NULL, 0, NULL, 0);
+					if(Events[e].events & (EPOLLERR | EPOLLHUP))
+						pClient->bClosing = TRUE;
+				}
+			}
+
+			// Send some of the overview.  Steps only go out while the client's queue is less than half full so a slow client is never waited on
+			// and its queue only grows by what one step adds.
+			if(!m_pLVOverviewClient)
+			{
+				for(jrs_u32 i = 0; i < MemoryManager_MaxLiveViewClients && !m_pLVOverviewClient; i++)
+				{
+					if(m_LVClients[i].Socket >= 0 && !m_LVClients[i].bClosing && m_LVClients[i].bOverview)
+						m_pLVOverviewClient = &m_LVClients[i];
+				}
+			}
+
+			if(m_pLVOverviewClient)
+			{
+				sLVClient *pClient = m_pLVOverviewClient;
+				m_pLVClient = pClient;
+				m_bLVSendCanGrow = TRUE;
+				for(jrs_u32 uStep = 0; uStep < MemoryManager_LVOverviewSteps && !pClient->bClosing; uStep++)
+				{
+					if(pClient->uQueueWrite - pClient->uQueueRead >= pClient->uQueueBase / 2)
+						break;
+
+					if(JRSMemory_LiveView_SendOverviewStep(pClient->Overview))
+					{
+						pClient->bOverview = FALSE;
+						m_pLVOverviewClient = NULL;
+						break;
+					}
+					JRSMemory_LiveView_Flush(pClient, NULL, 0, NULL, 0);
+				}
+				m_bLVSendCanGrow = FALSE;
+			}
+
+			// Collect the continuous operations while any client wants them.
+			jrs_bool bStreaming = FALSE;
+			for(jrs_u32 i = 0; i < MemoryManager_MaxLiveViewClients; i++)
+			{
+				if(m_LVClients[i].Socket >= 0 && !m_LVClients[i].bClosing && m_LVClients[i].bStreaming)
+					bStreaming = TRUE;
+			}
+
+			if(bStreaming && !m_bELVContinuousGrab)
+			{
+				JRSMemory_LiveView_ResetOperations();
+				m_bELVContinuousGrab = TRUE;
+			}
+			else if(!bStreaming)
+			{
+				m_bELVContinuousGrab = FALSE;
+			}
+
+			// Update the time
+			m_uLVTimeElapsed = LVTimer.GetElapsedTimeMilliSec(true);
+			if(m_uLVTimeElapsed - uLastPoll >= m_uLiveViewPoll)
+			{
+				uLastPoll = m_uLVTimeElapsed;
+
+				for(jrs_u32 i = 0; i < MemoryManager_MaxLiveViewClients; i++)
+				{
+					// Do not send this data while wating for a map file or sending an overview
+					sLVClient *pClient = &m_LVClients[i];
+					if(pClient->Socket < 0 || pClient->bClosing || pClient->bMapRetrieve || pClient->bOverview)
+						continue;
+
+					m_pLVClient = pClient;
+					if(!JRSMemory_LiveView_SendAllocationDetails())
+						continue;
+
+					// Check if anything has been forced.  The overview is sent a step at a time like a requested one.
+					if(m_bForceLVOverviewGrab)
+					{
+						pClient->Overview = sLVOverview();
+						pClient->bOverview = TRUE;
+					}
+
+					if(m_bForceLVContinuousGrab)
+					{
+						sPacket contPacket;
+						contPacket.TimeMS = m_uLVTimeElapsed;
+						contPacket.Type = 50;
+						contPacket.Size = 0;
+						contPacket.Count = 0;
+						contPacket.SwapToLittleEndian();
+						JRSMemory_LiveView_Send(m_ClientSocket, (const char *)&contPacket, sizeof(sPacket), 0);
+					}
+				}
+
+				m_bForceLVOverviewGrab = FALSE;
+				m_bForceLVContinuousGrab = FALSE;
+			}
+
+			// Send the operation details.  The ring is emptied every pass whatever the clients can take.  Twice for the part after a wrap.
+			if(m_bELVContinuousGrab)
+			{
+				cMemoryManager::JRSMemory_LiveView_SendOperations(cMemoryManager::Get().m_pELVDebugBuffer, &cMemoryManager::Get().m_LVThreadLock);
+				cMemoryManager::JRSMemory_LiveView_SendOperations(cMemoryManager::Get().m_pELVDebugBuffer, &cMemoryManager::Get().m_LVThreadLock);
+			}
+
+			// Send what is queued and close the clients that have gone
+			jrs_bool bConnected = FALSE;
+			for(jrs_u32 i = 0; i < MemoryManager_MaxLiveViewClients; i++)
+			{
+				sLVClient *pClient = &m_LVClients[i];
+				if(pClient->Socket < 0)
+					continue;
+
+				JRSMemory_LiveView_Flush(pClient, NULL, 0, NULL, 0);
+				if(pClient->bClosing)
+				{
+					if(m_pLVOverviewClient == pClient)
+						m_pLVOverviewClient = NULL;
+					epoll_ctl(iEpoll, EPOLL_CTL_DEL, (int)pClient->Socket, &Event);
+					close((int)pClient->Socket);
+					m_MemoryManagerDefaultFree(pClient->pQueue, pClient->uQueueSize);
+					pClient->Socket = -1;
+					continue;
+				}
+
+				// Give back what a request grew the queue by once it has been sent
+				if(pClient->uQueueSize != pClient->uQueueBase && pClient->uQueueRead == pClient->uQueueWrite && !pClient->bOverview)
+				{
+					jrs_i8 *pQueue = (jrs_i8 *)m_MemoryManagerDefaultAllocator(pClient->uQueueBase, NULL);
+					if(pQueue)
+					{
+						m_MemoryManagerDefaultFree(pClient->pQueue, pClient->uQueueSize);
+						pClient->pQueue = pQueue;
+						pClient->uQueueSize = pClient->uQueueBase;
+						pClient->uQueueRead = pClient->uQueueWrite = 0;
+					}
+				}
+
+				// Only listen for the socket becoming writable while something is queued.
+				jrs_bool bWaitingWrite = pClient->uQueueRead != pClient->uQueueWrite;
+				if(bWaitingWrite != pClient->bWaitingWrite)
+				{
+					Event.events = bWaitingWrite ? EPOLLIN | EPOLLOUT : EPOLLIN;
+					Event.data.u32 = i;
+					epoll_ctl(iEpoll, EPOLL_CTL_MOD, (int)pClient->Socket, &Event);
+					pClient->bWaitingWrite = bWaitingWrite;
+				}
+
+				bConnected = TRUE;
+			}
+
+			cMemoryManager::Get().m_bLiveViewRunning = bConnected;
+		}
+
+		// End
+		m_pLVOverviewClient = NULL;
+		m_bELVContinuousGrab = FALSE;
+		cMemoryManager::Get().m_bLiveViewRunning = FALSE;
+		for(jrs_u32 i = 0; i < MemoryManager_MaxLiveViewClients; i++)
+		{
+			sLVClient *pClient = &m_LVClients[i];
+			if(pClient->Socket >= 0)
+			{
+				close((int)pClient->Socket);
+				m_MemoryManagerDefaultFree(pClient->pQueue, pClient->uQueueSize);
+				pClient->Socket = -1;
+			}
+		}
+
+		if(iLocalSocket >= 0)
+		{
+			close(iLocalSocket);
+			unlink(m_LVLocalSocketPath);
+		}
+
+		close(iEpoll);
+		JRSMemory_LiveView_CloseNetworkConnection(ServerSocket);
+
+		JRSThreadReturn(1);
+	}
+#else
+	//  Description:
+	//      Wakes the live view thread.  The single client thread polls so there is nothing to do.  Internal only.
+	//  See Also:
+	//      ContinuousLog_AddToBuffer
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Wakes the live view thread.
+	void MemoryManagerLiveViewWake(void)
+	{
 	}
 
 	//  Description:
@@ -1033,9 +1980,7 @@ namespace Elephant
 						m_LVSendBufCur = 0;
 						m_LVRecvBufCur = 0;
 						m_LVRecvBufRead = 0;
-						cMemoryManager::Get().m_uELVDBRead = 0;
-						cMemoryManager::Get().m_uELVDBWrite = 0;						
-						cMemoryManager::Get().m_uELVDBWriteEnd = 0;	
+						JRSMemory_LiveView_ResetOperations();
 						cMemoryManager::Get().m_bLiveViewRunning = TRUE;	
 
 						// Send some init data to get us going
@@ -1125,9 +2070,7 @@ namespace Elephant
 							case 4:
 								// We want to start/stop continue logging
 								m_bELVContinuousGrab = !m_bELVContinuousGrab;
-								cMemoryManager::Get().m_uELVDBRead = 0;
-								cMemoryManager::Get().m_uELVDBWrite = 0;
-								cMemoryManager::Get().m_uELVDBWriteEnd = 0;
+								JRSMemory_LiveView_ResetOperations();
 							case MemoryManager_PoolInformationType:
 								// We want to send the names of the pools.
 								JRSMemory_LiveView_SendPoolDetails(pPacket->Size, pPacket->Count);
@@ -1158,7 +2101,7 @@ namespace Elephant
 
 		JRSThreadReturn(1);
 	}
-
+#endif
 }
 
 #else
@@ -1182,6 +2125,20 @@ namespace Elephant
 	{
 		
 	}
+
+	//  Description:
+	//      Internal only.  Stub function for when Live view isnt available.
+	//  See Also:
+	//      
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Wakes the live view thread.
+	void MemoryManagerLiveViewWake(void)
+	{
+	}
 }
 
 #endif	// JRSMEMORY_HASSOCKETS
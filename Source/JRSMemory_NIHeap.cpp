@@ -8,9 +8,9 @@
 #include "JRSMemory_Internal.h"
 #include "JRSMemory_ErrorCodes.h"
 
-// Defines to force inlining of some components
-#define HEAP_THREADLOCK if(m_bThreadSafe) { m_pThreadLock->Lock(); }
-#define HEAP_THREADUNLOCK if(m_bThreadSafe) { m_pThreadLock->Unlock(); }
+// Defines to force inlining of some components.  Non intrusive heaps have their own lock and no latency statistics.
+#define NIHEAP_THREADLOCK if(m_bThreadSafe) { m_pThreadLock->Lock(); }
+#define NIHEAP_THREADUNLOCK if(m_bThreadSafe) { m_pThreadLock->Unlock(); }
 
 // Elephant Namespace
 namespace Elephant
@@ -76,6 +76,8 @@ namespace Elephant
 		m_uNumCallStacks = pHeapDetails->uNumCallStacks;
 		if(m_uNumCallStacks < 8)
 			m_uNumCallStacks = 8;
+		if(m_uNumCallStacks > MemoryManager_StackTableDepth)
+			m_uNumCallStacks = MemoryManager_StackTableDepth;
 		m_uCallstackDepth = 1; 
 		m_bResizable = pHeapDetails->bResizable;
 		m_uResizableSize = pHeapDetails->uResizableSize;
@@ -84,11 +86,33 @@ namespace Elephant
 		m_bThreadSafe = pHeapDetails->bThreadSafe;
 		if(cMemoryManager::Get().m_bEnableLiveView || cMemoryManager::Get().m_bEnhancedDebugging)
 			m_bThreadSafe = true;
+		m_uRegistrySlot = MemoryManager_InvalidHeapSlot;
 
 #ifndef MEMORYMANAGER_MINIMAL
 		m_uDebugHeaderSize = 0;
+		m_uDebugSlotsPerPage = 1;
+		m_uDebugPagesPerRegion = 1;
+		m_uDebugRegionSize = 0;
 		if(m_bEnableMemoryTracking)
-			m_uDebugHeaderSize = MemoryManager_StringLength + (sizeof(void *) * m_uNumCallStacks);
+		{
+			// Name followed by the stack id.  Kept pointer aligned.
+			m_uDebugHeaderSize = MemoryManager_StringLength + sizeof(jrs_sizet);
+
+			// Smallest sub allocation decides how many slots a page may need
+			jrs_sizet uMinSubAlloc = pHeapDetails->uMinAllocationSize >= 64 ? pHeapDetails->uMinAllocationSize : 64;
+			if((uMinSubAlloc & (uMinSubAlloc - 1)))
+				uMinSubAlloc = (jrs_sizet)(1 << (JRSCountLeadingZero((jrs_u32)uMinSubAlloc) + 1));
+			if(uMinSubAlloc <= m_uPageSize >> 1)
+				m_uDebugSlotsPerPage = (jrs_u32)(m_uPageSize / uMinSubAlloc);
+
+			// The side table is split into regions of pages that are created as the pages are first used
+			jrs_sizet uSystemPageSize = cMemoryManager::Get().m_MemoryManagerDefaultSystemPageSize();
+			jrs_sizet uEntriesPerPage = m_uDebugSlotsPerPage * m_uDebugHeaderSize;
+			m_uDebugPagesPerRegion = (jrs_u32)(MemoryManager_NIDebugRegionSize / uEntriesPerPage);
+			if(!m_uDebugPagesPerRegion)
+				m_uDebugPagesPerRegion = 1;
+			m_uDebugRegionSize = (m_uDebugPagesPerRegion * uEntriesPerPage + (uSystemPageSize - 1)) & ~(uSystemPageSize - 1);
+		}
 #endif
 		// Only resizable 
 		if(m_bResizable)
@@ -116,6 +140,14 @@ namespace Elephant
 		m_systemFree = pHeapDetails->systemAllocator ? pHeapDetails->systemFree : cMemoryManager::Get().m_MemoryManagerDefaultFree;
 		m_systemPageSize = pHeapDetails->systemAllocator ? pHeapDetails->systemPageSize : cMemoryManager::Get().m_MemoryManagerDefaultSystemPageSize;
 		m_systemOpCallback = pHeapDetails->systemOpCallback;
+		m_systemRelease = pHeapDetails->systemAllocator ? pHeapDetails->systemRelease : cMemoryManager::Get().m_MemoryManagerDefaultSystemRelease;
+
+		// Page release
+		m_bReleaseFreePages = pHeapDetails->bReleaseFreePages;
+		m_uReleaseThreshold = pHeapDetails->uReleaseThreshold > m_uPageSize ? pHeapDetails->uReleaseThreshold : m_uPageSize;
+		m_uReleaseDelay = pHeapDetails->uReleaseDelay;
+		m_uReleaseDelayCount = 0;
+		m_uReleasedSize = 0;
 
 		// Clear bins
 		for(jrs_u32 i = 0; i < m_uMaxNumBins; i++)
@@ -140,8 +172,7 @@ namespace Elephant
 		HeapWarning(strlen(pName) < 32, JRSMEMORYERROR_HEAPNAMETOLARGE, "Heap Name is to large");
 		strcpy(m_HeapName, pName);
 
-		// Heap set up
-		cMemoryManager::Get().ContinuousLogging_NIOperation(cMemoryManager::eContLog_CreateHeap, this, NULL, 0);
+		// The creation is logged by the memory manager once the heap has its id
 	}
 
 	//  Description:
@@ -187,8 +218,10 @@ namespace Elephant
 		}
 
 		// Allocate the memory if null
+		jrs_bool bZeroed = FALSE;
 		if(!pMemoryAddress)
 		{
+			bZeroed = (cMemoryManager::GetSystemZeroFlags(m_systemAllocator, NULL) & JRSMEMORYZEROFLAG_ALLOCATOR) != 0;
 			jrs_sizet pageSize = m_systemPageSize();
 			pageSize = pageSize < m_uPageSize ? m_uPageSize : pageSize;
 
@@ -215,14 +248,25 @@ namespace Elephant
 			return FALSE;
 		}
 
+		// Memory tracking side table.  Only the list of regions follows the page blocks, each region is created by GetDebugInfo the first
+		// time one of its pages needs an entry.
+		jrs_u32 uNumDebugRegions = 0;
+#ifndef MEMORYMANAGER_MINIMAL
+		if(m_bEnableMemoryTracking)
+			uNumDebugRegions = (jrs_u32)(((uSize / m_uPageSize) + (m_uDebugPagesPerRegion - 1)) / m_uDebugPagesPerRegion);
+#endif
+
 		// Create slab and expand
 		sSlab *pSlab = &m_Slabs[m_uNumSlabs];
 		m_Slabs[m_uNumSlabs].numBlocks = (jrs_u32)(uSize / m_uPageSize);
-		m_Slabs[m_uNumSlabs].pBlocks = (sPageBlock *)(m_pStandardHeap->AllocateMemory((uSize / m_uPageSize) * sizeof(sPageBlock), 1024, JRSMEMORYFLAG_HEAPNISLAB, "Heap Slab"));
-		m_Slabs[m_uNumSlabs].uPageBlockSize = (uSize / m_uPageSize) * sizeof(sPageBlock);
+		m_Slabs[m_uNumSlabs].uPageBlockSize = (uSize / m_uPageSize) * sizeof(sPageBlock) + uNumDebugRegions * sizeof(void *);
+		m_Slabs[m_uNumSlabs].pBlocks = (sPageBlock *)(m_pStandardHeap->AllocateMemory(m_Slabs[m_uNumSlabs].uPageBlockSize, 1024, JRSMEMORYFLAG_HEAPNISLAB, "Heap Slab"));
 		m_Slabs[m_uNumSlabs].uSize = uSize;
 		m_Slabs[m_uNumSlabs].pBase = pMemoryAddress;
 
+		m_Slabs[m_uNumSlabs].ppDebugInfo = NULL;
+		m_Slabs[m_uNumSlabs].uNumDebugRegions = 0;
+
 		// Check for errors
 		if(!m_Slabs[m_uNumSlabs].pBlocks)
 		{
@@ -230,9 +274,20 @@ namespace Elephant
 			return FALSE;
 		}
 
+		if(uNumDebugRegions)
+		{
+			m_Slabs[m_uNumSlabs].ppDebugInfo = (void **)(m_Slabs[m_uNumSlabs].pBlocks + m_Slabs[m_uNumSlabs].numBlocks);
+			memset(m_Slabs[m_uNumSlabs].ppDebugInfo, 0, uNumDebugRegions * sizeof(void *));
+			m_Slabs[m_uNumSlabs].uNumDebugRegions = uNumDebugRegions;
+		}
+
 		// Increment the count
 		m_uNumSlabs++;
 
+		// Registered heaps add the slab to the address ranges used by cMemoryManager::Free.  The first slab is added when the heap is registered.
+		if(m_uRegistrySlot != MemoryManager_InvalidHeapSlot)
+			cMemoryManager::Get().AddHeapRange(NULL, this, pMemoryAddress, (jrs_i8 *)pMemoryAddress + uSize);
+
 		// Initialize the blocks
 		for(jrs_u32 i = 0; i < pSlab->numBlocks; i++)
 		{
@@ -242,11 +297,13 @@ namespace Elephant
 
 		// Add to the bins
 		AddPagesToBin(pSlab->pBlocks, pSlab->numBlocks);
+		if(bZeroed)
+			pSlab->pBlocks->pageFlags |= JRSMEMORYMANAGER_PAGEZEROED;
 #ifndef MEMORYMANAGER_MINIMAL
 		if(m_bEnableMemoryTracking)
 		{			
 			// Only one header for these
-			pSlab->pBlocks->pDebugInfo = m_pStandardHeap->AllocateMemory(m_uDebugHeaderSize, 0, JRSMEMORYFLAG_HEAPDEBUGTAG, "NIHeapDebug Info");
+			pSlab->pBlocks->pDebugInfo = GetDebugInfo(pSlab->pBlocks);
 			UpdateDebugInfo(pSlab->pBlocks->pDebugInfo, "MemMan_Slab");
 		}
 #endif
@@ -364,27 +421,41 @@ namespace Elephant
 				jrs_u32 pagesToSkip = (jrs_u32)(pAlignBlock - pBlock);
 				if(pBlock->numFreePages - pagesToSkip >= numPages)
 				{
+					jrs_u8 uReleased = pBlock->pageFlags & JRSMEMORYMANAGER_PAGERELEASED;
+					jrs_u8 uZeroed = pBlock->pageFlags & JRSMEMORYMANAGER_PAGEZEROED;
 					RemoveFromBin(pageBin, pBlock);
 
 					// Add the align block, it will get removed later.  This could be improved.
 					AddPagesToBin(pAlignBlock, pBlock->numFreePages - pagesToSkip);
 					pAlignBlock->pPrevBlock = pBlock;
+					pAlignBlock->pageFlags |= uZeroed;
+					if(uReleased)
+					{
+						pAlignBlock->pageFlags |= JRSMEMORYMANAGER_PAGERELEASED;
+						m_uReleasedSize += pAlignBlock->numFreePages * m_uPageSize;
+					}
 #ifndef MEMORYMANAGER_MINIMAL
 					if(m_bEnableMemoryTracking)
 					{			
 						// Only one header for these
-						pAlignBlock->pDebugInfo = m_pStandardHeap->AllocateMemory(m_uDebugHeaderSize, 0, JRSMEMORYFLAG_HEAPDEBUGTAG, "NIHeapDebug Info");
+						pAlignBlock->pDebugInfo = GetDebugInfo(pAlignBlock);
 						UpdateDebugInfo(pAlignBlock->pDebugInfo, "MemMan_Empty");
 					}
 #endif
 
 					sPageBlock *pSplit = pBlock;
 					AddPagesToBin(pSplit, pagesToSkip);
+					pSplit->pageFlags |= uZeroed;
+					if(uReleased)
+					{
+						pSplit->pageFlags |= JRSMEMORYMANAGER_PAGERELEASED;
+						m_uReleasedSize += pSplit->numFreePages * m_uPageSize;
+					}
 #ifndef MEMORYMANAGER_MINIMAL
 					if(m_bEnableMemoryTracking)
 					{			
 						// Only one header for these
-						pSplit->pDebugInfo = m_pStandardHeap->AllocateMemory(m_uDebugHeaderSize, 0, JRSMEMORYFLAG_HEAPDEBUGTAG, "NIHeapDebug Info");
+						pSplit->pDebugInfo = GetDebugInfo(pSplit);
 						UpdateDebugInfo(pSplit->pDebugInfo, "MemMan_Empty");
 					}
 #endif						
@@ -419,28 +490,36 @@ namespace Elephant
 				HeapWarning(pBlock, JRSMEMORYERROR_BININVALID, "Bins are invalid. FATAL.");
 			}
 		}
+		jrs_u8 uReleased = pBlock->pageFlags & JRSMEMORYMANAGER_PAGERELEASED;
+		jrs_u8 uZeroed = pBlock->pageFlags & JRSMEMORYMANAGER_PAGEZEROED;
 		RemoveFromBin(pageBin, pBlock);
 
-		// 2. Split and add back to the bins if needed.
+		// 2. Split and add back to the bins if needed.  Any released or zeroed pages stay that way.
 		if(pBlock->numFreePages > numPages)
 		{
 			sPageBlock *pSplit = pBlock + numPages;
 			AddPagesToBin(pSplit, pBlock->numFreePages - numPages);
+			pSplit->pageFlags |= uZeroed;
+			if(uReleased)
+			{
+				pSplit->pageFlags |= JRSMEMORYMANAGER_PAGERELEASED;
+				m_uReleasedSize += pSplit->numFreePages * m_uPageSize;
+			}
 #ifndef MEMORYMANAGER_MINIMAL
 			if(m_bEnableMemoryTracking)
 			{			
 				// Only one header for these
-				pSplit->pDebugInfo = m_pStandardHeap->AllocateMemory(m_uDebugHeaderSize, 0, JRSMEMORYFLAG_HEAPDEBUGTAG, "NIHeapDebug Info");
+				pSplit->pDebugInfo = GetDebugInfo(pSplit);
 				UpdateDebugInfo(pSplit->pDebugInfo, "MemMan_Empty");
 			}
 #endif
 		}
 		
-		// 3. Initialize the page
+		// 3. Initialize the page.  The zeroed flag is left for the caller to consume.
 		pBlock->pNext = NULL;
 		pBlock->pPrev = NULL;
 		pBlock->numFreePages = numPages;
-		pBlock->pageFlags = JRSMEMORYMANAGER_PAGEALLOCATED;
+		pBlock->pageFlags = JRSMEMORYMANAGER_PAGEALLOCATED | uZeroed;
 		sPageBlock *pNext = pBlock + numPages;
 		if(pNext < m_Slabs[pBlock->slabNum].pBlocks + m_Slabs[pBlock->slabNum].numBlocks)
 			pNext->pPrevBlock = pBlock;
@@ -471,6 +550,56 @@ namespace Elephant
 	//  Summary:
 	//      Allocates memory with additional information.
 	void *cHeapNonIntrusive::AllocateMemory(jrs_sizet uSize, jrs_u32 uAlignment, jrs_u32 uFlag /*= JRSMEMORYFLAG_NONE*/, const jrs_i8 *pName /*= 0*/, const jrs_u32 uExternalId /* = 0*/)
+	{
+		void *pMemory = InternalAllocateMemory(uSize, uAlignment, uFlag, pName, uExternalId, FALSE);
+		if(cMemoryManager::Get().m_pSampler)
+			cMemoryManager::Get().SampleAllocation(pMemory, uSize);
+
+		return pMemory;
+	}
+
+	//  Description:
+	//		Allocates memory cleared to zero.  Page runs that have not been touched since they came from a zero filling system allocator or
+	//		were released back to the system are not cleared again.  Sub page allocations are always cleared.  See AllocateMemory for the arguments.
+	//  See Also:
+	//		AllocateMemory, cMemoryManager::Calloc
+	//  Arguments:
+	//      uSize - Size in bytes.
+	//		uAlignment - Alignment or 0 for the heap default.
+	//		uFlag - One of JRSMEMORYFLAG_xxx or user defined value.  Default JRSMEMORYFLAG_NONE.
+	//		pName - NULL terminating text string to associate with the allocation. May be NULL.
+	//		uExternalId - An Id that to associate with the allocation.  Default 0.  Not available to NI Heaps.
+	//  Return Value:
+	//      Valid pointer to zero filled memory.
+	//		NULL otherwise.
+	//  Summary:
+	//      Allocates zero filled memory.
+	void *cHeapNonIntrusive::AllocateZeroed(jrs_sizet uSize, jrs_u32 uAlignment, jrs_u32 uFlag /*= JRSMEMORYFLAG_NONE*/, const jrs_i8 *pName /*= 0*/, const jrs_u32 uExternalId /* = 0*/)
+	{
+		void *pMemory = InternalAllocateMemory(uSize, uAlignment, uFlag, pName, uExternalId, TRUE);
+		if(cMemoryManager::Get().m_pSampler)
+			cMemoryManager::Get().SampleAllocation(pMemory, uSize);
+
+		return pMemory;
+	}
+
+	//  Description:
+	//		Internal.  AllocateMemory and AllocateZeroed implementation.
+	//  See Also:
+	//		AllocateMemory, AllocateZeroed
+	//  Arguments:
+	//      uSize - Size in bytes.
+	//		uAlignment - Alignment or 0 for the heap default.
+	//		uFlag - One of JRSMEMORYFLAG_xxx or user defined value.
+	//		pName - NULL terminating text string to associate with the allocation. May be NULL.
+	//		uExternalId - Not available to NI Heaps.
+	//		bZeroed - TRUE to return zero filled memory.
+	//  Return Value:
+	//      Valid pointer to allocated memory.
+	//		NULL otherwise.
+	//  Summary:
+	//      Internal.  Allocates memory.
+	void *cHeapNonIntrusive::InternalAllocateMemory(jrs_sizet uSize, jrs_u32 uAlignment, jrs_u32 uFlag, const jrs_i8 *pName, const jrs_u32 uExternalId, jrs_bool bZeroed)
 	{
 #ifndef MEMORYMANAGER_MINIMAL
 		if(!cMemoryManager::Get().IsInitialized())
@@ -503,6 +632,7 @@ namespace Elephant
 		}
 #endif
 		jrs_sizet uAlignedSize = uSize;
+		jrs_sizet uClearSize = 0;
 		void *pMemAddress = NULL;
 
 		// Thread lock
@@ -513,7 +643,7 @@ namespace Elephant
 		if(IsLocked())
 		{
 			HeapWarning(!IsLocked(), JRSMEMORYERROR_LOCKED, "Heap is locked.  You may not allocate memory.");
-			HEAP_THREADUNLOCK
+			NIHEAP_THREADUNLOCK
 				return 0;
 		}
 
@@ -535,6 +665,11 @@ namespace Elephant
 				return 0;
 			}
 
+			// Pages still zero from the system need no clearing
+			if(bZeroed && !(pBlock->pageFlags & JRSMEMORYMANAGER_PAGEZEROED))
+				uClearSize = uSize;
+			pBlock->pageFlags &= ~JRSMEMORYMANAGER_PAGEZEROED;
+
 			// Page size or more - do nothing, already handled above
 			// Get the address of the page.
 			sSlab *pSlab = &m_Slabs[pBlock->slabNum];
@@ -545,7 +680,7 @@ namespace Elephant
 			if(m_bEnableMemoryTracking)
 			{
 				// Only one header for these
-				pBlock->pDebugInfo = m_pStandardHeap->AllocateMemory(m_uDebugHeaderSize, 0, JRSMEMORYFLAG_HEAPDEBUGTAG, "NIHeapDebug Info");
+				pBlock->pDebugInfo = GetDebugInfo(pBlock);
 				UpdateDebugInfo(pBlock->pDebugInfo, pName);
 			}
 #endif
@@ -582,7 +717,7 @@ namespace Elephant
 					return 0;
 				}
 
-				pBlock->pageFlags |= JRSMEMORYMANAGER_PAGESUBALLOC;
+				pBlock->pageFlags = (pBlock->pageFlags & ~JRSMEMORYMANAGER_PAGEZEROED) | JRSMEMORYMANAGER_PAGESUBALLOC;
 				pBlock->sizeOfSubAllocs = (jrs_u32)uSize;
 				
 				// Add it to the pages.			
@@ -613,12 +748,13 @@ namespace Elephant
 				// Debug information
 				if(m_bEnableMemoryTracking)
 				{
-					pBlock->pDebugInfo = m_pStandardHeap->AllocateMemory(m_uDebugHeaderSize * (m_uPageSize / pBlock->sizeOfSubAllocs), 0, JRSMEMORYFLAG_HEAPDEBUGTAG, "NIHeapDebug Info");
-					
-					for(jrs_u32 uDebugBlock = 0; uDebugBlock < (m_uPageSize / pBlock->sizeOfSubAllocs); uDebugBlock++)
+					// The slots follow on from the page entry in the slab side table.  Empty slots have no callstack.
+					pBlock->pDebugInfo = GetDebugInfo(pBlock);
+					for(jrs_u32 uDebugBlock = 0; pBlock->pDebugInfo && uDebugBlock < (m_uPageSize / pBlock->sizeOfSubAllocs); uDebugBlock++)
 					{
-						void *pDebug = ((jrs_u8 *)pBlock->pDebugInfo + (m_uDebugHeaderSize * uDebugBlock));
-						UpdateDebugInfo(pDebug, "MemMan_Empty");
+						jrs_i8 *pDebug = ((jrs_i8 *)pBlock->pDebugInfo + (m_uDebugHeaderSize * uDebugBlock));
+						memset(pDebug, 0, m_uDebugHeaderSize);
+						strcpy(pDebug, "MemMan_Empty");
 					}
 				}
 #endif
@@ -626,10 +762,12 @@ namespace Elephant
 
 			// Allocate from the block
 			pMemAddress = AddSubAllocation(pBlock, uSize);
+			if(bZeroed)
+				uClearSize = uSize;
 
 #ifndef MEMORYMANAGER_MINIMAL
 			// Set debug details
-			if(m_bEnableMemoryTracking)
+			if(m_bEnableMemoryTracking && pBlock->pDebugInfo)
 			{
 				// Find the page by getting the base alignment
 				jrs_sizet offset = ((jrs_sizet)pMemAddress & (m_uPageSize - 1));
@@ -679,6 +817,9 @@ namespace Elephant
 
 		if(m_bThreadSafe)
 			m_pThreadLock->Unlock();
+
+		if(uClearSize)
+			memset(pMemAddress, 0, uClearSize);
 		
 #ifndef MEMORYMANAGER_MINIMAL
 		if(m_bEnableLogging)
@@ -705,8 +846,11 @@ namespace Elephant
 	void cHeapNonIntrusive::UpdateDebugInfo(void *pDebugInfo, const jrs_i8 *pName)
 	{
 #ifndef MEMORYMANAGER_MINIMAL
+		if(!pDebugInfo)
+			return;
+
 		jrs_i8 *pText = (jrs_i8 *)pDebugInfo;
-		jrs_sizet *puCallStack = (jrs_sizet *)(pText + MemoryManager_StringLength);
+		jrs_u32 *puStackId = (jrs_u32 *)(pText + MemoryManager_StringLength);
 
 		memset(pDebugInfo, 0, m_uDebugHeaderSize);
 		// Set the names etc and if we are on a supported platform get the stack trace
@@ -724,7 +868,38 @@ namespace Elephant
 		}
 		else
 			strcpy(pText, "Unknown Allocation");
-		cMemoryManager::Get().StackTrace(puCallStack, m_uCallstackDepth, m_uNumCallStacks);
+		*puStackId = cMemoryManager::Get().StackTraceId(m_uCallstackDepth, m_uNumCallStacks);
+#endif
+	}
+
+	//  Description:
+	//		Internal.  Returns the memory tracking entry for a page from the slab side table.  Sub allocated pages use the following
+	//		entries for each of their slots.  The region of the table holding the page is created the first time it is needed.
+	//  See Also:
+	//		UpdateDebugInfo
+	//  Arguments:
+	//		pBlock - Valid page block.
+	//  Return Value:
+	//      Pointer to the first tracking entry of the page.  NULL if the region could not be created.
+	//  Summary:
+	//		Internal.  Returns the memory tracking entry for a page.
+	void *cHeapNonIntrusive::GetDebugInfo(sPageBlock *pBlock)
+	{
+#ifndef MEMORYMANAGER_MINIMAL
+		sSlab *pSlab = &m_Slabs[pBlock->slabNum];
+		jrs_sizet pageOffsetInSlab = pBlock - pSlab->pBlocks;
+		jrs_u32 uRegion = (jrs_u32)(pageOffsetInSlab / m_uDebugPagesPerRegion);
+		if(!pSlab->ppDebugInfo[uRegion])
+		{
+			pSlab->ppDebugInfo[uRegion] = cMemoryManager::Get().m_MemoryManagerDefaultAllocator(m_uDebugRegionSize, NULL);
+			HeapWarning(pSlab->ppDebugInfo[uRegion], JRSMEMORYERROR_INVALIDADDRESS, "Could not allocate slab memory tracking information.");
+			if(!pSlab->ppDebugInfo[uRegion])
+				return NULL;
+		}
+		pageOffsetInSlab -= uRegion * m_uDebugPagesPerRegion;
+		return (jrs_i8 *)pSlab->ppDebugInfo[uRegion] + (pageOffsetInSlab * m_uDebugSlotsPerPage * m_uDebugHeaderSize);
+#else
+		return NULL;
 #endif
 	}
 
@@ -823,6 +998,9 @@ namespace Elephant
 			return;
 		}
 
+		if(cMemoryManager::Get().m_pSampler)
+			cMemoryManager::Get().RemoveSample(pMemory);
+
 		// Find the page by getting the base alignment
 		jrs_i8 *pPageAdd = (jrs_i8 *)((jrs_sizet)pMemory & ~(m_uPageSize - 1));
 		
@@ -833,7 +1011,7 @@ namespace Elephant
 		if(IsLocked())
 		{
 			HeapWarning(!IsLocked(), JRSMEMORYERROR_LOCKED, "Heap is locked.  You may not free memory.");
-			HEAP_THREADUNLOCK
+			NIHEAP_THREADUNLOCK
 			return;
 		}
 
@@ -864,7 +1042,7 @@ namespace Elephant
 #ifndef MEMORYMANAGER_MINIMAL
 		if(m_bEnableLogging)
 		{
-			cMemoryManager::Get().ContinuousLogging_HeapNIOperation(cMemoryManager::eContLog_Allocate, this, pMemory, 0, pBlock->pageFlags & JRSMEMORYMANAGER_PAGESUBALLOC ? pBlock->sizeOfSubAllocs : pBlock->numFreePages * m_uPageSize, 0);
+			cMemoryManager::Get().ContinuousLogging_HeapNIOperation(cMemoryManager::eContLog_Free, this, pMemory, 0, pBlock->pageFlags & JRSMEMORYMANAGER_PAGESUBALLOC ? pBlock->sizeOfSubAllocs : pBlock->numFreePages * m_uPageSize, 0);
 		}
 #endif
 
@@ -918,7 +1096,7 @@ namespace Elephant
 
 #ifndef MEMORYMANAGER_MINIMAL
 			// Clear the debug flags
-			if(m_bEnableMemoryTracking)
+			if(m_bEnableMemoryTracking && pBlock->pDebugInfo)
 			{			
 				jrs_sizet offsetDebug = offset / pBlock->sizeOfSubAllocs;
 				void *pDebug = ((jrs_u8 *)pBlock->pDebugInfo + (m_uDebugHeaderSize * offsetDebug));
@@ -959,22 +1137,22 @@ namespace Elephant
 		// Free the memory, add it back into the main pool
 
 #ifndef MEMORYMANAGER_MINIMAL
-		// Debug information
+		// Debug information.  The entry lives in the slab side table so there is nothing to free.
 		if(m_bEnableMemoryTracking)
 		{
-			// Only one header for these
-			m_pStandardHeap->FreeMemory(pBlock->pDebugInfo, JRSMEMORYFLAG_HEAPDEBUGTAG, "NIHeap Debug Free");
 			pBlock->pDebugInfo = NULL;
 		}
 #endif
 
-		// See if the previous or next can be consolidated
+		// See if the previous or next can be consolidated.  Released neighbours stop being counted once they leave the bins.
 		jrs_u32 uNumPages = pBlock->numFreePages;
 		jrs_bool bUpdatePointers = FALSE;
+		jrs_u8 uMergedReleased = 0;
 		if(pBlockNext && pBlockNext->pageFlags & JRSMEMORYMANAGER_PAGEFREE)
 		{
 			bUpdatePointers = TRUE;
 			uNumPages += pBlockNext->numFreePages;
+			uMergedReleased |= pBlockNext->pageFlags & JRSMEMORYMANAGER_PAGERELEASED;
 			sPageBlock *pPotentialNext = pBlockNext + pBlockNext->numFreePages;
 			RemoveFromBin(pBlockNext);
 
@@ -988,6 +1166,7 @@ namespace Elephant
 		{
 			bUpdatePointers = TRUE;
 			uNumPages += pBlockPrev->numFreePages;
+			uMergedReleased |= pBlockPrev->pageFlags & JRSMEMORYMANAGER_PAGERELEASED;
 			RemoveFromBin(pBlockPrev);
 
 			pBlock = pBlockPrev;
@@ -1001,7 +1180,7 @@ namespace Elephant
 		if(m_bEnableMemoryTracking)
 		{			
 			// Only one header for these
-			pBlock->pDebugInfo = m_pStandardHeap->AllocateMemory(m_uDebugHeaderSize, 0, JRSMEMORYFLAG_HEAPDEBUGTAG, "NIHeapDebug Info");
+			pBlock->pDebugInfo = GetDebugInfo(pBlock);
 			UpdateDebugInfo(pBlock->pDebugInfo, "MemMan_Empty");
 		}
 #endif
@@ -1014,10 +1193,266 @@ namespace Elephant
 			pBlockNext->pPrevBlock = pBlock;
 		}
 
+		// A run merged with released pages is released as a whole so the released size is worked out from the merged block again
+		if(uMergedReleased)
+			ReleasePages(pBlock);
+
+		// Return the pages to the system if required
+		if(m_bReleaseFreePages)
+		{
+			if(!m_uReleaseDelay)
+			{
+				if(uNumPages * m_uPageSize >= m_uReleaseThreshold)
+					ReleasePages(pBlock);
+			}
+			else if(++m_uReleaseDelayCount >= m_uReleaseDelay)
+			{
+				m_uReleaseDelayCount = 0;
+				InternalPurge(m_uReleaseThreshold);
+			}
+		}
+
 		if(m_bThreadSafe)
 			m_pThreadLock->Unlock();
 	}
 
+	//  Description:
+	//		Reallocates memory allocated from AllocateMemory.  Sub page allocations that still fit in the same size class return the same pointer.  Allocations
+	//		of one or more pages are resized in place where possible.  Growing takes the free pages immediately after the allocation if there are enough of them,
+	//		shrinking returns the trailing pages back to the bins.  In all other cases the memory is allocated, copied and the old allocation freed.
+	//		Flags are set by the user.  It can be one of JRSMEMORYFLAG_xxx or any user specified flags > JRSMEMORYFLAG_RESERVED3
+	//		but smaller than or equal to 15, values greater than 15 will be lost and operation of AllocateMemory is undefined.  Input text is
+	//		limited to 32 chars including terminator.  Strings longer than this will only store the last 31 chars.
+	//  See Also:
+	//		AllocateMemory, FreeMemory
+	//  Arguments:
+	//		pMemory - Memory to reallocate.  NULL will allocate new memory.
+	//      uSize - Size in bytes. 0 will free the memory.
+	//		uAlignment - Default alignment is 64bytes unless heap settings have set a larger alignment.
+	//					 Any specified alignments must be a power of 2. Setting 0 will default to the minimum requested alignment of the heap.
+	//		uFlag - One of JRSMEMORYFLAG_xxx or user defined value.  Default JRSMEMORYFLAG_NONE.  See description for more details.
+	//		pName - NULL terminating text string to associate with the allocation. May be NULL.
+	//		uExternalId - An Id that to associate with the allocation.  Default 0.  Not available to NI Heaps.
+	//  Return Value:
+	//      Valid pointer to allocated memory.
+	//		NULL otherwise.
+	//  Summary:
+	//      Reallocates memory resizing in place where possible.
+	void *cHeapNonIntrusive::ReAllocateMemory(void *pMemory, jrs_sizet uSize, jrs_u32 uAlignment, jrs_u32 uFlag /*= JRSMEMORYFLAG_NONE*/, const jrs_i8 *pName /*= 0*/, const jrs_u32 uExternalId /*= 0*/)
+	{
+		// Null memory can just be allocated through the standard approach
+		if(!pMemory)
+			return AllocateMemory(uSize, uAlignment, uFlag, pName, uExternalId);
+
+		// 0 size just frees memory
+		if(!uSize)
+		{
+			FreeMemory(pMemory, uFlag, pName, uExternalId);
+			return 0;
+		}
+
+		// Work out the size and alignment we would have allocated with
+		jrs_sizet uNewSize = uSize < m_uMinAllocSize ? m_uMinAllocSize : uSize;
+		if(!uAlignment)
+			uAlignment = (jrs_u32)m_uDefaultAlignment;
+
+		// Find the page by getting the base alignment
+		jrs_i8 *pPageAdd = (jrs_i8 *)((jrs_sizet)pMemory & ~(m_uPageSize - 1));
+
+		NIHEAP_THREADLOCK
+
+		// Cannot reallocate if the heap is locked.
+		if(IsLocked())
+		{
+			HeapWarning(!IsLocked(), JRSMEMORYERROR_LOCKED, "Heap is locked.  You may not reallocate memory.");
+			NIHEAP_THREADUNLOCK
+			return 0;
+		}
+
+		sSlab *pSlab = FindSlabFromMemory(pPageAdd);
+		if(!pSlab)
+		{
+			HeapWarning(pSlab, JRSMEMORYERROR_HEAPINVALID, "Memory doesnt appear to come from this heap.");
+			NIHEAP_THREADUNLOCK
+			return 0;
+		}
+
+		jrs_sizet pageIndex = ((jrs_sizet)pPageAdd - (jrs_sizet)pSlab->pBase) / m_uPageSize;
+		sPageBlock *pBlock = &pSlab->pBlocks[pageIndex];
+		if(!(pBlock->pageFlags & JRSMEMORYMANAGER_PAGEALLOCATED))
+		{
+			HeapWarning(pBlock->pageFlags & JRSMEMORYMANAGER_PAGEALLOCATED, JRSMEMORYERROR_INVALIDADDRESS, "Memory address 0x%p has already been freed", pMemory);
+			NIHEAP_THREADUNLOCK
+			return 0;
+		}
+
+		// Size of the current allocation.  Needed for the copy if it cannot be done in place.
+		jrs_sizet uOldSize = (pBlock->pageFlags & JRSMEMORYMANAGER_PAGESUBALLOC) ? pBlock->sizeOfSubAllocs : pBlock->numFreePages * m_uPageSize;
+
+		// Alignment must still hold for the existing address otherwise we have to move it.
+		if(!((jrs_sizet)pMemory & (uAlignment - 1)))
+		{
+			if(pBlock->pageFlags & JRSMEMORYMANAGER_PAGESUBALLOC)
+			{
+				// Sub allocations stay where they are if they fall into the same size class.
+				if(uNewSize <= m_uPageSize >> 1)
+				{
+					if((uNewSize & (uNewSize - 1)))
+						uNewSize = (jrs_sizet)(1 << (JRSCountLeadingZero((jrs_u32)uNewSize) + 1));
+
+					if(uNewSize == pBlock->sizeOfSubAllocs)
+					{
+#ifndef MEMORYMANAGER_MINIMAL
+						if(m_bEnableMemoryTracking && pBlock->pDebugInfo)
+						{
+							jrs_sizet offsetDebug = ((jrs_sizet)pMemory & (m_uPageSize - 1)) / pBlock->sizeOfSubAllocs;
+							UpdateDebugInfo((jrs_u8 *)pBlock->pDebugInfo + (m_uDebugHeaderSize * offsetDebug), pName);
+						}
+#endif
+						NIHEAP_THREADUNLOCK
+						return pMemory;
+					}
+				}
+			}
+			else
+			{
+				// Page allocations.  Anything that would normally be a sub allocation just keeps a single page.
+				jrs_u32 uNumPages = pBlock->numFreePages;
+				jrs_u32 uNewNumPages = 1;
+				if(uNewSize > m_uPageSize >> 1)
+					uNewNumPages = (jrs_u32)(((uNewSize + (m_uPageSize - 1)) & ~(m_uPageSize - 1)) / m_uPageSize);
+
+				sPageBlock *pSlabEnd = pSlab->pBlocks + pSlab->numBlocks;
+				sPageBlock *pBlockNext = pBlock + uNumPages;
+				if(pBlockNext >= pSlabEnd)
+					pBlockNext = NULL;
+
+				// Can we do it in place
+				jrs_bool bInPlace = uNewNumPages <= uNumPages;
+				if(!bInPlace && pBlockNext && (pBlockNext->pageFlags & JRSMEMORYMANAGER_PAGEFREE) && pBlockNext->numFreePages >= uNewNumPages - uNumPages)
+					bInPlace = TRUE;
+
+				if(bInPlace)
+				{
+#ifndef MEMORYMANAGER_MINIMAL
+					if(m_bEnableLogging && uNewNumPages != uNumPages)
+					{
+						cMemoryManager::Get().ContinuousLogging_HeapNIOperation(cMemoryManager::eContLog_Free, this, pMemory, 0, uOldSize, 0);
+					}
+#endif
+					if(uNewNumPages > uNumPages)
+					{
+						// Grow into the next free run.  Anything left over goes back to the bins.
+						jrs_u32 uRemaining = pBlockNext->numFreePages - (uNewNumPages - uNumPages);
+						sPageBlock *pAfterRun = pBlockNext + pBlockNext->numFreePages;
+						jrs_u8 uReleased = pBlockNext->pageFlags & JRSMEMORYMANAGER_PAGERELEASED;
+						jrs_u8 uZeroed = pBlockNext->pageFlags & JRSMEMORYMANAGER_PAGEZEROED;
+						RemoveFromBin(pBlockNext);
+						pBlockNext->pageFlags = 0;
+						pBlockNext->numFreePages = 0;
+
+						if(uRemaining)
+						{
+							sPageBlock *pSplit = pBlock + uNewNumPages;
+							AddPagesToBin(pSplit, uRemaining);
+							pSplit->pPrevBlock = pBlock;
+							pSplit->pageFlags |= uZeroed;
+							if(uReleased)
+							{
+								pSplit->pageFlags |= JRSMEMORYMANAGER_PAGERELEASED;
+								m_uReleasedSize += pSplit->numFreePages * m_uPageSize;
+							}
+#ifndef MEMORYMANAGER_MINIMAL
+							if(m_bEnableMemoryTracking)
+							{
+								// Only one header for these
+								pSplit->pDebugInfo = GetDebugInfo(pSplit);
+								UpdateDebugInfo(pSplit->pDebugInfo, "MemMan_Empty");
+							}
+#endif
+						}
+						else if(pAfterRun < pSlabEnd)
+						{
+							pAfterRun->pPrevBlock = pBlock;
+						}
+
+						m_uAllocatedSize += (uNewNumPages - uNumPages) * m_uPageSize;
+						if(m_uAllocatedSize > m_uAllocatedSizeMax)
+							m_uAllocatedSizeMax = m_uAllocatedSize;
+					}
+					else if(uNewNumPages < uNumPages)
+					{
+						// Shrink.  Return the trailing pages to the bins and merge them with any free run after us.
+						sPageBlock *pSplit = pBlock + uNewNumPages;
+						jrs_u32 uFreePages = uNumPages - uNewNumPages;
+						sPageBlock *pAfterRun = pBlockNext;
+						jrs_u8 uMergedReleased = 0;
+						if(pBlockNext && (pBlockNext->pageFlags & JRSMEMORYMANAGER_PAGEFREE))
+						{
+							uFreePages += pBlockNext->numFreePages;
+							uMergedReleased = pBlockNext->pageFlags & JRSMEMORYMANAGER_PAGERELEASED;
+							pAfterRun = pBlockNext + pBlockNext->numFreePages;
+							if(pAfterRun >= pSlabEnd)
+								pAfterRun = NULL;
+							RemoveFromBin(pBlockNext);
+							pBlockNext->pageFlags = 0;
+							pBlockNext->numFreePages = 0;
+						}
+
+						pSplit->Clear();
+						pSplit->slabNum = pBlock->slabNum;
+						AddPagesToBin(pSplit, uFreePages);
+						pSplit->pPrevBlock = pBlock;
+						if(pAfterRun)
+							pAfterRun->pPrevBlock = pSplit;
+#ifndef MEMORYMANAGER_MINIMAL
+						if(m_bEnableMemoryTracking)
+						{
+							// Only one header for these
+							pSplit->pDebugInfo = GetDebugInfo(pSplit);
+							UpdateDebugInfo(pSplit->pDebugInfo, "MemMan_Empty");
+						}
+#endif
+						m_uAllocatedSize -= (uNumPages - uNewNumPages) * m_uPageSize;
+
+						// Merged with released pages so release the whole run and count it again from the merged block
+						if(uMergedReleased)
+							ReleasePages(pSplit);
+					}
+
+					pBlock->numFreePages = uNewNumPages;
+
+#ifndef MEMORYMANAGER_MINIMAL
+					if(m_bEnableMemoryTracking)
+					{
+						UpdateDebugInfo(pBlock->pDebugInfo, pName);
+					}
+
+					if(m_bEnableLogging && uNewNumPages != uNumPages)
+					{
+						cMemoryManager::Get().ContinuousLogging_HeapNIOperation(cMemoryManager::eContLog_Allocate, this, pMemory, uAlignment, uNewNumPages * m_uPageSize, 0);
+					}
+#endif
+					NIHEAP_THREADUNLOCK
+					return pMemory;
+				}
+			}
+		}
+
+		NIHEAP_THREADUNLOCK
+
+		// Could not be done in place.  Allocate, copy and free the old memory.
+		void *pNewMem = AllocateMemory(uSize, uAlignment, uFlag, pName, uExternalId);
+		if(!pNewMem)
+			return 0;
+
+		memcpy(pNewMem, pMemory, uOldSize < uSize ? uOldSize : uSize);
+		FreeMemory(pMemory, uFlag, pName, uExternalId);
+
+		// Return the new memory
+		return pNewMem;
+	}
+
 	//  Description:
 	//		Internal.  Clears The page blocks to known values.
 	//  See Also:
@@ -1068,11 +1503,16 @@ namespace Elephant
 			m_uAvailableBins &= ~(1 << uBinP);
 		}
 
+		// Released pages are no longer tracked once they leave the bins
+		if(pBlock->pageFlags & JRSMEMORYMANAGER_PAGERELEASED)
+		{
+			m_uReleasedSize -= pBlock->numFreePages * m_uPageSize;
+			pBlock->pageFlags &= ~JRSMEMORYMANAGER_PAGERELEASED;
+		}
+
 #ifndef MEMORYMANAGER_MINIMAL
 		if(m_bEnableMemoryTracking)
 		{			
-			// Only one header for these
-			m_pStandardHeap->FreeMemory(pBlock->pDebugInfo, JRSMEMORYFLAG_HEAPDEBUGTAG, "MemMan_Removed");
 			pBlock->pDebugInfo = NULL;
 		}
 #endif
@@ -1094,6 +1534,115 @@ namespace Elephant
 		RemoveFromBin(pageBin, pBlock);
 	}
 
+	//  Description:
+	//		Internal.  Returns the pages of a free run to the system.  The address range stays with the heap so the run can be
+	//		reused without calling the system allocator again.  Only the system pages fully inside the run are released.
+	//  See Also:
+	//		Purge
+	//  Arguments:
+	//		pBlock - First page of a free run that is in the bins.
+	//  Return Value:
+	//      TRUE if the pages were released.
+	//		FALSE otherwise.
+	//  Summary:
+	//		Internal.  Returns the pages of a free run to the system.
+	jrs_bool cHeapNonIntrusive::ReleasePages(sPageBlock *pBlock)
+	{
+		HeapWarning(pBlock->pageFlags & JRSMEMORYMANAGER_PAGEFREE, JRSMEMORYERROR_FATAL, "Only free pages may be released.  FATAL.");
+		if(!m_systemRelease || (pBlock->pageFlags & JRSMEMORYMANAGER_PAGERELEASED))
+			return FALSE;
+
+		sSlab *pSlab = &m_Slabs[pBlock->slabNum];
+		jrs_sizet pageOffsetInSlab = pBlock - pSlab->pBlocks;
+		jrs_i8 *pStart = (jrs_i8 *)pSlab->pBase + (pageOffsetInSlab * m_uPageSize);
+		jrs_i8 *pEnd = pStart + (pBlock->numFreePages * m_uPageSize);
+
+		// The system page size may be larger than ours
+		jrs_sizet uSystemPageSize = m_systemPageSize ? m_systemPageSize() : m_uPageSize;
+		jrs_bool bWholeRun = TRUE;
+		if(uSystemPageSize > m_uPageSize)
+		{
+			bWholeRun = !((jrs_sizet)pStart & (uSystemPageSize - 1)) && !((jrs_sizet)pEnd & (uSystemPageSize - 1));
+			pStart = (jrs_i8 *)(((jrs_sizet)pStart + (uSystemPageSize - 1)) & ~(uSystemPageSize - 1));
+			pEnd = (jrs_i8 *)((jrs_sizet)pEnd & ~(uSystemPageSize - 1));
+			if(pEnd <= pStart)
+				return FALSE;
+		}
+
+		if(!m_systemRelease(pStart, (jrs_u64)(pEnd - pStart)))
+			return FALSE;
+
+		pBlock->pageFlags |= JRSMEMORYMANAGER_PAGERELEASED;
+		m_uReleasedSize += pBlock->numFreePages * m_uPageSize;
+
+		// Released pages may read back as zero but only if the whole run went
+		if(bWholeRun && (cMemoryManager::GetSystemZeroFlags(NULL, m_systemRelease) & JRSMEMORYZEROFLAG_RELEASE))
+			pBlock->pageFlags |= JRSMEMORYMANAGER_PAGEZEROED;
+		return TRUE;
+	}
+
+	//  Description:
+	//		Internal.  Releases all free runs of at least uMinSize bytes that are still resident.  The heap must be locked.
+	//  See Also:
+	//		Purge
+	//  Arguments:
+	//		uMinSize - Minimum size in bytes of a free run to release.
+	//  Return Value:
+	//      Size in bytes released by this call.
+	//  Summary:
+	//		Internal.  Releases free runs back to the system.
+	jrs_sizet cHeapNonIntrusive::InternalPurge(jrs_sizet uMinSize)
+	{
+		if(!m_systemRelease)
+			return 0;
+
+		jrs_u32 uMinPages = (jrs_u32)((uMinSize + (m_uPageSize - 1)) / m_uPageSize);
+		if(!uMinPages)
+			uMinPages = 1;
+
+		// Only the bins that can hold runs this size need checking
+		jrs_sizet uReleased = 0;
+		jrs_u32 uBins = m_uAvailableBins & ~((1 << JRSCountLeadingZero(uMinPages)) - 1);
+		while(uBins)
+		{
+			jrs_u32 uBin = JRSCountTrailingZero(uBins);
+			uBins &= ~(1 << uBin);
+
+			for(sPageBlock *pBlock = m_pBins[uBin]; pBlock; pBlock = pBlock->pNext)
+			{
+				if(pBlock->numFreePages >= uMinPages && !(pBlock->pageFlags & JRSMEMORYMANAGER_PAGERELEASED))
+				{
+					if(ReleasePages(pBlock))
+						uReleased += pBlock->numFreePages * m_uPageSize;
+				}
+			}
+		}
+
+		return uReleased;
+	}
+
+	//  Description:
+	//		Returns free page runs to the system.  The address range stays with the heap and released pages are reused by later allocations
+	//		as normal.  Runs that have already been released are skipped.  This works regardless of the bReleaseFreePages setting but
+	//		requires a valid system release callback.
+	//  See Also:
+	//		GetReleasedMemory, cHeapNonIntrusive::sHeapDetails
+	//  Arguments:
+	//		uMinSize - Minimum size in bytes of a free run to release.  0 releases every free run.  Default 0.
+	//  Return Value:
+	//      Size in bytes released by this call.
+	//  Summary:
+	//		Returns free page runs to the system.
+	jrs_sizet cHeapNonIntrusive::Purge(jrs_sizet uMinSize)
+	{
+		NIHEAP_THREADLOCK
+		m_uReleaseDelayCount = 0;
+		jrs_sizet uReleased = InternalPurge(uMinSize);
+		NIHEAP_THREADUNLOCK
+
+		return uReleased;
+	}
+
 	//  Description:
 	//		Does a report on the heap (statistics and allocations in memory order) to the user TTY callback.  If you want to report these to a file
 	//		include full path and file name to the function.  The generated file is an Overview file for use in Goldfish.  The file is in a 
@@ -1144,7 +1693,7 @@ namespace Elephant
 	//		Reports basic statistics about all heaps to the user TTY callback. 
 	void cHeapNonIntrusive::ReportStatistics(jrs_bool bAdvanced)
 	{
-		HEAP_THREADLOCK
+		NIHEAP_THREADLOCK
 		m_bEnableReportsInErrors = false;
 
 		cMemoryManager::DebugOutput("---------------------------------------------------------------------------------------------");
@@ -1162,6 +1711,7 @@ namespace Elephant
 		jrs_u64 TotalFreeMemory = 0;
 		jrs_u32 TotalFreeCount = 0;
 		jrs_u64 uAllocatedSize = m_uAllocatedSize;
+		jrs_u64 uReleasedSize = m_uReleasedSize;
 
 		// Loop for linked heaps
 		jrs_sizet AllocSize = 0;
@@ -1229,6 +1779,7 @@ namespace Elephant
 	
 		cMemoryManager::DebugOutput("Total Fragments: %d", TotalFreeCount);
 		cMemoryManager::DebugOutput("Total Fragmented Memory: %lluk", TotalFreeMemory >> 10);
+		cMemoryManager::DebugOutput("Released Memory: %lluk", uReleasedSize >> 10);
 	
 		cMemoryManager::DebugOutput("Allow Null Free: %s", m_bAllowNullFree ? "Yes" : "No");
 		cMemoryManager::DebugOutput("Allow 0 size Alloc: %s", m_bAllowZeroSizeAllocations ? "Yes" : "No");
@@ -1244,7 +1795,7 @@ namespace Elephant
 		// End
 		cMemoryManager::DebugOutput("---------------------------------------------------------------------------------------------");
 		m_bEnableReportsInErrors = true;
-		HEAP_THREADUNLOCK
+		NIHEAP_THREADUNLOCK
 	}
 
 	//  Description:
@@ -1262,7 +1813,7 @@ namespace Elephant
 	//		Reports all allocations from all heaps to the user TTY callback and/or a file.
 	void cHeapNonIntrusive::ReportAllocationsMemoryOrder(const jrs_i8 *pLogToFile, jrs_bool includeFreeBlocks, jrs_bool displayCallStack)
 	{
-		HEAP_THREADLOCK
+		NIHEAP_THREADLOCK
 		m_bEnableReportsInErrors = false;
 
 		cMemoryManager::DebugOutput("---------------------------------------------------------------------------------------------");
@@ -1312,12 +1863,12 @@ namespace Elephant
 				jrs_i8 *pMemoryLocation = (jrs_i8 *)m_Slabs[i].pBase + (((((jrs_i8 *)pBlock - (jrs_i8 *)m_Slabs[i].pBlocks) / sizeof(sPageBlock)) * m_uPageSize));
 				
 				const jrs_i8 *pText = "Unknown";
-				jrs_sizet *puCallStack = NULL;
+				jrs_u32 *puStackId = NULL;
 #ifndef MEMORYMANAGER_MINIMAL
 				if(m_bEnableMemoryTracking && pBlock->pDebugInfo)
 				{
 					pText = (jrs_i8 *)pBlock->pDebugInfo;
-					puCallStack = (jrs_sizet *)(pText + MemoryManager_StringLength);
+					puStackId = (jrs_u32 *)(pText + MemoryManager_StringLength);
 				}				
 #endif
 
@@ -1345,6 +1896,7 @@ namespace Elephant
 							jrs_u32 val = pBlock->activeAllocs[ind];
 							for (jrs_u32 c = 0; c < allocsPerBlock; c++) 
 							{
+								const jrs_sizet *puCallStack = cMemoryManager::Get().GetStackFromId(puStackId ? *puStackId : 0);
 								if(((val >> offset) & (bitsToSet)) == bitsToSet)
 								{
 									sprintf(logtext, "%s %6d (%8d %-32s %5d) - 0x%p (0x%p) %u", "Allocation",
@@ -1368,7 +1920,7 @@ namespace Elephant
 									for(jrs_u32 cs = 0; cs < m_uNumCallStacks; cs++)
 									{
 										jrs_i8 temp[32];
-										sprintf(temp, "; 0x%llx", puCallStack ? (jrs_u64)puCallStack[cs] : 0LL);
+										sprintf(temp, "; 0x%llx", (jrs_u64)puCallStack[cs]);
 										strcat(logtext, temp);
 									}
 									
@@ -1400,7 +1952,7 @@ namespace Elephant
 									for(jrs_u32 cs = 0; cs < m_uNumCallStacks; cs++)
 									{
 										jrs_i8 temp[32];
-										sprintf(temp, "; 0x%llx", puCallStack ? (jrs_u64)puCallStack[cs] : 0LL);
+										sprintf(temp, "; 0x%llx", (jrs_u64)puCallStack[cs]);
 										strcat(logtext, temp);
 									}
 
@@ -1410,10 +1962,10 @@ namespace Elephant
 								offset += bitSize;
 								pMemoryLocation += pBlock->sizeOfSubAllocs;
 #ifndef MEMORYMANAGER_MINIMAL
-								if(m_bEnableMemoryTracking)
+								if(m_bEnableMemoryTracking && pBlock->pDebugInfo)
 								{
 									pText += m_uDebugHeaderSize;
-									puCallStack = (jrs_sizet *)((jrs_i8 *)puCallStack + m_uDebugHeaderSize);
+									puStackId = (jrs_u32 *)((jrs_i8 *)puStackId + m_uDebugHeaderSize);
 								}	
 #endif
 							}
@@ -1421,6 +1973,7 @@ namespace Elephant
 					}
 					else
 					{
+						const jrs_sizet *puCallStack = cMemoryManager::Get().GetStackFromId(puStackId ? *puStackId : 0);
 						sprintf(logtext, "%s %6d (%8d %-32s %5d) - 0x%p (0x%p) %llu %u", "Allocation", (jrs_u32)AllocCount, pBlock->pageFlags, pText, 0, pMemoryLocation, pBlock, (jrs_u64)pBlock->numFreePages * m_uPageSize, pBlock->numFreePages);
 						if (displayCallStack)
 							cMemoryManager::StackToString(&logtext[strlen(logtext)], puCallStack, m_uNumCallStacks);
@@ -1434,7 +1987,7 @@ namespace Elephant
 						for(jrs_u32 cs = 0; cs < m_uNumCallStacks; cs++)
 						{
 							jrs_i8 temp[32];
-							sprintf(temp, "; 0x%llx", puCallStack ? (jrs_u64)puCallStack[cs] : 0LL);
+							sprintf(temp, "; 0x%llx", (jrs_u64)puCallStack[cs]);
 							strcat(logtext, temp);
 						}
 
@@ -1444,6 +1997,7 @@ namespace Elephant
 				else
 				{
 					// We have a free block.
+					const jrs_sizet *puCallStack = cMemoryManager::Get().GetStackFromId(puStackId ? *puStackId : 0);
 					if(includeFreeBlocks)
 					{
 						sprintf(logtext, "Free Block %6d (%8d %-32s %5d) - 0x%p (0x%p) %llu %u", (jrs_u32)FreeCount, pBlock->pageFlags, pText, 0, pMemoryLocation, pBlock, (jrs_u64)pBlock->numFreePages * m_uPageSize, pBlock->numFreePages);
@@ -1459,7 +2013,7 @@ namespace Elephant
 					for(jrs_u32 cs = 0; cs < m_uNumCallStacks; cs++)
 					{
 						jrs_i8 temp[32];
-						sprintf(temp, "; 0x%llx", puCallStack ? (jrs_u64)puCallStack[cs] : 0LL);
+						sprintf(temp, "; 0x%llx", (jrs_u64)puCallStack[cs]);
 						strcat(logtext, temp);
 					}
 
@@ -1477,7 +2031,7 @@ namespace Elephant
 
 		cMemoryManager::DebugOutput("---------------------------------------------------------------------------------------------");
 		m_bEnableReportsInErrors = true;
-		HEAP_THREADUNLOCK
+		NIHEAP_THREADUNLOCK
 	}
 
 	//  Description:
@@ -1574,15 +2128,18 @@ namespace Elephant
 	{
 		for(jrs_u32 i = 0; i < m_uNumSlabs; i++)
 		{
-			// When we destroy with allocations we dont bother with these, its left to the user
-			if(!m_bAllowDestructionWithAllocations)
-			{
 #ifndef MEMORYMANAGER_MINIMAL
-				if(m_bEnableMemoryTracking)
-					m_pStandardHeap->FreeMemory(m_Slabs[i].pBlocks->pDebugInfo, JRSMEMORYFLAG_HEAPDEBUGTAG, "MemMan_SlabDebugFree");
-				m_Slabs[i].pBlocks->pDebugInfo = NULL;
-#endif
+			// Tracking side table
+			if(m_Slabs[i].ppDebugInfo)
+			{
+				for(jrs_u32 uRegion = 0; uRegion < m_Slabs[i].uNumDebugRegions; uRegion++)
+				{
+					if(m_Slabs[i].ppDebugInfo[uRegion])
+						cMemoryManager::Get().m_MemoryManagerDefaultFree(m_Slabs[i].ppDebugInfo[uRegion], m_uDebugRegionSize);
+				}
+				m_Slabs[i].ppDebugInfo = NULL;
 			}
+#endif
 
 			if(!m_bSelfManaged)
 			{
@@ -1714,6 +2271,22 @@ namespace Elephant
 		return m_uSize - m_uAllocatedSize;
 	}
 
+	//  Description:
+	//		Returns the amount of free memory that has been returned to the system.  The address range is still owned by the heap and
+	//		is part of GetTotalFreeMemory.
+	//  See Also:
+	//		Purge, GetTotalFreeMemory
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      Size in bytes of released memory.
+	//  Summary:
+	//      Returns the amount of free memory that has been returned to the system.
+	jrs_sizet cHeapNonIntrusive::GetReleasedMemory(void) const
+	{
+		return m_uReleasedSize;
+	}
+
 	//  Description:
 	//		Returns if error checking is enabled or not for the heap.  This is determined by the bEnableErrors flag of sHeapDetails when creating the non intrusive heap.
 	//  See Also:
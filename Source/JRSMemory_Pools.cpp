@@ -14,6 +14,7 @@ Not for disclosure or distribution without Jury Rig Software Ltd's prior written
 
 #include <JRSCoreTypes.h>
 #include <JRSMemory_Pools.h>
+#include <JRSMemory_Thread.h>
 
 #include "JRSMemory_Internal.h"
 #include "JRSMemory_ErrorCodes.h"
@@ -90,7 +91,12 @@ namespace Elephant
 		pPool = new(pPool) cPool(uElementSize, uMaxElements, pHeap, pPoolName, pDetails);
 
 		// Attach the pool to the heap
-		pHeap->AttachPool(pPool);
+		if(!pHeap->AttachPool(pPool, pPool->GetAddress(), pPool->GetSize()))
+		{
+			((cPoolBase *)pPool)->Destroy();
+			pHeap->FreeMemory(pPool, JRSMEMORYFLAG_POOL);
+			return NULL;
+		}
 		cMemoryManager::Get().ContinuousLogging_Operation(cMemoryManager::eContLog_CreatePool, NULL, pPool, 0);
 
 		// Complete
@@ -150,7 +156,12 @@ namespace Elephant
 		}
 
 		// Attach the pool to the heap
-		pHeap->AttachPool(pPool);
+		if(!pHeap->AttachPool(pPool, pPool->m_pDataBuffer, pPool->m_uPoolSize))
+		{
+			((cPoolBase *)pPool)->Destroy();
+			pHeap->FreeMemory(pPool, JRSMEMORYFLAG_POOL);
+			return NULL;
+		}
 		cMemoryManager::Get().ContinuousLogging_Operation(cMemoryManager::eContLog_CreatePool, NULL, pPool, 0);
 
 		// Complete
@@ -177,42 +188,63 @@ namespace Elephant
 		if(pPool)
 		{
 			cMemoryManager::Get().ContinuousLogging_Operation(cMemoryManager::eContLog_DestroyPool, NULL, pPool, 0);
+			RemoveMallocRoutes(pPool);
 			pPool->GetHeap()->RemovePool(pPool);
 		}
 	}
 
 	//  Description:
-	//      Attaches a pool to the Heap.  For cPools only.  Internal function.
+	//      Attaches a pool to the Heap and indexes the address range its elements come from.  The pool list is only changed under the
+	//		manager's pool list lock so LockAllHeaps can walk it.  Internal function.
 	//  See Also:
-	//      RemovePool
+	//      RemovePool, AddPoolRange
 	//  Arguments:
-	//      pPool - cPool to attach.
+	//      pPool - Pool to attach.
+	//		pAddress - Start of the memory the pool allocates elements from.
+	//		uSize - Size in bytes of that memory.
 	//  Return Value:
-	//      Nothing.
+	//      TRUE if attached.  FALSE if the range index could not be grown.
 	//  Summary:
 	//      Attaches a pool to the Heap.
-	void cHeap::AttachPool(cPoolBase *pPool)
+	jrs_bool cHeap::AttachPool(cPoolBase *pPool, void *pAddress, jrs_sizet uSize)
 	{
+		cMemoryManager::Get().m_PoolListLock.Lock();
+		HEAP_THREADLOCK
+
+		if(!AddPoolRange(pPool, pAddress, uSize))
+		{
+			HEAP_THREADUNLOCK
+			cMemoryManager::Get().m_PoolListLock.Unlock();
+			return FALSE;
+		}
+
 		// Simple linked list to add and remove.
 		pPool->m_pNext = m_pAttachedPools;
 		if(m_pAttachedPools)
 			m_pAttachedPools->m_pPrev = pPool;
 
 		m_pAttachedPools = pPool;
+
+		HEAP_THREADUNLOCK
+		cMemoryManager::Get().m_PoolListLock.Unlock();
+		return TRUE;
 	}
 
 	//  Description:
-	//      Removes a pool from the Heap.  For cPools only.  Internal function.
+	//      Removes a pool and all its address ranges from the Heap then destroys it.  Internal function.
 	//  See Also:
 	//      AttachPool
 	//  Arguments:
-	//      pPool - cPool to remove.
+	//      pPool - Pool to remove.
 	//  Return Value:
 	//      Nothing.
 	//  Summary:
 	//      Removes a pool from the Heap.
 	void cHeap::RemovePool(cPoolBase *pPool)
 	{
+		cMemoryManager::Get().m_PoolListLock.Lock();
+		HEAP_THREADLOCK
+
 		cPoolBase *pNext = pPool->m_pNext;
 		cPoolBase *pPrev = pPool->m_pPrev;
 
@@ -232,11 +264,206 @@ namespace Elephant
 			// Else if there is no previous just set it to the next
 			m_pAttachedPools = pNext;
 		}                
+
+		// Drop every range the pool owns.  Done before destruction so the heap accepts the pool memory back.
+		sPoolRangeTable *pTable = m_pPoolRanges;
+		if(pTable)
+		{
+			m_uPoolRangeSequence++;
+			JRSMemoryBarrier();
+
+			jrs_u32 uKeep = 0;
+			for(jrs_u32 i = 0; i < pTable->uNumRanges; i++)
+			{
+				if(pTable->Ranges[i].pPool != pPool)
+					pTable->Ranges[uKeep++] = pTable->Ranges[i];
+			}
+			pTable->uNumRanges = uKeep;
+
+			JRSMemoryBarrier();
+			m_uPoolRangeSequence++;
+		}
+
+		HEAP_THREADUNLOCK
+		cMemoryManager::Get().m_PoolListLock.Unlock();
+
 		cPool *pP = (cPool *)pPool;
 		pP->Destroy();
 		cMemoryManager::Get().Free(pPool, JRSMEMORYFLAG_POOL);
 	}
 
+	//  Description:
+	//      Adds an address range owned by a pool to the sorted range index.  A full index is copied to one twice the size from the default
+	//		system allocator and the old one is kept for readers still searching it.  Internal function.
+	//  See Also:
+	//      RemovePoolRange, FindPoolRange
+	//  Arguments:
+	//      pPool - Pool owning the range.
+	//		pAddress - Start of the range.
+	//		uSize - Size in bytes of the range.
+	//  Return Value:
+	//      TRUE if added.  FALSE if the index could not be grown.
+	//  Summary:
+	//      Adds a pool address range to the heap index.
+	jrs_bool cHeap::AddPoolRange(cPoolBase *pPool, void *pAddress, jrs_sizet uSize)
+	{
+		HEAP_THREADLOCK
+
+		sPoolRangeTable *pTable = m_pPoolRanges;
+		if(!pTable || pTable->uNumRanges == pTable->uMaxRanges)
+		{
+			// The new table is complete before it is published so readers of either table see every range.
+			jrs_u32 uMaxRanges = pTable ? pTable->uMaxRanges << 1 : 16;
+			sPoolRangeTable *pNewTable = (sPoolRangeTable *)cMemoryManager::Get().m_MemoryManagerDefaultAllocator(sizeof(sPoolRangeTable) + (sizeof(sPoolRange) * (uMaxRanges - 1)), NULL);
+			if(!pNewTable)
+			{
+				HEAP_THREADUNLOCK
+				return FALSE;
+			}
+
+			pNewTable->pRetired = pTable;
+			pNewTable->uMaxRanges = uMaxRanges;
+			pNewTable->uNumRanges = pTable ? pTable->uNumRanges : 0;
+			if(pTable)
+				memcpy(pNewTable->Ranges, pTable->Ranges, sizeof(sPoolRange) * pTable->uNumRanges);
+
+			JRSMemoryBarrier();
+			m_pPoolRanges = pNewTable;
+			pTable = pNewTable;
+		}
+
+		m_uPoolRangeSequence++;
+		JRSMemoryBarrier();
+
+		// Insertion point
+		sPoolRange *pRanges = pTable->Ranges;
+		jrs_u32 uInsert = pTable->uNumRanges;
+		while(uInsert && pRanges[uInsert - 1].pStart > (jrs_i8 *)pAddress)
+		{
+			pRanges[uInsert] = pRanges[uInsert - 1];
+			uInsert--;
+		}
+
+		pRanges[uInsert].pStart = (jrs_i8 *)pAddress;
+		pRanges[uInsert].pEnd = (jrs_i8 *)pAddress + uSize;
+		pRanges[uInsert].pPool = pPool;
+		pTable->uNumRanges++;
+
+		JRSMemoryBarrier();
+		m_uPoolRangeSequence++;
+
+		HEAP_THREADUNLOCK
+		return TRUE;
+	}
+
+	//  Description:
+	//      Removes the pool address range starting at the given address.  Internal function.
+	//  See Also:
+	//      AddPoolRange
+	//  Arguments:
+	//      pAddress - Start of the range passed to AddPoolRange.
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Removes a pool address range from the heap index.
+	void cHeap::RemovePoolRange(void *pAddress)
+	{
+		HEAP_THREADLOCK
+
+		sPoolRangeTable *pTable = m_pPoolRanges;
+		for(jrs_u32 i = 0; pTable && i < pTable->uNumRanges; i++)
+		{
+			if(pTable->Ranges[i].pStart == (jrs_i8 *)pAddress)
+			{
+				m_uPoolRangeSequence++;
+				JRSMemoryBarrier();
+
+				memmove(&pTable->Ranges[i], &pTable->Ranges[i + 1], sizeof(sPoolRange) * (pTable->uNumRanges - i - 1));
+				pTable->uNumRanges--;
+
+				JRSMemoryBarrier();
+				m_uPoolRangeSequence++;
+				break;
+			}
+		}
+
+		HEAP_THREADUNLOCK
+	}
+
+	//  Description:
+	//      Frees the range index and every table it replaced.  Internal function.  Called when the heap is destroyed.
+	//  See Also:
+	//      AddPoolRange
+	//  Arguments:
+	//      None
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Frees the range index.
+	void cHeap::DestroyPoolRanges(void)
+	{
+		sPoolRangeTable *pTable = m_pPoolRanges;
+		m_pPoolRanges = NULL;
+		while(pTable)
+		{
+			sPoolRangeTable *pRetired = pTable->pRetired;
+			cMemoryManager::Get().m_MemoryManagerDefaultFree(pTable, sizeof(sPoolRangeTable) + (sizeof(sPoolRange) * (pTable->uMaxRanges - 1)));
+			pTable = pRetired;
+		}
+	}
+
+	//  Description:
+	//      Binary searches the range index for the pool owning an address without locking.  The search is retried if the index changed while
+	//		it was read.  Internal function.
+	//  See Also:
+	//      AddPoolRange, GetPoolFromAllocatedMemory
+	//  Arguments:
+	//      pMemory - Memory address to check.
+	//  Return Value:
+	//      The pool owning the address.  NULL if no attached pool owns it.
+	//  Summary:
+	//      Finds the pool owning an address.
+	cPoolBase *cHeap::FindPoolRange(void *pMemory) const
+	{
+		// Heaps that never had pools skip the search.
+		if(!m_pPoolRanges)
+			return NULL;
+
+		cPoolBase *pPool;
+		jrs_u32 uSequence;
+		do
+		{
+			pPool = NULL;
+			uSequence = m_uPoolRangeSequence;
+			JRSMemoryBarrier();
+
+			// The count may be mid change.  The sequence check below throws that result away.
+			const sPoolRangeTable *pTable = m_pPoolRanges;
+			if(!(uSequence & 1))
+			{
+				// Find the first range starting after the address.  The range before it is the only candidate.
+				const sPoolRange *pRanges = pTable->Ranges;
+				jrs_u32 uLow = 0;
+				jrs_u32 uHigh = pTable->uNumRanges < pTable->uMaxRanges ? pTable->uNumRanges : pTable->uMaxRanges;
+				while(uLow < uHigh)
+				{
+					jrs_u32 uMid = (uLow + uHigh) >> 1;
+					if((jrs_i8 *)pMemory < pRanges[uMid].pStart)
+						uHigh = uMid;
+					else
+						uLow = uMid + 1;
+				}
+
+				if(uLow && (jrs_i8 *)pMemory < pRanges[uLow - 1].pEnd)
+					pPool = pRanges[uLow - 1].pPool;
+			}
+
+			JRSMemoryBarrier();
+		}while((uSequence & 1) || uSequence != m_uPoolRangeSequence);
+
+		return pPool;
+	}
+
 	//  Description:
 	//      Traverses all the pools in a heap iterator style.  
 	//  See Also:
@@ -267,18 +494,7 @@ namespace Elephant
 	//      Checks if the memory comes from a pool.
 	jrs_bool cHeap::IsAllocatedFromAttachedPool(void *pMemory)
 	{
-		// Check the cPools
-		cPoolBase *pPool = m_pAttachedPools;
-		while(pPool)
-		{
-			cPool *pA = (cPool *)pPool;
-			if(pA->IsAllocatedFromThisPool(pMemory))
-				return TRUE;
-
-			// Next
-			pPool = pPool->m_pNext;
-		}
-		return FALSE;
+		return FindPoolRange(pMemory) ? TRUE : FALSE;
 	}
 
 	//  Description:
@@ -294,19 +510,7 @@ namespace Elephant
 	//      Returns the pool the memory pointer comes from.
 	cPoolBase *cHeap::GetPoolFromAllocatedMemory(void *pMemory)
 	{
-		// Check the cPools
-		cPoolBase *pPool = m_pAttachedPools;
-		while(pPool)
-		{
-			cPool *pA = (cPool *)pPool;
-			if(pA->IsAllocatedFromThisPool(pMemory))
-				return pA;
-
-			// Next
-			pPool = pPool->m_pNext;
-		}
-
-		return NULL;
+		return FindPoolRange(pMemory);
 	}
 
 	struct sMemPoolSentinel
@@ -317,7 +521,8 @@ namespace Elephant
 	struct sMemPoolTracking
 	{
 		jrs_i8 Name[MemoryManager_StringLength];
-		jrs_sizet Callstack[8];
+		jrs_u32 uStackId;			// Callstack id in the stack table.  0 for none.
+		jrs_u32 uPad;
 	};
 
 	//  Description:
@@ -364,6 +569,51 @@ namespace Elephant
 
 	}
 
+	//  Description:
+	//      Takes every thread lock of the pool.  Used by cMemoryManager::LockAllHeaps around fork.
+	//  See Also:
+	//      UnlockAllThreadLocks, ReinitializeThreadLocks
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Locks the pool.
+	void cPoolBase::LockAllThreadLocks(void)
+	{
+		m_Mutex.Lock();
+	}
+
+	//  Description:
+	//      Releases the locks taken by LockAllThreadLocks.
+	//  See Also:
+	//      LockAllThreadLocks
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Unlocks the pool.
+	void cPoolBase::UnlockAllThreadLocks(void)
+	{
+		m_Mutex.Unlock();
+	}
+
+	//  Description:
+	//      Recreates the locks taken by LockAllThreadLocks in a forked child.
+	//  See Also:
+	//      LockAllThreadLocks
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Recreates the pool locks.
+	void cPoolBase::ReinitializeThreadLocks(void)
+	{
+		new (&m_Mutex) JRSMemory_ThreadLock();
+	}
+
 	//  Description:
 	//      Returns the cHeap that the Pool is attached too.  This will always be valid.
 	//  See Also:
@@ -579,7 +829,7 @@ namespace Elephant
 		m_uPointerOffset = 0;
 		if(m_bEnableMemoryTracking)
 		{
-			minsize += sizeof(sMemPoolTracking);		// size for name and 8 deep callstack.
+			minsize += sizeof(sMemPoolTracking);		// size for name and callstack id.
 			m_uStartSentinelOffset = m_uTrackingOffset + sizeof(sMemPoolTracking);
 		}
 
@@ -610,16 +860,81 @@ namespace Elephant
 		}
 
 		// Clear the memory read for allocations
+		m_pFreePtr = m_pBuffer;
+		InitializeElements(m_pBuffer, m_uMaxElements, pName);
+		m_uUsedElements = 0;
+
+		// Growing.  Chunks hold exactly the grow count and are found again through the sorted chunk ranges.
+		m_pChunks = m_pChunksTail = NULL;
+		m_uNumChunks = 0;
+		m_ppChunkRanges = NULL;
+		m_uMaxChunkRanges = 0;
+		m_uResizeCount = 0;
+		m_uChunkElements = 0;
+		m_uChunkSize = 0;
+		m_uChunkHeaderSize = 0;
+		m_bReleaseFreeChunks = pDetails->bReleaseFreeChunks;
+		if(pDetails->uGrowElements)
+		{
+			jrs_u32 uHeaderAlign = m_uAlignment < sizeof(jrs_sizet) ? sizeof(jrs_sizet) : m_uAlignment;
+			m_uChunkHeaderSize = (sizeof(sPoolChunk) + (uHeaderAlign - 1)) & ~(uHeaderAlign - 1);
+			m_uChunkElements = pDetails->uGrowElements;
+			m_uChunkSize = m_uChunkHeaderSize + (m_uChunkElements * m_uElementSize);
+		}
+
+		// Thread caches.  Tracking and sentinels need every operation to go through the pool so they are not cached.
+		m_pCaches = NULL;
+		m_uNumCaches = 0;
+		m_uMagazineSize = 0;
+		m_pFullMagazines = m_pEmptyMagazines = NULL;
+		if(pDetails->uMagazineSize && m_bThreadSafe && !m_bEnableMemoryTracking && !m_bEnableSentinel)
+		{
+			PoolWarning(pDetails->uMagazineCaches && !(pDetails->uMagazineCaches & (pDetails->uMagazineCaches - 1)), JRSMEMORYERROR_POOLCREATEELEMENTCOUNT, "Number of thread caches must be a power of 2.");
+			m_uNumCaches = 1;
+			while(m_uNumCaches < pDetails->uMagazineCaches)
+				m_uNumCaches <<= 1;
+
+			m_pCaches = (sPoolCache *)pPoolMemory->AllocateMemory(sizeof(sPoolCache) * m_uNumCaches, 128, JRSMEMORYFLAG_POOL, m_Name);
+			if(m_pCaches)
+			{
+				m_uMagazineSize = pDetails->uMagazineSize;
+				for(jrs_u32 i = 0; i < m_uNumCaches; i++)
+				{
+					new(&m_pCaches[i].Lock) JRSMemory_ThreadLock();
+					m_pCaches[i].pLoaded = m_pCaches[i].pPrevious = NULL;
+				}
+			}
+			else
+			{
+				m_uNumCaches = 0;
+			}
+		}
+	}
+
+	//  Description:
+	//		Links a buffer of elements into a free list and sets up the tracking and sentinels of each.  Private.
+	//  See Also:
+	//		AddChunk
+	//  Arguments:
+	//		pBuffer - Start of the elements.
+	//		uNumElements - Number of elements in the buffer.
+	//		pName - Name given to the free elements.
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Links a buffer of elements into a free list.
+	void cPool::InitializeElements(jrs_sizet *pBuffer, jrs_u32 uNumElements, const jrs_i8 *pName)
+	{
 #ifndef MEMORYMANAGER_MINIMAL
 		// Less optimal version.  This covers the name and call stack if required.  Means we have a few extra instructions but in general
 		// allows for easier use and debugging while not being a noticeable amount slower.
-		jrs_sizet *pBuf = m_pFreePtr = m_pBuffer;
-		for(jrs_u32 i = 0; i < m_uMaxElements; i++)
+		jrs_sizet *pBuf = pBuffer;
+		for(jrs_u32 i = 0; i < uNumElements; i++)
 		{
 			// Do name and callstack
 			if(m_bEnableMemoryTracking)
 			{
-				StackTrace(&pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet))]);
+				((sMemPoolTracking *)&pBuf[m_uTrackingOffset])->uStackId = cMemoryManager::Get().StackTraceId(2, JRSMEMORY_CALLSTACKDEPTH);
 				if(pName)
 					strcpy((char *)&pBuf[m_uTrackingOffset], pName);
 				else
@@ -633,23 +948,173 @@ namespace Elephant
 			}
 
 			pBuf += m_uElementSize / sizeof(jrs_sizet);
-			m_pBuffer[((m_uElementSize / sizeof(jrs_sizet)) * i) + m_uPointerOffset] = (jrs_sizet)pBuf;		
+			pBuffer[((m_uElementSize / sizeof(jrs_sizet)) * i) + m_uPointerOffset] = (jrs_sizet)pBuf;		
 		}
 
 		// Set the last one to NULL
-		jrs_u32 Offset = ((m_uElementSize / sizeof(jrs_sizet)) * (m_uMaxElements - 1));
-		m_pBuffer[Offset + m_uPointerOffset ] = 0;
+		jrs_u32 Offset = ((m_uElementSize / sizeof(jrs_sizet)) * (uNumElements - 1));
+		pBuffer[Offset + m_uPointerOffset ] = 0;
 #else
 		// Optimized version for full speed.
-		jrs_sizet *pBuf = m_pFreePtr = m_pBuffer;
-		for(jrs_u32 i = 0; i < m_uMaxElements - 1; i++)
+		jrs_sizet *pBuf = pBuffer;
+		for(jrs_u32 i = 0; i < uNumElements - 1; i++)
 		{
 			pBuf += m_uElementSize / sizeof(jrs_sizet);
-			m_pBuffer[(m_uElementSize / sizeof(jrs_sizet)) * i] = (jrs_sizet)pBuf;
+			pBuffer[(m_uElementSize / sizeof(jrs_sizet)) * i] = (jrs_sizet)pBuf;
 		}
-		m_pBuffer[(m_uElementSize / sizeof(jrs_sizet)) * (m_uMaxElements - 1)] = 0;
+		pBuffer[(m_uElementSize / sizeof(jrs_sizet)) * (uNumElements - 1)] = 0;
 #endif
-		m_uUsedElements = 0;
+	}
+
+	//  Description:
+	//		Adds a new chunk of elements from the pool heap to the front of the chunk list.  Private.  Called with the pool locked.
+	//  See Also:
+	//		RemoveChunk, FindChunk
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      The new chunk.  NULL if the heap could not provide the memory.
+	//  Summary:
+	//      Adds a new chunk of elements to the pool.
+	cPool::sPoolChunk *cPool::AddChunk(void)
+	{
+		// Room in the chunk ranges first so a failure leaves nothing to undo.
+		if(m_uNumChunks == m_uMaxChunkRanges)
+		{
+			jrs_u32 uMaxRanges = m_uMaxChunkRanges ? m_uMaxChunkRanges << 1 : 16;
+			sPoolChunk **ppRanges = (sPoolChunk **)m_pAttachedHeap->AllocateMemory(sizeof(sPoolChunk *) * uMaxRanges, 0, JRSMEMORYFLAG_POOL, m_Name);
+			if(!ppRanges)
+				return NULL;
+
+			if(m_ppChunkRanges)
+			{
+				memcpy(ppRanges, m_ppChunkRanges, sizeof(sPoolChunk *) * m_uNumChunks);
+				m_pAttachedHeap->FreeMemory(m_ppChunkRanges, JRSMEMORYFLAG_POOL, m_Name);
+			}
+			m_ppChunkRanges = ppRanges;
+			m_uMaxChunkRanges = uMaxRanges;
+		}
+
+		// Heaps align to at least their default so only ask for larger
+		jrs_u32 uChunkAlign = m_uAlignment > m_pAttachedHeap->GetDefaultAlignment() ? m_uAlignment : 0;
+		sPoolChunk *pChunk = (sPoolChunk *)m_pAttachedHeap->AllocateMemory(m_uChunkSize, uChunkAlign, JRSMEMORYFLAG_POOL, m_Name);
+		if(!pChunk)
+			return NULL;
+
+		// Index the elements so the heap can find the pool from an address.
+		if(!m_pAttachedHeap->AddPoolRange(this, (jrs_i8 *)pChunk + m_uChunkHeaderSize, m_uChunkSize - m_uChunkHeaderSize))
+		{
+			m_pAttachedHeap->FreeMemory(pChunk, JRSMEMORYFLAG_POOL, m_Name);
+			return NULL;
+		}
+
+		// Keep the chunk ranges sorted by address
+		jrs_u32 uInsert = m_uNumChunks;
+		while(uInsert && m_ppChunkRanges[uInsert - 1] > pChunk)
+		{
+			m_ppChunkRanges[uInsert] = m_ppChunkRanges[uInsert - 1];
+			uInsert--;
+		}
+		m_ppChunkRanges[uInsert] = pChunk;
+
+		pChunk->pOwner = this;
+		pChunk->pFreePtr = (jrs_sizet *)((jrs_i8 *)pChunk + m_uChunkHeaderSize);
+		pChunk->uUsedElements = 0;
+		InitializeElements(pChunk->pFreePtr, m_uChunkElements, m_Name);
+
+		// Link to the front
+		pChunk->pPrev = NULL;
+		pChunk->pNext = m_pChunks;
+		if(m_pChunks)
+			m_pChunks->pPrev = pChunk;
+		else
+			m_pChunksTail = pChunk;
+		m_pChunks = pChunk;
+		m_uNumChunks++;
+		m_uResizeCount++;
+
+		return pChunk;
+	}
+
+	//  Description:
+	//		Unlinks a chunk and returns its memory to the pool heap.  Private.  Called with the pool locked.
+	//  See Also:
+	//		AddChunk
+	//  Arguments:
+	//		pChunk - Chunk to release.  Must have no allocations.
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Returns a chunk to the pool heap.
+	void cPool::RemoveChunk(sPoolChunk *pChunk)
+	{
+		if(pChunk->pPrev)
+			pChunk->pPrev->pNext = pChunk->pNext;
+		else
+			m_pChunks = pChunk->pNext;
+		if(pChunk->pNext)
+			pChunk->pNext->pPrev = pChunk->pPrev;
+		else
+			m_pChunksTail = pChunk->pPrev;
+		m_uNumChunks--;
+		m_uResizeCount++;
+
+		for(jrs_u32 i = 0; i <= m_uNumChunks; i++)
+		{
+			if(m_ppChunkRanges[i] == pChunk)
+			{
+				memmove(&m_ppChunkRanges[i], &m_ppChunkRanges[i + 1], sizeof(sPoolChunk *) * (m_uNumChunks - i));
+				break;
+			}
+		}
+
+		pChunk->pOwner = NULL;
+		m_pAttachedHeap->RemovePoolRange((jrs_i8 *)pChunk + m_uChunkHeaderSize);
+		m_pAttachedHeap->FreeMemory(pChunk, JRSMEMORYFLAG_POOL, m_Name);
+	}
+
+	//  Description:
+	//		Finds the grown chunk a memory address belongs to.  Searches the pool's sorted chunk ranges so nothing outside the pool is read.  Private.
+	//  See Also:
+	//		IsAllocatedFromThisPool
+	//  Arguments:
+	//		pMemory - Memory address to check.
+	//  Return Value:
+	//      The chunk the address is in.  NULL if it is not from a chunk of this pool.
+	//  Summary:
+	//      Finds the grown chunk a memory address belongs to.
+	cPool::sPoolChunk *cPool::FindChunk(void *pMemory) const
+	{
+		if(!m_uNumChunks)
+			return NULL;
+
+		// The ranges move when chunks are added or removed.  The lock is recursive so callers may already hold it.
+		if(m_bThreadSafe)
+			const_cast<JRSMemory_ThreadLock &>(m_Mutex).Lock();
+
+		// Find the first chunk starting after the address.  The chunk before it is the only candidate.
+		jrs_u32 uLow = 0, uHigh = m_uNumChunks;
+		while(uLow < uHigh)
+		{
+			jrs_u32 uMid = (uLow + uHigh) >> 1;
+			if((jrs_i8 *)pMemory < (jrs_i8 *)m_ppChunkRanges[uMid])
+				uHigh = uMid;
+			else
+				uLow = uMid + 1;
+		}
+
+		sPoolChunk *pChunk = NULL;
+		if(uLow)
+		{
+			jrs_i8 *pStart = (jrs_i8 *)m_ppChunkRanges[uLow - 1];
+			if((jrs_i8 *)pMemory >= pStart + m_uChunkHeaderSize && (jrs_i8 *)pMemory < pStart + m_uChunkSize)
+				pChunk = m_ppChunkRanges[uLow - 1];
+		}
+
+		if(m_bThreadSafe)
+			const_cast<JRSMemory_ThreadLock &>(m_Mutex).Unlock();
+
+		return pChunk;
 	}
 
 	//  Description:
@@ -698,12 +1163,36 @@ namespace Elephant
 		if(IsLocked())
 			return NULL;
 
+		// Thread cache first
+		if(m_pCaches)
+		{
+			void *pCached = AllocateFromMagazine();
+			if(pCached)
+			{
+#ifndef MEMORYMANAGER_MINIMAL
+				if(GetHeap()->IsLoggingEnabled())
+					cMemoryManager::Get().ContinuousLogging_PoolOperation(cMemoryManager::eContLog_AllocatePool, this, pCached, 0); 
+#endif
+				return pCached;
+			}
+		}
+
 		// Allocating inplace pools is easy and quick.  We do need to check for threading and if we want to do that however.
 		if(m_bThreadSafe)
 			m_Mutex.Lock();
 
+		// Growable pools take from the first chunk when the main buffer is empty.  Chunks with free elements are always first.
+		sPoolChunk *pChunk = NULL;
+		jrs_sizet **ppFreePtr = &m_pFreePtr;
+		if(!m_pFreePtr && m_uChunkElements)
+		{
+			pChunk = (m_pChunks && m_pChunks->pFreePtr) ? m_pChunks : AddChunk();
+			if(pChunk)
+				ppFreePtr = &pChunk->pFreePtr;
+		}
+
 		// Take some memory out of the pool.
-		if(!m_pFreePtr)
+		if(!*ppFreePtr)
 		{
 			// Release the lock here - the heaps will deal with it.
 			if(m_bThreadSafe)
@@ -731,7 +1220,7 @@ namespace Elephant
 		// We have memory, time to take it from the list
 #ifndef MEMORYMANAGER_MINIMAL
 		// Some extra bits.  Still quick but not as fast
-		jrs_sizet *pMemory = m_pFreePtr;
+		jrs_sizet *pMemory = *ppFreePtr;
 
 		// Check/Mark the sentinels
 		if(m_bEnableSentinel)
@@ -743,7 +1232,7 @@ namespace Elephant
 		// Do name and callstack
 		if(m_bEnableMemoryTracking)
 		{
- 			StackTrace(&pMemory[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet))]);
+ 			((sMemPoolTracking *)&pMemory[m_uTrackingOffset])->uStackId = cMemoryManager::Get().StackTraceId(2, JRSMEMORY_CALLSTACKDEPTH);
 			if(pName)
 				strcpy((char *)&pMemory[m_uTrackingOffset], pName);
 			else
@@ -751,16 +1240,31 @@ namespace Elephant
 		}
 
 		// Get the next pointer
-		m_pFreePtr = (jrs_sizet *)(pMemory[m_uPointerOffset]);
+		*ppFreePtr = (jrs_sizet *)(pMemory[m_uPointerOffset]);
 		
 		// Move the address on to the next
 		pMemory = &pMemory[m_uPointerOffset];
 #else
 		// Very quick
-		void *pMemory = m_pFreePtr;
-		m_pFreePtr = (jrs_sizet *)(*m_pFreePtr);
+		void *pMemory = *ppFreePtr;
+		*ppFreePtr = (jrs_sizet *)(**ppFreePtr);
 #endif
 
+		// Full chunks move to the back so the front one always has space
+		if(pChunk)
+		{
+			pChunk->uUsedElements++;
+			if(!pChunk->pFreePtr && pChunk != m_pChunksTail)
+			{
+				m_pChunks = pChunk->pNext;
+				m_pChunks->pPrev = NULL;
+				pChunk->pPrev = m_pChunksTail;
+				pChunk->pNext = NULL;
+				m_pChunksTail->pNext = pChunk;
+				m_pChunksTail = pChunk;
+			}
+		}
+
 		// Increase the count
 		m_uUsedElements++;
 
@@ -787,89 +1291,496 @@ namespace Elephant
 	//  Return Value:
 	//      None
 	//  Summary:
-	//      Frees a block of memory from the pool that was allocated with AllocateMemory.
-	void cPool::FreeMemory(void *pMemory, const jrs_i8 *pName)
+	//      Frees a block of memory from the pool that was allocated with AllocateMemory.
+	void cPool::FreeMemory(void *pMemory, const jrs_i8 *pName)
+	{
+		// not if there is a lock
+		PoolWarning(!IsLocked(), JRSMEMORYERROR_LOCKED, "Cannot allocate as the pool is locked.");
+		if(IsLocked())
+			return;
+
+		// Thread cache first
+		if(m_pCaches && FreeToMagazine(pMemory))
+		{
+#ifndef MEMORYMANAGER_MINIMAL
+			if(GetHeap()->IsLoggingEnabled())
+				cMemoryManager::Get().ContinuousLogging_PoolOperation(cMemoryManager::eContLog_FreePool, this, pMemory, 0); 
+#endif
+			return;
+		}
+
+		InternalFreeMemory(pMemory, pName, TRUE);
+	}
+
+	//  Description:
+	//		Allocates a block of memory for a caller that never shares the pool between threads.  In the MASTER library this takes the main free 
+	//		list directly when the pool itself was created without locks or thread caches.  Anything else goes through AllocateMemory.
+	//  See Also:
+	//		AllocateMemory, FreeMemoryUnshared
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      Valid memory address.  NULL otherwise.
+	//  Summary:
+	//      Allocates a block of memory for a single threaded caller.
+	void *cPool::AllocateMemoryUnshared(void)
+	{
+#ifdef MEMORYMANAGER_MINIMAL
+		jrs_sizet *pMemory = m_pFreePtr;
+		if(pMemory && !m_bThreadSafe && !m_pCaches && !m_bLocked)
+		{
+			m_pFreePtr = (jrs_sizet *)(*pMemory);
+			m_uUsedElements++;
+			return pMemory;
+		}
+#endif
+		return AllocateMemory(NULL);
+	}
+
+	//  Description:
+	//		Frees a block of memory allocated with AllocateMemoryUnshared.  In the MASTER library main buffer elements go straight back on the 
+	//		free list when the pool was created without locks or thread caches.  Anything else goes through FreeMemory.
+	//  See Also:
+	//		FreeMemory, AllocateMemoryUnshared
+	//  Arguments:
+	//		pMemory - Memory address previously allocated with AllocateMemoryUnshared or AllocateMemory.
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Frees a block of memory for a single threaded caller.
+	void cPool::FreeMemoryUnshared(void *pMemory)
+	{
+#ifdef MEMORYMANAGER_MINIMAL
+		if(!m_bThreadSafe && !m_pCaches && !m_bLocked && pMemory >= m_pBuffer && pMemory < (jrs_i8 *)m_pBuffer + m_uPoolSize)
+		{
+			*(jrs_sizet *)pMemory = (jrs_sizet)m_pFreePtr;
+			m_pFreePtr = (jrs_sizet *)pMemory;
+			m_uUsedElements--;
+			return;
+		}
+#endif
+		FreeMemory(pMemory, NULL);
+	}
+
+	//  Description:
+	//		Returns an element to the pool free lists.  Private.
+	//  See Also:
+	//		FreeMemory, FlushMagazines
+	//  Arguments:
+	//		pMemory - Memory address previously allocated with AllocateMemory.
+	//		pName - Name of the allocation.  31 chars not including null terminator.
+	//		bLog - TRUE to send the free to continuous logging.
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Returns an element to the pool free lists.
+	void cPool::InternalFreeMemory(void *pMemory, const jrs_i8 *pName, jrs_bool bLog)
+	{
+		// Grown chunks.  FindChunk takes the lock and a chunk with an allocation in it cannot be released so the result stays valid.
+		sPoolChunk *pChunk = NULL;
+		if(m_uNumChunks && (pMemory < m_pBuffer || pMemory >= ((jrs_i8 *)m_pBuffer + m_uPoolSize)))
+			pChunk = FindChunk(pMemory);
+
+		// Check the memory came from the overrun heap or not.
+		if(m_bEnableOverrun && !pChunk)
+		{
+			// We dont do this check thread safe.  If the memory has already been freed and comes from the heap that
+			// will always be thread safe.  These values do no change so it wont be a problem.
+
+			// Check it came from the memory or not.
+			if(pMemory < m_pBuffer || pMemory >= ((jrs_i8 *)m_pBuffer + m_uPoolSize))
+			{
+				// It did so free it from the heap.
+				if(m_pOverrunHeap)
+				{
+					m_pOverrunHeap->FreeMemory(pMemory, JRSMEMORYFLAG_POOLMEM, pName);
+					return;
+				}
+
+				// Allow fall through
+			}
+		}
+
+#ifndef MEMORYMANAGER_MINIMAL
+		// Check its valid
+		if(!IsAllocatedFromThisPool(pMemory))
+		{
+			// Freed so exit.
+			PoolWarning(NULL, JRSMEMORYERROR_ADDRESSNOTFROMPOOL, "Memory address is not from this pool (%s)", GetName());
+			return;
+		}
+#endif
+		// Free it from the pool quickly.
+		if(m_bThreadSafe)
+			m_Mutex.Lock();
+
+		jrs_sizet **ppFreePtr = pChunk ? &pChunk->pFreePtr : &m_pFreePtr;
+
+		// Simple as getting the pointer and putting it back into the list
+#ifndef MEMORYMANAGER_MINIMAL
+		jrs_sizet *pBuf = (jrs_sizet *)pMemory - m_uPointerOffset;
+
+		// Check/Mark the sentinels
+		if(m_bEnableSentinel)
+		{
+			CheckAllocatedSentinels((jrs_u32 *)&pBuf[0], (jrs_u32 *)&pBuf[m_uStartSentinelOffset]);
+			SetFreeSentinels((jrs_u32 *)&pBuf[0], (jrs_u32 *)&pBuf[m_uStartSentinelOffset]);
+		}
+
+		// Do name and callstack
+		if(m_bEnableMemoryTracking)
+		{
+			((sMemPoolTracking *)&pBuf[m_uTrackingOffset])->uStackId = cMemoryManager::Get().StackTraceId(2, JRSMEMORY_CALLSTACKDEPTH);
+			if(pName)
+				strcpy((char *)&pBuf[m_uTrackingOffset], pName);
+			else
+				strcpy((char *)&pBuf[m_uTrackingOffset], "Unknown");
+		}
+
+		// Revert the pointer
+		jrs_bool bWasFull = *ppFreePtr ? FALSE : TRUE;
+		pBuf[m_uPointerOffset] = (jrs_sizet)*ppFreePtr;
+		*ppFreePtr = (jrs_sizet *)pBuf;
+#else
+		jrs_sizet *pBuf = (jrs_sizet *)pMemory;
+		jrs_bool bWasFull = *ppFreePtr ? FALSE : TRUE;
+		*pBuf = (jrs_sizet)*ppFreePtr;
+		*ppFreePtr = (jrs_sizet *)pMemory;
+#endif
+
+		// Empty chunks may go back to the heap.  Chunks that were full move to the front.
+		if(pChunk)
+		{
+			pChunk->uUsedElements--;
+			if(!pChunk->uUsedElements && m_bReleaseFreeChunks)
+			{
+				RemoveChunk(pChunk);
+			}
+			else if(bWasFull && pChunk != m_pChunks)
+			{
+				pChunk->pPrev->pNext = pChunk->pNext;
+				if(pChunk->pNext)
+					pChunk->pNext->pPrev = pChunk->pPrev;
+				else
+					m_pChunksTail = pChunk->pPrev;
+				pChunk->pPrev = NULL;
+				pChunk->pNext = m_pChunks;
+				m_pChunks->pPrev = pChunk;
+				m_pChunks = pChunk;
+			}
+		}
+
+		// Decrease the count
+		m_uUsedElements--;
+
+		// Unlock
+		if(m_bThreadSafe)
+			m_Mutex.Unlock();
+
+		// Log it
+#ifndef MEMORYMANAGER_MINIMAL
+		if(bLog && GetHeap()->IsLoggingEnabled())
+			cMemoryManager::Get().ContinuousLogging_PoolOperation(cMemoryManager::eContLog_FreePool, this, pMemory, 0); 
+#endif
+	}
+
+	//  Description:
+	//		Returns the thread cache for the calling thread.  Threads are hashed across the caches.  Private.
+	//  See Also:
+	//		AllocateFromMagazine, FreeToMagazine
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      Thread cache.
+	//  Summary:
+	//      Returns the thread cache for the calling thread.
+	cPool::sPoolCache *cPool::GetCache(void)
+	{
+		jrs_sizet uHash = JRSThread::CurrentID();
+		uHash ^= uHash >> 16;
+		uHash *= 0x45d9f3b;
+		uHash ^= uHash >> 16;
+		return &m_pCaches[uHash & (m_uNumCaches - 1)];
+	}
+
+	//  Description:
+	//		Creates an empty magazine from the pool heap.  Private.  Called with the pool locked.
+	//  See Also:
+	//		FreeToMagazine
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      Empty magazine.  NULL if the heap could not provide the memory.
+	//  Summary:
+	//      Creates an empty magazine.
+	cPool::sPoolMagazine *cPool::CreateMagazine(void)
+	{
+		sPoolMagazine *pMagazine = (sPoolMagazine *)m_pAttachedHeap->AllocateMemory(sizeof(sPoolMagazine) + ((m_uMagazineSize - 1) * sizeof(void *)), 0, JRSMEMORYFLAG_POOL, m_Name);
+		if(pMagazine)
+		{
+			pMagazine->pNext = NULL;
+			pMagazine->uRounds = 0;
+		}
+
+		return pMagazine;
+	}
+
+	//  Description:
+	//		Takes an element from the calling thread's cache.  Swaps to the previous magazine or a full one from the depot when the loaded magazine is 
+	//		empty.  Private.
+	//  See Also:
+	//		FreeToMagazine
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      Element.  NULL if there are no cached elements and the pool must be used.
+	//  Summary:
+	//      Takes an element from the calling thread's cache.
+	void *cPool::AllocateFromMagazine(void)
+	{
+		sPoolCache *pCache = GetCache();
+		pCache->Lock.Lock();
+
+		sPoolMagazine *pMagazine = pCache->pLoaded;
+		if(!pMagazine || !pMagazine->uRounds)
+		{
+			if(pCache->pPrevious && pCache->pPrevious->uRounds)
+			{
+				// Previous is full.  Swap.
+				pCache->pLoaded = pCache->pPrevious;
+				pCache->pPrevious = pMagazine;
+			}
+			else
+			{
+				// Exchange the empty previous for a full magazine from the depot
+				m_Mutex.Lock();
+				if(m_pFullMagazines)
+				{
+					sPoolMagazine *pFull = m_pFullMagazines;
+					m_pFullMagazines = pFull->pNext;
+					if(pCache->pPrevious)
+					{
+						pCache->pPrevious->pNext = m_pEmptyMagazines;
+						m_pEmptyMagazines = pCache->pPrevious;
+					}
+					pCache->pPrevious = pCache->pLoaded;
+					pCache->pLoaded = pFull;
+				}
+				m_Mutex.Unlock();
+			}
+
+			pMagazine = pCache->pLoaded;
+			if(!pMagazine || !pMagazine->uRounds)
+			{
+				pCache->Lock.Unlock();
+				return NULL;
+			}
+		}
+
+		void *pMemory = pMagazine->pRounds[--pMagazine->uRounds];
+		pCache->Lock.Unlock();
+
+		return pMemory;
+	}
+
+	//  Description:
+	//		Puts an element into the calling thread's cache.  Swaps to the previous magazine or an empty one from the depot when the loaded 
+	//		magazine is full.  Private.
+	//  See Also:
+	//		AllocateFromMagazine
+	//  Arguments:
+	//		pMemory - Memory address previously allocated with AllocateMemory.
+	//  Return Value:
+	//      TRUE if cached.  FALSE if the pool must free it.
+	//  Summary:
+	//      Puts an element into the calling thread's cache.
+	jrs_bool cPool::FreeToMagazine(void *pMemory)
+	{
+		// Overrun and invalid memory go the normal way
+		if(!IsAllocatedFromThisPool(pMemory))
+			return FALSE;
+
+		sPoolCache *pCache = GetCache();
+		pCache->Lock.Lock();
+
+		sPoolMagazine *pMagazine = pCache->pLoaded;
+		if(!pMagazine || pMagazine->uRounds == m_uMagazineSize)
+		{
+			if(pCache->pPrevious && !pCache->pPrevious->uRounds)
+			{
+				// Previous is empty.  Swap.
+				pCache->pLoaded = pCache->pPrevious;
+				pCache->pPrevious = pMagazine;
+			}
+			else
+			{
+				// Exchange the full previous for an empty magazine from the depot
+				m_Mutex.Lock();
+				sPoolMagazine *pEmpty = m_pEmptyMagazines;
+				if(pEmpty)
+					m_pEmptyMagazines = pEmpty->pNext;
+				else
+					pEmpty = CreateMagazine();
+
+				if(pEmpty)
+				{
+					if(pCache->pPrevious)
+					{
+						pCache->pPrevious->pNext = m_pFullMagazines;
+						m_pFullMagazines = pCache->pPrevious;
+					}
+					pCache->pPrevious = pCache->pLoaded;
+					pCache->pLoaded = pEmpty;
+				}
+				m_Mutex.Unlock();
+			}
+
+			pMagazine = pCache->pLoaded;
+			if(!pMagazine || pMagazine->uRounds == m_uMagazineSize)
+			{
+				pCache->Lock.Unlock();
+				return FALSE;
+			}
+		}
+
+		pMagazine->pRounds[pMagazine->uRounds++] = pMemory;
+		pCache->Lock.Unlock();
+
+		return TRUE;
+	}
+
+	//  Description:
+	//		Returns every element held by the thread caches and the depot back to the pool.  The empty magazines are kept.
+	//  See Also:
+	//		GetNumberOfCachedElements
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Returns every cached element back to the pool.
+	void cPool::FlushMagazines(void)
 	{
-		// not if there is a lock
-		PoolWarning(!IsLocked(), JRSMEMORYERROR_LOCKED, "Cannot allocate as the pool is locked.");
-		if(IsLocked())
+		if(!m_pCaches)
 			return;
 
-		// Check the memory came from the overrun heap or not.
-		if(m_bEnableOverrun)
+		for(jrs_u32 i = 0; i < m_uNumCaches; i++)
 		{
-			// We dont do this check thread safe.  If the memory has already been freed and comes from the heap that
-			// will always be thread safe.  These values do no change so it wont be a problem.
-
-			// Check it came from the memory or not.
-			if(pMemory < m_pBuffer || pMemory >= ((jrs_i8 *)m_pBuffer + m_uPoolSize))
+			sPoolCache *pCache = &m_pCaches[i];
+			pCache->Lock.Lock();
+			sPoolMagazine *pMagazines[2] = { pCache->pLoaded, pCache->pPrevious };
+			for(jrs_u32 m = 0; m < 2; m++)
 			{
-				// It did so free it from the heap.
-				if(m_pOverrunHeap)
-				{
-					m_pOverrunHeap->FreeMemory(pMemory, JRSMEMORYFLAG_POOLMEM, pName);
-					return;
-				}
-
-				// Allow fall through
+				if(!pMagazines[m])
+					continue;
+				while(pMagazines[m]->uRounds)
+					InternalFreeMemory(pMagazines[m]->pRounds[--pMagazines[m]->uRounds], "MemMan_Magazine", FALSE);
 			}
+			pCache->Lock.Unlock();
 		}
 
-#ifndef MEMORYMANAGER_MINIMAL
-		// Check its valid
-		if(!IsAllocatedFromThisPool(pMemory))
+		// The depot
+		m_Mutex.Lock();
+		sPoolMagazine *pFull = m_pFullMagazines;
+		m_pFullMagazines = NULL;
+		m_Mutex.Unlock();
+		while(pFull)
 		{
-			// Freed so exit.
-			PoolWarning(NULL, JRSMEMORYERROR_ADDRESSNOTFROMPOOL, "Memory address is not from this pool (%s)", GetName());
-			return;
-		}
-#endif
-		// Free it from the pool quickly.
-		if(m_bThreadSafe)
+			sPoolMagazine *pNext = pFull->pNext;
+			while(pFull->uRounds)
+				InternalFreeMemory(pFull->pRounds[--pFull->uRounds], "MemMan_Magazine", FALSE);
+
 			m_Mutex.Lock();
+			pFull->pNext = m_pEmptyMagazines;
+			m_pEmptyMagazines = pFull;
+			m_Mutex.Unlock();
+			pFull = pNext;
+		}
+	}
 
-		// Simple as getting the pointer and putting it back into the list
-#ifndef MEMORYMANAGER_MINIMAL
-		jrs_sizet *pBuf = (jrs_sizet *)pMemory - m_uPointerOffset;
+	//  Description:
+	//		Gets the number of elements held by the thread caches and the depot.  These are counted as allocations by the pool.
+	//  See Also:
+	//		FlushMagazines
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      Number of cached elements.
+	//  Summary:
+	//      Gets the number of elements held by the thread caches.
+	jrs_u32 cPool::GetNumberOfCachedElements(void)
+	{
+		jrs_u32 uCached = 0;
+		if(!m_pCaches)
+			return uCached;
 
-		// Check/Mark the sentinels
-		if(m_bEnableSentinel)
+		for(jrs_u32 i = 0; i < m_uNumCaches; i++)
 		{
-			CheckAllocatedSentinels((jrs_u32 *)&pBuf[0], (jrs_u32 *)&pBuf[m_uStartSentinelOffset]);
-			SetFreeSentinels((jrs_u32 *)&pBuf[0], (jrs_u32 *)&pBuf[m_uStartSentinelOffset]);
+			m_pCaches[i].Lock.Lock();
+			if(m_pCaches[i].pLoaded)
+				uCached += m_pCaches[i].pLoaded->uRounds;
+			if(m_pCaches[i].pPrevious)
+				uCached += m_pCaches[i].pPrevious->uRounds;
+			m_pCaches[i].Lock.Unlock();
 		}
 
-		// Do name and callstack
-		if(m_bEnableMemoryTracking)
-		{
-			StackTrace(&pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet))]);
-			if(pName)
-				strcpy((char *)&pBuf[m_uTrackingOffset], pName);
-			else
-				strcpy((char *)&pBuf[m_uTrackingOffset], "Unknown");
-		}
+		m_Mutex.Lock();
+		for(sPoolMagazine *pFull = m_pFullMagazines; pFull; pFull = pFull->pNext)
+			uCached += pFull->uRounds;
+		m_Mutex.Unlock();
 
-		// Revert the pointer
-		pBuf[m_uPointerOffset] = (jrs_sizet)m_pFreePtr;
-		m_pFreePtr = (jrs_sizet *)pBuf;
-#else
-		jrs_sizet *pBuf = (jrs_sizet *)pMemory;
-		*pBuf = (jrs_sizet)m_pFreePtr;
-		m_pFreePtr = (jrs_sizet *)pMemory;
-#endif
+		return uCached;
+	}
 
-		// Decrease the count
-		m_uUsedElements--;
+	//  Description:
+	//      Takes the magazine cache locks and then the pool lock.  The same order allocation and free use.
+	//  See Also:
+	//      cPoolBase::LockAllThreadLocks
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Locks the pool and its caches.
+	void cPool::LockAllThreadLocks(void)
+	{
+		for(jrs_u32 i = 0; m_pCaches && i < m_uNumCaches; i++)
+			m_pCaches[i].Lock.Lock();
+		m_Mutex.Lock();
+	}
 
-		// Unlock
-		if(m_bThreadSafe)
-			m_Mutex.Unlock();
+	//  Description:
+	//      Releases the locks taken by LockAllThreadLocks.
+	//  See Also:
+	//      LockAllThreadLocks
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Unlocks the pool and its caches.
+	void cPool::UnlockAllThreadLocks(void)
+	{
+		m_Mutex.Unlock();
+		for(jrs_u32 i = m_pCaches ? m_uNumCaches : 0; i > 0; i--)
+			m_pCaches[i - 1].Lock.Unlock();
+	}
 
-		// Log it
-#ifndef MEMORYMANAGER_MINIMAL
-		if(GetHeap()->IsLoggingEnabled())
-			cMemoryManager::Get().ContinuousLogging_PoolOperation(cMemoryManager::eContLog_FreePool, this, pMemory, 0); 
-#endif
+	//  Description:
+	//      Recreates the locks taken by LockAllThreadLocks in a forked child.
+	//  See Also:
+	//      LockAllThreadLocks
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Recreates the pool and cache locks.
+	void cPool::ReinitializeThreadLocks(void)
+	{
+		new (&m_Mutex) JRSMemory_ThreadLock();
+		for(jrs_u32 i = 0; m_pCaches && i < m_uNumCaches; i++)
+			new (&m_pCaches[i].Lock) JRSMemory_ThreadLock();
 	}
 
 	//  Description:
@@ -922,11 +1833,15 @@ namespace Elephant
 		if(pMemory >= m_pBuffer && pMemory < (jrs_i8 *)m_pBuffer + m_uPoolSize)
 			return TRUE;
 
+		// Grown chunks
+		if(FindChunk(pMemory))
+			return TRUE;
+
 		return FALSE;
 	}
 
 	//  Description:
-	//		Returns the size of the pool in bytes.
+	//		Returns the size of the pool in bytes.  This includes any chunks a growable pool has added.
 	//  See Also:
 	//		
 	//  Arguments:
@@ -937,7 +1852,7 @@ namespace Elephant
 	//      Returns the size of the pool in bytes.
 	jrs_sizet cPool::GetSize(void) const 
 	{ 
-		return m_uPoolSize; 
+		return m_uPoolSize + ((jrs_sizet)m_uNumChunks * m_uChunkSize); 
 	}
 
 	//  Description:
@@ -995,10 +1910,14 @@ namespace Elephant
 		cMemoryManager::DebugOutput("Pool Start Address: 0x%016x", m_pBuffer);
 		cMemoryManager::DebugOutput("Pool End Address: 0x%016x", (jrs_i8 *)m_pBuffer + m_uPoolSize);
 		cMemoryManager::DebugOutput("Pool Size: %dk (bytes %d (0x%x))", m_uPoolSize >> 10, m_uPoolSize, m_uPoolSize);
-		cMemoryManager::DebugOutput("Max Elements: %d (Element size %d)", m_uMaxElements, m_uElementSize);
-		cMemoryManager::DebugOutput("Used Allocations: %d (%.2f%%)", m_uUsedElements, ((jrs_f32)m_uUsedElements / (jrs_f32)m_uMaxElements) * 100.0f);
+		cMemoryManager::DebugOutput("Max Elements: %d (Element size %d)", GetMaxAllocations(), m_uElementSize);
+		cMemoryManager::DebugOutput("Used Allocations: %d (%.2f%%)", m_uUsedElements, ((jrs_f32)m_uUsedElements / (jrs_f32)GetMaxAllocations()) * 100.0f);
+		if(m_uChunkElements)
+			cMemoryManager::DebugOutput("Grown Chunks: %d (%d elements each, chunk size %dk)%s", m_uNumChunks, m_uChunkElements, m_uChunkSize >> 10, m_bReleaseFreeChunks ? " Releasing free chunks" : "");
 		cMemoryManager::DebugOutput("Using Name and Callstack: %s", m_bEnableMemoryTracking ? "Yes" : "No");
 		cMemoryManager::DebugOutput("Using Sentinel Checking: %s", m_bEnableSentinel ? "Yes" : "No");
+		if(m_pCaches)
+			cMemoryManager::DebugOutput("Thread Caches: %d (Magazine size %d)", m_uNumCaches, m_uMagazineSize);
 		if(m_bEnableOverrun)
 			cMemoryManager::DebugOutput("Using Overrun Heap: %s", m_pOverrunHeap->GetName());
 		else
@@ -1038,83 +1957,16 @@ namespace Elephant
 			cMemoryManager::DebugOutput("Pool       - Address");
 
 		// Log the header
-		cMemoryManager::DebugOutputFile(pLogToFile, g_ReportHeapCreate, "_PoolHeadMarker_; %s; %u; %u; %u; %u; %u; %u; 0; 0; %u; 32; %u; %u", m_Name, m_uPoolSize, 0, m_uMaxElements, m_uElementSize, m_uUsedElements, 0, 0, 0, 0);	
+		cMemoryManager::DebugOutputFile(pLogToFile, g_ReportHeapCreate, "_PoolHeadMarker_; %s; %u; %u; %u; %u; %u; %u; 0; 0; %u; 32; %u; %u", m_Name, (jrs_u32)GetSize(), 0, GetMaxAllocations(), m_uElementSize, m_uUsedElements, 0, 0, 0, 0);	
 
 		// Log each allocation
 		if(bLogEachAllocation)
 		{
-			jrs_sizet *pBuf = m_pBuffer;
-			while((jrs_i8 *)pBuf < ((jrs_i8 *)m_pBuffer + m_uPoolSize))
-			{
-				// Check if the pBuf address is in the allocated list
-				jrs_bool bAlloc = TRUE;
-				jrs_sizet *pAlloc = m_pFreePtr;
-				while(pAlloc)
-				{
-					// If it matches then is a free block.
-					if(pAlloc == pBuf)
-					{
-						bAlloc = FALSE;
-						break;
-					}
-
-					// No match yet, continue.
-					pAlloc = (jrs_sizet *)pAlloc[m_uPointerOffset];
-				}
-
-				// CSV Main block		 = Marker (Allocation/Free), PoolName, Address, Size, CallStack4, CS3, CS3, CS2, CS1, Text (if one), (line if one)
-
-				// Was it allocated or not?
-				if(bAlloc)
-				{
-					if(m_bEnableMemoryTracking)
-					{
-						cMemoryManager::DebugOutput("Allocation (%-32s) - 0x%016x (0x%016x)", &pBuf[m_uTrackingOffset], &pBuf[m_uPointerOffset], pBuf);
-						cMemoryManager::DebugOutputFile(pLogToFile, g_ReportHeapCreate, "_PoolAlloc_; %u; %u; %s; %u; %u; %u; %u; %u; %u; 0; 0; 0; 0", 
-							&pBuf[m_uPointerOffset], m_uElementSize, &pBuf[m_uTrackingOffset], 
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (0 * sizeof(jrs_sizet))]), 
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (1 * sizeof(jrs_sizet))]),
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (2 * sizeof(jrs_sizet))]),
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (3 * sizeof(jrs_sizet))]),
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (4 * sizeof(jrs_sizet))]),
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (5 * sizeof(jrs_sizet))]),
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (6 * sizeof(jrs_sizet))])); 
-					}
-					else
-					{
-						cMemoryManager::DebugOutput("Allocation - 0x%016x", pBuf);
-						cMemoryManager::DebugOutputFile(pLogToFile, g_ReportHeapCreate, "_PoolAlloc_; %u; %u; %s; %u; %u; %u; %u; %u; %u; 0; 0; 0; 0", 
-							&pBuf[m_uPointerOffset], m_uElementSize, "Unknown", 0, 0, 0, 0, 0, 0, 0); 
-					}
-				}
-				else
-				{
-					if(m_bEnableMemoryTracking)
-					{
-						cMemoryManager::DebugOutput("Free       (%-32s) - 0x%016x (0x%016x)", &pBuf[m_uTrackingOffset], &pBuf[m_uPointerOffset], pBuf);
-						cMemoryManager::DebugOutputFile(pLogToFile, g_ReportHeapCreate, "_PoolFree_; %u; %u; %s; %u; %u; %u; %u; %u; %u; 0; 0; 0; 0", 
-							&pBuf[m_uPointerOffset], m_uElementSize, &pBuf[m_uTrackingOffset], 
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (0 * sizeof(jrs_sizet))]), 
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (1 * sizeof(jrs_sizet))]),
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (2 * sizeof(jrs_sizet))]),
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (3 * sizeof(jrs_sizet))]),
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (4 * sizeof(jrs_sizet))]),
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (5 * sizeof(jrs_sizet))]),
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (6 * sizeof(jrs_sizet))])); 
-
-					}
-					else
-					{
-						cMemoryManager::DebugOutput("Free       - 0x%016x", pBuf);
-						cMemoryManager::DebugOutputFile(pLogToFile, g_ReportHeapCreate, "_PoolFree_; %u; %u; %s; %u; %u; %u; %u; %u; %u; 0; 0; 0; 0", 
-							&pBuf[m_uPointerOffset], m_uElementSize, "Unknown", 0, 0, 0, 0, 0, 0, 0); 
-					}
-			
-				}
+			ReportElements(m_pBuffer, m_uPoolSize, m_pFreePtr, pLogToFile);
 
-				// Next pointer 
-				pBuf += m_uElementSize / sizeof(jrs_sizet);
-			}
+			// Grown chunks
+			for(sPoolChunk *pChunk = m_pChunks; pChunk; pChunk = pChunk->pNext)
+				ReportElements((jrs_sizet *)((jrs_i8 *)pChunk + m_uChunkHeaderSize), m_uChunkElements * m_uElementSize, pChunk->pFreePtr, pLogToFile);
 		}
 		else
 		{
@@ -1129,6 +1981,97 @@ namespace Elephant
 			m_Mutex.Unlock();
 	}
 
+	//  Description:
+	//		Reports each element of a buffer as allocated or free to the user TTY callback and/or a file.  Private.  Called with the pool locked.
+	//  See Also:
+	//		ReportAllocationsMemoryOrder
+	//  Arguments:
+	//		pBuffer - Start of the elements.
+	//		uSize - Size of the elements in bytes.
+	//		pFreePtr - Free list of the buffer.
+	//		pLogToFile - Full path and file name null terminated string. NULL if you do not wish to generate a file.
+	//  Return Value:
+	//      Nothing
+	//  Summary:	
+	//		Reports each element of a buffer.
+	void cPool::ReportElements(jrs_sizet *pBuffer, jrs_sizet uSize, jrs_sizet *pFreePtr, const jrs_i8 *pLogToFile)
+	{
+		jrs_sizet *pBuf = pBuffer;
+		while((jrs_i8 *)pBuf < ((jrs_i8 *)pBuffer + uSize))
+		{
+			// Check if the pBuf address is in the allocated list
+			jrs_bool bAlloc = TRUE;
+			jrs_sizet *pAlloc = pFreePtr;
+			while(pAlloc)
+			{
+				// If it matches then is a free block.
+				if(pAlloc == pBuf)
+				{
+					bAlloc = FALSE;
+					break;
+				}
+
+				// No match yet, continue.
+				pAlloc = (jrs_sizet *)pAlloc[m_uPointerOffset];
+			}
+
+			// CSV Main block		 = Marker (Allocation/Free), PoolName, Address, Size, CallStack4, CS3, CS3, CS2, CS1, Text (if one), (line if one)
+
+			// Was it allocated or not?
+			if(bAlloc)
+			{
+				if(m_bEnableMemoryTracking)
+				{
+					const jrs_sizet *pCallStack = cMemoryManager::Get().GetStackFromId(((sMemPoolTracking *)&pBuf[m_uTrackingOffset])->uStackId);
+					cMemoryManager::DebugOutput("Allocation (%-32s) - 0x%016x (0x%016x)", &pBuf[m_uTrackingOffset], &pBuf[m_uPointerOffset], pBuf);
+					cMemoryManager::DebugOutputFile(pLogToFile, g_ReportHeapCreate, "_PoolAlloc_; %u; %u; %s; %u; %u; %u; %u; %u; %u; 0; 0; 0; 0", 
+						&pBuf[m_uPointerOffset], m_uElementSize, &pBuf[m_uTrackingOffset], 
+						MemoryManagerPlatformAddressToBaseAddress(pCallStack[0]), 
+						MemoryManagerPlatformAddressToBaseAddress(pCallStack[1]),
+						MemoryManagerPlatformAddressToBaseAddress(pCallStack[2]),
+						MemoryManagerPlatformAddressToBaseAddress(pCallStack[3]),
+						MemoryManagerPlatformAddressToBaseAddress(pCallStack[4]),
+						MemoryManagerPlatformAddressToBaseAddress(pCallStack[5]),
+						MemoryManagerPlatformAddressToBaseAddress(pCallStack[6])); 
+				}
+				else
+				{
+					cMemoryManager::DebugOutput("Allocation - 0x%016x", pBuf);
+					cMemoryManager::DebugOutputFile(pLogToFile, g_ReportHeapCreate, "_PoolAlloc_; %u; %u; %s; %u; %u; %u; %u; %u; %u; 0; 0; 0; 0", 
+						&pBuf[m_uPointerOffset], m_uElementSize, "Unknown", 0, 0, 0, 0, 0, 0, 0); 
+				}
+			}
+			else
+			{
+				if(m_bEnableMemoryTracking)
+				{
+					const jrs_sizet *pCallStack = cMemoryManager::Get().GetStackFromId(((sMemPoolTracking *)&pBuf[m_uTrackingOffset])->uStackId);
+					cMemoryManager::DebugOutput("Free       (%-32s) - 0x%016x (0x%016x)", &pBuf[m_uTrackingOffset], &pBuf[m_uPointerOffset], pBuf);
+					cMemoryManager::DebugOutputFile(pLogToFile, g_ReportHeapCreate, "_PoolFree_; %u; %u; %s; %u; %u; %u; %u; %u; %u; 0; 0; 0; 0", 
+						&pBuf[m_uPointerOffset], m_uElementSize, &pBuf[m_uTrackingOffset], 
+						MemoryManagerPlatformAddressToBaseAddress(pCallStack[0]), 
+						MemoryManagerPlatformAddressToBaseAddress(pCallStack[1]),
+						MemoryManagerPlatformAddressToBaseAddress(pCallStack[2]),
+						MemoryManagerPlatformAddressToBaseAddress(pCallStack[3]),
+						MemoryManagerPlatformAddressToBaseAddress(pCallStack[4]),
+						MemoryManagerPlatformAddressToBaseAddress(pCallStack[5]),
+						MemoryManagerPlatformAddressToBaseAddress(pCallStack[6])); 
+
+				}
+				else
+				{
+					cMemoryManager::DebugOutput("Free       - 0x%016x", pBuf);
+					cMemoryManager::DebugOutputFile(pLogToFile, g_ReportHeapCreate, "_PoolFree_; %u; %u; %s; %u; %u; %u; %u; %u; %u; 0; 0; 0; 0", 
+						&pBuf[m_uPointerOffset], m_uElementSize, "Unknown", 0, 0, 0, 0, 0, 0, 0); 
+				}
+		
+			}
+
+			// Next pointer 
+			pBuf += m_uElementSize / sizeof(jrs_sizet);
+		}
+	}
+
 	//  Description:
 	//		Destroys the pool and any internals that the pool may have acquired.  Private function.
 	//  See Also:
@@ -1141,12 +2084,44 @@ namespace Elephant
 	//		Destroys the pool and any internals that the pool may have acquired.
 	void cPool::Destroy(void)
 	{
+		// Cached elements are not allocations
+		if(m_pCaches)
+		{
+			FlushMagazines();
+			for(jrs_u32 i = 0; i < m_uNumCaches; i++)
+			{
+				if(m_pCaches[i].pLoaded)
+					m_pAttachedHeap->FreeMemory(m_pCaches[i].pLoaded, JRSMEMORYFLAG_POOL, m_Name);
+				if(m_pCaches[i].pPrevious)
+					m_pAttachedHeap->FreeMemory(m_pCaches[i].pPrevious, JRSMEMORYFLAG_POOL, m_Name);
+				m_pCaches[i].Lock.~JRSMemory_ThreadLock();
+			}
+			while(m_pEmptyMagazines)
+			{
+				sPoolMagazine *pNext = m_pEmptyMagazines->pNext;
+				m_pAttachedHeap->FreeMemory(m_pEmptyMagazines, JRSMEMORYFLAG_POOL, m_Name);
+				m_pEmptyMagazines = pNext;
+			}
+			m_pAttachedHeap->FreeMemory(m_pCaches, JRSMEMORYFLAG_POOL, m_Name);
+			m_pCaches = NULL;
+		}
+
 		// No destruction with valid allocations?
 		if(!m_bAllowDestructionWithAllocations && m_uUsedElements)
 		{
 			PoolWarning(m_bAllowDestructionWithAllocations && m_uUsedElements, JRSMEMORYERROR_VALIDALLOCATIONS, "Pool still has valid allocations.");
 		}
 
+		// Grown chunks
+		while(m_pChunks)
+			RemoveChunk(m_pChunks);
+		if(m_ppChunkRanges)
+		{
+			m_pAttachedHeap->FreeMemory(m_ppChunkRanges, JRSMEMORYFLAG_POOL, m_Name);
+			m_ppChunkRanges = NULL;
+			m_uMaxChunkRanges = 0;
+		}
+
 		// A heap cant free this with out saying 'it comes from pool'.  We clear that error here by just setting it to null.
 		void *pPoolBuffer = m_pBuffer;
 		m_pBuffer = NULL;
@@ -1235,7 +2210,9 @@ namespace Elephant
 		}
 
 		// We have memory, time to take it from the list
-		jrs_i8 *pOutMemory = (jrs_i8 *)m_pDataBuffer + ((((jrs_sizet)((jrs_i8 *)m_pFreePtr - (jrs_i8 *)m_pBuffer)) / m_uHeaderSize) * m_uElementSize);
+		jrs_u32 uIndex = (jrs_u32)(((jrs_sizet)((jrs_i8 *)m_pFreePtr - (jrs_i8 *)m_pBuffer)) / m_uHeaderSize);
+		jrs_i8 *pOutMemory = (jrs_i8 *)m_pDataBuffer + ((jrs_sizet)uIndex * m_uElementSize);
+		m_pOccupancy[uIndex >> 5] |= 1u << (uIndex & 31);
 #ifndef MEMORYMANAGER_MINIMAL
 		jrs_sizet *pMemory = m_pFreePtr;
 
@@ -1244,7 +2221,7 @@ namespace Elephant
 		// Do name and callstack
 		if(m_bEnableMemoryTracking)
 		{
-			StackTrace(&pMemory[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet))]);
+			((sMemPoolTracking *)&pMemory[m_uTrackingOffset])->uStackId = cMemoryManager::Get().StackTraceId(2, JRSMEMORY_CALLSTACKDEPTH);
 			if(pName)
 				strcpy((char *)&pMemory[m_uTrackingOffset], pName);
 			else
@@ -1304,10 +2281,19 @@ namespace Elephant
 		jrs_sizet uOffset = ((jrs_sizet)((jrs_i8 *)pMemory - (jrs_i8 *)m_pDataBuffer) / m_uElementSize);
 		jrs_sizet *pBuf = &m_pBuffer[uOffset * (m_uHeaderSize / sizeof(jrs_sizet))];
 #ifndef MEMORYMANAGER_MINIMAL
+		// Freeing twice would corrupt the free list.
+		if(!(m_pOccupancy[uOffset >> 5] & (1u << (uOffset & 31))))
+		{
+			PoolWarning(NULL, JRSMEMORYERROR_ALREADYFREED, "Memory address 0x%p has already been freed (%s)", pMemory, GetName());
+			if(m_bThreadSafe)
+				m_Mutex.Unlock();
+			return;
+		}
+
 		// Do name and callstack
 		if(m_bEnableMemoryTracking)
 		{
-			StackTrace(&pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet))]);
+			((sMemPoolTracking *)&pBuf[m_uTrackingOffset])->uStackId = cMemoryManager::Get().StackTraceId(2, JRSMEMORY_CALLSTACKDEPTH);
 			if(pName)
 				strcpy((char *)&pBuf[m_uTrackingOffset], pName);
 			else
@@ -1316,6 +2302,7 @@ namespace Elephant
 #endif
 		*pBuf = (jrs_sizet)m_pFreePtr;
 		m_pFreePtr = (jrs_sizet *)pBuf;
+		m_pOccupancy[uOffset >> 5] &= ~(1u << (uOffset & 31));
 
 		// Decrease the count
 		m_uUsedElements--;
@@ -1346,6 +2333,98 @@ namespace Elephant
 		return m_uUsedElements;
 	}
 
+	//  Description:
+	//		Checks if an element of the pool is currently allocated.  Uses the occupancy bitmap so it does not search the free list.
+	//  See Also:
+	//		ForEachLive
+	//  Arguments:
+	//		pMemory - Address of an element in the pool.
+	//  Return Value:
+	//      TRUE if the element is allocated.  FALSE if it is free or not from this pool.
+	//  Summary:
+	//      Checks if an element of the pool is currently allocated.
+	jrs_bool cPoolNonIntrusive::IsLive(void *pMemory) const
+	{
+		if(!IsAllocatedFromThisPool(pMemory))
+			return FALSE;
+
+		jrs_sizet uOffset = ((jrs_sizet)((jrs_i8 *)pMemory - (jrs_i8 *)m_pDataBuffer) / m_uElementSize);
+		return (m_pOccupancy[uOffset >> 5] & (1u << (uOffset & 31))) ? TRUE : FALSE;
+	}
+
+	//  Description:
+	//		Calls pCallback for every allocated element in address order.  The occupancy bitmap is scanned a word at a time so free runs are 
+	//		skipped cheaply and the elements are visited as a linear sweep of the data buffer.  The pool stays locked for the whole walk.  The 
+	//		callback may free the element it is given.  Elements allocated during the walk may or may not be visited.
+	//  See Also:
+	//		SortFreeList, IsLive
+	//  Arguments:
+	//		pCallback - Function called with each live element.
+	//		pUserData - Passed to the callback unchanged.  Default NULL.
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Calls a function for every allocated element.
+	void cPoolNonIntrusive::ForEachLive(PoolLiveElementCallback pCallback, void *pUserData)
+	{
+		PoolWarning(pCallback, JRSMEMORYERROR_INVALIDARGUMENTS, "Callback cannot be NULL.");
+		if(!pCallback)
+			return;
+
+		if(m_bThreadSafe)
+			m_Mutex.Lock();
+
+		jrs_u32 uWords = (m_uMaxElements + 31) >> 5;
+		for(jrs_u32 uWord = 0; uWord < uWords; uWord++)
+		{
+			jrs_u32 uBits = m_pOccupancy[uWord];
+			while(uBits)
+			{
+				jrs_u32 uIndex = (uWord << 5) + JRSCountTrailingZero(uBits);
+				uBits &= uBits - 1;
+				pCallback((jrs_i8 *)m_pDataBuffer + ((jrs_sizet)uIndex * m_uElementSize), pUserData);
+			}
+		}
+
+		if(m_bThreadSafe)
+			m_Mutex.Unlock();
+	}
+
+	//  Description:
+	//		Rebuilds the free list in address order.  After many out of order frees the free list jumps around the data buffer.  Sorting it means 
+	//		following allocations come from the lowest free addresses upwards which keeps new elements contiguous.  Runs in one pass over the 
+	//		occupancy bitmap.
+	//  See Also:
+	//		ForEachLive
+	//  Arguments:
+	//		None
+	//  Return Value:
+	//      None
+	//  Summary:
+	//      Sorts the free list into address order.
+	void cPoolNonIntrusive::SortFreeList(void)
+	{
+		if(m_bThreadSafe)
+			m_Mutex.Lock();
+
+		// Thread the free elements from the top down so the list ends up in ascending order.
+		jrs_sizet *pFreePtr = NULL;
+		for(jrs_u32 i = m_uMaxElements; i > 0; i--)
+		{
+			jrs_u32 uIndex = i - 1;
+			if(m_pOccupancy[uIndex >> 5] & (1u << (uIndex & 31)))
+				continue;
+
+			jrs_sizet *pBuf = &m_pBuffer[uIndex * (m_uHeaderSize / sizeof(jrs_sizet))];
+			*pBuf = (jrs_sizet)pFreePtr;
+			pFreePtr = pBuf;
+		}
+		m_pFreePtr = pFreePtr;
+
+		if(m_bThreadSafe)
+			m_Mutex.Unlock();
+	}
+
 	//  Description:
 	//		Returns the size of the pool in bytes.
 	//  See Also:
@@ -1502,37 +2581,26 @@ namespace Elephant
 			jrs_sizet *pBuf = m_pBuffer;
 			while((jrs_i8 *)pBuf < ((jrs_i8 *)m_pBuffer + (m_uHeaderSize * m_uMaxElements)))
 			{
-				// Check if the pBuf address is in the allocated list
-				jrs_bool bAlloc = TRUE;
-				jrs_sizet *pAlloc = m_pFreePtr;
-				while(pAlloc)
-				{
-					// If it matches then is a free block.
-					if(pAlloc == pBuf)
-					{
-						bAlloc = FALSE;
-						break;
-					}
-
-					// No match yet, continue.
-					pAlloc = (jrs_sizet *)pAlloc[0];
-				}
+				// Check the occupancy bitmap
+				jrs_u32 uIndex = (jrs_u32)(((jrs_i8 *)pBuf - (jrs_i8 *)m_pBuffer) / m_uHeaderSize);
+				jrs_bool bAlloc = (m_pOccupancy[uIndex >> 5] & (1u << (uIndex & 31))) ? TRUE : FALSE;
 
 				// Was it allocated or not?
 				if(bAlloc)
 				{
 					if(m_bEnableMemoryTracking)
 					{
+						const jrs_sizet *pCallStack = cMemoryManager::Get().GetStackFromId(((sMemPoolTracking *)&pBuf[m_uTrackingOffset])->uStackId);
 						cMemoryManager::DebugOutput("Allocation (%-32s) - 0x%016x (0x%016x)", &pBuf[m_uTrackingOffset], &pBuf[0], pBuf);
 						cMemoryManager::DebugOutputFile(pLogToFile, g_ReportHeapCreate, "_PoolAlloc_; %u; %u; %s; %u; %u; %u; %u; %u; %u; 0; 0; 0; 0", 
 							&pBuf[0], m_uElementSize, &pBuf[m_uTrackingOffset], 
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (0 * sizeof(jrs_sizet))]), 
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (1 * sizeof(jrs_sizet))]),
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (2 * sizeof(jrs_sizet))]),
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (3 * sizeof(jrs_sizet))]),
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (4 * sizeof(jrs_sizet))]),
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (5 * sizeof(jrs_sizet))]),
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (6 * sizeof(jrs_sizet))])); 
+							MemoryManagerPlatformAddressToBaseAddress(pCallStack[0]), 
+							MemoryManagerPlatformAddressToBaseAddress(pCallStack[1]),
+							MemoryManagerPlatformAddressToBaseAddress(pCallStack[2]),
+							MemoryManagerPlatformAddressToBaseAddress(pCallStack[3]),
+							MemoryManagerPlatformAddressToBaseAddress(pCallStack[4]),
+							MemoryManagerPlatformAddressToBaseAddress(pCallStack[5]),
+							MemoryManagerPlatformAddressToBaseAddress(pCallStack[6])); 
 					}
 					else
 					{
@@ -1545,16 +2613,17 @@ namespace Elephant
 				{
 					if(m_bEnableMemoryTracking)
 					{
+						const jrs_sizet *pCallStack = cMemoryManager::Get().GetStackFromId(((sMemPoolTracking *)&pBuf[m_uTrackingOffset])->uStackId);
 						cMemoryManager::DebugOutput("Free       (%-32s) - 0x%016x (0x%016x)", &pBuf[m_uTrackingOffset], &pBuf[0], pBuf);
 						cMemoryManager::DebugOutputFile(pLogToFile, g_ReportHeapCreate, "_PoolFree_; %u; %u; %s; %u; %u; %u; %u; %u; %u; 0; 0; 0; 0", 
 							&pBuf[0], m_uElementSize, &pBuf[m_uTrackingOffset], 
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (0 * sizeof(jrs_sizet))]), 
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (1 * sizeof(jrs_sizet))]),
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (2 * sizeof(jrs_sizet))]),
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (3 * sizeof(jrs_sizet))]),
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (4 * sizeof(jrs_sizet))]),
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (5 * sizeof(jrs_sizet))]),
-							MemoryManagerPlatformAddressToBaseAddress(pBuf[m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)) + (6 * sizeof(jrs_sizet))])); 
+							MemoryManagerPlatformAddressToBaseAddress(pCallStack[0]), 
+							MemoryManagerPlatformAddressToBaseAddress(pCallStack[1]),
+							MemoryManagerPlatformAddressToBaseAddress(pCallStack[2]),
+							MemoryManagerPlatformAddressToBaseAddress(pCallStack[3]),
+							MemoryManagerPlatformAddressToBaseAddress(pCallStack[4]),
+							MemoryManagerPlatformAddressToBaseAddress(pCallStack[5]),
+							MemoryManagerPlatformAddressToBaseAddress(pCallStack[6])); 
 
 					}
 					else
@@ -1675,12 +2744,15 @@ namespace Elephant
 			return FALSE;
 		}
 
-		// Allocate from the pool unless it is null, then just take it from the last memory heap.
-		m_pBuffer = (jrs_sizet *)pPoolMemory->AllocateMemory(m_uHeaderSize * m_uMaxElements, pDetails->uBufferAlignment, JRSMEMORYFLAG_POOL, m_Name);
+		// Allocate from the pool unless it is null, then just take it from the last memory heap.  The occupancy bitmap follows the headers.
+		jrs_sizet uOccupancySize = ((m_uMaxElements + 31) >> 5) * sizeof(jrs_u32);
+		m_pBuffer = (jrs_sizet *)pPoolMemory->AllocateMemory((m_uHeaderSize * m_uMaxElements) + uOccupancySize, pDetails->uBufferAlignment, JRSMEMORYFLAG_POOL, m_Name);
 		if(!m_pBuffer)
 		{
 			PoolWarning(m_pBuffer, JRSMEMORYERROR_NOPOOLMEM, "Not enough memory to allocate the pool header buffer.");
 		}
+		m_pOccupancy = (jrs_u32 *)((jrs_i8 *)m_pBuffer + (m_uHeaderSize * m_uMaxElements));
+		memset(m_pOccupancy, 0, uOccupancySize);
 
 		// Clear the memory read for allocations
 		jrs_sizet *pBuf = m_pFreePtr = m_pBuffer;
@@ -1692,7 +2764,7 @@ namespace Elephant
 #ifndef MEMORYMANAGER_MINIMAL
 			if(m_bEnableMemoryTracking)
 			{
-				StackTrace(&m_pBuffer[((m_uHeaderSize  / sizeof(jrs_sizet)) * i) + (m_uTrackingOffset + (MemoryManager_StringLength / sizeof(jrs_sizet)))]);
+				((sMemPoolTracking *)&m_pBuffer[((m_uHeaderSize  / sizeof(jrs_sizet)) * i) + m_uTrackingOffset])->uStackId = cMemoryManager::Get().StackTraceId(2, JRSMEMORY_CALLSTACKDEPTH);
 				strcpy((char *)&m_pBuffer[((m_uHeaderSize  / sizeof(jrs_sizet)) * i) + m_uTrackingOffset], "Free");
 			}
 #endif
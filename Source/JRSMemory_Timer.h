@@ -72,6 +72,13 @@ namespace Elephant
 
 		jrs_u32 GetElapsedTimeMilliSec(jrs_bool bUpdate = false);
 	};
+
+	// Raw high resolution counter for timing short operations.  GetTicksPerSecond returns 0 on platforms without one.
+	namespace JRSTimer
+	{
+		jrs_u64 GetTicks(void);
+		jrs_u64 GetTicksPerSecond(void);
+	}
 }
 
 #endif	// _JRSMEMORY_TIMER_H
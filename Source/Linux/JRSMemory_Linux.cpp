@@ -6,10 +6,13 @@ This software contains code, techniques and know-how which is confidential and p
 Not for disclosure or distribution without Jury Rig Software Ltd's prior written consent. 
 */
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 #include <unwind.h>
 #include <dlfcn.h> 
 #include <sys/mman.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 #include <JRSMemory.h>
 #include <JRSMemory_Pools.h>
@@ -29,6 +32,11 @@ namespace Elephant
 	// Forward declarations to avoid compiler errors on some platforms
 	void *MemoryManagerDefaultSystemAllocator(jrs_u64 uSize, void *pExtMemoryPtr);
 	void MemoryManagerDefaultSystemFree(void *pFree, jrs_u64 uSize);
+	jrs_bool MemoryManagerDefaultSystemRelease(void *pAddress, jrs_u64 uSize);
+	jrs_u32 MemoryManagerDefaultSystemZeroFlags(void);
+	void MemoryManagerPlatformWriteModuleMap(MemoryManagerOutputToFile Output, const jrs_i8 *pFilePathAndName);
+	void *MemoryManagerPlatformCreateSharedPage(const jrs_i8 *pName, jrs_sizet uSize);
+	void MemoryManagerPlatformDestroySharedPage(const jrs_i8 *pName, void *pPage, jrs_sizet uSize);
 	void MemoryManagerPlatformInit(void);
 	void MemoryManagerPlatformDestroy(void);
 	jrs_sizet MemoryManagerPlatformAddressToBaseAddress(jrs_sizet uAddress);
@@ -55,6 +63,85 @@ namespace Elephant
 		munmap(pFree, uSize);
 	}
 
+	jrs_bool MemoryManagerDefaultSystemRelease(void *pAddress, jrs_u64 uSize)
+	{
+		return madvise(pAddress, uSize, MADV_DONTNEED) == 0;
+	}
+
+	jrs_u32 MemoryManagerDefaultSystemZeroFlags(void)
+	{
+		// mmap returns zero filled pages and MADV_DONTNEED refaults private anonymous pages as zero.
+		return JRSMEMORYZEROFLAG_ALLOCATOR | JRSMEMORYZEROFLAG_RELEASE;
+	}
+
+	void MemoryManagerPlatformWriteModuleMap(MemoryManagerOutputToFile Output, const jrs_i8 *pFilePathAndName)
+	{
+		// pprof reads the mapped libraries in the /proc/self/maps layout so the file is copied as is.
+		int iFile = open("/proc/self/maps", O_RDONLY);
+		if(iFile < 0)
+			return;
+
+		jrs_i8 Buffer[4096];
+		ssize_t iRead;
+		while((iRead = read(iFile, Buffer, sizeof(Buffer))) > 0)
+			Output(Buffer, (int)iRead, pFilePathAndName, true);
+		close(iFile);
+	}
+
+	// The shared page this process created.  Only the creator removes it and only while the name still refers to it.
+	static jrs_i8 g_SharedPageName[128];
+	static pid_t g_SharedPageOwner = 0;
+	static dev_t g_SharedPageDevice = 0;
+	static ino_t g_SharedPageInode = 0;
+
+	void *MemoryManagerPlatformCreateSharedPage(const jrs_i8 *pName, jrs_sizet uSize)
+	{
+		// %d in the name becomes the process id so processes do not share a page.  The name is copied untouched otherwise.
+		const jrs_i8 *pPid = strstr(pName, "%d");
+		int iLength = pPid ? snprintf(g_SharedPageName, sizeof(g_SharedPageName), "%.*s%d%s", (int)(pPid - pName), pName, (int)getpid(), pPid + 2) :
+			snprintf(g_SharedPageName, sizeof(g_SharedPageName), "%s", pName);
+		if(iLength < 0 || iLength >= (int)sizeof(g_SharedPageName))
+			return NULL;
+
+		// A page already using the name belongs to someone else or to a process that did not shut down.  It is left alone and creating fails.
+		int iFile = shm_open(g_SharedPageName, O_RDWR | O_CREAT | O_EXCL, 0644);
+		if(iFile < 0)
+			return NULL;
+
+		struct stat Stat;
+		void *pPage = MAP_FAILED;
+		if(fstat(iFile, &Stat) == 0 && ftruncate(iFile, (off_t)uSize) == 0)
+			pPage = mmap(NULL, uSize, PROT_READ | PROT_WRITE, MAP_SHARED, iFile, 0);
+		close(iFile);
+
+		if(pPage == MAP_FAILED)
+		{
+			shm_unlink(g_SharedPageName);
+			return NULL;
+		}
+
+		g_SharedPageOwner = getpid();
+		g_SharedPageDevice = Stat.st_dev;
+		g_SharedPageInode = Stat.st_ino;
+		return pPage;
+	}
+
+	void MemoryManagerPlatformDestroySharedPage(const jrs_i8 *pName, void *pPage, jrs_sizet uSize)
+	{
+		munmap(pPage, uSize);
+
+		// A forked child or a page replaced by hand is not ours to remove
+		int iFile = g_SharedPageOwner == getpid() ? shm_open(g_SharedPageName, O_RDONLY, 0) : -1;
+		if(iFile >= 0)
+		{
+			struct stat Stat;
+			if(fstat(iFile, &Stat) == 0 && Stat.st_dev == g_SharedPageDevice && Stat.st_ino == g_SharedPageInode)
+				shm_unlink(g_SharedPageName);
+			close(iFile);
+		}
+		g_SharedPageOwner = 0;
+	}
+
 	jrs_sizet MemoryManagerSystemPageSize(void)
 	{
 		return sysconf(_SC_PAGE_SIZE);
@@ -108,7 +195,34 @@ namespace Elephant
 		memset(stack.pCallstack, 0, 32 * sizeof(void *));
 		stack.uCount = 0;
 		stack.uSize = 32;
+
+#ifdef MEMORYMANAGER_FRAMEPOINTERS
+		// Follow the saved frame pointers.  Much cheaper than unwinding but only valid while the code is built with frame pointers.  The
+		// walk stops at a link that does not point a little further up the stack, usually code built without frame pointers, and unwinds
+		// instead if that left it short of the requested frames.  Frame 0 is this function.
+		jrs_sizet *pFrame = (jrs_sizet *)__builtin_frame_address(0);
+		stack.uCount = 1;
+		while(pFrame && stack.uCount < stack.uSize && stack.uCount < uCallStackCount)
+		{
+			jrs_sizet *pNext = (jrs_sizet *)pFrame[0];
+			if(!pFrame[1])
+				break;
+			stack.pCallstack[stack.uCount++] = (void *)pFrame[1];
+
+			if(pNext && (pNext <= pFrame || (jrs_sizet)pNext - (jrs_sizet)pFrame > 0x10000 || ((jrs_sizet)pNext & (sizeof(jrs_sizet) - 1))))
+				break;
+			pFrame = pNext;
+		}
+
+		if(stack.uCount < stack.uSize && stack.uCount < uCallStackCount)
+		{
+			memset(stack.pCallstack, 0, 32 * sizeof(void *));
+			stack.uCount = 0;
+			_Unwind_Backtrace(TracFunc, (void *)&stack); 
+		}
+#else
 		_Unwind_Backtrace(TracFunc, (void *)&stack); 
+#endif
 
         for(jrs_i32 i = uCallstackDepth; i < uCallStackCount && i < stack.uCount; i++)
         {
@@ -116,21 +230,6 @@ namespace Elephant
         }
 	}
 
-	void cPoolBase::StackTrace(jrs_sizet *pCallStack)
-	{
-		void* callstack[32];
-		sLocalStack stack;
-		memset(stack.pCallstack, 0, 32 * sizeof(void *));
-		stack.uCount = 0;
-		stack.uSize = 32;
-		_Unwind_Backtrace(TracFunc, (void *)&stack); 
-
-		for(jrs_i32 i = 3; i < JRSMEMORY_CALLSTACKDEPTH && i < stack.uCount; i++)
-		{
-			pCallStack[i - 3] = (jrs_sizet)stack.pCallstack[i]; 
-		}
-	}
-
 	// Socket wrappers per platform.  This doesn't have to be sockets but must function the same.  Although we call it a socket it could just be an id that is passed around.
 
 	//  Description:
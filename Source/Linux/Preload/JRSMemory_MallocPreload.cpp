@@ -0,0 +1,469 @@
+/*
+(C) Copyright 2010 Jury Rig Software Limited. All Rights Reserved.
+
+Use of this software is subject to the terms of an end user license agreement.
+This software contains code, techniques and know-how which is confidential and proprietary to Jury Rig Software Ltd.
+Not for disclosure or distribution without Jury Rig Software Ltd's prior written consent.
+*/
+
+// Replaces the C allocation functions with Elephant so unmodified programs can be run on it with LD_PRELOAD.  Built as
+// libelephant_malloc.so by the JRSMemory_MallocPreload target of Linux.mk.
+//
+//		LD_PRELOAD=Lib/Linux/x64/libelephant_malloc.so ./program
+//
+// Elephant is initialized in resizable mode on the first allocation.  The following environment variables configure it.  Sizes are in bytes
+// and accept a k, m or g suffix.
+//
+//		ELEPHANT_HEAP_SIZE			Initial size of the default heap.  Default 32m.
+//		ELEPHANT_HEAP_RESIZE		Minimum size the default heap grows by.  Default and minimum 32m.
+//		ELEPHANT_HEAP_RECLAIM		Returns free blocks of at least this size to the OS.  0 (default) disables.
+//		ELEPHANT_SIZECLASS_MAX		Largest allocation served by the size class pools of the default heap.  0 (default) disables.
+//		ELEPHANT_SMALLHEAP_SIZE		Size of the small heap.  0 (default) disables.
+//		ELEPHANT_SMALLHEAP_MAX		Largest allocation served by the small heap.  Default 256.
+//		ELEPHANT_VERBOSE			Non zero outputs Elephant messages to stderr.
+//		ELEPHANT_ABORT_ON_ERROR		Non zero aborts on an Elephant error.  Errors are otherwise output and ignored.
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include <JRSMemory.h>
+
+#define JRSMALLOCPRELOAD_EXPORT extern "C" __attribute__((visibility("default")))
+
+namespace
+{
+	// Initialization state.
+	enum
+	{
+		eState_Uninitialized,
+		eState_Initializing,
+		eState_Initialized,
+		eState_Failed
+	};
+
+	// Allocations made while Elephant initializes (dlsym, pthread_atfork, __cxa_atexit and similar may allocate) come from a small
+	// static buffer.  They are never freed.
+	const jrs_u32 BootstrapSize = 64 * 1024;
+	const jrs_u32 BootstrapHeader = 16;
+	jrs_u8 g_BootstrapBuffer[BootstrapSize] __attribute__((aligned(16)));
+	volatile jrs_u32 g_uBootstrapUsed = 0;
+
+	volatile jrs_u32 g_uState = eState_Uninitialized;
+	jrs_bool g_bVerbose = false;
+	jrs_bool g_bAbortOnError = false;
+
+	// Set while this thread initializes Elephant so its allocations use the bootstrap buffer instead of waiting.
+	__thread jrs_bool t_bInitializing __attribute__((tls_model("initial-exec"))) = false;
+
+	//  Description:
+	//      Writes a message to stderr without allocating.
+	//  See Also:
+	//
+	//  Arguments:
+	//      pText - NULL terminated text.
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Writes a message to stderr.
+	void PreloadWrite(const jrs_i8 *pText)
+	{
+		ssize_t iResult = write(STDERR_FILENO, pText, strlen(pText));
+		iResult = write(STDERR_FILENO, "\n", 1);
+		(void)iResult;
+	}
+
+	//  Description:
+	//      Elephant TTY callback.  Only outputs when ELEPHANT_VERBOSE is set.
+	//  See Also:
+	//      PreloadError
+	//  Arguments:
+	//      pText - NULL terminated text.
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Elephant TTY callback.
+	void PreloadTTY(const jrs_i8 *pText)
+	{
+		if(g_bVerbose)
+			PreloadWrite(pText);
+	}
+
+	//  Description:
+	//      Elephant error callback.  Errors are always output.  Aborts when ELEPHANT_ABORT_ON_ERROR is set, otherwise Elephant continues
+	//		as if the error was a warning which matches the behavior programs expect from the system malloc.
+	//  See Also:
+	//      PreloadTTY
+	//  Arguments:
+	//      pError - NULL terminated error text.
+	//		uErrorID - Elephant error code.
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Elephant error callback.
+	void PreloadError(const jrs_i8 *pError, jrs_u32 uErrorID)
+	{
+		PreloadWrite(pError);
+		if(g_bAbortOnError)
+			abort();
+	}
+
+	//  Description:
+	//      Reads a size from the environment.  Sizes are in bytes and accept a k, m or g suffix.
+	//  See Also:
+	//
+	//  Arguments:
+	//      pName - Environment variable name.
+	//		uDefault - Value to return if the variable is not set.
+	//  Return Value:
+	//      Size in bytes.
+	//  Summary:
+	//      Reads a size from the environment.
+	jrs_u64 PreloadGetEnvSize(const jrs_i8 *pName, jrs_u64 uDefault)
+	{
+		const jrs_i8 *pValue = getenv(pName);
+		if(!pValue || !*pValue)
+			return uDefault;
+
+		jrs_i8 *pEnd;
+		jrs_u64 uValue = strtoull(pValue, &pEnd, 10);
+		switch(*pEnd)
+		{
+		case 'k': case 'K': uValue <<= 10; break;
+		case 'm': case 'M': uValue <<= 20; break;
+		case 'g': case 'G': uValue <<= 30; break;
+		}
+
+		return uValue;
+	}
+
+	//  Description:
+	//      Allocates from the bootstrap buffer.  The size is stored before the allocation so realloc can copy it.
+	//  See Also:
+	//      PreloadIsBootstrap
+	//  Arguments:
+	//      uSize - Size in bytes.
+	//		uAlignment - Alignment.  16 bytes or less gives the normal alignment.
+	//  Return Value:
+	//      Valid pointer or NULL if the buffer is exhausted.
+	//  Summary:
+	//      Allocates from the bootstrap buffer.
+	void *PreloadBootstrapAllocate(jrs_sizet uSize, jrs_sizet uAlignment)
+	{
+		if(uAlignment < BootstrapHeader)
+			uAlignment = BootstrapHeader;
+		if(uSize > BootstrapSize || uAlignment > BootstrapSize)
+			return NULL;
+
+		jrs_u32 uUsed, uStart, uEnd;
+		do
+		{
+			uUsed = g_uBootstrapUsed;
+			uStart = (jrs_u32)((uUsed + BootstrapHeader + uAlignment - 1) & ~(uAlignment - 1));
+			uEnd = (jrs_u32)((uStart + uSize + BootstrapHeader - 1) & ~(BootstrapHeader - 1));
+			if(uEnd > BootstrapSize)
+				return NULL;
+		}while(!__sync_bool_compare_and_swap(&g_uBootstrapUsed, uUsed, uEnd));
+
+		*(jrs_sizet *)(g_BootstrapBuffer + uStart - sizeof(jrs_sizet)) = uSize;
+		return g_BootstrapBuffer + uStart;
+	}
+
+	//  Description:
+	//      Checks if memory came from the bootstrap buffer.
+	//  See Also:
+	//      PreloadBootstrapAllocate
+	//  Arguments:
+	//      pMemory - Memory address.
+	//  Return Value:
+	//      TRUE if the memory is from the bootstrap buffer.
+	//  Summary:
+	//      Checks if memory came from the bootstrap buffer.
+	inline jrs_bool PreloadIsBootstrap(void *pMemory)
+	{
+		return (jrs_u8 *)pMemory >= g_BootstrapBuffer && (jrs_u8 *)pMemory < g_BootstrapBuffer + BootstrapSize;
+	}
+
+	//  Description:
+	//      Fork handlers.  All pools and heaps are locked while fork runs so the child never inherits a lock held by another thread.
+	//		The child recreates the locks instead of unlocking them.
+	//  See Also:
+	//      cMemoryManager::LockAllHeaps
+	//  Arguments:
+	//      None.
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Fork handlers.
+	void PreloadForkPrepare(void)
+	{
+		if(g_uState == eState_Initialized)
+			cMemoryManager::Get().LockAllHeaps();
+	}
+
+	void PreloadForkParent(void)
+	{
+		if(g_uState == eState_Initialized)
+			cMemoryManager::Get().UnlockAllHeaps();
+	}
+
+	void PreloadForkChild(void)
+	{
+		if(g_uState == eState_Initialized)
+			cMemoryManager::Get().ReinitializeAllHeapLocks();
+	}
+
+	//  Description:
+	//      Initializes Elephant from the environment.  Only the thread that wins the state change initializes.  Others wait for it and
+	//		allocations made by the initializing thread come from the bootstrap buffer.
+	//  See Also:
+	//      PreloadReady
+	//  Arguments:
+	//      None.
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Initializes Elephant.
+	void PreloadInitialize(void)
+	{
+		if(!__sync_bool_compare_and_swap(&g_uState, eState_Uninitialized, eState_Initializing))
+		{
+			while(g_uState == eState_Initializing)
+				sched_yield();
+			return;
+		}
+
+		t_bInitializing = true;
+		g_bVerbose = PreloadGetEnvSize("ELEPHANT_VERBOSE", 0) != 0;
+		g_bAbortOnError = PreloadGetEnvSize("ELEPHANT_ABORT_ON_ERROR", 0) != 0;
+
+		cMemoryManager::InitializeCallbacks(PreloadTTY, PreloadError);
+
+		// Memory is still freed during global destruction so Elephant has to outlive it.
+		cMemoryManager::InitializeDestroyOnExit(false);
+
+		// Small heap.  Full small heaps overflow into the default heap.
+		jrs_u64 uSmallHeapSize = PreloadGetEnvSize("ELEPHANT_SMALLHEAP_SIZE", 0);
+		if(uSmallHeapSize)
+		{
+			cHeap::sHeapDetails SmallDetails;
+			SmallDetails.bAllowNullFree = true;
+			SmallDetails.bAllowZeroSizeAllocations = true;
+			SmallDetails.bAllowNotEnoughSpaceReturn = true;
+			cMemoryManager::InitializeSmallHeap((jrs_sizet)((uSmallHeapSize + 0xf) & ~0xf), (jrs_u32)PreloadGetEnvSize("ELEPHANT_SMALLHEAP_MAX", 256), &SmallDetails);
+		}
+
+		jrs_u32 uState = eState_Failed;
+		if(cMemoryManager::Get().Initialize(JRSMEMORYINITFLAG_LARGEST, 0, false))
+		{
+			cHeap::sHeapDetails Details;
+			Details.bAllowNullFree = true;
+			Details.bAllowZeroSizeAllocations = true;
+			Details.bAllowNotEnoughSpaceReturn = true;
+			Details.uResizableSize = (jrs_sizet)PreloadGetEnvSize("ELEPHANT_HEAP_RESIZE", Details.uResizableSize);
+			Details.uReclaimSize = (jrs_sizet)PreloadGetEnvSize("ELEPHANT_HEAP_RECLAIM", 0);
+			Details.bAllowResizeReclaimation = Details.uReclaimSize != 0;
+			Details.uSizeClassPoolMax = (jrs_u32)PreloadGetEnvSize("ELEPHANT_SIZECLASS_MAX", 0);
+			if(cMemoryManager::Get().CreateHeap(PreloadGetEnvSize("ELEPHANT_HEAP_SIZE", 32 << 20), "DefaultHeap", &Details))
+			{
+				pthread_atfork(PreloadForkPrepare, PreloadForkParent, PreloadForkChild);
+				uState = eState_Initialized;
+			}
+		}
+
+		if(uState == eState_Failed)
+			PreloadWrite("Elephant malloc failed to initialize.  Allocations will fail.");
+
+		t_bInitializing = false;
+		__sync_synchronize();
+		g_uState = uState;
+	}
+
+	//  Description:
+	//      Makes sure Elephant is initialized before an allocation.
+	//  See Also:
+	//      PreloadInitialize
+	//  Arguments:
+	//      None.
+	//  Return Value:
+	//      TRUE if Elephant can allocate.  FALSE if the bootstrap buffer must be used or initialization failed.
+	//  Summary:
+	//      Makes sure Elephant is initialized.
+	inline jrs_bool PreloadReady(void)
+	{
+		if(__builtin_expect(g_uState == eState_Initialized, 1))
+			return true;
+
+		if(t_bInitializing)
+			return false;
+
+		PreloadInitialize();
+		return g_uState == eState_Initialized;
+	}
+
+	//  Description:
+	//      Allocates memory with the given alignment.  Alignments up to the heap default use the default.
+	//  See Also:
+	//      PreloadFree
+	//  Arguments:
+	//      uSize - Size in bytes.
+	//		uAlignment - Power of 2 alignment.
+	//  Return Value:
+	//      Valid pointer or NULL with errno set to ENOMEM.
+	//  Summary:
+	//      Allocates memory.
+	void *PreloadAllocate(jrs_sizet uSize, jrs_sizet uAlignment)
+	{
+		void *pMemory;
+		if(PreloadReady())
+			pMemory = cMemoryManager::Get().Malloc(uSize, uAlignment > 16 ? (jrs_u32)uAlignment : 0);
+		else
+			pMemory = t_bInitializing ? PreloadBootstrapAllocate(uSize, uAlignment) : NULL;
+
+		if(!pMemory)
+			errno = ENOMEM;
+		return pMemory;
+	}
+
+	//  Description:
+	//      Gets the usable size of an allocation.
+	//  See Also:
+	//      PreloadAllocate
+	//  Arguments:
+	//      pMemory - Valid allocation.
+	//  Return Value:
+	//      Size in bytes.
+	//  Summary:
+	//      Gets the usable size of an allocation.
+	jrs_sizet PreloadSizeof(void *pMemory)
+	{
+		if(PreloadIsBootstrap(pMemory))
+			return *(jrs_sizet *)((jrs_u8 *)pMemory - sizeof(jrs_sizet));
+
+		return cMemoryManager::Get().SizeofAllocation(pMemory);
+	}
+}
+
+JRSMALLOCPRELOAD_EXPORT void *malloc(size_t uSize)
+{
+	return PreloadAllocate(uSize, 0);
+}
+
+JRSMALLOCPRELOAD_EXPORT void free(void *pMemory)
+{
+	// Nothing can have been allocated by Elephant before it was initialized.
+	if(!pMemory || PreloadIsBootstrap(pMemory) || g_uState != eState_Initialized)
+		return;
+
+	cMemoryManager::Get().Free(pMemory);
+}
+
+JRSMALLOCPRELOAD_EXPORT void *calloc(size_t uCount, size_t uSize)
+{
+	jrs_sizet uTotal = uCount * uSize;
+	if(uSize && uTotal / uSize != uCount)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	// Elephant only clears what is not already zero from the system.  The bootstrap buffer is already zeroed.
+	void *pMemory;
+	if(PreloadReady())
+		pMemory = cMemoryManager::Get().Calloc(uCount, uSize);
+	else
+		pMemory = t_bInitializing ? PreloadBootstrapAllocate(uTotal, 0) : NULL;
+
+	if(!pMemory)
+		errno = ENOMEM;
+	return pMemory;
+}
+
+JRSMALLOCPRELOAD_EXPORT void *realloc(void *pMemory, size_t uSize)
+{
+	if(!pMemory)
+		return PreloadAllocate(uSize, 0);
+
+	if(!uSize)
+	{
+		free(pMemory);
+		return NULL;
+	}
+
+	// Bootstrap memory is moved by hand.  Everything else belongs to Elephant.
+	if(PreloadIsBootstrap(pMemory))
+	{
+		void *pNewMemory = PreloadAllocate(uSize, 0);
+		if(pNewMemory)
+		{
+			jrs_sizet uOldSize = PreloadSizeof(pMemory);
+			memcpy(pNewMemory, pMemory, uOldSize < uSize ? uOldSize : uSize);
+			free(pMemory);
+		}
+		return pNewMemory;
+	}
+
+	void *pNewMemory = cMemoryManager::Get().Realloc(pMemory, uSize, 0, JRSMEMORYFLAG_NONE, NULL);
+	if(!pNewMemory)
+		errno = ENOMEM;
+	return pNewMemory;
+}
+
+JRSMALLOCPRELOAD_EXPORT void *reallocarray(void *pMemory, size_t uCount, size_t uSize)
+{
+	jrs_sizet uTotal = uCount * uSize;
+	if(uSize && uTotal / uSize != uCount)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	return realloc(pMemory, uTotal);
+}
+
+JRSMALLOCPRELOAD_EXPORT void *memalign(size_t uAlignment, size_t uSize)
+{
+	if(!uAlignment || (uAlignment & (uAlignment - 1)))
+	{
+		errno = EINVAL;
+		return NULL;
+	}
+
+	return PreloadAllocate(uSize, uAlignment);
+}
+
+JRSMALLOCPRELOAD_EXPORT int posix_memalign(void **ppMemory, size_t uAlignment, size_t uSize)
+{
+	if(!uAlignment || (uAlignment & (uAlignment - 1)) || (uAlignment % sizeof(void *)))
+		return EINVAL;
+
+	void *pMemory = PreloadAllocate(uSize, uAlignment);
+	if(!pMemory)
+		return ENOMEM;
+
+	*ppMemory = pMemory;
+	return 0;
+}
+
+JRSMALLOCPRELOAD_EXPORT void *aligned_alloc(size_t uAlignment, size_t uSize)
+{
+	return memalign(uAlignment, uSize);
+}
+
+JRSMALLOCPRELOAD_EXPORT void *valloc(size_t uSize)
+{
+	return PreloadAllocate(uSize, (jrs_sizet)sysconf(_SC_PAGESIZE));
+}
+
+JRSMALLOCPRELOAD_EXPORT void *pvalloc(size_t uSize)
+{
+	jrs_sizet uPageSize = (jrs_sizet)sysconf(_SC_PAGESIZE);
+	return PreloadAllocate((uSize + uPageSize - 1) & ~(uPageSize - 1), uPageSize);
+}
+
+JRSMALLOCPRELOAD_EXPORT size_t malloc_usable_size(void *pMemory)
+{
+	return pMemory ? PreloadSizeof(pMemory) : 0;
+}
@@ -0,0 +1,1223 @@
+/*
+(C) Copyright 2010 Jury Rig Software Limited. All Rights Reserved.
+
+Use of this software is subject to the terms of an end user license agreement.
+This software contains code, techniques and know-how which is confidential and proprietary to Jury Rig Software Ltd.
+Not for disclosure or distribution without Jury Rig Software Ltd's prior written consent.
+*/
+
+// Replays a compact continuous dump (see cMemoryManager::InitializeCompactContinuousDump) against an allocator so allocator settings can be
+// tuned with a real workload.  Built as elephant_replay by the JRSMemory_Replay target of Linux.mk.
+//
+//		Lib/Linux/x64/elephant_replay [-a capture|heap|ni|glibc] [-t] [-r count] dump.bin
+//
+//		-a	Allocator to replay against.
+//				capture	- Every heap, non intrusive heap and pool is recreated as the kind it was captured as.  Default.
+//				heap	- Every captured heap and pool is recreated as a cHeap.
+//				ni		- Every captured heap and pool is recreated as a cHeapNonIntrusive.
+//				glibc	- Every operation goes to malloc and free.
+//		-t	Replays each captured thread on its own thread.  Operations keep their order within a thread.  A free of memory allocated by another
+//			thread waits for that allocation.  Heaps are created before the threads start and destroyed once they have all finished.
+//		-r	Number of times the replay is repeated.  Timing is the best run.  Default 1.
+//
+// The capture is turned into an operation list before anything is timed.  Every allocation gets a slot which the matching free uses so the
+// replay never looks up addresses.  Allocations to heaps or pools created before the capture started are replayed on a heap created on first
+// use.  Frees of memory allocated before the capture started are skipped.  Memory still allocated when a heap is destroyed is freed first.
+//
+// Every page of an allocation is written to as the program would have.  Footprint is the growth of the resident set over the first run and
+// the memory the allocator uses for allocations including headers and rounding.  Both are sampled every few thousand operations and
+// straight after the allocation that took the capture to its peak, and compared to the bytes the capture had allocated at that peak.  For Elephant the heaps left at the end of the capture are listed with the
+// part of their free memory outside the largest free block.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <malloc.h>
+#include <pthread.h>
+
+#include <vector>
+#include <map>
+
+#include <JRSMemory.h>
+#include <JRSMemory_Pools.h>
+#include <JRSMemory_ContinuousDump.h>
+
+using namespace Elephant;
+
+namespace
+{
+	// Allocators that can be replayed against.
+	enum eReplayAllocator
+	{
+		eReplayAllocator_Capture,
+		eReplayAllocator_Heap,
+		eReplayAllocator_NonIntrusive,
+		eReplayAllocator_Glibc
+	};
+
+	// Replayed operations.
+	enum eReplayOp
+	{
+		eReplayOp_Allocate,
+		eReplayOp_Free,
+		eReplayOp_CreateHeap,
+		eReplayOp_DestroyHeap
+	};
+
+	// Frequency in operations of the footprint samples.
+	const jrs_u32 ReplaySampleFrequency = 4096;
+
+	// Slot value of an allocation that failed during the replay.  Frees of it are skipped.
+	void * const ReplayFailedAllocation = (void *)1;
+
+	// Heap index of operations that have no heap.
+	const jrs_u32 ReplayNoHeap = 0xffffffff;
+
+	// One replayed operation.
+	struct sReplayOp
+	{
+		jrs_u8 uType;				// eReplayOp
+		jrs_u8 bDeferred;			// Heap destruction and its frees.  Run after all threads have finished in threaded replays.
+		jrs_u16 uPad;
+		jrs_u32 uThread;			// Replay thread index
+		jrs_u32 uHeap;				// Heap index
+		jrs_u32 uSlot;				// Allocation slot for allocations and frees
+		jrs_u64 uSize;				// Allocation size
+		jrs_u32 uAlignment;			// Allocation alignment.  0 for the heap default.
+		jrs_u32 uPad2;
+	};
+
+	// A captured heap or pool and what it is replayed on.
+	struct sReplayHeap
+	{
+		jrs_u32 uCaptureId;			// Heap or pool id in the capture
+		jrs_u32 uKind;				// eContinuousDumpKind
+		jrs_u32 uParent;			// Heap index of the parent of a pool.  ReplayNoHeap if it was not captured.
+		jrs_u32 uAlignment;			// Default alignment
+		jrs_u64 uSize;				// Size when created
+		jrs_u64 uMaxSize;			// Largest size after resizing
+		jrs_u64 uMinAllocSize;		// Minimum allocation size
+		jrs_u64 uMaxAllocSize;		// Maximum allocation size
+		jrs_u64 uLive;				// Bytes allocated
+		jrs_u64 uPeakLive;			// Peak bytes allocated
+		jrs_u32 uLiveCount;			// Allocations
+		jrs_u32 uPeakLiveCount;		// Peak allocations
+		jrs_bool bImplicit;			// Created on first use as the creation was not captured
+		jrs_i8 Name[ContinuousDump_MaxName + 1];
+
+		// Replay state
+		cHeap *pHeap;
+		cHeapNonIntrusive *pNIHeap;
+		cPool *pPool;
+		jrs_bool bFolded;			// Could not be created.  Replayed on the bookkeeping heap.
+	};
+
+	// Parsed capture.
+	std::vector<sReplayOp> g_Ops;
+	std::vector<sReplayHeap> g_Heaps;
+	jrs_u32 g_uNumSlots = 0;
+	jrs_u32 g_uNumThreads = 0;
+	jrs_u64 g_uNumRecords = 0;
+	jrs_u64 g_uNumChunks = 0;
+	jrs_u64 g_uNumAllocations = 0;
+	jrs_u64 g_uNumFrees = 0;
+	jrs_u64 g_uUnmatchedFrees = 0;
+	jrs_u64 g_uReusedAddresses = 0;
+	jrs_u64 g_uIgnoredRecords = 0;
+	jrs_u64 g_uLive = 0;
+	jrs_u64 g_uPeakLive = 0;
+	jrs_u32 g_uLiveCount = 0;
+	jrs_u32 g_uPeakLiveCount = 0;
+	jrs_u32 g_uPeakLiveOp = 0;					// Operation that took g_uLive to g_uPeakLive
+	jrs_u64 g_uCaptureTicks = 0;
+	jrs_u64 g_uTicksPerSecond = 1;
+	jrs_bool g_bTruncated = false;
+
+	// Replay state
+	jrs_u32 g_uAllocator = eReplayAllocator_Capture;
+	void * volatile *g_pSlots = NULL;
+	cHeap *g_pBookkeepingHeap = NULL;
+	jrs_u32 g_uFoldedHeaps = 0;
+	volatile jrs_u64 g_uFailedAllocations = 0;
+	volatile jrs_u64 g_uElephantErrors = 0;
+	volatile jrs_u64 g_uPeakResident = 0;
+	volatile jrs_u64 g_uPeakUsed = 0;
+	jrs_u64 g_uBaseResident = 0;
+	jrs_u64 g_uBaseUsed = 0;
+	jrs_u64 g_uPageSize = 4096;
+
+	// Per thread replay lists.  Index 0 is run before the threads start and the last list after they finish.
+	std::vector< std::vector<jrs_u32> > g_ThreadOps;
+
+	// Slots of allocations the capture never freed.
+	std::vector<jrs_u32> g_Leaked;
+
+	//  Description:
+	//      Elephant TTY callback.  Output is discarded as Elephant reports every heap it creates.
+	//  See Also:
+	//      ReplayError
+	//  Arguments:
+	//      pText - NULL terminated text.
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Elephant TTY callback.
+	void ReplayTTY(const jrs_i8 *pText)
+	{
+	}
+
+	//  Description:
+	//      Elephant error callback.  Errors are output and counted.  The replay carries on as the heaps are created with errors as warnings.
+	//  See Also:
+	//      ReplayTTY
+	//  Arguments:
+	//      pError - NULL terminated error text.
+	//		uErrorID - Elephant error code.
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Elephant error callback.
+	void ReplayError(const jrs_i8 *pError, jrs_u32 uErrorID)
+	{
+		if(__sync_fetch_and_add(&g_uElephantErrors, 1) < 10)
+			fprintf(stderr, "Elephant error 0x%x: %s\n", uErrorID, pError);
+	}
+
+	//  Description:
+	//      Returns the monotonic time.
+	//  See Also:
+	//
+	//  Arguments:
+	//      None.
+	//  Return Value:
+	//      Time in nanoseconds.
+	//  Summary:
+	//      Returns the monotonic time.
+	jrs_u64 ReplayGetTime(void)
+	{
+		timespec Time;
+		clock_gettime(CLOCK_MONOTONIC, &Time);
+		return (jrs_u64)Time.tv_sec * 1000000000ULL + (jrs_u64)Time.tv_nsec;
+	}
+
+	//  Description:
+	//      Returns the resident set size of the process.  Reads /proc directly so the glibc replay is not disturbed by stdio allocating.
+	//  See Also:
+	//      ReplayGetUsed
+	//  Arguments:
+	//      None.
+	//  Return Value:
+	//      Resident bytes.  0 if they can not be read.
+	//  Summary:
+	//      Returns the resident set size.
+	jrs_u64 ReplayGetResident(void)
+	{
+		jrs_i8 Buffer[128];
+		int iFile = open("/proc/self/statm", O_RDONLY);
+		if(iFile < 0)
+			return 0;
+
+		ssize_t iRead = read(iFile, Buffer, sizeof(Buffer) - 1);
+		close(iFile);
+		if(iRead <= 0)
+			return 0;
+
+		// Second field is the resident pages
+		Buffer[iRead] = 0;
+		jrs_i8 *pResident = strchr(Buffer, ' ');
+		return pResident ? strtoull(pResident + 1, NULL, 10) * g_uPageSize : 0;
+	}
+
+	//  Description:
+	//      Returns the memory the replay allocator is using for allocations including their headers and rounding.  This is the memory used
+	//		by every heap for Elephant and the allocated chunks and mapped blocks for glibc.
+	//  See Also:
+	//      ReplayGetResident
+	//  Arguments:
+	//      None.
+	//  Return Value:
+	//      Used bytes.
+	//  Summary:
+	//      Returns the memory the replay allocator is using.
+	jrs_u64 ReplayGetUsed(void)
+	{
+		if(g_uAllocator == eReplayAllocator_Glibc)
+		{
+			struct mallinfo2 Info = mallinfo2();
+			return (jrs_u64)Info.uordblks + (jrs_u64)Info.hblkhd;
+		}
+
+		// Pools are allocations in their parent heap
+		jrs_u64 uUsed = g_pBookkeepingHeap ? g_pBookkeepingHeap->GetMemoryUsed() : 0;
+		for(jrs_u32 i = 0; i < g_Heaps.size(); i++)
+		{
+			const sReplayHeap &rHeap = g_Heaps[i];
+			if(rHeap.bFolded || rHeap.pPool)
+				continue;
+			if(rHeap.pHeap)
+				uUsed += rHeap.pHeap->GetMemoryUsed();
+			else if(rHeap.pNIHeap)
+				uUsed += rHeap.pNIHeap->GetMemoryUsed();
+		}
+
+		return uUsed;
+	}
+
+	//  Description:
+	//      Raises a peak to a value.  Safe to call from any replay thread.
+	//  See Also:
+	//      ReplaySample
+	//  Arguments:
+	//      pPeak - Peak to raise.
+	//		uValue - New value.
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Raises a peak to a value.
+	void ReplayRaisePeak(volatile jrs_u64 *pPeak, jrs_u64 uValue)
+	{
+		jrs_u64 uPeak = *pPeak;
+		while(uValue > uPeak && !__sync_bool_compare_and_swap(pPeak, uPeak, uValue))
+			uPeak = *pPeak;
+	}
+
+	//  Description:
+	//      Samples the footprint.  The heap sizes are read without locking the heaps which is fine for a sample.
+	//  See Also:
+	//      ReplayGetResident, ReplayGetUsed
+	//  Arguments:
+	//      None.
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Samples the footprint.
+	void ReplaySample(void)
+	{
+		ReplayRaisePeak(&g_uPeakResident, ReplayGetResident());
+		ReplayRaisePeak(&g_uPeakUsed, ReplayGetUsed());
+	}
+
+	//  Description:
+	//      Finds the heap a capture id is replayed on.  Heaps and pools that were created before the capture started are added the first time
+	//		they are used.
+	//  See Also:
+	//      ReplayAddOp
+	//  Arguments:
+	//      rHeapMap - Map of capture ids to heap indices.  Pools have bit 32 set.
+	//		uId - Heap or pool id.
+	//		bPool - TRUE for a pool.
+	//		uThread - Thread that used the heap.
+	//  Return Value:
+	//      Heap index.
+	//  Summary:
+	//      Finds the heap a capture id is replayed on.
+	jrs_u32 ReplayFindHeap(std::map<jrs_u64, jrs_u32> &rHeapMap, jrs_u32 uId, jrs_bool bPool, jrs_u32 uThread)
+	{
+		jrs_u64 uKey = ((jrs_u64)(bPool ? 1 : 0) << 32) | uId;
+		std::map<jrs_u64, jrs_u32>::iterator it = rHeapMap.find(uKey);
+		if(it != rHeapMap.end())
+			return it->second;
+
+		// Not captured.  Replayed on a heap as the pool size is not known.
+		sReplayHeap Heap;
+		memset(&Heap, 0, sizeof(Heap));
+		Heap.uCaptureId = uId;
+		Heap.uKind = eContinuousDumpKind_Heap;
+		Heap.uParent = ReplayNoHeap;
+		Heap.uSize = Heap.uMaxSize = 32 << 20;
+		Heap.bImplicit = true;
+		snprintf(Heap.Name, sizeof(Heap.Name), "%s %u", bPool ? "Pool" : "Heap", uId);
+
+		jrs_u32 uHeap = (jrs_u32)g_Heaps.size();
+		g_Heaps.push_back(Heap);
+		rHeapMap[uKey] = uHeap;
+
+		sReplayOp Op;
+		memset(&Op, 0, sizeof(Op));
+		Op.uType = eReplayOp_CreateHeap;
+		Op.uThread = uThread;
+		Op.uHeap = uHeap;
+		g_Ops.push_back(Op);
+
+		return uHeap;
+	}
+
+	//  Description:
+	//      Adds a free of a slot to the operation list and updates the live statistics.
+	//  See Also:
+	//      ReplayAddRecord
+	//  Arguments:
+	//      uSlot - Allocation slot.
+	//		uHeap - Heap index of the allocation.
+	//		uSize - Size of the allocation.
+	//		uThread - Thread that frees it.
+	//		bDeferred - TRUE if it is part of a heap destruction.
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Adds a free to the operation list.
+	void ReplayAddFree(jrs_u32 uSlot, jrs_u32 uHeap, jrs_u64 uSize, jrs_u32 uThread, jrs_bool bDeferred)
+	{
+		sReplayOp Op;
+		memset(&Op, 0, sizeof(Op));
+		Op.uType = eReplayOp_Free;
+		Op.bDeferred = bDeferred;
+		Op.uThread = uThread;
+		Op.uHeap = uHeap;
+		Op.uSlot = uSlot;
+		Op.uSize = uSize;
+		g_Ops.push_back(Op);
+
+		sReplayHeap &rHeap = g_Heaps[uHeap];
+		rHeap.uLive -= uSize;
+		rHeap.uLiveCount--;
+		g_uLive -= uSize;
+		g_uLiveCount--;
+		g_uNumFrees++;
+	}
+
+	// Address of a live allocation.  Pool elements are kept apart from heap allocations as the first element can share the pool's address.
+	typedef std::pair<jrs_u32, jrs_u64> tReplayAddress;
+
+	// Live allocation.
+	struct sReplayLive
+	{
+		jrs_u32 uSlot;
+		jrs_u32 uHeap;
+		jrs_u64 uSize;
+	};
+
+	//  Description:
+	//      Turns a capture record into replay operations.
+	//  See Also:
+	//      ReplayParse
+	//  Arguments:
+	//      rRecord - Record.
+	//		rHeapMap - Map of capture ids to heap indices.
+	//		rLive - Map of live allocation addresses.
+	//		rThreadMap - Map of captured thread ids to replay threads.
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Turns a capture record into replay operations.
+	void ReplayAddRecord(const sContinuousDumpRecord &rRecord, std::map<jrs_u64, jrs_u32> &rHeapMap, std::map<tReplayAddress, sReplayLive> &rLive,
+		std::map<jrs_u64, jrs_u32> &rThreadMap)
+	{
+		g_uNumRecords++;
+		if(rRecord.uType == eContinuousDumpRecord_Stack)
+			return;
+
+		g_uCaptureTicks = rRecord.uTicks;
+		std::map<jrs_u64, jrs_u32>::iterator itThread = rThreadMap.find(rRecord.uThreadId);
+		jrs_u32 uThread;
+		if(itThread == rThreadMap.end())
+		{
+			uThread = g_uNumThreads++;
+			rThreadMap[rRecord.uThreadId] = uThread;
+		}
+		else
+		{
+			uThread = itThread->second;
+		}
+
+		jrs_bool bPool = rRecord.uType >= eContinuousDumpRecord_CreatePool && rRecord.uType <= eContinuousDumpRecord_FreePool;
+		sReplayOp Op;
+		memset(&Op, 0, sizeof(Op));
+		Op.uThread = uThread;
+
+		switch(rRecord.uType)
+		{
+		case eContinuousDumpRecord_Allocate:
+		case eContinuousDumpRecord_AllocatePool:
+			{
+				Op.uType = eReplayOp_Allocate;
+				Op.uHeap = ReplayFindHeap(rHeapMap, rRecord.uId, bPool, uThread);
+				Op.uSlot = g_uNumSlots++;
+				Op.uSize = rRecord.uSize;
+				Op.uAlignment = bPool ? 0 : rRecord.uAlignment;
+
+				// The free of the previous allocation at this address was logged after this allocation.  Free it first.
+				tReplayAddress Address(bPool ? 1 : 0, rRecord.uAddress);
+				std::map<tReplayAddress, sReplayLive>::iterator it = rLive.find(Address);
+				if(it != rLive.end())
+				{
+					ReplayAddFree(it->second.uSlot, it->second.uHeap, it->second.uSize, uThread, false);
+					g_uReusedAddresses++;
+				}
+
+				g_Ops.push_back(Op);
+				sReplayLive Live = { Op.uSlot, Op.uHeap, Op.uSize };
+				rLive[Address] = Live;
+
+				sReplayHeap &rHeap = g_Heaps[Op.uHeap];
+				rHeap.uLive += Op.uSize;
+				rHeap.uLiveCount++;
+				if(rHeap.uLive > rHeap.uPeakLive)
+					rHeap.uPeakLive = rHeap.uLive;
+				if(rHeap.uLiveCount > rHeap.uPeakLiveCount)
+					rHeap.uPeakLiveCount = rHeap.uLiveCount;
+
+				g_uLive += Op.uSize;
+				g_uLiveCount++;
+				if(g_uLive > g_uPeakLive)
+				{
+					g_uPeakLive = g_uLive;
+					g_uPeakLiveOp = (jrs_u32)g_Ops.size() - 1;
+				}
+				if(g_uLiveCount > g_uPeakLiveCount)
+					g_uPeakLiveCount = g_uLiveCount;
+				g_uNumAllocations++;
+			}
+			break;
+
+		case eContinuousDumpRecord_Free:
+		case eContinuousDumpRecord_FreePool:
+			{
+				// Frees of memory allocated before the capture started have nothing to replay
+				std::map<tReplayAddress, sReplayLive>::iterator it = rLive.find(tReplayAddress(bPool ? 1 : 0, rRecord.uAddress));
+				if(it == rLive.end())
+				{
+					g_uUnmatchedFrees++;
+					break;
+				}
+
+				ReplayAddFree(it->second.uSlot, it->second.uHeap, it->second.uSize, uThread, false);
+				rLive.erase(it);
+			}
+			break;
+
+		case eContinuousDumpRecord_CreateHeap:
+		case eContinuousDumpRecord_CreatePool:
+			{
+				sReplayHeap Heap;
+				memset(&Heap, 0, sizeof(Heap));
+				Heap.uCaptureId = rRecord.uId;
+				Heap.uKind = rRecord.uKind;
+				Heap.uParent = ReplayNoHeap;
+				Heap.uAlignment = rRecord.uAlignment;
+				Heap.uSize = Heap.uMaxSize = rRecord.uSize;
+				Heap.uMinAllocSize = rRecord.uMinSize;
+				Heap.uMaxAllocSize = rRecord.uMaxSize;
+				memcpy(Heap.Name, rRecord.Name, sizeof(Heap.Name));
+				if(bPool)
+				{
+					std::map<jrs_u64, jrs_u32>::iterator it = rHeapMap.find(rRecord.uParentId);
+					if(it != rHeapMap.end())
+						Heap.uParent = it->second;
+				}
+
+				Op.uType = eReplayOp_CreateHeap;
+				Op.uHeap = (jrs_u32)g_Heaps.size();
+				g_Heaps.push_back(Heap);
+				rHeapMap[((jrs_u64)(bPool ? 1 : 0) << 32) | rRecord.uId] = Op.uHeap;
+				g_Ops.push_back(Op);
+			}
+			break;
+
+		case eContinuousDumpRecord_ResizeHeap:
+			{
+				// Heaps resize themselves during the replay.  Only the size is needed.
+				std::map<jrs_u64, jrs_u32>::iterator it = rHeapMap.find(rRecord.uId);
+				if(it != rHeapMap.end() && rRecord.uSize > g_Heaps[it->second].uMaxSize)
+					g_Heaps[it->second].uMaxSize = rRecord.uSize;
+			}
+			break;
+
+		case eContinuousDumpRecord_DestroyHeap:
+		case eContinuousDumpRecord_DestroyPool:
+			{
+				jrs_u64 uKey = ((jrs_u64)(bPool ? 1 : 0) << 32) | rRecord.uId;
+				std::map<jrs_u64, jrs_u32>::iterator itHeap = rHeapMap.find(uKey);
+				if(itHeap == rHeapMap.end())
+				{
+					g_uIgnoredRecords++;
+					break;
+				}
+
+				// Memory still allocated is freed before the heap goes
+				Op.uType = eReplayOp_DestroyHeap;
+				Op.bDeferred = true;
+				Op.uHeap = itHeap->second;
+				std::map<tReplayAddress, sReplayLive>::iterator it = rLive.begin();
+				while(it != rLive.end())
+				{
+					if(it->second.uHeap == Op.uHeap)
+					{
+						ReplayAddFree(it->second.uSlot, it->second.uHeap, it->second.uSize, uThread, true);
+						rLive.erase(it++);
+					}
+					else
+					{
+						++it;
+					}
+				}
+
+				g_Ops.push_back(Op);
+				rHeapMap.erase(itHeap);
+			}
+			break;
+
+		default:
+			g_uIgnoredRecords++;
+			break;
+		}
+	}
+
+	//  Description:
+	//      Decodes a chunk of the capture.
+	//  See Also:
+	//      ReplayParse
+	//  Arguments:
+	//      pChunk - Chunk header.  The data follows it.
+	//		uAvailable - Bytes of the file from the chunk header on.
+	//		rRaw - Buffer for the decompressed chunk.
+	//		rHeapMap, rLive, rThreadMap - See ReplayAddRecord.
+	//  Return Value:
+	//      Size of the chunk in the file.  0 if it is not valid.
+	//  Summary:
+	//      Decodes a chunk of the capture.
+	jrs_u64 ReplayParseChunk(const sContinuousDumpChunkHeader *pChunk, jrs_u64 uAvailable, std::vector<jrs_u8> &rRaw, std::map<jrs_u64, jrs_u32> &rHeapMap,
+		std::map<tReplayAddress, sReplayLive> &rLive, std::map<jrs_u64, jrs_u32> &rThreadMap)
+	{
+		if(uAvailable < sizeof(sContinuousDumpChunkHeader) || pChunk->uMagic != ContinuousDump_ChunkMagic || !pChunk->uRawSize)
+			return 0;
+
+		jrs_u64 uStored = pChunk->uCompressedSize ? pChunk->uCompressedSize : pChunk->uRawSize;
+		if(uAvailable - sizeof(sContinuousDumpChunkHeader) < uStored)
+			return 0;
+
+		rRaw.resize(pChunk->uRawSize);
+		const jrs_u8 *pData = (const jrs_u8 *)(pChunk + 1);
+		if(pChunk->uCompressedSize)
+		{
+			if(ContinuousDump_Decompress(pData, pChunk->uCompressedSize, &rRaw[0], pChunk->uRawSize) != pChunk->uRawSize)
+				return 0;
+		}
+		else
+		{
+			memcpy(&rRaw[0], pData, pChunk->uRawSize);
+		}
+
+		cContinuousDumpChunkReader Reader(&rRaw[0], pChunk->uRawSize, pChunk->uFirstTicks);
+		sContinuousDumpRecord Record;
+		while(Reader.ReadRecord(Record))
+			ReplayAddRecord(Record, rHeapMap, rLive, rThreadMap);
+
+		if(Reader.HasError())
+			return 0;
+
+		g_uNumChunks++;
+		return sizeof(sContinuousDumpChunkHeader) + uStored;
+	}
+
+	//  Description:
+	//      Loads a capture and turns it into the replay operations.  Chunks are read in file order which is the order they were written.  A
+	//		capture that was not finished has no index and is read up to the first chunk that is incomplete.
+	//  See Also:
+	//      ReplayParseChunk
+	//  Arguments:
+	//      pFileName - Capture file.
+	//  Return Value:
+	//      TRUE if the capture could be read.
+	//  Summary:
+	//      Loads a capture.
+	jrs_bool ReplayParse(const jrs_i8 *pFileName)
+	{
+		FILE *pFile = fopen(pFileName, "rb");
+		if(!pFile)
+		{
+			fprintf(stderr, "Unable to open %s\n", pFileName);
+			return false;
+		}
+
+		std::vector<jrs_u8> File;
+		jrs_u8 Buffer[64 * 1024];
+		size_t uRead;
+		while((uRead = fread(Buffer, 1, sizeof(Buffer), pFile)) > 0)
+			File.insert(File.end(), Buffer, Buffer + uRead);
+		fclose(pFile);
+
+		const sContinuousDumpFileHeader *pHeader = (const sContinuousDumpFileHeader *)&File[0];
+		if(File.size() < sizeof(sContinuousDumpFileHeader) || pHeader->uMagic != ContinuousDump_FileMagic)
+		{
+			fprintf(stderr, "%s is not a compact continuous dump\n", pFileName);
+			return false;
+		}
+		if(pHeader->uVersion != ContinuousDump_Version)
+		{
+			fprintf(stderr, "%s is version %u.  Version %u is supported\n", pFileName, pHeader->uVersion, ContinuousDump_Version);
+			return false;
+		}
+
+		// The index gives where the chunks end
+		jrs_u64 uEnd = File.size();
+		const sContinuousDumpFooter *pFooter = (const sContinuousDumpFooter *)(&File[0] + File.size() - sizeof(sContinuousDumpFooter));
+		if(File.size() >= sizeof(sContinuousDumpFileHeader) + sizeof(sContinuousDumpFooter) && pFooter->uMagic == ContinuousDump_FooterMagic &&
+			pFooter->uIndexOffset <= File.size())
+			uEnd = pFooter->uIndexOffset;
+		else
+			g_bTruncated = true;
+
+		g_uTicksPerSecond = pHeader->uTicksPerSecond ? pHeader->uTicksPerSecond : 1;
+
+		std::map<jrs_u64, jrs_u32> HeapMap;
+		std::map<tReplayAddress, sReplayLive> Live;
+		std::map<jrs_u64, jrs_u32> ThreadMap;
+		std::vector<jrs_u8> Raw;
+		jrs_u64 uOffset = sizeof(sContinuousDumpFileHeader);
+		while(uOffset < uEnd)
+		{
+			jrs_u64 uChunkSize = ReplayParseChunk((const sContinuousDumpChunkHeader *)(&File[0] + uOffset), uEnd - uOffset, Raw, HeapMap, Live, ThreadMap);
+			if(!uChunkSize)
+			{
+				fprintf(stderr, "%s has a bad chunk at offset %llu.  Replaying what came before it.\n", pFileName, (unsigned long long)uOffset);
+				g_bTruncated = true;
+				break;
+			}
+
+			uOffset += uChunkSize;
+		}
+
+		if(!g_uNumThreads)
+			g_uNumThreads = 1;
+		g_uCaptureTicks -= g_uCaptureTicks > pHeader->uStartTicks ? pHeader->uStartTicks : g_uCaptureTicks;
+
+		return true;
+	}
+
+	//  Description:
+	//      Fills in heap details common to every replayed heap.  Everything the capture did must succeed so checks that would fail on it are
+	//		relaxed and errors become warnings.
+	//  See Also:
+	//      ReplayCreateHeap
+	//  Arguments:
+	//      rDetails - cHeap or cHeapNonIntrusive details.
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Fills in heap details common to every replayed heap.
+	template<class T> void ReplaySetHeapDetails(T &rDetails)
+	{
+		rDetails.bAllowNullFree = true;
+		rDetails.bAllowZeroSizeAllocations = true;
+		rDetails.bAllowDestructionWithAllocations = true;
+		rDetails.bAllowNotEnoughSpaceReturn = true;
+		rDetails.bEnableLogging = false;
+		rDetails.bErrorsAsWarnings = true;
+	}
+
+	//  Description:
+	//      Creates the heap that a captured heap or pool is replayed on.  Heaps that can not be created are folded into the bookkeeping heap
+	//		which also holds the non intrusive heap structures and pools whose parent was not captured.
+	//  See Also:
+	//      ReplayDestroyHeap
+	//  Arguments:
+	//      uHeap - Heap index.
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Creates the heap that a captured heap or pool is replayed on.
+	void ReplayCreateHeap(jrs_u32 uHeap)
+	{
+		if(g_uAllocator == eReplayAllocator_Glibc)
+			return;
+
+		sReplayHeap &rHeap = g_Heaps[uHeap];
+		jrs_u32 uKind = rHeap.uKind;
+		if(g_uAllocator == eReplayAllocator_Heap)
+			uKind = eContinuousDumpKind_Heap;
+		else if(g_uAllocator == eReplayAllocator_NonIntrusive)
+			uKind = eContinuousDumpKind_NonIntrusiveHeap;
+
+		// Names must be unique
+		jrs_i8 Name[ContinuousDump_MaxName + 16];
+		snprintf(Name, sizeof(Name), "%s#%u", rHeap.Name[0] ? rHeap.Name : "Heap", uHeap);
+
+		// Sizes are rounded to 1MB and capped to the largest heap
+		jrs_u64 uSize = rHeap.uSize;
+		if(uKind == eContinuousDumpKind_NonIntrusiveHeap)
+		{
+			// Non intrusive heaps can not grow so get room for the peak with space for rounding
+			jrs_u64 uNeeded = rHeap.uPeakLive * 2 + (jrs_u64)rHeap.uPeakLiveCount * 64;
+			uSize = rHeap.uMaxSize > uNeeded ? rHeap.uMaxSize : uNeeded;
+		}
+		uSize = (uSize + 0xfffff) & ~0xfffffULL;
+		if(uSize < (1 << 20))
+			uSize = 1 << 20;
+		if(uSize > 0xfff00000ULL)
+			uSize = 0xfff00000ULL;
+
+		jrs_bool bCaptured = g_uAllocator == eReplayAllocator_Capture && !rHeap.bImplicit;
+		if(uKind == eContinuousDumpKind_Heap)
+		{
+			cHeap::sHeapDetails Details;
+			ReplaySetHeapDetails(Details);
+			if(bCaptured && rHeap.uAlignment >= 16)
+				Details.uDefaultAlignment = rHeap.uAlignment;
+			if(bCaptured && rHeap.uMinAllocSize >= 16)
+				Details.uMinAllocationSize = (jrs_sizet)rHeap.uMinAllocSize;
+			Details.bEnableErrors = true;
+			Details.bEnableSentinelChecking = false;
+			rHeap.pHeap = cMemoryManager::Get().CreateHeap(uSize, Name, &Details);
+		}
+		else if(uKind == eContinuousDumpKind_NonIntrusiveHeap)
+		{
+			cHeapNonIntrusive::sHeapDetails Details;
+			ReplaySetHeapDetails(Details);
+			if(bCaptured && rHeap.uAlignment >= 16)
+				Details.uDefaultAlignment = rHeap.uAlignment;
+			if(bCaptured && rHeap.uMinAllocSize >= 16)
+				Details.uMinAllocationSize = (jrs_sizet)rHeap.uMinAllocSize;
+			rHeap.pNIHeap = cMemoryManager::Get().CreateNonIntrusiveHeap((jrs_sizet)uSize, g_pBookkeepingHeap, Name, &Details);
+		}
+		else
+		{
+			sPoolDetails Details;
+			Details.bAllowDestructionWithAllocations = true;
+			Details.bAllowNotEnoughSpaceReturn = true;
+			Details.bErrorsAsWarnings = true;
+			jrs_u32 uElementSize = (jrs_u32)(rHeap.uMinAllocSize ? rHeap.uMinAllocSize : 16);
+			jrs_u32 uElements = (jrs_u32)(rHeap.uSize / uElementSize);
+			Details.uGrowElements = uElements < 256 ? 256 : uElements;
+			cHeap *pParent = (rHeap.uParent != ReplayNoHeap && g_Heaps[rHeap.uParent].pHeap) ? g_Heaps[rHeap.uParent].pHeap : g_pBookkeepingHeap;
+			rHeap.pPool = cMemoryManager::Get().CreatePool(uElementSize, uElements ? uElements : 1, Name, &Details, pParent);
+		}
+
+		if(!rHeap.pHeap && !rHeap.pNIHeap && !rHeap.pPool)
+		{
+			rHeap.bFolded = true;
+			rHeap.pHeap = g_pBookkeepingHeap;
+			g_uFoldedHeaps++;
+		}
+	}
+
+	//  Description:
+	//      Destroys the heap a captured heap or pool was replayed on.
+	//  See Also:
+	//      ReplayCreateHeap
+	//  Arguments:
+	//      uHeap - Heap index.
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Destroys the heap a captured heap or pool was replayed on.
+	void ReplayDestroyHeap(jrs_u32 uHeap)
+	{
+		sReplayHeap &rHeap = g_Heaps[uHeap];
+		if(!rHeap.bFolded)
+		{
+			if(rHeap.pPool)
+				cMemoryManager::Get().DestroyPool(rHeap.pPool);
+			else if(rHeap.pNIHeap)
+				cMemoryManager::Get().DestroyNonIntrusiveHeap(rHeap.pNIHeap);
+			else if(rHeap.pHeap)
+				cMemoryManager::Get().DestroyHeap(rHeap.pHeap);
+		}
+
+		rHeap.pHeap = NULL;
+		rHeap.pNIHeap = NULL;
+		rHeap.pPool = NULL;
+	}
+
+	//  Description:
+	//      Runs one operation.
+	//  See Also:
+	//      ReplayRun
+	//  Arguments:
+	//      rOp - Operation.
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Runs one operation.
+	inline void ReplayExecute(const sReplayOp &rOp)
+	{
+		if(rOp.uType == eReplayOp_Allocate)
+		{
+			void *pMemory;
+			const sReplayHeap &rHeap = g_Heaps[rOp.uHeap];
+			if(g_uAllocator == eReplayAllocator_Glibc)
+			{
+				if(rOp.uAlignment > 16)
+				{
+					if(posix_memalign(&pMemory, rOp.uAlignment, (size_t)rOp.uSize))
+						pMemory = NULL;
+				}
+				else
+				{
+					pMemory = malloc((size_t)rOp.uSize);
+				}
+			}
+			else if(rHeap.pPool)
+				pMemory = rHeap.pPool->AllocateMemory();
+			else if(rHeap.pNIHeap)
+				pMemory = rHeap.pNIHeap->AllocateMemory((jrs_sizet)rOp.uSize, rOp.uAlignment);
+			else
+				pMemory = rHeap.pHeap->AllocateMemory((jrs_sizet)rOp.uSize, rOp.uAlignment);
+
+			if(!pMemory)
+			{
+				__sync_fetch_and_add(&g_uFailedAllocations, 1);
+				pMemory = ReplayFailedAllocation;
+			}
+			else
+			{
+				// Touch every page like the program would so the resident set is comparable between allocators
+				for(jrs_u64 uOffset = 0; uOffset < rOp.uSize; uOffset += g_uPageSize)
+					((volatile jrs_u8 *)pMemory)[uOffset] = 0;
+			}
+
+			g_pSlots[rOp.uSlot] = pMemory;
+		}
+		else if(rOp.uType == eReplayOp_Free)
+		{
+			// The allocation may be on another thread that has not got to it yet
+			void *pMemory;
+			while((pMemory = g_pSlots[rOp.uSlot]) == NULL)
+				sched_yield();
+
+			if(pMemory == ReplayFailedAllocation)
+				return;
+
+			const sReplayHeap &rHeap = g_Heaps[rOp.uHeap];
+			if(g_uAllocator == eReplayAllocator_Glibc)
+				free(pMemory);
+			else if(rHeap.pPool)
+				rHeap.pPool->FreeMemory(pMemory);
+			else if(rHeap.pNIHeap)
+				rHeap.pNIHeap->FreeMemory(pMemory);
+			else
+				rHeap.pHeap->FreeMemory(pMemory);
+		}
+		else if(rOp.uType == eReplayOp_CreateHeap)
+		{
+			ReplayCreateHeap(rOp.uHeap);
+		}
+		else
+		{
+			ReplayDestroyHeap(rOp.uHeap);
+		}
+	}
+
+	//  Description:
+	//      Runs a list of operations sampling the footprint as it goes.  The allocation that took the capture to its peak is always sampled
+	//		so the footprint can not miss the peak between samples.
+	//  See Also:
+	//      ReplayExecute
+	//  Arguments:
+	//      pArg - Index of the list in g_ThreadOps.
+	//  Return Value:
+	//      NULL.
+	//  Summary:
+	//      Runs a list of operations.
+	void *ReplayRun(void *pArg)
+	{
+		const std::vector<jrs_u32> &rOps = g_ThreadOps[(size_t)pArg];
+		for(size_t i = 0; i < rOps.size(); i++)
+		{
+			ReplayExecute(g_Ops[rOps[i]]);
+			if(!((i + 1) % ReplaySampleFrequency) || rOps[i] == g_uPeakLiveOp)
+				ReplaySample();
+		}
+
+		return NULL;
+	}
+
+	//  Description:
+	//      Splits the operations into the lists ReplayRun uses.  A single threaded replay has one list with everything in capture order.  A
+	//		threaded one creates the heaps first, has a list per captured thread and destroys the heaps last.  Also finds the allocations
+	//		that are never freed so glibc replays can release them between runs.
+	//  See Also:
+	//      ReplayRun
+	//  Arguments:
+	//      bThreaded - TRUE for a threaded replay.
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Splits the operations into replay lists.
+	void ReplayBuildLists(jrs_bool bThreaded)
+	{
+		std::vector<jrs_u8> Freed(g_uNumSlots);
+		for(jrs_u32 i = 0; i < g_Ops.size(); i++)
+		{
+			if(g_Ops[i].uType == eReplayOp_Free)
+				Freed[g_Ops[i].uSlot] = 1;
+		}
+		for(jrs_u32 i = 0; i < g_uNumSlots; i++)
+		{
+			if(!Freed[i])
+				g_Leaked.push_back(i);
+		}
+
+		g_ThreadOps.clear();
+		if(!bThreaded)
+		{
+			g_ThreadOps.resize(1);
+			g_ThreadOps[0].reserve(g_Ops.size());
+			for(jrs_u32 i = 0; i < g_Ops.size(); i++)
+				g_ThreadOps[0].push_back(i);
+			return;
+		}
+
+		g_ThreadOps.resize(g_uNumThreads + 2);
+		for(jrs_u32 i = 0; i < g_Ops.size(); i++)
+		{
+			const sReplayOp &rOp = g_Ops[i];
+			if(rOp.uType == eReplayOp_CreateHeap)
+				g_ThreadOps[0].push_back(i);
+			else if(rOp.bDeferred)
+				g_ThreadOps[g_uNumThreads + 1].push_back(i);
+			else
+				g_ThreadOps[rOp.uThread + 1].push_back(i);
+		}
+	}
+
+	//  Description:
+	//      Outputs the state of every replayed Elephant heap at the end of the replay.  External fragmentation is the part of the free memory
+	//		that is not in the largest free block.
+	//  See Also:
+	//      ReplayReport
+	//  Arguments:
+	//      None.
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Outputs the state of every replayed heap.
+	void ReplayReportHeaps(void)
+	{
+		printf("  %-40s %12s %12s %12s %12s %8s\n", "Heap", "Size", "Used", "Free", "Largest", "Frag");
+		for(jrs_u32 i = 0; i < g_Heaps.size(); i++)
+		{
+			const sReplayHeap &rHeap = g_Heaps[i];
+			jrs_u64 uSize, uUsed, uFree, uLargest;
+			if(rHeap.bFolded || rHeap.pPool)
+				continue;
+			if(rHeap.pHeap)
+			{
+				uSize = rHeap.pHeap->GetSize();
+				uUsed = rHeap.pHeap->GetMemoryUsed();
+				uFree = rHeap.pHeap->GetTotalFreeMemory();
+				uLargest = rHeap.pHeap->GetSizeOfLargestFragment();
+			}
+			else if(rHeap.pNIHeap)
+			{
+				uSize = rHeap.pNIHeap->GetSize();
+				uUsed = rHeap.pNIHeap->GetMemoryUsed();
+				uFree = rHeap.pNIHeap->GetTotalFreeMemory();
+				uLargest = rHeap.pNIHeap->GetSizeOfLargestFragment();
+			}
+			else
+			{
+				continue;
+			}
+
+			printf("  %-40s %12llu %12llu %12llu %12llu %7.2f%%\n", rHeap.Name[0] ? rHeap.Name : "Heap", (unsigned long long)uSize, (unsigned long long)uUsed,
+				(unsigned long long)uFree, (unsigned long long)uLargest, uFree ? 100.0 * (1.0 - (double)uLargest / (double)uFree) : 0.0);
+		}
+	}
+
+	//  Description:
+	//      Outputs the command line options.
+	//  See Also:
+	//
+	//  Arguments:
+	//      None.
+	//  Return Value:
+	//      None.
+	//  Summary:
+	//      Outputs the command line options.
+	void ReplayUsage(void)
+	{
+		fprintf(stderr, "Usage: elephant_replay [-a capture|heap|ni|glibc] [-t] [-r count] dump.bin\n"
+			"  -a  Allocator to replay against.  capture recreates the captured heap kinds.  Default capture.\n"
+			"  -t  Replay each captured thread on its own thread.\n"
+			"  -r  Number of runs.  Timing is the best run.  Default 1.\n");
+	}
+}
+
+//  Description:
+//      Replays a compact continuous dump.  See the top of the file.
+//  See Also:
+//
+//  Arguments:
+//      iArgc, pArgv - Command line.
+//  Return Value:
+//      0 on success.
+//  Summary:
+//      Replays a compact continuous dump.
+int main(int iArgc, char **pArgv)
+{
+	static const jrs_i8 *AllocatorNames[] = { "capture", "heap", "ni", "glibc" };
+	jrs_bool bThreaded = false;
+	jrs_u32 uRuns = 1;
+	const jrs_i8 *pFileName = NULL;
+	for(int i = 1; i < iArgc; i++)
+	{
+		if(!strcmp(pArgv[i], "-t"))
+		{
+			bThreaded = true;
+		}
+		else if(!strcmp(pArgv[i], "-r") && i + 1 < iArgc)
+		{
+			uRuns = (jrs_u32)strtoul(pArgv[++i], NULL, 10);
+			uRuns = uRuns ? uRuns : 1;
+		}
+		else if(!strcmp(pArgv[i], "-a") && i + 1 < iArgc)
+		{
+			i++;
+			g_uAllocator = 0xffffffff;
+			for(jrs_u32 j = 0; j < sizeof(AllocatorNames) / sizeof(AllocatorNames[0]); j++)
+			{
+				if(!strcmp(pArgv[i], AllocatorNames[j]))
+					g_uAllocator = j;
+			}
+		}
+		else if(pArgv[i][0] != '-' && !pFileName)
+		{
+			pFileName = pArgv[i];
+		}
+		else
+		{
+			g_uAllocator = 0xffffffff;
+		}
+	}
+
+	if(!pFileName || g_uAllocator == 0xffffffff)
+	{
+		ReplayUsage();
+		return 1;
+	}
+
+	if(!ReplayParse(pFileName))
+		return 1;
+
+	g_uPageSize = (jrs_u64)sysconf(_SC_PAGESIZE);
+	printf("Capture:        %s%s\n", pFileName, g_bTruncated ? " (not finished)" : "");
+	printf("  Records       %llu in %llu chunks over %.3fs\n", (unsigned long long)g_uNumRecords, (unsigned long long)g_uNumChunks, (double)g_uCaptureTicks / (double)g_uTicksPerSecond);
+	printf("  Operations    %llu allocations, %llu frees, %llu frees of earlier allocations skipped, %llu reused addresses, %llu records ignored\n",
+		(unsigned long long)g_uNumAllocations, (unsigned long long)g_uNumFrees, (unsigned long long)g_uUnmatchedFrees, (unsigned long long)g_uReusedAddresses,
+		(unsigned long long)g_uIgnoredRecords);
+	printf("  Topology      %u heaps and pools, %u threads\n", (jrs_u32)g_Heaps.size(), g_uNumThreads);
+	printf("  Peak          %llu bytes in %u allocations\n", (unsigned long long)g_uPeakLive, g_uPeakLiveCount);
+
+	ReplayBuildLists(bThreaded);
+	g_pSlots = (void * volatile *)calloc(g_uNumSlots ? g_uNumSlots : 1, sizeof(void *));
+	if(!g_pSlots)
+	{
+		fprintf(stderr, "Unable to allocate %u slots\n", g_uNumSlots);
+		return 1;
+	}
+
+	if(g_uAllocator != eReplayAllocator_Glibc)
+	{
+		cMemoryManager::InitializeCallbacks(ReplayTTY, ReplayError);
+		if(!cMemoryManager::Get().Initialize(JRSMEMORYINITFLAG_LARGEST, 0, false))
+		{
+			fprintf(stderr, "Elephant failed to initialize\n");
+			return 1;
+		}
+	}
+
+	// Footprint is only measured on the first run.  glibc keeps the memory freed by a run so later runs would reuse it.
+	jrs_u64 uOps = g_uNumAllocations + g_uNumFrees;
+	jrs_u64 uBestTime = ~0ULL, uFootprint = 0, uUsed = 0, uFailed = 0, uFolded = 0;
+	printf("Replay:         %s, %s\n", AllocatorNames[g_uAllocator], bThreaded ? "threaded" : "single thread");
+	for(jrs_u32 uRun = 0; uRun < uRuns; uRun++)
+	{
+		memset((void *)g_pSlots, 0, g_uNumSlots * sizeof(void *));
+		if(g_uAllocator != eReplayAllocator_Glibc)
+		{
+			cHeap::sHeapDetails Details;
+			ReplaySetHeapDetails(Details);
+			g_pBookkeepingHeap = cMemoryManager::Get().CreateHeap(32 << 20, "ReplayBookkeeping", &Details);
+		}
+
+		// Everything the replay needs is allocated so the resident set only grows by what the allocator uses
+		malloc_trim(0);
+		g_uBaseResident = ReplayGetResident();
+		g_uBaseUsed = ReplayGetUsed();
+		g_uPeakResident = g_uBaseResident;
+		g_uPeakUsed = g_uBaseUsed;
+
+		jrs_u64 uStart = ReplayGetTime();
+		if(bThreaded)
+		{
+			ReplayRun((void *)0);
+			std::vector<pthread_t> Threads(g_uNumThreads);
+			for(jrs_u32 i = 0; i < g_uNumThreads; i++)
+			{
+				if(pthread_create(&Threads[i], NULL, ReplayRun, (void *)(size_t)(i + 1)))
+				{
+					fprintf(stderr, "Unable to create replay thread %u\n", i);
+					return 1;
+				}
+			}
+			for(jrs_u32 i = 0; i < g_uNumThreads; i++)
+				pthread_join(Threads[i], NULL);
+
+			ReplaySample();
+			ReplayRun((void *)(size_t)(g_uNumThreads + 1));
+		}
+		else
+		{
+			ReplayRun((void *)0);
+		}
+		jrs_u64 uTime = ReplayGetTime() - uStart;
+		ReplaySample();
+
+		uBestTime = uTime < uBestTime ? uTime : uBestTime;
+		printf("  Run %-9u %.3fms, %.1fns per operation, %.2fM operations per second\n", uRun + 1, (double)uTime / 1000000.0, uOps ? (double)uTime / (double)uOps : 0.0,
+			uTime ? (double)uOps * 1000.0 / (double)uTime : 0.0);
+		if(!uRun)
+		{
+			uFootprint = g_uPeakResident - g_uBaseResident;
+			uUsed = g_uPeakUsed - g_uBaseUsed;
+			uFailed = g_uFailedAllocations;
+			uFolded = g_uFoldedHeaps;
+		}
+
+		// The heaps still alive at the end of the capture are reported after the last run
+		if(uRun + 1 == uRuns)
+		{
+			if(uRuns > 1)
+				printf("  Best          %.3fms, %.1fns per operation\n", (double)uBestTime / 1000000.0, uOps ? (double)uBestTime / (double)uOps : 0.0);
+			printf("  Footprint     %llu bytes resident, %llu bytes used by the allocator at peak\n", (unsigned long long)uFootprint, (unsigned long long)uUsed);
+			printf("  Overhead      %.2f%% resident, %.2f%% used over the peak allocated\n", g_uPeakLive ? 100.0 * ((double)uFootprint / (double)g_uPeakLive - 1.0) : 0.0,
+				g_uPeakLive ? 100.0 * ((double)uUsed / (double)g_uPeakLive - 1.0) : 0.0);
+			printf("  Failures      %llu allocations failed, %llu heaps folded into the bookkeeping heap, %llu Elephant errors\n", (unsigned long long)uFailed,
+				(unsigned long long)uFolded, (unsigned long long)g_uElephantErrors);
+			if(g_uAllocator != eReplayAllocator_Glibc)
+				ReplayReportHeaps();
+		}
+
+		// Tear down what is left so each run starts the same
+		if(g_uAllocator != eReplayAllocator_Glibc)
+		{
+			for(jrs_u32 i = (jrs_u32)g_Heaps.size(); i > 0; i--)
+				ReplayDestroyHeap(i - 1);
+			cMemoryManager::Get().DestroyHeap(g_pBookkeepingHeap);
+			g_pBookkeepingHeap = NULL;
+		}
+		else
+		{
+			for(jrs_u32 i = 0; i < g_Leaked.size(); i++)
+			{
+				if(g_pSlots[g_Leaked[i]] != ReplayFailedAllocation)
+					free(g_pSlots[g_Leaked[i]]);
+			}
+		}
+
+		g_uFailedAllocations = 0;
+		g_uFoldedHeaps = 0;
+		for(jrs_u32 i = 0; i < g_Heaps.size(); i++)
+			g_Heaps[i].bFolded = false;
+	}
+
+	if(g_uAllocator != eReplayAllocator_Glibc)
+		cMemoryManager::Get().Destroy();
+	free((void *)g_pSlots);
+
+	return 0;
+}
@@ -0,0 +1,218 @@
+/*
+(C) Copyright 2010 Jury Rig Software Limited. All Rights Reserved.
+
+Use of this software is subject to the terms of an end user license agreement.
+This software contains code, techniques and know-how which is confidential and proprietary to Jury Rig Software Ltd.
+Not for disclosure or distribution without Jury Rig Software Ltd's prior written consent.
+*/
+
+// Prints the shared memory statistics page of a running process (see cMemoryManager::InitializeStatsPage).  Built as elephant_stats by
+// the JRSMemory_StatsReader target of Linux.mk.
+//
+//		Lib/Linux/x64/elephant_stats [-i ms] pid | name
+//
+//		-i	Prints the page every ms milliseconds until interrupted.  Default prints it once.
+//		pid		Process id of a process using the default name, /elephant_stats_pid.
+//		name	Name the page was published under.
+//
+// The page is mapped read only and copied with StatsPage_Read so the process being monitored is never locked or written to.  Only the
+// statistics header is used so the reader is not linked against Elephant.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <JRSMemory_StatsPage.h>
+
+using namespace Elephant;
+
+namespace
+{
+	//  Description:
+	//      Prints the command line options.
+	//  See Also:
+	//
+	//  Arguments:
+	//      None
+	//  Return Value:
+	//      Nothing
+	//  Summary:
+	//      Prints the command line options.
+	void StatsReaderUsage(void)
+	{
+		fprintf(stderr, "Usage: elephant_stats [-i ms] pid | name\n"
+			"  -i  Print the page every ms milliseconds.  Default once.\n"
+			"  pid  Process id of a process publishing under the default name.\n"
+			"  name  Shared memory name of the page.\n");
+	}
+
+	//  Description:
+	//      Returns the CLOCK_MONOTONIC time in nanoseconds.  The same clock the Linux publisher stamps updates with.
+	//  See Also:
+	//
+	//  Arguments:
+	//      None
+	//  Return Value:
+	//      Time in nanoseconds.
+	//  Summary:
+	//      Returns the monotonic time.
+	jrs_u64 StatsReaderNowNS(void)
+	{
+		struct timespec Time;
+		clock_gettime(CLOCK_MONOTONIC, &Time);
+		return (jrs_u64)Time.tv_sec * 1000000000ULL + (jrs_u64)Time.tv_nsec;
+	}
+
+	//  Description:
+	//      Prints one copy of the page as a table.  Pools are listed under the heap they are attached to.
+	//  See Also:
+	//
+	//  Arguments:
+	//      rHeader - Copied header.
+	//      pEntries - Copied entries.
+	//  Return Value:
+	//      Nothing
+	//  Summary:
+	//      Prints the page.
+	void StatsReaderPrint(const sStatsPageHeader &rHeader, const sStatsPageEntry *pEntries)
+	{
+		static const jrs_i8 *KindNames[] = { "heap", "ni", "pool" };
+
+		printf("Update %llu", (unsigned long long)rHeader.uUpdateCount);
+		if(rHeader.uTicksPerSecond)
+		{
+			jrs_u64 uNowNS = StatsReaderNowNS();
+			jrs_u64 uTicksNS = (jrs_u64)((double)rHeader.uTicks * 1000000000.0 / (double)rHeader.uTicksPerSecond);
+			printf(", %.3fs old", uNowNS > uTicksNS ? (double)(uNowNS - uTicksNS) / 1000000000.0 : 0.0);
+		}
+		printf(", %u entries%s\n", rHeader.uNumEntries, (rHeader.uFlags & StatsPageFlag_Truncated) ? " (truncated)" : "");
+
+		jrs_bool bLocks = (rHeader.uFlags & StatsPageFlag_LockStatistics) != 0;
+		printf("%-32s %-4s %6s %6s %14s %14s %14s %10s %14s %14s %8s", "Name", "Kind", "Id", "Parent", "Size", "Used", "Peak", "Count", "Free",
+			"Largest", "Resizes");
+		if(bLocks)
+			printf(" %12s %10s %10s", "Locks", "AvgWaitNS", "MaxWaitNS");
+		printf("\n");
+
+		for(jrs_u32 i = 0; i < rHeader.uNumEntries; i++)
+		{
+			const sStatsPageEntry &rEntry = pEntries[i];
+			jrs_i8 Name[StatsPage_MaxName + 2];
+			snprintf(Name, sizeof(Name), "%s%.*s", rEntry.uKind == eStatsPageKind_Pool ? "  " : "", (int)(StatsPage_MaxName - 1), rEntry.Name);
+
+			printf("%-32s %-4s %6u ", Name, rEntry.uKind < 3 ? KindNames[rEntry.uKind] : "?", rEntry.uId);
+			if(rEntry.uKind == eStatsPageKind_Pool)
+				printf("%6u", rEntry.uParentId);
+			else
+				printf("%6s", "-");
+			printf(" %14llu %14llu %14llu %10llu %14llu %14llu %8u", (unsigned long long)rEntry.uSize, (unsigned long long)rEntry.uUsed,
+				(unsigned long long)rEntry.uPeakUsed, (unsigned long long)rEntry.uCount, (unsigned long long)rEntry.uFree,
+				(unsigned long long)rEntry.uLargestFree, rEntry.uResizeCount);
+			if(bLocks && rEntry.uLockCount)
+				printf(" %12llu %10llu %10llu", (unsigned long long)rEntry.uLockCount, (unsigned long long)(rEntry.uLockWaitNS / rEntry.uLockCount),
+					(unsigned long long)rEntry.uLockWaitMaxNS);
+			printf("\n");
+		}
+	}
+}
+
+//  Description:
+//      Prints a shared memory statistics page.  See the top of the file.
+//  See Also:
+//
+//  Arguments:
+//      iArgc, pArgv - Command line.
+//  Return Value:
+//      0 on success.
+//  Summary:
+//      Prints a shared memory statistics page.
+int main(int iArgc, char **pArgv)
+{
+	const jrs_i8 *pName = NULL;
+	jrs_i8 DefaultName[64];
+	jrs_u32 uIntervalMS = 0;
+	jrs_bool bNamed = false;
+	for(int i = 1; i < iArgc; i++)
+	{
+		if(!strcmp(pArgv[i], "-i") && i + 1 < iArgc)
+		{
+			uIntervalMS = (jrs_u32)strtoul(pArgv[++i], NULL, 10);
+		}
+		else if(pArgv[i][0] != '-' && !bNamed)
+		{
+			pName = pArgv[i];
+			bNamed = true;
+		}
+		else
+		{
+			StatsReaderUsage();
+			return 1;
+		}
+	}
+
+	if(!pName)
+	{
+		StatsReaderUsage();
+		return 1;
+	}
+
+	// A process id on its own is the default name of that process
+	if(pName[0] && !pName[strspn(pName, "0123456789")])
+	{
+		snprintf(DefaultName, sizeof(DefaultName), "/elephant_stats_%s", pName);
+		pName = DefaultName;
+	}
+
+	int iFile = shm_open(pName, O_RDONLY, 0);
+	if(iFile < 0)
+	{
+		fprintf(stderr, "Unable to open the statistics page %s\n", pName);
+		return 1;
+	}
+
+	struct stat Stat;
+	void *pPage = MAP_FAILED;
+	if(fstat(iFile, &Stat) == 0 && (jrs_u64)Stat.st_size >= sizeof(sStatsPageHeader))
+		pPage = mmap(NULL, (size_t)Stat.st_size, PROT_READ, MAP_SHARED, iFile, 0);
+	close(iFile);
+	if(pPage == MAP_FAILED)
+	{
+		fprintf(stderr, "Unable to map the statistics page %s\n", pName);
+		return 1;
+	}
+
+	// Never copy more entries than the mapping holds whatever the header says.
+	const sStatsPageHeader *pShared = (const sStatsPageHeader *)pPage;
+	jrs_u32 uMaxEntries = 0;
+	if(pShared->uHeaderSize <= (jrs_u64)Stat.st_size && pShared->uEntrySize == sizeof(sStatsPageEntry))
+		uMaxEntries = (jrs_u32)(((jrs_u64)Stat.st_size - pShared->uHeaderSize) / sizeof(sStatsPageEntry));
+	sStatsPageEntry *pEntries = (sStatsPageEntry *)malloc((uMaxEntries ? uMaxEntries : 1) * sizeof(sStatsPageEntry));
+
+	int iResult = 0;
+	for(;;)
+	{
+		sStatsPageHeader Header;
+		if(!pEntries || !StatsPage_Read(pPage, &Header, pEntries, uMaxEntries))
+		{
+			fprintf(stderr, "%s is not a readable statistics page\n", pName);
+			iResult = 1;
+			break;
+		}
+
+		StatsReaderPrint(Header, pEntries);
+		if(!uIntervalMS)
+			break;
+
+		printf("\n");
+		fflush(stdout);
+		usleep(uIntervalMS * 1000);
+	}
+
+	free(pEntries);
+	munmap(pPage, (size_t)Stat.st_size);
+	return iResult;
+}
@@ -10,6 +10,8 @@ Not for disclosure or distribution without Jury Rig Software Ltd's prior written
 #include <stdio.h>
 #include <execinfo.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 #include <dlfcn.h>
 
 #include <JRSMemory.h>
@@ -34,6 +36,11 @@ namespace Elephant
 	// Forward declarations to avoid compiler errors on some platforms
 	void *MemoryManagerDefaultSystemAllocator(jrs_u64 uSize, void *pExtMemoryPtr);
 	void MemoryManagerDefaultSystemFree(void *pFree, jrs_u64 uSize);
+	jrs_bool MemoryManagerDefaultSystemRelease(void *pAddress, jrs_u64 uSize);
+	jrs_u32 MemoryManagerDefaultSystemZeroFlags(void);
+	void MemoryManagerPlatformWriteModuleMap(MemoryManagerOutputToFile Output, const jrs_i8 *pFilePathAndName);
+	void *MemoryManagerPlatformCreateSharedPage(const jrs_i8 *pName, jrs_sizet uSize);
+	void MemoryManagerPlatformDestroySharedPage(const jrs_i8 *pName, void *pPage, jrs_sizet uSize);
 	void MemoryManagerPlatformInit(void);
 	void MemoryManagerPlatformDestroy(void);
 	jrs_sizet MemoryManagerPlatformAddressToBaseAddress(jrs_sizet uAddress);
@@ -60,6 +67,76 @@ namespace Elephant
 		munmap(pFree, uSize);
 	}
 
+	jrs_bool MemoryManagerDefaultSystemRelease(void *pAddress, jrs_u64 uSize)
+	{
+		return madvise(pAddress, uSize, MADV_FREE) == 0;
+	}
+
+	jrs_u32 MemoryManagerDefaultSystemZeroFlags(void)
+	{
+		// mmap returns zero filled pages.  MADV_FREE pages may keep their contents.
+		return JRSMEMORYZEROFLAG_ALLOCATOR;
+	}
+
+	void MemoryManagerPlatformWriteModuleMap(MemoryManagerOutputToFile Output, const jrs_i8 *pFilePathAndName)
+	{
+		// No module map.  Addresses are left for the tools to resolve against the executable.
+	}
+
+	// The shared page this process created.  Only the creator removes it and only while the name still refers to it.
+	static jrs_i8 g_SharedPageName[128];
+	static pid_t g_SharedPageOwner = 0;
+	static dev_t g_SharedPageDevice = 0;
+	static ino_t g_SharedPageInode = 0;
+
+	void *MemoryManagerPlatformCreateSharedPage(const jrs_i8 *pName, jrs_sizet uSize)
+	{
+		// %d in the name becomes the process id so processes do not share a page.  The name is copied untouched otherwise.
+		const jrs_i8 *pPid = strstr(pName, "%d");
+		int iLength = pPid ? snprintf(g_SharedPageName, sizeof(g_SharedPageName), "%.*s%d%s", (int)(pPid - pName), pName, (int)getpid(), pPid + 2) :
+			snprintf(g_SharedPageName, sizeof(g_SharedPageName), "%s", pName);
+		if(iLength < 0 || iLength >= (int)sizeof(g_SharedPageName))
+			return NULL;
+
+		// A page already using the name belongs to someone else or to a process that did not shut down.  It is left alone and creating fails.
+		int iFile = shm_open(g_SharedPageName, O_RDWR | O_CREAT | O_EXCL, 0644);
+		if(iFile < 0)
+			return NULL;
+
+		struct stat Stat;
+		void *pPage = MAP_FAILED;
+		if(fstat(iFile, &Stat) == 0 && ftruncate(iFile, (off_t)uSize) == 0)
+			pPage = mmap(NULL, uSize, PROT_READ | PROT_WRITE, MAP_SHARED, iFile, 0);
+		close(iFile);
+
+		if(pPage == MAP_FAILED)
+		{
+			shm_unlink(g_SharedPageName);
+			return NULL;
+		}
+
+		g_SharedPageOwner = getpid();
+		g_SharedPageDevice = Stat.st_dev;
+		g_SharedPageInode = Stat.st_ino;
+		return pPage;
+	}
+
+	void MemoryManagerPlatformDestroySharedPage(const jrs_i8 *pName, void *pPage, jrs_sizet uSize)
+	{
+		munmap(pPage, uSize);
+
+		// A forked child or a page replaced by hand is not ours to remove
+		int iFile = g_SharedPageOwner == getpid() ? shm_open(g_SharedPageName, O_RDONLY, 0) : -1;
+		if(iFile >= 0)
+		{
+			struct stat Stat;
+			if(fstat(iFile, &Stat) == 0 && Stat.st_dev == g_SharedPageDevice && Stat.st_ino == g_SharedPageInode)
+				shm_unlink(g_SharedPageName);
+			close(iFile);
+		}
+		g_SharedPageOwner = 0;
+	}
+
 	jrs_sizet MemoryManagerSystemPageSize(void)
 	{
 		return 1024 * 64;
@@ -111,19 +188,6 @@ namespace Elephant
         }
 	}
 
-	void cPoolBase::StackTrace(jrs_sizet *pCallStack)
-	{
-		void* callstack[32];
-        
-		memset(pCallStack, 0, JRSMEMORY_CALLSTACKDEPTH * sizeof(jrs_sizet));
-        
-        jrs_i32 frames = backtrace(callstack, 32);
-        for(jrs_i32 i = 3; i < JRSMEMORY_CALLSTACKDEPTH && i < frames; i++)
-        {
-            pCallStack[i - 3] = (jrs_sizet)callstack[i]; 
-        }
-	}
-
 	// Socket wrappers per platform.  This doesn't have to be sockets but must function the same.  Although we call it a socket it could just be an id that is passed around.
 
 	//  Description:
@@ -48,6 +48,11 @@ namespace Elephant
 	// Forward declarations to avoid compiler errors on some platforms
 	void *MemoryManagerDefaultSystemAllocator(jrs_u64 uSize, void *pExtMemoryPtr);
 	void MemoryManagerDefaultSystemFree(void *pFree, jrs_u64 uSize);
+	jrs_bool MemoryManagerDefaultSystemRelease(void *pAddress, jrs_u64 uSize);
+	jrs_u32 MemoryManagerDefaultSystemZeroFlags(void);
+	void MemoryManagerPlatformWriteModuleMap(MemoryManagerOutputToFile Output, const jrs_i8 *pFilePathAndName);
+	void *MemoryManagerPlatformCreateSharedPage(const jrs_i8 *pName, jrs_sizet uSize);
+	void MemoryManagerPlatformDestroySharedPage(const jrs_i8 *pName, void *pPage, jrs_sizet uSize);
 	void MemoryManagerPlatformInit(void);
 	void MemoryManagerPlatformDestroy(void);
 	jrs_sizet MemoryManagerPlatformAddressToBaseAddress(jrs_sizet uAddress);
@@ -78,6 +83,32 @@ namespace Elephant
 		VirtualFree(pFree, 0, MEM_RELEASE);
 	}
 
+	jrs_bool MemoryManagerDefaultSystemRelease(void *pAddress, jrs_u64 uSize)
+	{
+		return VirtualAlloc(pAddress, (SIZE_T)uSize, MEM_RESET, PAGE_READWRITE) != NULL;
+	}
+
+	jrs_u32 MemoryManagerDefaultSystemZeroFlags(void)
+	{
+		// VirtualAlloc returns zero filled pages.  MEM_RESET pages may keep their contents.
+		return JRSMEMORYZEROFLAG_ALLOCATOR;
+	}
+
+	void MemoryManagerPlatformWriteModuleMap(MemoryManagerOutputToFile Output, const jrs_i8 *pFilePathAndName)
+	{
+		// No module map.  Addresses are left for the tools to resolve against the executable.
+	}
+
+	void *MemoryManagerPlatformCreateSharedPage(const jrs_i8 *pName, jrs_sizet uSize)
+	{
+		// No shared memory.  The statistics page is not available.
+		return NULL;
+	}
+
+	void MemoryManagerPlatformDestroySharedPage(const jrs_i8 *pName, void *pPage, jrs_sizet uSize)
+	{
+	}
+
 	jrs_sizet MemoryManagerSystemPageSize(void)
 	{
 		// We actually use the AllocationGranularity instead of the actual page size.  Makes allocating more efficient.
@@ -168,13 +199,6 @@ namespace Elephant
 			CStackBT(uCallstackDepth, uCallStackCount, (void **)pCallStack, NULL);	
 	}
 
-	void cPoolBase::StackTrace(jrs_sizet *pCallStack)
-	{
-		memset(pCallStack, 0, JRSMEMORY_CALLSTACKDEPTH * sizeof(jrs_sizet));
-		if(CStackBT)
-			CStackBT(3, JRSMEMORY_CALLSTACKDEPTH, (void **)pCallStack, NULL);
-	}
-
 	// Socket wrappers per platform.  This doesn't have to be sockets but must function the same.  Although we call it a socket it could just be an id that is passed around.
 	
 	//  Description:
@@ -61,4 +61,21 @@ namespace Elephant
 		
 		return m_ElapsedTimeMSTotal;
 	}
+
+	namespace JRSTimer
+	{
+		jrs_u64 GetTicks(void)
+		{
+			LARGE_INTEGER qwCurrentTime;
+			QueryPerformanceCounter(&qwCurrentTime);
+			return (jrs_u64)qwCurrentTime.QuadPart;
+		}
+
+		jrs_u64 GetTicksPerSecond(void)
+		{
+			LARGE_INTEGER qwFrequency;
+			QueryPerformanceFrequency(&qwFrequency);
+			return (jrs_u64)qwFrequency.QuadPart;
+		}
+	}
 }
\ No newline at end of file
@@ -62,4 +62,19 @@ namespace Elephant
 
 		return m_ElapsedTimeMSTotal;
 	}
+
+	namespace JRSTimer
+	{
+		jrs_u64 GetTicks(void)
+		{
+			uint64_t qwCurrentTime;
+			SYS_TIMEBASE_GET(qwCurrentTime);
+			return (jrs_u64)qwCurrentTime;
+		}
+
+		jrs_u64 GetTicksPerSecond(void)
+		{
+			return (jrs_u64)sys_time_get_timebase_frequency();
+		}
+	}
 }
\ No newline at end of file
@@ -59,4 +59,17 @@ namespace Elephant
 
 		return m_ElapsedTimeMSTotal;
 	}
+
+	namespace JRSTimer
+	{
+		jrs_u64 GetTicks(void)
+		{
+			return (jrs_u64)OSGetTime();
+		}
+
+		jrs_u64 GetTicksPerSecond(void)
+		{
+			return (jrs_u64)OS_TIMER_CLOCK;
+		}
+	}
 }
\ No newline at end of file
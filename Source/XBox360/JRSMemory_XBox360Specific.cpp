@@ -15,6 +15,11 @@ namespace Elephant
 	// Forward declarations to avoid compiler errors on some platforms
 	void *MemoryManagerDefaultSystemAllocator(jrs_u64 uSize, void *pExtMemoryPtr);
 	void MemoryManagerDefaultSystemFree(void *pFree, jrs_u64 uSize);
+	jrs_bool MemoryManagerDefaultSystemRelease(void *pAddress, jrs_u64 uSize);
+	jrs_u32 MemoryManagerDefaultSystemZeroFlags(void);
+	void MemoryManagerPlatformWriteModuleMap(MemoryManagerOutputToFile Output, const jrs_i8 *pFilePathAndName);
+	void *MemoryManagerPlatformCreateSharedPage(const jrs_i8 *pName, jrs_sizet uSize);
+	void MemoryManagerPlatformDestroySharedPage(const jrs_i8 *pName, void *pPage, jrs_sizet uSize);
 	void MemoryManagerPlatformInit(void);
 	void MemoryManagerPlatformDestroy(void);
 	jrs_sizet MemoryManagerPlatformAddressToBaseAddress(jrs_sizet uAddress);
@@ -39,6 +44,33 @@ namespace Elephant
 		XPhysicalFree(pFree);
 	}
 
+	jrs_bool MemoryManagerDefaultSystemRelease(void *pAddress, jrs_u64 uSize)
+	{
+		// Not supported.  Memory stays resident.
+		return FALSE;
+	}
+
+	jrs_u32 MemoryManagerDefaultSystemZeroFlags(void)
+	{
+		// Memory is not known to be zero filled.
+		return JRSMEMORYZEROFLAG_NONE;
+	}
+
+	void MemoryManagerPlatformWriteModuleMap(MemoryManagerOutputToFile Output, const jrs_i8 *pFilePathAndName)
+	{
+		// No module map.  Addresses are left for the tools to resolve against the executable.
+	}
+
+	void *MemoryManagerPlatformCreateSharedPage(const jrs_i8 *pName, jrs_sizet uSize)
+	{
+		// No shared memory.  The statistics page is not available.
+		return NULL;
+	}
+
+	void MemoryManagerPlatformDestroySharedPage(const jrs_i8 *pName, void *pPage, jrs_sizet uSize)
+	{
+	}
+
 	jrs_sizet MemoryManagerSystemPageSize(void)
 	{
 		return 1024 * 64;
@@ -126,35 +158,6 @@ namespace Elephant
 		}
 	}
 
-	void cPoolBase::StackTrace(jrs_u32 *pCallStack)
-	{
-		jrs_u64 StackBottom;
-		_asm  { addi StackBottom, r1, 0 };
-
-		memset(pCallStack, 0, JRSMEMORY_CALLSTACKDEPTH * 4);
-
-		// Get the local stack value from r1.
-		jrs_u32 *pWalkStack = (jrs_u32 *)StackBottom;
-		for(jrs_u32 i = 0; i < 2; i++)
-		{
-			if(!pWalkStack)
-				return;
-
-			pWalkStack = (jrs_u32 *)(*pWalkStack);
-		}
-
-		for(jrs_u32 i = 0; i < JRSMEMORY_CALLSTACKDEPTH; i++)
-		{
-			// Break if we have reached the top
-			if(!pWalkStack)
-				break;
-
-			// Store the return value 
-			pCallStack[i] = pWalkStack[-2];
-			pWalkStack = (jrs_u32 *)(*pWalkStack);
-		}
-	}
-
 	// Socket wrappers per platform.  This doesn't have to be sockets but must function the same.  Although we call it a socket it could just be an id that is passed around.
 
 	//  Description:
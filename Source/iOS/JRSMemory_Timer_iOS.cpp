@@ -6,6 +6,7 @@ This software contains code, techniques and know-how which is confidential and p
 Not for disclosure or distribution without Jury Rig Software Ltd's prior written consent. 
 */
 #include <sys/time.h>
+#include <mach/mach_time.h>
 #include <stdio.h>
 #include "JRSMemory_Timer.h"
 
@@ -63,4 +64,19 @@ namespace Elephant
 
 		return m_ElapsedTimeMSTotal;
 	}
+
+	namespace JRSTimer
+	{
+		jrs_u64 GetTicks(void)
+		{
+			return (jrs_u64)mach_absolute_time();
+		}
+
+		jrs_u64 GetTicksPerSecond(void)
+		{
+			mach_timebase_info_data_t Timebase;
+			mach_timebase_info(&Timebase);
+			return Timebase.numer ? (1000000000ULL * Timebase.denom) / Timebase.numer : 0;
+		}
+	}
 }
\ No newline at end of file